@@ -212,6 +212,28 @@ cdef extern from "semaphore.h" nogil:
     int sem_timedwait(sem_t *sem, const timespec *abs_timeout)
     int sem_post(sem_t *sem)
 
+cdef extern from "pthread.h" nogil:
+    ctypedef struct pthread_mutex_t:
+        pass
+    ctypedef struct pthread_cond_t:
+        pass
+    int pthread_mutex_init(pthread_mutex_t *m, const void *attr)
+    int pthread_mutex_destroy(pthread_mutex_t *m)
+    int pthread_mutex_lock(pthread_mutex_t *m)
+    int pthread_mutex_unlock(pthread_mutex_t *m)
+    int pthread_cond_init(pthread_cond_t *c, const void *attr)
+    int pthread_cond_destroy(pthread_cond_t *c)
+    int pthread_cond_wait(pthread_cond_t *c, pthread_mutex_t *m)
+    int pthread_cond_timedwait(pthread_cond_t *c, pthread_mutex_t *m,
+                               const timespec *abstime)
+    int pthread_cond_signal(pthread_cond_t *c)
+
+cdef extern from "sys/eventfd.h" nogil:
+    enum:
+        EFD_NONBLOCK
+        EFD_CLOEXEC
+    int eventfd(unsigned int initval, int flags)
+
 cdef extern from "time.h" nogil:
     int clock_gettime(int clk_id, timespec *tp)
     enum:
@@ -355,6 +377,7 @@ cdef extern from "ldms.h" nogil:
 			  attr_value_list *auth_av_list)
     void ldms_xprt_put(ldms_t x, const char *name)
     void ldms_xprt_close(ldms_t x)
+    int ldms_xprt_connected(ldms_t x)
     int ldms_xprt_connect_by_name(ldms_t x, const char *host, const char *port,
                                   ldms_event_cb_t cb, void *cb_arg)
     int ldms_xprt_listen_by_name(ldms_t x, const char *host, const char *port,
@@ -482,6 +505,7 @@ cdef extern from "ldms.h" nogil:
 
     # --- set related --- #
     ldms_set_t ldms_set_by_name(const char *set_name)
+    void ldms_set_ref_get(ldms_set_t s, const char *reason)
     void ldms_set_put(ldms_set_t s)
     const char *ldms_set_schema_name_get(ldms_set_t s)
     const char *ldms_set_instance_name_get(ldms_set_t s)
@@ -51,7 +51,7 @@ from cpython cimport PyObject, Py_INCREF, Py_DECREF, PyGILState_Ensure, \
 
 from libc.stdint cimport *
 from libc.stdlib cimport calloc, malloc, free, realloc
-from posix.unistd cimport geteuid, getegid
+from posix.unistd cimport geteuid, getegid, read, write, close
 from collections import namedtuple
 import datetime as dt
 import struct
@@ -1761,6 +1761,80 @@ cdef void push_cb(ldms_t _t, ldms_set_t _s, int flags, void *arg) with gil:
         s._push_cb(s, flags, s._push_cb_arg)
 
 
+# Bulk lookup/update (see `BulkOp`). The bulk callbacks run on the transport
+# threads without acquiring the GIL. A completed entry is appended to the ring
+# of its `bulk_s`; the Python side is woken once per batch through the
+# condition variable, or through the eventfd when used with asyncio.
+cdef enum:
+    BULK_LOOKUP = 0
+    BULK_UPDATE = 1
+    # BulkOp.__dealloc__() gives up on the requests in flight after this many
+    # seconds, or as soon as the transport is disconnected
+    BULK_DEALLOC_TIMEOUT = 10
+
+cdef struct bulk_ent:
+    void *bulk          # the owning bulk_s
+    int idx
+    int status
+    int flags
+    ldms_set_t set
+
+cdef struct bulk_s:
+    pthread_mutex_t mutex
+    pthread_cond_t cond
+    int efd             # -1 if not used
+    int in_flight
+    int ring_head       # next ring slot to drain
+    int ring_tail       # next ring slot to fill
+    int *ring           # indices of the completed entries
+    int orphan          # the BulkOp is gone; the last completion frees this
+    bulk_ent *ents
+
+cdef void bulk_free(bulk_s *b) nogil:
+    if b.efd >= 0:
+        close(b.efd)
+    pthread_cond_destroy(&b.cond)
+    pthread_mutex_destroy(&b.mutex)
+    free(b.ents)
+    free(b.ring)
+    free(b)
+
+cdef void bulk_complete(bulk_ent *ent) nogil:
+    cdef bulk_s *b = <bulk_s*>ent.bulk
+    cdef uint64_t one = 1
+    cdef int last
+    pthread_mutex_lock(&b.mutex)
+    b.ring[b.ring_tail] = ent.idx
+    b.ring_tail += 1
+    b.in_flight -= 1
+    last = b.orphan and not b.in_flight
+    if b.efd >= 0:
+        write(b.efd, &one, sizeof(one))
+    pthread_cond_signal(&b.cond)
+    pthread_mutex_unlock(&b.mutex)
+    if last:
+        bulk_free(b)
+
+cdef void bulk_lookup_cb(ldms_t _x, ldms_lookup_status status, int more,
+                         ldms_set_t s, void *arg) except * nogil:
+    cdef bulk_ent *ent = <bulk_ent*>arg
+    if status and not ent.status:
+        ent.status = status
+    if s and not ent.set:
+        ent.set = s
+    if not more:
+        bulk_complete(ent)
+
+cdef void bulk_update_cb(ldms_t _t, ldms_set_t _s, int flags,
+                         void *arg) except * nogil:
+    cdef bulk_ent *ent = <bulk_ent*>arg
+    if 0 != (flags & LDMS_UPD_F_MORE):
+        return
+    ent.flags = flags
+    ent.status = LDMS_UPD_ERROR(flags)
+    bulk_complete(ent)
+
+
 MetricTemplateBase = namedtuple('MetricTemplateBase',
                                 [ 'name', 'type', 'count', 'flags',
                                   'units', 'rec_def' ])
@@ -3775,6 +3849,39 @@ cdef class Xprt(object):
             return slist[0]
         raise KeyError("Set not found")
 
+    def lookup_many(self, names, int window=64, int batch=256,
+                    bint use_eventfd=False):
+        """X.lookup_many(names, window=64, batch=256) -> BulkOp
+
+        Look up the sets by instance names, keeping at most `window` lookups
+        in flight. Iterating the returned BulkOp yields lists of at most
+        `batch` tuples (name, Set or None, status) in completion order. The
+        waiting is done without the GIL and the lookup callbacks do not
+        acquire it.
+
+        Example:
+        >>> for batch in x.lookup_many(names):
+        ...     for name, lset, status in batch:
+        ...         ...
+
+        See `ovis_ldms.ldms_aio` for use with asyncio (`use_eventfd=True`).
+        """
+        return BulkOp(self, [ STR(n) for n in names ], BULK_LOOKUP,
+                      window, batch, use_eventfd)
+
+    def update_many(self, sets, int window=64, int batch=256,
+                    bint use_eventfd=False):
+        """X.update_many(sets, window=64, batch=256) -> BulkOp
+
+        Update the given sets, keeping at most `window` updates in flight.
+        Iterating the returned BulkOp yields lists of at most `batch` tuples
+        (Set, status, flags) in completion order. A non-zero status is the
+        update error (see `Set.update()`). The waiting is done without the
+        GIL and the update callbacks do not acquire it.
+        """
+        return BulkOp(self, list(sets), BULK_UPDATE, window, batch,
+                      use_eventfd)
+
     def send(self, bytes data):
         """X.send(bytes) - send data to peer"""
         cdef int rc
@@ -4136,6 +4243,203 @@ cdef class Xprt(object):
         return ldms_xprt_peer_msg_is_enabled(self.xprt)
 
 
+cdef class BulkOp(object):
+    """Windowed bulk lookup or update
+
+    A BulkOp is created by `Xprt.lookup_many()` or `Xprt.update_many()`. It
+    keeps at most `window` requests in flight. The completions are collected
+    by callbacks that do not take the GIL, and are handed to Python in
+    batches.
+
+    Iterating a BulkOp yields lists of results in completion order, waiting
+    for completions with the GIL released:
+    - lookup: (name, Set or None, status)
+    - update: (Set, status, flags)
+
+    For asyncio, create the BulkOp with `use_eventfd=True` and use the
+    `ovis_ldms.ldms_aio` module, or drive it with `fileno()` and `poll()`.
+
+    Deleting a BulkOp with requests in flight waits for them while the
+    transport is connected, for at most 10 seconds; the results of the
+    requests completing later are discarded.
+    """
+    cdef bulk_s *b
+    cdef Xprt x
+    cdef list objs
+    cdef int op
+    cdef int window
+    cdef int batch
+    cdef int n_issued
+    cdef int n_drained
+
+    def __cinit__(self, Xprt x, list objs, int op, int window=64,
+                  int batch=256, bint use_eventfd=False):
+        cdef int i, n = len(objs)
+        if window < 1:
+            raise ValueError("window must be greater than 0")
+        self.b = NULL
+        self.x = x
+        self.objs = objs
+        self.op = op
+        self.window = window
+        self.batch = batch if batch > 0 else n
+        self.n_issued = 0
+        self.n_drained = 0
+        self.b = <bulk_s*>calloc(1, sizeof(bulk_s))
+        if not self.b:
+            raise MemoryError()
+        self.b.efd = -1
+        pthread_mutex_init(&self.b.mutex, NULL)
+        pthread_cond_init(&self.b.cond, NULL)
+        self.b.ents = <bulk_ent*>calloc(n + 1, sizeof(bulk_ent))
+        self.b.ring = <int*>calloc(n + 1, sizeof(int))
+        if not self.b.ents or not self.b.ring:
+            raise MemoryError()
+        for i in range(n):
+            self.b.ents[i].bulk = self.b
+            self.b.ents[i].idx = i
+        if use_eventfd:
+            self.b.efd = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC)
+            if self.b.efd < 0:
+                raise OSError(errno, "eventfd() error: {}".format(ERRNO_SYM(errno)))
+
+    def __dealloc__(self):
+        cdef bulk_s *b = self.b
+        cdef ldms_t xprt = self.x.xprt if self.x is not None else NULL
+        cdef timespec ts
+        cdef int in_flight, secs = 0
+        if not b:
+            return
+        self.b = NULL
+        # The callbacks reference `b`; wait for the outstanding requests
+        # while the transport is connected, but not forever. If some are
+        # still in flight, leave `b` to be freed by the last completion.
+        with nogil:
+            pthread_mutex_lock(&b.mutex)
+            while b.in_flight and secs < BULK_DEALLOC_TIMEOUT and \
+                  xprt and ldms_xprt_connected(xprt):
+                # wake up every second to check the transport
+                clock_gettime(CLOCK_REALTIME, &ts)
+                ts.tv_sec += 1
+                if ETIMEDOUT == pthread_cond_timedwait(&b.cond, &b.mutex, &ts):
+                    secs += 1
+            in_flight = b.in_flight
+            if in_flight:
+                b.orphan = 1
+            pthread_mutex_unlock(&b.mutex)
+        if not in_flight:
+            bulk_free(b)
+
+    def __len__(self):
+        return len(self.objs)
+
+    @property
+    def done(self):
+        """True if all results have been drained"""
+        return self.n_drained == len(self.objs)
+
+    def fileno(self):
+        """The eventfd that becomes readable on completions"""
+        if self.b.efd < 0:
+            raise ValueError("BulkOp was created without use_eventfd")
+        return self.b.efd
+
+    def issue(self):
+        """B.issue() - issue requests until the window is full
+
+        Returns the number of requests issued.
+        """
+        cdef int rc, n = 0
+        cdef int total = len(self.objs)
+        cdef bulk_ent *ent
+        cdef Set s
+        while self.n_issued < total:
+            pthread_mutex_lock(&self.b.mutex)
+            if self.b.in_flight >= self.window:
+                pthread_mutex_unlock(&self.b.mutex)
+                break
+            self.b.in_flight += 1
+            pthread_mutex_unlock(&self.b.mutex)
+            ent = &self.b.ents[self.n_issued]
+            obj = self.objs[self.n_issued]
+            self.n_issued += 1
+            if self.op == BULK_LOOKUP:
+                rc = ldms_xprt_lookup(self.x.xprt, BYTES(obj),
+                                      LDMS_LOOKUP_BY_INSTANCE,
+                                      bulk_lookup_cb, <void*>ent)
+            else:
+                s = <Set>obj
+                rc = ldms_xprt_update(s.rbd, bulk_update_cb, <void*>ent)
+            if rc:
+                # synchronous error, complete it with the error status
+                ent.status = rc
+                bulk_complete(ent)
+            n += 1
+        return n
+
+    cdef list _drain(self, int want):
+        # Wait (without the GIL) for at least `want` undrained completions,
+        # then convert all of the available ones.
+        cdef bulk_s *b = self.b
+        cdef int i, head, tail
+        cdef bulk_ent *ent
+        cdef Set s
+        with nogil:
+            pthread_mutex_lock(&b.mutex)
+            while b.ring_tail - b.ring_head < want:
+                pthread_cond_wait(&b.cond, &b.mutex)
+            head = b.ring_head
+            tail = b.ring_tail
+            b.ring_head = tail
+            pthread_mutex_unlock(&b.mutex)
+        out = list()
+        for i in range(head, tail):
+            ent = &b.ents[b.ring[i]]
+            obj = self.objs[ent.idx]
+            if self.op == BULK_LOOKUP:
+                lset = None
+                if ent.set:
+                    # the reference dropped by Set.__del__()
+                    ldms_set_ref_get(ent.set, "__ldms_find_local_set")
+                    lset = Set(None, None, set_ptr=PTR(ent.set))
+                    ent.set = NULL
+                out.append((obj, lset, ent.status))
+            else:
+                s = <Set>obj
+                s._update_rc = ent.status
+                out.append((s, ent.status, ent.flags))
+        self.n_drained += tail - head
+        return out
+
+    def poll(self):
+        """B.poll() -> list
+
+        Non-blocking: clear the eventfd (if any), issue requests to fill the
+        window, and return the results completed so far (possibly empty).
+        """
+        cdef uint64_t cnt
+        if self.b.efd >= 0:
+            read(self.b.efd, &cnt, sizeof(cnt))
+        self.issue()
+        return self._drain(0)
+
+    def __iter__(self):
+        cdef int total = len(self.objs)
+        cdef int want, outstanding
+        pending = list()
+        while self.n_drained < total:
+            self.issue()
+            # Wake up when half of the window (or the rest of the batch) has
+            # completed so that the other half stays in flight.
+            outstanding = self.n_issued - self.n_drained
+            want = min(self.batch - len(pending), (self.window + 1) // 2,
+                       outstanding)
+            pending.extend(self._drain(max(want, 1)))
+            if len(pending) >= self.batch or self.n_drained == total:
+                yield pending
+                pending = list()
+
+
 cdef class _MsgSubCtxt(object):
     """For internal use"""
     cdef object cb
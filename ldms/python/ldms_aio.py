@@ -0,0 +1,105 @@
+# Copyright (c) 2026 Open Grid Computing, Inc. All rights reserved.
+# Copyright (c) 2026 NTESS Corporation. All rights reserved.
+# Under the terms of Contract DE-AC04-94AL85000, there is a non-exclusive
+# license for use of this work by or on behalf of the U.S. Government.
+# Export of this program may require a license from the United States
+# Government.
+#
+# This software is available to you under a choice of one of two
+# licenses.  You may choose to be licensed under the terms of the GNU
+# General Public License (GPL) Version 2, available from the file
+# COPYING in the main directory of this source tree, or the BSD-type
+# license below:
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#
+#      Redistributions of source code must retain the above copyright
+#      notice, this list of conditions and the following disclaimer.
+#
+#      Redistributions in binary form must reproduce the above
+#      copyright notice, this list of conditions and the following
+#      disclaimer in the documentation and/or other materials provided
+#      with the distribution.
+#
+#      Neither the name of NTESS Corporation, Open Grid Computing nor
+#      the names of any contributors may be used to endorse or promote
+#      products derived from this software without specific prior
+#      written permission.
+#
+#      Modified source versions must be plainly marked as such, and
+#      must not be misrepresented as being the original software.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+"""asyncio adapter for the LDMS bulk operations
+
+The bulk operations (`Xprt.lookup_many()`, `Xprt.update_many()`) complete in
+callbacks that never take the GIL. With `use_eventfd=True` each completion
+also signals an eventfd. This module registers that eventfd with the running
+asyncio loop so a coroutine is resumed once per wakeup and collects all of
+the results completed by then, instead of having the GIL acquired for every
+callback.
+
+Example:
+```
+from ovis_ldms import ldms, ldms_aio
+
+async def main(x, names):
+    sets = []
+    async for batch in ldms_aio.lookup_many(x, names):
+        sets.extend(s for name, s, status in batch if not status)
+    async for batch in ldms_aio.update_many(x, sets):
+        for s, status, flags in batch:
+            ...
+```
+The transport connect/dir calls are still the blocking/callback ones of the
+`ldms` module; run them before entering the loop or in an executor.
+"""
+
+import asyncio
+from ovis_ldms import ldms
+
+async def bulk_results(op):
+    """Asynchronously iterate the result batches of a BulkOp
+
+    The BulkOp must be created with `use_eventfd=True`. A yielded batch is
+    the list of the results completed since the previous one; it is never
+    empty.
+    """
+    loop = asyncio.get_running_loop()
+    wakeup = asyncio.Event()
+    fd = op.fileno()
+    loop.add_reader(fd, wakeup.set)
+    try:
+        while True:
+            wakeup.clear()
+            batch = op.poll()
+            if batch:
+                yield batch
+            if op.done:
+                break
+            await wakeup.wait()
+    finally:
+        loop.remove_reader(fd)
+
+def lookup_many(xprt, names, window=64):
+    """Asynchronous `Xprt.lookup_many()`; yields lists of (name, Set, status)"""
+    return bulk_results(xprt.lookup_many(names, window=window,
+                                         use_eventfd=True))
+
+def update_many(xprt, sets, window=64):
+    """Asynchronous `Xprt.update_many()`; yields lists of (Set, status, flags)"""
+    return bulk_results(xprt.update_many(sets, window=window,
+                                         use_eventfd=True))
@@ -68,7 +68,7 @@ LDMSD_CTRL_CMD_MAP = {'usage': {'req_attr': [], 'opt_attr': ['name']},
                       'config': {'req_attr': ['name']},
                       'source': {'req_attr': ['path'], 'opt_attr':[]},
                       'start': {'req_attr': ['name', 'interval'],
-                                'opt_attr': ['offset', 'exclusive_thread']},
+                                'opt_attr': ['offset', 'exclusive_thread', 'group']},
                       'stop': {'req_attr': ['name']},
                       'udata': {'req_attr': ['instance', 'metric', 'udata']},
                       'daemon_exit': {'req_attr': []},
@@ -167,6 +167,7 @@ LDMSD_CTRL_CMD_MAP = {'usage': {'req_attr': [], 'opt_attr': ['name']},
                       'log_status' : {'req_attr' : [], 'opt_attr' : ['name']},
                       'stats_reset' : {'req_attr' : [], 'opt_attr' : ['list']},
                       'profiling' : {'req_attr' : [], 'opt_attr' : ['enable', 'reset']},
+                      'latency_stats' : {'req_attr' : [], 'opt_attr' : ['name', 'type', 'reset']},
                       ##### Failover. #####
                       'failover_config': {
                                 'req_attr': [
@@ -179,6 +180,7 @@ LDMSD_CTRL_CMD_MAP = {'usage': {'req_attr': [], 'opt_attr': ['name']},
                                     'peer_name',
                                     'auto_switch',
                                     'timeout_factor',
+                                    'standby',
                                 ]
                             },
                       'failover_mod': {'req_attr': [], 'opt_attr': ['auto_switch']},
@@ -347,7 +349,10 @@ class LDMSD_Req_Attr(object):
     RESET_INTERVAL = 47
     XTHREAD = 48
     MSG_CHAN = 49
-    LAST = 50
+    FORMAT = 50
+    STANDBY = 51
+    GROUP = 52
+    LAST = 53
 
     NAME_ID_MAP = {'name': NAME,
                    'interval': INTERVAL,
@@ -406,6 +411,9 @@ class LDMSD_Req_Attr(object):
                    'reset_interval': RESET_INTERVAL,
                    'exclusive_thread': XTHREAD,
                    'message_channel': MSG_CHAN,
+                   'format': FORMAT,
+                   'standby': STANDBY,
+                   'group': GROUP,
                    'TERMINATING': LAST
         }
 
@@ -457,6 +465,9 @@ class LDMSD_Req_Attr(object):
                    RESET_INTERVAL : 'reset_interval',
                    XTHREAD : 'exclusive_thread',
                    MSG_CHAN : 'message_channel',
+                   FORMAT : 'format',
+                   STANDBY : 'standby',
+                   GROUP : 'group',
                    LAST : 'TERMINATING'
         }
 
@@ -639,6 +650,7 @@ class LDMSD_Request(object):
     # IDs 0x600 + 22 to 0x600 + 30 are reserved to match command-line options handlers
     # defined in ldmsd_request.h. These must stay in sync with the C implementation.
     PROFILING = 0x600 + 31
+    LATENCY_STATS = 0x600 + 32
 
     FAILOVER_CONFIG        = 0x700
     FAILOVER_PEERCFG_START = 0x700  +  1
@@ -757,6 +769,7 @@ class LDMSD_Request(object):
             'failover_stop'          : {'id' : FAILOVER_STOP},
             'xprt_stats'    :  {'id' : XPRT_STATS},
             'profiling'    :  {'id' : PROFILING},
+            'latency_stats' :  {'id' : LATENCY_STATS},
             'thread_stats'  :  {'id' : THREAD_STATS},
             'prdcr_stats'   :  {'id' : PRDCR_STATS},
             'set_stats'     :  {'id' : SET_STATS},
@@ -1229,11 +1242,12 @@ class Communicator(object):
         except Exception as e:
             return str(e)
 
-    def failover_config(self, host, xprt, port, auto_switch=None, interval=None, timeout_factor=None, peer_name=None):
+    def failover_config(self, host, xprt, port, auto_switch=None, interval=None, timeout_factor=None, peer_name=None, standby=None):
         """
         Start LDMSD failover service
         NOTE: After failover service has started, aggregator configuration objects
-        (prdcr, updtr, and strgp) are not allowed to be altered (start, stop or reconfigure).
+        (prdcr, updtr, and strgp) can only be added, deleted, started or stopped
+        by name; the objects replicated from the peer ('#' names) cannot be altered.
 
         Parameters:
         host             - host name of the failover partner
@@ -1244,6 +1258,8 @@ class Communicator(object):
         [timeout_factor] - The heartbeat timeout factor
         [peer_name]      - The failover partner name. If not given,
                            the ldmsd will accept any partner
+        [standby]        - 0|1 Keep the peer producers connected before
+                           a failover
 
         Returns:
         - status is an errno from the errno module
@@ -1261,6 +1277,8 @@ class Communicator(object):
             attr_list.append(LDMSD_Req_Attr(attr_id=LDMSD_Req_Attr.TIMEOUT_FACTOR, value=timeout_factor))
         if peer_name:
             attr_list.append(LDMSD_Req_Attr(attr_id=LDMSD_Req_Attr.PEER_NAME, value=peer_name))
+        if standby:
+            attr_list.append(LDMSD_Req_Attr(attr_id=LDMSD_Req_Attr.STANDBY, value=standby))
         req = LDMSD_Request(command_id=LDMSD_Request.FAILOVER_CONFIG, attrs=attr_list)
         try:
             req.send(self)
@@ -2193,7 +2211,8 @@ class Communicator(object):
             self.close()
             return errno.ENOTCONN, str(e)
 
-    def plugn_start(self, name, interval_us, offset_us=None, xthread=None):
+    def plugn_start(self, name, interval_us, offset_us=None, xthread=None,
+                    group=None):
         # If offset unspecified, start in non-synchronous mode
         req_attrs = [ LDMSD_Req_Attr(attr_id=LDMSD_Req_Attr.NAME, value=name),
                       LDMSD_Req_Attr(attr_id=LDMSD_Req_Attr.INTERVAL, value=str(interval_us))
@@ -2203,6 +2222,9 @@ class Communicator(object):
         if xthread is not None:
             req_attrs.append(LDMSD_Req_Attr(attr_id=LDMSD_Req_Attr.XTHREAD,
                                             value=str(xthread)))
+        if group is not None:
+            req_attrs.append(LDMSD_Req_Attr(attr_id=LDMSD_Req_Attr.GROUP,
+                                            value=group))
         req = LDMSD_Request(
                 command_id = LDMSD_Request.PLUGN_START,
                 attrs=req_attrs
@@ -3488,6 +3510,42 @@ class Communicator(object):
             self.close()
             return errno.ENOTCONN, str(e)
 
+    def latency_stats(self, name=None, type=None, reset=False):
+        """
+        Query the per-operation latency histograms of producers,
+        updaters and storage policies
+
+        Parameters:
+        name  - Report only the objects with this name
+        type  - Report only one object type: prdcr, updtr, or strgp
+        reset - If True, reset the histograms after reporting them
+
+        Returns:
+        A tuple of status, data
+        - status is an errno from the errno module
+        - data is the latency histograms in JSON, or an error msg
+          if status != 0
+        """
+        if reset is None:
+            reset = False
+        attrs = [ LDMSD_Req_Attr(attr_id=LDMSD_Req_Attr.RESET,
+                                 value=str(reset)) ]
+        if name:
+            attrs.append(LDMSD_Req_Attr(attr_id=LDMSD_Req_Attr.NAME,
+                                        value=name))
+        if type:
+            attrs.append(LDMSD_Req_Attr(attr_id=LDMSD_Req_Attr.TYPE,
+                                        value=type))
+        req = LDMSD_Request(command_id=LDMSD_Request.LATENCY_STATS,
+                            attrs=attrs)
+        try:
+            req.send(self)
+            resp = req.receive(self)
+            return resp['errcode'], resp['msg']
+        except Exception as e:
+            self.close()
+            return errno.ENOTCONN, str(e)
+
     def thread_stats(self, reset=False):
         """Query the daemon's I/O thread utilization data"""
         if reset is None:
@@ -0,0 +1,139 @@
+#!/usr/bin/python3
+#
+# SYNOPSIS
+# --------
+#   ./bench.py [-x XPRT] [-p PORT] [-h HOST] [-n NUM_SETS] [-w WINDOW]
+#              [-r ROUNDS] [-m {all,serial,bulk,aio}]
+#
+# DESCRIPTIONS
+# ------------
+# Benchmark the bulk lookup/update calls against a running ldmsd (e.g. a local
+# sock daemon with the test_sampler plugin providing a few thousand sets).
+# The script looks up and updates NUM_SETS sets (all sets if 0) in three ways
+# and prints the elapsed time and the rate of each:
+#   - serial: blocking `Xprt.lookup()` / `Set.update()` one set at a time,
+#   - bulk:   `Xprt.lookup_many()` / `Xprt.update_many()`,
+#   - aio:    `ldms_aio.lookup_many()` / `ldms_aio.update_many()` on an
+#             asyncio loop.
+# Each mode runs in its own process (the looked up sets stay in the process).
+#
+# Example:
+#   ldmsd -x sock:10001 -c samp.conf   # samp.conf creates many sets
+#   ./bench.py -p 10001 -n 5000
+
+import sys
+import time
+import subprocess as sp
+import socket
+import asyncio
+import logging
+import argparse as ap
+from ovis_ldms import ldms, ldms_aio
+
+if __name__ != "__main__":
+    raise RuntimeError("This is not a module.")
+
+logging.basicConfig(level=logging.INFO, datefmt="%F %T",
+        format="%(asctime)s.%(msecs)d %(levelname)s %(name)s %(message)s")
+
+log = logging.getLogger()
+
+psr = ap.ArgumentParser(description="LDMS Python bulk operation benchmark",
+                        add_help=False)
+psr.add_argument("-x", "--xprt", default="sock",
+                 help="Transport type (default: sock)")
+psr.add_argument("-p", "--port", default="10001",
+                 help="Port to connect (default: 10001)")
+psr.add_argument("-h", "--host", default=socket.gethostname(),
+                 help="Host to connect (default: ${HOSTNAME})")
+psr.add_argument("-n", "--num-sets", default=0, type=int,
+                 help="The number of sets to use (default: 0, all sets)")
+psr.add_argument("-w", "--window", default=64, type=int,
+                 help="Bulk operation window (default: 64)")
+psr.add_argument("-r", "--rounds", default=3, type=int,
+                 help="The number of update rounds (default: 3)")
+psr.add_argument("-m", "--mode", default="all",
+                 choices=["all", "serial", "bulk", "aio"],
+                 help="The benchmark to run (default: all)")
+psr.add_argument("-?", "--help", action="help",
+                 help="Show help message")
+g = psr.parse_args()
+
+ldms.init(1024*1024*1024)
+
+def connect():
+    x = ldms.Xprt(name=g.xprt)
+    x.connect(host=g.host, port=g.port)
+    return x
+
+def report(name, n, t0, t1):
+    dt = t1 - t0
+    rate = n / dt if dt > 0 else float("inf")
+    log.info("{:<14} {:>8} sets {:>10.4f} s {:>12.1f} sets/s" \
+             .format(name, n, dt, rate))
+
+if g.mode == "all":
+    for m in [ "serial", "bulk", "aio" ]:
+        sp.run([ sys.executable, sys.argv[0] ] + sys.argv[1:] + [ "-m", m ],
+               check=True)
+    sys.exit(0)
+
+x = connect()
+names = [ d.name for d in x.dir() ]
+if g.num_sets:
+    names = names[:g.num_sets]
+log.info("{}: {} sets, window {}".format(g.mode, len(names), g.window))
+
+def serial_bench():
+    t0 = time.time()
+    sets = [ x.lookup(n) for n in names ]
+    t1 = time.time()
+    report("serial lookup", len(sets), t0, t1)
+    t0 = time.time()
+    for r in range(g.rounds):
+        for s in sets:
+            s.update()
+    t1 = time.time()
+    report("serial update", len(sets) * g.rounds, t0, t1)
+
+def bulk_bench():
+    t0 = time.time()
+    sets = list()
+    for batch in x.lookup_many(names, window=g.window):
+        sets.extend(s for name, s, status in batch if not status)
+    t1 = time.time()
+    report("bulk lookup", len(sets), t0, t1)
+    t0 = time.time()
+    nerr = 0
+    for r in range(g.rounds):
+        for batch in x.update_many(sets, window=g.window):
+            nerr += sum(1 for s, status, flags in batch if status)
+    t1 = time.time()
+    report("bulk update", len(sets) * g.rounds, t0, t1)
+    if nerr:
+        log.warning("bulk update: {} errors".format(nerr))
+
+async def aio_bench():
+    t0 = time.time()
+    sets = list()
+    async for batch in ldms_aio.lookup_many(x, names, window=g.window):
+        sets.extend(s for name, s, status in batch if not status)
+    t1 = time.time()
+    report("aio lookup", len(sets), t0, t1)
+    t0 = time.time()
+    nerr = 0
+    for r in range(g.rounds):
+        async for batch in ldms_aio.update_many(x, sets, window=g.window):
+            nerr += sum(1 for s, status, flags in batch if status)
+    t1 = time.time()
+    report("aio update", len(sets) * g.rounds, t0, t1)
+    if nerr:
+        log.warning("aio update: {} errors".format(nerr))
+
+if g.mode == "serial":
+    serial_bench()
+elif g.mode == "bulk":
+    bulk_bench()
+else:
+    asyncio.run(aio_bench())
+x.close()
@@ -75,6 +75,7 @@
 #include "ldms_heap.h"
 #include "ldms_private.h"
 #include "coll/rbt.h"
+#include "coll/fnv_hash.h"
 
 ovis_log_t xlog;
 
@@ -224,12 +225,144 @@ static int id_comparator(void *a, const void *b)
 	return 0;
 }
 
-static struct rbt __id_tree = {
-	.root = NULL,
-	.comparator = id_comparator
+static pthread_mutex_t __set_tree_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Name and set_id lookups go through a sharded hash index instead of
+ * __set_tree. Each shard has its own rwlock, so lookups only contend
+ * with inserts/deletes that hash to the same shard and never with each
+ * other. __set_tree is still maintained under __set_tree_lock for the
+ * ordered iteration used by dir and regex lookup.
+ *
+ * The low bits of the key (name hash or set_id) select the shard, the
+ * next bits select the bucket. Buckets double when a shard's chains
+ * get long.
+ *
+ * Lock order: __set_tree_lock, then a shard lock.
+ */
+#define LDMS_SET_SHARD_BITS 6
+#define LDMS_SET_SHARDS (1 << LDMS_SET_SHARD_BITS)
+#define LDMS_SET_SHARD_DEPTH 16	/* initial buckets per shard */
+
+struct __set_htbl {
+	size_t count;
+	size_t mask;
+	struct ldms_set **bkt;
 };
 
-static pthread_mutex_t __set_tree_lock = PTHREAD_MUTEX_INITIALIZER;
+struct __set_shard {
+	pthread_rwlock_t lock;
+	struct __set_htbl name_tbl;
+	struct __set_htbl id_tbl;
+} __attribute__((aligned(64)));
+
+static struct __set_shard __set_shards[LDMS_SET_SHARDS];
+
+#define __SET_HNEXT(_s_, _by_id_) \
+	(*((_by_id_) ? &(_s_)->id_hnext : &(_s_)->name_hnext))
+#define __SET_HKEY(_s_, _by_id_) \
+	((_by_id_) ? (_s_)->set_id : (_s_)->name_hash)
+#define __SET_BKT(_t_, _key_) \
+	(((_key_) >> LDMS_SET_SHARD_BITS) & (_t_)->mask)
+
+static inline uint64_t __set_name_hash(const char *name)
+{
+	return fnv_hash_a1_64(name, strlen(name), FNV_64_OFFSET_BASIS);
+}
+
+static inline struct __set_shard *__set_shard(uint64_t key)
+{
+	return &__set_shards[key & (LDMS_SET_SHARDS - 1)];
+}
+
+static void __attribute__ ((constructor)) __set_shards_init(void)
+{
+	int i;
+	struct __set_shard *sh;
+	for (i = 0; i < LDMS_SET_SHARDS; i++) {
+		sh = &__set_shards[i];
+		pthread_rwlock_init(&sh->lock, NULL);
+		sh->name_tbl.mask = sh->id_tbl.mask = LDMS_SET_SHARD_DEPTH - 1;
+		sh->name_tbl.bkt = calloc(LDMS_SET_SHARD_DEPTH, sizeof(void *));
+		sh->id_tbl.bkt = calloc(LDMS_SET_SHARD_DEPTH, sizeof(void *));
+		assert(sh->name_tbl.bkt && sh->id_tbl.bkt);
+	}
+}
+
+/* Caller must hold the shard write lock */
+static void __set_htbl_ins(struct __set_htbl *t, struct ldms_set *set, int by_id)
+{
+	struct ldms_set **bkt, *s, *n;
+	size_t i, mask;
+
+	if (t->count > 2 * (t->mask + 1)) {
+		/* Double the buckets. On ENOMEM just keep the long chains. */
+		mask = (t->mask << 1) | 1;
+		bkt = calloc(mask + 1, sizeof(*bkt));
+		if (bkt) {
+			for (i = 0; i <= t->mask; i++) {
+				for (s = t->bkt[i]; s; s = n) {
+					n = __SET_HNEXT(s, by_id);
+					__SET_HNEXT(s, by_id) = bkt[(__SET_HKEY(s, by_id) >> LDMS_SET_SHARD_BITS) & mask];
+					bkt[(__SET_HKEY(s, by_id) >> LDMS_SET_SHARD_BITS) & mask] = s;
+				}
+			}
+			free(t->bkt);
+			t->bkt = bkt;
+			t->mask = mask;
+		}
+	}
+	i = __SET_BKT(t, __SET_HKEY(set, by_id));
+	__SET_HNEXT(set, by_id) = t->bkt[i];
+	t->bkt[i] = set;
+	t->count++;
+}
+
+/* Caller must hold the shard write lock */
+static void __set_htbl_del(struct __set_htbl *t, struct ldms_set *set, int by_id)
+{
+	struct ldms_set **pp;
+
+	pp = &t->bkt[__SET_BKT(t, __SET_HKEY(set, by_id))];
+	while (*pp && *pp != set)
+		pp = &__SET_HNEXT(*pp, by_id);
+	if (!*pp)
+		return;
+	*pp = __SET_HNEXT(set, by_id);
+	t->count--;
+}
+
+/* Caller must hold the set tree lock */
+static void __set_index_ins(struct ldms_set *set)
+{
+	struct __set_shard *sh;
+
+	sh = __set_shard(set->name_hash);
+	pthread_rwlock_wrlock(&sh->lock);
+	__set_htbl_ins(&sh->name_tbl, set, 0);
+	pthread_rwlock_unlock(&sh->lock);
+
+	sh = __set_shard(set->set_id);
+	pthread_rwlock_wrlock(&sh->lock);
+	__set_htbl_ins(&sh->id_tbl, set, 1);
+	pthread_rwlock_unlock(&sh->lock);
+}
+
+/* Caller must hold the set tree lock */
+static void __set_index_del(struct ldms_set *set)
+{
+	struct __set_shard *sh;
+
+	sh = __set_shard(set->name_hash);
+	pthread_rwlock_wrlock(&sh->lock);
+	__set_htbl_del(&sh->name_tbl, set, 0);
+	pthread_rwlock_unlock(&sh->lock);
+
+	sh = __set_shard(set->set_id);
+	pthread_rwlock_wrlock(&sh->lock);
+	__set_htbl_del(&sh->id_tbl, set, 1);
+	pthread_rwlock_unlock(&sh->lock);
+}
 
 static struct rbt __del_tree = {
 	.root = NULL,
@@ -258,17 +391,25 @@ void __ldms_gn_inc(struct ldms_set *set, ldms_mdesc_t desc)
 	}
 }
 
-/* Caller must hold the ldms set tree lock. */
+/*
+ * Returns the set with a reference taken. The set tree lock is not
+ * required; the lookup only takes the shard read lock.
+ */
 struct ldms_set *__ldms_find_local_set(const char *set_name)
 {
-	struct rbn *z;
-	struct ldms_set *s = NULL;
+	struct ldms_set *s;
+	uint64_t h = __set_name_hash(set_name);
+	struct __set_shard *sh = __set_shard(h);
 
-	z = rbt_find(&__set_tree, (void *)set_name);
-	if (z) {
-		s = container_of(z, struct ldms_set, rb_node);
-		ref_get(&s->ref, __func__);
+	pthread_rwlock_rdlock(&sh->lock);
+	for (s = sh->name_tbl.bkt[__SET_BKT(&sh->name_tbl, h)]; s; s = s->name_hnext) {
+		if (s->name_hash == h &&
+		    0 == strcmp(get_instance_name(s->meta)->name, set_name)) {
+			ref_get(&s->ref, __func__);
+			break;
+		}
 	}
+	pthread_rwlock_unlock(&sh->lock);
 	return s;
 }
 
@@ -305,11 +446,7 @@ void __ldms_set_tree_unlock()
 
 ldms_set_t ldms_set_by_name(const char *set_name)
 {
-	struct ldms_set *set;
-	__ldms_set_tree_lock();
-	set = __ldms_find_local_set(set_name);
-	__ldms_set_tree_unlock();
-	return set;
+	return __ldms_find_local_set(set_name);
 }
 
 struct set_mode {
@@ -626,9 +763,7 @@ __record_set(const char *instance_name,
 	zap_err_t zerr;
 	size_t sz;
 
-	__ldms_set_tree_lock();
 	set = __ldms_find_local_set(instance_name);
-	__ldms_set_tree_unlock();
 	if (set) {
 		ref_put(&set->ref, "__ldms_find_local_set");
 		errno = EEXIST;
@@ -642,6 +777,7 @@ __record_set(const char *instance_name,
 	}
 	LIST_INIT(&set->local_info);
 	LIST_INIT(&set->remote_info);
+	LIST_INIT(&set->retired);
 	rbt_init(&set->push_coll, rbn_ptr_cmp);
 	rbt_init(&set->lookup_coll, rbn_ptr_cmp);
 	pthread_mutex_init(&set->lock, NULL);
@@ -661,7 +797,7 @@ __record_set(const char *instance_name,
 
 	ref_init(&set->ref, __func__, __destroy_set, set);
 	rbn_init(&set->rb_node, get_instance_name(set->meta)->name);
-	rbn_init(&set->id_node, (void *)set->set_id);
+	set->name_hash = __set_name_hash(get_instance_name(set->meta)->name);
 
 	__ldms_set_tree_lock();
 	/* Check if we lost a race creating this same set name */
@@ -674,7 +810,7 @@ __record_set(const char *instance_name,
 		goto unlock_set_tree;
 	}
 	rbt_ins(&__set_tree, &set->rb_node);
-	rbt_ins(&__id_tree, &set->id_node);
+	__set_index_ins(set);
 
  unlock_set_tree:
 	__ldms_set_tree_unlock();
@@ -687,15 +823,20 @@ __record_set(const char *instance_name,
 }
 
 /**
- * Callers must hold the set_tree lock
+ * Look up a local set by set_id. No reference is taken; the set tree
+ * lock is not required.
  */
 extern struct ldms_set *__ldms_set_by_id(uint64_t id)
 {
-	struct ldms_set *set = NULL;
-	struct rbn *rbn;
-	rbn = rbt_find(&__id_tree, (void *)id);
-	if (rbn)
-		set = container_of(rbn, struct ldms_set, id_node);
+	struct ldms_set *set;
+	struct __set_shard *sh = __set_shard(id);
+
+	pthread_rwlock_rdlock(&sh->lock);
+	for (set = sh->id_tbl.bkt[__SET_BKT(&sh->id_tbl, id)]; set; set = set->id_hnext) {
+		if (set->set_id == id)
+			break;
+	}
+	pthread_rwlock_unlock(&sh->lock);
 	return set;
 }
 
@@ -899,6 +1040,7 @@ void __ldms_set_on_xprt_term(ldms_set_t set, ldms_t xprt)
 	if (rbn) {
 		rbt_del(&set->lookup_coll, rbn);
 		np = container_of(rbn, struct ldms_lookup_peer, rbn);
+		__ldms_set_retired_drop(set, xprt->conn_id, UINT32_MAX);
 	}
 	pthread_mutex_unlock(&set->lock);
 	if (pp) {
@@ -923,11 +1065,20 @@ void __ldms_set_info_delete(struct ldms_set_info_list *info)
 	}
 }
 
+static void __set_retired_free(struct ldms_set_retired *ret)
+{
+	zap_unmap(ret->lmap);
+	mm_free(ret->meta);
+	free(ret->peers);
+	free(ret);
+}
+
 static void __destroy_set_no_lock(void *v)
 {
 	struct ldms_set *set = v;
 	struct ldms_xprt *x = set->xprt;
 	struct ldms_context *ctxt;
+	struct ldms_set_retired *ret;
 	if (x) {
 		/*
 		 * Check if there any transports referencing this set
@@ -967,6 +1118,12 @@ static void __destroy_set_no_lock(void *v)
 	zap_unmap(set->lmap);
 	if (set->rmap)
 		zap_unmap(set->rmap);
+	if (set->resize.rmap)
+		zap_unmap(set->resize.rmap);
+	while ((ret = LIST_FIRST(&set->retired))) {
+		LIST_REMOVE(ret, entry);
+		__set_retired_free(ret);
+	}
 	free(set);
 }
 
@@ -993,7 +1150,7 @@ void __ldms_set_delete(ldms_set_t s, int notify)
 		return;
 	}
 	rbt_del(&__set_tree, &s->rb_node);
-	rbt_del(&__id_tree, &s->id_node);
+	__set_index_del(s);
 	__ldms_set_tree_unlock();
 
 	/* NOTE: We will clean up the push and lookup collections
@@ -1165,6 +1322,279 @@ uint32_t __ldms_set_size_get(struct ldms_set *s)
 		 (__le32_to_cpu(s->meta->data_sz)));
 }
 
+/* The retired memory is neither read by a peer nor written by a read */
+static int __set_retired_unused(struct ldms_set *s,
+				struct ldms_set_retired *ret)
+{
+	return !ret->n_peers && !__atomic_load_n(&s->read_cnt, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * Replace the memory of the set with \c meta. The old memory is kept
+ * mapped while the peers that have looked up the set may still read it
+ * with the old map, or while RDMA reads into it are in flight; see
+ * __ldms_set_retired_drop() and __ldms_set_read_end().
+ *
+ * The caller must hold the set lock.
+ */
+static int __set_mem_replace(struct ldms_set *s, struct ldms_set_hdr *meta)
+{
+	struct ldms_set_retired *ret;
+	struct ldms_lookup_peer *lp;
+	struct rbn *rbn;
+	zap_map_t lmap;
+	zap_err_t zerr;
+	size_t sz;
+	int n;
+
+	ret = calloc(1, sizeof(*ret));
+	if (!ret)
+		return ENOMEM;
+	n = 0;
+	RBT_FOREACH(rbn, &s->lookup_coll)
+		n++;
+	if (n) {
+		ret->peers = calloc(n, sizeof(*ret->peers));
+		if (!ret->peers) {
+			free(ret);
+			return ENOMEM;
+		}
+		RBT_FOREACH(rbn, &s->lookup_coll) {
+			lp = container_of(rbn, struct ldms_lookup_peer, rbn);
+			ret->peers[ret->n_peers++] = lp->xprt->conn_id;
+		}
+	}
+	sz = __le32_to_cpu(meta->meta_sz) +
+		__le32_to_cpu(meta->array_card) * __le32_to_cpu(meta->data_sz);
+	zerr = zap_map(&lmap, meta, sz, ZAP_ACCESS_READ | ZAP_ACCESS_WRITE);
+	if (zerr) {
+		free(ret->peers);
+		free(ret);
+		return ENOMEM;
+	}
+	ret->meta = s->meta;
+	ret->lmap = s->lmap;
+	ret->resize_gn = ++s->resize_gn;
+	if (__set_retired_unused(s, ret))
+		__set_retired_free(ret);
+	else
+		LIST_INSERT_HEAD(&s->retired, ret, entry);
+	s->meta = meta;
+	s->lmap = lmap;
+	s->data_array = (void *)meta + __le32_to_cpu(meta->meta_sz);
+	s->data = __set_array_get(s, s->curr_idx);
+	return 0;
+}
+
+/*
+ * The peer \c conn_id no longer reads the memory retired by the resizes up
+ * to \c resize_gn. Pass UINT32_MAX when the peer is gone. The memory that
+ * no peer reads any more is released.
+ *
+ * The caller must hold the set lock.
+ */
+void __ldms_set_retired_drop(struct ldms_set *s, uint64_t conn_id,
+			     uint32_t resize_gn)
+{
+	struct ldms_set_retired *ret, *next;
+	int i;
+
+	ret = LIST_FIRST(&s->retired);
+	while (ret) {
+		next = LIST_NEXT(ret, entry);
+		if (ret->resize_gn > resize_gn)
+			goto next;
+		for (i = 0; i < ret->n_peers; i++) {
+			if (ret->peers[i] != conn_id)
+				continue;
+			ret->peers[i] = ret->peers[--ret->n_peers];
+			break;
+		}
+		if (__set_retired_unused(s, ret)) {
+			LIST_REMOVE(ret, entry);
+			__set_retired_free(ret);
+		}
+	next:
+		ret = next;
+	}
+}
+
+/* An RDMA read into the memory of the mirror \c s is about to be posted */
+void __ldms_set_read_begin(struct ldms_set *s)
+{
+	__atomic_add_fetch(&s->read_cnt, 1, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * An RDMA read into the memory of \c s has completed or was not posted.
+ * With \c release, the memory retired while it was in flight is released
+ * once no read is left. The caller must not hold the set lock, nor the lock
+ * of a transport since the set lock is taken first elsewhere; without
+ * \c release, the memory is left to the next read completion.
+ */
+void __ldms_set_read_end(struct ldms_set *s, int release)
+{
+	struct ldms_set_retired *ret, *next;
+
+	if (__atomic_sub_fetch(&s->read_cnt, 1, __ATOMIC_SEQ_CST) || !release)
+		return;
+	pthread_mutex_lock(&s->lock);
+	ret = LIST_FIRST(&s->retired);
+	while (ret) {
+		next = LIST_NEXT(ret, entry);
+		if (__set_retired_unused(s, ret)) {
+			LIST_REMOVE(ret, entry);
+			__set_retired_free(ret);
+		}
+		ret = next;
+	}
+	pthread_mutex_unlock(&s->lock);
+}
+
+int ldms_set_heap_grow(ldms_set_t s, size_t heap_sz)
+{
+	struct ldms_set_hdr *meta, *old_meta;
+	struct ldms_data_hdr *dh, *old_dh;
+	struct ldms_heap_instance hinst;
+	size_t meta_sz, val_sz, data_sz, old_data_sz, old_heap_sz;
+	int i, n, rc = 0;
+
+	if (0 == (s->flags & LDMS_SET_F_LOCAL))
+		return EINVAL;
+	heap_sz = ldms_heap_size(heap_sz);
+
+	pthread_mutex_lock(&s->lock);
+	old_meta = s->meta;
+	old_heap_sz = __le32_to_cpu(old_meta->heap_sz);
+	if (!old_heap_sz) {
+		/* The set has no list or record to grow */
+		rc = EINVAL;
+		goto out;
+	}
+	if (heap_sz <= old_heap_sz)
+		goto out;
+	meta_sz = __le32_to_cpu(old_meta->meta_sz);
+	old_data_sz = __le32_to_cpu(old_meta->data_sz);
+	val_sz = old_data_sz - old_heap_sz;
+	data_sz = val_sz + heap_sz;
+	n = __le32_to_cpu(old_meta->array_card);
+	if (meta_sz + n * data_sz > UINT32_MAX) {
+		rc = EFBIG;
+		goto out;
+	}
+
+	meta = mm_alloc(meta_sz + n * data_sz);
+	if (!meta) {
+		rc = ENOMEM;
+		goto out;
+	}
+	memcpy(meta, old_meta, meta_sz);
+	meta->data_sz = __cpu_to_le32(data_sz);
+	meta->heap_sz = __cpu_to_le32(heap_sz);
+	LDMS_GN_INCREMENT(meta->meta_gn);
+
+	/*
+	 * The heap is addressed by offsets from its base, so copying each
+	 * array element and appending the new free space is enough.
+	 */
+	for (i = 0; i < n; i++) {
+		old_dh = (void *)old_meta + meta_sz + i * old_data_sz;
+		dh = (void *)meta + meta_sz + i * data_sz;
+		memcpy(dh, old_dh, old_data_sz);
+		memset((void *)dh + old_data_sz, 0, data_sz - old_data_sz);
+		dh->size = __cpu_to_le64(data_sz);
+		dh->set_off = __cpu_to_le32(ldms_off_(meta, dh));
+		dh->meta_gn = meta->meta_gn;
+		if (!ldms_heap_get(&hinst, &dh->heap, (void *)dh + val_sz)) {
+			rc = EINVAL;
+			goto err;
+		}
+		ldms_heap_grow(&hinst, heap_sz);
+	}
+
+	rc = __set_mem_replace(s, meta);
+	if (rc)
+		goto err;
+	s->heap = ldms_heap_get(&s->heap_inst, &s->data->heap,
+				(void *)s->data + val_sz);
+	pthread_mutex_unlock(&s->lock);
+
+	__ldms_set_resize_notify(s);
+	if (s->flags & LDMS_SET_F_PUBLISHED)
+		__ldms_dir_upd_set(s);
+	return 0;
+ err:
+	mm_free(meta);
+ out:
+	pthread_mutex_unlock(&s->lock);
+	return rc;
+}
+
+/*
+ * Re-allocate a mirror set to the size announced by its producer. An RDMA
+ * read into the set that is still in flight lands in the old memory, which
+ * is kept until the read completes.
+ */
+int __ldms_set_resize_apply(struct ldms_set *s)
+{
+	struct ldms_set_hdr *meta;
+	struct ldms_data_hdr *dh;
+	size_t meta_sz, data_sz;
+	int i, n, rc, curr_idx;
+	uint32_t gn;
+
+	pthread_mutex_lock(&s->lock);
+	if (!s->resize.rmap) {
+		pthread_mutex_unlock(&s->lock);
+		return 0;
+	}
+	meta_sz = s->resize.meta_sz;
+	data_sz = s->resize.data_sz;
+	n = __le32_to_cpu(s->meta->array_card);
+	meta = mm_alloc(meta_sz + n * data_sz);
+	if (!meta) {
+		/* Keep the resize pending, it is retried on the next update */
+		rc = ENOMEM;
+		goto out;
+	}
+	memset(meta, 0, meta_sz + n * data_sz);
+	memcpy(meta, s->meta, meta_sz < __le32_to_cpu(s->meta->meta_sz) ?
+				meta_sz : __le32_to_cpu(s->meta->meta_sz));
+	meta->meta_sz = __cpu_to_le32(meta_sz);
+	meta->data_sz = __cpu_to_le32(data_sz);
+	/* A zero meta_gn forces the next update to re-read the metadata */
+	meta->meta_gn = 0;
+	for (i = 0; i < n; i++) {
+		dh = (void *)meta + meta_sz + i * data_sz;
+		dh->size = __cpu_to_le64(data_sz);
+		dh->curr_idx = __cpu_to_le32(n - 1);
+	}
+
+	curr_idx = s->curr_idx;
+	s->curr_idx = n - 1;
+	rc = __set_mem_replace(s, meta);
+	if (rc) {
+		s->curr_idx = curr_idx;
+		mm_free(meta);
+		goto out;
+	}
+	zap_unmap(s->rmap);
+	s->rmap = s->resize.rmap;
+	s->resize.rmap = NULL;
+	s->heap = NULL;
+	gn = s->resize.gn;
+	pthread_mutex_unlock(&s->lock);
+
+	/* The producer may now release the memory this mirror read */
+	__ldms_set_resize_done(s, gn);
+	/* The peers looking up this mirror need the new map too */
+	__ldms_set_resize_notify(s);
+	return 0;
+ out:
+	pthread_mutex_unlock(&s->lock);
+	return rc;
+}
+
 #define LDMS_GRAIN_MMALLOC 1024
 
 static int delete_thread_initialized = 0;
@@ -3674,6 +4104,20 @@ int ldms_transaction_begin(ldms_set_t s)
 	return 0;
 }
 
+/* see ldms_transaction_ts_set() */
+static __thread int __trans_ts_override = 0;
+static __thread struct timeval __trans_ts;
+
+void ldms_transaction_ts_set(const struct timeval *tv)
+{
+	if (tv) {
+		__trans_ts = *tv;
+		__trans_ts_override = 1;
+	} else {
+		__trans_ts_override = 0;
+	}
+}
+
 int ldms_transaction_end(ldms_set_t s)
 {
 	struct ldms_data_hdr *dh;
@@ -3690,6 +4134,8 @@ int ldms_transaction_end(ldms_set_t s)
 	}
 	dh->trans.dur.sec = __cpu_to_le32(dh->trans.dur.sec);
 	dh->trans.dur.usec = __cpu_to_le32(dh->trans.dur.usec);
+	if (__trans_ts_override)
+		tv = __trans_ts;
 	dh->trans.ts.sec = __cpu_to_le32(tv.tv_sec);
 	dh->trans.ts.usec = __cpu_to_le32(tv.tv_usec);
 	dh->trans.flags = LDMS_TRANSACTION_END;
@@ -1118,6 +1118,27 @@ int ldms_xprt_rail_send_quota_get(ldms_t x, uint64_t *quota, int n);
  */
 int ldms_xprt_rail_recv_quota_set(ldms_t x, uint64_t q);
 
+/**
+ * \brief Pin the rail endpoints to a zap I/O thread pool
+ *
+ * By default, the endpoint \c i of a rail is assigned to the zap I/O thread
+ * pool \c i. With this call, the endpoint \c i is assigned to the pool
+ * <tt>tpi + i</tt> (modulo the number of pools, see \c ZAP_POOLS) instead.
+ * Applications that keep many rails (e.g. an aggregator with many producers)
+ * can use this to spread the rails deterministically over the I/O threads so
+ * that all completions of a given rail are delivered by the same thread.
+ *
+ * This must be called before ::ldms_xprt_connect().
+ *
+ * \param x   The rail transport handle.
+ * \param tpi The base thread pool index, or -1 for the default assignment.
+ *
+ * \retval 0       If succeeded.
+ * \retval -EINVAL If \c x is not a rail.
+ * \retval -EBUSY  If the rail is already connecting or connected.
+ */
+int ldms_xprt_rail_thread_pool_set(ldms_t x, int tpi);
+
 /* A convenient sockaddr union for IPv4 and IPv6 (for now) */
 union ldms_sockaddr {
 	struct sockaddr     sa;
@@ -1566,6 +1587,22 @@ ldms_msg_subscribe(const char *match, int is_regex,
  */
 void ldms_msg_client_close(ldms_msg_client_t cli);
 
+/**
+ * \brief Deliver JSON messages to \c cli without parsing them.
+ *
+ * By default, LDMS parses the data of an \c LDMS_MSG_JSON message once and
+ * hands the resulting object to every local client in \c ev->recv.json.
+ * A client that decodes \c ev->recv.data itself can opt out of this; the
+ * message is then only parsed if another local client still needs the
+ * object, and \c ev->recv.json is always \c NULL for \c cli.
+ *
+ * Messages delivered before this call may still carry a parsed object.
+ *
+ * \param cli    The client handle.
+ * \param enable 1 to receive raw JSON data only, 0 to restore the default.
+ */
+void ldms_msg_client_json_raw_set(ldms_msg_client_t cli, int enable);
+
 /**
  * \brief Request a remote message subscritpion.
  *
@@ -2003,6 +2040,32 @@ enum ldms_lookup_flags {
 extern int ldms_xprt_lookup(ldms_t t, const char *name, enum ldms_lookup_flags flags,
 		       ldms_lookup_cb_t cb, void *cb_arg);
 
+/**
+ * \brief Look up several metric sets by instance name.
+ *
+ * This is equivalent to calling ldms_xprt_lookup() with
+ * LDMS_LOOKUP_BY_INSTANCE for each name, but the names are sent to the
+ * peer in as few requests as the transport maximum message size allows
+ * and the peer answers all of the names that it could not share in a
+ * single reply. If the peer does not support the multi-set request, which
+ * it advertises when the transport connects, the names are looked up one
+ * by one with ldms_xprt_lookup().
+ *
+ * The \c cb function is called exactly once for each name with the
+ * corresponding element of \c cb_args. The \c more parameter of the
+ * callback is always 0. The callbacks may be called in any order.
+ *
+ * \param t	  The transport handle
+ * \param count   The number of names
+ * \param names   The set instance names
+ * \param cb	  The callback function; it cannot be NULL
+ * \param cb_args The per-name callback arguments
+ * \returns 0 if the lookup was submitted. If an error is returned, \c cb
+ *          is not called for any of the names.
+ */
+extern int ldms_xprt_lookup_multi(ldms_t t, int count, const char *names[],
+				  ldms_lookup_cb_t cb, void *cb_args[]);
+
 /** \} */
 
 /**
@@ -3216,6 +3279,35 @@ uint64_t ldms_set_heap_gn_get(ldms_set_t s);
  */
 uint64_t ldms_set_heap_size_get(ldms_set_t s);
 
+/**
+ * \brief Grow the heap of a set in place
+ *
+ * Re-allocate the set memory with a heap of at least \c heap_sz bytes.
+ * The lists and records in the heap are preserved and the set keeps its
+ * name, set ID and registrations. The metadata generation number is
+ * incremented and the peers that have looked up the set are given the
+ * new memory so that their mirrors are resized on their next update.
+ * The old memory is released once all of them have switched over. A peer
+ * running a version of LDMS that cannot resize a mirror is disconnected
+ * and looks the set up again when it reconnects.
+ *
+ * Use this instead of deleting and re-creating the set when
+ * ldms_list_append_item() or ldms_record_alloc() fails with ENOMEM.
+ *
+ * \note The \c ldms_mval_t handles obtained from the set before the call
+ *       refer to the old memory and must be looked up again.
+ *
+ * \param s       The ldms_set_t handle of a local set.
+ * \param heap_sz The new heap size in bytes. It is rounded up as in
+ *                ldms_set_new_with_heap().
+ *
+ * \retval 0      If the heap is at least \c heap_sz bytes.
+ * \retval EINVAL If the set is not a local set or has no heap.
+ * \retval EFBIG  If the resulting set would be too large.
+ * \retval ENOMEM If there is not enough memory.
+ */
+int ldms_set_heap_grow(ldms_set_t s, size_t heap_sz);
+
 /**
  * \brief Tell LDMS to copy previous data in the set array on transaction begin.
  *
@@ -3276,6 +3368,18 @@ extern int ldms_transaction_begin(ldms_set_t s);
  */
 extern int ldms_transaction_end(ldms_set_t s);
 
+/**
+ * \brief Set the transaction timestamp of the calling thread
+ *
+ * While set, ldms_transaction_end() called by this thread time-stamps the
+ * set data with \c tv instead of the current time. The transaction duration
+ * is still measured with the current time. This lets a caller sampling
+ * several sets back to back give them a common timestamp.
+ *
+ * \param tv    The timestamp, or NULL to use the current time again.
+ */
+extern void ldms_transaction_ts_set(const struct timeval *tv);
+
 /**
  * \brief Get the time the transaction ended
  *
@@ -136,23 +136,6 @@ void *ldms_heap_ptr(ldms_heap_t h, uint64_t off)
 	return (void *)((uint64_t)h->base + off);
 }
 
-void ldms_heap_get_info(ldms_heap_t heap, ldms_heap_info_t info)
-{
-	memset(info, 0, sizeof(*info));
-
-	pthread_mutex_lock(&heap->lock);
-
-	info->grain = heap->data->grain;
-	info->grain_bits = heap->data->grain_bits;
-	info->size = heap->data->size;
-	info->start = heap->data;
-
-	info->smallest = heap->data->size + 1;
-	rrbt_traverse(heap->addr_tree, heap_stat, info);
-
-	pthread_mutex_unlock(&heap->lock);
-}
-
 __attribute__((unused))
 static void get_pow2(size_t n, size_t *pow2, size_t *bits)
 {
@@ -168,84 +151,14 @@ size_t ldms_heap_grain_size(size_t grain_sz)
 	return ((grain_sz > sizeof(struct mm_free)) ? grain_sz : sizeof(struct mm_free));
 }
 
-void ldms_heap_init(struct ldms_heap *heap, void *base, size_t size, size_t grain)
-{
-	uint64_t count;
-	struct ldms_heap_base *hbase = base;
-
-	if (size == 0) {
-		heap->size = 0;
-		return;
-	}
-	size = MMR_ROUNDUP(size, LDMS_HEAP_MIN_SIZE);
-
-	for (heap->grain = 1, heap->grain_bits = 0;
-	     heap->grain < ldms_heap_grain_size(grain);
-	     heap->grain <<= 1, heap->grain_bits++);
-
-	heap->size = size;
-	heap->gn = 0;
-
-	/* Inialize the size and address r-b trees */
-	rrbt_init(&heap->size_tree);
-	rrbt_init(&heap->addr_tree);
-
-	/* Sign the heap */
-	strcpy(hbase->signature, LDMS_HEAP_SIGNATURE);
-
-	/* Initialize the prefix */
-	struct mm_free *pfx = (typeof(pfx))hbase->start;
-	assert(((uint64_t)pfx & 7) == 0);
-
-	/* Insert the chunk into the r-b trees */
-	struct rrbt_instance inst;
-	rrbt_t tree = rrbt_get(&inst, &heap->size_tree.root, base, compare_size);
-	count = size / heap->grain;
-	rrbn_init(RRBN(pfx->size_node), &count, sizeof(count));
-	rrbt_ins(tree, RRBN(pfx->size_node));
-
-	tree = rrbt_get(&inst, &heap->addr_tree.root, base, compare_addr);
-	count = (uint64_t)pfx - (uint64_t)base;
-	rrbn_init(RRBN(pfx->addr_node), &count, sizeof(uint64_t));
-	rrbt_ins(tree, RRBN(pfx->addr_node));
-}
-
-ldms_heap_t ldms_heap_get(ldms_heap_t h, struct ldms_heap *heap, void *base)
-{
-	h->data = heap;
-	h->base = base;
-	h->size_tree = rrbt_get(&h->size_inst, &heap->size_tree.root, base, compare_size);
-	h->addr_tree = rrbt_get(&h->addr_inst, &heap->addr_tree.root, base, compare_addr);
-	pthread_mutex_init(&h->lock, NULL);
-	if (strncmp(h->base->signature, LDMS_HEAP_SIGNATURE, sizeof(h->base->signature))) {
-		assert(0 == "heap signature mismatch");
-		return NULL;
-	}
-	return h;
-}
-
-size_t ldms_heap_alloc_size(size_t grain_sz, size_t data_sz)
-{
-	/* Contains the size prefix needed to free the memory */
-	data_sz += sizeof(struct mm_alloc);
-	/* The memory chunk must hold mm_free */
-	if (data_sz < sizeof(struct mm_free))
-		data_sz = sizeof(struct mm_free);
-	return MMR_ROUNDUP(data_sz, ldms_heap_grain_size(grain_sz));
-}
-
-void *ldms_heap_alloc(ldms_heap_t heap, size_t size)
+/* The caller must hold the heap lock */
+static struct mm_alloc *tree_alloc(ldms_heap_t heap, uint64_t count)
 {
 	struct mm_free *p, *n;
 	struct mm_alloc *a;
 	struct rrbn *rbn;
-	uint64_t count;
 	uint64_t remainder;
 
-
-	size = ldms_heap_alloc_size(heap->data->grain, size);
-	count = size >> heap->data->grain_bits;
-
 #if LDMS_HEAP_DEBUG
 	printf("------- %p: heap_alloc(%ld) -- start\n", heap, count);
 	printf("                         ---size tree ----\n");
@@ -256,12 +169,9 @@ void *ldms_heap_alloc(ldms_heap_t heap, size_t size)
 	rrbt_print(heap->addr_tree);
 #endif /* LDMS_HEAP_DEBUG */
 
-	pthread_mutex_lock(&heap->lock);
 	rbn = rrbt_find_lub(heap->size_tree, &count);
-	if (!rbn) {
-		pthread_mutex_unlock(&heap->lock);
+	if (!rbn)
 		return NULL;
-	}
 
 	p = container_of(rbn, struct mm_free, size_node);
 
@@ -283,15 +193,15 @@ void *ldms_heap_alloc(ldms_heap_t heap, size_t size)
 	}
 	a = (struct mm_alloc *)p;
 	a->count = count;
-	a += 1;
 #if LDMS_HEAP_DEBUG
 	printf("---%lx (size:%lx[%p], addr:%lx[%p], end:%lx) ---- heap_alloc(%ld) -- end\n",
-			ldms_heap_off(heap, a),
+			ldms_heap_off(heap, a + 1),
 			rrbt_off(heap->size_tree, rbn),
 			rbn,
 			rrbt_off(heap->addr_tree, RRBN(p->addr_node)),
 			&p->addr_node,
-			rrbt_off(heap->addr_tree, RRBN(p->addr_node)) + size,  count);
+			rrbt_off(heap->addr_tree, RRBN(p->addr_node)) +
+				(count << heap->data->grain_bits),  count);
 	printf("                         ---size tree ----\n");
 	rrbt_verify(heap->size_tree);
 	rrbt_print(heap->size_tree);
@@ -300,30 +210,26 @@ void *ldms_heap_alloc(ldms_heap_t heap, size_t size)
 	rrbt_print(heap->addr_tree);
 	printf("------------------------------------------\n");
 #endif /* LDMS_HEAP_DEBUG */
-	heap->data->gn++;
-	pthread_mutex_unlock(&heap->lock);
 	return a;
 }
 
-void ldms_heap_free(ldms_heap_t heap, void *d)
+/* The caller must hold the heap lock */
+static void tree_free(ldms_heap_t heap, struct mm_alloc *a)
 {
 	uint64_t count;
-	struct mm_alloc *a = d;
 	struct mm_free *p;
 	struct mm_free *q;
 	struct rrbn *rbn;
 	uint64_t offset;
 	uint64_t end;
 
-	a--;
 	p = (void *)a;
-	pthread_mutex_lock(&heap->lock);
 	offset = ldms_heap_off(heap, p);
 	count = a->count;
 #if LDMS_HEAP_DEBUG
 	printf("------- %p: heap_free(%lx, %ld) -- start\n",
 			heap,
-			ldms_heap_off(heap, d),
+			ldms_heap_off(heap, a + 1),
 			count);
 	rbn = rrbt_find_glb(heap->addr_tree, &offset);
 	if (rbn) {
@@ -381,11 +287,8 @@ void ldms_heap_free(ldms_heap_t heap, void *d)
 	rrbt_ins(heap->size_tree, RRBN(p->size_node));
 	rrbt_ins(heap->addr_tree, RRBN(p->addr_node));
 
-	/* Modify generation nubmer */
-	heap->data->gn++;
-
 #if LDMS_HEAP_DEBUG
-	printf("------- heap_free(%lx, %ld) -- end\n", ldms_heap_off(heap, d), count);
+	printf("------- heap_free(%lx, %ld) -- end\n", ldms_heap_off(heap, a + 1), count);
 	printf("                         ---size tree ----\n");
 	rrbt_verify(heap->size_tree);
 	rrbt_print(heap->size_tree);
@@ -394,12 +297,304 @@ void ldms_heap_free(ldms_heap_t heap, void *d)
 	rrbt_print(heap->addr_tree);
 	printf("------------------------------------------\n");
 #endif /* LDMS_HEAP_DEBUG */
+}
+
+/*
+ * Size-class free lists
+ *
+ * Chunks of up to LDMS_HEAP_SLAB_CLASSES grains are not returned to the
+ * trees when they are freed. They are pushed on the free list of their
+ * size class and popped by the next allocation of the same size, so a
+ * sampler that rebuilds its lists every interval does not rebalance the
+ * trees. An empty class is refilled with a run of chunks carved from the
+ * trees at once. When the trees cannot satisfy an allocation, the lists
+ * are returned to the trees so that the chunks coalesce again.
+ */
+#define LDMS_HEAP_SLAB_REFILL 8
+
+struct mm_slab {
+	uint64_t head[LDMS_HEAP_SLAB_CLASSES];	/* offset of the first chunk */
+	uint32_t count[LDMS_HEAP_SLAB_CLASSES];	/* number of chunks */
+};
+
+struct mm_slab_free {
+	struct mm_alloc a;
+	uint32_t pad;
+	uint64_t next;		/* offset of the next chunk of the class */
+};
+
+static inline struct mm_slab *slab_get(ldms_heap_t heap)
+{
+	if (!heap->data->slab)
+		return NULL;
+	return ldms_heap_ptr(heap, heap->data->slab);
+}
+
+static inline void slab_push(ldms_heap_t heap, struct mm_slab *slab,
+			     struct mm_alloc *a)
+{
+	struct mm_slab_free *f = (void *)a;
+	int c = a->count - 1;
+	f->next = slab->head[c];
+	slab->head[c] = ldms_heap_off(heap, f);
+	slab->count[c]++;
+}
+
+/* Return the chunks of all size classes to the trees */
+static int slab_drain(ldms_heap_t heap, struct mm_slab *slab)
+{
+	struct mm_slab_free *f;
+	int c, n = 0;
+	for (c = 0; c < LDMS_HEAP_SLAB_CLASSES; c++) {
+		while (slab->head[c]) {
+			f = ldms_heap_ptr(heap, slab->head[c]);
+			slab->head[c] = f->next;
+			tree_free(heap, &f->a);
+			n++;
+		}
+		slab->count[c] = 0;
+	}
+	return n;
+}
+
+static struct mm_alloc *slab_alloc(ldms_heap_t heap, struct mm_slab *slab,
+				   uint64_t count)
+{
+	struct mm_slab_free *f;
+	struct mm_alloc *a;
+	int c = count - 1;
+	int i, n;
+
+	if (slab->head[c]) {
+		f = ldms_heap_ptr(heap, slab->head[c]);
+		slab->head[c] = f->next;
+		slab->count[c]--;
+		return &f->a;
+	}
+	n = LDMS_HEAP_SLAB_REFILL;
+	a = tree_alloc(heap, count * n);
+	if (!a) {
+		n = 1;
+		a = tree_alloc(heap, count);
+	}
+	if (!a && slab_drain(heap, slab))
+		a = tree_alloc(heap, count);
+	if (!a)
+		return NULL;
+	for (i = n - 1; i > 0; i--) {
+		f = (void *)a + ((i * count) << heap->data->grain_bits);
+		f->a.count = count;
+		slab_push(heap, slab, &f->a);
+	}
+	a->count = count;
+	return a;
+}
+
+/* The caller must hold the heap lock */
+static void slab_init(ldms_heap_t heap)
+{
+	struct mm_alloc *a;
+	uint64_t count;
+
+	count = ldms_heap_alloc_size(heap->data->grain, sizeof(struct mm_slab))
+						>> heap->data->grain_bits;
+	a = tree_alloc(heap, count);
+	if (!a)
+		return;
+	memset(a + 1, 0, sizeof(struct mm_slab));
+	heap->data->slab = ldms_heap_off(heap, a + 1);
+}
+
+static int slab_stat(ldms_heap_t heap, ldms_heap_info_t info)
+{
+	struct mm_slab *slab = slab_get(heap);
+	int c;
+	if (!slab)
+		return 0;
+	for (c = 0; c < LDMS_HEAP_SLAB_CLASSES; c++) {
+		info->slab_free_chunks += slab->count[c];
+		info->slab_free_grains += slab->count[c] * (c + 1);
+	}
+	return 0;
+}
+
+void ldms_heap_get_info(ldms_heap_t heap, ldms_heap_info_t info)
+{
+	size_t free_grains;
+
+	memset(info, 0, sizeof(*info));
+
+	pthread_mutex_lock(&heap->lock);
+
+	info->grain = heap->data->grain;
+	info->grain_bits = heap->data->grain_bits;
+	info->size = heap->data->size;
+	info->start = heap->data;
+
+	info->smallest = heap->data->size + 1;
+	rrbt_traverse(heap->addr_tree, heap_stat, info);
+	slab_stat(heap, info);
+
+	pthread_mutex_unlock(&heap->lock);
+
+	free_grains = info->free_bytes + info->slab_free_grains;
+	if (free_grains)
+		info->fragmentation = 100 - (info->largest * 100) / free_grains;
+}
+
+void ldms_heap_init(struct ldms_heap *heap, void *base, size_t size, size_t grain)
+{
+	uint64_t count;
+	struct ldms_heap_base *hbase = base;
+
+	heap->slab = 0;
+	if (size == 0) {
+		heap->size = 0;
+		return;
+	}
+	size = MMR_ROUNDUP(size, LDMS_HEAP_MIN_SIZE);
+
+	for (heap->grain = 1, heap->grain_bits = 0;
+	     heap->grain < ldms_heap_grain_size(grain);
+	     heap->grain <<= 1, heap->grain_bits++);
+
+	heap->size = size;
+	heap->gn = 0;
+
+	/* Inialize the size and address r-b trees */
+	rrbt_init(&heap->size_tree);
+	rrbt_init(&heap->addr_tree);
+
+	/* Sign the heap */
+	strcpy(hbase->signature, LDMS_HEAP_SIGNATURE);
+
+	/* Initialize the prefix */
+	struct mm_free *pfx = (typeof(pfx))hbase->start;
+	assert(((uint64_t)pfx & 7) == 0);
+
+	/* Insert the chunk into the r-b trees */
+	struct rrbt_instance inst;
+	rrbt_t tree = rrbt_get(&inst, &heap->size_tree.root, base, compare_size);
+	count = size / heap->grain;
+	rrbn_init(RRBN(pfx->size_node), &count, sizeof(count));
+	rrbt_ins(tree, RRBN(pfx->size_node));
+
+	tree = rrbt_get(&inst, &heap->addr_tree.root, base, compare_addr);
+	count = (uint64_t)pfx - (uint64_t)base;
+	rrbn_init(RRBN(pfx->addr_node), &count, sizeof(uint64_t));
+	rrbt_ins(tree, RRBN(pfx->addr_node));
+
+	if (size >= LDMS_HEAP_SLAB_MIN_SIZE) {
+		struct ldms_heap_instance h;
+		ldms_heap_get(&h, heap, base);
+		slab_init(&h);
+		pthread_mutex_destroy(&h.lock);
+	}
+}
+
+ldms_heap_t ldms_heap_get(ldms_heap_t h, struct ldms_heap *heap, void *base)
+{
+	h->data = heap;
+	h->base = base;
+	h->size_tree = rrbt_get(&h->size_inst, &heap->size_tree.root, base, compare_size);
+	h->addr_tree = rrbt_get(&h->addr_inst, &heap->addr_tree.root, base, compare_addr);
+	pthread_mutex_init(&h->lock, NULL);
+	if (strncmp(h->base->signature, LDMS_HEAP_SIGNATURE, sizeof(h->base->signature))) {
+		assert(0 == "heap signature mismatch");
+		return NULL;
+	}
+	return h;
+}
+
+size_t ldms_heap_alloc_size(size_t grain_sz, size_t data_sz)
+{
+	/* Contains the size prefix needed to free the memory */
+	data_sz += sizeof(struct mm_alloc);
+	/* The memory chunk must hold mm_free */
+	if (data_sz < sizeof(struct mm_free))
+		data_sz = sizeof(struct mm_free);
+	return MMR_ROUNDUP(data_sz, ldms_heap_grain_size(grain_sz));
+}
+
+void *ldms_heap_alloc(ldms_heap_t heap, size_t size)
+{
+	struct mm_slab *slab;
+	struct mm_alloc *a;
+	uint64_t count;
+
+	size = ldms_heap_alloc_size(heap->data->grain, size);
+	count = size >> heap->data->grain_bits;
+
+	pthread_mutex_lock(&heap->lock);
+	slab = slab_get(heap);
+	if (slab && count <= LDMS_HEAP_SLAB_CLASSES) {
+		a = slab_alloc(heap, slab, count);
+	} else {
+		a = tree_alloc(heap, count);
+		if (!a && slab && slab_drain(heap, slab))
+			a = tree_alloc(heap, count);
+	}
+	if (!a) {
+		pthread_mutex_unlock(&heap->lock);
+		return NULL;
+	}
+	heap->data->gn++;
+	pthread_mutex_unlock(&heap->lock);
+	return a + 1;
+}
+
+void ldms_heap_free(ldms_heap_t heap, void *d)
+{
+	struct mm_alloc *a = d;
+	struct mm_slab *slab;
+
+	a--;
+	pthread_mutex_lock(&heap->lock);
+	slab = slab_get(heap);
+	if (slab && a->count <= LDMS_HEAP_SLAB_CLASSES)
+		slab_push(heap, slab, a);
+	else
+		tree_free(heap, a);
+
+	/* Modify generation nubmer */
+	heap->data->gn++;
 	pthread_mutex_unlock(&heap->lock);
 }
 
+int ldms_heap_grow(ldms_heap_t heap, size_t size)
+{
+	struct mm_alloc *a;
+	uint64_t old_size;
+
+	size = MMR_ROUNDUP(size, LDMS_HEAP_MIN_SIZE);
+	pthread_mutex_lock(&heap->lock);
+	old_size = heap->data->size;
+	if (size <= old_size) {
+		pthread_mutex_unlock(&heap->lock);
+		return (size < old_size)?EINVAL:0;
+	}
+	heap->data->size = size;
+	/*
+	 * Format the new region as an allocated chunk and return it to the
+	 * trees so that it is coalesced with the last free chunk.
+	 */
+	a = (struct mm_alloc *)&heap->base->start[old_size];
+	a->count = (size - old_size) >> heap->data->grain_bits;
+	tree_free(heap, a);
+	if (!heap->data->slab && size >= LDMS_HEAP_SLAB_MIN_SIZE)
+		slab_init(heap);
+	heap->data->gn++;
+	pthread_mutex_unlock(&heap->lock);
+	return 0;
+}
+
 size_t ldms_heap_size(size_t size)
 {
-	return MMR_ROUNDUP(size, LDMS_HEAP_MIN_SIZE);
+	size_t sz = MMR_ROUNDUP(size, LDMS_HEAP_MIN_SIZE);
+	/* Leave room for the size-class free lists */
+	if (sz >= LDMS_HEAP_SLAB_MIN_SIZE)
+		sz = MMR_ROUNDUP(size + LDMS_HEAP_MIN_SIZE, LDMS_HEAP_MIN_SIZE);
+	return sz;
 }
 
 
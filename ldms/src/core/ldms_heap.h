@@ -60,12 +60,20 @@ typedef struct ldms_heap_info {
 	size_t free_bytes;	/*< number of unallocated grains current */
 	size_t largest;		/*< largest unallocated chunk size in grains */
 	size_t smallest;	/*< smallest unallocated chunk size in grains */
+	size_t slab_free_chunks; /*< number of chunks in the size-class lists */
+	size_t slab_free_grains; /*< number of grains in the size-class lists */
+	size_t fragmentation;	/*< percent of the free grains that are not
+				 *  in the largest unallocated chunk */
 } *ldms_heap_info_t;
 #define LDMS_HEAP_MIN_SIZE 512
+#define LDMS_HEAP_SLAB_MIN_SIZE (16 * 1024)
+#define LDMS_HEAP_SLAB_CLASSES 16
 
 struct ldms_heap {
 	uint32_t grain_bits:8;
 	uint32_t grain:24;	/* Minimum allocation size and alignment */
+	uint32_t slab;		/* Offset of the size-class free lists from
+				 * the heap base, 0 if the heap has none */
 	uint64_t size;		/* Size of the heap in bytes */
 	uint32_t gn;            /* Changes when alloc and free  */
 	struct rrbt size_tree;	/* Tree ordered by size */
@@ -100,7 +108,12 @@ void ldms_heap_get_info(ldms_heap_t h, ldms_heap_info_t i);
 /**
  * \brief Initialize the heap.
  *
- * Initializes the heap data at the specified base address
+ * Initializes the heap data at the specified base address. A heap of at
+ * least \c LDMS_HEAP_SLAB_MIN_SIZE bytes serves the allocations of up to
+ * \c LDMS_HEAP_SLAB_CLASSES grains from segregated free lists, one per
+ * size class; larger allocations are served from the size and address
+ * trees. The free lists only hold offsets inside the heap, so the heap
+ * remains valid when it is copied to a peer.
  *
  * \param heap  The pointer to the heap structure.
  * \param base  The base address of the heap data.
@@ -138,6 +151,21 @@ ldms_heap_t ldms_heap_get(ldms_heap_t h, struct ldms_heap *heap, void *base);
  */
 void *ldms_heap_alloc(ldms_heap_t heap, size_t size);
 
+/**
+ * \brief Grow the heap in place.
+ *
+ * The memory following the current end of the heap must already be
+ * available to the heap. The new region is added to the free chunks and
+ * coalesced with the free chunk at the end of the heap, if any.
+ *
+ * \param heap The heap instance handle.
+ * \param size The new size of the heap in bytes.
+ *
+ * \retval 0      If the heap has been grown.
+ * \retval EINVAL If \c size is smaller than the current heap size.
+ */
+int ldms_heap_grow(ldms_heap_t heap, size_t size);
+
 /**
  * \brief Return heap bytes required to store element of specified size
  *
@@ -183,6 +211,8 @@ void *ldms_heap_ptr(ldms_heap_t h, uint64_t off);
  *
  * The heap size is required to be a multiplication of \c LDMS_HEAP_MIN_SIZE.
  * This function calculates the appropriate heap size >= the requested size.
+ * A heap of \c LDMS_HEAP_SLAB_MIN_SIZE bytes or more also gets room for its
+ * size-class free lists.
  *
  * \param  size The requested heap size.
  *
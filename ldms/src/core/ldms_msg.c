@@ -120,6 +120,24 @@ static struct rbt __msg_ch_rbt = RBT_INITIALIZER(__str_rbn_cmp);
 
 TAILQ_HEAD(, ldms_msg_client_s) __regex_client_tq = TAILQ_HEAD_INITIALIZER(__regex_client_tq);
 
+/* Distinct patterns of the regex clients, and the alternation of all of them
+ * that quickly rejects the channel names no regex client wants. Protected by
+ * __msg_rwlock. */
+static TAILQ_HEAD(, ldms_msg_pattern_s)
+	__pattern_tq = TAILQ_HEAD_INITIALIZER(__pattern_tq);
+static regex_t __pattern_all;
+static int __pattern_all_ok = 0;
+
+/* Channels that have no exact-match client and have been idle for
+ * `__msg_ch_idle_timeout` seconds are reclaimed by the client close thread.
+ * 0 disables the reclamation. See `LDMS_MSG_CH_IDLE_TIMEOUT` in
+ * __ldms_msg_init(). */
+static time_t __msg_ch_idle_timeout = 3600;
+
+/* the channel rx counter slot of the calling thread */
+static int __rx_slot_next = 0;
+static __thread int __rx_slot_id = -1;
+
 static uint64_t __msg_gn = 0;
 
 static pthread_mutex_t __client_close_mutex = PTHREAD_MUTEX_INITIALIZER;
@@ -406,14 +424,232 @@ __remote_client_cb(ldms_msg_event_t ev, void *cb_arg)
 static int
 __cli_ch_bind(ldms_msg_client_t c, struct ldms_msg_ch_s *s);
 
+/* Check that the parentheses in the regex are balanced so that it can be
+ * wrapped as a subexpression of the alternation without changing its
+ * meaning. */
+static int __regex_parens_balanced(const char *str)
+{
+	int depth = 0;
+	for (; *str; str++) {
+		switch (*str) {
+		case '\\':
+			if (!str[1])
+				return 0;
+			str++;
+			break;
+		case '[':
+			/* skip the bracket expression; ']' right after '[' or
+			 * '[^' is a literal */
+			str++;
+			if (*str == '^')
+				str++;
+			if (*str == ']')
+				str++;
+			while (*str && *str != ']')
+				str++;
+			if (!*str)
+				return 0;
+			break;
+		case '(':
+			depth++;
+			break;
+		case ')':
+			if (--depth < 0)
+				return 0;
+			break;
+		}
+	}
+	return depth == 0;
+}
+
+/* Rebuild `__pattern_all`; the caller must hold __msg_rwlock write lock.
+ * Without the alternation, every pattern is simply evaluated. */
+static void __pattern_all_rebuild()
+{
+	struct ldms_msg_pattern_s *p;
+	size_t len = 1;
+	char *str, *x;
+	int rc;
+
+	if (__pattern_all_ok) {
+		regfree(&__pattern_all);
+		__pattern_all_ok = 0;
+	}
+	TAILQ_FOREACH(p, &__pattern_tq, entry) {
+		if (!__regex_parens_balanced(p->match))
+			return;
+		len += strlen(p->match) + 3; /* "|(" ... ")" */
+	}
+	if (TAILQ_EMPTY(&__pattern_tq))
+		return;
+	str = malloc(len);
+	if (!str)
+		return;
+	x = str;
+	TAILQ_FOREACH(p, &__pattern_tq, entry) {
+		x += sprintf(x, "%s(%s)", (x == str)?"":"|", p->match);
+	}
+	rc = regcomp(&__pattern_all, str, REG_EXTENDED|REG_NOSUB);
+	if (!rc)
+		__pattern_all_ok = 1;
+	free(str);
+}
+
+/* Get the shared pattern for `match`; the caller must hold __msg_rwlock
+ * write lock. */
+static struct ldms_msg_pattern_s *__pattern_get(const char *match)
+{
+	struct ldms_msg_pattern_s *p;
+	int rc, len;
+
+	TAILQ_FOREACH(p, &__pattern_tq, entry) {
+		if (0 == strcmp(p->match, match)) {
+			p->n_clients++;
+			return p;
+		}
+	}
+	len = strlen(match) + 1;
+	p = calloc(1, sizeof(*p) + len);
+	if (!p)
+		return NULL;
+	rc = regcomp(&p->regex, match, REG_EXTENDED|REG_NOSUB);
+	if (rc) {
+		free(p);
+		errno = EINVAL;
+		return NULL;
+	}
+	memcpy(p->match, match, len);
+	p->n_clients = 1;
+	TAILQ_INSERT_TAIL(&__pattern_tq, p, entry);
+	__pattern_all_rebuild();
+	return p;
+}
+
+/* The caller must hold __msg_rwlock write lock. */
+static void __pattern_put(struct ldms_msg_pattern_s *p)
+{
+	if (--p->n_clients)
+		return;
+	TAILQ_REMOVE(&__pattern_tq, p, entry);
+	regfree(&p->regex);
+	free(p);
+	__pattern_all_rebuild();
+}
+
+/* Evaluate the regex client patterns against the channel `name`, setting
+ * `p->matched` accordingly. Returns the number of matched patterns. The
+ * caller must hold __msg_rwlock write lock. */
+static int __pattern_match(const char *name)
+{
+	struct ldms_msg_pattern_s *p;
+	int n = 0;
+
+	if (TAILQ_EMPTY(&__pattern_tq))
+		return 0;
+	if (__pattern_all_ok && regexec(&__pattern_all, name, 0, NULL, 0))
+		return 0; /* no pattern matches */
+	TAILQ_FOREACH(p, &__pattern_tq, entry) {
+		p->matched = (0 == regexec(&p->regex, name, 0, NULL, 0));
+		n += p->matched;
+	}
+	return n;
+}
+
+static inline struct ldms_msg_rx_slot_s *__rx_slot(struct ldms_msg_ch_s *s)
+{
+	struct ldms_msg_rx_slot_s *slots;
+
+	slots = __atomic_load_n(&s->rx_slot, __ATOMIC_ACQUIRE);
+	if (!slots)
+		return NULL;
+	if (__rx_slot_id < 0)
+		__rx_slot_id = __atomic_fetch_add(&__rx_slot_next, 1,
+				__ATOMIC_RELAXED) % LDMS_MSG_RX_SLOTS;
+	return &slots[__rx_slot_id];
+}
+
+static void __rx_slot_update(struct ldms_msg_rx_slot_s *r,
+			     struct timespec *now, size_t bytes)
+{
+	uint64_t ns = now->tv_sec * 1000000000ULL + now->tv_nsec;
+	uint64_t v;
+
+	__atomic_add_fetch(&r->count, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&r->bytes, bytes, __ATOMIC_RELAXED);
+	v = __atomic_load_n(&r->first_ns, __ATOMIC_RELAXED);
+	while ((v == 0 || ns < v) &&
+	       !__atomic_compare_exchange_n(&r->first_ns, &v, ns, 0,
+				__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+	v = __atomic_load_n(&r->last_ns, __ATOMIC_RELAXED);
+	while (ns > v &&
+	       !__atomic_compare_exchange_n(&r->last_ns, &v, ns, 0,
+				__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+}
+
+/* Merge the rx counters and slots of the channel into `ctr`; they are cleared
+ * if `is_reset` is not 0. */
+static void __ch_rx_merge(struct ldms_msg_ch_s *s,
+			  struct ldms_msg_counters_s *ctr, int is_reset)
+{
+	struct ldms_msg_rx_slot_s *r;
+	uint64_t count, bytes, first_ns, last_ns;
+	uint64_t min_ns = 0, max_ns = 0;
+	int i;
+
+	*ctr = s->rx;
+	if (is_reset)
+		LDMS_MSG_COUNTERS_INIT(&s->rx);
+	if (!s->rx_slot)
+		return;
+	if (ctr->count) {
+		min_ns = ctr->first_ts.tv_sec * 1000000000ULL + ctr->first_ts.tv_nsec;
+		max_ns = ctr->last_ts.tv_sec * 1000000000ULL + ctr->last_ts.tv_nsec;
+	}
+	for (i = 0; i < LDMS_MSG_RX_SLOTS; i++) {
+		r = &s->rx_slot[i];
+		if (is_reset) {
+			count = __atomic_exchange_n(&r->count, 0, __ATOMIC_RELAXED);
+			bytes = __atomic_exchange_n(&r->bytes, 0, __ATOMIC_RELAXED);
+			first_ns = __atomic_exchange_n(&r->first_ns, 0, __ATOMIC_RELAXED);
+			last_ns = __atomic_exchange_n(&r->last_ns, 0, __ATOMIC_RELAXED);
+		} else {
+			count = __atomic_load_n(&r->count, __ATOMIC_RELAXED);
+			bytes = __atomic_load_n(&r->bytes, __ATOMIC_RELAXED);
+			first_ns = __atomic_load_n(&r->first_ns, __ATOMIC_RELAXED);
+			last_ns = __atomic_load_n(&r->last_ns, __ATOMIC_RELAXED);
+		}
+		if (!count)
+			continue;
+		ctr->count += count;
+		ctr->bytes += bytes;
+		if (first_ns && (!min_ns || first_ns < min_ns))
+			min_ns = first_ns;
+		if (last_ns > max_ns)
+			max_ns = last_ns;
+	}
+	if (min_ns) {
+		ctr->first_ts.tv_sec = min_ns / 1000000000;
+		ctr->first_ts.tv_nsec = min_ns % 1000000000;
+	}
+	if (max_ns) {
+		ctr->last_ts.tv_sec = max_ns / 1000000000;
+		ctr->last_ts.tv_nsec = max_ns % 1000000000;
+	}
+}
+
 /* must NOT hold __msg_rwlock */
 static struct ldms_msg_ch_s *
 __ch_get(const char *name, int *is_new)
 {
 	struct ldms_msg_ch_s *s;
-	int name_len = strlen(name) + 1;
+	struct ldms_msg_client_s *c;
+	int rc, name_len = strlen(name) + 1;
 	__MSG_RDLOCK();
 	s = (void*)rbt_find(&__msg_ch_rbt, name);
+	if (s)
+		__atomic_add_fetch(&s->busy, 1, __ATOMIC_SEQ_CST);
 	__MSG_UNLOCK();
 	if (s)
 		goto out_0;
@@ -427,6 +663,7 @@ __ch_get(const char *name, int *is_new)
 	s = calloc(1, sizeof(*s) + name_len);
 	if (!s)
 		goto out_1;
+	s->last_active = time(NULL);
 	pthread_rwlock_init(&s->rwlock, NULL);
 	rbn_init(&s->rbn, s->name);
 	TAILQ_INIT(&s->cli_tq);
@@ -437,16 +674,14 @@ __ch_get(const char *name, int *is_new)
 		*is_new = 1;
 
 	rbt_init(&s->src_stats_rbt, __ldms_addr_rbn_cmp);
-	s->rx.first_ts = __TIMESPEC_MAX;
-	s->rx.last_ts  = __TIMESPEC_MIN;
+	LDMS_MSG_COUNTERS_INIT(&s->rx);
 
 	/* We need to go through the _regex_ clients to see if we match
-	 * any. */
-	struct ldms_msg_client_s *c;
-	int rc;
+	 * any. Each distinct pattern is evaluated only once. */
+	if (!__pattern_match(name))
+		goto out_1;
 	TAILQ_FOREACH(c, &__regex_client_tq, entry) {
-		rc = regexec(&c->regex, name, 0, NULL, 0);
-		if (rc) /* does not match */
+		if (!c->pat->matched)
 			continue;
 		/* matched; add the client into the client list */
 		rc = __cli_ch_bind(c, s);
@@ -458,11 +693,20 @@ __ch_get(const char *name, int *is_new)
 	 * non-regex clients already create the channel structure and
 	 * register themselves before reaching here. */
  out_1:
+	if (s)
+		__atomic_add_fetch(&s->busy, 1, __ATOMIC_SEQ_CST);
 	__MSG_UNLOCK();
  out_0:
 	return s;
 }
 
+/* release the channel obtained by __ch_get() */
+static inline void
+__ch_put(struct ldms_msg_ch_s *s)
+{
+	__atomic_sub_fetch(&s->busy, 1, __ATOMIC_SEQ_CST);
+}
+
 static void __sce_ref_free(void *arg)
 {
 	__DEBUG("sce %p: free\n", arg);
@@ -473,9 +717,19 @@ static int
 __cli_ch_bind(ldms_msg_client_t c, struct ldms_msg_ch_s *s)
 {
 	struct ldms_msg_ch_cli_entry_s *sce;
+	struct ldms_msg_rx_slot_s *slots = NULL;
 	sce = calloc(1, sizeof(*sce));
 	if (!sce)
 		return ENOMEM;
+	if (!__atomic_load_n(&s->rx_slot, __ATOMIC_ACQUIRE)) {
+		/* The channel is delivered to from now on; count rx without
+		 * the channel lock. On failure, s->rx keeps counting. */
+		if (posix_memalign((void**)&slots, 64,
+				   LDMS_MSG_RX_SLOTS * sizeof(*slots)))
+			slots = NULL;
+		else
+			memset(slots, 0, LDMS_MSG_RX_SLOTS * sizeof(*slots));
+	}
 	ref_get(&c->ref, "client_entry");
 	sce->cli = c;
 	sce->ch = s;
@@ -488,7 +742,12 @@ __cli_ch_bind(ldms_msg_client_t c, struct ldms_msg_ch_s *s)
 
 	pthread_rwlock_wrlock(&s->rwlock);
 	TAILQ_INSERT_TAIL(&s->cli_tq, sce, ch_cli_entry);
+	if (slots && !s->rx_slot) {
+		__atomic_store_n(&s->rx_slot, slots, __ATOMIC_RELEASE);
+		slots = NULL;
+	}
 	pthread_rwlock_unlock(&s->rwlock);
+	free(slots);
 	ref_get(&sce->ref, "ch_cli_entry");
 
 	LDMS_MSG_COUNTERS_INIT(&sce->tx);
@@ -599,6 +858,7 @@ __msg_deliver(struct __msg_buf_s *sbuf, uint64_t msg_gn,
 	struct ldms_msg_ch_cli_entry_s *sce, *next_sce;
 	struct ldms_msg_client_s *c;
 	struct timespec now;
+	struct ldms_msg_rx_slot_s *rx_slot;
 	size_t sz;
 
 	s = __ch_get(name, NULL);
@@ -633,14 +893,24 @@ __msg_deliver(struct __msg_buf_s *sbuf, uint64_t msg_gn,
 	if (sbuf)
 		_ev.pub.recv.src = sbuf->msg->src;
 
+	if (__atomic_load_n(&s->last_active, __ATOMIC_RELAXED) != recv_ts->tv_sec)
+		__atomic_store_n(&s->last_active, recv_ts->tv_sec, __ATOMIC_RELAXED);
+
 	/* update stats */
 	if (__msg_stats_level <= 0)
 		goto skip_stats;
-	pthread_rwlock_wrlock(&s->rwlock);
 	clock_gettime(CLOCK_REALTIME, &now);
-	__counters_update(&s->rx, &now, data_len);
+	rx_slot = __rx_slot(s);
+	if (rx_slot) {
+		__rx_slot_update(rx_slot, &now, data_len);
+	} else {
+		pthread_rwlock_wrlock(&s->rwlock);
+		__counters_update(&s->rx, &now, data_len);
+		pthread_rwlock_unlock(&s->rwlock);
+	}
 	if ((__msg_stats_level > 1) || ENABLED_PROFILING(LDMS_XPRT_OP_MSG_PUBLISH)) {
 		/* stats by src */
+		pthread_rwlock_wrlock(&s->rwlock);
 		struct rbn *rbn = rbt_find(&s->src_stats_rbt, &_ev.pub.recv.src);
 		struct ldms_msg_src_stats_s *ss;
 		struct ldms_msg_profile_ent *prof;
@@ -682,8 +952,8 @@ __msg_deliver(struct __msg_buf_s *sbuf, uint64_t msg_gn,
 			prof->profiles.hops[prof->profiles.hop_cnt].recv_ts = *recv_ts;
 			TAILQ_INSERT_TAIL(&ss->profiles, prof, ent);
 		}
+		pthread_rwlock_unlock(&s->rwlock);
 	}
-	pthread_rwlock_unlock(&s->rwlock);
  skip_stats:
 
 	gc = 0;
@@ -694,7 +964,7 @@ __msg_deliver(struct __msg_buf_s *sbuf, uint64_t msg_gn,
 			gc = 1;
 			continue;
 		}
-		if (!json && msg_type == LDMS_MSG_JSON && !c->x) {
+		if (!json && msg_type == LDMS_MSG_JSON && !c->x && !c->json_raw) {
 			/* json object is only required to parse once for
 			 * the local client */
 			struct json_parser_s *jp = json_parser_new(0);
@@ -703,7 +973,6 @@ __msg_deliver(struct __msg_buf_s *sbuf, uint64_t msg_gn,
 				goto cleanup;
 			}
 			rc = json_parse_buffer(jp, (void*)data, data_len, &json);
-			_ev.pub.recv.json = json;
 			json_parser_free(jp);
 			if (rc) {
 				goto cleanup;
@@ -712,6 +981,7 @@ __msg_deliver(struct __msg_buf_s *sbuf, uint64_t msg_gn,
 		ref_get(&c->ref, "callback");
 		pthread_rwlock_unlock(&s->rwlock);
 		_ev.pub.recv.client = c;
+		_ev.pub.recv.json = c->json_raw ? NULL : json;
 		rc = c->cb_fn(&_ev.pub, c->cb_arg);
 		if (__msg_stats_level > 0) {
 			pthread_rwlock_wrlock(&c->rwlock);
@@ -747,6 +1017,7 @@ __msg_deliver(struct __msg_buf_s *sbuf, uint64_t msg_gn,
 		}
 		pthread_rwlock_unlock(&s->rwlock);
 	}
+	__ch_put(s);
  out:
 	return rc;
 }
@@ -1006,9 +1277,6 @@ static void __client_ref_free(void *arg)
 		TAILQ_REMOVE(&c->ch_tq, sce, cli_ch_entry);
 		ref_put(&sce->ref, "cli_ch_entry");
 	}
-	if (c->is_regex) {
-		regfree(&c->regex);
-	}
 	free(c);
 }
 
@@ -1023,11 +1291,17 @@ __client_subscribe(struct ldms_msg_client_s *c)
 
 	if (c->is_regex) {
 		__MSG_WRLOCK();
+		c->pat = __pattern_get(c->match);
+		if (!c->pat) {
+			rc = errno;
+			__MSG_UNLOCK();
+			goto out;
+		}
 		TAILQ_INSERT_TAIL(&__regex_client_tq, c, entry);
 		ref_get(&c->ref, "__regex_client_tq");
 		RBT_FOREACH(rbn, &__msg_ch_rbt) {
 			s = container_of(rbn, struct ldms_msg_ch_s, rbn);
-			if (regexec(&c->regex, s->name, 0, NULL, 0))
+			if (regexec(&c->pat->regex, s->name, 0, NULL, 0))
 				continue; /* not matched */
 			/* matched; bind the client */
 			rc = __cli_ch_bind(c, s);
@@ -1043,6 +1317,7 @@ __client_subscribe(struct ldms_msg_client_s *c)
 			goto out;
 		}
 		rc = __cli_ch_bind(c, s);
+		__ch_put(s);
 		if (rc)
 			goto out;
 	}
@@ -1056,6 +1331,8 @@ __client_subscribe(struct ldms_msg_client_s *c)
 	if (c->is_regex) {
 		TAILQ_REMOVE(&__regex_client_tq, c, entry);
 		ref_put(&c->ref, "__regex_client_tq");
+		__pattern_put(c->pat);
+		c->pat = NULL;
 	}
 	__MSG_UNLOCK();
  out:
@@ -1068,7 +1345,7 @@ __client_alloc(const char *match, int is_regex,
 	       const char *desc)
 {
 	ldms_msg_client_t c;
-	int rc, slen = strlen(match) + 1;
+	int slen = strlen(match) + 1;
 	int dlen = (desc?strlen(desc):0) + 1;
 	c = calloc(1, sizeof(*c) + slen + dlen);
 	if (!c)
@@ -1086,12 +1363,7 @@ __client_alloc(const char *match, int is_regex,
 	c->cb_arg = cb_arg;
 	TAILQ_INIT(&c->ch_tq);
 	c->x = NULL;
-	if (is_regex) {
-		c->is_regex = 1;
-		rc = regcomp(&c->regex, c->match, REG_EXTENDED|REG_NOSUB);
-		if (rc)
-			goto err_0;
-	}
+	c->is_regex = !!is_regex;
 
 	LDMS_MSG_COUNTERS_INIT(&c->tx);
 	LDMS_MSG_COUNTERS_INIT(&c->drops);
@@ -1101,9 +1373,6 @@ __client_alloc(const char *match, int is_regex,
 	c->rate_quota.ts.tv_sec  = 0;
 	c->rate_quota.ts.tv_nsec = 0;
 
-	goto out;
- err_0:
-	free(c);
  out:
 	return c;
 }
@@ -1146,6 +1415,11 @@ ldms_msg_subscribe(const char *match, int is_regex,
 	return c;
 }
 
+void ldms_msg_client_json_raw_set(ldms_msg_client_t c, int enable)
+{
+	c->json_raw = !!enable;
+}
+
 void ldms_msg_client_close(ldms_msg_client_t c)
 {
 	struct ldms_msg_ch_cli_entry_s *sce;
@@ -1158,6 +1432,8 @@ void ldms_msg_client_close(ldms_msg_client_t c)
 	if (c->is_regex) {
 		TAILQ_REMOVE(&__regex_client_tq, c, entry);
 		ref_put(&c->ref, "__regex_client_tq");
+		__pattern_put(c->pat);
+		c->pat = NULL;
 	}
 	__MSG_UNLOCK();
 
@@ -1749,14 +2025,15 @@ struct ldms_msg_ch_stats_s * __msg_get_stats(struct ldms_msg_ch_s *s, int is_res
 	memcpy((char*)ss->name, s->name, s->name_len);
 	TAILQ_INIT(&ss->stats_tq);
 	rbt_init(&ss->src_stats_rbt, __ldms_addr_rbn_cmp);
-	LDMS_MSG_COUNTERS_INIT(&ss->rx);
-	ss->rx = s->rx;
+	__ch_rx_merge(s, &ss->rx, is_reset);
 
 	rc = __src_stats_rbt_copy(&s->src_stats_rbt, &ss->src_stats_rbt, is_reset);
 	if (rc)
 		goto err_1;
 
 	TAILQ_FOREACH(sce, &s->cli_tq, ch_cli_entry) {
+		if (!sce->cli)
+			continue; /* unbound; pending removal */
 		/* match_len already includes '\0' */
 		ps = malloc(sizeof(*ps) + sce->cli->match_len + sce->cli->desc_len);
 		if (!ps)
@@ -1773,8 +2050,6 @@ struct ldms_msg_ch_stats_s * __msg_get_stats(struct ldms_msg_ch_s *s, int is_res
 		if (is_reset)
 			LDMS_MSG_COUNTERS_INIT(&sce->tx);
 	}
-	if (is_reset)
-		LDMS_MSG_COUNTERS_INIT(&s->rx);
 
 	return ss;
 
@@ -2019,6 +2294,7 @@ void ldms_msg_stats_reset()
 	struct ldms_msg_ch_s *s;
 	struct ldms_msg_ch_cli_entry_s *sce;
 	struct ldms_msg_src_stats_s *src;
+	struct ldms_msg_counters_s ctr;
 	ldms_msg_client_t cli;
 
 	/*
@@ -2061,7 +2337,7 @@ void ldms_msg_stats_reset()
 			LDMS_MSG_COUNTERS_INIT(&cli->tx);
 			LDMS_MSG_COUNTERS_INIT(&cli->drops);
 		}
-		LDMS_MSG_COUNTERS_INIT(&s->rx);
+		__ch_rx_merge(s, &ctr, 1);
 		pthread_rwlock_unlock(&s->rwlock);
 	}
 
@@ -2115,6 +2391,8 @@ ldms_msg_client_get_stats(ldms_msg_client_t cli, int is_reset)
 	}
 
 	TAILQ_FOREACH(sce, &cli->ch_tq, cli_ch_entry) {
+		if (!sce->ch)
+			continue; /* unbound */
 		/* name_len included '\0' */
 		cps = malloc(sizeof(*cps) + sce->ch->name_len);
 		if (!cps)
@@ -2391,18 +2669,98 @@ int ldms_msg_is_enabled()
 
 static void __ldms_msg_init();
 
+/*
+ * Remove the channels that have been idle for `__msg_ch_idle_timeout` and
+ * have no exact-match client. The regex clients bound to such a channel are
+ * unbound; they are bound again by __ch_get() if the channel comes back.
+ */
+static void __ch_reclaim()
+{
+	struct rbn *rbn, *next;
+	struct ldms_msg_ch_s *s;
+	struct ldms_msg_ch_cli_entry_s *sce;
+	struct ldms_msg_client_s *c;
+	time_t now = time(NULL);
+	int n = 0;
+
+	__MSG_WRLOCK();
+	for (rbn = rbt_min(&__msg_ch_rbt); rbn; rbn = next) {
+		next = rbn_succ(rbn);
+		s = container_of(rbn, struct ldms_msg_ch_s, rbn);
+		if (__atomic_load_n(&s->busy, __ATOMIC_SEQ_CST))
+			continue;
+		if (now - __atomic_load_n(&s->last_active, __ATOMIC_RELAXED)
+				< __msg_ch_idle_timeout)
+			continue;
+		TAILQ_FOREACH(sce, &s->cli_tq, ch_cli_entry) {
+			if (sce->cli && !sce->cli->is_regex)
+				break;
+		}
+		if (sce)
+			continue; /* has an exact-match client */
+		rbt_del(&__msg_ch_rbt, rbn);
+		while ((sce = TAILQ_FIRST(&s->cli_tq))) {
+			TAILQ_REMOVE(&s->cli_tq, sce, ch_cli_entry);
+			c = sce->cli;
+			if (c) {
+				pthread_rwlock_wrlock(&c->rwlock);
+				TAILQ_REMOVE(&c->ch_tq, sce, cli_ch_entry);
+				sce->ch = NULL;
+				pthread_rwlock_unlock(&c->rwlock);
+				sce->cli = NULL;
+				ref_put(&sce->ref, "cli_ch_entry");
+				ref_put(&c->ref, "client_entry");
+			}
+			ref_put(&sce->ref, "ch_cli_entry");
+		}
+		__src_stats_rbt_purge(&s->src_stats_rbt);
+		pthread_rwlock_destroy(&s->rwlock);
+		free(s->rx_slot);
+		free(s);
+		n++;
+	}
+	__MSG_UNLOCK();
+	if (n)
+		__DEBUG("reclaimed %d idle channel(s)\n", n);
+}
+
 static void *__cli_close_proc(void *arg)
 {
 	struct ldms_msg_client_s *c;
 	struct ldms_msg_event_s ev;
+	struct timespec ts;
+	time_t period, next_sweep = 0;
 
 	pthread_atfork(NULL, NULL, __ldms_msg_init); /* re-initialize at fork */
 
+	/* sweep the idle channels a few times per timeout, at most every minute */
+	period = __msg_ch_idle_timeout / 2;
+	if (period > 60)
+		period = 60;
+	if (period < 1)
+		period = 1;
+
 	pthread_mutex_lock(&__client_close_mutex);
  loop:
 	c = TAILQ_FIRST(&__client_close_tq);
 	if (!c) {
-		pthread_cond_wait(&__client_close_cond, &__client_close_mutex);
+		if (!__msg_ch_idle_timeout) {
+			pthread_cond_wait(&__client_close_cond, &__client_close_mutex);
+			goto loop;
+		}
+		clock_gettime(CLOCK_REALTIME, &ts);
+		if (!next_sweep)
+			next_sweep = ts.tv_sec + period;
+		if (ts.tv_sec >= next_sweep) {
+			pthread_mutex_unlock(&__client_close_mutex);
+			__ch_reclaim();
+			pthread_mutex_lock(&__client_close_mutex);
+			next_sweep = ts.tv_sec + period;
+			goto loop;
+		}
+		ts.tv_sec = next_sweep;
+		ts.tv_nsec = 0;
+		pthread_cond_timedwait(&__client_close_cond, &__client_close_mutex, &ts);
 		goto loop;
 	}
 	TAILQ_REMOVE(&__client_close_tq, c, entry);
@@ -2428,6 +2786,13 @@ __attribute__((constructor))
 static void __ldms_msg_init()
 {
 	int rc;
+	char *var;
+	var = getenv("LDMS_MSG_CH_IDLE_TIMEOUT");
+	if (var) {
+		__msg_ch_idle_timeout = atoi(var);
+		if (__msg_ch_idle_timeout < 0)
+			__msg_ch_idle_timeout = 0;
+	}
 	pthread_mutex_init(&__client_close_mutex, NULL);
 	pthread_cond_init(&__client_close_cond, NULL);
 	if (!__ldms_msg_log)
@@ -65,12 +65,43 @@
 
 /* private structures / functions for LDMS Message Service */
 
+#define LDMS_MSG_RX_SLOTS 8
+
+/*
+ * A slot of channel rx counters. The delivering thread updates its own slot
+ * with atomics (no channel lock); the slots are merged into a single
+ * `struct ldms_msg_counters_s` when the stats are queried.
+ */
+struct ldms_msg_rx_slot_s {
+	uint64_t count;
+	uint64_t bytes;
+	uint64_t first_ns; /* 0 if no message has been counted */
+	uint64_t last_ns;
+} __attribute__((aligned(64)));
+
+/* A distinct regex among the regex clients; shared by the clients having the
+ * same `match` string. Protected by __msg_rwlock. */
+struct ldms_msg_pattern_s {
+	TAILQ_ENTRY(ldms_msg_pattern_s) entry;
+	regex_t regex;
+	int n_clients; /* the number of regex clients using this pattern */
+	int matched; /* scratch; valid only while holding __msg_rwlock write lock */
+	char match[OVIS_FLEX];
+};
+
 struct ldms_msg_ch_s {
 	struct rbn rbn;
 	pthread_rwlock_t rwlock; /* protects cli_tq */
 	TAILQ_HEAD(, ldms_msg_ch_cli_entry_s) cli_tq;
 	int name_len;
-	struct ldms_msg_counters_s rx; /* total rx regardless of src */
+	int busy; /* the number of threads using the channel (see __ch_get()) */
+	time_t last_active; /* the last time the channel was used (sec) */
+	/* total rx regardless of src, updated under `rwlock` until the channel
+	 * has its first client */
+	struct ldms_msg_counters_s rx;
+	/* total rx regardless of src, by delivering thread; LDMS_MSG_RX_SLOTS
+	 * slots allocated with the first client (see __cli_ch_bind()) */
+	struct ldms_msg_rx_slot_s *rx_slot;
 	struct rbt src_stats_rbt; /* tree of statistics by src; the nodes are `struct ldms_msg_src_stats_s` */
 	char name[OVIS_FLEX];
 };
@@ -115,7 +146,8 @@ struct ldms_msg_client_s {
 	ldms_msg_event_cb_t cb_fn;
 	void *cb_arg;
 	int is_regex;
-	regex_t regex;
+	int json_raw; /* do not parse LDMS_MSG_JSON data for this client */
+	struct ldms_msg_pattern_s *pat; /* the shared pattern if is_regex */
 	struct ref_s ref;
 
 	struct ldms_rail_rate_quota_s rate_quota;
@@ -1,3 +1,4 @@
+#include <pthread.h>
 #include "config.h"
 #include "ldms.h"
 
@@ -40,6 +41,123 @@ serdes_schema_t * serdes_schema_from_avro(serdes_t *sd, avro_schema_t asch)
 	return ssch;
 }
 
+int ldms_avro_enc_reserve(ldms_avro_enc_t enc, size_t sz)
+{
+	size_t alloc;
+	char *buf;
+
+	if (enc->err)
+		return enc->err;
+	if (enc->alloc - enc->len >= sz)
+		return 0;
+	alloc = enc->alloc ? enc->alloc : 1024;
+	while (alloc - enc->len < sz)
+		alloc *= 2;
+	buf = realloc(enc->buf, alloc);
+	if (!buf) {
+		enc->err = ENOMEM;
+		return ENOMEM;
+	}
+	enc->buf = buf;
+	enc->alloc = alloc;
+	return 0;
+}
+
+void ldms_avro_enc_free(ldms_avro_enc_t enc)
+{
+	free(enc->buf);
+	enc->buf = NULL;
+	enc->len = enc->alloc = 0;
+	enc->err = 0;
+}
+
+int ldms_avro_enc_framing(ldms_avro_enc_t enc, serdes_t *sd,
+			  serdes_schema_t *ssch)
+{
+	size_t sz = serdes_serializer_framing_size(sd);
+	ssize_t len;
+
+	if (!sz)
+		return ENOPROTOOPT;
+	if (ldms_avro_enc_reserve(enc, sz))
+		return enc->err;
+	len = serdes_framing_write(ssch, enc->buf + enc->len, sz);
+	if (len < 0) {
+		enc->err = EIO;
+		return EIO;
+	}
+	enc->len += len;
+	return 0;
+}
+
+int ldms_avro_enc_value(ldms_avro_enc_t enc, avro_value_t *value)
+{
+	avro_writer_t aw;
+	size_t sz;
+	int rc;
+
+	rc = avro_value_sizeof(value, &sz);
+	if (rc)
+		goto err;
+	if (ldms_avro_enc_reserve(enc, sz))
+		return enc->err;
+	aw = avro_writer_memory(enc->buf + enc->len, sz);
+	if (!aw) {
+		rc = ENOMEM;
+		goto err;
+	}
+	rc = avro_value_write(aw, value);
+	avro_writer_free(aw);
+	if (rc)
+		goto err;
+	enc->len += sz;
+	return 0;
+ err:
+	enc->err = rc;
+	return rc;
+}
+
+int ldms_msg_publish_avro_enc(ldms_t x, const char *stream_name,
+			      ldms_cred_t cred, uint32_t perm,
+			      ldms_avro_enc_t enc)
+{
+	if (enc->err)
+		return enc->err;
+	return ldms_msg_publish(x, stream_name, LDMS_MSG_AVRO_SER,
+				cred, perm, enc->buf, enc->len);
+}
+
+/* Per-thread encoding buffer for ldms_msg_publish_avro_ser() */
+static pthread_key_t __avro_enc_key;
+static pthread_once_t __avro_enc_once = PTHREAD_ONCE_INIT;
+
+static void __avro_enc_destroy(void *arg)
+{
+	ldms_avro_enc_free(arg);
+	free(arg);
+}
+
+static void __avro_enc_key_init(void)
+{
+	pthread_key_create(&__avro_enc_key, __avro_enc_destroy);
+}
+
+static ldms_avro_enc_t __avro_enc_get(void)
+{
+	ldms_avro_enc_t enc;
+
+	pthread_once(&__avro_enc_once, __avro_enc_key_init);
+	enc = pthread_getspecific(__avro_enc_key);
+	if (!enc) {
+		enc = calloc(1, sizeof(*enc));
+		if (!enc)
+			return NULL;
+		pthread_setspecific(__avro_enc_key, enc);
+	}
+	ldms_avro_enc_reset(enc);
+	return enc;
+}
+
 int ldms_msg_publish_avro_ser(ldms_t x, const char *stream_name,
 				 ldms_cred_t cred, uint32_t perm,
 				 avro_value_t *value, serdes_t *sd,
@@ -47,11 +165,8 @@ int ldms_msg_publish_avro_ser(ldms_t x, const char *stream_name,
 {
 	serdes_schema_t *ssch = NULL;
 	avro_schema_t asch;
-	char ebuf[4096];
-	serdes_err_t serr;
+	ldms_avro_enc_t enc;
 	int rc;
-	size_t sz;
-	void *payload;
 
 	if (0 == serdes_serializer_framing_size(sd)) {
 		/* Need serdes "serializer.framing" enabled */
@@ -69,17 +184,23 @@ int ldms_msg_publish_avro_ser(ldms_t x, const char *stream_name,
 	}
 	if (sch)
 		*sch = ssch;
-	payload = NULL;
-	serr = serdes_schema_serialize_avro(ssch, value, &payload, &sz,
-					    ebuf, sizeof(ebuf));
-	if (serr != SERDES_ERR_OK) {
+
+	/*
+	 * Encode the framing and the value into the reusable buffer of this
+	 * thread instead of a new buffer from serdes for every message.
+	 */
+	enc = __avro_enc_get();
+	if (!enc)
+		return ENOMEM;
+	rc = ldms_avro_enc_framing(enc, sd, ssch);
+	if (rc)
+		return rc;
+	rc = ldms_avro_enc_value(enc, value);
+	if (rc)
 		return EIO;
-	}
 
 	/* We can use existing stream_publish to publish the serialized data */
-	rc = ldms_msg_publish(x, stream_name, LDMS_MSG_AVRO_SER,
-				 cred, perm, payload, sz);
-	return rc;
+	return ldms_msg_publish_avro_enc(x, stream_name, cred, perm, enc);
 }
 
 static int avro_value_from_stream_data(const char *data, size_t data_len,
@@ -57,6 +57,9 @@
 #ifndef __LDMS_STREAM_AVRO_SER_H__
 #define __LDMS_STREAM_AVRO_SER_H__
 
+#include <stdint.h>
+#include <string.h>
+#include <endian.h>
 #include "ldms.h"
 #include "avro.h"
 #include "libserdes/serdes.h"
@@ -116,6 +119,144 @@ int ldms_msg_publish_avro_ser(ldms_t x, const char *stream_name,
 				 avro_value_t *value, serdes_t *serdes,
 				 struct serdes_schema_s **sch);
 
+/**
+ * \brief A reusable buffer for direct Avro binary encoding.
+ *
+ * The \c ldms_avro_enc_*() functions write the Avro binary encoding of
+ * primitive values (zig-zag varint \c int and \c long, little-endian
+ * \c float and \c double, length-prefixed \c string and array blocks)
+ * without building an \c avro_value_t. The caller must write the fields
+ * in the order of the Avro schema.
+ *
+ * A failed write sets \c err, and the following writes are ignored until
+ * the buffer is reset with \c ldms_avro_enc_reset(). The memory is kept
+ * across resets; release it with \c ldms_avro_enc_free().
+ */
+typedef struct ldms_avro_enc_s {
+	char *buf;	/**< The encoded bytes. */
+	size_t len;	/**< The number of bytes written. */
+	size_t alloc;	/**< The size of \c buf. */
+	int err;	/**< The first error, 0 if none. */
+} *ldms_avro_enc_t;
+
+/**
+ * \brief Make room for \c sz more bytes in \c enc.
+ *
+ * \retval 0 If success.
+ * \retval ENOMEM If the buffer could not be grown; \c enc->err is set.
+ */
+int ldms_avro_enc_reserve(ldms_avro_enc_t enc, size_t sz);
+
+/**
+ * \brief Release the memory of \c enc.
+ */
+void ldms_avro_enc_free(ldms_avro_enc_t enc);
+
+/**
+ * \brief Write the \c serdes framing (e.g. schema ID) of \c sch to \c enc.
+ *
+ * \retval 0 If success.
+ * \retval ENOPROTOOPT If \c serdes "serializer.framing" is disabled.
+ * \retval EIO If \c serdes failed to write the framing.
+ */
+int ldms_avro_enc_framing(ldms_avro_enc_t enc, serdes_t *serdes,
+			  struct serdes_schema_s *sch);
+
+/**
+ * \brief Write the Avro binary encoding of \c value to \c enc.
+ *
+ * \retval 0 If success.
+ * \retval errno If the value could not be encoded.
+ */
+int ldms_avro_enc_value(ldms_avro_enc_t enc, avro_value_t *value);
+
+static inline void ldms_avro_enc_reset(ldms_avro_enc_t enc)
+{
+	enc->len = 0;
+	enc->err = 0;
+}
+
+static inline void ldms_avro_enc_long(ldms_avro_enc_t enc, int64_t v)
+{
+	uint64_t n = ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); /* zig-zag */
+	char *p;
+	if (enc->alloc - enc->len < 10 && ldms_avro_enc_reserve(enc, 10))
+		return;
+	p = enc->buf + enc->len;
+	while (n & ~0x7FULL) {
+		*p++ = (char)((n & 0x7F) | 0x80);
+		n >>= 7;
+	}
+	*p++ = (char)n;
+	enc->len = p - enc->buf;
+}
+
+static inline void ldms_avro_enc_int(ldms_avro_enc_t enc, int32_t v)
+{
+	ldms_avro_enc_long(enc, v);
+}
+
+static inline void ldms_avro_enc_float(ldms_avro_enc_t enc, float v)
+{
+	union { float f; uint32_t u; } x = { .f = v };
+	if (enc->alloc - enc->len < 4 && ldms_avro_enc_reserve(enc, 4))
+		return;
+	x.u = htole32(x.u);
+	memcpy(enc->buf + enc->len, &x.u, 4);
+	enc->len += 4;
+}
+
+static inline void ldms_avro_enc_double(ldms_avro_enc_t enc, double v)
+{
+	union { double d; uint64_t u; } x = { .d = v };
+	if (enc->alloc - enc->len < 8 && ldms_avro_enc_reserve(enc, 8))
+		return;
+	x.u = htole64(x.u);
+	memcpy(enc->buf + enc->len, &x.u, 8);
+	enc->len += 8;
+}
+
+static inline void ldms_avro_enc_string(ldms_avro_enc_t enc,
+					const char *s, size_t len)
+{
+	ldms_avro_enc_long(enc, len);
+	if (enc->alloc - enc->len < len && ldms_avro_enc_reserve(enc, len))
+		return;
+	memcpy(enc->buf + enc->len, s, len);
+	enc->len += len;
+}
+
+/**
+ * \brief Start an array of \c count items.
+ *
+ * The items are written with the primitive writers, then the array is
+ * closed with \c ldms_avro_enc_array_end().
+ */
+static inline void ldms_avro_enc_array_begin(ldms_avro_enc_t enc, size_t count)
+{
+	if (count)
+		ldms_avro_enc_long(enc, count);
+}
+
+static inline void ldms_avro_enc_array_end(ldms_avro_enc_t enc)
+{
+	ldms_avro_enc_long(enc, 0);
+}
+
+/**
+ * \brief Publish the Avro/Serdes data encoded in \c enc.
+ *
+ * \c enc must start with the \c serdes framing written by
+ * \c ldms_avro_enc_framing(). The other parameters are the same as in
+ * \c ldms_msg_publish_avro_ser().
+ *
+ * \retval 0 If success.
+ * \retval errno The error in \c enc or from \c ldms_msg_publish().
+ */
+int ldms_msg_publish_avro_enc(ldms_t x, const char *stream_name,
+			      ldms_cred_t cred, uint32_t perm,
+			      ldms_avro_enc_t enc);
+
 /**
  * \brief Stream event for Avro/Serdes steam client.
  */
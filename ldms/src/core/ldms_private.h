@@ -121,6 +121,23 @@ struct ldms_set_info_pair {
 	LIST_ENTRY(ldms_set_info_pair) entry;
 };
 LIST_HEAD(ldms_set_info_list, ldms_set_info_pair);
+
+/*
+ * Set memory replaced by a heap resize. The peers that had looked up the
+ * set may still read the old memory, so it stays registered until each of
+ * them has acknowledged the resize or is gone. The memory of a mirror also
+ * stays until the RDMA reads into it that were in flight have completed.
+ */
+struct ldms_set_retired {
+	struct ldms_set_hdr *meta;
+	zap_map_t lmap;
+	uint32_t resize_gn;	/* the resize that retired the memory */
+	int n_peers;
+	uint64_t *peers;	/* conn_id of the peers that may read it */
+	LIST_ENTRY(ldms_set_retired) entry;
+};
+LIST_HEAD(ldms_set_retired_list, ldms_set_retired);
+
 struct ldms_set {
 	struct ref_s ref;
 	unsigned long flags;
@@ -131,7 +148,9 @@ struct ldms_set {
 	struct ldms_set_info_list local_info;
 	struct ldms_set_info_list remote_info; /*set info from the lookup operation */
 	struct rbn rb_node;	/* Indexed by instance name */
-	struct rbn id_node;	/* Indexed by set_id */
+	uint64_t name_hash;		/* Hash of the instance name */
+	struct ldms_set *name_hnext;	/* Sharded index by instance name */
+	struct ldms_set *id_hnext;	/* Sharded index by set_id */
 	struct rbn del_node;	/* Indexed by timestamp */
 	pthread_mutex_t lock;
 	int curr_idx;
@@ -149,6 +168,21 @@ struct ldms_set {
 	struct ldms_context *notify_ctxt; /* Notify req context */
 	ldms_heap_t heap;
 	struct ldms_heap_instance heap_inst;
+	struct ldms_set_retired_list retired; /* memory replaced by resize */
+	uint32_t resize_gn;	/* number of resizes of the set memory */
+	int read_cnt;		/* RDMA reads into the set memory in flight */
+
+	/*
+	 * Resize announced by the producer of a mirror set. It is applied
+	 * at the start of the next update or push when no RDMA read into
+	 * the set is outstanding.
+	 */
+	struct {
+		zap_map_t rmap;	/* the map of the new producer memory */
+		uint32_t meta_sz;
+		uint32_t data_sz;
+		uint32_t gn;	/* producer resize_gn */
+	} resize;
 
 	/*
 	 * Context of the ongoing update operation on the set
@@ -201,6 +235,13 @@ extern size_t __ldms_format_set_meta_as_json(struct ldms_set *set,
 extern int __ldms_for_all_sets(int (*cb)(struct ldms_set *, void *), void *arg);
 
 extern uint32_t __ldms_set_size_get(struct ldms_set *s);
+extern int __ldms_set_resize_apply(struct ldms_set *s);
+extern void __ldms_set_resize_notify(struct ldms_set *s);
+extern void __ldms_set_resize_done(struct ldms_set *s, uint32_t resize_gn);
+extern void __ldms_set_retired_drop(struct ldms_set *s, uint64_t conn_id,
+				    uint32_t resize_gn);
+extern void __ldms_set_read_begin(struct ldms_set *s);
+extern void __ldms_set_read_end(struct ldms_set *s, int release);
 extern void __ldms_metric_size_get(const char *name, const char *unit,
 				   enum ldms_value_type t,
 				   uint32_t count, size_t *meta_sz, size_t *data_sz);
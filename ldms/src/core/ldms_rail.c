@@ -98,6 +98,8 @@ static int __rail_dir(ldms_t _r, ldms_dir_cb_t cb, void *cb_arg, uint32_t flags)
 static int __rail_dir_cancel(ldms_t _r);
 static int __rail_lookup(ldms_t _r, const char *name, enum ldms_lookup_flags flags,
 	       ldms_lookup_cb_t cb, void *cb_arg, struct ldms_op_ctxt *op_ctxt);
+static int __rail_lookup_multi(ldms_t _r, int count, const char *names[],
+			       ldms_lookup_cb_t cb, void *cb_args[]);
 static int __rail_stats(ldms_t _r, ldms_xprt_stats_t stats, int mask, int is_reset);
 
 #define __rail_get(_r_, _n_) ___rail_get((_r_), (_n_), __func__, __LINE__)
@@ -128,6 +130,7 @@ static struct ldms_xprt_ops_s __rail_ops = {
 	.dir          = __rail_dir,
 	.dir_cancel   = __rail_dir_cancel,
 	.lookup       = __rail_lookup,
+	.lookup_multi = __rail_lookup_multi,
 	.stats        = __rail_stats,
 
 	.get          = ___rail_get,
@@ -275,6 +278,7 @@ ldms_t ldms_xprt_rail_new(const char *xprt_name,
 	r->n_eps = n;
 	r->recv_quota = recv_quota;
 	r->recv_rate_limit = rate_limit;
+	r->tpi = -1;
 	rbt_init(&r->ch_cli_rbt, __str_rbn_cmp);
 
 	snprintf(r->name, sizeof(r->name), "%s", xprt_name);
@@ -691,6 +695,8 @@ void __rail_zap_handle_conn_req(zap_ep_t zep, zap_event_t ev)
 	struct ldms_rail_s *r, *lr = NULL;
 	struct ldms_rail_ep_s *rep;
 	struct rbn *rbn;
+	uint32_t peer_caps = 0;
+	size_t msg_len;
 
 	rep = ldms_xprt_ctxt_get(lx);
 	if (rep)
@@ -714,6 +720,16 @@ void __rail_zap_handle_conn_req(zap_ep_t zep, zap_event_t ev)
 		break;
 	}
 
+	/*
+	 * A peer that sends the short message does not know about \c caps and
+	 * requires the accept message to have the same length.
+	 */
+	if (ev->data_len >= sizeof(*m)) {
+		peer_caps = ntohl(m->caps) & LDMS_PEER_CAPS;
+		msg_len = sizeof(msg);
+	} else {
+		msg_len = LDMS_RAIL_CONN_MSG_V0_LEN;
+	}
 	__rail_conn_msg_ntoh(m);
 
 	rail_id.ip4_addr = peer_addr.sin.sin_addr.s_addr;
@@ -819,6 +835,7 @@ void __rail_zap_handle_conn_req(zap_ep_t zep, zap_event_t ev)
 	_x->zap = lx->zap;
 	_x->zap_ep = zep;
 	_x->max_msg = zap_max_msg(lx->zap);
+	_x->peer_caps = peer_caps;
 
 	/* interpose */
 	_x->event_cb = __rail_cb;
@@ -852,7 +869,7 @@ void __rail_zap_handle_conn_req(zap_ep_t zep, zap_event_t ev)
 	ldms_xprt_get(_x, "connect");
 
 	ref_get(&r->ref, "ldms_accepting");
-	zerr = zap_accept2(zep, ldms_zap_auto_cb, (void*)&msg, sizeof(msg), m->idx);
+	zerr = zap_accept2(zep, ldms_zap_auto_cb, (void*)&msg, msg_len, m->idx);
 	if (zerr) {
 		RAIL_LOG("ERROR: %d accepting connection from %s.\n", zerr, name);
 		goto err_3;
@@ -889,6 +906,7 @@ static void __ldms_rail_conn_msg_init(struct ldms_rail_s *r, int idx, struct ldm
 	m->pid = htonl(getpid());
 	m->rail_gn = htobe64(r->rail_id.rail_gn);
 	m->msg_enabled = htonl(ldms_msg_enabled);
+	m->caps = htonl(LDMS_PEER_CAPS);
 }
 
 static int __rail_ep_connect(ldms_t x, struct sockaddr *sa, socklen_t sa_len,
@@ -904,7 +922,8 @@ static int __rail_ep_connect(ldms_t x, struct sockaddr *sa, socklen_t sa_len,
 	x->event_cb = cb;
 	x->event_cb_arg = cb_arg;
 	ldms_xprt_get(x, "connect");
-	rc = zap_connect2(x->zap_ep, sa, sa_len, (void*)&msg, sizeof(msg), rep->idx);
+	rc = zap_connect2(x->zap_ep, sa, sa_len, (void*)&msg, sizeof(msg),
+			  (r->tpi < 0)?rep->idx:(r->tpi + rep->idx));
 	return rc;
 }
 
@@ -1286,6 +1305,77 @@ static int __rail_lookup(ldms_t _r, const char *name, enum ldms_lookup_flags fla
 	return rc;
 }
 
+typedef
+struct ldms_rail_lookup_multi_ctxt_s {
+	ldms_rail_t r;
+	ldms_lookup_cb_t app_cb;
+	int remaining; /* names not yet completed */
+	struct ldms_rail_lookup_multi_ent_s {
+		struct ldms_rail_lookup_multi_ctxt_s *lm;
+		void *cb_arg;
+	} ent[OVIS_FLEX];
+} *ldms_rail_lookup_multi_ctxt_t;
+
+void __rail_lookup_multi_cb(ldms_t x, enum ldms_lookup_status status,
+			    int more, ldms_set_t s, void *arg)
+{
+	struct ldms_rail_lookup_multi_ent_s *ent = arg;
+	ldms_rail_lookup_multi_ctxt_t lm = ent->lm;
+	lm->app_cb((void*)lm->r, status, more, s, ent->cb_arg);
+	if (0 == __atomic_sub_fetch(&lm->remaining, 1, __ATOMIC_SEQ_CST))
+		free(lm);
+}
+
+static int __rail_lookup_multi(ldms_t _r, int count, const char *names[],
+			       ldms_lookup_cb_t cb, void *cb_args[])
+{
+	ldms_rail_t r = (ldms_rail_t)_r;
+	int i, rc;
+	struct ldms_rail_ep_s *rep;
+	ldms_rail_lookup_multi_ctxt_t lm;
+	void **args;
+
+	if (!cb || count <= 0)
+		return EINVAL;
+	pthread_mutex_lock(&r->mutex);
+	if (r->state != LDMS_RAIL_EP_CONNECTED) {
+		rc = ENOTCONN;
+		goto out;
+	}
+	/* All endpoints of a rail connect to the same peer */
+	if (!(r->eps[0].ep->peer_caps & LDMS_PEER_CAP_LOOKUP_MULTI)) {
+		rc = ENOTSUP;
+		goto out;
+	}
+	lm = malloc(sizeof(*lm) + count * sizeof(lm->ent[0]));
+	args = malloc(count * sizeof(*args));
+	if (!lm || !args) {
+		free(lm);
+		free(args);
+		rc = ENOMEM;
+		goto out;
+	}
+	lm->r = r;
+	lm->app_cb = cb;
+	lm->remaining = count;
+	for (i = 0; i < count; i++) {
+		lm->ent[i].lm = lm;
+		lm->ent[i].cb_arg = cb_args[i];
+		args[i] = &lm->ent[i];
+	}
+	/* All of the sets in one request are looked up on the same endpoint */
+	rep = &r->eps[r->lookup_rr++];
+	r->lookup_rr %= r->n_eps;
+	rc = rep->ep->ops.lookup_multi(rep->ep, count, names,
+				       __rail_lookup_multi_cb, args);
+	free(args);
+	if (rc)
+		free(lm); /* synchronous error, no callback was called */
+ out:
+	pthread_mutex_unlock(&r->mutex);
+	return rc;
+}
+
 static int __rail_stats(ldms_t _r, struct ldms_xprt_stats_s *stats, int mask, int is_reset)
 {
 	int i, rc;
@@ -1524,6 +1614,23 @@ int ldms_xprt_is_remote_rail(ldms_t x)
 	return r->eps[0].remote_is_rail == 1;
 }
 
+int ldms_xprt_rail_thread_pool_set(ldms_t _r, int tpi)
+{
+	ldms_rail_t r = (void*)_r;
+	int rc = 0;
+	if (!_r || !XTYPE_IS_RAIL(_r->xtype))
+		return -EINVAL;
+	pthread_mutex_lock(&r->mutex);
+	if (r->state != LDMS_RAIL_EP_INIT) {
+		rc = -EBUSY;
+		goto out;
+	}
+	r->tpi = (tpi < 0)?-1:tpi;
+ out:
+	pthread_mutex_unlock(&r->mutex);
+	return rc;
+}
+
 int ldms_xprt_rail_eps(ldms_t _r)
 {
 	ldms_rail_t r = (void*)_r;
@@ -1571,10 +1678,12 @@ void __rail_ep_limit(ldms_t x, void *msg, int msg_len)
 	struct ldms_rail_ep_s *rep = ldms_xprt_ctxt_get(x);
 	struct ldms_rail_conn_msg_s *conn_msg = msg;
 
-	if (msg_len != sizeof(*conn_msg))
+	if (msg_len != sizeof(*conn_msg) && msg_len != LDMS_RAIL_CONN_MSG_V0_LEN)
 		goto unlimited;
 	if (conn_msg->conn_type != htonl(LDMS_CONN_TYPE_RAIL))
 		goto unlimited;
+	if (msg_len == sizeof(*conn_msg))
+		x->peer_caps = ntohl(conn_msg->caps) & LDMS_PEER_CAPS;
 	/* This does not race; during end point setup */
 	rep->rail->send_quota = be64toh(conn_msg->recv_quota);
 	rep->rail->send_rate_limit = be64toh(conn_msg->rate_limit);
@@ -1831,9 +1940,7 @@ static ldms_set_t __rail_set_by_name(ldms_t _x, const char *set_name)
 
 	assert(XTYPE_IS_RAIL(r->xtype));
 
-	__ldms_set_tree_lock();
 	set = __ldms_find_local_set(set_name);
-	__ldms_set_tree_unlock();
 	if (!set)
 		return NULL;
 	for (i = 0; i < r->n_eps; i++) {
@@ -58,6 +58,7 @@
 #ifndef __LDMS_RAIL_H__
 #define __LDMS_RAIL_H__
 #include <semaphore.h>
+#include <stddef.h>
 #include <arpa/inet.h>
 
 #include "ovis_ref/ref.h"
@@ -92,9 +93,14 @@ struct ldms_rail_conn_msg_s {
 
 	int msg_enabled; /* 0 if peer does not enable message service */
 
+	/* -------- absent in messages from older peers */
+	uint32_t caps; /* LDMS_PEER_CAP_* bits */
 };
 #pragma pack(pop)
 
+/* Length of the rail connect message of peers that do not send \c caps */
+#define LDMS_RAIL_CONN_MSG_V0_LEN offsetof(struct ldms_rail_conn_msg_s, caps)
+
 typedef enum ldms_rail_ep_state_e {
 	LDMS_RAIL_EP_INIT = 0,
 	LDMS_RAIL_EP_LISTENING,
@@ -211,6 +217,7 @@ struct ldms_rail_s {
 	struct timespec disconnected_ts;
 
 	uint32_t lookup_rr; /* lookup round-robin index */
+	int tpi; /* base zap thread pool index, -1 for default */
 
 	int    connected_eps; /* track the number of connected endpoints */
 	int    connecting_eps; /* track the number of outstanding connecting/accepting endpoints */
@@ -356,6 +356,10 @@ struct ldms_context *__ldms_alloc_ctxt(struct ldms_xprt *x, size_t sz,
 		ctxt->lu_read.more = va_arg(ap, int);
 		ctxt->lu_read.flags = va_arg(ap, enum ldms_lookup_flags);
 		break;
+	case LDMS_CONTEXT_LOOKUP_MULTI:
+		ctxt->lu_multi.cb = va_arg(ap, ldms_lookup_cb_t);
+		ctxt->lu_multi.count = va_arg(ap, int);
+		break;
 	case LDMS_CONTEXT_UPDATE:
 	case LDMS_CONTEXT_UPDATE_META:
 		ctxt->update.s = va_arg(ap, ldms_set_t);
@@ -405,6 +409,9 @@ void __ldms_free_ctxt(struct ldms_xprt *x, struct ldms_context *ctxt)
 	case LDMS_CONTEXT_LOOKUP_REQ:
 		free(ctxt->lu_req.path);
 		break;
+	case LDMS_CONTEXT_LOOKUP_MULTI:
+		/* names, cb_args and done live in the context allocation */
+		break;
 	case LDMS_CONTEXT_LOOKUP_READ:
 		e = &x->stats.ops[LDMS_XPRT_OP_LOOKUP];
 		if (ctxt->lu_read.s)
@@ -546,6 +553,114 @@ static void send_req_notify_reply(struct ldms_xprt *x,
 	return;
 }
 
+static void send_resize(struct ldms_xprt *x, zap_map_t lmap,
+			struct ldms_rendezvous_msg *msg, size_t len)
+{
+	if (!ldms_xprt_connected(x))
+		return;
+
+	zap_err_t zerr = zap_share(x->zap_ep, lmap, (const char *)msg, len);
+	if (zerr != ZAP_ERR_OK) {
+		x->zerrno = zerr;
+		XPRT_LOG(x, OVIS_LERROR, "%s. zap_share synchronously error. '%s'\n",
+				__FUNCTION__, zap_err_str(zerr));
+	}
+}
+
+/*
+ * A peer that does not implement the resize would keep reading the old
+ * memory, so it is disconnected instead; it looks the set up again when
+ * it reconnects.
+ *
+ * The peers are collected under the set lock and notified without it,
+ * since zap_share() and the termination may call back into code that
+ * takes the set lock. The new memory stays mapped while they are notified:
+ * a later resize retires it for the same peers.
+ */
+void __ldms_set_resize_notify(struct ldms_set *set)
+{
+	struct rbn *rbn;
+	struct ldms_lookup_peer *p;
+	struct ldms_rendezvous_msg *msg = NULL;
+	ldms_name_t name;
+	ldms_t *peers;
+	zap_map_t lmap;
+	size_t len = 0;
+	int i, n = 0;
+
+	pthread_mutex_lock(&set->lock);
+	RBT_FOREACH(rbn, &set->lookup_coll)
+		n++;
+	if (!n) {
+		pthread_mutex_unlock(&set->lock);
+		return;
+	}
+	peers = calloc(n, sizeof(*peers));
+	name = get_instance_name(set->meta);
+	len = sizeof(struct ldms_rendezvous_hdr)
+		+ sizeof(struct ldms_rendezvous_resize_param) + name->len;
+	msg = calloc(1, len);
+	if (!peers || !msg) {
+		pthread_mutex_unlock(&set->lock);
+		ovis_log(xlog, OVIS_LCRITICAL, "Memory allocation failure "
+			 "in resize of set '%s'.\n", name->name);
+		free(peers);
+		free(msg);
+		return;
+	}
+	msg->hdr.xid = 0;
+	msg->hdr.cmd = htonl(LDMS_XPRT_RENDEZVOUS_RESIZE);
+	msg->hdr.len = htonl(len);
+	msg->resize.set_id = set->set_id;
+	msg->resize.meta_len = htonl(__le32_to_cpu(set->meta->meta_sz));
+	msg->resize.data_len = htonl(__le32_to_cpu(set->meta->data_sz));
+	msg->resize.resize_gn = htonl(set->resize_gn);
+	msg->resize.name_len = htonl(name->len);
+	memcpy(msg->resize.inst_name, name->name, name->len);
+	lmap = set->lmap;
+	n = 0;
+	RBT_FOREACH(rbn, &set->lookup_coll) {
+		p = container_of(rbn, struct ldms_lookup_peer, rbn);
+		peers[n++] = ldms_xprt_get(p->xprt, "resize_notify");
+	}
+	pthread_mutex_unlock(&set->lock);
+
+	for (i = 0; i < n; i++) {
+		if (peers[i]->peer_caps & LDMS_PEER_CAP_SET_RESIZE) {
+			send_resize(peers[i], lmap, msg, len);
+		} else {
+			XPRT_LOG(peers[i], OVIS_LINFO, "%s: the peer cannot "
+				 "resize set '%s', disconnecting.\n", __func__,
+				 msg->resize.inst_name);
+			__ldms_xprt_term(peers[i]);
+		}
+		ldms_xprt_put(peers[i], "resize_notify");
+	}
+	free(msg);
+	free(peers);
+}
+
+/* Tell the producer that the mirror \c s has switched to the new map */
+void __ldms_set_resize_done(struct ldms_set *s, uint32_t resize_gn)
+{
+	struct ldms_xprt *x = s->xprt;
+	struct ldms_request req;
+	size_t len;
+
+	if (!x || !ldms_xprt_connected(x))
+		return;
+	len = sizeof(struct ldms_request_hdr)
+		+ sizeof(struct ldms_resize_done_cmd_param);
+	req.hdr.xid = 0;
+	req.hdr.cmd = htonl(LDMS_CMD_RESIZE_DONE);
+	req.hdr.len = htonl(len);
+	req.resize_done.set_id = s->remote_set_id;
+	req.resize_done.resize_gn = htonl(resize_gn);
+	zap_err_t zerr = zap_send(x->zap_ep, &req, len);
+	if (zerr)
+		x->zerrno = zerr;
+}
+
 char *__ldms_format_set_for_dir(struct ldms_set *set, size_t *buf_sz)
 {
 	size_t json_buf_sz = 4096;
@@ -691,6 +806,12 @@ void __ldms_xprt_resource_free(struct ldms_xprt *x)
 		case LDMS_CONTEXT_LOOKUP_REQ:
 			x->active_lookup--;
 			break;
+		case LDMS_CONTEXT_LOOKUP_MULTI:
+			for (int i = 0; i < ctxt->lu_multi.count; i++) {
+				if (!ctxt->lu_multi.done[i])
+					x->active_lookup--;
+			}
+			break;
 		case LDMS_CONTEXT_PUSH:
 			x->active_push--;
 			break;
@@ -755,9 +876,7 @@ static void process_set_delete_request(struct ldms_xprt *x, struct ldms_request
 	 * Always notify the application about peer set delete. If we happened
 	 * not to have the set yet, `event.set_delete.set` will be NULL.
 	 */
-	__ldms_set_tree_lock();
 	set = __ldms_find_local_set(req->set_delete.inst_name);
-	__ldms_set_tree_unlock();
 	if (set) {
 		if (set->xprt != x) {
 			assert(set->xprt != x);
@@ -891,9 +1010,7 @@ static void process_dir_request(struct ldms_xprt *x, struct ldms_request *req)
 	}
 	struct ldms_set *set;
 	LIST_FOREACH(name, &name_list, entry) {
-		__ldms_set_tree_lock();
 		set = __ldms_find_local_set(name->name);
-		__ldms_set_tree_unlock();
 		if (!set)
 			continue;
 		uid = __le32_to_cpu(set->meta->uid);
@@ -1102,6 +1219,18 @@ process_req_notify_request(struct ldms_xprt *x, struct ldms_request *req)
 	pthread_mutex_unlock(&x->lock);
 }
 
+static void
+process_resize_done_request(struct ldms_xprt *x, struct ldms_request *req)
+{
+	ldms_set_t set = __ldms_set_by_id(req->resize_done.set_id);
+	if (!set)
+		return;
+	pthread_mutex_lock(&set->lock);
+	__ldms_set_retired_drop(set, x->conn_id,
+				ntohl(req->resize_done.resize_gn));
+	pthread_mutex_unlock(&set->lock);
+}
+
 static void
 process_cancel_notify_request(struct ldms_xprt *x, struct ldms_request *req)
 {
@@ -1313,6 +1442,7 @@ static int __add_lookup_peer(struct ldms_xprt *x, struct ldms_set *set)
 remove_peer:
 	pthread_mutex_lock(&set->lock);
 	rbt_del(&set->lookup_coll, &lp->rbn);
+	__ldms_set_retired_drop(set, x->conn_id, UINT32_MAX);
 	pthread_mutex_unlock(&set->lock);
 	ldms_xprt_put(lp->xprt, "lookup_peer");
 	free(lp);
@@ -1496,17 +1626,15 @@ static void process_lookup_request_re(struct ldms_xprt *x, struct ldms_request *
 			goto err_0;
 		}
 	} else if (0 == (flags & LDMS_LOOKUP_BY_SCHEMA)) {
-		__ldms_set_tree_lock();
 		set = __ldms_find_local_set(req->lookup.path);
 		if (!set) {
 			rc = ENOENT;
-			goto err_1;
+			goto err_0;
 		}
-		__ldms_set_tree_unlock();
 		rc = __send_lookup_reply(x, set, req->hdr.xid, 0);
 		ref_put(&set->ref, "__ldms_find_local_set");
 		if (rc)
-			goto err_1;
+			goto err_0;
 		return;
 	}
 
@@ -1576,6 +1704,86 @@ static void process_lookup_request(struct ldms_xprt *x, struct ldms_request *req
 	process_lookup_request_re(x, req, flags);
 }
 
+/**
+ * This function processes the multi-set lookup request from another peer.
+ *
+ * Each set that is found is shared with ::zap_share() in its own
+ * rendezvous message, as in the single lookup. The status of every name
+ * is then returned in one LDMS_CMD_LOOKUP_MULTI_REPLY, which the peer
+ * uses to complete the names that were not shared.
+ */
+static void process_lookup_multi_request(struct ldms_xprt *x, struct ldms_request *req)
+{
+	struct ldms_reply *reply;
+	struct ldms_reply_hdr hdr;
+	struct ldms_set *set;
+	uint32_t count = ntohl(req->lookup_multi.count);
+	uint32_t names_len = ntohl(req->lookup_multi.names_len);
+	const char *name = req->lookup_multi.names;
+	const char *end;
+	size_t len;
+	int i, rc;
+	zap_err_t zerr;
+
+	len = sizeof(struct ldms_request_hdr)
+		+ sizeof(struct ldms_lookup_multi_cmd_param);
+	if (ntohl(req->hdr.len) < len || names_len > ntohl(req->hdr.len) - len
+	    || count > names_len) {
+		rc = EINVAL;
+		goto err;
+	}
+	end = name + names_len;
+	len = sizeof(struct ldms_reply_hdr)
+		+ sizeof(struct ldms_lookup_multi_reply)
+		+ count * sizeof(uint32_t);
+	reply = malloc(len);
+	if (!reply) {
+		rc = ENOMEM;
+		goto err;
+	}
+	for (i = 0; i < count; i++) {
+		if (name >= end || !memchr(name, '\0', end - name)) {
+			reply->lookup_multi.status[i] = htonl(EINVAL);
+			continue;
+		}
+		set = __ldms_find_local_set(name);
+		if (set) {
+			rc = __xprt_set_access_check(x, set, LDMS_ACCESS_READ);
+			if (!rc)
+				rc = __send_lookup_reply(x, set, req->hdr.xid, 1);
+			ref_put(&set->ref, "__ldms_find_local_set");
+		} else {
+			rc = ENOENT;
+		}
+		reply->lookup_multi.status[i] = htonl(rc);
+		name += strlen(name) + 1;
+	}
+	reply->hdr.rc = 0;
+	reply->hdr.xid = req->hdr.xid;
+	reply->hdr.cmd = htonl(LDMS_CMD_LOOKUP_MULTI_REPLY);
+	reply->hdr.len = htonl(len);
+	reply->lookup_multi.count = htonl(count);
+	zerr = zap_send(x->zap_ep, reply, len);
+	free(reply);
+	if (zerr != ZAP_ERR_OK)
+		goto err_send;
+	return;
+ err:
+	hdr.rc = htonl(rc);
+	hdr.xid = req->hdr.xid;
+	hdr.cmd = htonl(LDMS_CMD_LOOKUP_MULTI_REPLY);
+	hdr.len = htonl(sizeof(struct ldms_reply_hdr));
+	zerr = zap_send(x->zap_ep, &hdr, sizeof(hdr));
+	if (zerr == ZAP_ERR_OK)
+		return;
+ err_send:
+	x->zerrno = zerr;
+	XPRT_LOG(x, OVIS_LERROR, "%s: x %p: "
+		"zap_send synchronously failed with '%s'\n",
+		__func__, x, zap_err_str(zerr));
+	ldms_xprt_close(x);
+}
+
 static int do_read_all(ldms_t x, ldms_set_t s, ldms_update_cb_t cb, void *arg)
 {
 	/* Read metadata and the first set in the set array in 1 RDMA read. */
@@ -1609,10 +1817,12 @@ static int do_read_all(ldms_t x, ldms_set_t s, ldms_update_cb_t cb, void *arg)
 			 */
 		}
 	}
+	__ldms_set_read_begin(s);
 	rc = zap_read(x->zap_ep, s->rmap, zap_map_addr(s->rmap),
 		      s->lmap, zap_map_addr(s->lmap), len, ctxt);
 	if (rc) {
 		x->zerrno = rc;
+		__ldms_set_read_end(s, 0);
 		__ldms_free_ctxt(x, ctxt);
 	}
 out:
@@ -1648,10 +1858,12 @@ static int do_read_meta(ldms_t x, ldms_set_t s, ldms_update_cb_t cb, void *arg)
 			 */
 		}
 	}
+	__ldms_set_read_begin(s);
 	rc = zap_read(x->zap_ep, s->rmap, zap_map_addr(s->rmap),
 			s->lmap, zap_map_addr(s->lmap), meta_sz, ctxt);
 	if (rc) {
 		x->zerrno = rc;
+		__ldms_set_read_end(s, 0);
 		__ldms_free_ctxt(x, ctxt);
 	}
 out:
@@ -1694,11 +1906,13 @@ static int do_read_data(ldms_t x, ldms_set_t s, int idx_from, int idx_to,
 			 */
 		}
 	}
+	__ldms_set_read_begin(s);
 	rc = zap_read(x->zap_ep, s->rmap, zap_map_addr(s->rmap) + doff,
 		      s->lmap, zap_map_addr(s->lmap) + doff, dlen, ctxt);
 	if (rc) {
 		x->zerrno = rc;
 		rc = zap_zerr2errno(rc);
+		__ldms_set_read_end(s, 0);
 		__ldms_free_ctxt(x, ctxt);
 	}
 out:
@@ -1727,6 +1941,12 @@ int __ldms_remote_update(ldms_t x, ldms_set_t s, ldms_update_cb_t cb, void *arg)
 	if (LDMS_XPRT_AUTH_GUARD(x))
 		return EPERM;
 	int rc;
+	if (s->resize.rmap) {
+		/* The producer has resized the set */
+		rc = __ldms_set_resize_apply(s);
+		if (rc)
+			return rc;
+	}
 	uint32_t meta_meta_gn = __le32_to_cpu(s->meta->meta_gn);
 	uint32_t data_meta_gn = __le32_to_cpu(s->data->meta_gn);
 	uint32_t n = __le32_to_cpu(s->meta->array_card);
@@ -1783,6 +2003,9 @@ int ldms_xprt_recv_request(struct ldms_xprt *x, struct ldms_request *req)
 	case LDMS_CMD_LOOKUP:
 		process_lookup_request(x, req);
 		break;
+	case LDMS_CMD_LOOKUP_MULTI:
+		process_lookup_multi_request(x, req);
+		break;
 	case LDMS_CMD_DIR:
 		process_dir_request(x, req);
 		break;
@@ -1798,6 +2021,9 @@ int ldms_xprt_recv_request(struct ldms_xprt *x, struct ldms_request *req)
 	case LDMS_CMD_CANCEL_PUSH:
 		process_cancel_push_request(x, req);
 		break;
+	case LDMS_CMD_RESIZE_DONE:
+		process_resize_done_request(x, req);
+		break;
 	case LDMS_CMD_SEND_MSG:
 		process_send_request(x, req);
 		break;
@@ -1871,6 +2097,41 @@ out:
 	pthread_mutex_unlock(&x->lock);
 }
 
+/*
+ * Complete every name of a multi-set lookup that was not completed by a
+ * rendezvous and free the request context.
+ */
+static
+void process_lookup_multi_reply(struct ldms_xprt *x, struct ldms_reply *reply,
+				struct ldms_context *ctxt)
+{
+	int i, status;
+	int rc = ntohl(reply->hdr.rc);
+	int count = 0;
+
+	if (!rc && ntohl(reply->hdr.len) >= sizeof(struct ldms_reply_hdr)
+					+ sizeof(struct ldms_lookup_multi_reply))
+		count = ntohl(reply->lookup_multi.count);
+	for (i = 0; i < ctxt->lu_multi.count; i++) {
+		if (ctxt->lu_multi.done[i])
+			continue;
+		if (rc)
+			status = rc;
+		else if (i < count && reply->lookup_multi.status[i])
+			status = ntohl(reply->lookup_multi.status[i]);
+		else
+			status = EIO; /* shared but no rendezvous was received */
+		ctxt->lu_multi.done[i] = 1;
+		ctxt->lu_multi.cb(x, status, 0, NULL, ctxt->lu_multi.cb_args[i]);
+#ifdef DEBUG
+		x->active_lookup--;
+#endif /* DEBUG */
+	}
+	pthread_mutex_lock(&x->lock);
+	__ldms_free_ctxt(x, ctxt);
+	pthread_mutex_unlock(&x->lock);
+}
+
 static
 void process_dir_cancel_reply(struct ldms_xprt *x, struct ldms_reply *reply,
 		struct ldms_context *ctxt)
@@ -2196,6 +2457,15 @@ static void process_push_reply(struct ldms_xprt *x, struct ldms_reply *reply,
 	if (rc)
 		return; /* NOTE should we terminate the xprt? */
 
+	if (set->resize.rmap && 0 == data_off)
+		(void)__ldms_set_resize_apply(set);
+	if (data_off + data_len > __ldms_set_size_get(set)) {
+		XPRT_LOG(x, OVIS_LERROR, "%s: push of %u bytes at %u exceeds "
+			 "the size of set '%s'\n", __func__, data_len, data_off,
+			 ldms_set_instance_name_get(set));
+		return;
+	}
+
 	/* Copy the data to the metric set */
 	if (data_len) {
 		memcpy((char *)set->meta + data_off,
@@ -2255,6 +2525,9 @@ static int ldms_xprt_recv_reply(struct ldms_xprt *x, struct ldms_reply *reply)
 	case LDMS_CMD_LOOKUP_REPLY:
 		process_lookup_reply(x, reply, ctxt);
 		break;
+	case LDMS_CMD_LOOKUP_MULTI_REPLY:
+		process_lookup_multi_reply(x, reply, ctxt);
+		break;
 	case LDMS_CMD_DIR_REPLY:
 		process_dir_reply(x, reply, ctxt);
 		break;
@@ -2626,6 +2899,21 @@ static void handle_zap_read_complete(zap_ep_t zep, zap_event_t ev)
 	struct ldms_xprt *x = zap_get_ucontext(zep);
 	struct ldms_thrstat *thrstat = zap_thrstat_ctxt_get(x->zap_ep);
 
+	/* The read has landed; release the memory retired meanwhile */
+	switch (ctxt->type) {
+	case LDMS_CONTEXT_UPDATE:
+	case LDMS_CONTEXT_UPDATE_META:
+		if (ctxt->update.s)
+			__ldms_set_read_end(ctxt->update.s, 1);
+		break;
+	case LDMS_CONTEXT_LOOKUP_READ:
+		if (ctxt->lu_read.s)
+			__ldms_set_read_end(ctxt->lu_read.s, 1);
+		break;
+	default:
+		break;
+	}
+
 	switch (ctxt->type) {
 	case LDMS_CONTEXT_UPDATE:
 		thrstat->last_op = LDMS_THRSTAT_OP_UPDATE_REPLY;
@@ -2657,7 +2945,7 @@ static void handle_zap_read_complete(zap_ep_t zep, zap_event_t ev)
 		break;
 	case LDMS_CONTEXT_LOOKUP_READ:
 		thrstat->last_op = LDMS_THRSTAT_OP_LOOKUP_REPLY;
-		if (ENABLED_PROFILING(LDMS_XPRT_OP_LOOKUP)) {
+		if (ENABLED_PROFILING(LDMS_XPRT_OP_LOOKUP) && ctxt->op_ctxt) {
 			memcpy(&ctxt->op_ctxt->lookup_profile.complete_ts,
 			                          &thrstat->last_op_start,
 			                          sizeof(struct timespec));
@@ -2766,6 +3054,22 @@ out:
 	return rc;
 }
 
+/*
+ * The peer shares the sets of a multi-set lookup in request order, so
+ * the search resumes after the last name that was shared.
+ */
+static int __lookup_multi_idx(struct ldms_context *ctxt, const char *name)
+{
+	int i;
+	for (i = ctxt->lu_multi.cursor; i < ctxt->lu_multi.count; i++) {
+		if (0 == strcmp(ctxt->lu_multi.names[i], name)) {
+			ctxt->lu_multi.cursor = i + 1;
+			return i;
+		}
+	}
+	return -1;
+}
+
 static void handle_rendezvous_lookup(zap_ep_t zep, zap_event_t ev,
 				     struct ldms_xprt *x,
 				     struct ldms_rendezvous_msg *lm)
@@ -2783,6 +3087,34 @@ static void handle_rendezvous_lookup(zap_ep_t zep, zap_event_t ev,
 
 	struct ldms_thrstat *thrstat = zap_thrstat_ctxt_get(zep);
 	struct ldms_op_ctxt *op_ctxt = ctxt->op_ctxt;
+	ldms_lookup_cb_t cb;
+	void *cb_arg;
+	int more;
+	enum ldms_lookup_flags flags;
+
+	schema_name = (ldms_name_t)lu->set_info;
+	inst_name = (ldms_name_t)&(schema_name->name[schema_name->len]);
+
+	if (ctxt->type == LDMS_CONTEXT_LOOKUP_MULTI) {
+		int idx = __lookup_multi_idx(ctxt, inst_name->name);
+		if (idx < 0) {
+			XPRT_LOG(x, OVIS_LERROR, "%s(): The set '%s' shared by the "
+				 "peer is not in the lookup request\n",
+				 __func__, inst_name->name);
+			zap_unmap(ev->map);
+			return;
+		}
+		ctxt->lu_multi.done[idx] = 1;
+		cb = ctxt->lu_multi.cb;
+		cb_arg = ctxt->lu_multi.cb_args[idx];
+		more = 0;
+		flags = LDMS_LOOKUP_BY_INSTANCE;
+		goto lookup;
+	}
+	cb = ctxt->lu_req.cb;
+	cb_arg = ctxt->lu_req.cb_arg;
+	more = ntohl(lu->more);
+	flags = ctxt->lu_req.flags;
 
 #ifdef DEBUG
 	if (!__is_lookup_name_good(x, lu, ctxt)) {
@@ -2794,12 +3126,8 @@ static void handle_rendezvous_lookup(zap_ep_t zep, zap_event_t ev,
 	}
 #endif /* DEBUG */
 
-	schema_name = (ldms_name_t)lu->set_info;
-	inst_name = (ldms_name_t)&(schema_name->name[schema_name->len]);
-
-	__ldms_set_tree_lock();
+ lookup:
 	lset = __ldms_find_local_set(inst_name->name);
-	__ldms_set_tree_unlock();
 
 	if (lset) {
 		rc = EEXIST;
@@ -2826,7 +3154,7 @@ static void handle_rendezvous_lookup(zap_ep_t zep, zap_event_t ev,
 	pthread_mutex_lock(&lset->lock);
 	(void)__process_lookup_set_info(lset, &inst_name->name[inst_name->len], &prfl_maker);
 
-	if (ENABLED_PROFILING(LDMS_XPRT_OP_LOOKUP)) {
+	if (ENABLED_PROFILING(LDMS_XPRT_OP_LOOKUP) && op_ctxt) {
 		if (prfl_maker < (char *)lm + lm->hdr.len) {
 			/* The message is from v4.5.1+ version,
 			 * which includes the lookup profiling timestamps.
@@ -2846,9 +3174,7 @@ static void handle_rendezvous_lookup(zap_ep_t zep, zap_event_t ev,
 	pthread_mutex_lock(&x->lock);
 	rd_ctxt = __ldms_alloc_ctxt(x, sizeof(*rd_ctxt),
 				LDMS_CONTEXT_LOOKUP_READ,
-				lset,
-				ctxt->lu_req.cb, ctxt->lu_req.cb_arg,
-				htonl(lu->more), ctxt->lu_req.flags);
+				lset, cb, cb_arg, more, flags);
 	if (!rd_ctxt) {
 		XPRT_LOG(x, OVIS_LCRITICAL, "%s(): Out of memory\n", __func__);
 		rc = ENOMEM;
@@ -2861,9 +3187,10 @@ static void handle_rendezvous_lookup(zap_ep_t zep, zap_event_t ev,
 	rd_ctxt->op_ctxt = ctxt->op_ctxt;
 	pthread_mutex_unlock(&x->lock);
 	assert((zep == x->zap_ep) && (x == rd_ctxt->x));
-	if (ENABLED_PROFILING(LDMS_XPRT_OP_LOOKUP)) {
+	if (ENABLED_PROFILING(LDMS_XPRT_OP_LOOKUP) && op_ctxt) {
 		(void)clock_gettime(CLOCK_REALTIME, &op_ctxt->lookup_profile.read_ts);
 	}
+	__ldms_set_read_begin(lset);
 	rc = zap_read(zep,
 		      lset->rmap, zap_map_addr(lset->rmap),
 		      lset->lmap, zap_map_addr(lset->lmap),
@@ -2871,10 +3198,12 @@ static void handle_rendezvous_lookup(zap_ep_t zep, zap_event_t ev,
 		      rd_ctxt);
 	if (rc) {
 		x->zerrno = rc;
+		__ldms_set_read_end(lset, 0);
 		rc = zap_zerr2errno(rc);
 		goto callback;
 	}
-	if (!lm->lookup.more) {
+	/* A multi-set lookup context is freed by its reply */
+	if (ctxt->type == LDMS_CONTEXT_LOOKUP_REQ && !lm->lookup.more) {
 		pthread_mutex_lock(&x->lock);
 		__ldms_free_ctxt(x, ctxt);
 		pthread_mutex_unlock(&x->lock);
@@ -2889,9 +3218,10 @@ static void handle_rendezvous_lookup(zap_ep_t zep, zap_event_t ev,
 			"with error %d. NOTE: error %d indicates that it is "
 			"a synchronous error of zap_read\n", inst_name->name, rc, EIO);
 #endif /* DEBUG */
-	if (ctxt->lu_req.cb)
-		ctxt->lu_req.cb(x, rc, 0, rc ? NULL : lset, ctxt->lu_req.cb_arg);
-	__ldms_free_ctxt(x, ctxt);
+	if (cb)
+		cb(x, rc, 0, rc ? NULL : lset, cb_arg);
+	if (ctxt->type == LDMS_CONTEXT_LOOKUP_REQ)
+		__ldms_free_ctxt(x, ctxt);
 	if (rd_ctxt)
 		__ldms_free_ctxt(x, rd_ctxt);
 #ifdef DEBUG
@@ -2971,12 +3301,56 @@ static void handle_rendezvous_push(zap_ep_t zep, zap_event_t ev,
 	return;
 }
 
+static void handle_rendezvous_resize(zap_ep_t zep, zap_event_t ev,
+				     struct ldms_xprt *x,
+				     struct ldms_rendezvous_msg *lm)
+{
+	struct ldms_rendezvous_resize_param *rz = &lm->resize;
+	struct ldms_set *set;
+	size_t name_len = ntohl(rz->name_len);
+
+	if (ev->data_len < sizeof(struct ldms_rendezvous_hdr) +
+			   sizeof(*rz) + name_len ||
+	    !name_len || rz->inst_name[name_len - 1] != '\0') {
+		XPRT_LOG(x, OVIS_LERROR, "%s: malformed resize message\n",
+			 __func__);
+		zap_unmap(ev->map);
+		return;
+	}
+
+	set = __ldms_find_local_set(rz->inst_name);
+	if (!set) {
+		/* The mirror has been deleted */
+		zap_unmap(ev->map);
+		return;
+	}
+
+	pthread_mutex_lock(&set->lock);
+	if (set->xprt != x || set->remote_set_id != rz->set_id) {
+		/* Not the mirror of the set resized by this peer */
+		pthread_mutex_unlock(&set->lock);
+		zap_unmap(ev->map);
+		goto out;
+	}
+	if (set->resize.rmap)
+		zap_unmap(set->resize.rmap);
+	set->resize.rmap = ev->map; /* set now owns ev->map */
+	set->resize.meta_sz = ntohl(rz->meta_len);
+	set->resize.data_sz = ntohl(rz->data_len);
+	set->resize.gn = ntohl(rz->resize_gn);
+	pthread_mutex_unlock(&set->lock);
+ out:
+	ref_put(&set->ref, "__ldms_find_local_set");
+}
+
 /*
- * The daemon will receive a Zap Rendezvous in two circumstances:
+ * The daemon will receive a Zap Rendezvous in three circumstances:
  * - A lookup is outstanding and the peer is giving the daemon the
  *   remote buffer needed to RMDA_READ the data.
  * - A register_push was requested and the peer is giving the daemon
  *   the RBD need to RDMA_WRITE the data.
+ * - A set that the daemon has looked up has been resized and the peer
+ *   is giving the daemon the remote buffer of the new set memory.
  */
 static void handle_zap_rendezvous(zap_ep_t zep, zap_event_t ev)
 {
@@ -2997,6 +3371,10 @@ static void handle_zap_rendezvous(zap_ep_t zep, zap_event_t ev)
 		thrstat->last_op = LDMS_THRSTAT_OP_PUSH_REPLY;
 		handle_rendezvous_push(zep, ev, x, lm);
 		break;
+	case LDMS_XPRT_RENDEZVOUS_RESIZE:
+		thrstat->last_op = LDMS_THRSTAT_OP_LOOKUP_REPLY;
+		handle_rendezvous_resize(zep, ev, x, lm);
+		break;
 	default:
 #ifdef DEBUG
 		assert(0);
@@ -3045,6 +3423,8 @@ static void __ldms_xprt_release_sets(ldms_t x, struct rbt *set_coll)
 		if (rbn) {
 			rbt_del(&ent->set->lookup_coll, rbn);
 			lp = container_of(rbn, struct ldms_lookup_peer, rbn);
+			__ldms_set_retired_drop(ent->set, x->conn_id,
+						UINT32_MAX);
 		}
 		rbn = rbt_find(&ent->set->push_coll, x);
 		if (rbn) {
@@ -3401,6 +3781,8 @@ static size_t __ldms_xprt_msg_max(ldms_t x);
 static int __ldms_xprt_dir(ldms_t x, ldms_dir_cb_t cb, void *cb_arg, uint32_t flags);
 static int __ldms_xprt_lookup(ldms_t x, const char *path, enum ldms_lookup_flags flags,
 		     ldms_lookup_cb_t cb, void *cb_arg, struct ldms_op_ctxt *op_ctxt);
+static int __ldms_xprt_lookup_multi(ldms_t x, int count, const char *names[],
+				    ldms_lookup_cb_t cb, void *cb_args[]);
 static int __ldms_xprt_stats(ldms_t x, ldms_xprt_stats_t stats, int mask, int is_reset);
 static int __ldms_xprt_dir_cancel(ldms_t x);
 
@@ -3430,6 +3812,7 @@ static const struct ldms_xprt_ops_s ldms_xprt_ops = {
 	.dir          = __ldms_xprt_dir,
 	.dir_cancel   = __ldms_xprt_dir_cancel,
 	.lookup       = __ldms_xprt_lookup,
+	.lookup_multi = __ldms_xprt_lookup_multi,
 	.stats        = __ldms_xprt_stats,
 
 	.get          = __ldms_xprt_get,
@@ -3883,9 +4266,7 @@ int __ldms_remote_lookup(ldms_t _x, const char *path,
 	if (LDMS_XPRT_AUTH_GUARD(x))
 		return EPERM;
 
-	__ldms_set_tree_lock();
 	struct ldms_set *set = __ldms_find_local_set(path);
-	__ldms_set_tree_unlock();
 	if (set) {
 		ldms_set_put(set);
 		return EEXIST;
@@ -3988,6 +4369,148 @@ int ldms_xprt_lookup(ldms_t x, const char *path, enum ldms_lookup_flags flags,
 	return rc;
 }
 
+/*
+ * Send one LDMS_CMD_LOOKUP_MULTI request with as many of the names as
+ * fit in the request and in its reply. The number of names sent is
+ * returned in \c sent.
+ */
+static int __ldms_remote_lookup_multi(struct ldms_xprt *x, int count,
+				      const char *names[], ldms_lookup_cb_t cb,
+				      void *cb_args[], int *sent)
+{
+	struct ldms_request *req;
+	struct ldms_context *ctxt;
+	const char **ctxt_names;
+	void **ctxt_args;
+	uint8_t *done;
+	char *p;
+	size_t req_len, names_len, name_len;
+	int i, n;
+
+	/* Find how many names fit in one request */
+	req_len = sizeof(struct ldms_request_hdr)
+			+ sizeof(struct ldms_lookup_multi_cmd_param);
+	names_len = 0;
+	for (n = 0; n < count; n++) {
+		name_len = strlen(names[n]) + 1;
+		if (req_len + names_len + name_len > x->max_msg)
+			break;
+		if (sizeof(struct ldms_reply_hdr)
+			+ sizeof(struct ldms_lookup_multi_reply)
+			+ (n + 1) * sizeof(uint32_t) > x->max_msg)
+			break;
+		names_len += name_len;
+	}
+	if (!n)
+		return EINVAL;
+	req_len += names_len;
+
+	ldms_xprt_get(x, "lookup_multi");
+	pthread_mutex_lock(&x->lock);
+	ctxt = __ldms_alloc_ctxt(x, sizeof(*ctxt)
+				+ n * (sizeof(char *) + sizeof(void *) + 1)
+				+ req_len,
+				LDMS_CONTEXT_LOOKUP_MULTI, cb, n);
+	if (!ctxt) {
+		pthread_mutex_unlock(&x->lock);
+		ldms_xprt_put(x, "lookup_multi");
+		return ENOMEM;
+	}
+	ctxt_names = (const char **)(ctxt + 1);
+	ctxt_args = (void **)&ctxt_names[n];
+	req = (struct ldms_request *)&ctxt_args[n];
+	done = (uint8_t *)req + req_len;
+	p = req->lookup_multi.names;
+	for (i = 0; i < n; i++) {
+		name_len = strlen(names[i]) + 1;
+		memcpy(p, names[i], name_len);
+		ctxt_names[i] = p;
+		ctxt_args[i] = cb_args[i];
+		p += name_len;
+	}
+	ctxt->lu_multi.names = ctxt_names;
+	ctxt->lu_multi.cb_args = ctxt_args;
+	ctxt->lu_multi.done = done;
+	req->lookup_multi.count = htonl(n);
+	req->lookup_multi.names_len = htonl(names_len);
+	req->hdr.xid = (uint64_t)(unsigned long)ctxt;
+	req->hdr.cmd = htonl(LDMS_CMD_LOOKUP_MULTI);
+	req->hdr.len = htonl(req_len);
+#ifdef DEBUG
+	x->active_lookup += n;
+#endif /* DEBUG */
+	pthread_mutex_unlock(&x->lock);
+
+	zap_err_t zerr = zap_send(x->zap_ep, req, req_len);
+	if (zerr) {
+		pthread_mutex_lock(&x->lock);
+#ifdef DEBUG
+		x->active_lookup -= n;
+#endif /* DEBUG */
+		__ldms_free_ctxt(x, ctxt);
+		pthread_mutex_unlock(&x->lock);
+	}
+	ldms_xprt_put(x, "lookup_multi");
+	*sent = n;
+	return zap_zerr2errno(zerr);
+}
+
+static int __ldms_xprt_lookup_multi(ldms_t x, int count, const char *names[],
+				    ldms_lookup_cb_t cb, void *cb_args[])
+{
+	int i, n, rc;
+
+	if (!cb || count <= 0)
+		return EINVAL;
+	for (i = 0; i < count; i++) {
+		if (strlen(names[i]) > LDMS_LOOKUP_PATH_MAX)
+			return EINVAL;
+	}
+	if (!ldms_xprt_connected(x))
+		return ENOTCONN;
+	if (LDMS_XPRT_AUTH_GUARD(x))
+		return EPERM;
+	if (!(x->peer_caps & LDMS_PEER_CAP_LOOKUP_MULTI))
+		return ENOTSUP; /* ldms_xprt_lookup_multi() looks them up one by one */
+
+	for (i = 0; i < count; i += n) {
+		rc = __ldms_remote_lookup_multi(x, count - i, &names[i],
+						cb, &cb_args[i], &n);
+		if (!rc)
+			continue;
+		if (i == 0)
+			return rc;
+		/* Part of the names were sent; complete the rest here */
+		for (; i < count; i++)
+			cb(x, rc, 0, NULL, cb_args[i]);
+		break;
+	}
+	return 0;
+}
+
+int ldms_xprt_lookup_multi(ldms_t x, int count, const char *names[],
+			   ldms_lookup_cb_t cb, void *cb_args[])
+{
+	int i, rc;
+
+	rc = x->ops.lookup_multi(x, count, names, cb, cb_args);
+	if (rc != ENOTSUP)
+		return rc;
+	/* The peer does not implement LDMS_CMD_LOOKUP_MULTI */
+	for (i = 0; i < count; i++) {
+		rc = ldms_xprt_lookup(x, names[i], LDMS_LOOKUP_BY_INSTANCE,
+				      cb, cb_args[i]);
+		if (!rc)
+			continue;
+		if (i == 0)
+			return rc;
+		for (; i < count; i++)
+			cb(x, rc, 0, NULL, cb_args[i]);
+		break;
+	}
+	return 0;
+}
+
 static void __stats_ep_clear(ldms_xprt_stats_t stats)
 {
 	enum ldms_xprt_ops_e op_e;
@@ -4529,9 +5052,7 @@ static ldms_set_t __ldms_xprt_set_by_name(ldms_t x, const char *set_name)
 
 	assert(XTYPE_IS_LEGACY(x->xtype));
 
-	__ldms_set_tree_lock();
 	set = __ldms_find_local_set(set_name);
-	__ldms_set_tree_unlock();
 	if (!set)
 		return NULL;
 	pthread_mutex_lock(&x->lock);
@@ -4653,10 +5174,13 @@ enum ldms_thrstat_op_e req2thrstat_op_tbl[] = {
 	[LDMS_CMD_AUTH]               = LDMS_THRSTAT_OP_AUTH,
 	[LDMS_CMD_SET_DELETE]         = LDMS_THRSTAT_OP_SET_DELETE_REQ,
 	[LDMS_CMD_SEND_QUOTA]         = LDMS_THRSTAT_OP_OTHER,
+	[LDMS_CMD_LOOKUP_MULTI]       = LDMS_THRSTAT_OP_LOOKUP_REQ,
+	[LDMS_CMD_RESIZE_DONE]        = LDMS_THRSTAT_OP_OTHER,
 
 	[LDMS_CMD_DIR_REPLY]          = LDMS_THRSTAT_OP_DIR_REPLY,
 	[LDMS_CMD_DIR_UPDATE_REPLY]   = LDMS_THRSTAT_OP_UPDATE_REPLY,
 	[LDMS_CMD_LOOKUP_REPLY]       = LDMS_THRSTAT_OP_LOOKUP_REPLY,
+	[LDMS_CMD_LOOKUP_MULTI_REPLY] = LDMS_THRSTAT_OP_LOOKUP_REPLY,
 	[LDMS_CMD_AUTH_CHALLENGE_REPLY] = LDMS_THRSTAT_OP_AUTH,
 	[LDMS_CMD_AUTH_APPROVAL_REPLY]  = LDMS_THRSTAT_OP_AUTH,
 	[LDMS_CMD_AUTH_REPLY]           = LDMS_THRSTAT_OP_AUTH,
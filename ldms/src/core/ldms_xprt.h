@@ -137,6 +137,10 @@ enum ldms_request_cmd {
 	LDMS_CMD_QUOTA_RECONFIG,
 	/* rail rate re-config after connected */
 	LDMS_CMD_RATE_RECONFIG,
+	/* lookup of several sets by instance name */
+	LDMS_CMD_LOOKUP_MULTI,
+	/* the mirror no longer reads the set memory retired by a resize */
+	LDMS_CMD_RESIZE_DONE,
 
 	LDMS_CMD_REPLY = 0x100,
 	LDMS_CMD_DIR_REPLY,
@@ -154,12 +158,24 @@ enum ldms_request_cmd {
 	LDMS_CMD_MSG_SUB_REPLY, /* message subscribe reply (result) */
 	LDMS_CMD_MSG_UNSUB_REPLY, /* message unsubscribe reply (result) */
 
-	LDMS_CMD_LAST = LDMS_CMD_MSG_UNSUB_REPLY,
+	LDMS_CMD_LOOKUP_MULTI_REPLY,
+
+	LDMS_CMD_LAST = LDMS_CMD_LOOKUP_MULTI_REPLY,
 
 	/* Transport private requests set bit 32 */
 	LDMS_CMD_XPRT_PRIVATE = 0x80000000,
 };
 
+/*
+ * Optional protocol features. A peer advertises the ones it implements in
+ * the \c caps field of the rail connect message; a request that needs a
+ * feature is only sent to a peer that advertised it.
+ */
+#define LDMS_PEER_CAP_LOOKUP_MULTI	0x00000001 /* LDMS_CMD_LOOKUP_MULTI */
+#define LDMS_PEER_CAP_SET_RESIZE	0x00000002 /* LDMS_XPRT_RENDEZVOUS_RESIZE */
+#define LDMS_PEER_CAPS			(LDMS_PEER_CAP_LOOKUP_MULTI | \
+					 LDMS_PEER_CAP_SET_RESIZE)
+
 struct ldms_conn_msg {
 	struct ldms_version ver;
 	char auth_name[LDMS_AUTH_NAME_MAX + 1];
@@ -192,6 +208,16 @@ struct ldms_lookup_cmd_param {
 	char path[LDMS_LOOKUP_PATH_MAX+1];
 };
 
+/*
+ * The instance names are packed back to back in \c names, each one
+ * terminated by '\0'.
+ */
+struct ldms_lookup_multi_cmd_param {
+	uint32_t count;		/*! Number of names */
+	uint32_t names_len;	/*! Total length of \c names */
+	char names[OVIS_FLEX];
+};
+
 struct ldms_dir_cmd_param {
 	uint32_t flags;		/*! Directory update flags */
 };
@@ -214,6 +240,11 @@ struct ldms_cancel_push_cmd_param {
 	uint64_t set_id;	/*! The set we want to cancel push updates for  */
 };
 
+struct ldms_resize_done_cmd_param {
+	uint64_t set_id;	/*! set_id provided in the resize */
+	uint32_t resize_gn;	/*! resize_gn provided in the resize */
+};
+
 /* partial message (in message service); see ldms_msg.h for a full message */
 struct ldms_msg_part_param {
 	struct ldms_addr src;
@@ -264,9 +295,11 @@ struct ldms_request {
 		struct ldms_dir_cmd_param dir;
 		struct ldms_set_delete_cmd_param set_delete;
 		struct ldms_lookup_cmd_param lookup;
+		struct ldms_lookup_multi_cmd_param lookup_multi;
 		struct ldms_req_notify_cmd_param req_notify;
 		struct ldms_cancel_notify_cmd_param cancel_notify;
 		struct ldms_cancel_push_cmd_param cancel_push;
+		struct ldms_resize_done_cmd_param resize_done;
 		struct ldms_msg_part_param msg_part;
 		struct ldms_msg_sub_param msg_sub;
 		struct ldms_qgroup_ask qgroup_ask;
@@ -296,8 +329,23 @@ struct ldms_rendezvous_push_param {
 	uint32_t flags;
 };
 
+/*
+ * Sent with the map of the new set memory to the peers that looked up a
+ * set after its heap has been resized. The peer acknowledges with
+ * LDMS_CMD_RESIZE_DONE once it has switched to the new map.
+ */
+struct ldms_rendezvous_resize_param {
+	uint64_t set_id;	/* set_id provided in the lookup */
+	uint32_t meta_len;
+	uint32_t data_len;
+	uint32_t resize_gn;	/* number of resizes of the set so far */
+	uint32_t name_len;	/* including the terminating '\0' */
+	char inst_name[OVIS_FLEX];
+};
+
 #define LDMS_XPRT_RENDEZVOUS_LOOKUP	1
 #define LDMS_XPRT_RENDEZVOUS_PUSH	2
+#define LDMS_XPRT_RENDEZVOUS_RESIZE	3
 
 struct ldms_rendezvous_hdr {
 	uint64_t xid;
@@ -310,6 +358,7 @@ struct ldms_rendezvous_msg {
 	union {
 		struct ldms_rendezvous_lookup_param lookup;
 		struct ldms_rendezvous_push_param push;
+		struct ldms_rendezvous_resize_param resize;
 	};
 };
 
@@ -355,6 +404,16 @@ struct ldms_set_delete_reply {
 	struct timespec recv_ts;
 };
 
+/*
+ * One status per name in the LDMS_CMD_LOOKUP_MULTI request, in request
+ * order. A status of 0 means the set was shared in a rendezvous message
+ * that precedes this reply.
+ */
+struct ldms_lookup_multi_reply {
+	uint32_t count;
+	uint32_t status[OVIS_FLEX];
+};
+
 struct ldms_reply {
 	struct ldms_reply_hdr hdr;
 	union {
@@ -364,6 +423,7 @@ struct ldms_reply {
 		struct ldms_push_reply push;
 		struct ldms_msg_sub_reply sub;
 		struct ldms_set_delete_reply set_del;
+		struct ldms_lookup_multi_reply lookup_multi;
 	};
 };
 #pragma pack()
@@ -379,6 +439,7 @@ typedef enum ldms_context_type {
 	LDMS_CONTEXT_PUSH,
 	LDMS_CONTEXT_UPDATE_META,
 	LDMS_CONTEXT_SET_DELETE,
+	LDMS_CONTEXT_LOOKUP_MULTI,
 } ldms_context_type_t;
 
 struct ldms_context {
@@ -406,6 +467,14 @@ struct ldms_context {
 			int more;
 			enum ldms_lookup_flags flags;
 		} lu_read;
+		struct {
+			ldms_lookup_cb_t cb;
+			int count;
+			int cursor;	/* next name expected in a rendezvous */
+			const char **names;
+			void **cb_args;
+			uint8_t *done;	/* 1 if the callback has been called */
+		} lu_multi;
 		struct {
 			ldms_set_t s;
 			ldms_update_cb_t cb;
@@ -466,6 +535,8 @@ struct ldms_xprt_ops_s {
 	int (*dir_cancel)(ldms_t x);
 	int (*lookup)(ldms_t t, const char *name, enum ldms_lookup_flags flags,
 		       ldms_lookup_cb_t cb, void *cb_arg, struct ldms_op_ctxt *op_ctxt);
+	int (*lookup_multi)(ldms_t t, int count, const char *names[],
+			    ldms_lookup_cb_t cb, void *cb_args[]);
 	int (*stats)(ldms_t x, ldms_xprt_stats_t stats, int mask, int is_reset);
 
 	ldms_t (*get)(ldms_t x, const char *name, const char *func, int line); /* ref get */
@@ -557,6 +628,8 @@ struct ldms_xprt {
 
 	int term;
 
+	uint32_t peer_caps; /* LDMS_PEER_CAP_* bits advertised by the peer */
+
 	struct rbt set_coll;
 
 	/** Application's context */
@@ -75,6 +75,7 @@
 #define LDMS_LS_MEM_SZ_ENVVAR "LDMS_LS_MEM_SZ"
 #define LDMS_LS_MAX_MEM_SIZE 512L * 1024L * 1024L
 #define LDMS_LS_MAX_MEM_SZ_STR "512MB"
+#define LDMS_LS_WINDOW_DEFAULT 64
 
 /* from ldmsd_group.c */
 #define GRP_SCHEMA_NAME "ldmsd_grp_schema"
@@ -94,9 +95,17 @@ static pthread_cond_t dir_cv;
 static int dir_done;
 static int dir_status;
 
+/*
+ * print_lock serializes the output of the update callbacks and protects
+ * in_flight, the number of outstanding lookup/update requests.
+ */
 static pthread_mutex_t print_lock;
 static pthread_cond_t print_cv;
-static int print_done;
+static int in_flight;
+static int window = LDMS_LS_WINDOW_DEFAULT;
+static int sort_output;
+static int timing;
+static int compact;
 
 static pthread_mutex_t done_lock;
 static pthread_cond_t done_cv;
@@ -113,6 +122,21 @@ struct ls_set {
 };
 LIST_HEAD(set_list, ls_set) set_list;
 
+/*
+ * A lookup/update request of a set in the long format (-l). The
+ * timestamps are CLOCK_MONOTONIC and are used by the timing summary (-t).
+ */
+struct ls_req {
+	const char *inst_name;
+	ldms_set_t set;		/* set kept for the sorted output (-s) */
+	int upd_rc;		/* update flags of the kept set */
+	int status;		/* lookup/update error, 0 if OK */
+	struct timespec t_issue;
+	struct timespec t_lookup;
+	struct timespec t_update;
+	uint64_t print_ns;
+};
+
 /*
  * A wrapper so that we can keep all received dir's
  * so that we can
@@ -148,6 +172,11 @@ enum out_format format_to_enum(const char *f) {
 		return sf_json;
 	if (!strcmp(f,"tab"))
 		return sf_tab;
+	if (!strcmp(f,"compact")) {
+		/* tab format with one line per set in the long listing */
+		compact = 1;
+		return sf_tab;
+	}
 	printf("WARNING: format unknown: %s\n", f);
 	return sf_normal;
 }
@@ -155,7 +184,7 @@ enum out_format format_to_enum(const char *f) {
 enum out_format format = sf_normal;
 
 
-#define FMT "h:p:x:w:m:ESIlvua:A:VPdf:"
+#define FMT "h:p:x:w:m:ESIlvua:A:VPdf:W:st"
 void usage(char *argv[])
 {
 	printf("%s -h <hostname> -x <transport> [ name ... ]\n"
@@ -171,7 +200,9 @@ void usage(char *argv[])
 	       "                     this option multiple times increases the verbosity.\n"
 	       "\n    -f <fmt>         Emit set information in a machine readable format. Detail\n"
 	       "                     level is controlled by the presence of -l or -v.\n"
-	       "                     Format fmt is one of 'json' and 'tab'; any other is ignored.\n"
+	       "                     Format fmt is one of 'json', 'tab' and 'compact'; any\n"
+	       "                     other is ignored. 'compact' is 'tab' with one line per\n"
+	       "                     set in the long listing.\n"
 	       "\n    -E               The <name> arguments are regular expressions.\n"
 	       "\n    -S               The <name>s refers to the schema name.\n"
 	       "\n    -I               The <name>s refer to the instance name (default).\n"
@@ -189,6 +220,12 @@ void usage(char *argv[])
 	       , LDMS_LS_MAX_MEM_SZ_STR, LDMS_LS_MEM_SZ_ENVVAR);
 	printf("\n    -V               Print LDMS version and exit.\n");
 	printf("\n    -P               Register for push updates.\n");
+	printf("\n    -W <num>         The maximum number of set lookups and updates in flight\n"
+	       "                     in the long listing. The default is %d.\n"
+	       "\n    -s               Sort the long listing by instance name. The sets are\n"
+	       "                     printed after all updates have completed.\n"
+	       "\n    -t               Print a timing summary of each stage to stderr.\n",
+	       LDMS_LS_WINDOW_DEFAULT);
 	exit(1);
 }
 
@@ -1020,26 +1057,26 @@ int format_first = 1;
 int format_long_first = 1;
 extern char *__ldms_format_set_for_dir(ldms_set_t s, size_t *cnt);
 
-void print_cb(ldms_t t, ldms_set_t s, int rc, void *arg)
+void value_printer_compact(ldms_set_t s, int idx)
 {
-	int err;
-	unsigned long last = (unsigned long)arg;
-	err = LDMS_UPD_ERROR(rc);
-	if (err) {
-		printf("    Error %x updating metric set.\n", err);
-		goto out;
-	}
-	/* Ignore if more update of this set is expected */
-	if (rc & LDMS_UPD_F_MORE)
-		return;
-	/* If this is a push update and it's not the last, ignore it. */
-	if (rc & LDMS_UPD_F_PUSH) {
-		if (!(rc & LDMS_UPD_F_PUSH_LAST)) {
-			/* This will trigger the last update */
-			ldms_xprt_cancel_push(s);
-			return;
-		}
+	enum ldms_value_type type = ldms_metric_type_get(s, idx);
+
+	switch (type) {
+	case LDMS_V_RECORD_TYPE:
+	case LDMS_V_RECORD_ARRAY:
+	case LDMS_V_LIST:
+		/* Nested values do not fit on one line */
+		printf("<%s>", ldms_metric_type_to_str(type));
+		break;
+	default:
+		value_printer(s, idx);
+		break;
 	}
+}
+
+/* Caller must hold print_lock */
+void print_set_values(ldms_set_t s, int rc)
+{
 	if (print_decomp) {
 		char digest_str[LDMS_DIGEST_STR_LENGTH];
 		struct digest_entry *de;
@@ -1047,7 +1084,7 @@ void print_cb(ldms_t t, ldms_set_t s, int rc, void *arg)
 		ldms_digest_str(ldms_set_digest_get(s), digest_str, sizeof(digest_str));
 		rbn = rbt_find(&digest_tree, digest_str);
 		if (rbn)
-			goto out;
+			return;
 		if (rbt_card(&digest_tree))
 			fprintf(stdout, ",\n");
 		else
@@ -1058,7 +1095,7 @@ void print_cb(ldms_t t, ldms_set_t s, int rc, void *arg)
 		rbn_init(&de->rbn, de->digest_str);
 		rbt_ins(&digest_tree, &de->rbn);
 		fprint_decomp(stdout, s);
-		goto out;
+		return;
 	}
 	struct ldms_timestamp _ts = ldms_transaction_timestamp_get(s);
 	struct ldms_timestamp const *ts = &_ts;
@@ -1071,6 +1108,7 @@ void print_cb(ldms_t t, ldms_set_t s, int rc, void *arg)
 
 	char *metajson = NULL;
 	size_t mj_cnt = 0;
+	int i;
 	switch (format) {
 	case sf_normal:
 		printf("%s: %s, last update: %s [%dus] ",
@@ -1082,10 +1120,10 @@ void print_cb(ldms_t t, ldms_set_t s, int rc, void *arg)
 			printf("LAST ");
 		printf("\n");
 		if (long_format) {
-			int i;
 			for (i = 0; i < ldms_set_card_get(s); i++)
 				metric_printer(s, i);
 		}
+		printf("\n");
 		break;
 	case sf_json:
 		metajson = __ldms_format_set_for_dir(s, &mj_cnt);
@@ -1101,13 +1139,29 @@ void print_cb(ldms_t t, ldms_set_t s, int rc, void *arg)
 		free(metajson);
 		if (long_format) {
 			printf(",\"metrics\":[");
-			int i;
 			for (i = 0; i < ldms_set_card_get(s); i++)
 				metric_printer_json(s, i);
 			printf("]}");
 		}
 		break;
 	case sf_tab:
+		if (compact) {
+			if (format_long_first) {
+				format_long_first = 0;
+				printf("#instance\tschema\ttimestamp\tconsistent"
+				       "\tmetric=value...\n");
+			}
+			printf("%s\t%s\t%u.%06u\t%d",
+			       ldms_set_instance_name_get(s),
+			       ldms_set_schema_name_get(s),
+			       ts->sec, ts->usec, (consistent?1:0));
+			for (i = 0; i < ldms_set_card_get(s); i++) {
+				printf("\t%s=", ldms_metric_name_get(s, i));
+				value_printer_compact(s, i);
+			}
+			printf("\n");
+			break;
+		}
 		printf("#instance\tconsistent\tupdate\tupdate.usec\tpush\tlast_push\n");
 		printf("%s\t%d\t%s\t%d\t%d\t%d\n",
 		       ldms_set_instance_name_get(s),
@@ -1119,33 +1173,80 @@ void print_cb(ldms_t t, ldms_set_t s, int rc, void *arg)
 			if (user_data)
 				printf("\tudata");
 			printf("\tvalue\tunit\n");
-			int i;
 			for (i = 0; i < ldms_set_card_get(s); i++)
 				metric_printer_tab(s, i);
 		}
 		break;
 	}
-	if ((rc == 0) || (rc & LDMS_UPD_F_PUSH_LAST))
-		ldms_set_delete(s);
- out:
-	switch (format) {
-	case sf_normal:
-		if (!print_decomp)
-			printf("\n");
-		break;
-	case sf_tab:
-		break;
-	case sf_json:
-		break;
-	}
-	if (last) {
+}
+
+static uint64_t ts_diff_ns(struct timespec *a, struct timespec *b)
+{
+	return (b->tv_sec - a->tv_sec) * 1000000000UL + b->tv_nsec - a->tv_nsec;
+}
+
+static void print_timed(struct ls_req *req, ldms_set_t s, int rc)
+{
+	struct timespec t0, t1;
+
+	pthread_mutex_lock(&print_lock);
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	print_set_values(s, rc);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	pthread_mutex_unlock(&print_lock);
+	if (req)
+		req->print_ns += ts_diff_ns(&t0, &t1);
+}
+
+/* Retire a request and open a slot in the window */
+static void req_complete(struct ls_req *req)
+{
+	pthread_mutex_lock(&print_lock);
+	in_flight--;
+	pthread_cond_signal(&print_cv);
+	pthread_mutex_unlock(&print_lock);
+}
+
+void print_cb(ldms_t t, ldms_set_t s, int rc, void *arg)
+{
+	int err;
+	struct ls_req *req = arg;
+	err = LDMS_UPD_ERROR(rc);
+	if (err) {
 		pthread_mutex_lock(&print_lock);
-		print_done = 1;
-		pthread_cond_signal(&print_cv);
+		printf("    Error %x updating metric set.\n", err);
+		if (format == sf_normal && !print_decomp)
+			printf("\n");
 		pthread_mutex_unlock(&print_lock);
-		done = 1;
-		pthread_cond_signal(&done_cv);
+		if (req)
+			req->status = err;
+		goto out;
+	}
+	/* Ignore if more update of this set is expected */
+	if (rc & LDMS_UPD_F_MORE)
+		return;
+	/* If this is a push update and it's not the last, ignore it. */
+	if (rc & LDMS_UPD_F_PUSH) {
+		if (!(rc & LDMS_UPD_F_PUSH_LAST)) {
+			/* This will trigger the last update */
+			ldms_xprt_cancel_push(s);
+			return;
+		}
+	}
+	if (req)
+		clock_gettime(CLOCK_MONOTONIC, &req->t_update);
+	if (sort_output && req) {
+		/* Printed and deleted by main() once all updates are done */
+		req->set = s;
+		req->upd_rc = rc;
+		goto out;
 	}
+	print_timed(req, s, rc);
+	if ((rc == 0) || (rc & LDMS_UPD_F_PUSH_LAST))
+		ldms_set_delete(s);
+ out:
+	if (req)
+		req_complete(req);
 }
 
 void lookup_cb(ldms_t t, enum ldms_lookup_status status, int more,
@@ -1157,75 +1258,132 @@ static const char *ldmsd_group_member_name(const char *info_key)
 	return info_key + sizeof(GRP_KEY_PREFIX) - 1;
 }
 
-void lookup_cb(ldms_t t, enum ldms_lookup_status status,
-	       int more,
-	       ldms_set_t s, void *arg)
+static void lookup_err(struct ls_req *req, int status)
 {
-	unsigned long last = (unsigned long)arg;
-	if (status) {
-		last = 1;
-		pthread_mutex_lock(&print_lock);
-		print_done = 1;
-		pthread_cond_signal(&print_cv);
-		pthread_mutex_unlock(&print_lock);
-		goto err;
-	}
-	ldms_xprt_update(s, print_cb, (void *)(unsigned long)(!more));
-	return;
- err:
+	pthread_mutex_lock(&print_lock);
 	printf("ldms_ls: Error %d looking up metric set.\n", status);
 	if (status == ENOMEM) {
 		printf("Change the LDMS_LS_MEM_SZ environment variable or the "
 		       "-m option to a bigger value. The current "
 		       "value is %s\n", mem_sz);
 	}
-	if (last && !more) {
-		pthread_mutex_lock(&done_lock);
-		done = 1;
-		pthread_cond_signal(&done_cv);
-		pthread_mutex_unlock(&done_lock);
+	pthread_mutex_unlock(&print_lock);
+	req->status = status;
+	req_complete(req);
+}
+
+void lookup_cb(ldms_t t, enum ldms_lookup_status status,
+	       int more,
+	       ldms_set_t s, void *arg)
+{
+	struct ls_req *req = arg;
+	int rc;
+	if (status) {
+		lookup_err(req, status);
+		return;
 	}
+	clock_gettime(CLOCK_MONOTONIC, &req->t_lookup);
+	/* Only the last set of the lookup retires the request */
+	rc = ldms_xprt_update(s, print_cb, (more ? NULL : req));
+	if (rc && !more)
+		lookup_err(req, rc);
 }
 
 void lookup_push_cb(ldms_t t, enum ldms_lookup_status status,
 		    int more,
 		    ldms_set_t s, void *arg)
 {
-	unsigned long last = (unsigned long)arg;
+	struct ls_req *req = arg;
+	void *upd_arg = (more ? NULL : req);
+	int rc;
 	if (LDMS_UPD_ERROR(status)) {
-		/* Lookup failed, signal the main thread to finish up */
-		last = 1;
-		pthread_mutex_lock(&print_lock);
-		print_done = 1;
-		pthread_cond_signal(&print_cv);
-		pthread_mutex_unlock(&print_lock);
-		goto err;
+		lookup_err(req, status);
+		return;
 	}
+	clock_gettime(CLOCK_MONOTONIC, &req->t_lookup);
 	if (strcmp(GRP_SCHEMA_NAME, ldms_set_schema_name_get(s)) == 0) {
 		/*
 		 * This is a set group. Don't register for push update otherwise
 		 * ldms_ls will wait indefinitely. Get the update by pulling.
 		 */
-		ldms_xprt_update(s, print_cb, (void *)(unsigned long)(!more));
-		return;
+		rc = ldms_xprt_update(s, print_cb, upd_arg);
+	} else {
+		/* Register this set for push updates */
+		rc = ldms_xprt_register_push(s, LDMS_XPRT_PUSH_F_CHANGE,
+					     print_cb, upd_arg);
 	}
-	/* Register this set for push updates */
-	ldms_xprt_register_push(s, LDMS_XPRT_PUSH_F_CHANGE, print_cb,
-					(void *)(unsigned long)(!more));
-	return;
- err:
-	printf("ldms_ls: Error %d looking up metric set.\n", status);
-	if (status == ENOMEM) {
-		printf("Change the LDMS_LS_MEM_SZ environment variable or the "
-				"-m option to a bigger value. The current "
-				"value is %s\n", mem_sz);
+	if (rc && !more)
+		lookup_err(req, rc);
+}
+
+
+static int req_name_cmp(const void *a, const void *b)
+{
+	const struct ls_req *ra = a, *rb = b;
+	return strcmp(ra->inst_name, rb->inst_name);
+}
+
+static int u64_cmp(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return (x < y) ? -1 : (x > y);
+}
+
+static void timing_stage_print(const char *name, uint64_t *v, size_t n)
+{
+	uint64_t sum = 0;
+	size_t i;
+
+	if (!n) {
+		fprintf(stderr, "  %-8s %8d\n", name, 0);
+		return;
 	}
-	if (last && !more) {
-		pthread_mutex_lock(&done_lock);
-		done = 1;
-		pthread_cond_signal(&done_cv);
-		pthread_mutex_unlock(&done_lock);
+	qsort(v, n, sizeof(*v), u64_cmp);
+	for (i = 0; i < n; i++)
+		sum += v[i];
+	fprintf(stderr, "  %-8s %8zu %12.1f %12.1f %12.1f %12.1f %12.1f\n",
+		name, n, v[0] / 1e3, (sum / n) / 1e3, v[n / 2] / 1e3,
+		v[(n * 99) / 100] / 1e3, v[n - 1] / 1e3);
+}
+
+/* The -t summary; all latencies are in microseconds */
+static void timing_print(struct ls_req *reqs, size_t nreq,
+			 struct timespec *t_start, struct timespec *t_conn,
+			 struct timespec *t_dir, struct timespec *t_end)
+{
+	uint64_t *lu, *upd, *prn, v;
+	size_t i, nlu = 0, nupd = 0, nprn = 0, nerr = 0;
+	double wall = ts_diff_ns(t_start, t_end) / 1e9;
+
+	lu = calloc(3 * (nreq + 1), sizeof(*lu));
+	if (!lu)
+		return;
+	upd = lu + nreq + 1;
+	prn = upd + nreq + 1;
+	for (i = 0; i < nreq; i++) {
+		if (reqs[i].status)
+			nerr++;
+		if (reqs[i].t_lookup.tv_sec || reqs[i].t_lookup.tv_nsec)
+			lu[nlu++] = ts_diff_ns(&reqs[i].t_issue, &reqs[i].t_lookup);
+		if (reqs[i].t_update.tv_sec || reqs[i].t_update.tv_nsec) {
+			upd[nupd++] = ts_diff_ns(&reqs[i].t_lookup, &reqs[i].t_update);
+			prn[nprn++] = reqs[i].print_ns;
+		}
 	}
+	fprintf(stderr, "ldms_ls timing: %zu sets, %zu errors, window %d, "
+		"wall %.6f s", nreq, nerr, window, wall);
+	if (nreq && wall > 0)
+		fprintf(stderr, " (%.1f sets/s)", nreq / wall);
+	fprintf(stderr, "\n  %-8s %8s %12s %12s %12s %12s %12s\n",
+		"stage", "count", "min_us", "avg_us", "p50_us", "p99_us", "max_us");
+	v = ts_diff_ns(t_start, t_conn);
+	timing_stage_print("connect", &v, 1);
+	v = ts_diff_ns(t_conn, t_dir);
+	timing_stage_print("dir", &v, 1);
+	timing_stage_print("lookup", lu, nlu);
+	timing_stage_print("update", upd, nupd);
+	timing_stage_print("print", prn, nprn);
+	free(lu);
 }
 
 long total_meta;
@@ -1519,6 +1677,9 @@ int main(int argc, char *argv[])
 	struct timespec ts;
 	char *lval, *rval;
 	struct ldms_ls_dir *dir;
+	struct ls_req *reqs = NULL, *req;
+	size_t nreq = 0;
+	struct timespec t_start, t_conn, t_dir, t_end;
 
 	/* If no arguments are given, print usage. */
 	if (argc == 1)
@@ -1612,6 +1773,20 @@ int main(int argc, char *argv[])
 			lu_cb_fn = lookup_push_cb;
 			long_format = 1;
 			break;
+		case 'W':
+			window = atoi(optarg);
+			if (window < 1) {
+				printf("ERROR: -W %s must be a positive number\n",
+				       optarg);
+				exit(1);
+			}
+			break;
+		case 's':
+			sort_output = 1;
+			break;
+		case 't':
+			timing = 1;
+			break;
 		case 'a':
 			auth_name = optarg;
 			break;
@@ -1754,6 +1929,7 @@ int main(int argc, char *argv[])
 	free(hostname);
 	xprt = NULL;
 	hostname = NULL;
+	clock_gettime(CLOCK_MONOTONIC, &t_start);
 	ret  = ldms_xprt_connect(ldms, &lsa.sa, sa_len, ldms_connect_cb, NULL);
 	if (ret) {
 		perror("ldms_xprt_connect");
@@ -1765,6 +1941,7 @@ int main(int argc, char *argv[])
 		/* Connection error/rejected */
 		exit(1);
 	}
+	clock_gettime(CLOCK_MONOTONIC, &t_conn);
 	pthread_mutex_init(&dir_lock, 0);
 	pthread_cond_init(&dir_cv, NULL);
 	pthread_mutex_init(&done_lock, 0);
@@ -1866,6 +2043,7 @@ int main(int argc, char *argv[])
 	pthread_mutex_unlock(&dir_lock);
 	if (ret)
 		server_timeout();
+	clock_gettime(CLOCK_MONOTONIC, &t_dir);
 
 	if (dir_status) {
 		printf("Error %d looking up the metric set directory.\n",
@@ -1986,30 +2164,58 @@ int main(int argc, char *argv[])
 		fprintf(stdout, "  \"decomposition\" : {");
 	}
 	/*
-	 * Handle the long format (-l)
+	 * Handle the long format (-l). Keep up to `window` lookups and
+	 * updates in flight; each update callback prints its set as soon as
+	 * it completes unless the output is sorted (-s).
 	 */
+	LIST_FOREACH(lss, &set_list, entry)
+		nreq++;
+	reqs = calloc(nreq, sizeof(*reqs));
+	if (!reqs) {
+		printf("ERROR: out of memory\n");
+		exit(1);
+	}
+	nreq = 0;
 	while (!LIST_EMPTY(&set_list)) {
 		lss = LIST_FIRST(&set_list);
 		LIST_REMOVE(lss, entry);
+		req = &reqs[nreq++];
+		req->inst_name = lss->set_data->inst_name;
+		free(lss);
 
 		pthread_mutex_lock(&print_lock);
-		print_done = 0;
+		while (in_flight >= window)
+			pthread_cond_wait(&print_cv, &print_lock);
+		in_flight++;
 		pthread_mutex_unlock(&print_lock);
 
-		ret = ldms_xprt_lookup(ldms, lss->set_data->inst_name,
+		clock_gettime(CLOCK_MONOTONIC, &req->t_issue);
+		ret = ldms_xprt_lookup(ldms, req->inst_name,
 				       LDMS_LOOKUP_BY_INSTANCE,
-				       lu_cb_fn,
-				       (void *)(unsigned long)
-				       LIST_EMPTY(&set_list));
+				       lu_cb_fn, req);
 		if (ret) {
+			pthread_mutex_lock(&print_lock);
 			printf("ldms_xprt_lookup returned %d for set '%s'\n",
-			       ret, lss->set_data->inst_name);
+			       ret, req->inst_name);
+			pthread_mutex_unlock(&print_lock);
+			req->status = ret;
+			req_complete(req);
+		}
+	}
+	pthread_mutex_lock(&print_lock);
+	while (in_flight)
+		pthread_cond_wait(&print_cv, &print_lock);
+	pthread_mutex_unlock(&print_lock);
+	if (sort_output) {
+		qsort(reqs, nreq, sizeof(*reqs), req_name_cmp);
+		for (i = 0; i < nreq; i++) {
+			req = &reqs[i];
+			if (!req->set)
+				continue;
+			print_timed(req, req->set, req->upd_rc);
+			ldms_set_delete(req->set);
+			req->set = NULL;
 		}
-		pthread_mutex_lock(&print_lock);
-		while (!print_done)
-			pthread_cond_wait(&print_cv, &print_lock);
-		pthread_mutex_unlock(&print_lock);
-		free(lss);
 	}
 	if (print_decomp) {
 		struct digest_entry *de;
@@ -2036,6 +2242,7 @@ done:
 	while (!done)
 		pthread_cond_wait(&done_cv, &done_lock);
 	pthread_mutex_unlock(&done_lock);
+	clock_gettime(CLOCK_MONOTONIC, &t_end);
 
 	while ((dir = LIST_FIRST(&dir_list))) {
 		LIST_REMOVE(dir, entry);
@@ -2048,6 +2255,11 @@ done:
 			printf("]");
 		printf("}");
 	}
+	if (timing) {
+		fflush(stdout);
+		timing_print(reqs, nreq, &t_start, &t_conn, &t_dir, &t_end);
+	}
+	free(reqs);
 	/* gracefully close, and wait at most 2 seconds before exit */
 	ldms_xprt_close(ldms);
 	struct timespec _t;
@@ -355,7 +355,11 @@ static void help_start()
 		"                 negative with magnitude up to 1/2 the sample interval.\n"
 		"                 If this offset is specified, including 0, \n"
 		"                 collection will be synchronous; if the offset\n"
-		"                 is not specified, collection will be asychronous.\n");
+		"                 is not specified, collection will be asychronous.\n"
+		"     [group=]    Sample in the named sampler group. The members\n"
+		"                 of a group are sampled back to back on the group's\n"
+		"                 thread with a common timestamp, and must have the\n"
+		"                 same interval and offset.\n");
 }
 
 static void help_stop()
@@ -1569,6 +1573,8 @@ static void help_failover_config()
 	printf("    [timeout_factor=] The heartbeat timeout factor.\n");
 	printf("    [peer_name=]      The failover partner name. If not given,\n");
 	printf("                      the ldmsd will accept any partner.\n");
+	printf("    [standby=0|1]     Keep the peer producers connected before\n");
+	printf("                      a failover.\n");
 }
 
 static void help_failover_status()
@@ -1991,6 +1997,29 @@ static void resp_xprt_stats(ldmsd_req_hdr_t resp, size_t len, uint32_t rsp_err)
 	return;
 }
 
+static void help_latency_stats()
+{
+	printf( "\nQuery the per-operation latency histograms of producers,\n"
+		"updaters, storage policies, and samplers\n\n"
+		"Parameters:\n"
+		"[name=]    Report only the objects with this name\n"
+		"[type=]    Report only this object type: prdcr, updtr, strgp, or sampler\n"
+		"[reset=]   If true, reset the histograms after returning the values.\n"
+		"           The default is false.\n");
+}
+
+static void resp_latency_stats(ldmsd_req_hdr_t resp, size_t len, uint32_t rsp_err)
+{
+	ldmsd_req_attr_t attr;
+	if (rsp_err) {
+		resp_generic(resp, len, rsp_err);
+		return;
+	}
+	attr = ldmsd_first_attr(resp);
+	if (attr->discrim && (attr->attr_id == LDMSD_ATTR_JSON))
+		printf("%s\n", attr->attr_value);
+}
+
 static void help_thread_stats()
 {
 	printf( "\nQuery the daemon's thread utilization statistics\n\n"
@@ -2395,6 +2424,7 @@ static struct command command_tbl[] = {
 	{ "greeting", LDMSD_GREETING_REQ, NULL, help_greeting, resp_greeting },
 	{ "help", LDMSCTL_HELP, handle_help, NULL, NULL },
 	{ "help", LDMSCTL_HELP, handle_help, NULL, NULL },
+	{ "latency_stats", LDMSD_LATENCY_STATS_REQ, NULL, help_latency_stats, resp_latency_stats },
 	{ "listen", LDMSD_LISTEN_REQ, NULL, help_listen, resp_generic },
 	{ "load", LDMSD_PLUGN_LOAD_REQ, NULL, help_load, resp_generic },
 	{ "log_level", LDMSD_VERBOSE_REQ, NULL, help_log_level, resp_generic },
@@ -73,8 +73,11 @@
 #include <assert.h>
 #include <libgen.h>
 #include <time.h>
+#include <sched.h>
+#include <sys/sysinfo.h>
 #include <coll/rbt.h>
 #include <coll/str_map.h>
+#include <coll/fnv_hash.h>
 #include "ovis_ev/ev.h"
 #include "ovis_ref/ref.h"
 #include "ldms.h"
@@ -421,6 +424,13 @@ void release_ovis_scheduler(int idx)
 	__sync_sub_and_fetch(&ev_count[idx], 1);
 }
 
+int ldmsd_shard_hash(const char *name)
+{
+	/* keep 24 bits so that it can be offset by the rail index */
+	uint32_t h = fnv_hash_a1_32(name, strlen(name), FNV_32_OFFSET_BASIS);
+	return (int)(h & 0xffffff);
+}
+
 pthread_t get_thread(int idx)
 {
 	return ev_thread[idx];
@@ -466,6 +476,39 @@ err:
 	return NULL;
 }
 
+/*
+ * Sampler groups
+ *
+ * The samplers started with the same `group=` share one periodic event on
+ * the group's own thread. On each wakeup, the members are sampled back to
+ * back in the order they joined the group, and the sets they update get
+ * the wakeup time as their transaction timestamp (see
+ * ldms_transaction_ts_set()). A group is created by the first sampler
+ * started in it, which also sets the group interval and offset. The group
+ * thread stays around once created; the event is removed when the last
+ * member stops.
+ */
+struct ldmsd_smplr_grp {
+	char *name;
+	pthread_mutex_t lock; /* protects the members and the schedule */
+	TAILQ_HEAD(, ldmsd_cfgobj_sampler) member_tq;
+	int n_members;
+	unsigned long interval_us;
+	long offset_us;
+	ovis_scheduler_t os;
+	pthread_t thread;
+	struct ovis_event_s oev;
+	/* member snapshot; used only by the group thread */
+	ldmsd_cfgobj_sampler_t *snap;
+	int snap_len;
+	LIST_ENTRY(ldmsd_smplr_grp) entry;
+};
+
+static pthread_mutex_t smplr_grp_list_lock = PTHREAD_MUTEX_INITIALIZER;
+static LIST_HEAD(, ldmsd_smplr_grp) smplr_grp_list =
+				LIST_HEAD_INITIALIZER(smplr_grp_list);
+static int smplr_grp_count = 0;
+
 struct ldmsd_worker_thrstat_result *ldmsd_xthrstat_get()
 {
 	/* TODO locks / race ... */
@@ -484,7 +527,7 @@ struct ldmsd_worker_thrstat_result *ldmsd_xthrstat_get()
 	clock_gettime(CLOCK_REALTIME, &now);
 
 	for (samp = ldmsd_sampler_first(); samp; samp = ldmsd_sampler_next(samp)) {
-		if (!samp->os || !samp->use_xthread)
+		if (!samp->os || !samp->use_xthread || samp->grp)
 			continue;
 		se = calloc(1, sizeof(*se));
 		if (!se)
@@ -497,6 +540,25 @@ struct ldmsd_worker_thrstat_result *ldmsd_xthrstat_get()
 		LIST_INSERT_HEAD(&lh, se, entry);
 		count++;
 	}
+	/* sampler group threads */
+	struct ldmsd_smplr_grp *grp;
+	pthread_mutex_lock(&smplr_grp_list_lock);
+	LIST_FOREACH(grp, &smplr_grp_list, entry) {
+		se = calloc(1, sizeof(*se));
+		if (!se) {
+			pthread_mutex_unlock(&smplr_grp_list_lock);
+			goto err1;
+		}
+		se->stat = ovis_scheduler_thrstats_get(grp->os, &now, 0);
+		if (!se->stat) {
+			free(se);
+			pthread_mutex_unlock(&smplr_grp_list_lock);
+			goto err1;
+		}
+		LIST_INSERT_HEAD(&lh, se, entry);
+		count++;
+	}
+	pthread_mutex_unlock(&smplr_grp_list_lock);
 	if (!count) {
 		errno = ENOENT;
 		return NULL;
@@ -534,10 +596,16 @@ void ldmsd_xthrstat_reset(struct timespec *now)
 {
 	ldmsd_cfgobj_sampler_t samp;
 	for (samp = ldmsd_sampler_first(); samp; samp = ldmsd_sampler_next(samp)) {
-		if (!samp->os || !samp->use_xthread)
+		if (!samp->os || !samp->use_xthread || samp->grp)
 			continue;
 		ovis_scheduler_thrstats_reset(samp->os, now);
 	}
+	struct ldmsd_smplr_grp *grp;
+	pthread_mutex_lock(&smplr_grp_list_lock);
+	LIST_FOREACH(grp, &smplr_grp_list, entry) {
+		ovis_scheduler_thrstats_reset(grp->os, now);
+	}
+	pthread_mutex_unlock(&smplr_grp_list_lock);
 }
 
 void kpublish(int map_fd, int set_no, int set_size, char *set_name)
@@ -643,6 +711,26 @@ static void stop_sampler(ldmsd_cfgobj_sampler_t samp)
 	ldmsd_cfgobj_put(&samp->cfg, "start");
 }
 
+/*
+ * Call the sampler's sample() and record its latency. \c wakeup is the
+ * group wakeup time if the sampler is sampled by its sampler group.
+ * The caller must hold the sampler lock.
+ */
+static int __sampler_sample(ldmsd_cfgobj_sampler_t samp, struct timespec *wakeup)
+{
+	struct timespec start, end;
+	int rc = 0;
+
+	clock_gettime(CLOCK_REALTIME, &start);
+	if (samp->api->sample)
+		rc = samp->api->sample(samp);
+	clock_gettime(CLOCK_REALTIME, &end);
+	ldmsd_lat_record(samp->lat, LDMSD_LAT_SAMPLE, &start, &end);
+	if (wakeup)
+		ldmsd_lat_record(samp->lat, LDMSD_LAT_GROUP, wakeup, &end);
+	return rc;
+}
+
 void plugin_sampler_cb(ovis_event_t oev)
 {
 	ldmsd_cfgobj_sampler_t samp = oev->param.ctxt;
@@ -650,9 +738,7 @@ void plugin_sampler_cb(ovis_event_t oev)
 	ldmsd_cfgobj_lock(&samp->cfg);
 	assert(samp->cfg.type == LDMSD_CFGOBJ_SAMPLER);
 	assert(samp->api->base.type == LDMSD_PLUGIN_SAMPLER);
-	int rc = 0;
-	if (samp->api->sample)
-		rc = samp->api->sample(samp);
+	int rc = __sampler_sample(samp, NULL);
 	if (rc) {
 		/*
 		 * If the sampler reports an error don't reschedule
@@ -830,11 +916,19 @@ static void task_cb_fn(ovis_event_t ev)
 void ldmsd_task_init(ldmsd_task_t task)
 {
 	memset(task, 0, sizeof *task);
+	task->shard = -1;
 	task->state = LDMSD_TASK_STATE_STOPPED;
 	pthread_mutex_init(&task->lock, NULL);
 	pthread_cond_init(&task->join_cv, NULL);
 }
 
+void ldmsd_task_shard_set(ldmsd_task_t task, int shard)
+{
+	pthread_mutex_lock(&task->lock);
+	task->shard = (shard < 0)?-1:shard;
+	pthread_mutex_unlock(&task->lock);
+}
+
 void ldmsd_task_stop(ldmsd_task_t task)
 {
 
@@ -882,7 +976,10 @@ int ldmsd_task_start(ldmsd_task_t task,
 		rc = EBUSY;
 		goto out;
 	}
-	task->thread_id = find_least_busy_thread();
+	if (task->shard < 0)
+		task->thread_id = find_least_busy_thread();
+	else
+		task->thread_id = task->shard % ev_thread_count;
 	task->os = get_ovis_scheduler(task->thread_id);
 	task->fn = task_fn;
 	task->fn_arg = task_arg;
@@ -963,6 +1060,182 @@ int __sampler_set_info_add(ldmsd_cfgobj_sampler_t samp, long interval_us, long o
 
 void *event_proc(void *v);
 
+/* The caller must hold the sampler lock */
+static void __smplr_grp_leave(ldmsd_cfgobj_sampler_t samp)
+{
+	struct ldmsd_smplr_grp *grp = samp->grp;
+
+	pthread_mutex_lock(&grp->lock);
+	TAILQ_REMOVE(&grp->member_tq, samp, grp_entry);
+	if (0 == --grp->n_members)
+		ovis_scheduler_event_del(grp->os, &grp->oev);
+	pthread_mutex_unlock(&grp->lock);
+	samp->grp = NULL;
+	samp->os = NULL;
+}
+
+static void smplr_grp_cb(ovis_event_t oev)
+{
+	struct ldmsd_smplr_grp *grp = oev->param.ctxt;
+	ldmsd_cfgobj_sampler_t samp, *snap;
+	struct timespec wakeup;
+	struct timeval tv;
+	int i, n, rc;
+
+	clock_gettime(CLOCK_REALTIME, &wakeup);
+	tv.tv_sec = wakeup.tv_sec;
+	tv.tv_usec = wakeup.tv_nsec / 1000;
+
+	/*
+	 * Take a snapshot of the members so that the sampler locks are not
+	 * taken under grp->lock; ldmsd_sampler_stop() takes them in the
+	 * other order.
+	 */
+	pthread_mutex_lock(&grp->lock);
+	if (grp->snap_len < grp->n_members) {
+		snap = realloc(grp->snap, grp->n_members * sizeof(*snap));
+		if (!snap) {
+			pthread_mutex_unlock(&grp->lock);
+			ovis_log(sampler_log, OVIS_LERROR,
+				 "sampler group '%s': out of memory\n",
+				 grp->name);
+			return;
+		}
+		grp->snap = snap;
+		grp->snap_len = grp->n_members;
+	}
+	n = 0;
+	TAILQ_FOREACH(samp, &grp->member_tq, grp_entry) {
+		grp->snap[n++] = ldmsd_sampler_get(samp, "grp_cb");
+	}
+	pthread_mutex_unlock(&grp->lock);
+
+	ldms_transaction_ts_set(&tv);
+	for (i = 0; i < n; i++) {
+		samp = grp->snap[i];
+		ldmsd_sampler_lock(samp);
+		if (samp->grp != grp)
+			goto next; /* stopped after the snapshot */
+		rc = __sampler_sample(samp, &wakeup);
+		if (rc) {
+			/* see plugin_sampler_cb() */
+			ovis_log(sampler_log, OVIS_LERROR,
+				"'%s': failed to sample. Stopping "
+				"the plug-in.\n", samp->cfg.name);
+			__smplr_grp_leave(samp);
+			ldmsd_sampler_put(samp, "start");
+		}
+	next:
+		ldmsd_sampler_unlock(samp);
+		ldmsd_sampler_put(samp, "grp_cb");
+	}
+	ldms_transaction_ts_set(NULL);
+}
+
+static struct ldmsd_smplr_grp *__smplr_grp_find_create(const char *name)
+{
+	struct ldmsd_smplr_grp *grp;
+	char tname[32];
+	char *affinity;
+	int rc, ncpu, cpu;
+
+	pthread_mutex_lock(&smplr_grp_list_lock);
+	LIST_FOREACH(grp, &smplr_grp_list, entry) {
+		if (0 == strcmp(grp->name, name))
+			goto out;
+	}
+	grp = calloc(1, sizeof(*grp));
+	if (!grp)
+		goto out;
+	grp->name = strdup(name);
+	if (!grp->name)
+		goto err_0;
+	pthread_mutex_init(&grp->lock, NULL);
+	TAILQ_INIT(&grp->member_tq);
+	grp->os = ovis_scheduler_new();
+	if (!grp->os)
+		goto err_1;
+	snprintf(tname, sizeof(tname), "smplr_grp_%d", smplr_grp_count);
+	ovis_scheduler_name_set(grp->os, tname);
+	rc = pthread_create(&grp->thread, NULL, event_proc, grp->os);
+	if (rc) {
+		errno = rc;
+		goto err_2;
+	}
+	pthread_setname_np(grp->thread, tname);
+	affinity = getenv("LDMSD_WORKER_AFFINITY");
+	if (affinity && atoi(affinity)) {
+		/* next to the worker threads */
+		cpu_set_t cpus;
+		ncpu = get_nprocs();
+		cpu = (ev_thread_count + smplr_grp_count) % (ncpu?ncpu:1);
+		CPU_ZERO(&cpus);
+		CPU_SET(cpu, &cpus);
+		rc = pthread_setaffinity_np(grp->thread, sizeof(cpus), &cpus);
+		if (rc)
+			ovis_log(sampler_log, OVIS_LWARN, "Cannot pin sampler "
+				 "group '%s' thread to CPU %d, error %d\n",
+				 name, cpu, rc);
+	}
+	smplr_grp_count++;
+	LIST_INSERT_HEAD(&smplr_grp_list, grp, entry);
+	goto out;
+
+ err_2:
+	ovis_scheduler_free(grp->os);
+ err_1:
+	free(grp->name);
+ err_0:
+	free(grp);
+	grp = NULL;
+ out:
+	pthread_mutex_unlock(&smplr_grp_list_lock);
+	return grp;
+}
+
+/* The caller must hold the sampler lock */
+static int __smplr_grp_join(ldmsd_cfgobj_sampler_t samp, const char *name)
+{
+	struct ldmsd_smplr_grp *grp;
+	int rc = 0;
+
+	grp = __smplr_grp_find_create(name);
+	if (!grp)
+		return errno?errno:ENOMEM;
+	pthread_mutex_lock(&grp->lock);
+	if (grp->n_members) {
+		if (grp->interval_us != samp->sample_interval_us ||
+		    grp->offset_us != samp->sample_offset_us) {
+			rc = EXDEV;
+			goto out;
+		}
+	} else {
+		grp->interval_us = samp->sample_interval_us;
+		grp->offset_us = samp->sample_offset_us;
+		OVIS_EVENT_INIT(&grp->oev);
+		grp->oev.param.type = OVIS_EVENT_PERIODIC;
+		grp->oev.param.periodic.period_us = grp->interval_us;
+		grp->oev.param.periodic.phase_us = grp->offset_us;
+		grp->oev.param.ctxt = grp;
+		grp->oev.param.cb_fn = smplr_grp_cb;
+		rc = ovis_scheduler_event_add(grp->os, &grp->oev);
+		if (rc)
+			goto out;
+	}
+	TAILQ_INSERT_TAIL(&grp->member_tq, samp, grp_entry);
+	grp->n_members++;
+	samp->grp = grp;
+	samp->os = grp->os;
+ out:
+	pthread_mutex_unlock(&grp->lock);
+	return rc;
+}
+
+const char *ldmsd_sampler_group_name(ldmsd_cfgobj_sampler_t samp)
+{
+	return samp->grp ? samp->grp->name : NULL;
+}
+
 int ldmsd_sampler_xthread_create(ldmsd_cfgobj_sampler_t samp)
 {
 	/* Create exclusive thread and scheduler */
@@ -1003,7 +1276,7 @@ int ldmsd_sampler_xthread_delete(ldmsd_cfgobj_sampler_t samp)
  * Start the sampler
  */
 int ldmsd_sampler_start(char *cfg_name, char *interval, char *offset,
-			char *exclusive_thread)
+			char *exclusive_thread, char *group)
 {
 	int rc = 0;
 	long sample_interval;
@@ -1012,6 +1285,7 @@ int ldmsd_sampler_start(char *cfg_name, char *interval, char *offset,
 	if (!samp)
 		return ENOENT;
 
+	ldmsd_sampler_lock(samp);
 	if (samp->os) {
 		rc = EBUSY;
 		goto out;
@@ -1023,7 +1297,7 @@ int ldmsd_sampler_start(char *cfg_name, char *interval, char *offset,
 
 	rc = ovis_time_str2us(interval, &sample_interval);
 	if (rc)
-		return rc;
+		goto out;
 
 	samp->sample_interval_us = sample_interval;
 	if (offset) {
@@ -1051,7 +1325,11 @@ int ldmsd_sampler_start(char *cfg_name, char *interval, char *offset,
 	samp->oev.param.ctxt = samp;
 	samp->oev.param.cb_fn = plugin_sampler_cb;
 
-	if (samp->use_xthread) {
+	if (group) {
+		rc = __smplr_grp_join(samp, group);
+		if (rc)
+			goto out;
+	} else if (samp->use_xthread) {
 		rc = ldmsd_sampler_xthread_create(samp);
 		if (rc)
 			goto out;
@@ -1186,7 +1464,10 @@ int ldmsd_sampler_stop(char *cfg_name)
 		return ENOENT;
 
 	ldmsd_sampler_lock(samp);
-	if (samp->os) {
+	if (samp->grp) {
+		__smplr_grp_leave(samp);
+		ldmsd_sampler_put(samp, "start");
+	} else if (samp->os) {
 		ovis_scheduler_event_del(samp->os, &samp->oev);
 		if (samp->use_xthread) {
 			ldmsd_sampler_xthread_delete(samp);
@@ -1250,6 +1531,57 @@ void ldmsd_stat_reset(struct ldmsd_stat *stats, struct timespec *now)
 	stats->start = *now;
 }
 
+static const char *__lat_op_str[] = {
+	[LDMSD_LAT_LOOKUP] = "lookup",
+	[LDMSD_LAT_UPDATE] = "update",
+	[LDMSD_LAT_STORE]  = "store",
+	[LDMSD_LAT_DECOMP] = "decomposition",
+	[LDMSD_LAT_COMMIT] = "commit",
+	[LDMSD_LAT_PUSH]   = "push",
+	[LDMSD_LAT_SAMPLE] = "sample",
+	[LDMSD_LAT_GROUP]  = "group_sample",
+};
+
+const char *ldmsd_lat_op_str(enum ldmsd_lat_op op)
+{
+	if (op < 0 || op >= LDMSD_LAT_LAST)
+		return "unknown";
+	return __lat_op_str[op];
+}
+
+int ldmsd_lat_alloc(ldmsd_lat_t lat, int op_mask)
+{
+	int op;
+	for (op = 0; op < LDMSD_LAT_LAST; op++) {
+		if (!(op_mask & LDMSD_LAT_F(op)))
+			continue;
+		lat[op] = ovis_thrstats_hist_new();
+		if (!lat[op]) {
+			ldmsd_lat_free(lat);
+			return ENOMEM;
+		}
+	}
+	return 0;
+}
+
+void ldmsd_lat_free(ldmsd_lat_t lat)
+{
+	int op;
+	for (op = 0; op < LDMSD_LAT_LAST; op++) {
+		ovis_thrstats_hist_free(lat[op]);
+		lat[op] = NULL;
+	}
+}
+
+void ldmsd_lat_reset(ldmsd_lat_t lat)
+{
+	int op;
+	for (op = 0; op < LDMSD_LAT_LAST; op++) {
+		if (lat[op])
+			ovis_thrstats_hist_reset(lat[op]);
+	}
+}
+
 void *event_proc(void *v)
 {
 	ovis_scheduler_t os = v;
@@ -2175,6 +2507,8 @@ int main(int argc, char *argv[])
 		exit(1);
 	}
 	char tname[256];
+	char *wkr_affinity = getenv("LDMSD_WORKER_AFFINITY");
+	int ncpu = get_nprocs();
 	for (op = 0; op < ev_thread_count; op++) {
 		snprintf(tname, sizeof(tname), "ldmsd_wkr_%d", op);
 		ovis_scheduler[op] = ovis_scheduler_new();
@@ -2190,6 +2524,16 @@ int main(int argc, char *argv[])
 			cleanup(7, "event thread create fail");
 		}
 		pthread_setname_np(ev_thread[op], tname);
+		if (wkr_affinity && atoi(wkr_affinity)) {
+			cpu_set_t cpus;
+			CPU_ZERO(&cpus);
+			CPU_SET(op % (ncpu?ncpu:1), &cpus);
+			ret = pthread_setaffinity_np(ev_thread[op], sizeof(cpus), &cpus);
+			if (ret)
+				ovis_log(NULL, OVIS_LWARN, "Cannot pin worker "
+					 "thread %d to CPU %d, error %d\n", op,
+					 op % (ncpu?ncpu:1), ret);
+		}
 	}
 
 	if (!setfile)
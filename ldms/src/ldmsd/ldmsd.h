@@ -131,6 +131,7 @@ struct ldmsd_task;
 typedef void (*ldmsd_task_fn_t)(struct ldmsd_task *, void *arg);
 typedef struct ldmsd_task {
 	int thread_id;
+	int shard; /* -1 for the least busy worker, see ldmsd_task_shard_set() */
 	int flags;
 	long sched_us;
 	long offset_us;
@@ -187,6 +188,11 @@ typedef void (*ldmsd_cfgobj_del_fn_t)(struct ldmsd_cfgobj *);
 /* can execute even if the failover is turned on */
 #define LDMSD_PERM_FAILOVER_ALLOWED 04000
 
+/* modifies the prdcr/updtr/strgp configuration that the failover replicates
+ * to its peer; allowed while the failover is turned on, but never on the
+ * objects replicated from the peer (LDMSD_FAILOVER_NAME_PREFIX) */
+#define LDMSD_PERM_FAILOVER_REPLICATED 020000
+
 struct attr_value_list;
 struct avl_q_item {
 	struct attr_value_list *av_list;
@@ -208,6 +214,44 @@ typedef struct ldmsd_cfgobj {
 	char *kvl_str;
 } *ldmsd_cfgobj_t;
 
+/**
+ * Per-operation latency histograms
+ *
+ * Each producer, updater, storage policy and sampler carries an array of
+ * histograms indexed by \c ldmsd_lat_op. Only the entries that make sense
+ * for the object type are allocated; the others are left NULL and
+ * ::ldmsd_lat_record() ignores them. Recording is lock-free (see
+ * ovis_thrstats_hist_record()), so it is safe to record from the xprt
+ * completion threads without holding the cfgobj lock.
+ */
+enum ldmsd_lat_op {
+	LDMSD_LAT_LOOKUP,	/* ldms_xprt_lookup() request to completion */
+	LDMSD_LAT_UPDATE,	/* ldms_xprt_update() request to completion */
+	LDMSD_LAT_STORE,	/* strgp update_fn() (decomposition + commit) */
+	LDMSD_LAT_DECOMP,	/* decomposer decompose() */
+	LDMSD_LAT_COMMIT,	/* store commit() */
+	LDMSD_LAT_PUSH,		/* ldms_xprt_push() */
+	LDMSD_LAT_SAMPLE,	/* sampler sample() */
+	LDMSD_LAT_GROUP,	/* sampler group wakeup to the end of sample() */
+	LDMSD_LAT_LAST
+};
+
+#define LDMSD_LAT_F(op) (1 << (op))
+typedef ovis_thrstats_hist_t ldmsd_lat_t[LDMSD_LAT_LAST];
+
+int ldmsd_lat_alloc(ldmsd_lat_t lat, int op_mask);
+void ldmsd_lat_free(ldmsd_lat_t lat);
+void ldmsd_lat_reset(ldmsd_lat_t lat);
+const char *ldmsd_lat_op_str(enum ldmsd_lat_op op);
+
+static inline
+void ldmsd_lat_record(ldmsd_lat_t lat, enum ldmsd_lat_op op,
+		      struct timespec *start, struct timespec *end)
+{
+	if (lat[op] && start->tv_sec)
+		ovis_thrstats_hist_record_ts(lat[op], start, end);
+}
+
 typedef struct ldmsd_prdcr_stream_s {
 	char *name;
 	char *msg;
@@ -319,6 +363,13 @@ typedef struct ldmsd_prdcr {
 		LDMSD_PRDCR_TYPE_ADVERTISED_ACTIVE,
 	} type;
 
+	/**
+	 * Stable hash of the producer name. It selects the worker thread of
+	 * the producer task and the zap I/O thread pool of the producer
+	 * connection so that all work of the producer stays on one shard.
+	 */
+	int shard;
+
 	struct ldmsd_task task;
 
 	/**
@@ -343,6 +394,8 @@ typedef struct ldmsd_prdcr {
 	int rail; /* the number of xprt in the rail */
 	int64_t quota;
 	int64_t rx_rate;
+
+	ldmsd_lat_t lat; /* lookup, update, store and push latencies */
 } *ldmsd_prdcr_t;
 
 struct ldmsd_strgp;
@@ -396,6 +449,8 @@ typedef struct ldmsd_prdcr_set {
 	uint64_t last_gn;
 	pthread_mutex_t lock;
 	LIST_HEAD(ldmsd_strgp_ref_list, ldmsd_strgp_ref) strgp_list;
+	/* rows decomposed in the current update, shared among the strgps */
+	LIST_HEAD(, ldmsd_row_share_s) row_share_list;
 	struct rbn rbn;
 
 	LIST_ENTRY(ldmsd_prdcr_set) updt_hint_entry;
@@ -414,6 +469,8 @@ typedef struct ldmsd_prdcr_set {
 
 	int ref_count;
 	struct timespec lookup_complete_ts;
+	struct timespec lookup_req_ts; /* when the lookup was requested */
+	ldmsd_updtr_ptr updt_updtr; /* updater of the outstanding update */
 } *ldmsd_prdcr_set_t;
 
 typedef struct ldmsd_prdcr_ref {
@@ -546,6 +603,8 @@ typedef struct ldmsd_updtr {
 	 */
 	struct rbt prdcr_tree;
 	LIST_HEAD(updtr_match_list, ldmsd_name_match) match_list;
+
+	ldmsd_lat_t lat; /* update and store latencies */
 } *ldmsd_updtr_t;
 
 typedef struct ldmsd_name_match {
@@ -561,7 +620,16 @@ typedef struct ldmsd_name_match {
 		LDMSD_NAME_MATCH_SCHEMA_NAME,
 	} selector;
 
+	/**
+	 * The literal name if regex_str is "^name$". Such matches are
+	 * indexed by name in the storage policy instead of being tried
+	 * one by one.
+	 */
+	char *name;
+	struct rbn rbn;
+
 	LIST_ENTRY(ldmsd_name_match) entry;
+	LIST_ENTRY(ldmsd_name_match) regex_entry;
 } *ldmsd_name_match_t;
 
 /** Storage Policy: Defines which producers and metrics are
@@ -639,6 +707,10 @@ struct ldmsd_strgp {
 
 	/** A set of match strings to select a subset of all producers */
 	LIST_HEAD(ldmsd_strgp_prdcr_list, ldmsd_name_match) prdcr_list;
+	/** The prdcr_list matches that are real regular expressions */
+	LIST_HEAD(, ldmsd_name_match) prdcr_regex_list;
+	/** The prdcr_list matches that are producer names, by name */
+	struct rbt prdcr_name_tree;
 
 	/** A list of the names of the metrics in the set specified by schema */
 	TAILQ_HEAD(ldmsd_strgp_metric_list, ldmsd_strgp_metric) metric_list;
@@ -679,6 +751,13 @@ struct ldmsd_strgp {
 	/** Decomposer resource handle */
 	struct ldmsd_decomp_s *decomp;
 	char *decomp_path;	/* path to decomposition configuration */
+	/*
+	 * The canonical (compact, key-sorted) decomposition configuration.
+	 * Storage policies with the same key decompose a set update once
+	 * and commit the same rows.
+	 */
+	char *decomp_key;
+	uint64_t decomp_key_hash;
 
 	/** Regular expression for the schema */
 	regex_t schema_regex;
@@ -688,6 +767,8 @@ struct ldmsd_strgp {
 
 	int row_cache_init;
 	ldmsd_row_cache_t row_cache;
+
+	ldmsd_lat_t lat; /* store, decomposition and commit latencies */
 };
 
 
@@ -989,6 +1070,7 @@ struct ldmsd_store {
 	int (*flush)(ldmsd_plug_handle_t handle, ldmsd_store_handle_t sh);
 	int (*store)(ldmsd_plug_handle_t handle, ldmsd_store_handle_t sh,
 		     ldms_set_t set, int *, size_t count);
+	/* The rows may be shared with other storage policies; treat them as read-only. */
 	int (*commit)(ldmsd_plug_handle_t handle, ldmsd_strgp_t strgp, ldms_set_t set,
 		      ldmsd_row_list_t row_list, int row_count);
 };
@@ -1060,6 +1142,13 @@ struct ldmsd_cfgobj_sampler {
 	LIST_HEAD(, ldmsd_sampler_set) set_list;
 	int use_xthread; /* !0 if use exclusitve thread */
 	pthread_t xthread; /* the exclusive thread */
+
+	/* The sampler group this sampler is started in; see
+	 * ldmsd_sampler_start() */
+	struct ldmsd_smplr_grp *grp;
+	TAILQ_ENTRY(ldmsd_cfgobj_sampler) grp_entry;
+
+	ldmsd_lat_t lat; /* LDMSD_LAT_SAMPLE and LDMSD_LAT_GROUP */
 };
 
 #define LDMSD_DEFAULT_SAMPLE_INTERVAL 1000000
@@ -1267,6 +1356,7 @@ void ldmsd_cfgobj_find_put(ldmsd_cfgobj_t obj);
 void ldmsd_cfgobj_del(ldmsd_cfgobj_t obj);
 ldmsd_cfgobj_t ldmsd_cfgobj_first(ldmsd_cfgobj_type_t type);
 ldmsd_cfgobj_t ldmsd_cfgobj_next(ldmsd_cfgobj_t obj);
+const char *ldmsd_cfgobj_type_str(ldmsd_cfgobj_type_t t);
 int ldmsd_cfgobj_access_check(ldmsd_cfgobj_t obj, int acc, ldmsd_sec_ctxt_t ctxt);
 int ldmsd_cfgobj_add(ldmsd_cfgobj_t obj);
 void ldmsd_cfgobj_rm(ldmsd_cfgobj_t obj);
@@ -1285,7 +1375,8 @@ ldmsd_cfgobj_sampler_t ldmsd_sampler_next(ldmsd_cfgobj_sampler_t);
 void ldmsd_sampler_lock(ldmsd_cfgobj_sampler_t samp);
 void ldmsd_sampler_unlock(ldmsd_cfgobj_sampler_t samp);
 extern int ldmsd_sampler_start(char *cfg_name, char *interval, char *offset,
-			char *exclusive_thread);
+			char *exclusive_thread, char *group);
+const char *ldmsd_sampler_group_name(ldmsd_cfgobj_sampler_t samp);
 extern int ldmsd_sampler_stop(char *name);
 
 /* NOTE: Caller must call ldms_store_find_put() to drop reference in returned object. */
@@ -1301,6 +1392,32 @@ void ldmsd_store_unlock(ldmsd_cfgobj_store_t store);
 	for ((obj) = ldmsd_cfgobj_first(type); (obj);  \
 			(obj) = ldmsd_cfgobj_next(obj))
 
+/**
+ * Name matcher over a configuration object tree
+ *
+ * The objects are sorted by name, so an expression anchored with a literal
+ * prefix (e.g. "^node1" or "^node12$") only visits the objects in the prefix
+ * range instead of running the regular expression on every object.
+ */
+typedef struct ldmsd_cfgobj_match_s {
+	regex_t regex;
+	char *prefix;	/* literal prefix of the anchored expression */
+	size_t plen;
+	int exact;	/* the expression is "^prefix$" */
+} *ldmsd_cfgobj_match_t;
+int ldmsd_cfgobj_match_init(ldmsd_cfgobj_match_t m, const char *ex,
+			    char *errbuf, size_t errsz);
+void ldmsd_cfgobj_match_fini(ldmsd_cfgobj_match_t m);
+/* The caller must hold the cfgobj_type lock. */
+ldmsd_cfgobj_t ldmsd_cfgobj_match_first(ldmsd_cfgobj_match_t m,
+					ldmsd_cfgobj_type_t type);
+ldmsd_cfgobj_t ldmsd_cfgobj_match_next(ldmsd_cfgobj_match_t m,
+				       ldmsd_cfgobj_t obj);
+
+#define LDMSD_CFGOBJ_MATCH_FOREACH(obj, m, type) \
+	for ((obj) = ldmsd_cfgobj_match_first(m, type); (obj);  \
+			(obj) = ldmsd_cfgobj_match_next(m, obj))
+
 /** Producer configuration object management */
 int ldmsd_prdcr_str2type(const char *type);
 const char *ldmsd_prdcr_type2str(enum ldmsd_prdcr_type type);
@@ -1447,6 +1564,7 @@ ldmsd_strgp_t ldmsd_strgp_first();
 ldmsd_strgp_t ldmsd_strgp_next(struct ldmsd_strgp *strgp);
 ldmsd_name_match_t ldmsd_strgp_prdcr_first(ldmsd_strgp_t strgp);
 ldmsd_name_match_t ldmsd_strgp_prdcr_next(ldmsd_name_match_t match);
+int ldmsd_strgp_prdcr_match(ldmsd_strgp_t strgp, const char *prdcr_name);
 ldmsd_strgp_metric_t ldmsd_strgp_metric_first(ldmsd_strgp_t strgp);
 ldmsd_strgp_metric_t ldmsd_strgp_metric_next(ldmsd_strgp_metric_t metric);
 static inline ldmsd_strgp_t ldmsd_strgp_get(ldmsd_strgp_t strgp, char *name) {
@@ -1485,6 +1603,8 @@ int __ldmsd_strgp_stop(ldmsd_strgp_t strgp, ldmsd_sec_ctxt_t ctxt);
 void ldmsd_prdcr_update(ldmsd_strgp_t strgp);
 void ldmsd_strgp_update(ldmsd_prdcr_set_t prd_set);
 int ldmsd_strgp_update_prdcr_set(ldmsd_strgp_t strgp, ldmsd_prdcr_set_t prd_set);
+/* Release the rows shared by the strgps in the set update; prd_set->lock held */
+void ldmsd_strgp_row_share_release(ldmsd_prdcr_set_t prd_set);
 int ldmsd_strgp_prdcr_add(const char *strgp_name, const char *regex_str,
 			  char *rep_buf, size_t rep_len, ldmsd_sec_ctxt_t ctxt);
 int ldmsd_strgp_prdcr_del(const char *strgp_name, const char *regex_str,
@@ -1508,6 +1628,7 @@ int ldmsd_failover_config(const char *host, const char *port, const char *xprt,
 			  int auto_switch, uint64_t interval_us);
 int ldmsd_failover_start();
 int cfgobj_is_failover(ldmsd_cfgobj_t obj);
+void ldmsd_failover_cfg_changed(ldmsd_req_ctxt_t reqc);
 int ldmsd_cfgobjs_start(int (*filter)(ldmsd_cfgobj_t));
 
 int ldmsd_ourcfg_start_proc();
@@ -1522,11 +1643,53 @@ int ldmsd_task_resched(ldmsd_task_t task,
 void ldmsd_task_stop(ldmsd_task_t task);
 void ldmsd_task_join(ldmsd_task_t task);
 
+/**
+ * \brief Pin a task to a shard
+ *
+ * The task is scheduled on the worker thread <tt>shard % worker_threads</tt>
+ * instead of the least busy worker thread. It takes effect at the next
+ * ldmsd_task_start().
+ *
+ * \param task  The task handle
+ * \param shard The shard, e.g. from ldmsd_shard_hash(), or -1 to use the
+ *              least busy worker thread.
+ */
+void ldmsd_task_shard_set(ldmsd_task_t task, int shard);
+
+/**
+ * \brief Return the shard of a configuration object name
+ *
+ * The shard is a stable, non-negative hash of \c name. Work that belongs to
+ * the same object (e.g. a producer) is kept on the same worker thread and
+ * zap I/O thread pool by using the same shard.
+ */
+int ldmsd_shard_hash(const char *name);
+
 int ldmsd_set_update_hint_set(ldms_set_t set, long interval_us, long offset_us);
 int ldmsd_set_update_hint_get(ldms_set_t set, long *interva_us, long *offset_us);
 
 /** Regular expressions */
 int ldmsd_compile_regex(regex_t *regex, const char *ex, char *errbuf, size_t errsz);
+char *ldmsd_regex_prefix(const char *ex, int *exact);
+
+/**
+ * \brief Expand a hostlist expression
+ *
+ * E.g. "node[01-03,7],login" expands to "node01", "node02", "node03",
+ * "node7" and "login".
+ *
+ * \param expr The hostlist expression
+ * \param _names Receives an array of the \c *_count expanded names. Free it
+ *               with ldmsd_hostlist_free().
+ * \param _count Receives the number of names
+ *
+ * \retval 0      Success
+ * \retval EINVAL \c expr is malformed
+ * \retval E2BIG  The expression expands to too many names
+ * \retval ENOMEM Out of memory
+ */
+int ldmsd_hostlist_expand(const char *expr, char ***_names, int *_count);
+void ldmsd_hostlist_free(char **names, int count);
 
 /* Receive a message from an ldms endpoint */
 void ldmsd_recv_msg(ldms_t x, char *data, size_t data_len);
@@ -181,6 +181,9 @@ static const char *__cfgobj_type_str[] = {
 	[LDMSD_CFGOBJ_STRGP]  = "strgp",
 	[LDMSD_CFGOBJ_LISTEN] = "listen",
 	[LDMSD_CFGOBJ_AUTH]   = "auth",
+	[LDMSD_CFGOBJ_PRDCR_LISTEN] = "prdcr_listen",
+	[LDMSD_CFGOBJ_SAMPLER] = "sampler",
+	[LDMSD_CFGOBJ_STORE]  = "store",
 };
 
 const char *ldmsd_cfgobj_type_str(ldmsd_cfgobj_type_t t)
@@ -347,6 +350,72 @@ out:
 	return nobj;
 }
 
+int ldmsd_cfgobj_match_init(ldmsd_cfgobj_match_t m, const char *ex,
+			    char *errbuf, size_t errsz)
+{
+	int rc;
+	rc = ldmsd_compile_regex(&m->regex, ex, errbuf, errsz);
+	if (rc)
+		return rc;
+	m->prefix = ldmsd_regex_prefix(ex, &m->exact);
+	m->plen = (m->prefix)?strlen(m->prefix):0;
+	return 0;
+}
+
+void ldmsd_cfgobj_match_fini(ldmsd_cfgobj_match_t m)
+{
+	regfree(&m->regex);
+	free(m->prefix);
+	m->prefix = NULL;
+}
+
+static ldmsd_cfgobj_t __cfgobj_match_from(ldmsd_cfgobj_match_t m, struct rbn *n)
+{
+	ldmsd_cfgobj_t obj;
+	for (; n; n = rbn_succ(n)) {
+		obj = container_of(n, struct ldmsd_cfgobj, rbn);
+		/* The names with the prefix are contiguous in the tree */
+		if (m->plen && strncmp(obj->name, m->prefix, m->plen))
+			break;
+		if (0 == regexec(&m->regex, obj->name, 0, NULL, 0))
+			return ldmsd_cfgobj_get(obj, "iter");
+		if (m->exact)
+			break;
+	}
+	return NULL;
+}
+
+/**
+ * Return the first configuration object of the given type matching \c m
+ *
+ * This function must be called with the cfgobj_type lock held
+ */
+ldmsd_cfgobj_t ldmsd_cfgobj_match_first(ldmsd_cfgobj_match_t m,
+					ldmsd_cfgobj_type_t type)
+{
+	struct rbn *n;
+	if (m->plen)
+		n = rbt_find_lub(cfgobj_trees[type], m->prefix);
+	else
+		n = rbt_min(cfgobj_trees[type]);
+	return __cfgobj_match_from(m, n);
+}
+
+/**
+ * Return the next configuration object matching \c m
+ *
+ * This function must be called with the cfgobj_type lock held
+ */
+ldmsd_cfgobj_t ldmsd_cfgobj_match_next(ldmsd_cfgobj_match_t m,
+				       ldmsd_cfgobj_t obj)
+{
+	ldmsd_cfgobj_t nobj = NULL;
+	if (!m->exact)
+		nobj = __cfgobj_match_from(m, rbn_succ(&obj->rbn));
+	ldmsd_cfgobj_put(obj, "iter");	/* Drop the next reference */
+	return nobj;
+}
+
 ldmsd_cfgobj_sampler_t ldmsd_sampler_first()
 {
 	ldmsd_cfgobj_t obj;
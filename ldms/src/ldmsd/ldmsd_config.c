@@ -234,6 +234,10 @@ ldmsd_sampler_add(const char *cfg_name,
         sampler->plugin = plugin;
 	sampler->api = (struct ldmsd_sampler *)plugin->api;
 	sampler->thread_id = -1; /* stopped */
+	rc = ldmsd_lat_alloc(sampler->lat, LDMSD_LAT_F(LDMSD_LAT_SAMPLE) |
+					   LDMSD_LAT_F(LDMSD_LAT_GROUP));
+	if (rc)
+		goto err;
 	if (sampler->api->base.constructor != NULL) {
 		rc = sampler->api->base.constructor(&sampler->cfg);
 		if (rc)
@@ -343,6 +347,196 @@ int ldmsd_compile_regex(regex_t *regex, const char *regex_str,
 	return rc;
 }
 
+/*
+ * Return the literal prefix of an anchored extended regular expression in a
+ * newly allocated string, or NULL if the expression has no such prefix.
+ * \c exact is set to 1 if the expression matches the prefix only, i.e. it is
+ * "^literal$".
+ */
+char *ldmsd_regex_prefix(const char *ex, int *exact)
+{
+	const char *s;
+	char *buf, *b;
+	int n;
+
+	*exact = 0;
+	/* A top-level alternative is not bound by the anchor */
+	if (ex[0] != '^' || strchr(ex, '|'))
+		return NULL;
+	buf = b = malloc(strlen(ex));
+	if (!buf)
+		return NULL;
+	for (s = ex + 1; *s; s += n) {
+		n = 1;
+		if (*s == '\\') {
+			/* escaped punctuation, but not the GNU anchors */
+			if (!ispunct(s[1]) || strchr("<>`'", s[1]))
+				break;
+			n = 2;
+		} else if (strchr(".[]()*+?{}^$", *s)) {
+			break;
+		}
+		/* a quantified character is optional */
+		if (s[n] == '*' || s[n] == '?' || s[n] == '{')
+			break;
+		*b++ = s[n - 1];
+		if (s[n] == '+') {
+			s += n;
+			break;
+		}
+	}
+	*b = '\0';
+	if (b == buf) {
+		free(buf);
+		return NULL;
+	}
+	if (0 == strcmp(s, "$"))
+		*exact = 1;
+	return buf;
+}
+
+#define LDMSD_HOSTLIST_MAX (1024*1024)
+
+struct hostlist_buf {
+	char **names;
+	int count;
+	int alloc;
+};
+
+static int hostlist_push(struct hostlist_buf *hl, const char *name)
+{
+	char **names;
+	if (hl->count >= LDMSD_HOSTLIST_MAX)
+		return E2BIG;
+	if (hl->count == hl->alloc) {
+		hl->alloc = hl->alloc ? hl->alloc * 2 : 64;
+		names = realloc(hl->names, hl->alloc * sizeof(*names));
+		if (!names)
+			return ENOMEM;
+		hl->names = names;
+	}
+	hl->names[hl->count] = strdup(name);
+	if (!hl->names[hl->count])
+		return ENOMEM;
+	hl->count++;
+	return 0;
+}
+
+/*
+ * Expand the host expression \c s of length \c len (no top-level comma)
+ * with \c pfx prepended. Each [..] group is expanded in turn.
+ */
+static int hostlist_expand_one(struct hostlist_buf *hl, const char *pfx,
+			       const char *s, size_t len)
+{
+	const char *lb, *rb, *r, *next;
+	char *buf, *end;
+	unsigned long lo, hi, v;
+	int width, rc = 0;
+	size_t plen = strlen(pfx);
+
+	lb = memchr(s, '[', len);
+	if (!lb) {
+		buf = malloc(plen + len + 1);
+		if (!buf)
+			return ENOMEM;
+		memcpy(buf, pfx, plen);
+		memcpy(buf + plen, s, len);
+		buf[plen + len] = '\0';
+		rc = hostlist_push(hl, buf);
+		free(buf);
+		return rc;
+	}
+	rb = memchr(lb, ']', len - (lb - s));
+	if (!rb)
+		return EINVAL;
+	/* pfx + text before '[' + up to 20 digits */
+	buf = malloc(plen + (lb - s) + 24);
+	if (!buf)
+		return ENOMEM;
+	for (r = lb + 1; r < rb; r = next + 1) {
+		next = memchr(r, ',', rb - r);
+		if (!next)
+			next = rb;
+		if (!isdigit(*r)) {
+			rc = EINVAL;
+			goto out;
+		}
+		width = 0;
+		while (r + width < next && isdigit(r[width]))
+			width++;
+		lo = hi = strtoul(r, &end, 10);
+		if (end < next) {
+			if (*end != '-' || !isdigit(end[1])) {
+				rc = EINVAL;
+				goto out;
+			}
+			hi = strtoul(end + 1, &end, 10);
+		}
+		if (end != next || hi < lo) {
+			rc = EINVAL;
+			goto out;
+		}
+		if (hi - lo >= LDMSD_HOSTLIST_MAX) {
+			rc = E2BIG;
+			goto out;
+		}
+		for (v = lo; v <= hi; v++) {
+			snprintf(buf, plen + (lb - s) + 24, "%s%.*s%0*lu", pfx,
+				 (int)(lb - s), s, (r[0] == '0')?width:0, v);
+			rc = hostlist_expand_one(hl, buf, rb + 1,
+						 len - (rb + 1 - s));
+			if (rc)
+				goto out;
+		}
+	}
+ out:
+	free(buf);
+	return rc;
+}
+
+void ldmsd_hostlist_free(char **names, int count)
+{
+	int i;
+	for (i = 0; i < count; i++)
+		free(names[i]);
+	free(names);
+}
+
+int ldmsd_hostlist_expand(const char *expr, char ***_names, int *_count)
+{
+	struct hostlist_buf hl = {0};
+	const char *s, *e;
+	int depth, rc = 0;
+
+	for (s = expr; *s; s = e + (*e == ',')) {
+		/* split at the commas outside of the brackets */
+		for (depth = 0, e = s; *e && (depth || *e != ','); e++) {
+			if (*e == '[')
+				depth++;
+			else if (*e == ']')
+				depth--;
+		}
+		if (e == s || depth) {
+			rc = EINVAL;
+			goto err;
+		}
+		rc = hostlist_expand_one(&hl, "", s, e - s);
+		if (rc)
+			goto err;
+	}
+	if (!hl.count) {
+		rc = EINVAL;
+		goto err;
+	}
+	*_names = hl.names;
+	*_count = hl.count;
+	return 0;
+ err:
+	ldmsd_hostlist_free(hl.names, hl.count);
+	return rc;
+}
+
 void ldmsd_sampler___del(ldmsd_cfgobj_t obj)
 {
 	ldmsd_cfgobj_sampler_t samp = (void*)obj;
@@ -350,6 +544,7 @@ void ldmsd_sampler___del(ldmsd_cfgobj_t obj)
 		samp->plugin->api->destructor(obj);
         unload_plugin(samp->plugin);
         ovis_log_deregister(samp->log);
+	ldmsd_lat_free(samp->lat);
 	ldmsd_cfgobj___del(obj);
 }
 
@@ -1133,16 +1328,17 @@ err:
 
 int __req_deferred_start_regex(ldmsd_req_ctxt_t reqc, ldmsd_cfgobj_type_t type)
 {
-	regex_t regex = {0};
+	struct ldmsd_cfgobj_match_s m;
 	ldmsd_cfgobj_t obj;
 	int rc;
 	char *val;
+	char errbuf[128];
 	val = ldmsd_req_attr_str_value_get_by_id(reqc, LDMSD_ATTR_REGEX);
 	if (!val) {
 		ovis_log(NULL, OVIS_LERROR, "`regex` attribute is required.\n");
 		return EINVAL;
 	}
-	rc = regcomp(&regex, val, REG_NOSUB);
+	rc = ldmsd_cfgobj_match_init(&m, val, errbuf, sizeof(errbuf));
 	if (rc) {
 		ovis_log(NULL, OVIS_LERROR, "Bad regex: %s\n", val);
 		free(val);
@@ -1150,13 +1346,11 @@ int __req_deferred_start_regex(ldmsd_req_ctxt_t reqc, ldmsd_cfgobj_type_t type)
 	}
 	free(val);
 	ldmsd_cfg_lock(type);
-	LDMSD_CFGOBJ_FOREACH(obj, type) {
-		rc = regexec(&regex, obj->name, 0, NULL, 0);
-		if (rc == 0) {
-			obj->perm |= LDMSD_PERM_DSTART;
-		}
+	LDMSD_CFGOBJ_MATCH_FOREACH(obj, &m, type) {
+		obj->perm |= LDMSD_PERM_DSTART;
 	}
 	ldmsd_cfg_unlock(type);
+	ldmsd_cfgobj_match_fini(&m);
 	return 0;
 }
 
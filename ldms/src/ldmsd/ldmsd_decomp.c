@@ -63,6 +63,7 @@
 
 #include <jansson.h>
 #include "coll/rbt.h"
+#include "coll/fnv_hash.h"
 
 #include "ldmsd.h"
 #include "ldmsd_request.h"
@@ -264,6 +265,18 @@ int ldmsd_decomp_config(ldmsd_strgp_t strgp, const char *json_path, ldmsd_req_ct
 		rc = errno;
 		goto err_1;
 	}
+	/*
+	 * The strgps with the same configuration share the decomposed rows.
+	 * A strgp with a row cache (functional operators) must decompose every
+	 * update itself to keep its cache current, so it does not share.
+	 */
+	if (!strgp->row_cache) {
+		strgp->decomp_key = json_dumps(root, JSON_COMPACT | JSON_SORT_KEYS);
+		if (strgp->decomp_key)
+			strgp->decomp_key_hash = fnv_hash_a1_64(strgp->decomp_key,
+						strlen(strgp->decomp_key),
+						FNV_64_OFFSET_BASIS);
+	}
 
 	/* decomp config success! */
 	rc = 0;
@@ -56,8 +56,10 @@
 #include <assert.h>
 #include <pthread.h>
 #include <netdb.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <math.h>
+#include <unistd.h>
 
 #include "coll/rbt.h"
 #include "ovis_event/ovis_event.h"
@@ -72,6 +74,8 @@
 #define DEFAULT_PING_INTERVAL 1000000 /* unit: uSec */
 #define DEFAULT_AUTOSWITCH 1
 #define DEFAULT_TIMEOUT_FACTOR 2
+#define CHG_LOG_MAX 65536 /* max number of cfgobj change records */
+#define DELTA_RETRY_MAX 3 /* consecutive delta failures before full resync */
 
 /* Defined in ldmsd.c */
 extern ovis_log_t fo_log;
@@ -123,6 +127,7 @@ typedef enum {
 	__FAILOVER_OUTSTANDING_PING   = 0x0008,
 	__FAILOVER_OURCFG_ACTIVATED   = 0x0010,
 	__FAILOVER_OUTSTANDING_UNPAIR = 0x0020,
+	__FAILOVER_OUTSTANDING_DELTA  = 0x0040,
 
 } __failover_flags_t;
 
@@ -175,12 +180,64 @@ struct ldmsd_failover {
 	double ping_sd;       /* ping round-trip time standard deviation */
 
 	int ping_skipped; /* the number of ping skipped due to outstanding */
+
+	int standby; /* keep peer producers connected before takeover */
+	int standby_pending; /* peer producers need (re)starting */
+
+	/* Our side of the replication: every cfgobj modification bumps
+	 * cfg_gn, and chg_rbt remembers the last modification of each
+	 * object so that the peer can ask for the changes since the
+	 * generation it already has. */
+	uint64_t epoch;       /* identifies this daemon instance */
+	uint64_t cfg_gn;      /* cfgobj generation number */
+	uint64_t chg_trim_gn; /* changes before this gn are forgotten */
+	uint64_t type_gn[3];  /* type-wide changes (e.g. by regex) */
+	struct rbt chg_rbt;
+	int chg_n;
+
+	/* The peer's side of the replication */
+	uint64_t peer_epoch;  /* epoch of the received peer config */
+	uint64_t peer_gn;     /* peer generation we are in sync with */
+	int delta_err;        /* errors while applying the current delta */
+	int delta_retry;      /* consecutive failed deltas */
+	int reset_retry;      /* consecutive failed peer config deletions */
 } *ldmsd_failover_t;
 
+/* cfgobj types replicated to the peer; index of type_gn[] */
+enum {
+	FO_PRDCR,
+	FO_UPDTR,
+	FO_STRGP,
+};
+
+static const char *__fo_type_str[] = {
+	[FO_PRDCR] = "prdcr",
+	[FO_UPDTR] = "updtr",
+	[FO_STRGP] = "strgp",
+};
+
+/* cfgobj change record, keyed by "<type><name>" */
+struct chg_rbn {
+	struct rbn rbn;
+	int type;
+	uint64_t gn;     /* last modification */
+	uint64_t del_gn; /* last deletion (or modification needing one) */
+	char *name;      /* points into key */
+	char key[OVIS_FLEX];
+};
+
+/* generation info carried in pair / peercfg replies */
+struct failover_gn_data {
+	uint64_t epoch;
+	uint64_t gn;
+	uint64_t zero; /* padding zero; attr values must end with '\0' */
+};
+
 struct str_rbn {
 	struct rbn rbn;
 	int started;
 	int will_start;
+	int deleting; /* stopped for deletion by a delta */
 	char str[OVIS_FLEX];
 };
 
@@ -293,7 +350,13 @@ int __peercfg_start(ldmsd_failover_t f);
 static
 int __peercfg_stop(ldmsd_failover_t f);
 static
+int __peercfg_failback(ldmsd_failover_t f);
+static
 int __failover_reset_and_request_peercfg(ldmsd_failover_t f);
+static
+int __gn_data_get(char *buf, struct failover_gn_data *data);
+static
+void __failover_reply_gn(ldmsd_req_ctxt_t req, uint64_t epoch, uint64_t gn);
 
 static inline
 void __failover_task_resched(ldmsd_failover_t f)
@@ -311,6 +374,7 @@ void __failover_set_ping_interval(ldmsd_failover_t f, uint64_t i)
 
 void __failover_init(ldmsd_failover_t f)
 {
+	struct timeval tv;
 	bzero(f, sizeof(*f));
 	pthread_mutex_init(&f->mutex, NULL);
 	f->flags = 0;
@@ -321,6 +385,13 @@ void __failover_init(ldmsd_failover_t f)
 	rbt_init(&f->prdcr_rbt, str_rbn_cmp);
 	rbt_init(&f->updtr_rbt, str_rbn_cmp);
 	rbt_init(&f->strgp_rbt, str_rbn_cmp);
+	rbt_init(&f->chg_rbt, str_rbn_cmp);
+
+	/* The peer keeps our generation numbers only as long as the epoch
+	 * does not change, i.e. until this daemon restarts. */
+	gettimeofday(&tv, NULL);
+	f->epoch = ((uint64_t)tv.tv_sec << 20) ^ tv.tv_usec ^
+		   ((uint64_t)getpid() << 40);
 
 	ldmsd_task_init(&f->task);
 
@@ -371,6 +442,124 @@ void __failover_unlock(ldmsd_failover_t f)
 	pthread_mutex_unlock(&f->mutex);
 }
 
+static
+void __chg_log_purge(ldmsd_failover_t f)
+{
+	/* f->lock is held */
+	struct rbn *rbn;
+	while ((rbn = rbt_min(&f->chg_rbt))) {
+		rbt_del(&f->chg_rbt, rbn);
+		free(rbn);
+	}
+	f->chg_n = 0;
+}
+
+static
+void __chg_log_add(ldmsd_failover_t f, int type, const char *name, int del)
+{
+	/* f->lock is held */
+	struct chg_rbn *chg;
+	struct rbn *rbn;
+	char key[256];
+	int len;
+
+	f->cfg_gn++;
+	if (!name) {
+		f->type_gn[type] = f->cfg_gn;
+		return;
+	}
+	len = snprintf(key, sizeof(key), "%c%s", '0' + type, name);
+	if (len >= sizeof(key))
+		goto trim;
+	rbn = rbt_find(&f->chg_rbt, key);
+	if (rbn) {
+		chg = container_of(rbn, struct chg_rbn, rbn);
+		goto update;
+	}
+	if (f->chg_n >= CHG_LOG_MAX)
+		goto trim;
+	chg = calloc(1, sizeof(*chg) + len + 1);
+	if (!chg)
+		goto trim;
+	memcpy(chg->key, key, len + 1);
+	chg->name = chg->key + 1;
+	chg->type = type;
+	rbn_init(&chg->rbn, chg->key);
+	rbt_ins(&f->chg_rbt, &chg->rbn);
+	f->chg_n++;
+update:
+	chg->gn = f->cfg_gn;
+	if (del)
+		chg->del_gn = f->cfg_gn;
+	return;
+trim:
+	/* Cannot remember this change; peers older than this generation
+	 * must fetch the whole config again. */
+	__chg_log_purge(f);
+	f->chg_trim_gn = f->cfg_gn;
+}
+
+/*
+ * Record a cfgobj modification so that it is replicated to the peer with
+ * the next delta. Called after every successful MOD request.
+ */
+void ldmsd_failover_cfg_changed(ldmsd_req_ctxt_t reqc)
+{
+	ldmsd_failover_t f = &__failover;
+	char *name;
+	int type, del = 0;
+
+	switch (reqc->req_id) {
+	case LDMSD_PRDCR_DEL_REQ:
+	case LDMSD_PRDCR_UNSUBSCRIBE_REQ:
+		del = 1;
+		/* let through */
+	case LDMSD_PRDCR_ADD_REQ:
+	case LDMSD_PRDCR_SUBSCRIBE_REQ:
+	case LDMSD_PRDCR_START_REQ:
+	case LDMSD_PRDCR_START_REGEX_REQ:
+	case LDMSD_BRIDGE_ADD_REQ:
+		type = FO_PRDCR;
+		break;
+	case LDMSD_UPDTR_ADD_REQ:
+	case LDMSD_UPDTR_DEL_REQ:
+	case LDMSD_UPDTR_PRDCR_ADD_REQ:
+	case LDMSD_UPDTR_PRDCR_DEL_REQ:
+	case LDMSD_UPDTR_MATCH_ADD_REQ:
+	case LDMSD_UPDTR_MATCH_DEL_REQ:
+	case LDMSD_UPDTR_START_REQ:
+		/* updaters and storage policies are always re-created */
+		del = 1;
+		type = FO_UPDTR;
+		break;
+	case LDMSD_STRGP_ADD_REQ:
+	case LDMSD_STRGP_DEL_REQ:
+	case LDMSD_STRGP_PRDCR_ADD_REQ:
+	case LDMSD_STRGP_PRDCR_DEL_REQ:
+	case LDMSD_STRGP_METRIC_ADD_REQ:
+	case LDMSD_STRGP_METRIC_DEL_REQ:
+		del = 1;
+		type = FO_STRGP;
+		break;
+	default:
+		return;
+	}
+	name = ldmsd_req_attr_str_value_get_by_id(reqc, LDMSD_ATTR_NAME);
+	if (name && __name_is_failover(name))
+		goto out;
+	if (name && strchr(name, '[')) {
+		/* prdcr_add name=node[1-8] adds several producers */
+		free(name);
+		name = NULL;
+	}
+	__failover_lock(f);
+	if (__F_GET(f, __FAILOVER_CONFIGURED))
+		__chg_log_add(f, type, name, del);
+	__failover_unlock(f);
+out:
+	free(name);
+}
+
 static
 int __failover_send_prdcr(ldmsd_failover_t f, ldms_t x, ldmsd_prdcr_t p)
 {
@@ -891,10 +1080,134 @@ out:
 	return rc;
 }
 
+static
+int __failover_send_cfgdel(ldmsd_failover_t f, ldms_t x, int type,
+			   const char *name)
+{
+	/* f->lock is held */
+	int rc;
+	char buff[256];
+	ldmsd_req_cmd_t rcmd;
+
+	rcmd = ldmsd_req_cmd_new(x, LDMSD_FAILOVER_CFGDEL_REQ,
+				 NULL, NULL, NULL);
+	if (!rcmd)
+		return errno;
+	snprintf(buff, sizeof(buff), LDMSD_FAILOVER_NAME_PREFIX "%s", name);
+	rc = ldmsd_req_cmd_attr_append_str(rcmd, LDMSD_ATTR_NAME, buff);
+	if (rc)
+		goto out;
+	rc = ldmsd_req_cmd_attr_append_str(rcmd, LDMSD_ATTR_TYPE,
+					   __fo_type_str[type]);
+	if (rc)
+		goto out;
+	rc = ldmsd_req_cmd_attr_term(rcmd);
+out:
+	ldmsd_req_cmd_free(rcmd);
+	return rc;
+}
+
+static
+int __chg_since(ldmsd_failover_t f, int type, const char *name, uint64_t since)
+{
+	/* f->lock is held */
+	char key[256];
+	struct rbn *rbn;
+	if (f->type_gn[type] > since)
+		return 1;
+	if (snprintf(key, sizeof(key), "%c%s", '0' + type, name) >= sizeof(key))
+		return 1;
+	rbn = rbt_find(&f->chg_rbt, key);
+	if (!rbn)
+		return 0;
+	return container_of(rbn, struct chg_rbn, rbn)->gn > since;
+}
+
+/*
+ * Send the cfgobjs modified after generation `since`.
+ *
+ * Updaters and storage policies that changed are deleted and re-sent as a
+ * whole; the peer does not run them until takeover, so this is cheap.
+ * Producers are deleted only when they were deleted (or lost a stream) on
+ * our side, so that the peer's standby connections survive a delta.
+ */
+static
+int __failover_send_delta(ldmsd_failover_t f, ldms_t x, uint64_t since)
+{
+	/* f->lock is held */
+	static const int del_order[] = { FO_STRGP, FO_UPDTR, FO_PRDCR };
+	struct rbn *rbn;
+	struct chg_rbn *chg;
+	ldmsd_prdcr_t p;
+	ldmsd_updtr_t u;
+	ldmsd_strgp_t s;
+	int i, rc = 0;
+
+	/* Phase 1: deletions, dependents first */
+	for (i = 0; i < ARRAY_LEN(del_order); i++) {
+		RBT_FOREACH(rbn, &f->chg_rbt) {
+			chg = container_of(rbn, struct chg_rbn, rbn);
+			if (chg->type != del_order[i] || chg->del_gn <= since)
+				continue;
+			rc = __failover_send_cfgdel(f, x, chg->type, chg->name);
+			if (rc)
+				return rc;
+		}
+	}
+
+	/* Phase 2: (re)send the changed objects that exist now */
+	ldmsd_cfg_lock(LDMSD_CFGOBJ_PRDCR);
+	for (p = ldmsd_prdcr_first(); p; p = ldmsd_prdcr_next(p)) {
+		if (__cfgobj_is_failover(&p->obj))
+			continue;
+		if (!__chg_since(f, FO_PRDCR, p->obj.name, since))
+			continue;
+		rc = __failover_send_prdcr(f, x, p);
+		if (rc) {
+			ldmsd_prdcr_put(p, "iter");
+			ldmsd_cfg_unlock(LDMSD_CFGOBJ_PRDCR);
+			return rc;
+		}
+	}
+	ldmsd_cfg_unlock(LDMSD_CFGOBJ_PRDCR);
+
+	ldmsd_cfg_lock(LDMSD_CFGOBJ_UPDTR);
+	for (u = ldmsd_updtr_first(); u; u = ldmsd_updtr_next(u)) {
+		if (__cfgobj_is_failover(&u->obj))
+			continue;
+		if (!__chg_since(f, FO_UPDTR, u->obj.name, since))
+			continue;
+		rc = __failover_send_updtr(f, x, u);
+		if (rc) {
+			ldmsd_updtr_put(u, "iter");
+			ldmsd_cfg_unlock(LDMSD_CFGOBJ_UPDTR);
+			return rc;
+		}
+	}
+	ldmsd_cfg_unlock(LDMSD_CFGOBJ_UPDTR);
+
+	ldmsd_cfg_lock(LDMSD_CFGOBJ_STRGP);
+	for (s = ldmsd_strgp_first(); s; s = ldmsd_strgp_next(s)) {
+		if (__cfgobj_is_failover(&s->obj))
+			continue;
+		if (!__chg_since(f, FO_STRGP, s->obj.name, since))
+			continue;
+		rc = __failover_send_strgp(f, x, s);
+		if (rc) {
+			ldmsd_strgp_put(s, "iter");
+			ldmsd_cfg_unlock(LDMSD_CFGOBJ_STRGP);
+			return rc;
+		}
+	}
+	ldmsd_cfg_unlock(LDMSD_CFGOBJ_STRGP);
+	return 0;
+}
+
 int __on_peercfg_resp(ldmsd_req_cmd_t rcmd)
 {
 	ldmsd_failover_t f = rcmd->ctxt;
 	ldmsd_req_hdr_t hdr = (void*)rcmd->reqc->req_buf;
+	struct failover_gn_data gd;
 	__failover_lock(f);
 	if (hdr->rsp_err) {
 		ovis_log(fo_log, OVIS_LERROR, "peer config request remote error: %d\n",
@@ -905,12 +1218,94 @@ int __on_peercfg_resp(ldmsd_req_cmd_t rcmd)
 		/* all peercfg have been received at this point */
 		__F_ON(f, __FAILOVER_PEERCFG_RECEIVED);
 		f->conn_state = FAILOVER_CONN_STATE_CONFIGURED;
-		ovis_log(fo_log, OVIS_LINFO, "peer config recv success\n");
+		/* a peer without generation info never sends deltas */
+		if (__gn_data_get(rcmd->reqc->req_buf, &gd))
+			memset(&gd, 0, sizeof(gd));
+		f->peer_epoch = gd.epoch;
+		f->peer_gn = gd.gn;
+		f->delta_err = 0;
+		f->delta_retry = 0;
+		f->standby_pending = 1;
+		ovis_log(fo_log, OVIS_LINFO, "peer config recv success, "
+			 "generation: %lu\n", f->peer_gn);
 	}
 	__failover_unlock(f);
 	return 0;
 }
 
+static
+int __on_peercfg_delta_resp(ldmsd_req_cmd_t rcmd)
+{
+	ldmsd_failover_t f = rcmd->ctxt;
+	ldmsd_req_hdr_t hdr = (void*)rcmd->reqc->req_buf;
+	struct failover_gn_data gd;
+	int rc;
+
+	__failover_lock(f);
+	__F_OFF(f, __FAILOVER_OUTSTANDING_DELTA);
+	if (f->conn_state != FAILOVER_CONN_STATE_CONFIGURED)
+		goto out;
+	rc = hdr->rsp_err;
+	if (!rc && __gn_data_get(rcmd->reqc->req_buf, &gd))
+		rc = EPROTO;
+	if (!rc)
+		rc = f->delta_err;
+	if (!rc) {
+		__dlog(DLOG_FOVER, "Failover: peer config updated to "
+		       "generation %lu\n", gd.gn);
+		f->peer_gn = gd.gn;
+		f->delta_retry = 0;
+		f->standby_pending = 1;
+		goto out;
+	}
+	if (rc == ERANGE || ++f->delta_retry >= DELTA_RETRY_MAX) {
+		/* the peer cannot give us the changes, or we cannot apply
+		 * them; fetch the whole config again */
+		ovis_log(fo_log, OVIS_LINFO, "peer config update failed, "
+			 "rc: %d, requesting full peer config\n", rc);
+		f->delta_retry = 0;
+		f->conn_state = FAILOVER_CONN_STATE_RESETTING;
+	} else {
+		/* peer_gn is unchanged; the next ping retries */
+		__dlog(DLOG_FOVER, "Failover: peer config update error: %d\n",
+		       rc);
+	}
+out:
+	f->delta_err = 0;
+	__failover_unlock(f);
+	return 0;
+}
+
+static
+int __failover_request_peercfg_delta(ldmsd_failover_t f)
+{
+	/* f->lock is held */
+	ldmsd_req_cmd_t rcmd;
+	struct failover_gn_data gd;
+	int rc;
+
+	rcmd = ldmsd_req_cmd_new(f->ax, LDMSD_FAILOVER_PEERCFG_REQ,
+				 NULL, __on_peercfg_delta_resp, f);
+	if (!rcmd)
+		return errno;
+	gd.epoch = htobe64(f->peer_epoch);
+	gd.gn = htobe64(f->peer_gn);
+	gd.zero = 0;
+	rc = ldmsd_req_cmd_attr_append(rcmd, LDMSD_ATTR_UDATA,
+				       &gd, sizeof(gd));
+	if (rc)
+		goto err;
+	rc = ldmsd_req_cmd_attr_term(rcmd);
+	if (rc)
+		goto err;
+	f->delta_err = 0;
+	__F_ON(f, __FAILOVER_OUTSTANDING_DELTA);
+	return 0;
+err:
+	ldmsd_req_cmd_free(rcmd);
+	return rc;
+}
+
 static
 int __failover_request_peercfg(ldmsd_failover_t f)
 {
@@ -926,6 +1321,7 @@ int __failover_request_peercfg(ldmsd_failover_t f)
 		rc = errno;
 		goto out;
 	}
+	f->delta_err = 0;
 	rc = ldmsd_req_cmd_attr_term(rcmd);
 out:
 	if (rc) {
@@ -955,6 +1351,7 @@ int __on_pair_resp(ldmsd_req_cmd_t rcmd)
 {
 	ldmsd_failover_t f = rcmd->ctxt;
 	ldmsd_req_hdr_t hdr = (void*)rcmd->reqc->req_buf;
+	struct failover_gn_data gd;
 	int rc = 0;
 
 	__failover_lock(f);
@@ -971,8 +1368,22 @@ int __on_pair_resp(ldmsd_req_cmd_t rcmd)
 	}
 	ovis_log(fo_log, OVIS_LINFO, "Failover pairing success, peer: %s\n", f->peer_name);
 
+	if (__F_GET(f, __FAILOVER_PEERCFG_RECEIVED) && f->peer_epoch &&
+	    0 == __gn_data_get(rcmd->reqc->req_buf, &gd) &&
+	    gd.epoch == f->peer_epoch) {
+		/* Same peer instance as before the disconnection; keep the
+		 * peer config we have and let the ping catch up with the
+		 * changes. */
+		ovis_log(fo_log, OVIS_LINFO, "resuming peer config at "
+			 "generation %lu (peer: %lu)\n", f->peer_gn, gd.gn);
+		f->conn_state = FAILOVER_CONN_STATE_CONFIGURED;
+		goto out;
+	}
+
 	f->conn_state = FAILOVER_CONN_STATE_RESETTING;
 	rc = __failover_reset_and_request_peercfg(f);
+	if (rc == EAGAIN || rc == EBUSY)
+		rc = 0; /* peer config still stopping; the task retries */
 
 err:
 	if (rc) {
@@ -1058,6 +1469,7 @@ void __failover_xprt_cb(ldms_t x, ldms_xprt_event_t e, void *cb_arg)
 		__F_ON(f, __FAILOVER_OURCFG_ACTIVATED);
 		__F_OFF(f, __FAILOVER_OUTSTANDING_PING);
 		__F_OFF(f, __FAILOVER_OUTSTANDING_UNPAIR);
+		__F_OFF(f, __FAILOVER_OUTSTANDING_DELTA);
 		__failover_unlock(f);
 		if (need_start) {
 			ldmsd_ourcfg_start_proc();
@@ -1123,7 +1535,9 @@ struct failover_ping_data {
 	failover_state_t state;
 	failover_conn_state_t conn_state;
 	uint64_t flags;
-	uint64_t zero; /* padding zero */
+	uint64_t cfg_gn; /* was padding zero, 0 from older peers */
+	uint64_t epoch;  /* not sent by older peers */
+	uint64_t zero;   /* padding zero; attr values must end with '\0' */
 };
 
 void __ping_data_hton(struct failover_ping_data *data)
@@ -1131,6 +1545,8 @@ void __ping_data_hton(struct failover_ping_data *data)
 	data->state = htonl(data->state);
 	data->conn_state = htonl(data->conn_state);
 	data->flags = htobe64(data->flags);
+	data->cfg_gn = htobe64(data->cfg_gn);
+	data->epoch = htobe64(data->epoch);
 }
 
 void __ping_data_ntoh(struct failover_ping_data *data)
@@ -1138,6 +1554,8 @@ void __ping_data_ntoh(struct failover_ping_data *data)
 	data->state = ntohl(data->state);
 	data->conn_state = ntohl(data->conn_state);
 	data->flags = be64toh(data->flags);
+	data->cfg_gn = be64toh(data->cfg_gn);
+	data->epoch = be64toh(data->epoch);
 }
 
 static
@@ -1148,8 +1566,9 @@ int __on_ping_resp(ldmsd_req_cmd_t rcmd)
 	uint64_t dur2;
 	ldmsd_failover_t f = rcmd->ctxt;
 	int will_start = 0;
-	struct failover_ping_data *ping_data;
+	struct failover_ping_data ping_data = {0};
 	ldmsd_req_attr_t attr;
+	size_t len;
 	int i;
 	__failover_lock(f);
 
@@ -1186,16 +1605,34 @@ int __on_ping_resp(ldmsd_req_cmd_t rcmd)
 
 	/* stop peercfg on our side */
 	if (f->auto_switch) {
-		__peercfg_stop(f);
+		__peercfg_failback(f);
 	}
 
 	/* get peer state */
 	attr = ldmsd_req_attr_get_by_id(rcmd->reqc->req_buf, LDMSD_ATTR_UDATA);
 	if (!attr)
 		goto out;
-	ping_data = (void*)attr->attr_value;
-	__ping_data_ntoh(ping_data);
-	if (ping_data->flags & __FAILOVER_PEERCFG_ACTIVATED) {
+	/* older peers send a shorter ping data without cfg_gn and epoch; the
+	 * missing fields stay 0 in the local copy */
+	len = attr->attr_len;
+	if (len > sizeof(ping_data))
+		len = sizeof(ping_data);
+	memcpy(&ping_data, attr->attr_value, len);
+	__ping_data_ntoh(&ping_data);
+
+	/* catch up with the peer config changes */
+	if (len >= offsetof(struct failover_ping_data, zero) && f->peer_epoch &&
+	    f->conn_state == FAILOVER_CONN_STATE_CONFIGURED) {
+		if (ping_data.epoch != f->peer_epoch) {
+			ovis_log(fo_log, OVIS_LINFO, "peer restarted, "
+				 "requesting full peer config\n");
+			f->conn_state = FAILOVER_CONN_STATE_RESETTING;
+		} else if (ping_data.cfg_gn != f->peer_gn &&
+			   !__F_GET(f, __FAILOVER_OUTSTANDING_DELTA)) {
+			__failover_request_peercfg_delta(f);
+		}
+	}
+	if (ping_data.flags & __FAILOVER_PEERCFG_ACTIVATED) {
 		/* cannot start ours yet */
 		goto out;
 	}
@@ -1303,7 +1740,7 @@ int __peercfg_delete(ldmsd_failover_t f)
 }
 
 static
-int __peercfg_stop(ldmsd_failover_t f)
+int __peercfg_stop_objs(ldmsd_failover_t f, int keep_prdcr)
 {
 	/* f->lock is held */
 	int rc = 0, _rc, i;
@@ -1313,12 +1750,13 @@ int __peercfg_stop(ldmsd_failover_t f)
 	struct rbt *t[] = {&f->updtr_rbt, &f->prdcr_rbt};
 	void *stop[] = {ldmsd_updtr_stop, ldmsd_prdcr_stop};
 	int (*fn)(void*, void*);
+	int n = keep_prdcr ? 1 : ARRAY_LEN(t);
 
 	/* NOTE: Leaving out peer storage policy in the favor of letting our
 	 *       storage policy picks up the data. */
 
 	ovis_log(fo_log, OVIS_LINFO, "stopping peercfg\n");
-	for (i = 0; i < ARRAY_LEN(t); i++) {
+	for (i = 0; i < n; i++) {
 		fn = stop[i];
 		RBT_FOREACH(rbn, t[i]) {
 			ent = STR_RBN(rbn);
@@ -1343,6 +1781,72 @@ int __peercfg_stop(ldmsd_failover_t f)
 	return rc;
 }
 
+static
+int __peercfg_stop(ldmsd_failover_t f)
+{
+	/* f->lock is held */
+	return __peercfg_stop_objs(f, 0);
+}
+
+/*
+ * The peer is back. In standby mode only the updaters are stopped; the
+ * producers stay connected for the next takeover.
+ */
+static
+int __peercfg_failback(ldmsd_failover_t f)
+{
+	/* f->lock is held */
+	if (!f->standby)
+		return __peercfg_stop_objs(f, 0);
+	if (!__peercfg_updtr_activated(f))
+		return 0;
+	return __peercfg_stop_objs(f, 1);
+}
+
+static
+int __failover_prdcr_start(const char *name, ldmsd_sec_ctxt_t sctxt)
+{
+	/* Not ldmsd_prdcr_start(); it keeps a reference that would make the
+	 * peer producer impossible to delete on failback or reset. */
+	int rc;
+	ldmsd_prdcr_t prdcr = ldmsd_prdcr_find(name);
+	if (!prdcr)
+		return ENOENT;
+	rc = __ldmsd_prdcr_start(prdcr, sctxt);
+	ldmsd_prdcr_put(prdcr, "find");
+	return rc;
+}
+
+/*
+ * Connect the peer producers ahead of a takeover, so that the takeover only
+ * has to start the updaters.
+ */
+static
+void __peercfg_standby(ldmsd_failover_t f)
+{
+	/* f->lock is held */
+	int rc;
+	struct rbn *rbn;
+	struct str_rbn *srbn;
+	struct ldmsd_sec_ctxt sctxt = __get_sec_ctxt(NULL);
+
+	f->standby_pending = 0;
+	RBT_FOREACH(rbn, &f->prdcr_rbt) {
+		srbn = STR_RBN(rbn);
+		if (srbn->started || srbn->deleting)
+			continue;
+		rc = __failover_prdcr_start(srbn->str, &sctxt);
+		if (rc) {
+			/* e.g. still stopping, try again later */
+			__dlog(DLOG_FOVER, "Failover: standby prdcr_start(%s) "
+			       "rc: %d\n", srbn->str, rc);
+			f->standby_pending = 1;
+			continue;
+		}
+		srbn->started = 1;
+	}
+}
+
 static
 int __peercfg_reset(ldmsd_failover_t f)
 {
@@ -1352,8 +1856,14 @@ int __peercfg_reset(ldmsd_failover_t f)
 	rc = __peercfg_stop(f);
 	if (rc)
 		return rc;
-	__peercfg_delete(f);
+	rc = __peercfg_delete(f);
+	if (rc && f->reset_retry++ < DELTA_RETRY_MAX)
+		return rc; /* e.g. producers still stopping, retry later */
+	/* Give up on the leftovers; the full peer config updates them. */
+	f->reset_retry = 0;
 	__F_OFF(f, __FAILOVER_PEERCFG_RECEIVED);
+	f->peer_epoch = 0;
+	f->peer_gn = 0;
 	return 0;
 }
 
@@ -1475,6 +1985,8 @@ void __failover_active_routine(ldmsd_failover_t f)
 		break;
 	case FAILOVER_CONN_STATE_CONFIGURED:
 		__failover_ping(f);
+		if (f->standby && f->standby_pending)
+			__peercfg_standby(f);
 		break;
 	default:
 		__ASSERT(0 == "BAD STATE");
@@ -1516,7 +2028,10 @@ int __peercfg_activated(ldmsd_failover_t f)
 {
 	struct rbn *rbn;
 	struct str_rbn *srbn;
+	/* standby producers do not make the peer config active */
 	RBT_FOREACH(rbn, &f->prdcr_rbt) {
+		if (f->standby)
+			break;
 		srbn = STR_RBN(rbn);
 		if (srbn->started)
 			return 1;
@@ -1543,9 +2058,9 @@ int __peercfg_start(ldmsd_failover_t f)
 
 	RBT_FOREACH(rbn, &f->prdcr_rbt) {
 		srbn = STR_RBN(rbn);
-		if (srbn->started)
+		if (srbn->started || srbn->deleting)
 			continue;
-		rc = ldmsd_prdcr_start(srbn->str, NULL, &sctxt);
+		rc = __failover_prdcr_start(srbn->str, &sctxt);
 		if (rc) {
 			ovis_log(fo_log, OVIS_LERROR,
 				  "failover: prdcr_start(%s) failed, "
@@ -1607,6 +2122,7 @@ int failover_config_handler(ldmsd_req_ctxt_t req)
 	char *peer_name;
 	const char *myname;
 	char *timeout_factor;
+	char *standby = NULL;
 	const char *errmsg = NULL;
 	ldmsd_failover_t f;
 	int len;
@@ -1627,6 +2143,7 @@ int failover_config_handler(ldmsd_req_ctxt_t req)
 	interval = __req_attr_gets(req, LDMSD_ATTR_INTERVAL);
 	peer_name = __req_attr_gets(req, LDMSD_ATTR_PEER_NAME);
 	timeout_factor = __req_attr_gets(req, LDMSD_ATTR_TIMEOUT_FACTOR);
+	standby = __req_attr_gets(req, LDMSD_ATTR_STANDBY);
 
 	/* Check for at least a listening port */
 	struct ldmsd_listen *_listen;
@@ -1702,6 +2219,9 @@ int failover_config_handler(ldmsd_req_ctxt_t req)
 	if (interval) {
 		__failover_set_ping_interval(f, strtoul(interval, NULL, 0));
 	}
+	if (standby) {
+		f->standby = atoi(standby);
+	}
 
 	__F_ON(f, __FAILOVER_CONFIGURED);
 
@@ -1724,6 +2244,7 @@ out:
 		free(peer_name);
 	if (timeout_factor)
 		free(timeout_factor);
+	free(standby);
 resp:
 	req->errcode = rc;
 	ldmsd_send_req_response(req, errmsg);
@@ -1822,6 +2343,10 @@ int failover_status_handler(ldmsd_req_ctxt_t req)
 	__APPEND(", \"ping_sd\": \"%lf\"", f->ping_sd);
 	__APPEND(", \"timeout_factor\": \"%lf\"", f->timeout_factor);
 	__APPEND(", \"auto_switch\": \"%d\"", f->auto_switch);
+	__APPEND(", \"standby\": \"%d\"", f->standby);
+	__APPEND(", \"epoch\": \"%#lx\"", f->epoch);
+	__APPEND(", \"cfg_gn\": \"%lu\"", f->cfg_gn);
+	__APPEND(", \"peer_cfg_gn\": \"%lu\"", f->peer_gn);
 	__APPEND(", \"ping_ts\": \"%ld.%ld\"", f->ping_ts.tv_sec,
 					       f->ping_ts.tv_usec);
 	__APPEND(", \"echo_ts\": \"%ld.%ld\"", f->echo_ts.tv_sec,
@@ -1995,6 +2520,12 @@ int failover_pair_handler(ldmsd_req_ctxt_t req)
 	}
 
 	rc = __verify_pair_req(f, req);
+	if (!rc) {
+		struct failover_gn_data gd = { f->epoch, f->cfg_gn, 0 };
+		__failover_unlock(f);
+		__failover_reply_gn(req, gd.epoch, gd.gn);
+		return 0;
+	}
 
 err1:
 	__failover_unlock(f);
@@ -2022,6 +2553,8 @@ int failover_reset_handler(ldmsd_req_ctxt_t req)
 		/* let through */
 	case FAILOVER_STATE_STOPPING:
 		rc = __peercfg_reset(f);
+		if (rc == EBUSY)
+			rc = EAGAIN; /* peer cfgobjs still stopping */
 		break;
 	case FAILOVER_STATE_STOP:
 		/* already stop, do nothing */
@@ -2095,6 +2628,10 @@ int failover_cfgprdcr_handler(ldmsd_req_ctxt_t req)
 
 	p = ldmsd_prdcr_find(name);
 	if (p) {
+		/* re-sent after a failed deletion */
+		srbn = (void*)rbt_find(&f->prdcr_rbt, name);
+		if (srbn)
+			srbn->deleting = 0;
 		/* update interval */
 		if (interval)
 			p->conn_intrvl_us = atoi(interval);
@@ -2132,6 +2669,8 @@ int failover_cfgprdcr_handler(ldmsd_req_ctxt_t req)
 	rbt_ins(&f->prdcr_rbt, &srbn->rbn);
 
 out:
+	if (rc && rc != EEXIST)
+		f->delta_err = rc;
 	__failover_unlock(f);
 	if (name)
 		free(name);
@@ -2260,6 +2799,8 @@ int failover_cfgupdtr_handler(ldmsd_req_ctxt_t req)
 updtr_put:
 	ldmsd_updtr_put(u, "find");
 out:
+	if (rc && rc != EEXIST)
+		f->delta_err = rc;
 	__failover_unlock(f);
 	if (name)
 		free(name);
@@ -2370,6 +2911,8 @@ int failover_cfgstrgp_handler(ldmsd_req_ctxt_t req)
 put:
 	ldmsd_strgp_put(s, "find");
 out:
+	if (rc && rc != EEXIST)
+		f->delta_err = rc;
 	__failover_unlock(f);
 	if (name)
 		free(name);
@@ -2393,6 +2936,81 @@ out:
 	return rc;
 }
 
+/*
+ * Delete a peer cfgobj that was deleted (or needs re-creation) on the peer.
+ * The errors are collected in f->delta_err so that the delta is retried.
+ */
+int failover_cfgdel_handler(ldmsd_req_ctxt_t req)
+{
+	ldmsd_failover_t f = __ldmsd_req_failover_get(req);
+	char *name = __req_attr_gets(req, LDMSD_ATTR_NAME);
+	char *type = __req_attr_gets(req, LDMSD_ATTR_TYPE);
+	struct ldmsd_sec_ctxt sctxt = __get_sec_ctxt(NULL);
+	struct rbt *t;
+	struct rbn *rbn;
+	struct str_rbn *ent;
+	int rc = 0;
+
+	__failover_lock(f);
+	if (!name || !type || !__name_is_failover(name)) {
+		rc = EINVAL;
+		goto out;
+	}
+	if (0 == strcmp(type, "prdcr")) {
+		t = &f->prdcr_rbt;
+	} else if (0 == strcmp(type, "updtr")) {
+		t = &f->updtr_rbt;
+	} else if (0 == strcmp(type, "strgp")) {
+		t = &f->strgp_rbt;
+	} else {
+		rc = EINVAL;
+		goto out;
+	}
+	rbn = rbt_find(t, name);
+	if (!rbn)
+		goto out; /* we never had it */
+	ent = STR_RBN(rbn);
+	if (ent->started) {
+		if (t != &f->prdcr_rbt) {
+			/* taken over, the failback will stop it first */
+			rc = EBUSY;
+			goto out;
+		}
+		/* a standby producer */
+		rc = ldmsd_prdcr_stop(ent->str, &sctxt);
+		if (rc == 0)
+			ent->started = 0;
+		ent->deleting = 1;
+		rc = EAGAIN;
+		goto out;
+	}
+	if (t == &f->prdcr_rbt)
+		rc = ldmsd_prdcr_del(ent->str, &sctxt);
+	else if (t == &f->updtr_rbt)
+		rc = ldmsd_updtr_del(ent->str, &sctxt);
+	else
+		rc = ldmsd_strgp_del(ent->str, &sctxt);
+	if (rc == ENOENT)
+		rc = 0;
+	if (rc) {
+		ent->deleting = 1;
+		goto out;
+	}
+	rbt_del(t, rbn);
+	str_rbn_free(ent);
+out:
+	if (rc) {
+		ovis_log(fo_log, OVIS_LINFO, "peer %s '%s' deletion failed, "
+			 "rc: %d\n", type, name, rc);
+		f->delta_err = rc;
+	}
+	__failover_unlock(f);
+	free(name);
+	free(type);
+	/* this req needs no resp */
+	return rc;
+}
+
 int failover_ping_handler(ldmsd_req_ctxt_t req)
 {
 	int rc = 0;
@@ -2423,6 +3041,8 @@ int failover_ping_handler(ldmsd_req_ctxt_t req)
 	data.state = f->state;
 	data.conn_state = f->conn_state;
 	data.flags = f->flags;
+	data.cfg_gn = f->cfg_gn;
+	data.epoch = f->epoch;
 	data.zero = 0;
 	__ping_data_hton(&data);
 	attr.attr_id = LDMSD_ATTR_UDATA;
@@ -2447,10 +3067,55 @@ err:
 	return rc;
 }
 
+/*
+ * Reply with our epoch and the cfgobj generation `gn`, so that the peer
+ * can later ask only for what changed after it.
+ */
+static
+void __failover_reply_gn(ldmsd_req_ctxt_t req, uint64_t epoch, uint64_t gn)
+{
+	struct ldmsd_req_attr_s attr;
+	struct failover_gn_data data;
+
+	data.epoch = htobe64(epoch);
+	data.gn = htobe64(gn);
+	data.zero = 0;
+	attr.attr_id = LDMSD_ATTR_UDATA;
+	attr.discrim = 1;
+	attr.attr_len = sizeof(data);
+	ldmsd_hton_req_attr(&attr);
+	req->errcode = 0;
+	ldmsd_append_reply(req, (void*)&attr, sizeof(attr), LDMSD_REQ_SOM_F);
+	ldmsd_append_reply(req, (void*)&data, sizeof(data), 0);
+	attr.discrim = 0;
+	ldmsd_append_reply(req, (char *)&attr.discrim, sizeof(uint32_t),
+			   LDMSD_REQ_EOM_F);
+}
+
+static
+int __gn_data_get(char *buf, struct failover_gn_data *data)
+{
+	ldmsd_req_attr_t attr;
+	attr = ldmsd_req_attr_get_by_id(buf, LDMSD_ATTR_UDATA);
+	if (!attr || attr->attr_len < sizeof(*data))
+		return ENOENT;
+	memcpy(data, attr->attr_value, sizeof(*data));
+	data->epoch = be64toh(data->epoch);
+	data->gn = be64toh(data->gn);
+	return 0;
+}
+
+/*
+ * Without UDATA, the peer asks for the whole config. With UDATA
+ * {epoch, gn}, it asks for the changes since generation `gn`; ERANGE tells
+ * it that the changes are not available and a full request is needed.
+ */
 int failover_peercfg_handler(ldmsd_req_ctxt_t req)
 {
 	int rc = 0;
 	ldmsd_failover_t f;
+	struct failover_gn_data since;
+	uint64_t epoch, gn;
 
 	f = __ldmsd_req_failover_get(req);
 	if (!f) {
@@ -2458,8 +3123,23 @@ int failover_peercfg_handler(ldmsd_req_ctxt_t req)
 		goto out;
 	}
 	__failover_lock(f);
-	rc = __failover_send_cfgobjs(f, req->xprt->ldms.ldms);
+	epoch = f->epoch;
+	gn = f->cfg_gn;
+	if (__gn_data_get(req->req_buf, &since)) {
+		rc = __failover_send_cfgobjs(f, req->xprt->ldms.ldms);
+	} else if (since.epoch != f->epoch || since.gn < f->chg_trim_gn ||
+		   since.gn > f->cfg_gn) {
+		rc = ERANGE;
+	} else {
+		__dlog(DLOG_FOVER, "Failover: sending changes %lu..%lu\n",
+		       since.gn, f->cfg_gn);
+		rc = __failover_send_delta(f, req->xprt->ldms.ldms, since.gn);
+	}
 	__failover_unlock(f);
+	if (!rc) {
+		__failover_reply_gn(req, epoch, gn);
+		return 0;
+	}
 out:
 	req->errcode = rc;
 	ldmsd_send_req_response(req, NULL);
@@ -2483,9 +3163,13 @@ int ldmsd_failover_start()
 		goto out;
 
 	f->state = FAILOVER_STATE_START;
-	/* allows only failover-safe and failover-internal commands */
+	/*
+	 * allows only failover-safe and failover-internal commands, and the
+	 * changes of our own configuration that are replicated to the peer
+	 */
 	ldmsd_inband_cfg_mask_set(LDMSD_PERM_FAILOVER_ALLOWED |
-				  LDMSD_PERM_FAILOVER_INTERNAL);
+				  LDMSD_PERM_FAILOVER_INTERNAL |
+				  LDMSD_PERM_FAILOVER_REPLICATED);
 out:
 	__failover_unlock(f);
 	return rc;
@@ -96,6 +96,7 @@ void ldmsd_prdcr___del(ldmsd_cfgobj_t obj)
 	free(prdcr->conn_auth_dom_name);
 	if (prdcr->conn_auth_args)
 		av_free(prdcr->conn_auth_args);
+	ldmsd_lat_free(prdcr->lat);
 	ldmsd_cfgobj___del(obj);
 }
 
@@ -906,6 +907,9 @@ static void prdcr_connect(ldmsd_prdcr_t prdcr)
 						 prdcr->conn_auth,
 						 prdcr->conn_auth_args);
 		if (prdcr->xprt) {
+			/* Keep the connection on the producer's shard */
+			(void)ldms_xprt_rail_thread_pool_set(prdcr->xprt,
+							     prdcr->shard);
 			ret  = ldms_xprt_connect(prdcr->xprt,
 						 (struct sockaddr *)&prdcr->ss,
 						 prdcr->ss_len,
@@ -1063,11 +1067,12 @@ ldmsd_prdcr_new_with_auth(const char *name, const char *xprt_name,
 		}
 	}
 
+	/*
+	 * The host name is resolved by prdcr_connect() on the producer's
+	 * worker thread, so that adding many producers does not wait on
+	 * name resolution one by one.
+	 */
 	prdcr->ss_len = sizeof(prdcr->ss);
-	if (prdcr_resolve(prdcr->host_name, prdcr->port_no, &prdcr->ss, &prdcr->ss_len)) {
-		ovis_log(config_log, OVIS_LWARN, "Producer '%s': %s:%u not resolved.\n",
-			prdcr->obj.name, prdcr->host_name,(unsigned) prdcr->port_no);
-	}
 
 	if (!auth)
 		auth = DEFAULT_AUTH;
@@ -1089,8 +1094,15 @@ ldmsd_prdcr_new_with_auth(const char *name, const char *xprt_name,
 		if (!prdcr->conn_auth_args)
 			goto out;
 	}
+	if (ldmsd_lat_alloc(prdcr->lat, LDMSD_LAT_F(LDMSD_LAT_LOOKUP) |
+					LDMSD_LAT_F(LDMSD_LAT_UPDATE) |
+					LDMSD_LAT_F(LDMSD_LAT_STORE) |
+					LDMSD_LAT_F(LDMSD_LAT_PUSH)))
+		goto out;
 
 	ldmsd_task_init(&prdcr->task);
+	prdcr->shard = ldmsd_shard_hash(prdcr->obj.name);
+	ldmsd_task_shard_set(&prdcr->task, prdcr->shard);
 #ifdef _CFG_REF_DUMP_
 	ref_dump(&prdcr->obj.ref, prdcr->obj.name, stderr);
 #endif
@@ -1477,7 +1489,8 @@ int ldmsd_prdcr_start_regex(const char *prdcr_regex, const char *interval_str,
 			    char *rep_buf, size_t rep_len,
 			    ldmsd_sec_ctxt_t ctxt)
 {
-	regex_t regex;
+	struct ldmsd_cfgobj_match_s m;
+	ldmsd_cfgobj_t obj;
 	ldmsd_prdcr_t prdcr;
 	int rc;
 	long reconnect;
@@ -1495,44 +1508,41 @@ int ldmsd_prdcr_start_regex(const char *prdcr_regex, const char *interval_str,
 		}
 	}
 
-	rc = ldmsd_compile_regex(&regex, prdcr_regex, rep_buf, rep_len);
+	rc = ldmsd_cfgobj_match_init(&m, prdcr_regex, rep_buf, rep_len);
 	if (rc)
 		return rc;
 
 	ldmsd_cfg_lock(LDMSD_CFGOBJ_PRDCR);
-	for (prdcr = ldmsd_prdcr_first(); prdcr; prdcr = ldmsd_prdcr_next(prdcr)) {
-		rc = regexec(&regex, prdcr->obj.name, 0, NULL, 0);
-		if (rc)
-			continue;
+	LDMSD_CFGOBJ_MATCH_FOREACH(obj, &m, LDMSD_CFGOBJ_PRDCR) {
+		prdcr = (ldmsd_prdcr_t)obj;
 		if (interval_str)
 			prdcr->conn_intrvl_us = reconnect;
 		__ldmsd_prdcr_start(prdcr, ctxt);
 	}
 	rc = 0;
 	ldmsd_cfg_unlock(LDMSD_CFGOBJ_PRDCR);
-	regfree(&regex);
+	ldmsd_cfgobj_match_fini(&m);
 	return rc;
 }
 
 int ldmsd_prdcr_stop_regex(const char *prdcr_regex, char *rep_buf,
 			   size_t rep_len, ldmsd_sec_ctxt_t ctxt)
 {
-	regex_t regex;
+	struct ldmsd_cfgobj_match_s m;
+	ldmsd_cfgobj_t obj;
 	ldmsd_prdcr_t prdcr;
 	int rc;
 
-	rc = ldmsd_compile_regex(&regex, prdcr_regex, rep_buf, rep_len);
+	rc = ldmsd_cfgobj_match_init(&m, prdcr_regex, rep_buf, rep_len);
 	if (rc)
 		return rc;
 	ldmsd_cfg_lock(LDMSD_CFGOBJ_PRDCR);
-	for (prdcr = ldmsd_prdcr_first(); prdcr; prdcr = ldmsd_prdcr_next(prdcr)) {
-		rc = regexec(&regex, prdcr->obj.name, 0, NULL, 0);
-		if (rc)
-			continue;
+	LDMSD_CFGOBJ_MATCH_FOREACH(obj, &m, LDMSD_CFGOBJ_PRDCR) {
+		prdcr = (ldmsd_prdcr_t)obj;
 		__ldmsd_prdcr_stop(prdcr, ctxt);
 	}
 	ldmsd_cfg_unlock(LDMSD_CFGOBJ_PRDCR);
-	regfree(&regex);
+	ldmsd_cfgobj_match_fini(&m);
 	return 0;
 }
 
@@ -1615,14 +1625,7 @@ void ldmsd_prdcr_update(ldmsd_strgp_t strgp)
 	ldmsd_cfg_lock(LDMSD_CFGOBJ_PRDCR);
 	ldmsd_prdcr_t prdcr;
 	for (prdcr = ldmsd_prdcr_first(); prdcr; prdcr = ldmsd_prdcr_next(prdcr)) {
-		int rc;
-		ldmsd_name_match_t match = ldmsd_strgp_prdcr_first(strgp);
-		for (rc = 0; match; match = ldmsd_strgp_prdcr_next(match)) {
-			rc = regexec(&match->regex, prdcr->obj.name, 0, NULL, 0);
-			if (!rc)
-				break;
-		}
-		if (rc)
+		if (ldmsd_strgp_prdcr_match(strgp, prdcr->obj.name))
 			continue;
 
 		ldmsd_prdcr_lock(prdcr);
@@ -1654,22 +1657,21 @@ int ldmsd_prdcr_subscribe_regex(const char *prdcr_regex, const char *stream,
 				char *rep_buf, size_t rep_len,
 				ldmsd_sec_ctxt_t ctxt, int64_t rate)
 {
-	regex_t regex;
+	struct ldmsd_cfgobj_match_s m;
+	ldmsd_cfgobj_t obj;
 	ldmsd_prdcr_t prdcr;
 	int rc;
 
-	rc = ldmsd_compile_regex(&regex, prdcr_regex, rep_buf, rep_len);
+	rc = ldmsd_cfgobj_match_init(&m, prdcr_regex, rep_buf, rep_len);
 	if (rc)
 		return rc;
 	ldmsd_cfg_lock(LDMSD_CFGOBJ_PRDCR);
-	for (prdcr = ldmsd_prdcr_first(); prdcr; prdcr = ldmsd_prdcr_next(prdcr)) {
-		rc = regexec(&regex, prdcr->obj.name, 0, NULL, 0);
-		if (rc)
-			continue;
+	LDMSD_CFGOBJ_MATCH_FOREACH(obj, &m, LDMSD_CFGOBJ_PRDCR) {
+		prdcr = (ldmsd_prdcr_t)obj;
 		ldmsd_prdcr_subscribe(prdcr, stream, msg, rate);
 	}
 	ldmsd_cfg_unlock(LDMSD_CFGOBJ_PRDCR);
-	regfree(&regex);
+	ldmsd_cfgobj_match_fini(&m);
 	return 0;
 }
 
@@ -1679,22 +1681,21 @@ int ldmsd_prdcr_unsubscribe_regex(const char *prdcr_regex,
 				char *rep_buf, size_t rep_len,
 				ldmsd_sec_ctxt_t ctxt)
 {
-	regex_t regex;
+	struct ldmsd_cfgobj_match_s m;
+	ldmsd_cfgobj_t obj;
 	ldmsd_prdcr_t prdcr;
 	int rc;
 
-	rc = ldmsd_compile_regex(&regex, prdcr_regex, rep_buf, rep_len);
+	rc = ldmsd_cfgobj_match_init(&m, prdcr_regex, rep_buf, rep_len);
 	if (rc)
 		return rc;
 	ldmsd_cfg_lock(LDMSD_CFGOBJ_PRDCR);
-	for (prdcr = ldmsd_prdcr_first(); prdcr; prdcr = ldmsd_prdcr_next(prdcr)) {
-		rc = regexec(&regex, prdcr->obj.name, 0, NULL, 0);
-		if (rc)
-			continue;
+	LDMSD_CFGOBJ_MATCH_FOREACH(obj, &m, LDMSD_CFGOBJ_PRDCR) {
+		prdcr = (ldmsd_prdcr_t)obj;
 		ldmsd_prdcr_unsubscribe(prdcr, stream_name, msg);
 	}
 	ldmsd_cfg_unlock(LDMSD_CFGOBJ_PRDCR);
-	regfree(&regex);
+	ldmsd_cfgobj_match_fini(&m);
 	return 0;
 }
 
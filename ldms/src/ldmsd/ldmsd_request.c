@@ -50,6 +50,7 @@
 #include <errno.h>
 #include <unistd.h>
 #include <inttypes.h>
+#include <endian.h>
 #include <limits.h>
 #include <stdlib.h>
 #include <stdarg.h>
@@ -256,6 +257,8 @@ static int set_stats_handler(ldmsd_req_ctxt_t req_ctxt);
 static int unimplemented_handler(ldmsd_req_ctxt_t req_ctxt);
 static int eperm_handler(ldmsd_req_ctxt_t req_ctxt);
 static int ebusy_handler(ldmsd_req_ctxt_t reqc);
+static int __name_is_failover(ldmsd_req_ctxt_t reqc);
+static int failover_obj_handler(ldmsd_req_ctxt_t reqc);
 static int updtr_task_status_handler(ldmsd_req_ctxt_t req_ctxt);
 static int prdcr_hint_tree_status_handler(ldmsd_req_ctxt_t reqc);
 static int update_time_stats_handler(ldmsd_req_ctxt_t reqc);
@@ -263,6 +266,7 @@ static int set_sec_mod_handler(ldmsd_req_ctxt_t reqc);
 static int log_status_handler(ldmsd_req_ctxt_t reqc);
 static int stats_reset_handler(ldmsd_req_ctxt_t reqc);
 static int profiling_handler(ldmsd_req_ctxt_t req);
+static int latency_stats_handler(ldmsd_req_ctxt_t reqc);
 
 /* these are implemented in ldmsd_failover.c */
 int failover_config_handler(ldmsd_req_ctxt_t req_ctxt);
@@ -275,6 +279,7 @@ int failover_reset_handler(ldmsd_req_ctxt_t req_ctxt);
 int failover_cfgprdcr_handler(ldmsd_req_ctxt_t req_ctxt);
 int failover_cfgupdtr_handler(ldmsd_req_ctxt_t req_ctxt);
 int failover_cfgstrgp_handler(ldmsd_req_ctxt_t req_ctxt);
+int failover_cfgdel_handler(ldmsd_req_ctxt_t req_ctxt);
 int failover_ping_handler(ldmsd_req_ctxt_t req_ctxt);
 int failover_peercfg_handler(ldmsd_req_ctxt_t req);
 
@@ -352,16 +357,20 @@ static struct request_handler_entry request_handler[] = {
 
 	/* PRDCR */
 	[LDMSD_PRDCR_ADD_REQ] = {
-		LDMSD_PRDCR_ADD_REQ, prdcr_add_handler, XUG | MOD
+		LDMSD_PRDCR_ADD_REQ, prdcr_add_handler, XUG | MOD |
+		LDMSD_PERM_FAILOVER_REPLICATED
 	},
 	[LDMSD_PRDCR_DEL_REQ] = {
-		LDMSD_PRDCR_DEL_REQ, prdcr_del_handler, XUG | MOD
+		LDMSD_PRDCR_DEL_REQ, prdcr_del_handler, XUG | MOD |
+		LDMSD_PERM_FAILOVER_REPLICATED
 	},
 	[LDMSD_PRDCR_START_REQ] = {
-		LDMSD_PRDCR_START_REQ, prdcr_start_handler, XUG | MOD
+		LDMSD_PRDCR_START_REQ, prdcr_start_handler, XUG | MOD |
+		LDMSD_PERM_FAILOVER_REPLICATED
 	},
 	[LDMSD_PRDCR_STOP_REQ] = {
-		LDMSD_PRDCR_STOP_REQ, prdcr_stop_handler, XUG | MOD
+		LDMSD_PRDCR_STOP_REQ, prdcr_stop_handler, XUG | MOD |
+		LDMSD_PERM_FAILOVER_REPLICATED
 	},
 	[LDMSD_PRDCR_STATUS_REQ] = {
 		LDMSD_PRDCR_STATUS_REQ, prdcr_status_handler,
@@ -394,33 +403,42 @@ static struct request_handler_entry request_handler[] = {
 		XUG | LDMSD_PERM_FAILOVER_ALLOWED
 	},
 	[LDMSD_BRIDGE_ADD_REQ] = {
-		LDMSD_BRIDGE_ADD_REQ, prdcr_add_handler, XUG | MOD
+		LDMSD_BRIDGE_ADD_REQ, prdcr_add_handler, XUG | MOD |
+		LDMSD_PERM_FAILOVER_REPLICATED
 	},
 
 	/* STRGP */
 	[LDMSD_STRGP_ADD_REQ] = {
-		LDMSD_STRGP_ADD_REQ, strgp_add_handler, XUG | MOD
+		LDMSD_STRGP_ADD_REQ, strgp_add_handler, XUG | MOD |
+		LDMSD_PERM_FAILOVER_REPLICATED
 	},
 	[LDMSD_STRGP_DEL_REQ]  = {
-		LDMSD_STRGP_DEL_REQ, strgp_del_handler, XUG | MOD
+		LDMSD_STRGP_DEL_REQ, strgp_del_handler, XUG | MOD |
+		LDMSD_PERM_FAILOVER_REPLICATED
 	},
 	[LDMSD_STRGP_PRDCR_ADD_REQ] = {
-		LDMSD_STRGP_PRDCR_ADD_REQ, strgp_prdcr_add_handler, XUG | MOD
+		LDMSD_STRGP_PRDCR_ADD_REQ, strgp_prdcr_add_handler, XUG | MOD |
+		LDMSD_PERM_FAILOVER_REPLICATED
 	},
 	[LDMSD_STRGP_PRDCR_DEL_REQ] = {
-		LDMSD_STRGP_PRDCR_DEL_REQ, strgp_prdcr_del_handler, XUG | MOD
+		LDMSD_STRGP_PRDCR_DEL_REQ, strgp_prdcr_del_handler, XUG | MOD |
+		LDMSD_PERM_FAILOVER_REPLICATED
 	},
 	[LDMSD_STRGP_METRIC_ADD_REQ] = {
-		LDMSD_STRGP_METRIC_ADD_REQ, strgp_metric_add_handler, XUG | MOD
+		LDMSD_STRGP_METRIC_ADD_REQ, strgp_metric_add_handler, XUG | MOD |
+		LDMSD_PERM_FAILOVER_REPLICATED
 	},
 	[LDMSD_STRGP_METRIC_DEL_REQ] = {
-		LDMSD_STRGP_METRIC_DEL_REQ, strgp_metric_del_handler, XUG | MOD
+		LDMSD_STRGP_METRIC_DEL_REQ, strgp_metric_del_handler, XUG | MOD |
+		LDMSD_PERM_FAILOVER_REPLICATED
 	},
 	[LDMSD_STRGP_START_REQ] = {
-		LDMSD_STRGP_START_REQ, strgp_start_handler, XUG | MOD
+		LDMSD_STRGP_START_REQ, strgp_start_handler, XUG | MOD |
+		LDMSD_PERM_FAILOVER_REPLICATED
 	},
 	[LDMSD_STRGP_STOP_REQ] = {
-		LDMSD_STRGP_STOP_REQ, strgp_stop_handler, XUG | MOD
+		LDMSD_STRGP_STOP_REQ, strgp_stop_handler, XUG | MOD |
+		LDMSD_PERM_FAILOVER_REPLICATED
 	},
 	[LDMSD_STRGP_STATUS_REQ] = {
 		LDMSD_STRGP_STATUS_REQ, strgp_status_handler,
@@ -433,28 +451,36 @@ static struct request_handler_entry request_handler[] = {
 
 	/* UPDTR */
 	[LDMSD_UPDTR_ADD_REQ] = {
-		LDMSD_UPDTR_ADD_REQ, updtr_add_handler, XUG | MOD
+		LDMSD_UPDTR_ADD_REQ, updtr_add_handler, XUG | MOD |
+		LDMSD_PERM_FAILOVER_REPLICATED
 	},
 	[LDMSD_UPDTR_DEL_REQ] = {
-		LDMSD_UPDTR_DEL_REQ, updtr_del_handler, XUG | MOD
+		LDMSD_UPDTR_DEL_REQ, updtr_del_handler, XUG | MOD |
+		LDMSD_PERM_FAILOVER_REPLICATED
 	},
 	[LDMSD_UPDTR_PRDCR_ADD_REQ] = {
-		LDMSD_UPDTR_PRDCR_ADD_REQ, updtr_prdcr_add_handler, XUG | MOD
+		LDMSD_UPDTR_PRDCR_ADD_REQ, updtr_prdcr_add_handler, XUG | MOD |
+		LDMSD_PERM_FAILOVER_REPLICATED
 	},
 	[LDMSD_UPDTR_PRDCR_DEL_REQ] = {
-		LDMSD_UPDTR_PRDCR_DEL_REQ, updtr_prdcr_del_handler, XUG | MOD
+		LDMSD_UPDTR_PRDCR_DEL_REQ, updtr_prdcr_del_handler, XUG | MOD |
+		LDMSD_PERM_FAILOVER_REPLICATED
 	},
 	[LDMSD_UPDTR_START_REQ] = {
-		LDMSD_UPDTR_START_REQ, updtr_start_handler, XUG | MOD
+		LDMSD_UPDTR_START_REQ, updtr_start_handler, XUG | MOD |
+		LDMSD_PERM_FAILOVER_REPLICATED
 	},
 	[LDMSD_UPDTR_STOP_REQ] = {
-		LDMSD_UPDTR_STOP_REQ, updtr_stop_handler, XUG | MOD
+		LDMSD_UPDTR_STOP_REQ, updtr_stop_handler, XUG | MOD |
+		LDMSD_PERM_FAILOVER_REPLICATED
 	},
 	[LDMSD_UPDTR_MATCH_ADD_REQ] = {
-		LDMSD_UPDTR_MATCH_ADD_REQ, updtr_match_add_handler, XUG | MOD
+		LDMSD_UPDTR_MATCH_ADD_REQ, updtr_match_add_handler, XUG | MOD |
+		LDMSD_PERM_FAILOVER_REPLICATED
 	},
 	[LDMSD_UPDTR_MATCH_DEL_REQ] = {
-		LDMSD_UPDTR_MATCH_DEL_REQ, updtr_match_del_handler, XUG | MOD
+		LDMSD_UPDTR_MATCH_DEL_REQ, updtr_match_del_handler, XUG | MOD |
+		LDMSD_PERM_FAILOVER_REPLICATED
 	},
 	[LDMSD_UPDTR_MATCH_LIST_REQ] = {
 		LDMSD_UPDTR_MATCH_LIST_REQ, updtr_match_list_handler, XUG
@@ -567,6 +593,10 @@ static struct request_handler_entry request_handler[] = {
 	[LDMSD_PROFILING_REQ] = {
 		LDMSD_PROFILING_REQ, profiling_handler, XALL
 	},
+	[LDMSD_LATENCY_STATS_REQ] = {
+		LDMSD_LATENCY_STATS_REQ, latency_stats_handler,
+		XALL | LDMSD_PERM_FAILOVER_ALLOWED
+	},
 
 	/* FAILOVER user commands */
 	[LDMSD_FAILOVER_CONFIG_REQ] = {
@@ -623,6 +653,10 @@ static struct request_handler_entry request_handler[] = {
 		LDMSD_FAILOVER_PEERCFG_REQ, failover_peercfg_handler,
 		XUG | LDMSD_PERM_FAILOVER_INTERNAL,
 	},
+	[LDMSD_FAILOVER_CFGDEL_REQ] = {
+		LDMSD_FAILOVER_CFGDEL_REQ, failover_cfgdel_handler,
+		XUG | LDMSD_PERM_FAILOVER_INTERNAL,
+	},
 
 	/* SETGROUP */
 	[LDMSD_SETGROUP_ADD_REQ] = {
@@ -1106,6 +1140,11 @@ int ldmsd_handle_request(ldmsd_req_ctxt_t reqc)
 		if (0 == (mask & ent->flag))
 			return ebusy_handler(reqc);
 
+		/* the objects replicated from the failover peer are its own */
+		if ((ent->flag & LDMSD_PERM_FAILOVER_REPLICATED) &&
+		    __name_is_failover(reqc))
+			return failover_obj_handler(reqc);
+
 		/* check against credential */
 		struct ldms_cred crd;
 		ldms_xprt_cred_get(ldms, &crd, NULL);
@@ -1459,8 +1498,10 @@ int ldmsd_process_config_request(ldmsd_cfg_xprt_t xprt, ldmsd_req_hdr_t request,
 
 	if (!rc && !reqc->errcode) {
 		ent = &request_handler[reqc->req_id];
-		if (ent->flag & MOD)
+		if (ent->flag & MOD) {
 			ldmsd_inc_cfg_cntr();
+			ldmsd_failover_cfg_changed(reqc);
+		}
 	}
 
 put_reqc:
@@ -1657,7 +1698,12 @@ static int example_handler(ldmsd_req_ctxt_t reqc)
 	return rc;
 }
 
-ldmsd_prdcr_t __prdcr_add_handler(ldmsd_req_ctxt_t reqc, char *verb, char *obj_name)
+/*
+ * Add a producer from the request attributes. \c name_ov and \c host_ov,
+ * if not NULL, are used instead of the 'name' and 'host' attributes.
+ */
+static ldmsd_prdcr_t __prdcr_add(ldmsd_req_ctxt_t reqc, char *verb, char *obj_name,
+				 const char *name_ov, const char *host_ov)
 {
 	ldmsd_prdcr_t prdcr = NULL;
 	char *name, *host, *xprt, *attr_name, *type_s, *port_s, *interval_s,
@@ -1680,7 +1726,10 @@ ldmsd_prdcr_t __prdcr_add_handler(ldmsd_req_ctxt_t reqc, char *verb, char *obj_n
 	name = host = xprt = type_s = port_s = interval_s = auth = rail_s = quota_s = NULL;
 
 	attr_name = "name";
-	name = ldmsd_req_attr_str_value_get_by_id(reqc, LDMSD_ATTR_NAME);
+	if (name_ov)
+		name = strdup(name_ov);
+	else
+		name = ldmsd_req_attr_str_value_get_by_id(reqc, LDMSD_ATTR_NAME);
 	if (!name)
 		goto einval;
 
@@ -1711,7 +1760,10 @@ ldmsd_prdcr_t __prdcr_add_handler(ldmsd_req_ctxt_t reqc, char *verb, char *obj_n
 		goto einval;
 
 	attr_name = "host";
-	host = ldmsd_req_attr_str_value_get_by_id(reqc, LDMSD_ATTR_HOST);
+	if (host_ov)
+		host = strdup(host_ov);
+	else
+		host = ldmsd_req_attr_str_value_get_by_id(reqc, LDMSD_ATTR_HOST);
 	if (!host)
 		goto einval;
 
@@ -1862,19 +1914,123 @@ out:
 	return prdcr;
 }
 
+ldmsd_prdcr_t __prdcr_add_handler(ldmsd_req_ctxt_t reqc, char *verb, char *obj_name)
+{
+	return __prdcr_add(reqc, verb, obj_name, NULL, NULL);
+}
+
+static void __prdcr_add_dlog(ldmsd_prdcr_t prdcr)
+{
+	__dlog(DLOG_CFGOK, "prdcr_add name=%s xprt=%s host=%s port=%u type=%s "
+		"reconnect=%ld auth=%s uid=%d gid=%d perm=%o\n",
+		prdcr->obj.name, prdcr->xprt_name, prdcr->host_name,
+		prdcr->port_no, ldmsd_prdcr_type2str(prdcr->type),
+		prdcr->conn_intrvl_us, prdcr->conn_auth_dom_name,
+		(int)prdcr->obj.uid, (int)prdcr->obj.gid,
+		(unsigned)prdcr->obj.perm);
+}
+
+/*
+ * prdcr_add with a hostlist expression in 'name', e.g. name=node[1-1000]
+ * host=node[1-1000]. The 'host' expression expands to either one host for
+ * all producers or one host per producer.
+ *
+ * The command is all-or-nothing: if any producer cannot be added, the
+ * producers already added by this command are deleted again and the
+ * response names the producer that failed.
+ */
+static int __prdcr_add_bulk(ldmsd_req_ctxt_t reqc, const char *name_expr)
+{
+	ldmsd_prdcr_t prdcr;
+	struct ldmsd_sec_ctxt sctxt;
+	char *host_expr, *err = NULL;
+	char **names = NULL, **hosts = NULL;
+	int i, j, rc, n_names = 0, n_hosts = 0, n_left = 0;
+
+	host_expr = ldmsd_req_attr_str_value_get_by_id(reqc, LDMSD_ATTR_HOST);
+	if (!host_expr) {
+		reqc->errcode = EINVAL;
+		(void)Snprintf(&reqc->line_buf, &reqc->line_len,
+				"The attribute 'host' is required.");
+		goto out;
+	}
+	reqc->errcode = ldmsd_hostlist_expand(name_expr, &names, &n_names);
+	if (reqc->errcode) {
+		(void)Snprintf(&reqc->line_buf, &reqc->line_len,
+				"Bad producer name list '%s'.", name_expr);
+		goto out;
+	}
+	reqc->errcode = ldmsd_hostlist_expand(host_expr, &hosts, &n_hosts);
+	if (reqc->errcode) {
+		(void)Snprintf(&reqc->line_buf, &reqc->line_len,
+				"Bad host list '%s'.", host_expr);
+		goto out;
+	}
+	if (n_hosts != 1 && n_hosts != n_names) {
+		reqc->errcode = EINVAL;
+		(void)Snprintf(&reqc->line_buf, &reqc->line_len,
+				"'%s' names %d producers but '%s' names %d hosts.",
+				name_expr, n_names, host_expr, n_hosts);
+		goto out;
+	}
+	for (i = 0; i < n_names; i++) {
+		prdcr = __prdcr_add(reqc, "prdcr_add", "producer", names[i],
+				    hosts[(n_hosts == 1)?0:i]);
+		if (!prdcr)
+			goto rollback;
+		__prdcr_add_dlog(prdcr);
+	}
+	goto out;
+ rollback:
+	err = strdup(reqc->line_buf ? reqc->line_buf : "");
+	if (err && err[0] && err[strlen(err) - 1] == '.')
+		err[strlen(err) - 1] = '\0';
+	ldmsd_req_ctxt_sec_get(reqc, &sctxt);
+	for (j = 0; j < i; j++) {
+		rc = ldmsd_prdcr_del(names[j], &sctxt);
+		if (rc) {
+			ovis_log(config_log, OVIS_LERROR,
+				 "prdcr_add: cannot roll back producer '%s', "
+				 "error %d\n", names[j], rc);
+			n_left++;
+		} else {
+			__dlog(DLOG_CFGOK, "prdcr_del name=%s\n", names[j]);
+		}
+	}
+	if (n_left) {
+		(void)Snprintf(&reqc->line_buf, &reqc->line_len,
+			"Producer '%s' failed: %s; %d of the %d producers "
+			"added before it could not be removed, see the log.",
+			names[i], err ? err : "", n_left, i);
+	} else {
+		(void)Snprintf(&reqc->line_buf, &reqc->line_len,
+			"Producer '%s' failed: %s; no producers were added.",
+			names[i], err ? err : "");
+	}
+	free(err);
+ out:
+	free(host_expr);
+	if (names)
+		ldmsd_hostlist_free(names, n_names);
+	if (hosts)
+		ldmsd_hostlist_free(hosts, n_hosts);
+	return reqc->errcode;
+}
+
 static int prdcr_add_handler(ldmsd_req_ctxt_t reqc)
 {
 	ldmsd_prdcr_t prdcr;
-	prdcr = __prdcr_add_handler(reqc, "prdcr_add", "producer");
-	if (prdcr) {
-		__dlog(DLOG_CFGOK, "prdcr_add name=%s xprt=%s host=%s port=%u type=%s "
-			"reconnect=%ld auth=%s uid=%d gid=%d perm=%o\n",
-			prdcr->obj.name, prdcr->xprt_name, prdcr->host_name,
-			prdcr->port_no, ldmsd_prdcr_type2str(prdcr->type),
-			prdcr->conn_intrvl_us, prdcr->conn_auth_dom_name,
-			(int)prdcr->obj.uid, (int)prdcr->obj.gid,
-			(unsigned)prdcr->obj.perm);
+	char *name;
+
+	name = ldmsd_req_attr_str_value_get_by_id(reqc, LDMSD_ATTR_NAME);
+	if (name && strchr(name, '[')) {
+		(void)__prdcr_add_bulk(reqc, name);
+	} else {
+		prdcr = __prdcr_add_handler(reqc, "prdcr_add", "producer");
+		if (prdcr)
+			__prdcr_add_dlog(prdcr);
 	}
+	free(name);
 
 	ldmsd_send_req_response(reqc, reqc->line_buf);
 	return 0;
@@ -5110,7 +5266,8 @@ static int plugn_start_handler(ldmsd_req_ctxt_t reqc)
 	char *interval_us = NULL;
 	char *offset = NULL;
 	char *attr_name;
-	char *exclusive_thread;
+	char *exclusive_thread = NULL;
+	char *group = NULL;
 	size_t cnt = 0;
 
 	attr_name = "name";
@@ -5125,14 +5282,16 @@ static int plugn_start_handler(ldmsd_req_ctxt_t reqc)
 	exclusive_thread = ldmsd_req_attr_str_value_get_by_id(reqc, LDMSD_ATTR_XTHREAD);
 
 	offset = ldmsd_req_attr_str_value_get_by_id(reqc, LDMSD_ATTR_OFFSET);
+	group = ldmsd_req_attr_str_value_get_by_id(reqc, LDMSD_ATTR_GROUP);
 
 	reqc->errcode = ldmsd_sampler_start(instance_name, interval_us, offset,
-					    exclusive_thread);
+					    exclusive_thread, group);
 	if (reqc->errcode == 0) {
-		__dlog(DLOG_CFGOK, "start name=%s%s%s%s%s\n", instance_name,
+		__dlog(DLOG_CFGOK, "start name=%s%s%s%s%s%s%s\n", instance_name,
 			interval_us ? " interval=" : "",
 			interval_us ? interval_us : "",
-			offset ? " offset=" : "", offset ? offset : "");
+			offset ? " offset=" : "", offset ? offset : "",
+			group ? " group=" : "", group ? group : "");
 
 		goto send_reply;
 	} else if (reqc->errcode == EINVAL) {
@@ -5157,6 +5316,11 @@ static int plugn_start_handler(ldmsd_req_ctxt_t reqc)
 		cnt = Snprintf(&reqc->line_buf, &reqc->line_len,
 				"Sampler parameters interval and offset are "
 				"incompatible.");
+	} else if (reqc->errcode == EXDEV) {
+		reqc->errcode = EINVAL;
+		cnt = Snprintf(&reqc->line_buf, &reqc->line_len,
+				"The sampler group '%s' samples at a different "
+				"interval or offset.", group);
 	} else {
 		reqc->errcode = EINVAL;
 		cnt = Snprintf(&reqc->line_buf, &reqc->line_len,
@@ -5173,6 +5337,8 @@ send_reply:
 	free(instance_name);
 	free(interval_us);
 	free(offset);
+	free(exclusive_thread);
+	free(group);
 	return 0;
 }
 
@@ -6641,7 +6807,13 @@ static int dump_cfg_handler(ldmsd_req_ctxt_t reqc)
 				samp->cfg.name,
 				samp->cfg.avl_str ? samp->cfg.avl_str : "",
 				samp->cfg.kvl_str ? samp->cfg.kvl_str : "");
-		if (samp->thread_id >= 0) {
+		if (samp->grp) {
+			fprintf(fp, "start name=%s interval=%ld offset=%ld group=%s\n",
+				samp->cfg.name,
+				samp->sample_interval_us,
+				samp->sample_offset_us,
+				ldmsd_sampler_group_name(samp));
+		} else if (samp->thread_id >= 0) {
 			/* Plugin is running. */
 			fprintf(fp, "start name=%s interval=%ld offset=%ld\n",
 				samp->cfg.name,
@@ -6902,6 +7074,31 @@ static int eperm_handler(ldmsd_req_ctxt_t reqc)
 	return 0;
 }
 
+static int __name_is_failover(ldmsd_req_ctxt_t reqc)
+{
+	char *name;
+	int rc;
+
+	name = ldmsd_req_attr_str_value_get_by_id(reqc, LDMSD_ATTR_NAME);
+	if (!name)
+		return 0;
+	rc = (0 == strncmp(name, LDMSD_FAILOVER_NAME_PREFIX,
+			   sizeof(LDMSD_FAILOVER_NAME_PREFIX) - 1));
+	free(name);
+	return rc;
+}
+
+static int failover_obj_handler(ldmsd_req_ctxt_t reqc)
+{
+	reqc->errcode = EPERM;
+	Snprintf(&reqc->line_buf, &reqc->line_len,
+			"The names beginning with '%s' are reserved for the "
+			"configuration of the failover peer.",
+			LDMSD_FAILOVER_NAME_PREFIX);
+	ldmsd_send_req_response(reqc, reqc->line_buf);
+	return 0;
+}
+
 static int ebusy_handler(ldmsd_req_ctxt_t reqc)
 {
 	reqc->errcode = EBUSY;
@@ -7630,6 +7827,14 @@ static void __prdset_stats_reset(struct timespec *now, int is_update, int is_sto
  *       "utilization": <utilization ratio 0.0-1.0>,
  *       "sq_sz": <send queue size>,
  *       "n_eps": <number of endpoints>,
+ *       "zip": {
+ *         "in_bytes": <bytes given to the compressor>,
+ *         "out_bytes": <bytes sent after compression>,
+ *         "us": <time spent compressing in microseconds>,
+ *         "unzip_in_bytes": <compressed bytes received>,
+ *         "unzip_out_bytes": <bytes after decompression>,
+ *         "unzip_us": <time spent decompressing in microseconds>
+ *       },
  *       "idle": <idle ratio 0.0-1.0>,
  *       "active": <active ratio 0.0-1.0>,
  *       "interval": <analysis interval in microseconds>,
@@ -7683,6 +7888,9 @@ static void __prdset_stats_reset(struct timespec *now, int is_update, int is_sto
  *                   A value of -1 indicates insufficient data for calculation
  * sq_sz           - Send queue size (number of pending send operations)
  * n_eps           - Number of endpoints handled by this thread
+ * zip             - Payload compression counters of the zap transport
+ *                   (sock with ZAP_SOCK_COMPRESS); in_bytes - out_bytes is
+ *                   the number of bytes saved on the wire
  * idle            - Idle ratio within the last 3 seconds
  * active          - Active ratio within the last 3 seconds
  * interval        - Duration of the analysis interval in microseconds (3 seconds)
@@ -7784,6 +7992,14 @@ static char * __thread_stats_as_json(size_t *json_sz)
 		__APPEND("   \"utilization\": %g,\n", utilization);
 		__APPEND("   \"sq_sz\": %lu,\n", zthr->sq_sz);
 		__APPEND("   \"n_eps\": %lu,\n", zthr->n_eps);
+		__APPEND("   \"zip\": {\n");
+		__APPEND("     \"in_bytes\": %lu,\n", zthr->zip.in_bytes);
+		__APPEND("     \"out_bytes\": %lu,\n", zthr->zip.out_bytes);
+		__APPEND("     \"us\": %lu,\n", zthr->zip.ns / 1000);
+		__APPEND("     \"unzip_in_bytes\": %lu,\n", zthr->zip.unzip_in_bytes);
+		__APPEND("     \"unzip_out_bytes\": %lu,\n", zthr->zip.unzip_out_bytes);
+		__APPEND("     \"unzip_us\": %lu\n", zthr->zip.unzip_ns / 1000);
+		__APPEND("   },\n");
 		__APPEND("   \"ldms_xprt\": {\n");
 		__APPEND("     \"Idle\": %ld,\n", lres->entries[i].idle);
 		__APPEND("     \"Zap\": %ld,\n", lres->entries[i].zap_time);
@@ -9289,7 +9505,6 @@ __store_time_stats_strgp(json_entity_t strgp_dict, ldmsd_strgp_t strgp, int rese
 	int rc = 0;
 	ldmsd_prdcr_t prdcr;
 	ldmsd_prdcr_set_t prdset;
-	ldmsd_name_match_t match;
 	struct rbn *rbn;
 	pid_t tid;
 	char tid_s[128];
@@ -9314,12 +9529,8 @@ __store_time_stats_strgp(json_entity_t strgp_dict, ldmsd_strgp_t strgp, int rese
 	sets = json_attr_value(json_attr_find(strgp_stats, "sets"));
 
 	for (prdcr = ldmsd_prdcr_first(); prdcr; prdcr = ldmsd_prdcr_next(prdcr)) {
-		match = ldmsd_strgp_prdcr_first(strgp);
-		for (rc = 0; match; match = ldmsd_strgp_prdcr_next(match)) {
-			rc = regexec(&match->regex, prdcr->obj.name, 0, NULL, 0);
-			if (!rc)
-				break;
-		}
+		if (ldmsd_strgp_prdcr_match(strgp, prdcr->obj.name))
+			continue;
 		for (rbn = rbt_min(&prdcr->set_tree); rbn; rbn = rbn_succ(rbn)) {
 
 			prdset = container_of(rbn, struct ldmsd_prdcr_set, rbn);
@@ -9481,6 +9692,320 @@ out:
 	return rc;
 }
 
+static ovis_thrstats_hist_t *__cfgobj_lat(ldmsd_cfgobj_t obj)
+{
+	switch (obj->type) {
+	case LDMSD_CFGOBJ_PRDCR:
+		return ((ldmsd_prdcr_t)obj)->lat;
+	case LDMSD_CFGOBJ_UPDTR:
+		return ((ldmsd_updtr_t)obj)->lat;
+	case LDMSD_CFGOBJ_STRGP:
+		return ((ldmsd_strgp_t)obj)->lat;
+	case LDMSD_CFGOBJ_SAMPLER:
+		return ((ldmsd_cfgobj_sampler_t)obj)->lat;
+	default:
+		return NULL;
+	}
+}
+
+static json_t *__lat_hist_as_json(struct ovis_thrstats_hist_result *res)
+{
+	json_t *obj, *buckets;
+	int i, last;
+
+	obj = json_object();
+	if (!obj)
+		return NULL;
+	json_object_set_new(obj, "count", json_integer(res->count));
+	json_object_set_new(obj, "sum_us", json_integer(res->sum_us));
+	json_object_set_new(obj, "max_us", json_integer(res->max_us));
+	json_object_set_new(obj, "p50_us",
+		json_integer(ovis_thrstats_hist_percentile(res, 50)));
+	json_object_set_new(obj, "p90_us",
+		json_integer(ovis_thrstats_hist_percentile(res, 90)));
+	json_object_set_new(obj, "p99_us",
+		json_integer(ovis_thrstats_hist_percentile(res, 99)));
+	/* Trailing empty buckets are omitted */
+	for (last = OVIS_THRSTATS_HIST_BUCKETS - 1; last >= 0; last--) {
+		if (res->bucket[last])
+			break;
+	}
+	buckets = json_array();
+	for (i = 0; i <= last; i++)
+		json_array_append_new(buckets, json_integer(res->bucket[i]));
+	json_object_set_new(obj, "buckets", buckets);
+	return obj;
+}
+
+struct __lat_bin_buf {
+	char *buf;
+	size_t len;
+	size_t alloc_len;
+	uint32_t rec_count;
+};
+
+static int __lat_hist_append_bin(struct __lat_bin_buf *b, ldmsd_cfgobj_t obj,
+				 enum ldmsd_lat_op op,
+				 struct ovis_thrstats_hist_result *res)
+{
+	struct ldmsd_lat_stats_rec *rec;
+	size_t name_len = strlen(obj->name) + 1;
+	size_t rec_len;
+	char *tmp;
+	int i;
+
+	rec_len = sizeof(*rec) + OVIS_THRSTATS_HIST_BUCKETS * sizeof(uint64_t)
+		  + name_len;
+	rec_len = (rec_len + 7) & ~7;
+	if (b->len + rec_len > b->alloc_len) {
+		tmp = realloc(b->buf, (b->len + rec_len) * 2);
+		if (!tmp)
+			return ENOMEM;
+		b->buf = tmp;
+		b->alloc_len = (b->len + rec_len) * 2;
+	}
+	rec = (void *)&b->buf[b->len];
+	memset(rec, 0, rec_len);
+	rec->rec_len = htonl(rec_len);
+	rec->obj_type = obj->type;
+	rec->op = op;
+	rec->name_len = htons(name_len);
+	rec->count = htobe64(res->count);
+	rec->sum_us = htobe64(res->sum_us);
+	rec->max_us = htobe64(res->max_us);
+	for (i = 0; i < OVIS_THRSTATS_HIST_BUCKETS; i++)
+		rec->bucket[i] = htobe64(res->bucket[i]);
+	memcpy(&rec->bucket[OVIS_THRSTATS_HIST_BUCKETS], obj->name, name_len);
+	b->len += rec_len;
+	b->rec_count++;
+	return 0;
+}
+
+/*
+ * Collect the latency histograms of the cfgobjs of \c type into either
+ * \c jtype (JSON) or \c bin (binary). Caller must hold the cfgobj tree lock.
+ */
+static int __lat_stats_collect(ldmsd_cfgobj_type_t type, const char *name,
+			       int is_reset, json_t *jtype,
+			       struct __lat_bin_buf *bin)
+{
+	struct ovis_thrstats_hist_result res;
+	ovis_thrstats_hist_t *lat;
+	ldmsd_cfgobj_t obj;
+	json_t *jobj;
+	int op, rc;
+
+	for (obj = ldmsd_cfgobj_first(type); obj; obj = ldmsd_cfgobj_next(obj)) {
+		if (name && strcmp(name, obj->name))
+			continue;
+		lat = __cfgobj_lat(obj);
+		if (!lat)
+			continue;
+		jobj = NULL;
+		if (jtype) {
+			jobj = json_object();
+			if (!jobj) {
+				rc = ENOMEM;
+				goto err;
+			}
+			json_object_set_new(jtype, obj->name, jobj);
+		}
+		for (op = 0; op < LDMSD_LAT_LAST; op++) {
+			if (!lat[op])
+				continue;
+			ovis_thrstats_hist_get(lat[op], &res);
+			if (is_reset)
+				ovis_thrstats_hist_reset(lat[op]);
+			if (jobj) {
+				json_object_set_new(jobj, ldmsd_lat_op_str(op),
+						    __lat_hist_as_json(&res));
+			} else {
+				rc = __lat_hist_append_bin(bin, obj, op, &res);
+				if (rc)
+					goto err;
+			}
+		}
+	}
+	return 0;
+err:
+	ldmsd_cfgobj_put(obj, "iter");
+	return rc;
+}
+
+static int latency_stats_handler(ldmsd_req_ctxt_t reqc)
+{
+	ldmsd_cfgobj_type_t types[] = {
+		LDMSD_CFGOBJ_PRDCR, LDMSD_CFGOBJ_UPDTR, LDMSD_CFGOBJ_STRGP,
+		LDMSD_CFGOBJ_SAMPLER
+	};
+	struct __lat_bin_buf bin = {};
+	struct ldmsd_lat_stats_hdr *hdr;
+	struct ldmsd_req_attr_s attr;
+	json_t *obj = NULL, *jtype, *bounds;
+	char *name, *type_s, *reset_s, *fmt_s;
+	char *json_s = NULL;
+	const char *data;
+	size_t data_len;
+	int i, rc = 0;
+	int is_reset = 0;
+	int is_bin = 0;
+
+	name = ldmsd_req_attr_str_value_get_by_id(reqc, LDMSD_ATTR_NAME);
+	type_s = ldmsd_req_attr_str_value_get_by_id(reqc, LDMSD_ATTR_TYPE);
+	reset_s = ldmsd_req_attr_str_value_get_by_id(reqc, LDMSD_ATTR_RESET);
+	fmt_s = ldmsd_req_attr_str_value_get_by_id(reqc, LDMSD_ATTR_FORMAT);
+
+	if (reset_s && (0 != strcasecmp(reset_s, "false")))
+		is_reset = 1;
+	if (fmt_s) {
+		if (0 == strcasecmp(fmt_s, "binary")) {
+			is_bin = 1;
+		} else if (0 != strcasecmp(fmt_s, "json")) {
+			reqc->errcode = EINVAL;
+			(void) snprintf(reqc->line_buf, reqc->line_len,
+					"Unknown format '%s'. "
+					"Expecting 'json' or 'binary'.", fmt_s);
+			goto send_reply;
+		}
+	}
+	if (type_s) {
+		for (i = 0; i < (sizeof(types)/sizeof(types[0])); i++) {
+			if (0 == strcasecmp(type_s, ldmsd_cfgobj_type_str(types[i])))
+				break;
+		}
+		if (i == (sizeof(types)/sizeof(types[0]))) {
+			reqc->errcode = EINVAL;
+			(void) snprintf(reqc->line_buf, reqc->line_len,
+					"Unknown type '%s'. Expecting 'prdcr', "
+					"'updtr', 'strgp' or 'sampler'.", type_s);
+			goto send_reply;
+		}
+	}
+
+	if (is_bin) {
+		bin.alloc_len = sizeof(*hdr);
+		bin.len = sizeof(*hdr);
+		bin.buf = calloc(1, bin.alloc_len);
+		if (!bin.buf)
+			goto enomem;
+	} else {
+		/*
+		 * {
+		 *   "bucket_bounds_us": [ <exclusive upper bound>, ... ],
+		 *   "prdcr": {
+		 *     <name>: {
+		 *       <op>: { "count", "sum_us", "max_us",
+		 *               "p50_us", "p90_us", "p99_us", "buckets" },
+		 *       ...
+		 *     },
+		 *     ...
+		 *   },
+		 *   "updtr": { ... },
+		 *   "strgp": { ... },
+		 *   "sampler": { ... }
+		 * }
+		 */
+		obj = json_object();
+		bounds = json_array();
+		if (!obj || !bounds)
+			goto enomem;
+		for (i = 0; i < OVIS_THRSTATS_HIST_BUCKETS - 1; i++) {
+			json_array_append_new(bounds,
+				json_integer(ovis_thrstats_hist_bucket_bound(i)));
+		}
+		json_array_append_new(bounds, json_null());
+		json_object_set_new(obj, "bucket_bounds_us", bounds);
+	}
+
+	for (i = 0; i < (sizeof(types)/sizeof(types[0])); i++) {
+		if (type_s && strcasecmp(type_s, ldmsd_cfgobj_type_str(types[i])))
+			continue;
+		jtype = NULL;
+		if (obj) {
+			jtype = json_object();
+			if (!jtype)
+				goto enomem;
+			json_object_set_new(obj, ldmsd_cfgobj_type_str(types[i]), jtype);
+		}
+		ldmsd_cfg_lock(types[i]);
+		rc = __lat_stats_collect(types[i], name, is_reset, jtype, &bin);
+		ldmsd_cfg_unlock(types[i]);
+		if (rc)
+			goto enomem;
+	}
+
+	if (is_bin) {
+		hdr = (void *)bin.buf;
+		hdr->version = htonl(LDMSD_LAT_STATS_VERSION);
+		hdr->bucket_count = htonl(OVIS_THRSTATS_HIST_BUCKETS);
+		hdr->rec_count = htonl(bin.rec_count);
+		data = bin.buf;
+		data_len = bin.len;
+		attr.attr_id = LDMSD_ATTR_FORMAT;
+	} else {
+		json_s = json_dumps(obj, JSON_COMPACT);
+		if (!json_s)
+			goto enomem;
+		data = json_s;
+		data_len = strlen(json_s) + 1;
+		attr.attr_id = LDMSD_ATTR_JSON;
+	}
+	attr.discrim = 1;
+	attr.attr_len = data_len;
+	ldmsd_hton_req_attr(&attr);
+	rc = ldmsd_append_reply(reqc, (char *)&attr, sizeof(attr), LDMSD_REQ_SOM_F);
+	if (rc)
+		goto out;
+	rc = ldmsd_append_reply(reqc, data, data_len, 0);
+	if (rc)
+		goto out;
+	attr.discrim = 0;
+	rc = ldmsd_append_reply(reqc, (char *)&attr.discrim,
+				sizeof(attr.discrim), LDMSD_REQ_EOM_F);
+	goto out;
+enomem:
+	ovis_log(config_log, OVIS_LCRIT, "Memory allocation failure\n");
+	reqc->errcode = ENOMEM;
+	(void) snprintf(reqc->line_buf, reqc->line_len,
+			"Memory allocation failure.");
+send_reply:
+	ldmsd_send_req_response(reqc, reqc->line_buf);
+out:
+	if (obj)
+		json_decref(obj);
+	free(json_s);
+	free(bin.buf);
+	free(name);
+	free(type_s);
+	free(reset_s);
+	free(fmt_s);
+	return rc;
+}
+
+static void __lat_stats_reset()
+{
+	ldmsd_cfgobj_type_t types[] = {
+		LDMSD_CFGOBJ_PRDCR, LDMSD_CFGOBJ_UPDTR, LDMSD_CFGOBJ_STRGP,
+		LDMSD_CFGOBJ_SAMPLER
+	};
+	ldmsd_cfgobj_type_t type;
+	ovis_thrstats_hist_t *lat;
+	ldmsd_cfgobj_t obj;
+	int i;
+
+	for (i = 0; i < (sizeof(types)/sizeof(types[0])); i++) {
+		type = types[i];
+		ldmsd_cfg_lock(type);
+		for (obj = ldmsd_cfgobj_first(type); obj;
+				obj = ldmsd_cfgobj_next(obj)) {
+			lat = __cfgobj_lat(obj);
+			if (lat)
+				ldmsd_lat_reset(lat);
+		}
+		ldmsd_cfg_unlock(type);
+	}
+}
+
 static int stats_reset_handler(ldmsd_req_ctxt_t reqc)
 {
 	struct timespec now;
@@ -9492,7 +10017,8 @@ static int stats_reset_handler(ldmsd_req_ctxt_t reqc)
 	int is_thread;
 	int is_xprt;
 	int is_stream;
-	is_update = is_store = is_thread = is_xprt = is_stream = 0;
+	int is_latency;
+	is_update = is_store = is_thread = is_xprt = is_stream = is_latency = 0;
 
 	s = ldmsd_req_attr_str_value_get_by_id(reqc, LDMSD_ATTR_STRING);
 	if (s) {
@@ -9516,11 +10042,13 @@ static int stats_reset_handler(ldmsd_req_ctxt_t reqc)
 				is_xprt = 1;
 			else if (0 == strcasecmp(tok, "stream"))
 				is_stream = 1;
+			else if (0 == strcasecmp(tok, "latency"))
+				is_latency = 1;
 			tok = strtok_r(NULL, ",", &ptr);
 		}
 
 	} else {
-		is_update = is_store = is_thread = is_xprt = is_stream = 1;
+		is_update = is_store = is_thread = is_xprt = is_stream = is_latency = 1;
 	}
 
 	clock_gettime(CLOCK_REALTIME, &now);
@@ -9538,6 +10066,9 @@ static int stats_reset_handler(ldmsd_req_ctxt_t reqc)
 
 	if (is_stream)
 		ldms_msg_stats_reset();
+
+	if (is_latency)
+		__lat_stats_reset();
 out:
 	free(s);
 	ldmsd_send_req_response(reqc, reqc->line_buf);
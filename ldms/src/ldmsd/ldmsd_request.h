@@ -166,6 +166,7 @@ enum ldmsd_request {
 	LDMSD_PID_FILE_REQ,
 	LDMSD_BANNER_MODE_REQ,
 	LDMSD_PROFILING_REQ,
+	LDMSD_LATENCY_STATS_REQ,
 
 	/* failover requests by user */
 	LDMSD_FAILOVER_CONFIG_REQ = 0x700, /* "failover_config" user command */
@@ -182,6 +183,7 @@ enum ldmsd_request {
 	LDMSD_FAILOVER_CFGSTRGP_REQ, /* internal strgp failover config */
 	LDMSD_FAILOVER_PING_REQ, /* ping message over REQ protocol */
 	LDMSD_FAILOVER_PEERCFG_REQ, /* request peer cfg */
+	LDMSD_FAILOVER_CFGDEL_REQ, /* internal failover config deletion */
 
 	/* additional failover requests by user */
 	LDMSD_FAILOVER_START_REQ = 0x770, /* start the failover service */
@@ -275,6 +277,9 @@ enum ldmsd_request_attr {
 	LDMSD_ATTR_RESET_INTERVAL,
 	LDMSD_ATTR_XTHREAD,
 	LDMSD_ATTR_MSG_CHAN,
+	LDMSD_ATTR_FORMAT,
+	LDMSD_ATTR_STANDBY,
+	LDMSD_ATTR_GROUP,
 	LDMSD_ATTR_LAST,
 };
 
@@ -415,6 +420,35 @@ typedef struct ldmsd_req_attr_s {
 } *ldmsd_req_attr_t;
 #pragma pack(pop)
 
+/*
+ * Binary reply of the latency_stats request (format=binary)
+ *
+ * The reply is a single LDMSD_ATTR_FORMAT attribute holding an
+ * ldmsd_lat_stats_hdr followed by hdr.rec_count records. Each record is
+ * padded to a multiple of 8 bytes and rec_len includes the padding. All
+ * integers are in network byte order.
+ */
+#define LDMSD_LAT_STATS_VERSION 1
+#pragma pack(push, 1)
+struct ldmsd_lat_stats_hdr {
+	uint32_t version;	/* LDMSD_LAT_STATS_VERSION */
+	uint32_t bucket_count;	/* Number of buckets in each record */
+	uint32_t rec_count;	/* Number of records following the header */
+	uint32_t reserved;
+};
+
+struct ldmsd_lat_stats_rec {
+	uint32_t rec_len;	/* Length of the record, including name */
+	uint8_t obj_type;	/* ldmsd_cfgobj_type_t */
+	uint8_t op;		/* enum ldmsd_lat_op */
+	uint16_t name_len;	/* Length of name, including '\0' */
+	uint64_t count;
+	uint64_t sum_us;
+	uint64_t max_us;
+	uint64_t bucket[OVIS_FLEX];	/* hdr.bucket_count buckets, then name */
+};
+#pragma pack(pop)
+
 struct ldmsd_req_array {
 	int num_reqs; /**<  Number of request handles */
 	ldmsd_req_hdr_t reqs[OVIS_FLEX]; /**<  array of request handles */
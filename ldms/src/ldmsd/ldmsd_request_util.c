@@ -92,6 +92,7 @@ struct req_str_id req_str_id_table[] = {
 	{  "failover_stop",      LDMSD_FAILOVER_STOP_REQ  },
 	{  "greeting",           LDMSD_GREETING_REQ  },
 	{  "include",            LDMSD_INCLUDE_REQ  },
+	{  "latency_stats",      LDMSD_LATENCY_STATS_REQ  },
 	{  "listen",             LDMSD_LISTEN_REQ },
 	{  "load",               LDMSD_PLUGN_LOAD_REQ  },
 	{  "log_file",           LDMSD_LOG_FILE_REQ  },
@@ -196,7 +197,9 @@ struct req_str_id attr_str_id_table[] = {
 	{  "disable_start",     LDMSD_ATTR_AUTO_INTERVAL  },
 	{  "exclusive_thread",  LDMSD_ATTR_XTHREAD  },
 	{  "flush",             LDMSD_ATTR_INTERVAL },
+	{  "format",            LDMSD_ATTR_FORMAT  },
 	{  "gid",               LDMSD_ATTR_GID  },
+	{  "group",             LDMSD_ATTR_GROUP  },
 	{  "host",              LDMSD_ATTR_HOST  },
 	{  "incr",              LDMSD_ATTR_INCREMENT  },
 	{  "instance",          LDMSD_ATTR_INSTANCE  },
@@ -227,6 +230,7 @@ struct req_str_id attr_str_id_table[] = {
 	{  "rx_rate",           LDMSD_ATTR_RX_RATE  },
 	{  "schema",            LDMSD_ATTR_SCHEMA  },
 	{  "size",              LDMSD_ATTR_SIZE  },
+	{  "standby",           LDMSD_ATTR_STANDBY  },
 	{  "stream",            LDMSD_ATTR_STREAM  },
 	{  "string",            LDMSD_ATTR_STRING  },
 	{  "summary",           LDMSD_ATTR_SUMMARY  },
@@ -339,6 +343,7 @@ const char *ldmsd_req_id2str(enum ldmsd_request req_id)
 	case LDMSD_SET_SEC_MOD_REQ       : return "SET_SEC_REQ";
 	case LDMSD_LOG_STATUS_REQ        : return "LOG_STATUS_REQ";
 	case LDMSD_PROFILING_REQ         : return "PROFILING_REQ";
+	case LDMSD_LATENCY_STATS_REQ     : return "LATENCY_STATS_REQ";
 
 	/* failover requests by user */
 	case LDMSD_FAILOVER_CONFIG_REQ        : return "FAILOVER_CONFIG_REQ";
@@ -355,6 +360,7 @@ const char *ldmsd_req_id2str(enum ldmsd_request req_id)
 	case LDMSD_FAILOVER_CFGSTRGP_REQ  : return "FAILOVER_CFGSTRGP_REQ";
 	case LDMSD_FAILOVER_PING_REQ      : return "FAILOVER_PING_REQ";
 	case LDMSD_FAILOVER_PEERCFG_REQ   : return "FAILOVER_PEERCFG_REQ";
+	case LDMSD_FAILOVER_CFGDEL_REQ    : return "FAILOVER_CFGDEL_REQ";
 
 	/* additional failover requests by user */
 	case LDMSD_FAILOVER_START_REQ : return "FAILOVER_START_REQ";
@@ -91,11 +91,19 @@ void ldmsd_strgp___del(ldmsd_cfgobj_t obj)
 			free(match->regex_str);
 		regfree(&match->regex);
 		LIST_REMOVE(match, entry);
+		if (match->name) {
+			rbt_del(&strgp->prdcr_name_tree, &match->rbn);
+			free(match->name);
+		} else {
+			LIST_REMOVE(match, regex_entry);
+		}
 		free(match);
 	}
 	if (strgp->decomp_path)
 		free(strgp->decomp_path);
+	free(strgp->decomp_key);
 	free(strgp->digest);
+	ldmsd_lat_free(strgp->lat);
 	ldmsd_cfgobj___del(obj);
 }
 
@@ -176,19 +184,133 @@ out:
 	return rc;
 }
 
+/*
+ * The rows of a set update decomposed by one strgp and committed by every
+ * strgp of the set with the same decomposition key. The prd_set holds a
+ * reference until the end of the update (ldmsd_strgp_row_share_release()).
+ */
+struct ldmsd_row_share_s {
+	int ref_count;
+	ldmsd_strgp_t strgp;	/* the strgp that decomposed the rows */
+	int row_count;
+	struct ldmsd_row_list_s row_list;
+	LIST_ENTRY(ldmsd_row_share_s) entry;
+};
+typedef struct ldmsd_row_share_s *ldmsd_row_share_t;
+
+static int decomp_key_eq(ldmsd_strgp_t a, ldmsd_strgp_t b)
+{
+	return a->decomp_key && b->decomp_key &&
+	       a->decomp_key_hash == b->decomp_key_hash &&
+	       0 == strcmp(a->decomp_key, b->decomp_key);
+}
+
+static ldmsd_row_share_t row_share_find(ldmsd_prdcr_set_t prd_set, ldmsd_strgp_t strgp)
+{
+	ldmsd_row_share_t rs;
+	LIST_FOREACH(rs, &prd_set->row_share_list, entry) {
+		if (decomp_key_eq(rs->strgp, strgp))
+			return rs;
+	}
+	return NULL;
+}
+
+/* Another strgp of the set decomposes the same way */
+static int row_share_wanted(ldmsd_prdcr_set_t prd_set, ldmsd_strgp_t strgp)
+{
+	ldmsd_strgp_ref_t ref;
+	LIST_FOREACH(ref, &prd_set->strgp_list, entry) {
+		if (ref->strgp != strgp && decomp_key_eq(ref->strgp, strgp))
+			return 1;
+	}
+	return 0;
+}
+
+static ldmsd_row_share_t row_share_new(ldmsd_prdcr_set_t prd_set, ldmsd_strgp_t strgp,
+				       ldmsd_row_list_t row_list, int row_count)
+{
+	ldmsd_row_share_t rs = calloc(1, sizeof(*rs));
+	if (!rs)
+		return NULL;
+	rs->ref_count = 1; /* prd_set->row_share_list */
+	rs->strgp = ldmsd_strgp_get(strgp, "row_share");
+	rs->row_count = row_count;
+	TAILQ_INIT(&rs->row_list);
+	TAILQ_CONCAT(&rs->row_list, row_list, entry);
+	LIST_INSERT_HEAD(&prd_set->row_share_list, rs, entry);
+	return rs;
+}
+
+static ldmsd_row_share_t row_share_get(ldmsd_row_share_t rs)
+{
+	__atomic_fetch_add(&rs->ref_count, 1, __ATOMIC_SEQ_CST);
+	return rs;
+}
+
+static void row_share_put(ldmsd_row_share_t rs)
+{
+	ldmsd_strgp_t strgp = rs->strgp;
+	if (__atomic_sub_fetch(&rs->ref_count, 1, __ATOMIC_SEQ_CST))
+		return;
+	ldmsd_strgp_lock(strgp);
+	strgp->decomp->release_rows(strgp, &rs->row_list);
+	ldmsd_strgp_unlock(strgp);
+	ldmsd_strgp_put(strgp, "row_share");
+	free(rs);
+}
+
+void ldmsd_strgp_row_share_release(ldmsd_prdcr_set_t prd_set)
+{
+	ldmsd_row_share_t rs;
+	while ((rs = LIST_FIRST(&prd_set->row_share_list))) {
+		LIST_REMOVE(rs, entry);
+		row_share_put(rs);
+	}
+}
+
 static void strgp_decompose(ldmsd_strgp_t strgp, ldmsd_prdcr_set_t prd_set, void **ctxt)
 {
 	struct ldmsd_row_list_s row_list = TAILQ_HEAD_INITIALIZER(row_list);
+	ldmsd_row_list_t rows = &row_list;
+	ldmsd_row_share_t rs = NULL;
 	int row_count, rc;
+	struct timespec start, end;
+
+	if (strgp->decomp_key) {
+		rs = row_share_find(prd_set, strgp);
+		if (rs) {
+			/* decomposed by another strgp in this update */
+			row_share_get(rs);
+			rows = &rs->row_list;
+			row_count = rs->row_count;
+			rc = 0;
+			clock_gettime(CLOCK_REALTIME, &end);
+			goto commit;
+		}
+	}
+	clock_gettime(CLOCK_REALTIME, &start);
 	rc = strgp->decomp->decompose(strgp, prd_set->set, &row_list, &row_count, ctxt);
+	clock_gettime(CLOCK_REALTIME, &end);
+	ldmsd_lat_record(strgp->lat, LDMSD_LAT_DECOMP, &start, &end);
 	if (rc) {
+		/* not shared; the other strgps will try on their own */
 		ovis_log(store_log, OVIS_LERROR,
 			 "decompose error: %d for set '%s'\n", rc, prd_set->inst_name);
 		return;
 	}
+	if (strgp->decomp_key && row_share_wanted(prd_set, strgp)) {
+		rs = row_share_new(prd_set, strgp, &row_list, row_count);
+		if (rs) {
+			row_share_get(rs);
+			rows = &rs->row_list;
+		}
+	}
+ commit:
         if (strgp->store->api->commit != NULL) {
                 rc = strgp->store->api->commit(strgp->store,
-					       strgp, prd_set->set, &row_list, row_count);
+					       strgp, prd_set->set, rows, row_count);
+		clock_gettime(CLOCK_REALTIME, &start);
+		ldmsd_lat_record(strgp->lat, LDMSD_LAT_COMMIT, &end, &start);
         } else {
                 ovis_log(store_log, OVIS_LERROR,
                          "store plugin \"%s\" does not support decomposition commit()\n",
@@ -197,7 +319,10 @@ static void strgp_decompose(ldmsd_strgp_t strgp, ldmsd_prdcr_set_t prd_set, void
 	if (rc) {
 		ovis_log(store_log, OVIS_LERROR, "strgp row commit error: %d\n", rc);
 	}
-	strgp->decomp->release_rows(strgp, &row_list);
+	if (rs)
+		row_share_put(rs);
+	else
+		strgp->decomp->release_rows(strgp, &row_list);
 }
 
 /* protected by strgp lock */
@@ -239,9 +364,15 @@ static void strgp_update_fn(ldmsd_strgp_t strgp, ldmsd_prdcr_set_t prd_set, void
 	}
 }
 
+static int prdcr_name_cmp(void *a, const void *b)
+{
+	return strcmp(a, b);
+}
+
 ldmsd_strgp_t
 ldmsd_strgp_new_with_auth(const char *name, uid_t uid, gid_t gid, int perm)
 {
+	extern struct rbt *cfgobj_trees[];
 	struct ldmsd_strgp *strgp;
 
 	strgp = (struct ldmsd_strgp *)
@@ -258,8 +389,19 @@ ldmsd_strgp_new_with_auth(const char *name, uid_t uid, gid_t gid, int perm)
 	strgp->last_flush.tv_nsec = 0;
 	strgp->update_fn = strgp_update_fn;
 	LIST_INIT(&strgp->prdcr_list);
+	LIST_INIT(&strgp->prdcr_regex_list);
+	rbt_init(&strgp->prdcr_name_tree, prdcr_name_cmp);
 	TAILQ_INIT(&strgp->metric_list);
 	ldmsd_task_init(&strgp->task);
+	if (ldmsd_lat_alloc(strgp->lat, LDMSD_LAT_F(LDMSD_LAT_STORE) |
+					LDMSD_LAT_F(LDMSD_LAT_DECOMP) |
+					LDMSD_LAT_F(LDMSD_LAT_COMMIT))) {
+		rbt_del(cfgobj_trees[LDMSD_CFGOBJ_STRGP], &strgp->obj.rbn);
+		ldmsd_cfgobj_unlock(&strgp->obj);
+		ldmsd_strgp_put(strgp, "cfgobj_tree");
+		ldmsd_strgp_put(strgp, "init");
+		return NULL;
+	}
 #ifdef _CFG_REF_DUMP_
 	ref_dump(&strgp->obj.ref, strgp->obj.name, stderr);
 #endif
@@ -305,6 +447,27 @@ ldmsd_name_match_t ldmsd_strgp_prdcr_next(ldmsd_name_match_t match)
 	return LIST_NEXT(match, entry);
 }
 
+/*
+ * Return 0 if the producer named \c prdcr_name is selected by the storage
+ * policy, i.e. the policy has no producer matches or one of them matches the
+ * name. The literal "^name$" matches are looked up by name.
+ *
+ * Caller must hold the strgp lock.
+ */
+int ldmsd_strgp_prdcr_match(ldmsd_strgp_t strgp, const char *prdcr_name)
+{
+	ldmsd_name_match_t match;
+	if (LIST_EMPTY(&strgp->prdcr_list))
+		return 0;
+	if (rbt_find(&strgp->prdcr_name_tree, prdcr_name))
+		return 0;
+	LIST_FOREACH(match, &strgp->prdcr_regex_list, regex_entry) {
+		if (0 == regexec(&match->regex, prdcr_name, 0, NULL, 0))
+			return 0;
+	}
+	return REG_NOMATCH;
+}
+
 time_t convert_rotate_str(const char *rotate)
 {
 	char *units;
@@ -342,6 +505,7 @@ int ldmsd_strgp_prdcr_add(const char *strgp_name, const char *regex_str,
 			  char *rep_buf, size_t rep_len, ldmsd_sec_ctxt_t ctxt)
 {
 	int rc = 0;
+	int exact;
 	ldmsd_strgp_t strgp = ldmsd_strgp_find(strgp_name);
 	if (!strgp)
 		return ENOENT;
@@ -369,6 +533,17 @@ int ldmsd_strgp_prdcr_add(const char *strgp_name, const char *regex_str,
 	if (rc)
 		goto out_3;
 	match->selector = LDMSD_NAME_MATCH_INST_NAME;
+	match->name = ldmsd_regex_prefix(regex_str, &exact);
+	if (match->name && !exact) {
+		free(match->name);
+		match->name = NULL;
+	}
+	if (match->name) {
+		rbn_init(&match->rbn, match->name);
+		rbt_ins(&strgp->prdcr_name_tree, &match->rbn);
+	} else {
+		LIST_INSERT_HEAD(&strgp->prdcr_regex_list, match, regex_entry);
+	}
 	LIST_INSERT_HEAD(&strgp->prdcr_list, match, entry);
 	goto out_1;
 out_3:
@@ -403,6 +578,12 @@ int ldmsd_strgp_prdcr_del(const char *strgp_name, const char *regex_str,
 		goto out_1;
 	}
 	LIST_REMOVE(match, entry);
+	if (match->name) {
+		rbt_del(&strgp->prdcr_name_tree, &match->rbn);
+		free(match->name);
+	} else {
+		LIST_REMOVE(match, regex_entry);
+	}
 	free(match->regex_str);
 	regfree(&match->regex);
 	free(match);
@@ -689,12 +870,7 @@ void ldmsd_strgp_update(ldmsd_prdcr_set_t prd_set)
 	ldmsd_cfg_lock(LDMSD_CFGOBJ_STRGP);
 	for (strgp = ldmsd_strgp_first(); strgp; strgp = ldmsd_strgp_next(strgp)) {
 		ldmsd_strgp_lock(strgp);
-		ldmsd_name_match_t match = ldmsd_strgp_prdcr_first(strgp);
-		for (rc = 0; match; match = ldmsd_strgp_prdcr_next(match)) {
-			rc = regexec(&match->regex, prd_set->prdcr->obj.name, 0, NULL, 0);
-			if (!rc)
-				break;
-		}
+		rc = ldmsd_strgp_prdcr_match(strgp, prd_set->prdcr->obj.name);
 		if (rc) {
 			ldmsd_strgp_unlock(strgp);
 			continue;
@@ -84,6 +84,7 @@ void ldmsd_updtr___del(ldmsd_cfgobj_t obj)
 		ldmsd_cfgobj_put(&prdcr_ref->prdcr->obj, "init");
 		free(prdcr_ref);
 	}
+	ldmsd_lat_free(updtr->lat);
 	ldmsd_cfgobj___del(obj);
 }
 
@@ -165,6 +166,12 @@ static void updtr_task_init(ldmsd_updtr_task_t task, ldmsd_updtr_t updtr,
 	task->set_count = 0;
 	rbn_init(&task->rbn, &task->hint);
 	ldmsd_task_init(&task->task);
+	/*
+	 * All tasks of an updater run on the updater's shard so that the
+	 * updater lock and the producer set locks it takes are not bounced
+	 * between the worker threads.
+	 */
+	ldmsd_task_shard_set(&task->task, ldmsd_shard_hash(updtr->obj.name));
 }
 
 /* Caller must hold the updater lock. */
@@ -215,6 +222,7 @@ static void updtr_update_cb(ldms_t t, ldms_set_t set, int status, void *arg)
 {
 	uint64_t gn, push_it = 0;
 	ldmsd_prdcr_set_t prd_set = arg;
+	ldmsd_updtr_t updtr = NULL;
 	int errcode;
 	struct timespec start;
 	struct timespec end;
@@ -222,6 +230,16 @@ static void updtr_update_cb(ldms_t t, ldms_set_t set, int status, void *arg)
 	pthread_mutex_lock(&prd_set->lock);
 	clock_gettime(CLOCK_REALTIME, &prd_set->updt_stat.end);
 	ldmsd_stat_update(&prd_set->updt_stat, &prd_set->updt_stat.start, &prd_set->updt_stat.end);
+	if (0 == (status & LDMS_UPD_F_PUSH)) {
+		updtr = prd_set->updt_updtr;
+		ldmsd_lat_record(prd_set->prdcr->lat, LDMSD_LAT_UPDATE,
+				 &prd_set->updt_stat.start, &prd_set->updt_stat.end);
+		if (updtr) {
+			ldmsd_lat_record(updtr->lat, LDMSD_LAT_UPDATE,
+					 &prd_set->updt_stat.start,
+					 &prd_set->updt_stat.end);
+		}
+	}
 
 	errcode = LDMS_UPD_ERROR(status);
 	ovis_log(updtr_log, OVIS_LDEBUG, "Update complete for Set %s with status %#x\n",
@@ -265,8 +283,13 @@ static void updtr_update_cb(ldms_t t, ldms_set_t set, int status, void *arg)
 			prd_set->store_stat.start = start;
 		prd_set->store_stat.end = end;
 		ldmsd_stat_update(&prd_set->store_stat, &start, &end);
+		ldmsd_lat_record(strgp->lat, LDMSD_LAT_STORE, &start, &end);
+		ldmsd_lat_record(prd_set->prdcr->lat, LDMSD_LAT_STORE, &start, &end);
+		if (updtr)
+			ldmsd_lat_record(updtr->lat, LDMSD_LAT_STORE, &start, &end);
 		ldmsd_strgp_unlock(strgp);
 	}
+	ldmsd_strgp_row_share_release(prd_set);
 set_ready:
 	if ((status & LDMS_UPD_F_MORE) == 0)
 		/* No more data pending move prdcr_set state UPDATING --> READY */
@@ -276,15 +299,23 @@ out:
 	if (0 == errcode && push_it) {
 		ovis_log(updtr_log, OVIS_LDEBUG, "Pushing set %p %s\n",
 			  prd_set->set, prd_set->inst_name);
+		clock_gettime(CLOCK_REALTIME, &start);
 		int rc = ldms_xprt_push(prd_set->set);
+		clock_gettime(CLOCK_REALTIME, &end);
+		ldmsd_lat_record(prd_set->prdcr->lat, LDMSD_LAT_PUSH, &start, &end);
 		if (rc) {
 			ovis_log(updtr_log, OVIS_LERROR, "Failed to push set %s\n",
 						prd_set->inst_name);
 		}
 	}
-	if (0 == (status & (LDMS_UPD_F_PUSH|LDMS_UPD_F_MORE)))
-		/* Put reference taken before calling ldms_xprt_update. */
+	if (0 == (status & (LDMS_UPD_F_PUSH|LDMS_UPD_F_MORE))) {
+		/* Put references taken before calling ldms_xprt_update. */
+		if (updtr) {
+			prd_set->updt_updtr = NULL;
+			ldmsd_updtr_put(updtr, "updt_lat");
+		}
 		ldmsd_prdcr_set_ref_put(prd_set);
+	}
 	return;
 }
 
@@ -361,6 +392,7 @@ static int schedule_set_updates(ldmsd_prdcr_set_t prd_set, ldmsd_updtr_task_t ta
 					 *
 					 * Thus, do the lookup here.
 					 */
+					clock_gettime(CLOCK_REALTIME, &pset->lookup_req_ts);
 					rc = ldms_xprt_lookup(pset->prdcr->xprt,
 							      pset->inst_name,
 							      LDMS_LOOKUP_BY_INSTANCE,
@@ -380,7 +412,13 @@ static int schedule_set_updates(ldmsd_prdcr_set_t prd_set, ldmsd_updtr_task_t ta
 			 * do not update the setgroup.
 			 */
 		} else {
+			/* Put back in update_cb to attribute the latencies */
+			prd_set->updt_updtr = ldmsd_updtr_get(updtr, "updt_lat");
 			rc = ldms_xprt_update(prd_set->set, updtr_update_cb, prd_set);
+			if (rc) {
+				prd_set->updt_updtr = NULL;
+				ldmsd_updtr_put(updtr, "updt_lat");
+			}
 		}
 	} else if (0 == (prd_set->push_flags & LDMSD_PRDCR_SET_F_PUSH_REG)) {
 		op_s = "Registering push for";
@@ -479,6 +517,7 @@ static int __setgrp_members_lookup(ldmsd_prdcr_set_t setgrp)
 			case LDMSD_PRDCR_SET_STATE_START:
 				ldmsd_prdcr_set_ref_get(pset);
 				pset->state = LDMSD_PRDCR_SET_STATE_LOOKUP;
+				clock_gettime(CLOCK_REALTIME, &pset->lookup_req_ts);
 				rc = ldms_xprt_lookup(setgrp->prdcr->xprt,
 						pset->inst_name,
 						LDMS_LOOKUP_BY_INSTANCE,
@@ -547,6 +586,8 @@ void __ldmsd_prdset_lookup_cb(ldms_t xprt, enum ldms_lookup_status status,
 	}
 	flags = ldmsd_group_check(prd_set->set);
 	clock_gettime(CLOCK_REALTIME, &prd_set->lookup_complete_ts);
+	ldmsd_lat_record(prd_set->prdcr->lat, LDMSD_LAT_LOOKUP,
+			 &prd_set->lookup_req_ts, &prd_set->lookup_complete_ts);
 	if (flags & LDMSD_GROUP_IS_GROUP) {
 		/*
 		 * Lookup the member sets
@@ -569,11 +610,66 @@ out:
 
 /* Implemented in ldmsd.c */
 extern double ts_diff_usec(struct timespec *a, struct timespec *b);
+
+/*
+ * The producer sets that are looked up with one ldms_xprt_lookup_multi()
+ * call at the end of schedule_prdcr_updates().
+ */
+struct prdset_lookup_batch {
+	int count;
+	int alloc;
+	const char **names;
+	void **args;
+};
+
+static int prdset_lookup_batch_add(struct prdset_lookup_batch *b,
+				   ldmsd_prdcr_set_t prd_set)
+{
+	if (b->count == b->alloc) {
+		int alloc = b->alloc ? 2 * b->alloc : 64;
+		const char **names = realloc(b->names, alloc * sizeof(*names));
+		if (!names)
+			return ENOMEM;
+		b->names = names;
+		void **args = realloc(b->args, alloc * sizeof(*args));
+		if (!args)
+			return ENOMEM;
+		b->args = args;
+		b->alloc = alloc;
+	}
+	b->names[b->count] = prd_set->inst_name;
+	b->args[b->count] = prd_set;
+	b->count++;
+	return 0;
+}
+
+static void prdset_lookup_error(ldmsd_prdcr_set_t prd_set, int rc)
+{
+	/* If the error is EEXIST, the set is already in the set tree. */
+	if (rc == EEXIST) {
+		ovis_log(updtr_log, OVIS_LERROR, "Prdcr '%s': "
+			"lookup failed synchronously. "
+			"The set '%s' already exists. "
+			"It is likely that there are more "
+			"than one producers pointing to "
+			"the set.\n",
+			prd_set->prdcr->obj.name,
+			prd_set->inst_name);
+	} else {
+		ovis_log(updtr_log, OVIS_LINFO, "Synchronous error "
+				"%d from ldms_lookup\n", rc);
+	}
+	prd_set->state = LDMSD_PRDCR_SET_STATE_START;
+	ldmsd_prdcr_set_ref_put(prd_set);
+}
+
 static void schedule_prdcr_updates(ldmsd_updtr_task_t task,
 				   ldmsd_prdcr_t prdcr, ldmsd_name_match_t match)
 {
 	ldmsd_updtr_t updtr = task->updtr;
 	struct timespec ts;
+	struct prdset_lookup_batch lookups = {0};
+	int i;
 	ldmsd_prdcr_lock(prdcr);
 	if (prdcr->conn_state != LDMSD_PRDCR_STATE_CONNECTED || prdcr->xprt->disconnected)
 		goto out;
@@ -614,27 +710,19 @@ static void schedule_prdcr_updates(ldmsd_updtr_task_t task,
 			/* Lookup the set */
 			prd_set->state = LDMSD_PRDCR_SET_STATE_LOOKUP;
 			assert(prd_set->set == NULL);
+			clock_gettime(CLOCK_REALTIME, &prd_set->lookup_req_ts);
+			/*
+			 * The sets are looked up together after the loop, so
+			 * that a producer that advertises many sets at once
+			 * is not sent one lookup request per set.
+			 */
+			if (0 == prdset_lookup_batch_add(&lookups, prd_set))
+				goto next_prd_set;
 			rc = ldms_xprt_lookup(prdcr->xprt, prd_set->inst_name,
 					      LDMS_LOOKUP_BY_INSTANCE,
 					      __ldmsd_prdset_lookup_cb, prd_set);
-			if (rc) {
-				/* If the error is EEXIST, the set is already in the set tree. */
-				if (rc == EEXIST) {
-					ovis_log(updtr_log, OVIS_LERROR, "Prdcr '%s': "
-						"lookup failed synchronously. "
-						"The set '%s' already exists. "
-						"It is likely that there are more "
-						"than one producers pointing to "
-						"the set.\n",
-						prd_set->prdcr->obj.name,
-						prd_set->inst_name);
-				} else {
-					ovis_log(updtr_log, OVIS_LINFO, "Synchronous error "
-							"%d from ldms_lookup\n", rc);
-				}
-				prd_set->state = LDMSD_PRDCR_SET_STATE_START;
-				ldmsd_prdcr_set_ref_put(prd_set);
-			}
+			if (rc)
+				prdset_lookup_error(prd_set, rc);
 			goto next_prd_set;
 		case LDMSD_PRDCR_SET_STATE_LOOKUP:
 			ovis_log(updtr_log, OVIS_LINFO, "%s: Set %s: "
@@ -659,8 +747,20 @@ next_prd_set:
 		else
 			prd_set = ldmsd_prdcr_set_next(prd_set);
 	}
+	if (lookups.count) {
+		int rc = ldms_xprt_lookup_multi(prdcr->xprt, lookups.count,
+						lookups.names,
+						__ldmsd_prdset_lookup_cb,
+						lookups.args);
+		if (rc) {
+			for (i = 0; i < lookups.count; i++)
+				prdset_lookup_error(lookups.args[i], rc);
+		}
+	}
 out:
 	ldmsd_prdcr_unlock(prdcr);
+	free(lookups.names);
+	free(lookups.args);
 }
 
 static void cancel_prdcr_updates(ldmsd_updtr_t updtr,
@@ -899,6 +999,7 @@ ldmsd_updtr_new_with_auth(const char *name, char *interval_str, char *offset_str
 					int push_flags, int is_auto_task,
 					uid_t uid, gid_t gid, int perm)
 {
+	extern struct rbt *cfgobj_trees[];
 	int rc;
 	struct ldmsd_updtr *updtr;
 	long interval_us = UPDTR_TREE_MGMT_TASK_INTRVL, offset_us = LDMSD_UPDT_HINT_OFFSET_NONE;
@@ -937,6 +1038,14 @@ ldmsd_updtr_new_with_auth(const char *name, char *interval_str, char *offset_str
 	LIST_INIT(&updtr->match_list);
 	rbt_init(&updtr->task_tree, ldmsd_updtr_schedule_cmp);
 	updtr->push_flags = push_flags;
+	if (ldmsd_lat_alloc(updtr->lat, LDMSD_LAT_F(LDMSD_LAT_UPDATE) |
+					LDMSD_LAT_F(LDMSD_LAT_STORE))) {
+		rbt_del(cfgobj_trees[LDMSD_CFGOBJ_UPDTR], &updtr->obj.rbn);
+		ldmsd_cfgobj_unlock(&updtr->obj);
+		ldmsd_updtr_put(updtr, "cfgobj_tree");
+		ldmsd_updtr_put(updtr, "init");
+		return NULL;
+	}
 	ldmsd_cfgobj_unlock(&updtr->obj);
 #ifdef _CFG_REF_DUMP_
 	ref_dump(&updtr->obj.ref, updtr->obj.name, stderr);
@@ -1424,6 +1533,8 @@ int ldmsd_updtr_prdcr_add(const char *updtr_name, const char *prdcr_regex,
 	ldmsd_updtr_t updtr;
 	ldmsd_prdcr_t prdcr;
 	ldmsd_name_match_t prd_match;
+	struct ldmsd_cfgobj_match_s m;
+	ldmsd_cfgobj_t obj;
 	int rc;
 
 	updtr = ldmsd_updtr_find(updtr_name);
@@ -1466,10 +1577,14 @@ int ldmsd_updtr_prdcr_add(const char *updtr_name, const char *prdcr_regex,
 	}
 
 	LIST_INSERT_HEAD(&updtr->prdcr_filter, prd_match, entry);
+	rc = ldmsd_cfgobj_match_init(&m, prdcr_regex, rep_buf, rep_len);
+	if (rc) {
+		rc = EINVAL;
+		goto unlock;
+	}
 	ldmsd_cfg_lock(LDMSD_CFGOBJ_PRDCR);
-	for (prdcr = ldmsd_prdcr_first(); prdcr; prdcr = ldmsd_prdcr_next(prdcr)) {
-		if (regexec(&prd_match->regex, prdcr->obj.name, 0, NULL, 0))
-			continue;
+	LDMSD_CFGOBJ_MATCH_FOREACH(obj, &m, LDMSD_CFGOBJ_PRDCR) {
+		prdcr = (ldmsd_prdcr_t)obj;
 		/* See if this match is already in the list */
 		ldmsd_prdcr_ref_t ref = prdcr_ref_find(updtr, prdcr->obj.name);
 		if (ref)
@@ -1480,11 +1595,13 @@ int ldmsd_updtr_prdcr_add(const char *updtr_name, const char *prdcr_regex,
 			sprintf(rep_buf, "%dMemory allocation failure.\n", ENOMEM);
 			ldmsd_prdcr_put(prdcr, "iter");
 			ldmsd_cfg_unlock(LDMSD_CFGOBJ_PRDCR);
+			ldmsd_cfgobj_match_fini(&m);
 			goto out_1;
 		}
 		rbt_ins(&updtr->prdcr_tree, &ref->rbn);
 	}
 	ldmsd_cfg_unlock(LDMSD_CFGOBJ_PRDCR);
+	ldmsd_cfgobj_match_fini(&m);
 	sprintf(rep_buf, "0\n");
 out_1:
 unlock:
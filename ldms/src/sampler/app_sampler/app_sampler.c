@@ -69,6 +69,9 @@
 #include "ldmsd.h"
 #include "ldmsd_plug_api.h"
 #include "../sampler_base.h"
+#ifdef HAVE_PROC_EVENTS
+#include "proc_events.h"
+#endif
 
 #define SAMP "app_sampler"
 
@@ -446,6 +449,9 @@ struct app_sampler_inst_s {
 
 	char *stream_name;
 	ldms_msg_client_t stream;
+#ifdef HAVE_PROC_EVENTS
+	proc_ev_client_t proc_ev; /* retires sets on process exit */
+#endif
 
 	handler_fn_t fn[16];
 	int n_fn;
@@ -1260,10 +1266,14 @@ char *_help = "\
 app_sampler config synopsis: \n\
     config name=app_sampler [COMMON_OPTIONS] [stream=STREAM]\n\
                             [metrics=METRICS] [cfg_file=FILE]\n\
+                            [proc_events=1]\n\
 \n\
 Option descriptions:\n\
     stream    The name of the `ldms_msg` to listen for SLURM job events.\n\
               (default: slurm).\n\
+    proc_events=1 Retire a task set as soon as the kernel proc connector\n\
+              reports the task exited, instead of waiting for the\n\
+              task_exit event (requires CAP_NET_ADMIN).\n\
     metrics   The comma-separated list of metrics to monitor.\n\
               The default is "" (empty), which is equivalent to monitor ALL\n\
               metrics.\n\
@@ -1454,20 +1464,12 @@ int __handle_task_init(app_sampler_inst_t inst, json_entity_t data)
 	return 0;
 }
 
-int __handle_task_exit(app_sampler_inst_t inst, json_entity_t data)
+static int __task_exit(app_sampler_inst_t inst, uint64_t task_pid)
 {
 	struct rbn *rbn;
 	struct app_sampler_set *app_set;
-	json_entity_t job_id;
-	json_entity_t task_pid;
-	job_id = json_value_find(data, "job_id");
-	if (!job_id || job_id->type != JSON_INT_VALUE)
-		return EINVAL;
-	task_pid = json_value_find(data, "task_pid");
-	if (!task_pid || task_pid->type != JSON_INT_VALUE)
-		return EINVAL;
 	pthread_mutex_lock(&inst->mutex);
-	rbn = rbt_find(&inst->set_rbt, (void*)task_pid->value.int_);
+	rbn = rbt_find(&inst->set_rbt, (void*)task_pid);
 	if (!rbn) {
 		pthread_mutex_unlock(&inst->mutex);
 		return ENOENT;
@@ -1483,6 +1485,32 @@ int __handle_task_exit(app_sampler_inst_t inst, json_entity_t data)
 	return 0;
 }
 
+int __handle_task_exit(app_sampler_inst_t inst, json_entity_t data)
+{
+	json_entity_t job_id;
+	json_entity_t task_pid;
+	job_id = json_value_find(data, "job_id");
+	if (!job_id || job_id->type != JSON_INT_VALUE)
+		return EINVAL;
+	task_pid = json_value_find(data, "task_pid");
+	if (!task_pid || task_pid->type != JSON_INT_VALUE)
+		return EINVAL;
+	return __task_exit(inst, task_pid->value.int_);
+}
+
+#ifdef HAVE_PROC_EVENTS
+static void __proc_ev_cb(const struct proc_ev *ev, void *arg)
+{
+	app_sampler_inst_t inst = arg;
+	if (ev->type == PROC_EV_OVERRUN) {
+		INST_LOG(inst, OVIS_LWARNING, "process events were lost.\n");
+		return;
+	}
+	if (ev->type == PROC_EV_EXIT && ev->pid == ev->tgid)
+		(void)__task_exit(inst, ev->pid);
+}
+#endif
+
 int __stream_cb(ldms_msg_event_t ev, void *ctxt)
 {
 	app_sampler_inst_t inst = ctxt;
@@ -1625,6 +1653,24 @@ app_sampler_config(ldmsd_plug_handle_t pi, struct attr_value_list *kwl,
 		goto err;
 	}
 
+	val = av_value(avl, "proc_events");
+	if (val && atoi(val)) {
+#ifdef HAVE_PROC_EVENTS
+		inst->proc_ev = proc_ev_subscribe(PROC_EV_EXIT, __proc_ev_cb, inst);
+		if (!inst->proc_ev) {
+			rc = errno;
+			INST_LOG(inst, OVIS_LERROR,
+				 "Error subscribing to process events: %d", rc);
+			goto err;
+		}
+#else
+		INST_LOG(inst, OVIS_LERROR,
+			 "proc_events=1 is not supported by this build.");
+		rc = ENOTSUP;
+		goto err;
+#endif
+	}
+
 	return 0;
 
  err:
@@ -1702,6 +1748,10 @@ static void destructor(ldmsd_plug_handle_t handle)
 	struct rbn *rbn;
 	struct app_sampler_set *app_set;
 
+#ifdef HAVE_PROC_EVENTS
+	if (inst->proc_ev)
+		proc_ev_unsubscribe(inst->proc_ev);
+#endif
 	if (inst->stream)
 		ldms_msg_client_close(inst->stream);
 	pthread_mutex_lock(&inst->mutex);
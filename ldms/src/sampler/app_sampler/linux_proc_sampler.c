@@ -71,7 +71,11 @@
 #include "ldmsd.h"
 #include "ldmsd_plug_api.h"
 #include "../sampler_base.h"
+#include "proc_pread.h"
 #include "mmalloc.h"
+#ifdef HAVE_PROC_EVENTS
+#include "proc_events.h"
+#endif
 #define DSTRING_USE_SHORT
 #include "ovis_util/dstring.h"
 #include "ovis_json/ovis_json.h"
@@ -449,6 +453,30 @@ struct set_key {
 	int64_t os_pid;
 };
 
+/* /proc/<PID>/ files kept open for the life of a set and re-read with pread */
+enum pid_file_e {
+	PF_STAT,
+	PF_STATUS,
+	PF_IO,
+	PF_SYSCALL,
+	PF_OOM_SCORE,
+	PF_OOM_SCORE_ADJ,
+	PF_TIMERSLACK_NS,
+	PF_WCHAN,
+	_PF_LAST
+};
+
+static const char *pid_file_name[_PF_LAST] = {
+	[PF_STAT] = "stat",
+	[PF_STATUS] = "status",
+	[PF_IO] = "io",
+	[PF_SYSCALL] = "syscall",
+	[PF_OOM_SCORE] = "oom_score",
+	[PF_OOM_SCORE_ADJ] = "oom_score_adj",
+	[PF_TIMERSLACK_NS] = "timerslack_ns",
+	[PF_WCHAN] = "wchan",
+};
+
 struct linux_proc_sampler_set {
 	struct set_key key;
 	ldms_set_t set;
@@ -459,6 +487,7 @@ struct linux_proc_sampler_set {
 	char *fd_ident; /* json prefix for all file messages */
 	size_t fd_ident_sz; /* json prefix for all file messages */
 	struct rbt fn_rbt; /* tree for fd numbers of this process */
+	int pfd[_PF_LAST]; /* cached /proc/<PID>/ file descriptors, -1 if closed */
 	LIST_ENTRY(linux_proc_sampler_set) del;
 };
 LIST_HEAD(set_del_list, linux_proc_sampler_set);
@@ -483,11 +512,18 @@ struct linux_proc_sampler_inst_s {
 	int fd_msg; /* N for rescan fd every n-th sample */
 	bool fd_use_regex; /* match object is ready */
 	regex_t fd_regex; /* match object for fd_exclude */
+	bool proc_events; /* track exec/exit from the kernel proc connector */
+	bool exe_use_regex; /* match object is ready */
+	regex_t exe_regex; /* match object for proc_exe */
+#ifdef HAVE_PROC_EVENTS
+	proc_ev_client_t proc_ev;
+#endif
 	long sc_clk_tck;
 	struct timeval sample_start;
 
 	struct rbt set_rbt;
 	pthread_mutex_t mutex;
+	struct linux_proc_sampler_set *sample_set; /* set being sampled */
 
 	char *stream_name;
 	char *published_pid_dir;
@@ -496,6 +532,8 @@ struct linux_proc_sampler_inst_s {
 	char *fd_stream;
 	char *recycle_buf;
 	size_t recycle_buf_sz;
+	char *status_buf; /* /proc/<pid>/status */
+	size_t status_buf_sz;
 	ldms_msg_client_t stream;
 	int log_send;
 	char *argv_sep;
@@ -581,17 +619,69 @@ static int __read_str(ldms_set_t set, int idx, const char *path, int max_len)
 	return rlen;
 }
 
-/* like `__read_str()`, but also '\0'-terminate the string */
-static int __read_str0(ldms_set_t set, int idx, const char *path, int max_len)
+/*
+ * Get the descriptor of /proc/<pid>/<pf>. While sampling, the file is opened
+ * on first use and kept in the set so subsequent samples cost a single
+ * pread(). Release it with pid_file_put(). Returns the fd, or -errno.
+ */
+static int pid_file_get(linux_proc_sampler_inst_t inst, pid_t pid,
+			enum pid_file_e pf)
 {
-	ldms_mval_t str = ldms_metric_get(set, idx);
-	int rlen = __read_str(set, idx, path, max_len);
-	if (rlen == max_len)
-		rlen = max_len - 1;
-	str->a_char[rlen] = '\0';
+	char path[PROCPID_SZ];
+	struct linux_proc_sampler_set *as = inst->sample_set;
+	int fd;
+
+	if (as && as->key.os_pid == pid && as->pfd[pf] >= 0)
+		return as->pfd[pf];
+	snprintf(path, sizeof(path), "/proc/%d/%s", pid, pid_file_name[pf]);
+	fd = open(path, O_RDONLY|O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+	if (as && as->key.os_pid == pid)
+		as->pfd[pf] = fd;
+	return fd;
+}
+
+static void pid_file_put(linux_proc_sampler_inst_t inst, pid_t pid, int fd)
+{
+	struct linux_proc_sampler_set *as = inst->sample_set;
+	if (!as || as->key.os_pid != pid)
+		close(fd);
+}
+
+/*
+ * Read /proc/<pid>/<pf> into `buf` and '\0'-terminate it. Returns the number
+ * of bytes read, or -errno. Only for the files with a bounded length; the
+ * rest is cut off at `sz` - 1 bytes.
+ */
+static ssize_t pid_file_read(linux_proc_sampler_inst_t inst, pid_t pid,
+			     enum pid_file_e pf, char *buf, size_t sz)
+{
+	ssize_t rlen;
+	int fd;
+
+	fd = pid_file_get(inst, pid, pf);
+	if (fd < 0)
+		return fd;
+	rlen = pread(fd, buf, sz - 1, 0);
+	if (rlen < 0)
+		rlen = -errno;
+	else
+		buf[rlen] = '\0';
+	pid_file_put(inst, pid, fd);
 	return rlen;
 }
 
+static void pid_files_close(struct linux_proc_sampler_set *as)
+{
+	int i;
+	for (i = 0; i < _PF_LAST; i++) {
+		if (as->pfd[i] >= 0)
+			close(as->pfd[i]);
+		as->pfd[i] = -1;
+	}
+}
+
 /* Convenient functions that set `set[midx] = val` if midx > 0 */
 static inline void __may_set_u64(ldms_set_t set, int midx, uint64_t val)
 {
@@ -722,14 +812,14 @@ static int n_open_files_handler(linux_proc_sampler_inst_t inst, pid_t pid,
 static int io_handler(linux_proc_sampler_inst_t inst, pid_t pid, ldms_set_t set)
 {
 	/* populate io_* */
-	char path[PROCPID_SZ];
+	char buff[PROCPID_SZ * 4];
 	uint64_t val[7];
-	int n, rc;
-	snprintf(path, sizeof(path), "/proc/%d/io", pid);
-	FILE *f = fopen(path, "r");
-	if (!f)
-		return errno;
-	n = fscanf(f,   "rchar: %lu\n"
+	ssize_t rlen;
+	int n;
+	rlen = pid_file_read(inst, pid, PF_IO, buff, sizeof(buff));
+	if (rlen < 0)
+		return -rlen;
+	n = sscanf(buff, "rchar: %lu\n"
 			"wchar: %lu\n"
 			"syscr: %lu\n"
 			"syscw: %lu\n"
@@ -737,10 +827,8 @@ static int io_handler(linux_proc_sampler_inst_t inst, pid_t pid, ldms_set_t set)
 			"write_bytes: %lu\n"
 			"cancelled_write_bytes: %lu\n",
 			val+0, val+1, val+2, val+3, val+4, val+5, val+6);
-	if (n != 7) {
-		rc = EINVAL;
-		goto out;
-	}
+	if (n != 7)
+		return EINVAL;
 	__may_set_u64(set, inst->metric_idx[APP_IO_READ_B]	   , val[0]);
 	__may_set_u64(set, inst->metric_idx[APP_IO_WRITE_B]	  , val[1]);
 	__may_set_u64(set, inst->metric_idx[APP_IO_N_READ]	   , val[2]);
@@ -748,25 +836,21 @@ static int io_handler(linux_proc_sampler_inst_t inst, pid_t pid, ldms_set_t set)
 	__may_set_u64(set, inst->metric_idx[APP_IO_READ_DEV_B]       , val[4]);
 	__may_set_u64(set, inst->metric_idx[APP_IO_WRITE_DEV_B]      , val[5]);
 	__may_set_u64(set, inst->metric_idx[APP_IO_WRITE_CANCELLED_B], val[6]);
-	rc = 0;
- out:
-	fclose(f);
-	return rc;
+	return 0;
 }
 
 static int oom_score_handler(linux_proc_sampler_inst_t inst, pid_t pid, ldms_set_t set)
 {
 	/* according to `proc_oom_score()` in Linux kernel src tree, oom_score
 	 * is `unsigned long` */
-	char path[PROCPID_SZ];
+	char buff[32];
 	uint64_t x;
+	ssize_t rlen;
 	int n;
-	snprintf(path, sizeof(path), "/proc/%d/oom_score", pid);
-	FILE *f = fopen(path, "r");
-	if (!f)
-		return errno;
-	n = fscanf(f, "%lu", &x);
-	fclose(f);
+	rlen = pid_file_read(inst, pid, PF_OOM_SCORE, buff, sizeof(buff));
+	if (rlen < 0)
+		return -rlen;
+	n = sscanf(buff, "%lu", &x);
 	if (n != 1)
 		return EINVAL;
 	ldms_metric_set_u64(set, inst->metric_idx[APP_OOM_SCORE], x);
@@ -777,15 +861,14 @@ static int oom_score_adj_handler(linux_proc_sampler_inst_t inst, pid_t pid, ldms
 {
 	/* according to `proc_oom_score_adj_read()` in Linux kernel src tree,
 	 * oom_score_adj is `short` */
-	char path[PROCPID_SZ];
+	char buff[32];
 	int x;
+	ssize_t rlen;
 	int n;
-	snprintf(path, sizeof(path), "/proc/%d/oom_score_adj", pid);
-	FILE *f = fopen(path, "r");
-	if (!f)
-		return errno;
-	n = fscanf(f, "%d", &x);
-	fclose(f);
+	rlen = pid_file_read(inst, pid, PF_OOM_SCORE_ADJ, buff, sizeof(buff));
+	if (rlen < 0)
+		return -rlen;
+	n = sscanf(buff, "%d", &x);
 	if (n != 1)
 		return EINVAL;
 	ldms_metric_set_s64(set, inst->metric_idx[APP_OOM_SCORE_ADJ], x);
@@ -821,24 +904,16 @@ static int stat_handler(linux_proc_sampler_inst_t inst, pid_t pid, ldms_set_t se
 	char state;
 	pid_t _pid;
 	linux_proc_sampler_metric_e code;
-	FILE *f;
-	snprintf(buff, sizeof(buff), "/proc/%d/stat", pid);
-	f = fopen(buff, "r");
-	if (!f)
-		return errno;
-	char *s;
-	errno = 0;
-	s = fgets(buff, sizeof(buff), f);
-	fclose(f);
-	str = buff;
-	if (s != buff) {
-		if (errno) {
-			INST_LOG(inst, OVIS_LDEBUG,
-				"error reading /proc/%d/stat %s\n", pid, STRERROR(errno));
-			return errno;
-		}
-		return EINVAL;
+	ssize_t rlen;
+	rlen = pid_file_read(inst, pid, PF_STAT, buff, sizeof(buff));
+	if (rlen < 0) {
+		INST_LOG(inst, OVIS_LDEBUG,
+			"error reading /proc/%d/stat %s\n", pid, STRERROR(-rlen));
+		return -rlen;
 	}
+	if (rlen == 0)
+		return EINVAL;
+	str = buff;
 	n = sscanf(str, "%d (%[^)]) %c%n", &_pid, name, &state, &off);
 	if (n != 3)
 		return EINVAL;
@@ -989,24 +1064,31 @@ struct status_line_handler_s status_line_tbl[] = {
 
 static int status_handler(linux_proc_sampler_inst_t inst, pid_t pid, ldms_set_t set)
 {
-	char buff[CMDLINE_SZ];
-	FILE *f;
-	char *line, *key, *ptr;
+	char *line, *key, *ptr, *lptr;
 	status_line_handler_t sh;
+	ssize_t rlen;
+	int fd;
 
-	snprintf(buff, sizeof(buff), "/proc/%d/status", pid);
-	f = fopen(buff, "r");
-	if (!f)
-		return errno;
-	while ((line = fgets(buff, sizeof(buff), f))) {
+	/* status grows with the number of CPUs and NUMA nodes (Cpus_allowed,
+	 * Mems_allowed), so it is read into a buffer that grows to fit */
+	fd = pid_file_get(inst, pid, PF_STATUS);
+	if (fd < 0)
+		return -fd;
+	rlen = proc_pread(fd, &inst->status_buf, &inst->status_buf_sz);
+	pid_file_put(inst, pid, fd);
+	if (rlen < 0)
+		return -rlen;
+	for (line = strtok_r(inst->status_buf, "\n", &lptr); line;
+			line = strtok_r(NULL, "\n", &lptr)) {
 		key = strtok_r(line, ":", &ptr);
+		if (!key || !ptr)
+			continue;
 		sh = find_status_line_handler(key);
 		if (!sh)
 			continue;
 		while (isspace(*ptr)) {
 			ptr++;
 		}
-		ptr[strlen(ptr)-1] = '\0'; /* eliminate trailing space */
 		if (inst->metric_idx[sh->code] > 0
 			|| sh->code == APP_STATUS_SIG_QUEUED
 			|| sh->code == APP_STATUS_UID
@@ -1015,7 +1097,6 @@ static int status_handler(linux_proc_sampler_inst_t inst, pid_t pid, ldms_set_t
 			sh->fn(inst, set, ptr, sh->code);
 		}
 	}
-	fclose(f);
 	return 0;
 }
 
@@ -1409,11 +1490,9 @@ err:
 static int syscall_handler(linux_proc_sampler_inst_t inst, pid_t pid, ldms_set_t set)
 {
 	char buff[CMDLINE_SZ];
-	FILE *f;
-	char *ret;
+	ssize_t rlen;
 	int i, n;
 	uint64_t val[9] = {0};
-	snprintf(buff, sizeof(buff), "/proc/%d/syscall", pid);
 	/*
 	 * NOTE: The file contains single line wcich could be:
 	 * - "running": the process is running.
@@ -1422,14 +1501,10 @@ static int syscall_handler(linux_proc_sampler_inst_t inst, pid_t pid, ldms_set_t
 	 * - "<SYSCALL_NUM> <ARG0> ... <ARG5> <STACK_PTR> <PROGRAM_CTR>": the
 	 *   syscall number, 6 arguments, stack pointer and program counter.
 	 */
-	f = fopen(buff, "r");
-	if (!f)
-		return errno;
-	ret = fgets(buff, sizeof(buff), f);
-	fclose(f);
+	rlen = pid_file_read(inst, pid, PF_SYSCALL, buff, sizeof(buff));
 	int call = -1;
-	if (!ret)
-		return errno;
+	if (rlen < 0)
+		return -rlen;
 	if (0 == strncmp(buff, "running", 7)) {
 		n = 0;
 	} else {
@@ -1478,19 +1553,18 @@ static int syscall_handler(linux_proc_sampler_inst_t inst, pid_t pid, ldms_set_t
 
 static int timerslack_ns_handler(linux_proc_sampler_inst_t inst, pid_t pid, ldms_set_t set)
 {
-	char path[PROCPID_SZ];
+	char buff[32];
 	uint64_t x;
+	ssize_t rlen;
 	int n;
-	snprintf(path, sizeof(path), "/proc/%d/timerslack_ns", pid);
-	FILE *f = fopen(path, "r");
-	if (!f && errno != ENOENT)
-		return errno;
-	if (!f) {
+	rlen = pid_file_read(inst, pid, PF_TIMERSLACK_NS, buff, sizeof(buff));
+	if (rlen == -ENOENT) {
 		ldms_metric_set_u64(set, inst->metric_idx[APP_TIMERSLACK_NS], 0);
 		return 0;
 	}
-	n = fscanf(f, "%lu", &x);
-	fclose(f);
+	if (rlen < 0)
+		return -rlen;
+	n = sscanf(buff, "%lu", &x);
 	if (n != 1)
 		return EINVAL;
 	ldms_metric_set_u64(set, inst->metric_idx[APP_TIMERSLACK_NS], x);
@@ -1499,9 +1573,12 @@ static int timerslack_ns_handler(linux_proc_sampler_inst_t inst, pid_t pid, ldms
 
 static int wchan_handler(linux_proc_sampler_inst_t inst, pid_t pid, ldms_set_t set)
 {
-	char path[PROCPID_SZ];
-	snprintf(path, sizeof(path), "/proc/%d/wchan", pid);
-	__read_str0(set, inst->metric_idx[APP_WCHAN], path, WCHAN_SZ);
+	char buff[WCHAN_SZ];
+	ssize_t rlen;
+	rlen = pid_file_read(inst, pid, PF_WCHAN, buff, sizeof(buff));
+	if (rlen < 0)
+		buff[0] = '\0';
+	ldms_metric_array_set_str(set, inst->metric_idx[APP_WCHAN], buff);
 	return 0;
 }
 
@@ -1613,6 +1690,7 @@ void app_set_destroy(linux_proc_sampler_inst_t inst, struct linux_proc_sampler_s
 	a->key.os_pid = 0;
 	free(a->fd_ident);
 	fn_rbt_destroy(inst, &a->fn_rbt);
+	pid_files_close(a);
 	free(a);
 }
 
@@ -1638,6 +1716,7 @@ static int linux_proc_sampler_sample(ldmsd_plug_handle_t handle)
 		}
 		ldms_transaction_begin(app_set->set);
 		gettimeofday(&inst->sample_start, NULL);
+		inst->sample_set = app_set;
 		for (i = 0; i < inst->n_fn; i++) {
 			rc = inst->fn[i].fn(inst, app_set->key.os_pid, app_set->set);
 			if (rc) {
@@ -1657,6 +1736,7 @@ static int linux_proc_sampler_sample(ldmsd_plug_handle_t handle)
 				break;
 			}
 		}
+		inst->sample_set = NULL;
 		app_set->fd_skip++;
 		if (!app_set->dead && inst->fd_msg &&
 			(app_set->fd_skip % inst->fd_msg == 0)) {
@@ -1703,6 +1783,7 @@ linux_proc_sampler config synopsis: \n\
 	    [sc_clk_tck=1] [metrics=METRICS] [cfg_file=FILE] [exe_suffix=1]\n\
             [env_msg=1] [argv_msg=1] [argv_fmt=<1,2>] [env_exclude=EFILE]\n\
             [fd_msg=N] [fd_exclude=EFILE] [published_pid_dir=PDIR]\n\
+            [proc_events=1] [proc_exe=REGEX]\n\
 \n\
 Option descriptions:\n\
     instance_prefix    The prefix for generated instance names. Typically a cluster name\n\
@@ -1725,6 +1806,12 @@ Option descriptions:\n\
     fd_msg=N  Enable /proc/$pid/fd detail reporting every N-th sample\n\
     fd_exclude Name of a file with 1 regular expression per line.\n\
     published_pid_dir Name of a directory of interesting pids\n\
+    proc_events=1 Also follow process exec/exit events from the kernel\n\
+              proc connector (requires CAP_NET_ADMIN). Sets are retired\n\
+              as soon as their process exits.\n\
+    proc_exe  With proc_events=1, create a set when a process whose\n\
+              executable path matches REGEX calls exec. Children of\n\
+              processes that already have a set are tracked regardless.\n\
     cfg_file  The alternative config file in JSON format. The file is\n\
 	      expected to have an object that contains the following \n\
 	      attributes:\n\
@@ -2053,6 +2140,29 @@ int __handle_cfg_file(linux_proc_sampler_inst_t inst, char *val)
 	if (ent) {
 		inst->exe_suffix = 1;
 	}
+	ent = json_value_find(jdoc, "proc_events");
+	if (ent) {
+		if (ent->type != JSON_INT_VALUE) {
+			rc = EINVAL;
+			INST_LOG(inst, OVIS_LERROR,
+				"Error: `proc_events` must be 1 or 0.\n");
+			goto out;
+		}
+		inst->proc_events = (json_value_int(ent) != 0);
+	}
+	ent = json_value_find(jdoc, "proc_exe");
+	if (ent) {
+		if (ent->type != JSON_STRING_VALUE) {
+			rc = EINVAL;
+			INST_LOG(inst, OVIS_LERROR,
+				"Error: `proc_exe` must be a string.\n");
+			goto out;
+		}
+		rc = init_regex_filter(inst, (char *)json_value_cstr(ent), "exe",
+			&inst->exe_use_regex, &inst->exe_regex);
+		if (rc)
+			goto out;
+	}
 	ent = json_value_find(jdoc, "sc_clk_tck");
 	if (ent) {
 		inst->sc_clk_tck = sysconf(_SC_CLK_TCK);
@@ -2323,11 +2433,14 @@ static json_entity_t get_field(linux_proc_sampler_inst_t inst, json_entity_t src
 
 static uint64_t get_start_tick(linux_proc_sampler_inst_t inst, json_entity_t data, int64_t pid)
 {
-	if (!inst || !data)
+	if (!inst)
 		return 0;
-	uint64_t start_tick = get_field_value_u64(inst, data, JSON_STRING_VALUE, "start_tick");
-	if (start_tick)
-		return start_tick;
+	if (data) {
+		uint64_t start_tick = get_field_value_u64(inst, data,
+						JSON_STRING_VALUE, "start_tick");
+		if (start_tick)
+			return start_tick;
+	}
 	char path[PATH_MAX];
 	char buf[STAT_COMM_SZ];
 	snprintf(path, sizeof(path), "/proc/%" PRId64 "/stat", pid);
@@ -3185,64 +3298,20 @@ static int publish_fd_pid_first(linux_proc_sampler_inst_t inst, struct linux_pro
  * If given, *pid_bad will be updated to indicate if process
  * is not trackable for any reason.
  */
+/*
+ * Create, publish and track the set for `pid`. `start` and `exe` may be NULL,
+ * in which case they are derived from `start_tick` and /proc/<pid>/exe.
+ */
 static
-int __handle_task_init(linux_proc_sampler_inst_t inst, json_entity_t data, int *pid_bad)
+int __task_init(linux_proc_sampler_inst_t inst, pid_t pid, uint64_t job_id_val,
+		int64_t task_rank_val, uint64_t start_tick, const char *start,
+		const char *exe, bool is_thread_val, pid_t parent, int *pid_bad)
 {
-	/* create a set per task; deduplicate if multiple spank and linux proc sources
-	 * are both active. */
 	struct linux_proc_sampler_set *app_set;
 	int rc;
 	ldms_set_t set;
 	int len;
-	jbuf_t bjb = NULL;
-	json_entity_t os_pid;
-	json_entity_t task_pid;
-	json_entity_t task_rank;
-	json_entity_t exe;
-	json_entity_t is_thread;
-	json_entity_t parent_pid;
-	json_entity_t start;
 	char setname[512];
-	exe = get_field(inst, data, JSON_STRING_VALUE, "exe");
-	start = get_field(inst, data, JSON_STRING_VALUE, "start");
-	errno = 0;
-	bool job_id = true;
-	uint64_t job_id_val =
-		get_field_value_u64(inst, data, JSON_NULL_VALUE, "job_id");
-	if (errno)
-		job_id = false;
-	os_pid = get_field(inst, data, JSON_INT_VALUE, "os_pid");
-	task_pid = get_field(inst, data, JSON_INT_VALUE, "task_pid");
-	parent_pid = get_field(inst, data, JSON_INT_VALUE, "parent_pid");
-	is_thread = get_field(inst, data, JSON_INT_VALUE, "is_thread");
-	if (pid_bad)
-		*pid_bad = 0;
-	if (!job_id && (!os_pid && !task_pid)) {
-		INST_LOG(inst, OVIS_LINFO, "need job_id or (os_pid & task_pid)\n");
-		goto dump;
-	}
-	pid_t  pid;
-	if (os_pid)
-		pid = (pid_t)json_value_int(os_pid);
-	else
-		pid = json_value_int(task_pid); /* from spank plugin */
-
-	bool is_thread_val = false;
-	pid_t parent = 0;
-	if (is_thread && parent_pid) {
-		is_thread_val = json_value_int(is_thread);
-		parent = json_value_int(parent_pid);
-	} else {
-		parent = get_parent_pid(pid, &is_thread_val);
-	}
-	uint64_t start_tick = get_start_tick(inst, data, pid);
-	if (!start_tick) { /* process disappeared before here */
-		if (pid_bad)
-			*pid_bad = 1;
-		INST_LOG(inst, OVIS_LDEBUG, "ignoring start-tickless pid %"
-			PRId32 "\n", pid);
-		return 0;
-	}
 	const char *start_string;
 	char start_string_buf[32];
 	if (!start) {
@@ -3253,7 +3322,7 @@ int __handle_task_init(linux_proc_sampler_inst_t inst, json_entity_t data, int *
 			tv.tv_sec, tv.tv_usec);
 		start_string = start_string_buf;
 	} else {
-		start_string = json_value_cstr(start);
+		start_string = start;
 	}
 	const char *exe_string;
 	char exe_buf[CMDLINE_SZ];
@@ -3261,12 +3330,7 @@ int __handle_task_init(linux_proc_sampler_inst_t inst, json_entity_t data, int *
 		proc_exe_buf(pid, exe_buf, sizeof(exe_buf));
 		exe_string = exe_buf;
 	} else {
-		exe_string = json_value_cstr(exe);
-	}
-	int64_t task_rank_val = -1;
-	task_rank = get_field(inst, data, JSON_INT_VALUE, "task_global_id");
-	if (task_rank) {
-		task_rank_val = json_value_int(task_rank);
+		exe_string = exe;
 	}
 /* set instance is $iprefix/$producer/$jobid/$start_time/$os_pid
  * unless it came from spank with task_global_id set, in which case it is.
@@ -3329,6 +3393,8 @@ int __handle_task_init(linux_proc_sampler_inst_t inst, json_entity_t data, int *
 	app_set = calloc(1, sizeof(*app_set));
 	if (!app_set)
 		return ENOMEM;
+	for (len = 0; len < _PF_LAST; len++)
+		app_set->pfd[len] = -1;
 	app_set->task_rank = task_rank_val;
 	data_set_key(inst, app_set, start_tick, pid);
 
@@ -3491,6 +3557,70 @@ else {
 	}
 	pthread_mutex_unlock(&inst->mutex);
 	return 0;
+}
+
+static
+int __handle_task_init(linux_proc_sampler_inst_t inst, json_entity_t data, int *pid_bad)
+{
+	/* create a set per task; deduplicate if multiple spank and linux proc sources
+	 * are both active. */
+	jbuf_t bjb = NULL;
+	json_entity_t os_pid;
+	json_entity_t task_pid;
+	json_entity_t task_rank;
+	json_entity_t exe;
+	json_entity_t is_thread;
+	json_entity_t parent_pid;
+	json_entity_t start;
+	exe = get_field(inst, data, JSON_STRING_VALUE, "exe");
+	start = get_field(inst, data, JSON_STRING_VALUE, "start");
+	errno = 0;
+	bool job_id = true;
+	uint64_t job_id_val =
+		get_field_value_u64(inst, data, JSON_NULL_VALUE, "job_id");
+	if (errno)
+		job_id = false;
+	os_pid = get_field(inst, data, JSON_INT_VALUE, "os_pid");
+	task_pid = get_field(inst, data, JSON_INT_VALUE, "task_pid");
+	parent_pid = get_field(inst, data, JSON_INT_VALUE, "parent_pid");
+	is_thread = get_field(inst, data, JSON_INT_VALUE, "is_thread");
+	if (pid_bad)
+		*pid_bad = 0;
+	if (!job_id && (!os_pid && !task_pid)) {
+		INST_LOG(inst, OVIS_LINFO, "need job_id or (os_pid & task_pid)\n");
+		goto dump;
+	}
+	pid_t  pid;
+	if (os_pid)
+		pid = (pid_t)json_value_int(os_pid);
+	else
+		pid = json_value_int(task_pid); /* from spank plugin */
+
+	bool is_thread_val = false;
+	pid_t parent = 0;
+	if (is_thread && parent_pid) {
+		is_thread_val = json_value_int(is_thread);
+		parent = json_value_int(parent_pid);
+	} else {
+		parent = get_parent_pid(pid, &is_thread_val);
+	}
+	uint64_t start_tick = get_start_tick(inst, data, pid);
+	if (!start_tick) { /* process disappeared before here */
+		if (pid_bad)
+			*pid_bad = 1;
+		INST_LOG(inst, OVIS_LDEBUG, "ignoring start-tickless pid %"
+			PRId32 "\n", pid);
+		return 0;
+	}
+	int64_t task_rank_val = -1;
+	task_rank = get_field(inst, data, JSON_INT_VALUE, "task_global_id");
+	if (task_rank) {
+		task_rank_val = json_value_int(task_rank);
+	}
+	return __task_init(inst, pid, job_id_val, task_rank_val, start_tick,
+			   start ? json_value_cstr(start) : NULL,
+			   exe ? json_value_cstr(exe) : NULL,
+			   is_thread_val, parent, pid_bad);
 dump:
 	if (pid_bad)
 		*pid_bad = 1;
@@ -3551,10 +3681,10 @@ int get_rbn_from_pid(struct rbn *rbn, void *key, int level)
 	return 0;
 }
 
+static int __task_exit(linux_proc_sampler_inst_t inst, pid_t pid, uint64_t start_tick);
+
 int __handle_task_exit(linux_proc_sampler_inst_t inst, json_entity_t data)
 {
-	struct rbn *rbn;
-	struct linux_proc_sampler_set *app_set;
 	json_entity_t os_pid;
 	os_pid = get_field(inst, data, JSON_INT_VALUE, "os_pid");
 	pid_t pid;
@@ -3566,7 +3696,17 @@ int __handle_task_exit(linux_proc_sampler_inst_t inst, json_entity_t data)
 	} else {
 		pid = (pid_t)json_value_int(os_pid);
 	}
-	uint64_t start_tick = get_start_tick(inst, data, pid);
+	return __task_exit(inst, pid, get_start_tick(inst, data, pid));
+}
+
+/*
+ * Retire the set of `pid`. If `start_tick` is 0 (e.g. /proc/<pid> is already
+ * gone), the set is found by pid only.
+ */
+static int __task_exit(linux_proc_sampler_inst_t inst, pid_t pid, uint64_t start_tick)
+{
+	struct rbn *rbn;
+	struct linux_proc_sampler_set *app_set;
 	/* lock the tree and find the delete target. If no start_tick available,
 	search on pid only. */
 	struct linux_proc_sampler_set app_set_search;
@@ -3651,6 +3791,72 @@ static int __stream_cb(ldms_msg_event_t ev, void *ctxt)
 	return rc;
 }
 
+#ifdef HAVE_PROC_EVENTS
+/* Find the job_id of the set tracking `pid`, if any. */
+static int __tracked_job_id(linux_proc_sampler_inst_t inst, pid_t pid,
+			    uint64_t *job_id)
+{
+	struct pid_search ps = { pid, NULL };
+	struct linux_proc_sampler_set *app_set;
+	int found = 0;
+
+	pthread_mutex_lock(&inst->mutex);
+	(void)rbt_traverse(&inst->set_rbt, get_rbn_from_pid, (void*)&ps);
+	if (ps.rbn) {
+		app_set = container_of(ps.rbn, struct linux_proc_sampler_set, rbn);
+		*job_id = ldms_metric_get_u64(app_set->set, BASE_JOB_ID);
+		found = 1;
+	}
+	pthread_mutex_unlock(&inst->mutex);
+	return found;
+}
+
+static void __proc_ev_exec(linux_proc_sampler_inst_t inst, pid_t pid)
+{
+	char exe[CMDLINE_SZ];
+	uint64_t job_id = 0;
+	uint64_t start_tick;
+	bool is_thread = false;
+	pid_t parent;
+	int tracked;
+
+	parent = get_parent_pid(pid, &is_thread);
+	tracked = parent > 0 && __tracked_job_id(inst, parent, &job_id);
+	if (!tracked && !inst->exe_use_regex)
+		return;
+	proc_exe_buf(pid, exe, sizeof(exe));
+	if (!tracked && regexec(&inst->exe_regex, exe, 0, NULL, 0))
+		return;
+	start_tick = get_start_tick(inst, NULL, pid);
+	if (!start_tick)
+		return; /* already gone */
+	(void)__task_init(inst, pid, job_id, -1, start_tick, NULL, exe,
+			  is_thread, parent, NULL);
+}
+
+static void __proc_ev_cb(const struct proc_ev *ev, void *arg)
+{
+	linux_proc_sampler_inst_t inst = arg;
+
+	switch (ev->type) {
+	case PROC_EV_EXEC:
+		__proc_ev_exec(inst, ev->tgid);
+		break;
+	case PROC_EV_EXIT:
+		if (ev->pid != ev->tgid)
+			break; /* a thread other than the main one */
+		(void)__task_exit(inst, ev->pid, get_start_tick(inst, NULL, ev->pid));
+		break;
+	case PROC_EV_OVERRUN:
+		INST_LOG(inst, OVIS_LWARNING, "process events were lost; "
+			 "exited processes are retired at the next sample.\n");
+		break;
+	default:
+		break;
+	}
+}
+#endif
+
 static void linux_proc_sampler_cleanup(linux_proc_sampler_inst_t inst);
 
 static int
@@ -3779,6 +3985,17 @@ linux_proc_sampler_config(ldmsd_plug_handle_t handle, struct attr_value_list *kw
 		if (val) {
 			inst->exe_suffix = true;
 		}
+		val = av_value(avl, "proc_events");
+		if (val) {
+			inst->proc_events = (atoi(val) != 0);
+		}
+		val = av_value(avl, "proc_exe");
+		if (val) {
+			rc = init_regex_filter(inst, val, "exe",
+				&inst->exe_use_regex, &inst->exe_regex);
+			if (rc)
+				goto err;
+		}
 		val = av_value(avl, "sc_clk_tck");
 		if (val) {
 			inst->sc_clk_tck = sysconf(_SC_CLK_TCK);
@@ -3945,6 +4162,24 @@ no_pids:	;
 		rc = errno;
 		goto err;
 	}
+	if (inst->proc_events) {
+#ifdef HAVE_PROC_EVENTS
+		inst->proc_ev = proc_ev_subscribe(PROC_EV_EXEC|PROC_EV_EXIT,
+						  __proc_ev_cb, inst);
+		if (!inst->proc_ev) {
+			rc = errno;
+			INST_LOG(inst, OVIS_LERROR,
+				 "Error subscribing to process events: %d(%s)\n",
+				 rc, STRERROR(rc));
+			goto err;
+		}
+#else
+		INST_LOG(inst, OVIS_LERROR,
+			 "proc_events=1 is not supported by this build.\n");
+		rc = ENOTSUP;
+		goto err;
+#endif
+	}
 
 	return 0;
 
@@ -3961,6 +4196,12 @@ void linux_proc_sampler_cleanup(linux_proc_sampler_inst_t inst)
 	struct linux_proc_sampler_set *app_set;
 
 	ovis_log(inst->mylog, OVIS_LDEBUG, "terminating plugin linux_proc_sampler\n");
+#ifdef HAVE_PROC_EVENTS
+	if (inst->proc_ev) {
+		proc_ev_unsubscribe(inst->proc_ev);
+		inst->proc_ev = NULL;
+	}
+#endif
 	if (inst->stream)
 		ldms_msg_client_close(inst->stream);
 	pthread_mutex_lock(&inst->mutex);
@@ -3998,10 +4239,17 @@ void linux_proc_sampler_cleanup(linux_proc_sampler_inst_t inst)
 	char *tmp = inst->recycle_buf;
 	inst->recycle_buf = NULL;
 	inst->recycle_buf_sz = 0;
+	free(inst->status_buf);
+	inst->status_buf = NULL;
+	inst->status_buf_sz = 0;
 	if (inst->env_use_regex)
 		regfree(&(inst->env_regex));
 	if (inst->fd_use_regex)
 		regfree(&(inst->fd_regex));
+	if (inst->exe_use_regex)
+		regfree(&(inst->exe_regex));
+	inst->env_use_regex = inst->fd_use_regex = inst->exe_use_regex = false;
+	inst->proc_events = false;
 	free(tmp);
 }
 
@@ -0,0 +1,48 @@
+/* -*- c-basic-offset: 8 -*- */
+/* Copyright 2026 National Technology & Engineering Solutions of Sandia, LLC
+ * (NTESS). Under the terms of Contract DE-NA0003525 with NTESS, the U.S.
+ * Government retains certain rights in this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0 OR BSD-3-Clause)
+ */
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "proc_pread.h"
+
+#define PROC_PREAD_MIN 4096
+
+/* The /proc/<pid> files are seq_files which fill as much of the request
+ * as they can in one call, so a read that leaves room in the buffer has
+ * reached the end of the file. A full buffer is grown and the file read
+ * again from the beginning so that the content is from a single snapshot. */
+ssize_t proc_pread(int fd, char **buf, size_t *buf_sz)
+{
+	ssize_t len;
+	size_t sz;
+	char *b;
+
+	if (!*buf || *buf_sz < 2) {
+		b = realloc(*buf, PROC_PREAD_MIN);
+		if (!b)
+			return -ENOMEM;
+		*buf = b;
+		*buf_sz = PROC_PREAD_MIN;
+	}
+	while (1) {
+		len = pread(fd, *buf, *buf_sz - 1, 0);
+		if (len < 0)
+			return -errno;
+		if (len < *buf_sz - 1)
+			break;
+		sz = *buf_sz * 2;
+		b = realloc(*buf, sz);
+		if (!b)
+			return -ENOMEM;
+		*buf = b;
+		*buf_sz = sz;
+	}
+	(*buf)[len] = '\0';
+	return len;
+}
@@ -0,0 +1,19 @@
+/* -*- c-basic-offset: 8 -*- */
+/* Copyright 2026 National Technology & Engineering Solutions of Sandia, LLC
+ * (NTESS). Under the terms of Contract DE-NA0003525 with NTESS, the U.S.
+ * Government retains certain rights in this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0 OR BSD-3-Clause)
+ */
+#ifndef __PROC_PREAD_H
+#define __PROC_PREAD_H
+
+#include <sys/types.h>
+
+/* Read the whole /proc file open on fd from offset 0 into *buf, growing
+ * *buf (of *buf_sz bytes, which may start as NULL/0) until the file fits.
+ * The result is '\0' terminated. Returns the number of bytes read or
+ * -errno; *buf is kept on error. */
+ssize_t proc_pread(int fd, char **buf, size_t *buf_sz);
+
+#endif /* __PROC_PREAD_H */
@@ -0,0 +1,112 @@
+/* -*- c-basic-offset: 8 -*- */
+/* Copyright 2026 National Technology & Engineering Solutions of Sandia, LLC
+ * (NTESS). Under the terms of Contract DE-NA0003525 with NTESS, the U.S.
+ * Government retains certain rights in this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0 OR BSD-3-Clause)
+ */
+
+/**
+ * Test that proc_pread() reads a whole file that is larger than the initial
+ * buffer (e.g. /proc/<pid>/status with a long Cpus_allowed on a large node).
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "proc_pread.h"
+
+#define FAIL(...) do { \
+		fprintf(stderr, "FAIL: " __VA_ARGS__); \
+		exit(1); \
+	} while (0)
+
+/* write a status-like file of at least `sz` bytes, return its fd */
+static int status_file(size_t sz, char **content, size_t *len)
+{
+	char path[] = "/tmp/test_proc_pread.XXXXXX";
+	size_t n = 0;
+	char *s = malloc(sz + 128);
+	int fd;
+
+	if (!s)
+		FAIL("malloc\n");
+	n += sprintf(s + n, "Name:\tcat\nCpus_allowed:\t");
+	while (n < sz)
+		n += sprintf(s + n, "ffffffff,");
+	n += sprintf(s + n, "ffffffff\nvoluntary_ctxt_switches:\t42\n");
+	fd = mkstemp(path);
+	if (fd < 0)
+		FAIL("mkstemp: %d\n", errno);
+	unlink(path);
+	if (write(fd, s, n) != n)
+		FAIL("write: %d\n", errno);
+	*content = s;
+	*len = n;
+	return fd;
+}
+
+static void check(size_t file_sz, size_t buf_sz)
+{
+	char *content, *buf = NULL;
+	size_t len, sz = buf_sz;
+	ssize_t rlen;
+	int fd;
+
+	fd = status_file(file_sz, &content, &len);
+	if (sz)
+		buf = malloc(sz);
+	rlen = proc_pread(fd, &buf, &sz);
+	if (rlen < 0)
+		FAIL("proc_pread: %zd\n", rlen);
+	if (rlen != len)
+		FAIL("file %zu, buffer %zu: read %zd of %zu bytes\n",
+		     file_sz, buf_sz, rlen, len);
+	if (sz <= len || buf[len] != '\0')
+		FAIL("file %zu, buffer %zu: not terminated\n", file_sz, buf_sz);
+	if (memcmp(buf, content, len))
+		FAIL("file %zu, buffer %zu: content differs\n", file_sz, buf_sz);
+	if (!strstr(buf, "\nvoluntary_ctxt_switches:\t42\n"))
+		FAIL("file %zu, buffer %zu: last line lost\n", file_sz, buf_sz);
+	/* a second read reuses the grown buffer */
+	buf_sz = sz;
+	rlen = proc_pread(fd, &buf, &sz);
+	if (rlen != len || sz != buf_sz)
+		FAIL("file %zu: second read %zd, buffer %zu -> %zu\n",
+		     file_sz, rlen, buf_sz, sz);
+	close(fd);
+	free(buf);
+	free(content);
+}
+
+int main(int argc, char **argv)
+{
+	char *buf = NULL;
+	size_t sz = 0;
+	ssize_t rlen;
+	int fd;
+
+	check(100, 0);
+	check(100, 64);
+	check(8192, 64);	/* the old fixed buffer was CMDLINE_SZ * 2 */
+	check(8192 - 60, 8192);	/* exactly fills the buffer */
+	check(100000, 0);
+
+	fd = open("/proc/self/status", O_RDONLY);
+	if (fd < 0)
+		FAIL("open /proc/self/status: %d\n", errno);
+	sz = 16;
+	buf = malloc(sz);
+	rlen = proc_pread(fd, &buf, &sz);
+	if (rlen <= 0 || !strstr(buf, "Name:") || buf[rlen - 1] != '\n')
+		FAIL("/proc/self/status: %zd\n", rlen);
+	close(fd);
+	free(buf);
+	printf("PASS\n");
+	return 0;
+}
@@ -55,6 +55,7 @@
 #include <stdio.h>
 #include <sys/types.h>
 #include "coll/rbt.h"
+#include "coll/fnv_hash.h"
 #include "ovis_json/ovis_json.h"
 #include "ldms.h"
 #include "ldmsd.h"
@@ -77,6 +78,17 @@ static int str_cmp(void *tree_key, const void *srch_key)
 	return strcmp(tree_key, srch_key);
 }
 
+static int u64_cmp(void *tree_key, const void *srch_key)
+{
+	uint64_t a = *(uint64_t *)tree_key;
+	uint64_t b = *(const uint64_t *)srch_key;
+	if (a < b)
+		return -1;
+	if (a > b)
+		return 1;
+	return 0;
+}
+
 #define DEFAULT_CHAR_ARRAY_LEN 255
 
 /*
@@ -127,6 +139,7 @@ typedef struct js_schema_s {
 typedef struct js_stream_sampler_s *js_stream_sampler_t;
 struct js_stream_sampler_s {
 	int initialized;	/* 0 if 1st config */
+	char *cfg_name;		/* plugin configuration name */
 	char *stream_name;	/* stream msgs received from */
 	size_t heap_sz;		/* heap size for created sets */
 	char *prod_name;	/* producer name */
@@ -138,6 +151,8 @@ struct js_stream_sampler_s {
 	ldms_msg_client_t stream_client;
 	pthread_mutex_t sch_tree_lock;
 	struct rbt sch_tree;
+	struct rbt plan_tree;	/* decode plans by shape fingerprint */
+	int plan_count;
 	LIST_HEAD(, js_entry_s) set_list;
 	pthread_mutex_t lock;
 };
@@ -821,6 +836,7 @@ static int config(ldmsd_plug_handle_t handle, struct attr_value_list *kwl,
 		pthread_mutex_init(&js->lock, NULL);
 		pthread_mutex_init(&js->sch_tree_lock, NULL);
 		rbt_init(&js->sch_tree, str_cmp);
+		rbt_init(&js->plan_tree, u64_cmp);
 
 	}
 	pthread_mutex_lock(&js->lock);
@@ -913,12 +929,16 @@ static int config(ldmsd_plug_handle_t handle, struct attr_value_list *kwl,
 		js->perm = strdup("0660");
 
 	js->stream_client = ldms_msg_subscribe(js->stream_name, 0,
-				json_recv_cb, handle, "js_stream_sampler");
+				json_recv_cb, js, "js_stream_sampler");
 	if (!js->stream_client) {
 		LERROR("Cannot create stream client.\n");
 		rc = errno;
 		goto err_0;
 	}
+	/* The messages are decoded straight from the buffer when their
+	 * shape matches a cached plan (see js_plan_find()), so do not have
+	 * LDMS build a JSON object for every message. */
+	ldms_msg_client_json_raw_set(js->stream_client, 1);
 	pthread_mutex_unlock(&js->lock);
 	return 0;
  err_0:
@@ -1057,17 +1077,17 @@ static void update_set_data(js_stream_sampler_t js, ldms_set_t l_set,
 	}
 }
 
-static void js_set_free(ldmsd_cfgobj_store_t self, js_set_t j_set)
+static void js_set_free(js_stream_sampler_t js, js_set_t j_set)
 {
 	if (j_set->set) {
-		ldmsd_set_deregister(j_set->name, self->cfg.name);
+		ldmsd_set_deregister(j_set->name, js->cfg_name);
 		ldms_set_delete(j_set->set);
 	}
 	free(j_set->name);
 	free(j_set);
 }
 
-static void js_schema_free(ldmsd_cfgobj_store_t scfg, js_schema_t j_schema)
+static void js_schema_free(js_stream_sampler_t js, js_schema_t j_schema)
 {
 	struct rbn *rbn;
 	js_set_t j_set;
@@ -1075,7 +1095,7 @@ static void js_schema_free(ldmsd_cfgobj_store_t scfg, js_schema_t j_schema)
 	while (( rbn = rbt_min(&j_schema->s_set_tree) )) {
 		rbt_del(&j_schema->s_set_tree, rbn);
 		j_set = container_of(rbn, struct js_set_s, rbn);
-		js_set_free(scfg, j_set);
+		js_set_free(js, j_set);
 	}
 	while (( rbn = rbt_min(&j_schema->s_attr_tree) )) {
 		rbt_del(&j_schema->s_attr_tree, rbn);
@@ -1086,27 +1106,360 @@ static void js_schema_free(ldmsd_cfgobj_store_t scfg, js_schema_t j_schema)
 	free(j_schema);
 }
 
-static void purge_schema_tree(ldmsd_cfgobj_store_t scfg, js_stream_sampler_t js)
+/*
+ * Decode plans
+ *
+ * Most streams publish messages of a single shape: the same flat
+ * dictionary of scalar attributes in the same order, with only the
+ * values changing. For such messages, building a JSON object and
+ * looking up every attribute by name is repeated work. Instead, the
+ * message is scanned once to tokenize the top-level dictionary and to
+ * compute a fingerprint of its shape (the attribute names, value types
+ * and the schema name). The fingerprint selects a plan that maps each
+ * attribute position to its metric index, and the values are converted
+ * straight from the message buffer into the set.
+ *
+ * A plan is compiled from the first message of a shape after that
+ * message was processed by the generic path. Messages containing
+ * lists, dictionaries or single-quoted strings are never planned.
+ */
+#define JS_PLAN_MAX_ATTR 64	/* Max attributes in a planned message */
+#define JS_PLAN_MAX 256		/* Max plans per stream */
+
+struct js_token_s {
+	const char *key;	/* Attribute name (not terminated) */
+	int key_len;
+	const char *val;	/* Value text, without quotes for strings */
+	int val_len;
+	enum json_value_e type;
+};
+
+struct js_shape_s {
+	uint64_t fp;		/* Shape fingerprint */
+	int n;			/* Number of attributes */
+	const char *schema;	/* The 'schema' value (not terminated) */
+	int schema_len;
+	struct js_token_s tok[JS_PLAN_MAX_ATTR];
+};
+
+struct js_plan_step_s {
+	int midx;		/* Metric index, -1 to skip the attribute */
+	enum json_value_e type;
+	int key_len;
+	char *key;
+};
+
+typedef struct js_plan_s {
+	uint64_t fp;		/* Shape fingerprint (key) */
+	js_schema_t j_schema;
+	js_set_t j_set;		/* Set of the last message decoded */
+	uid_t uid;		/* Credential j_set was resolved for */
+	gid_t gid;
+	long hits;
+	struct rbn rbn;		/* js->plan_tree entry */
+	int n;
+	struct js_plan_step_s step[OVIS_FLEX];
+} *js_plan_t;
+
+static inline const char *skip_ws(const char *p, const char *end)
+{
+	while (p < end && isspace((unsigned char)*p))
+		p++;
+	return p;
+}
+
+/* Return the closing quote of the string starting after the opening quote */
+static const char *scan_str(const char *p, const char *end)
+{
+	while (p < end) {
+		if (*p == '"')
+			return p;
+		if (*p == '\\')
+			p++;
+		p++;
+	}
+	return NULL;
+}
+
+/*
+ * Tokenize a flat, top-level JSON dictionary and compute its shape
+ * fingerprint. Returns ENOTSUP if the message cannot be planned, in which
+ * case it must be handled by the generic path.
+ */
+static int js_shape_scan(const char *data, size_t len, struct js_shape_s *sh)
+{
+	const char *end = data + len;
+	const char *p, *q;
+	struct js_token_s *t;
+	uint64_t h = FNV_64_OFFSET_BASIS;
+	char tc;
+
+	sh->n = 0;
+	sh->schema = NULL;
+	p = skip_ws(data, end);
+	if (p >= end || *p != '{')
+		return ENOTSUP;
+	p = skip_ws(p + 1, end);
+	if (p < end && *p == '}')
+		return ENOTSUP; /* nothing to decode */
+	while (p < end) {
+		if (sh->n == JS_PLAN_MAX_ATTR || *p != '"')
+			return ENOTSUP;
+		t = &sh->tok[sh->n];
+		q = scan_str(p + 1, end);
+		if (!q)
+			return ENOTSUP;
+		t->key = p + 1;
+		t->key_len = q - t->key;
+		p = skip_ws(q + 1, end);
+		if (p >= end || *p != ':')
+			return ENOTSUP;
+		p = skip_ws(p + 1, end);
+		if (p >= end)
+			return ENOTSUP;
+		switch (*p) {
+		case '"':
+			q = scan_str(p + 1, end);
+			if (!q)
+				return ENOTSUP;
+			t->val = p + 1;
+			t->val_len = q - t->val;
+			t->type = JSON_STRING_VALUE;
+			p = q + 1;
+			break;
+		case 't':
+		case 'f':
+		case 'n':
+			if (end - p >= 4 && 0 == memcmp(p, "true", 4)) {
+				t->type = JSON_BOOL_VALUE;
+				t->val_len = 4;
+			} else if (end - p >= 5 && 0 == memcmp(p, "false", 5)) {
+				t->type = JSON_BOOL_VALUE;
+				t->val_len = 5;
+			} else if (end - p >= 4 && 0 == memcmp(p, "null", 4)) {
+				t->type = JSON_NULL_VALUE;
+				t->val_len = 4;
+			} else {
+				return ENOTSUP;
+			}
+			t->val = p;
+			p += t->val_len;
+			break;
+		default:
+			/* Same classification as the JSON lexer */
+			t->type = JSON_INT_VALUE;
+			for (q = p; q < end; q++) {
+				if (*q == '.' || *q == 'e' || *q == 'E')
+					t->type = JSON_FLOAT_VALUE;
+				else if (!isdigit((unsigned char)*q) &&
+					 *q != '-' && *q != '+')
+					break;
+			}
+			if (q == p)
+				return ENOTSUP; /* list, dict, or garbage */
+			t->val = p;
+			t->val_len = q - p;
+			p = q;
+			break;
+		}
+		if (t->type == JSON_STRING_VALUE && t->key_len == 6 &&
+		    0 == memcmp(t->key, "schema", 6)) {
+			sh->schema = t->val;
+			sh->schema_len = t->val_len;
+		}
+		tc = t->type;
+		h = fnv_hash_a1_64(t->key, t->key_len, h);
+		h = fnv_hash_a1_64(&tc, 1, h);
+		sh->n++;
+		p = skip_ws(p, end);
+		if (p >= end)
+			return ENOTSUP;
+		if (*p == '}')
+			break;
+		if (*p != ',')
+			return ENOTSUP;
+		p = skip_ws(p + 1, end);
+	}
+	if (!sh->schema)
+		return ENOTSUP;
+	sh->fp = fnv_hash_a1_64(sh->schema, sh->schema_len, h);
+	return 0;
+}
+
+/* Return the plan matching the scanned shape, or NULL. Caller holds js->lock */
+static js_plan_t js_plan_find(js_stream_sampler_t js, struct js_shape_s *sh)
+{
+	struct rbn *rbn;
+	js_plan_t plan;
+	int i;
+
+	rbn = rbt_find(&js->plan_tree, &sh->fp);
+	if (!rbn)
+		return NULL;
+	plan = container_of(rbn, struct js_plan_s, rbn);
+	/* Guard against fingerprint collisions */
+	if (plan->n != sh->n)
+		return NULL;
+	if (strlen(plan->j_schema->s_name) != sh->schema_len ||
+	    memcmp(plan->j_schema->s_name, sh->schema, sh->schema_len))
+		return NULL;
+	for (i = 0; i < sh->n; i++) {
+		if (plan->step[i].type != sh->tok[i].type ||
+		    plan->step[i].key_len != sh->tok[i].key_len ||
+		    memcmp(plan->step[i].key, sh->tok[i].key, sh->tok[i].key_len))
+			return NULL;
+	}
+	return plan;
+}
+
+/*
+ * Compile a plan for the shape of a message that was just handled by the
+ * generic path into the set of j_set. Caller holds js->lock.
+ */
+static void js_plan_add(js_stream_sampler_t js, struct js_shape_s *sh,
+			js_schema_t j_schema, js_set_t j_set,
+			uid_t uid, gid_t gid)
+{
+	js_plan_t plan;
+	struct attr_entry *ae;
+	struct rbn *rbn;
+	size_t sz;
+	char *key;
+	int i;
+
+	if (js->plan_count >= JS_PLAN_MAX)
+		return;
+	if (rbt_find(&js->plan_tree, &sh->fp))
+		return; /* Already planned, or a fingerprint collision */
+	sz = sizeof(*plan) + sh->n * sizeof(plan->step[0]);
+	for (i = 0; i < sh->n; i++)
+		sz += sh->tok[i].key_len + 1;
+	plan = calloc(1, sz);
+	if (!plan)
+		return;	/* Messages of this shape stay on the generic path */
+	key = (char *)&plan->step[sh->n];
+	for (i = 0; i < sh->n; i++) {
+		struct js_plan_step_s *step = &plan->step[i];
+		memcpy(key, sh->tok[i].key, sh->tok[i].key_len);
+		key[sh->tok[i].key_len] = '\0';
+		step->key = key;
+		step->key_len = sh->tok[i].key_len;
+		step->type = sh->tok[i].type;
+		step->midx = -1;
+		key += step->key_len + 1;
+		if (step->type == JSON_NULL_VALUE)
+			continue;
+		rbn = rbt_find(&j_schema->s_attr_tree, step->key);
+		if (!rbn)
+			continue; /* Not in the schema, ignored */
+		ae = container_of(rbn, struct attr_entry, rbn);
+		if (ae->type != step->type || ae->ridx >= 0) {
+			/* The schema was created from a different shape */
+			free(plan);
+			return;
+		}
+		step->midx = ae->midx;
+	}
+	plan->n = sh->n;
+	plan->fp = sh->fp;
+	plan->j_schema = j_schema;
+	plan->j_set = j_set;
+	plan->uid = uid;
+	plan->gid = gid;
+	rbn_init(&plan->rbn, &plan->fp);
+	rbt_ins(&js->plan_tree, &plan->rbn);
+	js->plan_count++;
+	LDEBUG("Compiled a %d-attribute decode plan for schema '%s'\n",
+	       plan->n, j_schema->s_name);
+}
+
+/* Decode the message values straight into the set. Caller holds js->lock */
+static void js_plan_apply(js_plan_t plan, struct js_shape_s *sh, ldms_set_t set)
+{
+	struct js_plan_step_s *step;
+	struct js_token_s *t;
+	ldms_mval_t mval;
+	size_t len;
+	int i;
+
+	for (i = 0; i < plan->n; i++) {
+		step = &plan->step[i];
+		t = &sh->tok[i];
+		if (step->midx < 0)
+			continue;
+		switch (step->type) {
+		case JSON_INT_VALUE:
+			ldms_metric_set_s64(set, step->midx, strtoll(t->val, NULL, 0));
+			break;
+		case JSON_BOOL_VALUE:
+			ldms_metric_set_s8(set, step->midx, t->val[0] == 't');
+			break;
+		case JSON_FLOAT_VALUE:
+			ldms_metric_set_double(set, step->midx, strtold(t->val, NULL));
+			break;
+		case JSON_STRING_VALUE:
+			len = ldms_metric_array_get_len(set, step->midx);
+			if (t->val_len < len)
+				len = t->val_len;
+			else
+				len = len - 1;
+			mval = ldms_metric_array_get(set, step->midx);
+			ldms_mval_array_set_str(mval, t->val, len);
+			ldms_metric_array_set_char(set, step->midx, len, '\0');
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+static void purge_plan_tree(js_stream_sampler_t js)
+{
+	struct rbn *rbn;
+	while (( rbn = rbt_min(&js->plan_tree) )) {
+		rbt_del(&js->plan_tree, rbn);
+		free(container_of(rbn, struct js_plan_s, rbn));
+	}
+	js->plan_count = 0;
+}
+
+static void purge_schema_tree(js_stream_sampler_t js)
 {
 	struct rbn *rbn;
 	js_schema_t j_schema;
+	pthread_mutex_lock(&js->lock);
+	purge_plan_tree(js);
+	pthread_mutex_unlock(&js->lock);
 	while (( rbn = rbt_min(&js->sch_tree) )) {
 		rbt_del(&js->sch_tree, rbn);
 		j_schema = container_of(rbn, struct js_schema_s, rbn);
-		js_schema_free(scfg, j_schema);
+		js_schema_free(js, j_schema);
 	}
 }
 
-static int __stream_close(ldms_msg_event_t ev, ldmsd_cfgobj_store_t scfg)
+static void js_free(js_stream_sampler_t js)
 {
-	js_stream_sampler_t js = scfg->context;
-	purge_schema_tree(scfg, js);
+	free(js->stream_name);
+	free(js->prod_name);
+	free(js->inst_fmt);
+	free(js->comp_id);
+	free(js->uid);
+	free(js->gid);
+	free(js->perm);
+	free(js->cfg_name);
+	free(js);
+}
+
+static int __stream_close(ldms_msg_event_t ev, js_stream_sampler_t js)
+{
+	/* This is the last event; the plugin has been destroyed */
+	purge_schema_tree(js);
+	js_free(js);
 	return 0;
 }
 
-static int __stream_recv(ldms_msg_event_t ev, ldmsd_cfgobj_store_t scfg)
+static int __stream_recv(ldms_msg_event_t ev, js_stream_sampler_t js)
 {
-	js_stream_sampler_t js = scfg->context;
 	const char *msg;
 	json_entity_t entity;
 	int rc = EINVAL;
@@ -1116,6 +1469,11 @@ static int __stream_recv(ldms_msg_event_t ev, ldmsd_cfgobj_store_t scfg)
 	ldms_set_t l_set;
 	js_set_t j_set;
 	char *inst_name = NULL;
+	struct js_shape_s shape;
+	js_plan_t plan = NULL;
+	json_parser_t jp;
+	json_entity_t parsed = NULL;
+	int planned;
 
 	if (ev->type != LDMS_MSG_EVENT_RECV)
 		return 0;
@@ -1126,7 +1484,58 @@ static int __stream_recv(ldms_msg_event_t ev, ldmsd_cfgobj_store_t scfg)
 	}
 
 	msg = ev->recv.data;
+	pthread_mutex_lock(&js->lock);
+
+	planned = (0 == js_shape_scan(msg, ev->recv.data_len, &shape));
+	if (planned)
+		plan = js_plan_find(js, &shape);
+	if (plan && (plan->uid != ev->recv.cred.uid ||
+		     plan->gid != ev->recv.cred.gid)) {
+		/* The set instance name may depend on the credential */
+		inst_name = get_inst_name(js, NULL, plan->j_schema,
+					  ev->recv.cred.uid, ev->recv.cred.gid,
+					  ev->recv.perm);
+		rbn = inst_name ? rbt_find(&plan->j_schema->s_set_tree, inst_name) : NULL;
+		free(inst_name);
+		inst_name = NULL;
+		if (rbn) {
+			plan->j_set = container_of(rbn, struct js_set_s, rbn);
+			plan->uid = ev->recv.cred.uid;
+			plan->gid = ev->recv.cred.gid;
+		} else {
+			/* Let the generic path create the set */
+			plan = NULL;
+		}
+	}
+	if (plan) {
+		plan->hits++;
+		l_set = plan->j_set->set;
+		ldms_transaction_begin(l_set);
+		ldms_metric_set_s32(l_set, 0, ev->recv.cred.uid);
+		ldms_metric_set_s32(l_set, 1, ev->recv.cred.gid);
+		ldms_metric_set_s32(l_set, 2, ev->recv.perm);
+		js_plan_apply(plan, &shape, l_set);
+		ldms_transaction_end(l_set);
+		pthread_mutex_unlock(&js->lock);
+		return 0;
+	}
+
 	entity = ev->recv.json;
+	if (!entity) {
+		jp = json_parser_new(0);
+		if (!jp) {
+			rc = ENOMEM;
+			goto err_0;
+		}
+		rc = json_parse_buffer(jp, (char *)msg, ev->recv.data_len, &parsed);
+		json_parser_free(jp);
+		if (rc) {
+			LERROR("%s: Error %d parsing the JSON message.\n",
+			       ev->recv.name, rc);
+			goto err_0;
+		}
+		entity = parsed;
+	}
 
 	/* Find/create the schema for this JSON object */
 	if (JSON_DICT_VALUE != json_entity_type(entity)) {
@@ -1180,7 +1589,7 @@ static int __stream_recv(ldms_msg_event_t ev, ldmsd_cfgobj_store_t scfg)
 		}
 		LINFO("Created the set '%s' with schema '%s'\n",
 			inst_name, j_schema->s_name);
-		ldmsd_set_register(l_set, scfg->cfg.name);
+		ldmsd_set_register(l_set, js->cfg_name);
 		ldms_set_publish(l_set);
 
 		rbn_init(&j_set->rbn, j_set->name);
@@ -1195,26 +1604,33 @@ static int __stream_recv(ldms_msg_event_t ev, ldmsd_cfgobj_store_t scfg)
 	ldms_metric_set_s32(l_set, 2, ev->recv.perm);
 	update_set_data(js, l_set, entity, j_schema);
 	ldms_transaction_end(l_set);
+	if (planned)
+		js_plan_add(js, &shape, j_schema, j_set,
+			    ev->recv.cred.uid, ev->recv.cred.gid);
 	pthread_mutex_unlock(&js->lock);
 	free(inst_name);
+	if (parsed)
+		json_entity_free(parsed);
 	return 0;
 err_1:
 	free(j_set);
 err_0:
 	pthread_mutex_unlock(&js->lock);
 	free(inst_name);
+	if (parsed)
+		json_entity_free(parsed);
 	return rc;
 }
 
 static int json_recv_cb(ldms_msg_event_t ev, void *arg)
 {
-	ldmsd_cfgobj_store_t scfg = arg;
+	js_stream_sampler_t js = arg;
 
 	switch (ev->type)  {
 	case LDMS_MSG_EVENT_CLIENT_CLOSE:
-		return __stream_close(ev, scfg);
+		return __stream_close(ev, js);
 	case LDMS_MSG_EVENT_RECV:
-		return __stream_recv(ev, scfg);
+		return __stream_recv(ev, js);
 	default:
 		/* ignore other events */
 		return 0;
@@ -1223,16 +1639,28 @@ static int json_recv_cb(ldms_msg_event_t ev, void *arg)
 
 static int constructor(ldmsd_plug_handle_t handle)
 {
-	__log = ldmsd_plug_log_get(handle);
+	js_stream_sampler_t js;
 
-        return 0;
+	__log = ldmsd_plug_log_get(handle);
+	js = calloc(1, sizeof(*js));
+	if (!js)
+		return ENOMEM;
+	js->cfg_name = strdup(ldmsd_plug_cfg_name_get(handle));
+	if (!js->cfg_name) {
+		free(js);
+		return ENOMEM;
+	}
+	ldmsd_plug_ctxt_set(handle, js);
+	return 0;
 }
 
 static void destructor(ldmsd_plug_handle_t handle)
 {
 	js_stream_sampler_t js = ldmsd_plug_ctxt_get(handle);
 	if (js->stream_client)
-		ldms_msg_client_close(js->stream_client); /* CLOSE event will clean up `p` */
+		ldms_msg_client_close(js->stream_client); /* CLOSE event will clean up `js` */
+	else
+		js_free(js);
 }
 
 struct ldmsd_sampler ldmsd_plugin_interface = {
@@ -52,11 +52,14 @@
  */
 #include <stdlib.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <wordexp.h>
 #include <pthread.h>
 #include <coll/rbt.h>
 #pragma GCC diagnostic ignored "-Wunused-variable"
 #include "lustre_sampler.h"
+#include "lustre_stats.h"
 #pragma GCC diagnostic warning "-Wunused-variable"
 #include <assert.h>
 
@@ -98,6 +101,7 @@ struct lustre_svc_stats* lustre_svc_stats_alloc(const char *path, int mlen)
 		goto err0;
 	s->lms.path = strdup(path);
 	s->lms.type = LMS_SVC_STATS;
+	s->lms.fd = -1;
 	if (!s->lms.path)
 		goto err1;
 	s->mctxt_map = str_map_create(1021);
@@ -120,6 +124,7 @@ struct lustre_single* lustre_single_alloc(const char *path)
 		goto err0;
 	l->lms.path = strdup(path);
 	l->lms.type = LMS_SINGLE;
+	l->lms.fd = -1;
 	if (!l->lms.path)
 		goto err1;
 	return l;
@@ -131,6 +136,14 @@ err0:
 
 void __lms_content_free(struct lustre_metric_src *lms)
 {
+	if (lms->fd >= 0) {
+		close(lms->fd);
+		lms->fd = -1;
+	}
+	if (lms->buf) {
+		free(lms->buf);
+		lms->buf = NULL;
+	}
 	if (lms->path) {
 		free(lms->path);
 		lms->path = NULL;
@@ -144,6 +157,7 @@ void lustre_svc_stats_free(struct lustre_svc_stats *lss)
 		str_map_free(lss->mctxt_map);
 		lss->mctxt_map = NULL;
 	}
+	free(lss->layout);
 	free(lss);
 }
 
@@ -190,9 +204,10 @@ int __add_lss_metric_routine(ldms_schema_t schema,
 
 void lms_close_file(struct lustre_metric_src *lms);
 
+#define __LMS_BUF_SIZ 4096
 int lms_open_file(struct lustre_metric_src *lms)
 {
-	if (lms->f)
+	if (lms->fd >= 0)
 		return EEXIST;
 	wordexp_t p = {0};
 	int rc;
@@ -209,17 +224,18 @@ int lms_open_file(struct lustre_metric_src *lms)
 		goto out;
 	}
 
-	lms->f = fopen(p.we_wordv[0], "r");
-	if (!lms->f) {
-		rc = errno;
-		goto out;
+	if (!lms->buf) {
+		lms->buf = malloc(__LMS_BUF_SIZ);
+		if (!lms->buf) {
+			rc = ENOMEM;
+			goto out;
+		}
+		lms->buf_sz = __LMS_BUF_SIZ;
 	}
 
-	/* set unbuffered mode */
-	rc = setvbuf(lms->f, NULL, _IONBF, 0);
-	if (rc) {
-		lms_close_file(lms);
-	}
+	lms->fd = open(p.we_wordv[0], O_RDONLY|O_CLOEXEC);
+	if (lms->fd < 0)
+		rc = errno;
 out:
 	wordfree(&p);
 	return rc;
@@ -227,8 +243,8 @@ out:
 
 void lms_close_file(struct lustre_metric_src *lms)
 {
-	fclose(lms->f);
-	lms->f = NULL;
+	close(lms->fd);
+	lms->fd = -1;
 }
 
 static int del_str(char *str, char *tgt)
@@ -399,46 +415,85 @@ void __lss_reset(ldms_set_t set, struct lustre_svc_stats *lss)
 }
 
 #define __LBUF_SIZ 256
+/*
+ * Return the metric context of the \c tok found on stats line \c i. The
+ * ::str_map is consulted only when the line differs from the layout seen in
+ * the previous sample, e.g. when a zero counter line appears or disappears.
+ */
+static struct lustre_metric_ctxt *
+__lss_layout_ctxt(struct lustre_svc_stats *lss, int i,
+		 struct lustre_stats_tok *tok)
+{
+	struct lustre_svc_stats_line *layout;
+	struct lustre_metric_ctxt *ctxt;
+	char name[__LBUF_SIZ];
+	int len, sz;
+
+	if (i < lss->layout_len && lss->layout[i].hash == tok->hash)
+		return lss->layout[i].ctxt;
+
+	len = tok->key_len < __LBUF_SIZ ? tok->key_len : __LBUF_SIZ - 1;
+	memcpy(name, tok->key, len);
+	name[len] = '\0';
+	ctxt = (void*)str_map_get(lss->mctxt_map, name);
+
+	if (i >= lss->layout_sz) {
+		sz = lss->layout_sz ? lss->layout_sz * 2 : 64;
+		layout = realloc(lss->layout, sz * sizeof(*layout));
+		if (!layout)
+			return ctxt; /* uncached, but still sampled */
+		lss->layout = layout;
+		lss->layout_sz = sz;
+	}
+	lss->layout[i].hash = tok->hash;
+	lss->layout[i].ctxt = ctxt;
+	if (i >= lss->layout_len)
+		lss->layout_len = i + 1;
+	return ctxt;
+}
+
 int __lss_sample(ldms_set_t set, struct lustre_svc_stats *lss)
 {
 	int rc = 0;
+	ssize_t len;
+	int i;
 
-	if (!lss->lms.f) {
+	if (lss->lms.fd < 0) {
 		rc = lms_open_file(&lss->lms);
 		if (rc)
 			goto err;
 	}
 
-	rc = fseek(lss->lms.f, 0, SEEK_SET);
-	if (rc) {
-		rc = errno;
+	len = lustre_stats_pread(lss->lms.fd, &lss->lms.buf, &lss->lms.buf_sz);
+	if (len < 0) {
+		rc = -len;
 		goto err;
 	}
 
 	if (lss->mh_status_idx != -1)
 		ldms_metric_set_u64(set, lss->mh_status_idx, 1);
 
-	fseek(lss->lms.f, 0, SEEK_SET);
-	char lbuf[__LBUF_SIZ];
-	char name[__LBUF_SIZ];
-	char unit[__LBUF_SIZ];
-	uint64_t n, count, min, max, sum, sum2;
+	struct lustre_stats_tok tok;
 	union ldms_value value;
 	/* The first line is timestamp, we can ignore that */
-	char *s = fgets(lbuf, __LBUF_SIZ, lss->lms.f);
+	char *s = strchr(lss->lms.buf, '\n');
 	if (!s)
 		goto err;
+	s++;
 	gettimeofday(lss->tv_cur, 0);
 	struct timeval dtv;
 	timersub(lss->tv_cur, lss->tv_prev, &dtv);
 	float dt = dtv.tv_sec + dtv.tv_usec / 1e06;
 
-	while (fgets(lbuf, __LBUF_SIZ, lss->lms.f)) {
-		n = sscanf(lbuf, "%s %lu samples %s %lu %lu %lu %lu",
-				name, &count, unit, &min, &max, &sum, &sum2);
+	i = 0;
+	while (*s) {
+		char *line = s;
+		s = lustre_stats_tok_line(s, &tok);
+		if (!tok.key_len)
+			continue;
 
 		struct lustre_metric_ctxt *ctxt =
-				(void*)str_map_get(lss->mctxt_map, name);
+				__lss_layout_ctxt(lss, i++, &tok);
 		if (!ctxt)
 			continue;
 
@@ -452,16 +507,17 @@ int __lss_sample(ldms_set_t set, struct lustre_svc_stats *lss)
 		 * - {name} {count of events} samples [{units}] {min} {max} {sum}
 		 * - {name} {count of events} samples [{units}] {min} {max} {sum} {sum-of-square}
 		 */
-		if (n >= 6) {
+		if (tok.n >= 4) {
 			/* `sum` available, use it */
-			value.v_u64 = sum;
-		} else if (n >= 3) {
+			value.v_u64 = tok.v[3];
+		} else if (tok.n >= 1) {
 			/* otherwise, use count */
-			value.v_u64 = count;
+			value.v_u64 = tok.v[0];
 		} else {
 			/* bad format */
 			ovis_log(mylog, OVIS_LWARNING, "lustre sample: "
-				  "bad line format: %s\n", lbuf);
+				  "bad line format: %.*s\n",
+				  (int)(s - line), line);
 			continue;
 		}
 
@@ -485,7 +541,7 @@ err:
 	__lss_reset(set, lss);
 	if (lss->mh_status_idx != -1)
 		ldms_metric_set_u64(set, lss->mh_status_idx, 0);
-	if (lss->lms.f) {
+	if (lss->lms.fd >= 0) {
 		lms_close_file(&lss->lms);
 	}
 out:
@@ -497,39 +553,31 @@ int __single_sample(ldms_set_t set, struct lustre_single *ls)
 	int rc = 0;
 	union ldms_value v = {0};
 
-	if (!ls->lms.f) {
+	if (ls->lms.fd < 0) {
 		rc = lms_open_file(&ls->lms);
 		if (rc)
 			goto err;
 	}
 
-	rc = fseek(ls->lms.f, 0, SEEK_SET);
-	if (rc) {
-		rc = errno;
-		goto err;
-	}
-
-	fseek(ls->lms.f, 0, SEEK_SET);
-	char line[64], *s;
-	s = fgets(line, 64, ls->lms.f);
-	if (!s) {
-		rc = ENOENT;
+	ssize_t len = lustre_stats_pread(ls->lms.fd, &ls->lms.buf, &ls->lms.buf_sz);
+	if (len <= 0) {
+		rc = len ? -len : ENOENT;
 		goto err;
 	}
-	rc = sscanf(s, "%"PRIu64, &v.v_u64);
-	if (rc < 1) {
-		v.v_u64 = 0;
-		rc = errno;
+	char *s = ls->lms.buf;
+	while (*s == ' ' || *s == '\t')
+		s++;
+	if (*s < '0' || *s > '9') {
+		rc = EINVAL;
 		goto err;
 	}
-	while (fgets(line, 64, ls->lms.f)) {
-		/* read until end of file */
-	}
+	while (*s >= '0' && *s <= '9')
+		v.v_u64 = v.v_u64 * 10 + (*s++ - '0');
 	rc = 0;
 
 	goto out;
 err:
-	if (ls->lms.f)
+	if (ls->lms.fd >= 0)
 		lms_close_file(&ls->lms);
 out:
 	ldms_metric_set(set, ls->sctxt.metric_idx, &v);
@@ -216,7 +216,18 @@ struct lustre_metric_src {
 		LMS_SINGLE
 	} type;
 	char *path;
-	FILE *f;
+	int fd;		/**< Kept open across samples, -1 if not opened */
+	char *buf;	/**< pread() buffer, grown to fit the whole file */
+	size_t buf_sz;
+};
+
+/**
+ * An entry of the stats file layout cache. \c hash is the hash of the key
+ * found on the corresponding line in the previous sample.
+ */
+struct lustre_svc_stats_line {
+	uint64_t hash;
+	struct lustre_metric_ctxt *ctxt; /**< NULL if the key is not sampled */
 };
 /**
  * Lustre service stats structure, for a metric source that follow lustre stat
@@ -237,6 +248,13 @@ struct lustre_svc_stats {
 	 */
 	int mh_status_idx;
 	ldms_set_t set;
+	/**
+	 * Line layout learned from the previous sample. Lines whose key hash
+	 * still matches skip the ::str_map lookup.
+	 */
+	struct lustre_svc_stats_line *layout;
+	int layout_len;
+	int layout_sz;
 	int mlen;
 	struct lustre_metric_ctxt mctxt[OVIS_FLEX];
 };
@@ -308,7 +326,7 @@ int lms_sample(ldms_set_t set, struct lustre_metric_src *lss);
 /**
  * Open the file (which can be a pattern) in lss.
  * \return 0 on success.
- * \return EEXIST if \c lss->f has already been opened.
+ * \return EEXIST if \c lss->fd has already been opened.
  * \return EINVAL if \c lss->path matches more than one file.
  * \return Error code on other error.
  */
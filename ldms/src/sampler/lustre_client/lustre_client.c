@@ -7,10 +7,13 @@
 #include <limits.h>
 #include <string.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <coll/rbt.h>
 #include <sys/queue.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/inotify.h>
 #include <unistd.h>
 #include "ldms.h"
 #include "ldmsd.h"
@@ -31,6 +34,21 @@ static const char * const llite_paths[] = {
 };
 static const int llite_paths_len = sizeof(llite_paths) / sizeof(llite_paths[0]);
 
+/* llite directory given by llite_path=, used instead of llite_paths[] */
+static char *llite_path_cfg;
+
+/* The LLITE directories are rescanned only when something may have changed:
+   /proc/self/mountinfo raises POLLPRI when the mount table changes, and an
+   inotify watch on the llite directory reports entries coming and going.
+   procfs and debugfs do not generate inotify events, so on a real client it
+   is the mount table that triggers the rescan; the watch covers plain
+   directories such as test fixtures. */
+static int mountinfo_fd = -1;
+static int inotify_fd = -1;
+static int inotify_wd = -1;
+static const char *watched_path;
+static int llites_stale = 1;
+
 static struct comp_id_data cid;
 
 char producer_name[LDMS_PRODUCER_NAME_MAX];
@@ -44,7 +62,7 @@ struct llite_data {
         char *fs_name;
         char *name;
         char *path;
-        char *stats_path;
+        struct llite_stats *stats;
         ldms_set_t general_metric_set; /* a pointer */
         struct rbn llite_tree_node;
 };
@@ -73,8 +91,8 @@ static struct llite_data *llite_create(const char *llite_name, const char *based
         if (llite->path == NULL)
                 goto out3;
         snprintf(path_tmp, PATH_MAX, "%s/stats", llite->path);
-        llite->stats_path = strdup(path_tmp);
-        if (llite->stats_path == NULL)
+        llite->stats = llite_stats_open(path_tmp);
+        if (llite->stats == NULL)
                 goto out4;
         llite->fs_name = strdup(llite_name);
         if (llite->fs_name == NULL)
@@ -96,7 +114,7 @@ static struct llite_data *llite_create(const char *llite_name, const char *based
 out6:
         free(llite->fs_name);
 out5:
-        free(llite->stats_path);
+        llite_stats_close(llite->stats);
 out4:
         free(llite->path);
 out3:
@@ -112,7 +130,7 @@ static void llite_destroy(struct llite_data *llite)
         ovis_log(lustre_client_log, OVIS_LDEBUG, "llite_destroy() %s\n", llite->name);
         llite_general_destroy(llite->general_metric_set);
         free(llite->fs_name);
-        free(llite->stats_path);
+        llite_stats_close(llite->stats);
         free(llite->path);
         free(llite->name);
         free(llite);
@@ -141,6 +159,14 @@ static const char *const find_llite_path()
         struct stat sb;
         int i;
 
+        if (llite_path_cfg != NULL) {
+                if (stat(llite_path_cfg, &sb) == 0 && S_ISDIR(sb.st_mode))
+                        return llite_path_cfg;
+                ovis_log(lustre_client_log, OVIS_LWARNING, "llite directory %s not found\n",
+                       llite_path_cfg);
+                return NULL;
+        }
+
         for (i = 0; i < llite_paths_len; i++) {
                 if (stat(llite_paths[i], &sb) == -1 || !S_ISDIR(sb.st_mode))
                         continue;
@@ -157,6 +183,72 @@ static const char *const find_llite_path()
         return NULL;
 }
 
+static void llites_watch_init()
+{
+        mountinfo_fd = open("/proc/self/mountinfo", O_RDONLY | O_CLOEXEC);
+        if (mountinfo_fd < 0)
+                ovis_log(lustre_client_log, OVIS_LDEBUG, "cannot open /proc/self/mountinfo,"
+                       " llites will be rescanned every sample\n");
+        inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+}
+
+static void llites_watch_fini()
+{
+        if (inotify_fd >= 0)
+                close(inotify_fd);
+        if (mountinfo_fd >= 0)
+                close(mountinfo_fd);
+        inotify_fd = inotify_wd = mountinfo_fd = -1;
+        watched_path = NULL;
+}
+
+static void llites_watch_dir(const char *llite_path)
+{
+        if (inotify_fd < 0 || watched_path == llite_path)
+                return;
+        if (inotify_wd >= 0)
+                inotify_rm_watch(inotify_fd, inotify_wd);
+        inotify_wd = inotify_add_watch(inotify_fd, llite_path,
+                                       IN_ONLYDIR | IN_CREATE | IN_DELETE |
+                                       IN_MOVED_FROM | IN_MOVED_TO |
+                                       IN_DELETE_SELF | IN_MOVE_SELF);
+        watched_path = (inotify_wd >= 0) ? llite_path : NULL;
+}
+
+/* Returns non-zero if the LLITE directories need to be rescanned */
+static int llites_changed()
+{
+        char buf[4096]
+                __attribute__ ((aligned(__alignof__(struct inotify_event))));
+        const struct inotify_event *ev;
+        struct pollfd pfd;
+        ssize_t len;
+        char *p;
+        int changed = llites_stale;
+
+        if (mountinfo_fd < 0)
+                return 1;
+        pfd.fd = mountinfo_fd;
+        pfd.events = POLLPRI;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLPRI | POLLERR)))
+                changed = 1;
+        if (inotify_fd < 0)
+                return changed;
+        while ((len = read(inotify_fd, buf, sizeof(buf))) > 0) {
+                for (p = buf; p < buf + len; p += sizeof(*ev) + ev->len) {
+                        ev = (const struct inotify_event *)p;
+                        if (ev->mask & IN_IGNORED) {
+                                /* the watched directory itself went away */
+                                inotify_wd = -1;
+                                watched_path = NULL;
+                        }
+                }
+                changed = 1;
+        }
+        return changed;
+}
+
 static int dir_once_log;
 /* List subdirectories in llite_path to get list of
    LLITE names.  Create llite_data structures for any LLITEs that we
@@ -169,10 +261,16 @@ static int llites_refresh()
         struct rbt new_llite_tree;
 	int err = 0;
 
+        if (!llites_changed())
+                return 0;
+        llites_stale = 0;
+
         llite_path = find_llite_path();
         if (llite_path == NULL) {
                 return 0;
         }
+        /* watch before listing so that no entry falls in between */
+        llites_watch_dir(llite_path);
 
         rbt_init(&new_llite_tree, string_comparator);
 
@@ -234,8 +332,9 @@ static void llites_sample()
         RBT_FOREACH(rbn, &llite_tree) {
                 struct llite_data *llite;
                 llite = container_of(rbn, struct llite_data, llite_tree_node);
-                llite_general_sample(llite->name, llite->stats_path,
-                                   llite->general_metric_set);
+                if (llite_general_sample(llite->name, llite->stats,
+                                         llite->general_metric_set))
+                        llites_stale = 1; /* possibly unmounted */
         }
 }
 
@@ -252,6 +351,14 @@ static int config(ldmsd_plug_handle_t handle,
                         return EINVAL;
 		}
 	}
+	ival = av_value(avl, "llite_path");
+	if (ival) {
+		free(llite_path_cfg);
+		llite_path_cfg = strdup(ival);
+		if (!llite_path_cfg)
+			return ENOMEM;
+		llites_stale = 1;
+	}
 	(void)base_auth_parse(avl, &auth, lustre_client_log);
 	int jc = jobid_helper_config(avl);
         if (jc) {
@@ -287,7 +394,7 @@ static int sample(ldmsd_plug_handle_t handle)
 static const char *usage(ldmsd_plug_handle_t handle)
 {
         ovis_log(lustre_client_log, OVIS_LDEBUG, "usage() called\n");
-	return  "config name=" SAMP;
+	return  "config name=" SAMP " [llite_path=<dir>]";
 }
 
 static int constructor(ldmsd_plug_handle_t handle)
@@ -295,6 +402,7 @@ static int constructor(ldmsd_plug_handle_t handle)
         lustre_client_log = ldmsd_plug_log_get(handle);
 	rbt_init(&llite_tree, string_comparator);
 	gethostname(producer_name, sizeof(producer_name));
+	llites_watch_init();
 
         return 0;
 }
@@ -304,6 +412,9 @@ static void destructor(ldmsd_plug_handle_t handle)
 	ovis_log(lustre_client_log, OVIS_LDEBUG, "term() called\n");
 	llites_destroy();
 	llite_general_schema_fini();
+	llites_watch_fini();
+	free(llite_path_cfg);
+	llite_path_cfg = NULL;
 }
 
 struct ldmsd_sampler ldmsd_plugin_interface = {
@@ -8,6 +8,9 @@
 #include <stdint.h>
 #include <dirent.h>
 #include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
 
 #include "ldms.h"
@@ -15,6 +18,7 @@
 #include "lustre_client.h"
 #include "lustre_client_general.h"
 #include "jobid_helper.h"
+#include "lustre_stats.h"
 
 /* Defined in lustre_client.c */
 extern ovis_log_t lustre_client_log;
@@ -22,6 +26,25 @@ extern ovis_log_t lustre_client_log;
 static ldms_schema_t llite_general_schema;
 
 #define MAXNAMESIZE 64
+#define STATS_BUF_SIZE 4096
+
+/* One entry of the layout cache: the key hash seen on a stats line in the
+   previous sample, and the metric index it resolved to (-1 if unknown). */
+struct llite_stats_line {
+        uint64_t hash;
+        int sum;
+        int index;
+};
+
+struct llite_stats {
+        char *path;
+        int fd;
+        char *buf;
+        size_t buf_sz;
+        struct llite_stats_line *lines;
+        int lines_len;
+        int lines_sz;
+};
 
 static char *llite_stats_uint64_t_entries[] = {
         "dirty_pages_hits",
@@ -172,80 +195,157 @@ ldms_set_t llite_general_create(const char *producer_name,
         return set;
 }
 
-static int llite_stats_sample(const char *stats_path,
+struct llite_stats *llite_stats_open(const char *stats_path)
+{
+        struct llite_stats *stats;
+
+        stats = calloc(1, sizeof(*stats));
+        if (stats == NULL)
+                goto out1;
+        stats->path = strdup(stats_path);
+        if (stats->path == NULL)
+                goto out2;
+        stats->buf = malloc(STATS_BUF_SIZE);
+        if (stats->buf == NULL)
+                goto out3;
+        stats->buf_sz = STATS_BUF_SIZE;
+        /* opened lazily by the first sample */
+        stats->fd = -1;
+        return stats;
+out3:
+        free(stats->path);
+out2:
+        free(stats);
+out1:
+        return NULL;
+}
+
+void llite_stats_close(struct llite_stats *stats)
+{
+        if (stats->fd >= 0)
+                close(stats->fd);
+        free(stats->lines);
+        free(stats->buf);
+        free(stats->path);
+        free(stats);
+}
+
+/* Read the whole stats file into stats->buf, reusing the open descriptor.
+   Returns the length or -errno. */
+static ssize_t llite_stats_read(struct llite_stats *stats)
+{
+        ssize_t len;
+
+        if (stats->fd < 0) {
+                stats->fd = open(stats->path, O_RDONLY | O_CLOEXEC);
+                if (stats->fd < 0)
+                        return -errno;
+        }
+        len = lustre_stats_pread(stats->fd, &stats->buf, &stats->buf_sz);
+        if (len < 0 && len != -ENOMEM) {
+                close(stats->fd);
+                stats->fd = -1;
+        }
+        return len;
+}
+
+/* Resolve the metric index of the name on stats line i, consulting the
+   metric set by name only when the line differs from the previous sample. */
+static int llite_stats_index(struct llite_stats *stats, int i,
+                             const char *name, int name_len, uint64_t hash,
+                             int sum, ldms_set_t set)
+{
+        struct llite_stats_line *lines;
+        char str1[MAXNAMESIZE+5];
+        int index;
+        int sz;
+
+        if (i < stats->lines_len && stats->lines[i].hash == hash &&
+            stats->lines[i].sum == sum)
+                return stats->lines[i].index;
+
+        if (name_len > MAXNAMESIZE)
+                name_len = MAXNAMESIZE;
+        memcpy(str1, name, name_len);
+        strcpy(str1 + name_len, sum ? ".sum" : "");
+        index = ldms_metric_by_name(set, str1);
+        if (index == -1)
+                ovis_log(lustre_client_log, OVIS_LWARNING, SAMP ": llite stats metric not found: %s\n",
+                       str1);
+
+        if (i >= stats->lines_sz) {
+                sz = stats->lines_sz ? stats->lines_sz * 2 : 64;
+                lines = realloc(stats->lines, sz * sizeof(*lines));
+                if (lines == NULL)
+                        return index;
+                stats->lines = lines;
+                stats->lines_sz = sz;
+        }
+        stats->lines[i].hash = hash;
+        stats->lines[i].sum = sum;
+        stats->lines[i].index = index;
+        if (i >= stats->lines_len)
+                stats->lines_len = i + 1;
+        return index;
+}
+
+static int llite_stats_sample(struct llite_stats *stats,
                                    ldms_set_t general_metric_set)
 {
-        FILE *sf;
-        char buf[512];
-	char str1[MAXNAMESIZE+1];
-	int ec = 0;
-
-        sf = fopen(stats_path, "r");
-        if (sf == NULL) {
-                ovis_log(lustre_client_log, OVIS_LWARNING, SAMP ": file %s not found\n",
-                       stats_path);
-                return ENOENT;
+        ssize_t len;
+        char *s;
+        int i;
+
+        len = llite_stats_read(stats);
+        if (len < 0) {
+                ovis_log(lustre_client_log, OVIS_LWARNING, SAMP ": failed on read from %s: %s\n",
+                       stats->path, STRERROR((int)-len));
+                return (int)-len;
         }
 
         /* The first line should always be "snapshot_time"
            we will ignore it because it always contains the time that we read
            from the file, not any information about when the stats last
            changed */
-        if (fgets(buf, sizeof(buf), sf) == NULL) {
-                ovis_log(lustre_client_log, OVIS_LWARNING, SAMP ": failed on read from %s\n",
-                       stats_path);
-		ec = ENOMSG;
-                goto out1;
-        }
-        if (strncmp("snapshot_time", buf, sizeof("snapshot_time")-1) != 0) {
-                ovis_log(lustre_client_log, OVIS_LWARNING, SAMP ": first line in %s is not \"snapshot_time\": %s\n",
-                       stats_path, buf);
-		ec = ENOMSG;
-                goto out1;
+        s = stats->buf;
+        if (strncmp("snapshot_time", s, sizeof("snapshot_time")-1) != 0) {
+                ovis_log(lustre_client_log, OVIS_LWARNING, SAMP ": first line in %s is not \"snapshot_time\": %.64s\n",
+                       stats->path, s);
+		return ENOMSG;
         }
+        s = strchr(s, '\n');
+        if (s == NULL)
+                return ENOMSG;
+        s++;
 
         ldms_transaction_begin(general_metric_set);
 	jobid_helper_metric_update(general_metric_set);
-        while (fgets(buf, sizeof(buf), sf)) {
-                uint64_t val1, val2;
-                int rc;
+        for (i = 0; *s != '\0'; ) {
+                struct lustre_stats_tok tok;
                 int index;
+                int sum;
 
-                rc = sscanf(buf, "%64s %lu samples [%*[^]]] %*u %*u %lu",
-                            str1, &val1, &val2);
-                if (rc == 2) {
-                        index = ldms_metric_by_name(general_metric_set, str1);
-                        if (index == -1) {
-                                ovis_log(lustre_client_log, OVIS_LWARNING, SAMP ": llite stats metric not found: %s\n",
-                                       str1);
-                        } else {
-                                ldms_metric_set_u64(general_metric_set, index, val1);
-                        }
+                s = lustre_stats_tok_line(s, &tok);
+                if (tok.key_len == 0)
                         continue;
-                } else if (rc == 3) {
-                        int base_name_len = strlen(str1);
-                        sprintf(str1+base_name_len, ".sum"); /* append ".sum" */
-                        index = ldms_metric_by_name(general_metric_set, str1);
-                        if (index == -1) {
-                                ovis_log(lustre_client_log, OVIS_LWARNING, SAMP ": llite stats metric not found: %s\n",
-                                       str1);
-                        } else {
-                                ldms_metric_set_u64(general_metric_set, index, val2);
-                        }
+                /* "<count> samples" alone, or with min, max and sum */
+                sum = (tok.n >= 4);
+                index = llite_stats_index(stats, i++, tok.key, tok.key_len,
+                                          tok.hash, sum, general_metric_set);
+                if (index == -1 || tok.n == 0)
                         continue;
-                }
+                ldms_metric_set_u64(general_metric_set, index,
+                                    sum ? tok.v[3] : tok.v[0]);
         }
         ldms_transaction_end(general_metric_set);
-out1:
-        fclose(sf);
 
-        return ec;
+        return 0;
 }
 
-void llite_general_sample(const char *llite_name, const char *stats_path,
-                          ldms_set_t general_metric_set)
+int llite_general_sample(const char *llite_name, struct llite_stats *stats,
+                         ldms_set_t general_metric_set)
 {
         ovis_log(lustre_client_log, OVIS_LDEBUG, SAMP ": llite_general_sample() %s\n",
                llite_name);
-        llite_stats_sample(stats_path, general_metric_set);
+        return llite_stats_sample(stats, general_metric_set);
 }
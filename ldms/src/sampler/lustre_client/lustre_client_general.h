@@ -21,8 +21,13 @@ ldms_set_t llite_general_create(const char *producer_name,
 				const comp_id_t cid,
 				const struct base_auth *auth);
 char *llite_general_osd_path_find(const char *search_path, const char *llite_name);
-void llite_general_sample(const char *llite_name, const char *stats_path,
-                          ldms_set_t general_metric_set);
+
+/* An llite stats file kept open across samples */
+struct llite_stats;
+struct llite_stats *llite_stats_open(const char *stats_path);
+void llite_stats_close(struct llite_stats *stats);
+int llite_general_sample(const char *llite_name, struct llite_stats *stats,
+                         ldms_set_t general_metric_set);
 void llite_general_destroy(ldms_set_t set);
 
 #endif /* __LUSTRE_LLITE_GENERAL_H */
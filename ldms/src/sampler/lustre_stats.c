@@ -0,0 +1,73 @@
+/* -*- c-basic-offset: 8 -*- */
+/* Copyright 2026 Lawrence Livermore National Security, LLC
+ * See the top-level COPYING file for details.
+ *
+ * SPDX-License-Identifier: (GPL-2.0 OR BSD-3-Clause)
+ */
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <coll/fnv_hash.h>
+
+#include "lustre_stats.h"
+
+/* The stats files are seq_files which fill the whole request in one call,
+ * so a short read is the end of the file. A full buffer is grown and the
+ * file read again. */
+ssize_t lustre_stats_pread(int fd, char **buf, size_t *buf_sz)
+{
+	ssize_t len;
+	char *b;
+
+	while (1) {
+		len = pread(fd, *buf, *buf_sz - 1, 0);
+		if (len < 0)
+			return -errno;
+		if (len < *buf_sz - 1)
+			break;
+		b = realloc(*buf, *buf_sz * 2);
+		if (!b)
+			return -ENOMEM;
+		*buf = b;
+		*buf_sz *= 2;
+	}
+	(*buf)[len] = '\0';
+	return len;
+}
+
+char *lustre_stats_tok_line(char *s, struct lustre_stats_tok *tok)
+{
+	uint64_t h = FNV_64_OFFSET_BASIS;
+	uint64_t v;
+
+	tok->n = 0;
+	while (*s == ' ' || *s == '\t')
+		s++;
+	tok->key = s;
+	while (*s && *s != ' ' && *s != '\t' && *s != '\n') {
+		h ^= (unsigned char)*s++;
+		h *= FNV_64_PRIME;
+	}
+	tok->key_len = s - tok->key;
+	tok->hash = h;
+	while (*s && *s != '\n') {
+		if (*s == ' ' || *s == '\t') {
+			s++;
+			continue;
+		}
+		if (*s < '0' || *s > '9') {
+			/* "samples" and "[unit]" */
+			while (*s && *s != ' ' && *s != '\t' && *s != '\n')
+				s++;
+			continue;
+		}
+		v = 0;
+		while (*s >= '0' && *s <= '9')
+			v = v * 10 + (*s++ - '0');
+		if (tok->n < sizeof(tok->v) / sizeof(tok->v[0]))
+			tok->v[tok->n++] = v;
+	}
+	if (*s == '\n')
+		s++;
+	return s;
+}
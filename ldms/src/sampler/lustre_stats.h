@@ -0,0 +1,37 @@
+/* -*- c-basic-offset: 8 -*- */
+/* Copyright 2026 Lawrence Livermore National Security, LLC
+ * See the top-level COPYING file for details.
+ *
+ * SPDX-License-Identifier: (GPL-2.0 OR BSD-3-Clause)
+ */
+#ifndef __LUSTRE_STATS_H
+#define __LUSTRE_STATS_H
+
+#include <inttypes.h>
+#include <sys/types.h>
+
+/* Parsing of the Lustre proc/debugfs "stats" files, shared by the lustre2_*
+ * and lustre_client samplers. */
+
+/* Read the whole file open on fd from offset 0 into *buf, growing *buf
+ * (of *buf_sz bytes) until the file fits. The result is '\0' terminated.
+ * Returns the number of bytes read or -errno. */
+ssize_t lustre_stats_pread(int fd, char **buf, size_t *buf_sz);
+
+/* One stats line:
+ *   {name} {count} samples [{unit}] [{min} {max} {sum} [{sum-of-square}]]
+ */
+struct lustre_stats_tok {
+	const char *key;
+	int key_len;
+	uint64_t hash;	/* FNV-1a hash of the key */
+	int n;		/* number of numeric fields stored in v[] */
+	uint64_t v[5];	/* count, min, max, sum, sum2 */
+};
+
+/* Tokenize the line at s in a single pass: the key is hashed while it is
+ * scanned and the numbers are converted in place, skipping "samples" and
+ * the unit. Returns the beginning of the next line. */
+char *lustre_stats_tok_line(char *s, struct lustre_stats_tok *tok);
+
+#endif /* __LUSTRE_STATS_H */
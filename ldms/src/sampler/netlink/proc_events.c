@@ -0,0 +1,313 @@
+/*
+ * Copyright (c) 2026 National Technology & Engineering Solutions
+ * of Sandia, LLC (NTESS). Under the terms of Contract DE-NA0003525 with
+ * NTESS, the U.S. Government retains certain rights in this software.
+ * Copyright (c) 2026 Open Grid Computing, Inc. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the BSD-type
+ * license below:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *      Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *      Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ *      Neither the name of Sandia nor the names of any contributors may
+ *      be used to endorse or promote products derived from this software
+ *      without specific prior written permission.
+ *
+ *      Neither the name of Open Grid Computing nor the names of any
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ *      Modified source versions must be plainly marked as such, and
+ *      must not be misrepresented as being the original software.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/queue.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+
+#include "proc_events.h"
+
+#define PROC_EV_RCVBUF (4*1024*1024)	/* room for bursts of short tasks */
+#define PROC_EV_BUFSZ 4096
+
+struct proc_ev_client_s {
+	int mask;
+	proc_ev_cb_t cb;
+	void *arg;
+	LIST_ENTRY(proc_ev_client_s) entry;
+};
+
+/* Serializes subscribe and unsubscribe */
+static pthread_mutex_t pe_mutex = PTHREAD_MUTEX_INITIALIZER;
+/* Protects pe_clients against the receiver thread */
+static pthread_rwlock_t pe_rwlock = PTHREAD_RWLOCK_INITIALIZER;
+static LIST_HEAD(, proc_ev_client_s) pe_clients = LIST_HEAD_INITIALIZER(pe_clients);
+static int pe_sock = -1;
+static int pe_pipe[2] = { -1, -1 }; /* wakes up the receiver to exit */
+static pthread_t pe_thread;
+
+static int pe_mcast_op(int sock, enum proc_cn_mcast_op op)
+{
+	struct nlmsghdr nlmsghdr;
+	struct cn_msg cn_msg;
+	struct iovec iov[3];
+
+	memset(&nlmsghdr, 0, sizeof(nlmsghdr));
+	nlmsghdr.nlmsg_len = NLMSG_LENGTH(sizeof(cn_msg) + sizeof(op));
+	nlmsghdr.nlmsg_type = NLMSG_DONE;
+	iov[0].iov_base = &nlmsghdr;
+	iov[0].iov_len = sizeof(nlmsghdr);
+
+	memset(&cn_msg, 0, sizeof(cn_msg));
+	cn_msg.id.idx = CN_IDX_PROC;
+	cn_msg.id.val = CN_VAL_PROC;
+	cn_msg.len = sizeof(op);
+	iov[1].iov_base = &cn_msg;
+	iov[1].iov_len = sizeof(cn_msg);
+
+	iov[2].iov_base = &op;
+	iov[2].iov_len = sizeof(op);
+
+	if (writev(sock, iov, 3) < 0)
+		return errno;
+	return 0;
+}
+
+static int pe_connect(void)
+{
+	struct sockaddr_nl addr;
+	int sock, sz, rc;
+
+	sock = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+	if (sock < 0)
+		return -errno;
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	addr.nl_groups = CN_IDX_PROC;
+	if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+		goto err;
+	sz = PROC_EV_RCVBUF;
+	if (setsockopt(sock, SOL_SOCKET, SO_RCVBUFFORCE, &sz, sizeof(sz)))
+		(void)setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &sz, sizeof(sz));
+	rc = pe_mcast_op(sock, PROC_CN_MCAST_LISTEN);
+	if (rc) {
+		errno = rc;
+		goto err;
+	}
+	return sock;
+ err:
+	rc = errno;
+	close(sock);
+	return -rc;
+}
+
+static void pe_deliver(const struct proc_ev *ev)
+{
+	struct proc_ev_client_s *c;
+
+	pthread_rwlock_rdlock(&pe_rwlock);
+	LIST_FOREACH(c, &pe_clients, entry) {
+		if (ev->type == PROC_EV_OVERRUN || (c->mask & ev->type))
+			c->cb(ev, c->arg);
+	}
+	pthread_rwlock_unlock(&pe_rwlock);
+}
+
+static void pe_process(const struct proc_event *pe)
+{
+	struct proc_ev ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.timestamp_ns = pe->timestamp_ns;
+	switch (pe->what) {
+	case PROC_EVENT_FORK:
+		ev.type = PROC_EV_FORK;
+		ev.pid = pe->event_data.fork.child_pid;
+		ev.tgid = pe->event_data.fork.child_tgid;
+		ev.ppid = pe->event_data.fork.parent_pid;
+		ev.ptgid = pe->event_data.fork.parent_tgid;
+		break;
+	case PROC_EVENT_EXEC:
+		ev.type = PROC_EV_EXEC;
+		ev.pid = pe->event_data.exec.process_pid;
+		ev.tgid = pe->event_data.exec.process_tgid;
+		break;
+	case PROC_EVENT_EXIT:
+		ev.type = PROC_EV_EXIT;
+		ev.pid = pe->event_data.exit.process_pid;
+		ev.tgid = pe->event_data.exit.process_tgid;
+		ev.exit_code = pe->event_data.exit.exit_code;
+		break;
+	default:
+		return;
+	}
+	pe_deliver(&ev);
+}
+
+static void *pe_proc(void *arg)
+{
+	char __attribute__((aligned(NLMSG_ALIGNTO))) buf[PROC_EV_BUFSZ];
+	struct pollfd pfd[2];
+	struct nlmsghdr *nlh;
+	struct cn_msg *cn;
+	struct proc_ev ev;
+	ssize_t len;
+
+	pfd[0].fd = pe_sock;
+	pfd[0].events = POLLIN;
+	pfd[1].fd = pe_pipe[0];
+	pfd[1].events = POLLIN;
+	while (1) {
+		if (poll(pfd, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		if (pfd[1].revents)
+			break;
+		len = recv(pe_sock, buf, sizeof(buf), MSG_DONTWAIT);
+		if (len < 0) {
+			if (errno == ENOBUFS) {
+				memset(&ev, 0, sizeof(ev));
+				ev.type = PROC_EV_OVERRUN;
+				pe_deliver(&ev);
+			}
+			continue;
+		}
+		for (nlh = (struct nlmsghdr *)buf; NLMSG_OK(nlh, len);
+		     nlh = NLMSG_NEXT(nlh, len)) {
+			if (nlh->nlmsg_type == NLMSG_ERROR ||
+			    nlh->nlmsg_type == NLMSG_NOOP)
+				continue;
+			cn = NLMSG_DATA(nlh);
+			if (cn->id.idx != CN_IDX_PROC || cn->id.val != CN_VAL_PROC)
+				continue;
+			pe_process((struct proc_event *)cn->data);
+		}
+	}
+	return NULL;
+}
+
+static int pe_start(void)
+{
+	int rc;
+
+	pe_sock = pe_connect();
+	if (pe_sock < 0) {
+		rc = -pe_sock;
+		goto err_0;
+	}
+	if (pipe2(pe_pipe, O_CLOEXEC)) {
+		rc = errno;
+		goto err_1;
+	}
+	rc = pthread_create(&pe_thread, NULL, pe_proc, NULL);
+	if (rc)
+		goto err_2;
+	pthread_setname_np(pe_thread, "proc_ev");
+	return 0;
+ err_2:
+	close(pe_pipe[0]);
+	close(pe_pipe[1]);
+	pe_pipe[0] = pe_pipe[1] = -1;
+ err_1:
+	close(pe_sock);
+	pe_sock = -1;
+ err_0:
+	return rc;
+}
+
+static void pe_stop(void)
+{
+	char c = 0;
+
+	(void)pe_mcast_op(pe_sock, PROC_CN_MCAST_IGNORE);
+	if (write(pe_pipe[1], &c, 1) == 1)
+		pthread_join(pe_thread, NULL);
+	close(pe_pipe[0]);
+	close(pe_pipe[1]);
+	pe_pipe[0] = pe_pipe[1] = -1;
+	close(pe_sock);
+	pe_sock = -1;
+}
+
+proc_ev_client_t proc_ev_subscribe(int mask, proc_ev_cb_t cb, void *arg)
+{
+	proc_ev_client_t c;
+	int rc;
+
+	if (!cb) {
+		errno = EINVAL;
+		return NULL;
+	}
+	c = calloc(1, sizeof(*c));
+	if (!c)
+		return NULL;
+	c->mask = mask;
+	c->cb = cb;
+	c->arg = arg;
+	pthread_mutex_lock(&pe_mutex);
+	if (pe_sock < 0) {
+		rc = pe_start();
+		if (rc) {
+			pthread_mutex_unlock(&pe_mutex);
+			free(c);
+			errno = rc;
+			return NULL;
+		}
+	}
+	pthread_rwlock_wrlock(&pe_rwlock);
+	LIST_INSERT_HEAD(&pe_clients, c, entry);
+	pthread_rwlock_unlock(&pe_rwlock);
+	pthread_mutex_unlock(&pe_mutex);
+	return c;
+}
+
+void proc_ev_unsubscribe(proc_ev_client_t c)
+{
+	pthread_mutex_lock(&pe_mutex);
+	pthread_rwlock_wrlock(&pe_rwlock);
+	LIST_REMOVE(c, entry);
+	pthread_rwlock_unlock(&pe_rwlock);
+	if (LIST_EMPTY(&pe_clients))
+		pe_stop();
+	pthread_mutex_unlock(&pe_mutex);
+	free(c);
+}
@@ -0,0 +1,113 @@
+#ifndef proc_events_h
+#define proc_events_h
+/*
+ * Copyright (c) 2026 National Technology & Engineering Solutions
+ * of Sandia, LLC (NTESS). Under the terms of Contract DE-NA0003525 with
+ * NTESS, the U.S. Government retains certain rights in this software.
+ * Copyright (c) 2026 Open Grid Computing, Inc. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the BSD-type
+ * license below:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *      Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *      Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ *      Neither the name of Sandia nor the names of any contributors may
+ *      be used to endorse or promote products derived from this software
+ *      without specific prior written permission.
+ *
+ *      Neither the name of Open Grid Computing nor the names of any
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ *      Modified source versions must be plainly marked as such, and
+ *      must not be misrepresented as being the original software.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * In-process source of Linux process lifetime events.
+ *
+ * The events come from the kernel proc connector (NETLINK_CONNECTOR,
+ * CN_IDX_PROC), the same interface ldms-netlink-notifier uses. Listening
+ * requires CAP_NET_ADMIN. All clients in a process share one netlink
+ * socket and one receiver thread; the socket is opened by the first
+ * proc_ev_subscribe() and closed by the last proc_ev_unsubscribe().
+ *
+ * Callbacks run on the receiver thread, one event at a time, and must
+ * not block for long: events arriving meanwhile are queued in the socket
+ * buffer and dropped by the kernel if it overflows. Lost events are
+ * reported to every client as PROC_EV_OVERRUN.
+ */
+
+enum proc_ev_type {
+	PROC_EV_FORK    = 0x1, /* a task was created */
+	PROC_EV_EXEC    = 0x2, /* a task called exec() */
+	PROC_EV_EXIT    = 0x4, /* a task exited */
+	PROC_EV_OVERRUN = 0x8, /* events were lost; always delivered */
+};
+
+struct proc_ev {
+	enum proc_ev_type type;
+	pid_t pid;	/* the task (thread) id */
+	pid_t tgid;	/* the process id; pid == tgid for the main thread */
+	pid_t ppid;	/* PROC_EV_FORK: the parent task id */
+	pid_t ptgid;	/* PROC_EV_FORK: the parent process id */
+	uint32_t exit_code; /* PROC_EV_EXIT: the wait(2) status */
+	uint64_t timestamp_ns; /* kernel monotonic time of the event */
+};
+
+typedef struct proc_ev_client_s *proc_ev_client_t;
+typedef void (*proc_ev_cb_t)(const struct proc_ev *ev, void *arg);
+
+/**
+ * \brief Subscribe to process events.
+ *
+ * \param mask A bitwise OR of the \c PROC_EV_FORK, \c PROC_EV_EXEC and
+ *             \c PROC_EV_EXIT event types to deliver.
+ * \param cb   The callback function.
+ * \param arg  The application context passed to \c cb.
+ *
+ * \retval c    The client handle.
+ * \retval NULL If there is an error; \c errno is set. \c EPERM means the
+ *              process lacks CAP_NET_ADMIN, \c EPROTONOSUPPORT that the
+ *              kernel has no proc connector.
+ */
+proc_ev_client_t proc_ev_subscribe(int mask, proc_ev_cb_t cb, void *arg);
+
+/**
+ * \brief Terminate the subscription.
+ *
+ * \c cb is not called for \c c after this function returns. This function
+ * must not be called from a proc_ev callback.
+ */
+void proc_ev_unsubscribe(proc_ev_client_t c);
+
+#endif
@@ -436,15 +436,17 @@ begin:
 	return 0;
 resize:
 	/*
-	 * We intend to leave the set in the inconsistent state so that
-	 * the aggregators are aware that some metrics have not been newly sampled.
+	 * Close the transaction before growing; the one begun again below
+	 * re-samples all interfaces into the larger heap. The set keeps its
+	 * identity; the aggregators resize their mirrors.
 	 */
-	base_set_delete(p->base);
-	base_set_new_heap(p->base, p->heap_sz);
-	if (!p->base->set) {
-		rc = errno;
-		ovis_log(p->mylog, OVIS_LCRITICAL, SAMP " : Failed to create a set with "
-						"a bigger heap. Error %d\n", rc);
+	base_sample_end(p->base);
+	p->heap_sz = 2 * ldms_set_heap_size_get(p->base->set);
+	rc = ldms_set_heap_grow(p->base->set, p->heap_sz);
+	if (rc) {
+		ovis_log(p->mylog, OVIS_LCRITICAL, SAMP " : Failed to grow the set "
+						"heap to %zu bytes. Error %d\n",
+						p->heap_sz, rc);
 		return rc;
 	}
 	goto begin;
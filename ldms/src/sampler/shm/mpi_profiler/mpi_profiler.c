@@ -84,6 +84,9 @@ static void (*shm_inc)(ldms_shm_set_t, int);
 
 static void (*shm_add)(ldms_shm_set_t, int, int);
 
+/* set when this rank writes into its own counter slab of the set */
+static int use_slab = 0;
+
 static unsigned int update_interval;
 static pthread_t ldms_shm_updater_thread;
 static ldms_shm_data_t *event_counters_thread_buffer = NULL;
@@ -185,6 +188,18 @@ static void clean_local_resources()
 	}
 }
 
+/*
+ * Publishes the local counters of this rank. With a slab the counters are
+ * assigned into the slab of the rank for both scopes, as the sampler sums
+ * the slabs of all node-local ranks.
+ */
+static void update_shm_from_local_counters()
+{
+	ldms_shm_slab_group_assign(profiler->shm_set, profiler->event_index_map,
+			profiler->local_mpi_event_counters,
+			profiler->num_base_events_with_types);
+}
+
 static int clean_updater_thread()
 {
 	int rc = 0;
@@ -205,7 +220,9 @@ static int clean_updater_thread()
 		}
 
 		/* last update */
-		if(LDMS_SHM_MPI_STAT_LOCAL == profiler->conf->scope) {
+		if(use_slab) {
+			update_shm_from_local_counters();
+		} else if(LDMS_SHM_MPI_STAT_LOCAL == profiler->conf->scope) {
 			ldms_shm_counter_group_assign(profiler->shm_set,
 					profiler->event_index_map,
 					profiler->local_mpi_event_counters,
@@ -263,8 +280,9 @@ static void clean_profiler()
 {
 	if(log_level_info())
 		printf("INFO: %d: cleaning profiler\n\r", profiler->rankid);
-	clean_shared_resources();
+	/* the updater thread makes its last update before the writer leaves */
 	clean_updater_thread();
+	clean_shared_resources();
 	clean_local_resources();
 }
 
@@ -321,7 +339,9 @@ void *ldms_shm_periodic_update(void *ignored)
 				profiler->rankid);
 	while(should_update_shm) {
 
-		if(profiler->conf->scope == LDMS_SHM_MPI_STAT_LOCAL) {
+		if(use_slab) {
+			update_shm_from_local_counters();
+		} else if(profiler->conf->scope == LDMS_SHM_MPI_STAT_LOCAL) {
 			ldms_shm_counter_group_assign(profiler->shm_set,
 					profiler->event_index_map,
 					profiler->local_mpi_event_counters,
@@ -458,13 +478,6 @@ static int config_profiler()
 				mpi_profiler_log_level_str);
 	}
 	profile_log_level = profiler->conf->profile_log_level;
-
-	if(LDMS_SHM_MPI_EVENT_UPDATE_LOCAL
-			== profiler->conf->event_update_type) {
-		int rc = config_updater_thread();
-		if(rc)
-			return rc;
-	}
 	return rc;
 }
 
@@ -526,6 +539,38 @@ static int init_profiler()
 	return 0;
 }
 
+/*
+ * number of ranks that share the node with this rank, which is the number of
+ * writers of the set, or 0 if it can not be determined
+ */
+static int node_local_ranks()
+{
+	int size = 0;
+#if MPI_VERSION >= 3
+	MPI_Comm node_comm;
+	if(MPI_SUCCESS != PMPI_Comm_split_type(MPI_COMM_WORLD,
+			MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node_comm))
+		return 0;
+	PMPI_Comm_size(node_comm, &size);
+	PMPI_Comm_free(&node_comm);
+#endif
+	return size;
+}
+
+static void config_slab()
+{
+	if(ldms_shm_set_slab_claim(profiler->shm_set)) {
+		if(log_level_info())
+			printf(
+					"INFO: %d: no free counter slab, updating the shared counters\n\r",
+					profiler->rankid);
+		return;
+	}
+	use_slab = 1;
+	shm_inc = &ldms_shm_slab_counter_inc;
+	shm_add = &ldms_shm_slab_counter_add;
+}
+
 static void clean_on_init_error(char **events_desc, int *num_elements_per_event)
 {
 	clean_local_after_init(events_desc, num_elements_per_event);
@@ -583,11 +628,12 @@ void post_init_call()
 	build_fs_location_name();
 	build_set_label();
 
-	profiler->shm_set = ldms_shm_index_register_set(
+	profiler->shm_set = ldms_shm_index_register_set_slabs(
 			profiler->ldms_shm_set_label,
 			profiler->ldms_shm_set_fslocation,
 			profiler->num_base_events_with_types,
-			num_elements_per_event, events_desc);
+			num_elements_per_event, events_desc,
+			node_local_ranks());
 
 	if(profiler->shm_set == NULL) {
 		clean_on_init_error(events_desc, num_elements_per_event);
@@ -600,6 +646,21 @@ void post_init_call()
 					profiler->total_num_events,
 					profiler->ldms_shm_set_label,
 					profiler->ldms_shm_set_fslocation);
+		config_slab();
+	}
+
+	/* the updater thread publishes into the set, so it starts once the
+	 * set is registered */
+	if(LDMS_SHM_MPI_EVENT_UPDATE_LOCAL
+			== profiler->conf->event_update_type) {
+		rc = config_updater_thread();
+		if(rc) {
+			printf("ERROR: failed to start the updater thread\n\r");
+			clean_on_init_error(events_desc,
+					num_elements_per_event);
+			post_Pcontrol_call(0);
+			return;
+		}
 	}
 
 	clean_local_after_init(events_desc, num_elements_per_event);
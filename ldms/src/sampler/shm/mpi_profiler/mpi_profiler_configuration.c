@@ -142,8 +142,8 @@ static char** prase_conf(const char *conf, const char *delim, int *count_tokens)
 			tokens[index] = strdup(ecp->param);
 			index--;
 		}
-		LIST_FOREACH(ecp, &conf_token_list, entry)
-		{
+		while((ecp = LIST_FIRST(&conf_token_list))) {
+			LIST_REMOVE(ecp, entry);
 			free(ecp->param);
 			free(ecp);
 		}
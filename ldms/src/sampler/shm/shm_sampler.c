@@ -367,10 +367,18 @@ static int create_base_for_box(ldms_shm_box_t *box, const char* schema_name,
 	box->base->job_end_idx = initial_base_config->job_end_idx;
 	box->base->job_id_idx = initial_base_config->job_id_idx;
 	box->base->job_start_idx = initial_base_config->job_start_idx;
+	box->base->job_slot_list_idx = initial_base_config->job_slot_list_idx;
+	box->base->job_slot_list_tail_idx =
+			initial_base_config->job_slot_list_tail_idx;
+	box->base->job_list_idx = initial_base_config->job_list_idx;
 	box->base->auth.uid = initial_base_config->auth.uid;
 	box->base->auth.gid = initial_base_config->auth.gid;
 	box->base->auth.perm = initial_base_config->auth.perm;
+	box->base->set_array_card = initial_base_config->set_array_card;
+	box->base->mylog = initial_base_config->mylog;
 
+	box->base->cfg_name = strdup(initial_base_config->cfg_name);
+	box->base->job_set_name = strdup(initial_base_config->job_set_name);
 	box->base->producer_name = strdup(initial_base_config->producer_name);
 	box->base->schema_name = strdup(schema_name);
 	box->base->instance_name = strdup(instance_name);
@@ -692,14 +700,17 @@ static int get_updates_from_index()
 	return rc;
 }
 
+/*
+ * The scan does not take the index lock: entries are read under their
+ * seqlocks and the reader registration validates the entry on its own, so
+ * writers registering and leaving are not stalled by the sampler.
+ */
 static int check_for_index_update()
 {
 	int rc = 0;
-	ldms_shm_index_lock();
 
 	uint64_t gen = ldms_shm_gn_get(box_cache.index);
 	if(!index_changed(gen)) {
-		ldms_shm_index_unlock();
 		return rc;
 	}
 	ovis_log(mylog, OVIS_LINFO,
@@ -709,8 +720,6 @@ static int check_for_index_update()
 
 	rc = get_updates_from_index();
 
-	ldms_shm_index_unlock();
-
 	return rc;
 }
 
@@ -881,7 +890,7 @@ static int config(ldmsd_plug_handle_t handle, struct attr_value_list *kwl,
 		return rc;
 	}
 
-	rc = shm_sampler_config(context, avl);
+	rc = shm_sampler_config(handle, avl);
 
 	if(rc) {
 		ovis_log(mylog, OVIS_LERROR, "failed to config shm_sampler\n");
@@ -907,6 +916,7 @@ static int sample_set(ldmsd_plug_handle_t handle, ldms_shm_box_t *box)
 {
 
 	int shm_metric_index, ldms_metric_index;
+	ldms_shm_set_snapshot(box->shm_set);
 	base_sample_begin(box->base);
 	for(shm_metric_index = 0;
 			shm_metric_index < box->shm_set->meta->num_events;
@@ -957,7 +967,7 @@ static int sample(ldmsd_plug_handle_t handle)
 	int i;
 	for(i = 0; i < box_cache.box_len; i++) {
 		if(is_active(&boxes[i])) {
-			rc = sample_set(context, &boxes[i]);
+			rc = sample_set(handle, &boxes[i]);
 			if(rc) {
 				ovis_log(mylog, OVIS_LERROR,
 						"failed to sample the set %s\n",
@@ -998,8 +1008,6 @@ static int constructor(ldmsd_plug_handle_t handle)
 
 static void destructor(ldmsd_plug_handle_t handle)
 {
-	ldms_shm_index_lock();
-
 	int index_should_be_cleaned = 1, i;
 	for(i = 0; i < box_cache.box_len; i++) {
 		ldms_shm_box_t *box = &boxes[i];
@@ -1016,7 +1024,6 @@ static void destructor(ldmsd_plug_handle_t handle)
 			index_should_be_cleaned = 0;
 		}
 	}
-	ldms_shm_index_unlock();
 	if(index_should_be_cleaned
 			&& ldms_shm_index_is_empty(box_cache.index)) {
 		ldms_shm_index_clean_shared_resources(box_cache.index);
@@ -55,6 +55,7 @@
 #include <stdlib.h>
 #include <inttypes.h>
 #include <errno.h>
+#include <unistd.h>
 
 #include "third/city.h"
 
@@ -66,10 +67,25 @@ static inline void ldms_shm_init_meta_pointer(void *addr, ldms_shm_set_t set)
 	set->meta = addr;
 }
 
-static void ldms_shm_init_meta(void *addr, ldms_shm_set_t set, int num_events)
+static void ldms_shm_init_meta(void *addr, ldms_shm_set_t set, int num_events,
+		int num_slabs)
 {
 	ldms_shm_init_meta_pointer(addr, set);
 	set->meta->num_events = num_events;
+	set->meta->num_slabs = num_slabs;
+	ldms_shm_seqlock_init(&set->meta->fold_lock);
+}
+
+static inline int cache_line_align(int len)
+{
+	return (len + LDMS_SHM_CACHE_LINE - 1) & ~(LDMS_SHM_CACHE_LINE - 1);
+}
+
+static inline int slab_stride(int total_events)
+{
+	return sizeof(struct ldms_shm_slab_hdr)
+			+ cache_line_align(
+					total_events * sizeof(ldms_shm_data_t));
 }
 
 static inline int ldms_shm_find_events_offset(ldms_shm_set_t set)
@@ -116,13 +132,40 @@ static inline void ldms_shm_init_data_pointer(ldms_shm_set_t set)
 			+ ldms_shm_find_data_offset(set));
 }
 
+static inline int ldms_shm_find_slabs_offset(ldms_shm_set_t set)
+{
+	return cache_line_align(ldms_shm_find_data_offset(set)
+			+ set->meta->total_events * sizeof(ldms_shm_data_t));
+}
+
+static inline ldms_shm_slab_hdr_t get_slab(ldms_shm_set_t set, int i)
+{
+	return ((void *)set->meta) + ldms_shm_find_slabs_offset(set)
+			+ i * set->meta->slab_stride;
+}
+
+static inline ldms_shm_data_t* get_slab_data(ldms_shm_slab_hdr_t slab)
+{
+	return (ldms_shm_data_t*)(slab + 1);
+}
+
 static void ldms_shm_data_init(ldms_shm_set_t set)
 {
-	int e;
+	int e, s;
 	ldms_shm_init_data_pointer(set);
 	for(e = 0; e < set->meta->total_events; e++) {
 		set->data[e].val = 0;
 	}
+	set->meta->slab_stride = slab_stride(set->meta->total_events);
+	for(s = 0; s < set->meta->num_slabs; s++) {
+		ldms_shm_slab_hdr_t slab = get_slab(set, s);
+		ldms_shm_data_t *slab_data = get_slab_data(slab);
+		ldms_shm_robust_mutex_init(&slab->owner_mutex);
+		slab->owner = 0;
+		slab->write_count = 0;
+		for(e = 0; e < set->meta->total_events; e++)
+			slab_data[e].val = 0;
+	}
 }
 
 ldms_shm_event_desc_t* ldms_shm_set_get_event(ldms_shm_set_t set,
@@ -175,19 +218,24 @@ static void ldms_shm_add_events(ldms_shm_set_t set, int num_events,
 }
 
 static int ldms_shm_calc_set_size(int num_events, int *num_elements_per_event,
-		char **event_names)
+		char **event_names, int num_slabs)
 {
 	int meta_len = sizeof(struct ldms_shm_meta);
 	int events_len = 0;
 	int data_len = 0;
+	int total_events = 0;
 
 	int i;
 	for(i = 0; i < num_events; i++) {
 		events_len += sizeof(struct ldms_shm_event_desc)
 				+ strlen(event_names[i]) + 1;
 		data_len += num_elements_per_event[i] * sizeof(ldms_shm_data_t);
+		total_events += num_elements_per_event[i];
 	}
-	return meta_len + meta_len + data_len;
+	if(!num_slabs)
+		return meta_len + events_len + data_len;
+	return cache_line_align(meta_len + events_len + data_len)
+			+ num_slabs * slab_stride(total_events);
 }
 
 /* FIXME
@@ -217,7 +265,8 @@ uint64_t ldms_shm_set_calc_checksum(ldms_shm_set_t set)
  * creates an object of type ldms_shm_set and initialized the shared memory, and set the pointers in the ldms_shm_set
  */
 static ldms_shm_set_t create_ldms_shm_set(ldms_shm_obj_t shm_obj,
-		int num_events, int *num_elements_per_event, char **event_names)
+		int num_events, int *num_elements_per_event, char **event_names,
+		int num_slabs)
 {
 	int rc;
 	ldms_shm_set_t set = calloc(1, sizeof(*set));
@@ -226,7 +275,7 @@ static ldms_shm_set_t create_ldms_shm_set(ldms_shm_obj_t shm_obj,
 		return NULL;
 	}
 
-	ldms_shm_init_meta(shm_obj->addr, set, num_events);
+	ldms_shm_init_meta(shm_obj->addr, set, num_events, num_slabs);
 
 	ldms_shm_init_events_pointer(set);
 
@@ -234,6 +283,7 @@ static ldms_shm_set_t create_ldms_shm_set(ldms_shm_obj_t shm_obj,
 			event_names);
 
 	ldms_shm_data_init(set);
+	set->view = set->data;
 
 	rc = ldms_shm_set_init_event_index_map(set);
 	if(rc) {
@@ -251,6 +301,13 @@ void ldms_shm_clear_set(ldms_shm_set_t set)
 	set->meta = NULL;
 	set->events = NULL;
 	set->data = NULL;
+	set->view = NULL;
+	set->slab = NULL;
+	set->slab_data = NULL;
+	if(NULL != set->snapshot) {
+		free(set->snapshot);
+		set->snapshot = NULL;
+	}
 	if(NULL != set->entry) {
 		ldms_shm_clear_index_entry(set->entry);
 		free(set->entry);
@@ -280,6 +337,7 @@ ldms_shm_set_t ldms_shm_set_get(ldms_shm_obj_t shm_obj)
 	ldms_shm_init_events_pointer(set);
 
 	ldms_shm_init_data_pointer(set);
+	set->view = set->data;
 
 	rc = ldms_shm_set_init_event_index_map(set);
 
@@ -302,8 +360,63 @@ int ldms_shm_set_deregister_reader(ldms_shm_set_t set)
 	return ldms_shm_index_entry_deregister_reader(set->entry);
 }
 
+/**
+ * adds the counters of a slab to the data and clears the slab. The fold is
+ * done under the fold seqlock so that a concurrent snapshot does not count
+ * the same values twice.
+ */
+static void ldms_shm_slab_fold(ldms_shm_set_t set, ldms_shm_slab_hdr_t slab)
+{
+	ldms_shm_data_t *slab_data = get_slab_data(slab);
+	int e;
+	ldms_shm_seq_write_lock(&set->meta->fold_lock);
+	for(e = 0; e < set->meta->total_events; e++) {
+		if(!slab_data[e].val)
+			continue;
+		__sync_fetch_and_add(&set->data[e].val, slab_data[e].val);
+		slab_data[e].val = 0;
+	}
+	slab->write_count = 0;
+	ldms_shm_seq_write_unlock(&set->meta->fold_lock);
+}
+
+int ldms_shm_set_slab_claim(ldms_shm_set_t set)
+{
+	int s, rc;
+	if(NULL != set->slab)
+		return 0;
+	for(s = 0; s < set->meta->num_slabs; s++) {
+		ldms_shm_slab_hdr_t slab = get_slab(set, s);
+		/* the kernel releases the robust mutex of a writer that died */
+		rc = pthread_mutex_trylock(&slab->owner_mutex);
+		if(EOWNERDEAD == rc) {
+			ldms_shm_slab_fold(set, slab);
+			pthread_mutex_consistent(&slab->owner_mutex);
+		} else if(rc) {
+			continue;
+		}
+		slab->owner = getpid();
+		set->slab = slab;
+		set->slab_data = get_slab_data(slab);
+		return 0;
+	}
+	return ENOSPC;
+}
+
+static void ldms_shm_set_slab_release(ldms_shm_set_t set)
+{
+	if(NULL == set->slab)
+		return;
+	ldms_shm_slab_fold(set, set->slab);
+	set->slab->owner = 0;
+	pthread_mutex_unlock(&set->slab->owner_mutex);
+	set->slab = NULL;
+	set->slab_data = NULL;
+}
+
 int ldms_shm_set_deregister_writer(ldms_shm_set_t set)
 {
+	ldms_shm_set_slab_release(set);
 	return ldms_shm_index_entry_deregister_writer(set->entry);
 }
 
@@ -321,6 +434,15 @@ ldms_shm_set_t ldms_shm_index_register_set(const char *setlabel,
 		const char *fslocation, int num_events,
 		int *num_elements_per_event, char **event_names)
 {
+	return ldms_shm_index_register_set_slabs(setlabel, fslocation,
+			num_events, num_elements_per_event, event_names, 0);
+}
+
+ldms_shm_set_t ldms_shm_index_register_set_slabs(const char *setlabel,
+		const char *fslocation, int num_events,
+		int *num_elements_per_event, char **event_names,
+		int num_slabs)
+{
 
 	ldms_shm_index_entry_t entry = ldms_shm_index_add_entry(setlabel,
 			fslocation);
@@ -332,14 +454,10 @@ ldms_shm_set_t ldms_shm_index_register_set(const char *setlabel,
 	}
 
 	int set_size = ldms_shm_calc_set_size(num_events,
-			num_elements_per_event, event_names);
-
-	ldms_shm_index_lock();
+			num_elements_per_event, event_names, num_slabs);
 
 	ldms_shm_obj_t shm_obj = ldms_shm_init(fslocation, set_size);
 
-	ldms_shm_index_unlock();
-
 	if(shm_obj == NULL) {
 		printf(
 				"Memory allocation error! failed to register the set with label \"%s\" in the location \"%s\" of the index\n\r",
@@ -353,7 +471,8 @@ ldms_shm_set_t ldms_shm_index_register_set(const char *setlabel,
 
 	if(is_first_updater(entry)) {
 		set = create_ldms_shm_set(shm_obj, num_events,
-				num_elements_per_event, event_names);
+				num_elements_per_event, event_names,
+				num_slabs);
 		entry->p->schema_checksum = ldms_shm_set_calc_checksum(set);
 	} else {
 		set = ldms_shm_set_get(shm_obj);
@@ -416,16 +535,57 @@ ldms_shm_set_t ldms_shm_data_open(ldms_shm_index_entry_t entry)
  */
 ldms_shm_data_t ldms_shm_event_read(ldms_shm_set_t set, int event_index)
 {
-	/*FIXME lock? */
 	set->entry->p->read_count++;
-	return set->data[event_index];
+	return set->view[set->event_index_map[event_index]];
 }
 
 ldms_shm_data_t* ldms_shm_event_array_read(ldms_shm_set_t set, int event_index)
 {
-	/*FIXME lock? */
 	set->entry->p->read_count++;
-	return &set->data[set->event_index_map[event_index]];
+	return &set->view[set->event_index_map[event_index]];
+}
+
+ldms_shm_data_t* ldms_shm_set_snapshot(ldms_shm_set_t set)
+{
+	int total_events = set->meta->total_events;
+	uint64_t seq, slab_writes;
+	int e, s;
+
+	if(0 == set->meta->num_slabs) {
+		set->view = set->data;
+		return set->view;
+	}
+	if(NULL == set->snapshot) {
+		set->snapshot = calloc(total_events, sizeof(ldms_shm_data_t));
+		if(NULL == set->snapshot) {
+			printf("ERROR: failed to allocate memory for the snapshot\n\r");
+			set->view = set->data;
+			return set->view;
+		}
+	}
+	do {
+		seq = ldms_shm_seq_read_begin(&set->meta->fold_lock);
+		slab_writes = 0;
+		for(e = 0; e < total_events; e++)
+			set->snapshot[e].val = __atomic_load_n(
+					&set->data[e].val, __ATOMIC_RELAXED);
+		for(s = 0; s < set->meta->num_slabs; s++) {
+			ldms_shm_slab_hdr_t slab = get_slab(set, s);
+			ldms_shm_data_t *slab_data = get_slab_data(slab);
+			if(!__atomic_load_n(&slab->write_count,
+					__ATOMIC_RELAXED))
+				continue;
+			slab_writes += slab->write_count;
+			for(e = 0; e < total_events; e++)
+				set->snapshot[e].val += __atomic_load_n(
+						&slab_data[e].val,
+						__ATOMIC_RELAXED);
+		}
+	} while(ldms_shm_seq_read_retry(&set->meta->fold_lock, seq));
+	if(NULL != set->entry)
+		set->entry->p->slab_write_count = slab_writes;
+	set->view = set->snapshot;
+	return set->view;
 }
 
 static inline void increment_write_counter(ldms_shm_set_t set)
@@ -469,6 +629,42 @@ void ldms_shm_non_atomic_counter_add(ldms_shm_set_t set,
 	set->data[event_element_index].val += val_to_inc;
 }
 
+static inline void increment_slab_write_counter(ldms_shm_set_t set)
+{
+	__atomic_store_n(&set->slab->write_count, set->slab->write_count + 1,
+			__ATOMIC_RELAXED);
+}
+
+/*
+ * The slab functions rely on the slab having a single writer: a plain
+ * load followed by a relaxed store is enough, the store only keeps the
+ * compiler from tearing the 64-bit value that readers load concurrently.
+ */
+void ldms_shm_slab_counter_inc(ldms_shm_set_t set, int event_element_index)
+{
+	ldms_shm_data_t *d = &set->slab_data[event_element_index];
+	increment_slab_write_counter(set);
+	__atomic_store_n(&d->val, d->val + 1, __ATOMIC_RELAXED);
+}
+
+void ldms_shm_slab_counter_add(ldms_shm_set_t set, int event_element_index,
+		int val_to_inc)
+{
+	ldms_shm_data_t *d = &set->slab_data[event_element_index];
+	increment_slab_write_counter(set);
+	__atomic_store_n(&d->val, d->val + val_to_inc, __ATOMIC_RELAXED);
+}
+
+void ldms_shm_slab_group_assign(ldms_shm_set_t set, int *event_element_indexes,
+		ldms_shm_data_t* vals_to_assign, int count_events)
+{
+	int i;
+	increment_slab_write_counter(set);
+	for(i = 0; i < count_events; i++)
+		__atomic_store_n(&set->slab_data[event_element_indexes[i]].val,
+				vals_to_assign[i].val, __ATOMIC_RELAXED);
+}
+
 void ldms_shm_counter_group_assign(ldms_shm_set_t set,
 		int *event_element_indexes, ldms_shm_data_t* vals_to_assign,
 		int count_events)
@@ -72,6 +72,9 @@ typedef struct ldms_shm_event_desc {
 typedef struct ldms_shm_meta {
 	int total_events; /* num_elements * num_events*/
 	int num_events; /* number of events for the set */
+	int num_slabs; /* number of per-writer counter slabs that follow the data */
+	int slab_stride; /* distance in bytes between two consecutive slabs */
+	ldms_shm_seqlock_t fold_lock; /* guards the fold of a released slab into the data */
 }*ldms_shm_meta_t;
 
 /**
@@ -81,6 +84,20 @@ typedef struct ldms_shm_data {
 	uint64_t val; /* The counter value for the event *//* TODO make this double datatype */
 } ldms_shm_data_t;
 
+#define LDMS_SHM_CACHE_LINE 64
+
+/**
+ * header of a per-writer counter slab. Each slab starts on its own cache line
+ * and is written by the single process that owns it, so writers on the same
+ * node never contend on the same line. Readers sum the slabs into the data.
+ */
+struct ldms_shm_slab_hdr {
+	pthread_mutex_t owner_mutex; /* robust, held by the writer thread that claimed the slab */
+	volatile uint64_t owner; /* pid of the writer that claimed the slab, 0 if free (informational) */
+	volatile uint64_t write_count; /* number of writes to this slab */
+} __attribute__((aligned(LDMS_SHM_CACHE_LINE)));
+typedef struct ldms_shm_slab_hdr *ldms_shm_slab_hdr_t;
+
 /**
  * structure to keep the pointers to the specific required offsets in the shared memory
  */
@@ -90,6 +107,10 @@ typedef struct ldms_shm_set {
 	ldms_shm_meta_t meta; /* pointer to the location of the metadata for this set in the shared memory  */
 	ldms_shm_event_desc_t *events; /* pointer to the staring point of the events for this set in the shared memory  */
 	ldms_shm_data_t *data; /* pointer to the staring point of the data for this set in the shared memory  */
+	ldms_shm_slab_hdr_t slab; /* slab claimed by this writer, NULL if none */
+	ldms_shm_data_t *slab_data; /* counters of the claimed slab */
+	ldms_shm_data_t *snapshot; /* reader-local sum of the data and all slabs */
+	ldms_shm_data_t *view; /* values returned by the read functions, either data or snapshot */
 }*ldms_shm_set_t;
 
 /**
@@ -153,12 +174,20 @@ ldms_shm_set_t ldms_shm_data_open(ldms_shm_index_entry_t entry);
 int ldms_shm_set_is_active(ldms_shm_set_t set);
 /**
  * \brief deregister a reader from this set
- * caller should hold the lock on the index, before calling this
  *
  * \param entry
  * \return the number of remaining users (reader/writer) of the set
  */
 int ldms_shm_set_deregister_reader(ldms_shm_set_t set);
+/**
+ * \brief fold the data and all the writer slabs of the set into a consistent local view
+ * The following ldms_shm_event_read() and ldms_shm_event_array_read() calls
+ * return values from this view. Sets without slabs are read in place.
+ *
+ * \param set
+ * \return the view that the read functions return values from
+ */
+ldms_shm_data_t* ldms_shm_set_snapshot(ldms_shm_set_t set);
 /**
  * \brief reads the value of counter for the event specified by 'event_index' using the information provided by 'set'
  *
@@ -190,6 +219,36 @@ ldms_shm_data_t* ldms_shm_event_array_read(ldms_shm_set_t set, int event_index);
 ldms_shm_set_t ldms_shm_index_register_set(const char *setlabel,
 		const char *fslocation, int num_events,
 		int *num_elements_per_event, char **event_names);
+/**
+ * \brief register as the writer for a set that has per-writer counter slabs
+ * The number of slabs is decided by the first writer of the set, later writers
+ * share the layout that is already in the shared memory.
+ *
+ * \param setlabel Name of the metric set
+ * \param fslocation Name of the shared memory location that the information related to metric set is retained
+ * \param num_events Number of events in this set
+ * \param num_elements_per_event Number of elements for each event
+ * \param event_names Name of each event
+ * \param num_slabs Number of writer slabs, typically the number of node-local writers
+ * \return shm_set if the registration has been done successfully
+ * \return NULL if the registration failed
+ */
+ldms_shm_set_t ldms_shm_index_register_set_slabs(const char *setlabel,
+		const char *fslocation, int num_events,
+		int *num_elements_per_event, char **event_names,
+		int num_slabs);
+/**
+ * \brief claim a free counter slab of the set for this process
+ * The slab is owned by the calling thread until ldms_shm_set_deregister_writer()
+ * is called from the same thread. A slab left behind by a writer that died is
+ * detected through its robust owner mutex (independent of PID namespaces and
+ * PID reuse), folded into the data and reused.
+ *
+ * \param set
+ * \return 0 if a slab was claimed
+ * \return ENOSPC if the set has no free slab
+ */
+int ldms_shm_set_slab_claim(ldms_shm_set_t set);
 /**
  * \brief deregister a writer from this set
  *
@@ -230,6 +289,32 @@ void ldms_shm_atomic_counter_add(ldms_shm_set_t set, int event_element_index,
  */
 void ldms_shm_non_atomic_counter_add(ldms_shm_set_t set,
 		int event_element_index, int val_to_inc);
+/**
+ * \brief increment the counter of the event in the slab claimed by this writer
+ *
+ * \param set
+ * \param event_element_index the index of element of the event that is going to be incremented
+ */
+void ldms_shm_slab_counter_inc(ldms_shm_set_t set, int event_element_index);
+/**
+ * \brief add a value to the counter of the event in the slab claimed by this writer
+ *
+ * \param set
+ * \param event_element_index the index of element of the event that is going to be updated
+ * \param val_to_inc The value to be added to the counter
+ */
+void ldms_shm_slab_counter_add(ldms_shm_set_t set, int event_element_index,
+		int val_to_inc);
+/**
+ * \brief assign values to the counters of the events in the slab claimed by this writer
+ *
+ * \param set
+ * \param event_element_indexes the index array of elements of the events that are going to be updated
+ * \param vals_to_assign The values to be assigned to the counters
+ * \param count_events number Number of events to be updated
+ */
+void ldms_shm_slab_group_assign(ldms_shm_set_t set, int *event_element_indexes,
+		ldms_shm_data_t* vals_to_assign, int count_events);
 /**
  * \brief non-atomically assign values to the counter of the events specified by the event_element_indexes in set
  *
@@ -55,6 +55,7 @@
 #include <inttypes.h>
 #include <stddef.h>
 #include <fcntl.h> /* For O_* constants */
+#include <pthread.h>
 #include <sys/time.h>
 #include <string.h>
 #include <errno.h>
@@ -63,11 +64,9 @@
 #include "ldms_shm_index.h"
 #include "ovis_util/util.h" /* for strerror macro only */
 
-#define LDMS_SHM_GLOBAL_SEM_MUTEX_NAME_PREFIX "/ldms_shm_global_mutex"
-static char* ldms_shm_global_sem_mutex_name;
-static sem_t *mutex_sem = NULL;
+/* serializes ldms_shm_index_open() among the threads of this process */
+static pthread_mutex_t open_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-static char* ldms_shm_index_mutex_name;
 static ldms_shm_index_t shm_index = NULL;
 
 static inline double get_second(struct timeval time)
@@ -92,13 +91,74 @@ static int calc_index_mem_size(int max_entries, int metric_max, int array_max)
 
 static inline int index_is_initialized()
 {
-	return (LDMS_SHM_INDEX_STATE_INITIALIZED == shm_index->p->state);
+	return (LDMS_SHM_INDEX_STATE_INITIALIZED
+			== __atomic_load_n(&shm_index->p->state,
+					__ATOMIC_ACQUIRE));
+}
+
+int ldms_shm_robust_mutex_init(pthread_mutex_t *mutex)
+{
+	pthread_mutexattr_t attr;
+	int rc;
+
+	rc = pthread_mutexattr_init(&attr);
+	if(rc)
+		return rc;
+	rc = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+	if(!rc)
+		rc = pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+	if(!rc)
+		rc = pthread_mutex_init(mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+	return rc;
+}
+
+int ldms_shm_seqlock_init(ldms_shm_seqlock_t *lock)
+{
+	lock->seq = 0;
+	return ldms_shm_robust_mutex_init(&lock->mutex);
+}
+
+/* the owner of the mutex died; its update is incomplete, give it up */
+static void seq_owner_died(ldms_shm_seqlock_t *lock)
+{
+	uint64_t s = __atomic_load_n(&lock->seq, __ATOMIC_RELAXED);
+	printf("Warning: a writer of the shm index died while holding a lock, recovering\n\r");
+	if(s & 1)
+		__atomic_store_n(&lock->seq, s + 1, __ATOMIC_RELEASE);
+	pthread_mutex_consistent(&lock->mutex);
+}
+
+void ldms_shm_seq_write_lock(ldms_shm_seqlock_t *lock)
+{
+	int rc = pthread_mutex_lock(&lock->mutex);
+	if(EOWNERDEAD == rc)
+		seq_owner_died(lock);
+	__atomic_add_fetch(&lock->seq, 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void ldms_shm_seq_write_unlock(ldms_shm_seqlock_t *lock)
+{
+	__atomic_add_fetch(&lock->seq, 1, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&lock->mutex);
+}
+
+void ldms_shm_seq_recover(ldms_shm_seqlock_t *lock)
+{
+	/* a live writer holds the mutex for as long as the sequence is odd */
+	int rc = pthread_mutex_trylock(&lock->mutex);
+	if(EOWNERDEAD == rc)
+		seq_owner_died(lock);
+	else if(rc)
+		return;
+	pthread_mutex_unlock(&lock->mutex);
 }
 
 static void initialize_index(const char *name, int max_entries,
 		int shm_set_timeout)
 {
-	shm_index->p->state = LDMS_SHM_INDEX_STATE_INITIALIZED;
+	ldms_shm_seqlock_init(&shm_index->p->lock);
 	shm_index->p->generation_number = 0;
 	shm_index->p->instance_count = 0;
 	shm_index->p->max_entries = max_entries;
@@ -108,10 +168,13 @@ static void initialize_index(const char *name, int max_entries,
 	for(i = 0; i < shm_index->p->max_entries; i++) {
 		ldms_shm_index_entry_properties_t *ip =
 				&shm_index->instance_list[i];
+		ldms_shm_seqlock_init(&ip->lock);
 		ip->state = LDMS_SHM_INDEX_ENTRY_STATE_EMPTY;
 		ip->cnt_rdr = 0;
 		ip->cnt_updtr = 0;
 	}
+	__atomic_store_n(&shm_index->p->state,
+			LDMS_SHM_INDEX_STATE_INITIALIZED, __ATOMIC_RELEASE);
 }
 
 static int allocate_shared_resources(const char *name, int max_entries,
@@ -132,18 +195,6 @@ static int allocate_shared_resources(const char *name, int max_entries,
 
 	shm_index->p = shm_obj->addr;
 
-	if((shm_index->mutex_sem = sem_open(ldms_shm_index_mutex_name, O_CREAT,
-			0660, 1)) == SEM_FAILED) {
-		printf(
-				"Error in shm index initialization: failed to open a semaphore with the name %s\n\r",
-				ldms_shm_index_mutex_name);
-		free(shm_index);
-		shm_index = NULL;
-		free(shm_obj->name);
-		free(shm_obj);
-		return -1;
-	}
-
 	shm_index->instance_list = ((void*)shm_obj->addr
 			+ sizeof(struct ldms_shm_index_properties));
 	free(shm_obj->name);
@@ -172,16 +223,27 @@ static ldms_shm_index_t ldms_shm_index_init(const char *name, int max_entries,
 		return NULL;
 	}
 
-	ldms_shm_index_lock();
-
-	if(index_is_initialized()) {
-		ldms_shm_index_unlock();
+	/* The first process to move the state out of UNINITIALIZED sets up
+	 * the index; everybody else waits for it to publish INITIALIZED. */
+	enum ldms_shm_index_state state = LDMS_SHM_INDEX_STATE_UNINITIALIZED;
+	if(__atomic_compare_exchange_n(&shm_index->p->state, &state,
+			LDMS_SHM_INDEX_STATE_INITIALIZING, 0, __ATOMIC_ACQUIRE,
+			__ATOMIC_ACQUIRE)) {
+		initialize_index(name, max_entries, shm_set_timeout);
 		return shm_index;
 	}
-
-	initialize_index(name, max_entries, shm_set_timeout);
-
-	ldms_shm_index_unlock();
+	double deadline = getWallTime() + LDMS_SHM_INDEX_INIT_TIMEOUT;
+	while(!index_is_initialized()) {
+		if(getWallTime() > deadline) {
+			printf(
+					"Error in shm index initialization: %s is not initialized after %d seconds, the initializing process may have died. Remove /dev/shm%s to start over\n\r",
+					name, LDMS_SHM_INDEX_INIT_TIMEOUT, name);
+			free(shm_index);
+			shm_index = NULL;
+			return NULL;
+		}
+		sched_yield();
+	}
 
 	return shm_index;
 }
@@ -203,13 +265,6 @@ static ldms_shm_index_entry_t ldms_shm_index_find_entry(const char *fslocation)
 				return NULL;
 			}
 			entry->p = ip;
-			if((entry->mutex_sem = sem_open(fslocation, O_CREAT,
-					0660, 1)) == SEM_FAILED) {
-				printf(
-						"Error in entry finding: failed to open a semaphore with the name %s\n\r",
-						fslocation);
-				return NULL;
-			}
 			return entry;
 		}
 	}
@@ -218,85 +273,38 @@ static ldms_shm_index_entry_t ldms_shm_index_find_entry(const char *fslocation)
 
 void ldms_shm_index_lock()
 {
-	if(sem_wait(shm_index->mutex_sem) == -1)
-		printf("Error: failed to acquire the lock on the index\n\r");
+	ldms_shm_seq_write_lock(&shm_index->p->lock);
 }
 
 void ldms_shm_index_unlock()
 {
-	if(sem_post(shm_index->mutex_sem) == -1)
-		printf("Error: failed to release the lock on the index\n\r");
+	ldms_shm_seq_write_unlock(&shm_index->p->lock);
 }
 
 void ldms_shm_index_entry_lock(ldms_shm_index_entry_t entry)
 {
-	if(sem_wait(entry->mutex_sem) == -1)
-		printf("Error: failed to acquire the lock on the entry\n\r");
+	ldms_shm_seq_write_lock(&entry->p->lock);
 }
 
 void ldms_shm_index_entry_unlock(ldms_shm_index_entry_t entry)
 {
-	if(sem_post(entry->mutex_sem) == -1)
-		printf("Error: failed to release the lock on the entry\n\r");
-}
-
-static int build_shared_names(const char* index_name)
-{
-	int rc = 0;
-	ldms_shm_global_sem_mutex_name = malloc(strlen(index_name) + strlen(
-	LDMS_SHM_GLOBAL_SEM_MUTEX_NAME_PREFIX) + 1);
-	if(NULL == ldms_shm_global_sem_mutex_name) {
-		rc = ENOMEM;
-		return rc;
-	}
-	sprintf(ldms_shm_global_sem_mutex_name, "%s%s",
-	LDMS_SHM_GLOBAL_SEM_MUTEX_NAME_PREFIX, index_name + 1);
-
-	ldms_shm_index_mutex_name = malloc(strlen(index_name) + strlen(
-	LDMS_SHM_INDEX_MUTEX_NAME_PREFIX) + 1);
-	if(NULL == ldms_shm_index_mutex_name) {
-		rc = ENOMEM;
-		return rc;
-	}
-	sprintf(ldms_shm_index_mutex_name, "%s%s",
-	LDMS_SHM_INDEX_MUTEX_NAME_PREFIX, index_name + 1);
-	return rc;
+	ldms_shm_seq_write_unlock(&entry->p->lock);
 }
 
 ldms_shm_index_t ldms_shm_index_open(const char *name, int max_entries,
 		int metric_max, int array_max, int shm_set_timeout)
 {
-	int rc = build_shared_names(name);
-	if(rc) {
-		printf("Error in opening the index\n\r");
-		return NULL;
-	}
-
-	if((mutex_sem = sem_open(ldms_shm_global_sem_mutex_name, O_CREAT, 0660,
-			1)) == SEM_FAILED) {
-		printf(
-				"Error in opening the index: failed to open a semaphore with the name %s\n\r",
-				ldms_shm_global_sem_mutex_name);
-		return NULL;
-	}
-	if(sem_wait(mutex_sem) == -1) {
-		printf(
-				"Error in opening the index: failed to acquire the global lock during the opening of the index\n\r");
-		return NULL;
-	}
+	pthread_mutex_lock(&open_mutex);
 	if(shm_index != NULL) {
 		printf("ldms_shm_index_open is called twice!\n\r");
+		pthread_mutex_unlock(&open_mutex);
 		return shm_index;
 	}
 
 	ldms_shm_index_init(name, max_entries, metric_max, array_max,
 			shm_set_timeout);
 
-	if(sem_post(mutex_sem) == -1) {
-		printf(
-				"Error in opening the index: failed to release the global lock during the opening of the index\n\r");
-		return NULL;
-	}
+	pthread_mutex_unlock(&open_mutex);
 	return shm_index;
 }
 
@@ -306,6 +314,7 @@ static inline int ldms_shm_index_entry_is_empty(
 	return (LDMS_SHM_INDEX_ENTRY_STATE_EMPTY == entry_p->state);
 }
 
+/* caller holds the index lock */
 static ldms_shm_index_entry_t create_index_entry(const char *fslocation,
 		const char *setlabel)
 {
@@ -325,13 +334,9 @@ static ldms_shm_index_entry_t create_index_entry(const char *fslocation,
 			break;
 		}
 	}
-	new_entry->mutex_sem = sem_open(fslocation, O_CREAT, 0660, 1);
-	if(SEM_FAILED == new_entry->mutex_sem) {
-		printf(
-				"ERROR: failed to open a semaphore with the name %s  %d: %s\n\r",
-				fslocation, errno, STRERROR(errno));
-		if(NULL != new_entry)
-			free(new_entry);
+	if(NULL == new_entry->p) {
+		printf("ERROR: no empty entry for %s\n\r", fslocation);
+		free(new_entry);
 		return NULL;
 	}
 
@@ -340,9 +345,11 @@ static ldms_shm_index_entry_t create_index_entry(const char *fslocation,
 	new_entry->p->cnt_rdr = 0;
 	new_entry->p->cnt_updtr = 0;
 	new_entry->p->write_count = 0;
+	new_entry->p->slab_write_count = 0;
 	new_entry->p->read_count = 0;
 	new_entry->p->last_read_count_observed = 0;
 	new_entry->p->last_write_count_observed = 0;
+	new_entry->p->schema_checksum = 0;
 	sprintf(new_entry->p->setlabel, "%s", setlabel);
 	sprintf(new_entry->p->fslocation, "%s", fslocation);
 
@@ -357,66 +364,22 @@ static ldms_shm_index_entry_t create_index_entry(const char *fslocation,
 void ldms_shm_clear_index_entry(ldms_shm_index_entry_t entry)
 {
 	entry->p = NULL;
-	if(NULL != entry->mutex_sem) {
-		entry->mutex_sem = NULL;
-	}
 }
 
 int ldms_shm_index_entry_clean_shared_resources(ldms_shm_index_entry_t entry)
 {
-	int rc;
-	rc = ldms_shm_clean(entry->p->fslocation);
-	if(!rc) {
-		rc = sem_unlink(entry->p->fslocation);
-		if(rc) {
-			printf(
-					"ERROR: failed to unlink the semaphore %s  %d: %s\n\r",
-					entry->p->fslocation, errno,
-					STRERROR(errno));
-		}
-	}
-	return rc;
+	return ldms_shm_clean(entry->p->fslocation);
 }
 
 int ldms_shm_index_clean_shared_resources(ldms_shm_index_t shm_index)
 {
-	int rc;
-	rc = ldms_shm_clean(shm_index->p->name);
-	if(!rc) {
-		rc = sem_unlink(ldms_shm_index_mutex_name);
-		if(rc) {
-			printf(
-					"ERROR: failed to unlink the semaphore %s  %d: %s\n\r",
-					ldms_shm_index_mutex_name, errno,
-					STRERROR(errno));
-		} else {
-			free(ldms_shm_index_mutex_name);
-			ldms_shm_index_mutex_name = NULL;
-			rc = sem_unlink(ldms_shm_global_sem_mutex_name);
-			if(rc) {
-				printf(
-						"ERROR: failed to unlink the semaphore %s  %d: %s\n\r",
-						ldms_shm_global_sem_mutex_name,
-						errno, STRERROR(errno));
-			} else {
-				free(ldms_shm_index_mutex_name);
-				ldms_shm_index_mutex_name = NULL;
-				mutex_sem = NULL;
-			}
-		}
-	}
-	return rc;
+	return ldms_shm_clean(shm_index->p->name);
 }
 
 void ldms_shm_clear_index(ldms_shm_index_t index)
 {
 	if(NULL == index)
 		return;
-	if(NULL != index->mutex_sem) {
-		index->mutex_sem = NULL;
-	}
-
-	index->mutex_sem = NULL;
 	index->p = NULL;
 	index->instance_list = NULL;
 }
@@ -436,6 +399,15 @@ static inline int index_is_full()
 	return (shm_index->p->instance_count >= shm_index->p->max_entries);
 }
 
+/* drops an entry that lost its last user from the index */
+static void index_remove_entry()
+{
+	ldms_shm_index_lock();
+	shm_index->p->instance_count--;
+	ldms_shm_index_inc_gen_number();
+	ldms_shm_index_unlock();
+}
+
 ldms_shm_index_entry_t ldms_shm_index_add_entry(const char *setlabel,
 		const char *fslocation)
 {
@@ -448,6 +420,7 @@ ldms_shm_index_entry_t ldms_shm_index_add_entry(const char *setlabel,
 		printf("Info: entry %s already exists\n\r", fslocation);
 		return entry;
 	}
+	free(entry);
 
 	if(index_is_full()) {
 		ldms_shm_index_unlock();
@@ -473,38 +446,41 @@ ldms_shm_index_entry_t ldms_shm_index_add_entry(const char *setlabel,
 	return entry;
 }
 
-static ldms_shm_index_entry_t ldms_shm_index_entry_register_reader(
-		const char *fslocation)
+ldms_shm_index_entry_t ldms_shm_index_entry_register_instance_reader(
+		ldms_shm_index_t shm_index, int instance_index)
 {
-	ldms_shm_index_entry_t entry = ldms_shm_index_find_entry(fslocation);
+	ldms_shm_index_entry_properties_t *ip =
+			&shm_index->instance_list[instance_index];
+	ldms_shm_index_entry_t entry = calloc(1, sizeof(*entry));
 
 	if(NULL == entry) {
-		printf(
-				"ERROR: in registering as reader. Could not find index entry with label %s\n\r",
-				fslocation);
+		printf("ERROR: in registering as reader for instance %d: out of memory\n\r",
+				instance_index);
 		return NULL;
 	}
+	entry->p = ip;
 
 	ldms_shm_index_entry_lock(entry);
-
+	/* the set is not usable until its first writer published the schema */
+	if(!ldms_shm_index_entry_is_active(entry) || 0 == ip->schema_checksum) {
+		ldms_shm_index_entry_unlock(entry);
+		printf(
+				"ERROR: in registering as reader. Index entry %d is not ready\n\r",
+				instance_index);
+		free(entry);
+		return NULL;
+	}
 	entry->p->cnt_rdr++;
 
 	ldms_shm_index_entry_unlock(entry);
 
 	printf(
 			"INFO: reader #%d registered for reading the set with label (%s) at (%s) in the index\n\r",
-			entry->p->cnt_rdr, entry->p->setlabel, fslocation);
+			entry->p->cnt_rdr, entry->p->setlabel, entry->p->fslocation);
 
 	return entry;
 }
 
-ldms_shm_index_entry_t ldms_shm_index_entry_register_instance_reader(
-		ldms_shm_index_t shm_index, int instance_index)
-{
-	return ldms_shm_index_entry_register_reader(
-			shm_index->instance_list[instance_index].fslocation);
-}
-
 static inline int is_last_reader(ldms_shm_index_entry_t entry)
 {
 	return (entry->p->cnt_rdr == 1);
@@ -517,19 +493,19 @@ static inline int have_writers(ldms_shm_index_entry_t entry)
 
 static int write_timeout_reached(ldms_shm_index_entry_t entry)
 {
-	if(entry->p->write_count == entry->p->last_write_count_observed) {
+	uint64_t writes = entry->p->write_count + entry->p->slab_write_count;
+	if(writes == entry->p->last_write_count_observed) {
 		return ((getWallTime()
 				- get_second(entry->p->last_write_count_change))
 				> shm_index->p->shm_set_timeout);
 	} else {
-		entry->p->last_write_count_observed = entry->p->write_count;
+		entry->p->last_write_count_observed = writes;
 		gettimeofday(&entry->p->last_write_count_change, NULL);
 		return 0;
 	}
 }
 
 /**
- *  caller should hold the lock on the index
  * returns the number of remaining shm user
  */
 int ldms_shm_index_entry_deregister_reader(ldms_shm_index_entry_t entry)
@@ -545,13 +521,9 @@ int ldms_shm_index_entry_deregister_reader(ldms_shm_index_entry_t entry)
 			ldms_shm_index_entry_unlock(entry);
 		} else {
 			entry->p->state = LDMS_SHM_INDEX_ENTRY_STATE_EMPTY;
-
-			/* caller should lock the index */
-			shm_index->p->instance_count--;
-			ldms_shm_index_inc_gen_number();
-
 			ldms_shm_index_entry_unlock(entry);
 
+			index_remove_entry();
 			rem_users = 0;
 		}
 	} else {
@@ -608,12 +580,9 @@ int ldms_shm_index_entry_deregister_writer(ldms_shm_index_entry_t entry)
 
 		} else {
 			entry->p->state = LDMS_SHM_INDEX_ENTRY_STATE_EMPTY;
-			ldms_shm_index_lock();
-			shm_index->p->instance_count--;
-			ldms_shm_index_inc_gen_number();
-			ldms_shm_index_unlock();
-
 			ldms_shm_index_entry_unlock(entry);
+
+			index_remove_entry();
 			rem_users = 0;
 		}
 	} else {
@@ -627,14 +596,28 @@ int ldms_shm_index_entry_deregister_writer(ldms_shm_index_entry_t entry)
 int ldms_shm_index_is_instance_empty(ldms_shm_index_t shm_index,
 		int instance_index)
 {
-	return (LDMS_SHM_INDEX_ENTRY_STATE_EMPTY
-			== shm_index->instance_list[instance_index].state);
+	ldms_shm_index_entry_properties_t *ip =
+			&shm_index->instance_list[instance_index];
+	uint64_t seq;
+	int empty;
+	do {
+		seq = ldms_shm_seq_read_begin(&ip->lock);
+		empty = (LDMS_SHM_INDEX_ENTRY_STATE_EMPTY == ip->state);
+	} while(ldms_shm_seq_read_retry(&ip->lock, seq));
+	return empty;
 }
 
 uint64_t ldms_shm_index_get_schema_checksum(ldms_shm_index_t shm_index,
 		int instance_index)
 {
-	return shm_index->instance_list[instance_index].schema_checksum;
+	ldms_shm_index_entry_properties_t *ip =
+			&shm_index->instance_list[instance_index];
+	uint64_t seq, checksum;
+	do {
+		seq = ldms_shm_seq_read_begin(&ip->lock);
+		checksum = ip->schema_checksum;
+	} while(ldms_shm_seq_read_retry(&ip->lock, seq));
+	return checksum;
 }
 
 uint64_t ldms_shm_index_entry_get_schema_checksum(ldms_shm_index_entry_t entry)
@@ -644,7 +627,7 @@ uint64_t ldms_shm_index_entry_get_schema_checksum(ldms_shm_index_entry_t entry)
 
 uint64_t ldms_shm_gn_get(ldms_shm_index_t index)
 {
-	return index->p->generation_number;
+	return __atomic_load_n(&index->p->generation_number, __ATOMIC_ACQUIRE);
 }
 
 int ldms_shm_index_get_instace_count(ldms_shm_index_t index)
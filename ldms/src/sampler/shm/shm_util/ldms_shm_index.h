@@ -54,19 +54,36 @@
 #define LDMS_SHM_INDEX_H_
 
 #include <stdint.h>
-#include <semaphore.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/time.h>
 
 #define LDMS_SHM_INDEX_ENTRY_SET_LABEL_SIZE 256
 #define LDMS_SHM_INDEX_NAME_SIZE 256
 #define LDMS_SHM_INDEX_ENTRY_FSLOCATION_SIZE 256
 
-#define LDMS_SHM_INDEX_MUTEX_NAME_PREFIX "/ldms_shm_index_mutex"
 #define LDMS_SHM_SET_FSLOCATION_PREFIX "/ldms_shm_set_fslocation"
 
+/* seconds to wait for the first opener to initialize the index */
+#define LDMS_SHM_INDEX_INIT_TIMEOUT 10
+
+/**
+ * sequence lock shared between processes. The writers serialize on a robust
+ * process-shared mutex and make the sequence odd while they update; readers
+ * never take the mutex in the common case, they retry if the sequence was odd
+ * or changed while they were reading.
+ */
+typedef struct ldms_shm_seqlock {
+	volatile uint64_t seq; /* odd while a writer updates the protected data */
+	pthread_mutex_t mutex; /* robust and process-shared, held by the writer */
+} ldms_shm_seqlock_t;
+
 /**
  * structure to record the information related to the index_entry that should be retained in the shared memory, because it is shared between multiple set updaters and reader
  */
 typedef struct ldms_shm_index_entry_properties {
+	ldms_shm_seqlock_t lock; /* protects the entry */
+	uint64_t slab_write_count; /* Sum of the per-rank slab write counters, refreshed by the reader at sample time */
 	uint64_t write_count; /* Counter that is updated with each write event. This is used for determining the entry write activity */
 	uint64_t schema_checksum; /* Unique checksum for each entry/set for validation */
 	int cnt_rdr; /* Number of readers have been registered for the current entry/set */
@@ -92,18 +109,19 @@ typedef struct ldms_shm_index_entry_properties {
  */
 typedef struct ldms_shm_index_entry {
 	ldms_shm_index_entry_properties_t *p; /* shared entry information that is recorded in the shared memory */
-	sem_t *mutex_sem; /* semaphore that protect the current entry from shared access */
 }*ldms_shm_index_entry_t;
 
 /**
  * structure to record the information related to the index that should be retained in the shared memory, because it is shared between multiple set updaters and reader
  */
 typedef struct ldms_shm_index_properties {
+	ldms_shm_seqlock_t lock; /* protects the index */
 	char name[LDMS_SHM_INDEX_NAME_SIZE]; /* name of the shared memory index */
 	enum ldms_shm_index_state {
 		LDMS_SHM_INDEX_STATE_UNINITIALIZED = 0, /* The initial state upon creation */
 		LDMS_SHM_INDEX_STATE_INITIALIZED, /* When all properties are set, this index is initialized state */
-		LDMS_SHM_INDEX_STATE_INCONSISTENT
+		LDMS_SHM_INDEX_STATE_INCONSISTENT,
+		LDMS_SHM_INDEX_STATE_INITIALIZING /* The first opener is setting the properties */
 	} state; /* state of the shared memory index */
 	int instance_count; /* number of active entries */
 	int max_entries; /* maximum number of entries  */
@@ -115,7 +133,6 @@ typedef struct ldms_shm_index_properties {
  * structure to record the information related to the index that is unique to each process and need not to be retained in the shared memory
  */
 typedef struct ldms_shm_index {
-	sem_t *mutex_sem; /* semaphore that protect the current index from shared access */
 	ldms_shm_index_properties_t p; /* shared index information that is recorded in the shared memory */
 
 	ldms_shm_index_entry_properties_t *instance_list; /* list of entries (stored in the shared memory)*/
@@ -130,20 +147,84 @@ typedef struct ldms_shm_index {
  * \param array_max The maximum number of elements allowed in an array based metric set
  * \param shm_set_timeout The timeout in seconds for the index activity
  * \return shm_index if the shared memory index is opened and initialized successfully
- * \return NULL if fails to open and initialized the shared memory index
+ * \return NULL if fails to open and initialized the shared memory index, or
+ *         if the process initializing it did not finish within
+ *         LDMS_SHM_INDEX_INIT_TIMEOUT seconds
  */
 ldms_shm_index_t ldms_shm_index_open(const char *name, int max_entries,
 		int metric_max, int array_max, int shm_set_timeout);
 /**
- * \brief lock the shared memory index
+ * \brief initialize a robust process-shared mutex in the shared memory
+ *
+ * \param mutex
+ * \return 0 on success, an errno otherwise
+ */
+int ldms_shm_robust_mutex_init(pthread_mutex_t *mutex);
+/**
+ * \brief initialize a sequence lock in the shared memory
+ * Only the process that creates the shared memory may call this.
+ *
+ * \param lock
+ * \return 0 on success, an errno otherwise
+ */
+int ldms_shm_seqlock_init(ldms_shm_seqlock_t *lock);
+/**
+ * \brief lock a sequence lock for writing
+ * A writer that died while holding the lock is detected by the robust mutex:
+ * its half-done update is abandoned (the sequence is made even again) and
+ * the lock is taken over, so a dying writer does not wedge the other
+ * writers or the readers.
+ *
+ * \param lock
+ */
+void ldms_shm_seq_write_lock(ldms_shm_seqlock_t *lock);
+/**
+ * \brief unlock a sequence lock locked by ldms_shm_seq_write_lock()
+ *
+ * \param lock
+ */
+void ldms_shm_seq_write_unlock(ldms_shm_seqlock_t *lock);
+/**
+ * \brief recover a sequence lock left odd by a writer that died
+ * Called by the readers that keep finding the sequence odd.
+ *
+ * \param lock
+ */
+void ldms_shm_seq_recover(ldms_shm_seqlock_t *lock);
+
+#define LDMS_SHM_SEQ_RECOVER_SPIN 1000
+
+static inline uint64_t ldms_shm_seq_read_begin(ldms_shm_seqlock_t *lock)
+{
+	uint64_t s;
+	int spin = 0;
+	while ((s = __atomic_load_n(&lock->seq, __ATOMIC_ACQUIRE)) & 1) {
+		if (++spin == LDMS_SHM_SEQ_RECOVER_SPIN) {
+			spin = 0;
+			ldms_shm_seq_recover(lock);
+		} else {
+			sched_yield();
+		}
+	}
+	return s;
+}
+
+static inline int ldms_shm_seq_read_retry(ldms_shm_seqlock_t *lock, uint64_t s)
+{
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return __atomic_load_n(&lock->seq, __ATOMIC_RELAXED) != s;
+}
+
+/**
+ * \brief lock the shared memory index for writing
  */
 void ldms_shm_index_lock();
 /**
- * \brief unlock the shared memory index
+ * \brief unlock the shared memory index after writing
  */
 void ldms_shm_index_unlock();
 /**
- * \brief lock the shared memory index entry
+ * \brief lock the shared memory index entry for writing
  * For changes that only affects the current entry subscribers, use this more fine grained lock
  *
  * \param entry to be protected
@@ -57,9 +57,31 @@
 #include <fcntl.h> /* For O_* constants */
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
 #include "ldms_shm_obj.h"
 #include "ovis_util/util.h" /* for strerror macro only */
 
+#define LDMS_SHM_SIZE_WAIT_USEC 1000
+#define LDMS_SHM_SIZE_WAIT_TRIES 1000
+
+/**
+ * waits for the creator of the object to size it. The creator truncates the
+ * object right after creating it, so this only spins when the two race.
+ */
+static off_t ldms_shm_wait_size(int fd)
+{
+	struct stat sb;
+	int i;
+	for(i = 0; i < LDMS_SHM_SIZE_WAIT_TRIES; i++) {
+		if(fstat(fd, &sb))
+			return 0;
+		if(sb.st_size)
+			return sb.st_size;
+		usleep(LDMS_SHM_SIZE_WAIT_USEC);
+	}
+	return 0;
+}
+
 /**
  * opens the shared memory and creates the mapping
  */
@@ -95,9 +117,14 @@ ldms_shm_obj_t ldms_shm_init(const char *name, int size)
 						errno, STRERROR(errno));
 				return NULL;
 			} else {
-				struct stat sb;
-				fstat(shm_obj->fd, &sb);
-				shm_obj->size = sb.st_size;
+				shm_obj->size = ldms_shm_wait_size(shm_obj->fd);
+				if(0 == shm_obj->size) {
+					close(shm_obj->fd);
+					free(shm_obj);
+					printf("ERROR: shm object %s has no size\n\r",
+							name);
+					return NULL;
+				}
 			}
 		} else {
 			free(shm_obj);
@@ -125,8 +152,8 @@ ldms_shm_obj_t ldms_shm_init(const char *name, int size)
 				size);
 		return NULL;
 	}
-	if(new)
-		memset(shm_obj->addr, 0, shm_obj->size);
+	/* a new object is zero filled by ftruncate, and other processes may
+	 * already be using it, so it must not be cleared here */
 	return shm_obj;
 }
 
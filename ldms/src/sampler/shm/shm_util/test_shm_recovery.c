@@ -0,0 +1,110 @@
+/* -*- c-basic-offset: 8 -*-
+ * Copyright (c) 2026 National Technology & Engineering Solutions
+ * of Sandia, LLC (NTESS). Under the terms of Contract DE-NA0003525 with
+ * NTESS, the U.S. Government retains certain rights in this software.
+ *
+ * SPDX-License-Identifier: (GPL-2.0 OR BSD-3-Clause)
+ */
+/**
+ * \file test_shm_recovery.c
+ * \brief a writer that dies holding the index locks or a counter slab must
+ * not wedge the other users of the shared memory index
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include "ldms_shm_index.h"
+#include "ldms_shm_event_set.h"
+
+#define FAIL(...) do { \
+		printf("FAIL: " __VA_ARGS__); \
+		status = 1; \
+		goto out; \
+	} while (0)
+
+static void hang(int sig)
+{
+	printf("FAIL: timed out, a lock was not recovered\n");
+	_exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	char index_name[64], fslocation[64];
+	char *event_names[] = { "calls" };
+	int num_elements[] = { 1 };
+	ldms_shm_index_t index;
+	ldms_shm_set_t set;
+	ldms_shm_data_t *view;
+	pid_t pid;
+	int status = 0;
+
+	snprintf(index_name, sizeof(index_name), "/test_shm_recovery.%d",
+			getpid());
+	snprintf(fslocation, sizeof(fslocation), "/test_shm_recovery.%d.set",
+			getpid());
+	index = ldms_shm_index_open(index_name, 4, 16, 16, 10);
+	if(!index) {
+		printf("FAIL: cannot open the index %s\n", index_name);
+		return 1;
+	}
+	set = ldms_shm_index_register_set_slabs("test", fslocation, 1,
+			num_elements, event_names, 1);
+	if(!set)
+		FAIL("cannot register the set\n");
+
+	/* the child claims the only slab, counts, and dies holding the
+	 * index lock, the entry lock and the slab */
+	pid = fork();
+	if(pid < 0)
+		FAIL("fork\n");
+	if(pid == 0) {
+		if(ldms_shm_set_slab_claim(set))
+			_exit(2);
+		ldms_shm_slab_counter_add(set, 0, 5);
+		ldms_shm_index_lock();
+		ldms_shm_index_entry_lock(set->entry);
+		_exit(0);
+	}
+	if(waitpid(pid, &status, 0) != pid || !WIFEXITED(status)
+			|| WEXITSTATUS(status))
+		FAIL("the child did not claim the slab (%d)\n", status);
+	status = 0;
+
+	signal(SIGALRM, hang);
+	alarm(10);
+
+	/* a reader finds the entry sequence odd and recovers it */
+	if(ldms_shm_index_is_instance_empty(index, 0))
+		FAIL("the entry is empty\n");
+	if(index->instance_list[0].lock.seq & 1)
+		FAIL("the entry lock is still odd\n");
+
+	/* a writer takes over the index lock */
+	ldms_shm_index_lock();
+	ldms_shm_index_unlock();
+	if(index->p->lock.seq & 1)
+		FAIL("the index lock is still odd\n");
+
+	/* the slab of the dead child is folded and reused */
+	view = ldms_shm_set_snapshot(set);
+	if(view[0].val != 5)
+		FAIL("snapshot %lu before the claim, expected 5\n",
+				(unsigned long)view[0].val);
+	if(ldms_shm_set_slab_claim(set))
+		FAIL("the slab of the dead child was not reclaimed\n");
+	ldms_shm_slab_counter_add(set, 0, 2);
+	view = ldms_shm_set_snapshot(set);
+	if(view[0].val != 7)
+		FAIL("snapshot %lu after the claim, expected 7\n",
+				(unsigned long)view[0].val);
+	alarm(0);
+	printf("PASS\n");
+out:
+	if(set && 0 == ldms_shm_set_deregister_writer(set))
+		ldms_shm_set_clean_entry_shared_resources(set);
+	ldms_shm_index_clean_shared_resources(index);
+	return status;
+}
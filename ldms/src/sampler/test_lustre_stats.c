@@ -0,0 +1,120 @@
+/* -*- c-basic-offset: 8 -*- */
+/* Copyright 2026 Lawrence Livermore National Security, LLC
+ * See the top-level COPYING file for details.
+ *
+ * SPDX-License-Identifier: (GPL-2.0 OR BSD-3-Clause)
+ */
+
+/* Parse test_input/lustre_stats with the shared Lustre stats parser. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "lustre_stats.h"
+
+static int err;
+
+#define CHECK(cond, ...) do { \
+	if (!(cond)) { \
+		err++; \
+		printf("error: " __VA_ARGS__); \
+	} \
+} while (0)
+
+struct expect {
+	const char *key;
+	int n;
+	uint64_t v[5];
+};
+
+/* The lines of test_input/lustre_stats after snapshot_time */
+static struct expect expect[] = {
+	{ "read_bytes", 5, { 4, 4096, 1048576, 2101248, 1099528404992ULL } },
+	{ "write_bytes", 4, { 2, 512, 65536, 66048 } },
+	{ "ioctl", 1, { 17 } },
+	{ "open", 1, { 9 } },
+	{ "", 0 },
+	{ "getattr", 5, { 25, 1, 30, 120, 1500 } },
+	{ "statfs", 4, { 3, 2, 7, 12 } },
+	{ "inode_permission", 4, { 123, 0, 4, 98 } },
+};
+
+static void check_hash(const char *key, uint64_t hash)
+{
+	struct lustre_stats_tok tok;
+	char line[64];
+
+	snprintf(line, sizeof(line), "%s 1 samples [reqs]\n", key);
+	lustre_stats_tok_line(line, &tok);
+	CHECK(tok.hash == hash, "hash of \"%s\" is %#" PRIx64
+	      ", expecting %#" PRIx64 "\n", key, tok.hash, hash);
+}
+
+int main(int argc, char **argv)
+{
+	struct lustre_stats_tok tok;
+	const char *srcdir = getenv("srcdir");
+	char path[4096];
+	struct stat st;
+	size_t buf_sz;
+	ssize_t len;
+	char *buf, *s;
+	int fd, i, j;
+
+	/* FNV-1a test vectors */
+	check_hash("a", 0xaf63dc4c8601ec8cULL);
+	check_hash("foobar", 0x85944171f73967e8ULL);
+
+	snprintf(path, sizeof(path), "%s/test_input/lustre_stats",
+		 srcdir ? srcdir : ".");
+	fd = open(path, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st)) {
+		printf("error: cannot open %s\n", path);
+		return 1;
+	}
+
+	/* Start small so that the buffer is grown, and read twice */
+	buf_sz = 16;
+	buf = malloc(buf_sz);
+	for (i = 0; i < 2; i++) {
+		len = lustre_stats_pread(fd, &buf, &buf_sz);
+		CHECK(len == st.st_size, "read %zd bytes of %zd\n",
+		      len, (ssize_t)st.st_size);
+	}
+	close(fd);
+	if (len < 0)
+		return 1;
+
+	s = strchr(buf, '\n');
+	CHECK(s && !strncmp(buf, "snapshot_time", 13), "no snapshot_time\n");
+	s++;
+	for (i = 0; *s; i++) {
+		s = lustre_stats_tok_line(s, &tok);
+		if (i >= sizeof(expect) / sizeof(expect[0])) {
+			CHECK(0, "extra line %.*s\n", tok.key_len, tok.key);
+			continue;
+		}
+		CHECK(tok.key_len == strlen(expect[i].key) &&
+		      !strncmp(tok.key, expect[i].key, tok.key_len),
+		      "line %d key %.*s, expecting %s\n",
+		      i, tok.key_len, tok.key, expect[i].key);
+		CHECK(tok.n == expect[i].n, "%s: %d values, expecting %d\n",
+		      expect[i].key, tok.n, expect[i].n);
+		for (j = 0; j < tok.n && j < expect[i].n; j++)
+			CHECK(tok.v[j] == expect[i].v[j],
+			      "%s: value %d is %" PRIu64 ", expecting %" PRIu64
+			      "\n", expect[i].key, j, tok.v[j], expect[i].v[j]);
+	}
+	CHECK(i == sizeof(expect) / sizeof(expect[0]), "%d lines\n", i);
+	free(buf);
+
+	if (err)
+		printf("%d errors\n", err);
+	else
+		printf("no errors\n");
+	return err;
+}
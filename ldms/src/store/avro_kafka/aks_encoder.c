@@ -0,0 +1,207 @@
+/* -*- c-basic-offset: 8 -*-
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * Copyright 2026 Open Grid Computing, Inc.
+ *
+ * See the top-level COPYING file for details.
+ *
+ * SPDX-License-Identifier: (GPL-2.0 OR BSD-3-Clause)
+ */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "aks_encoder.h"
+
+static int col_type_supported(enum ldms_value_type type)
+{
+	switch (type) {
+	case LDMS_V_TIMESTAMP:
+	case LDMS_V_CHAR:
+	case LDMS_V_U8:
+	case LDMS_V_S8:
+	case LDMS_V_U16:
+	case LDMS_V_S16:
+	case LDMS_V_U32:
+	case LDMS_V_S32:
+	case LDMS_V_U64:
+	case LDMS_V_S64:
+	case LDMS_V_F32:
+	case LDMS_V_D64:
+	case LDMS_V_CHAR_ARRAY:
+	case LDMS_V_U8_ARRAY:
+	case LDMS_V_S8_ARRAY:
+	case LDMS_V_U16_ARRAY:
+	case LDMS_V_S16_ARRAY:
+	case LDMS_V_U32_ARRAY:
+	case LDMS_V_S32_ARRAY:
+	case LDMS_V_U64_ARRAY:
+	case LDMS_V_S64_ARRAY:
+	case LDMS_V_F32_ARRAY:
+	case LDMS_V_D64_ARRAY:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+aks_encoder_t aks_encoder_new(ldmsd_row_t row)
+{
+	aks_encoder_t ae;
+	int i;
+
+	for (i = 0; i < row->col_count; i++) {
+		if (!col_type_supported(row->cols[i].type)) {
+			errno = ENOTSUP;
+			return NULL;
+		}
+	}
+	ae = malloc(sizeof(*ae) + row->col_count * sizeof(ae->col_type[0]));
+	if (!ae) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	ae->col_count = row->col_count;
+	for (i = 0; i < row->col_count; i++)
+		ae->col_type[i] = row->cols[i].type;
+	return ae;
+}
+
+void aks_encoder_free(aks_encoder_t ae)
+{
+	free(ae);
+}
+
+/*
+ * The Avro types follow col_type_str() in ldmsd_decomp.c: 8-bit, 16-bit
+ * and signed 32-bit values are 'int', unsigned 32-bit and 64-bit values
+ * are 'long' and timestamps are 'long' timestamp-millis.
+ */
+static void encode_col(ldms_avro_enc_t enc, ldmsd_col_t col)
+{
+	struct ldms_timestamp ts;
+	const char *s;
+	char c;
+	int i, n = col->array_len;
+
+	switch (col->type) {
+	case LDMS_V_TIMESTAMP:
+		ts = ldms_mval_get_ts(col->mval);
+		ldms_avro_enc_long(enc, ((int64_t)ts.sec * 1000) + (ts.usec / 1000));
+		break;
+	case LDMS_V_CHAR:
+		c = ldms_mval_get_char(col->mval);
+		ldms_avro_enc_string(enc, &c, 1);
+		break;
+	case LDMS_V_U8:
+		ldms_avro_enc_int(enc, ldms_mval_get_u8(col->mval));
+		break;
+	case LDMS_V_S8:
+		ldms_avro_enc_int(enc, ldms_mval_get_s8(col->mval));
+		break;
+	case LDMS_V_U16:
+		ldms_avro_enc_int(enc, ldms_mval_get_u16(col->mval));
+		break;
+	case LDMS_V_S16:
+		ldms_avro_enc_int(enc, ldms_mval_get_s16(col->mval));
+		break;
+	case LDMS_V_U32:
+		ldms_avro_enc_long(enc, ldms_mval_get_u32(col->mval));
+		break;
+	case LDMS_V_S32:
+		ldms_avro_enc_int(enc, ldms_mval_get_s32(col->mval));
+		break;
+	case LDMS_V_U64:
+		ldms_avro_enc_long(enc, (int64_t)ldms_mval_get_u64(col->mval));
+		break;
+	case LDMS_V_S64:
+		ldms_avro_enc_long(enc, ldms_mval_get_s64(col->mval));
+		break;
+	case LDMS_V_F32:
+		ldms_avro_enc_float(enc, ldms_mval_get_float(col->mval));
+		break;
+	case LDMS_V_D64:
+		ldms_avro_enc_double(enc, ldms_mval_get_double(col->mval));
+		break;
+	case LDMS_V_CHAR_ARRAY:
+		s = ldms_mval_array_get_str(col->mval);
+		ldms_avro_enc_string(enc, s, strnlen(s, n));
+		break;
+	case LDMS_V_U8_ARRAY:
+		ldms_avro_enc_array_begin(enc, n);
+		for (i = 0; i < n; i++)
+			ldms_avro_enc_int(enc, ldms_mval_array_get_u8(col->mval, i));
+		ldms_avro_enc_array_end(enc);
+		break;
+	case LDMS_V_S8_ARRAY:
+		ldms_avro_enc_array_begin(enc, n);
+		for (i = 0; i < n; i++)
+			ldms_avro_enc_int(enc, ldms_mval_array_get_s8(col->mval, i));
+		ldms_avro_enc_array_end(enc);
+		break;
+	case LDMS_V_U16_ARRAY:
+		ldms_avro_enc_array_begin(enc, n);
+		for (i = 0; i < n; i++)
+			ldms_avro_enc_int(enc, ldms_mval_array_get_u16(col->mval, i));
+		ldms_avro_enc_array_end(enc);
+		break;
+	case LDMS_V_S16_ARRAY:
+		ldms_avro_enc_array_begin(enc, n);
+		for (i = 0; i < n; i++)
+			ldms_avro_enc_int(enc, ldms_mval_array_get_s16(col->mval, i));
+		ldms_avro_enc_array_end(enc);
+		break;
+	case LDMS_V_U32_ARRAY:
+		ldms_avro_enc_array_begin(enc, n);
+		for (i = 0; i < n; i++)
+			ldms_avro_enc_long(enc, ldms_mval_array_get_u32(col->mval, i));
+		ldms_avro_enc_array_end(enc);
+		break;
+	case LDMS_V_S32_ARRAY:
+		ldms_avro_enc_array_begin(enc, n);
+		for (i = 0; i < n; i++)
+			ldms_avro_enc_int(enc, ldms_mval_array_get_s32(col->mval, i));
+		ldms_avro_enc_array_end(enc);
+		break;
+	case LDMS_V_U64_ARRAY:
+		ldms_avro_enc_array_begin(enc, n);
+		for (i = 0; i < n; i++)
+			ldms_avro_enc_long(enc, (int64_t)ldms_mval_array_get_u64(col->mval, i));
+		ldms_avro_enc_array_end(enc);
+		break;
+	case LDMS_V_S64_ARRAY:
+		ldms_avro_enc_array_begin(enc, n);
+		for (i = 0; i < n; i++)
+			ldms_avro_enc_long(enc, ldms_mval_array_get_s64(col->mval, i));
+		ldms_avro_enc_array_end(enc);
+		break;
+	case LDMS_V_F32_ARRAY:
+		ldms_avro_enc_array_begin(enc, n);
+		for (i = 0; i < n; i++)
+			ldms_avro_enc_float(enc, ldms_mval_array_get_float(col->mval, i));
+		ldms_avro_enc_array_end(enc);
+		break;
+	case LDMS_V_D64_ARRAY:
+		ldms_avro_enc_array_begin(enc, n);
+		for (i = 0; i < n; i++)
+			ldms_avro_enc_double(enc, ldms_mval_array_get_double(col->mval, i));
+		ldms_avro_enc_array_end(enc);
+		break;
+	default:
+		/* rejected by aks_encoder_new() */
+		enc->err = ENOTSUP;
+		break;
+	}
+}
+
+int aks_encoder_encode(aks_encoder_t ae, ldmsd_row_t row, ldms_avro_enc_t enc)
+{
+	int i;
+
+	if (row->col_count != ae->col_count)
+		return EINVAL;
+	for (i = 0; i < row->col_count; i++) {
+		if (row->cols[i].type != ae->col_type[i])
+			return EINVAL;
+		encode_col(enc, &row->cols[i]);
+	}
+	return enc->err;
+}
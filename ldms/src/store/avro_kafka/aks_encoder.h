@@ -0,0 +1,48 @@
+/* -*- c-basic-offset: 8 -*-
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * Copyright 2026 Open Grid Computing, Inc.
+ *
+ * See the top-level COPYING file for details.
+ *
+ * SPDX-License-Identifier: (GPL-2.0 OR BSD-3-Clause)
+ */
+#ifndef __AKS_ENCODER_H__
+#define __AKS_ENCODER_H__
+
+#include "ldms.h"
+#include "ldmsd.h"
+#include "ldms_msg_avro_ser.h"
+
+/*
+ * An Avro binary encoder compiled for the rows of one schema.
+ *
+ * The Avro schema of the rows is generated by
+ * ldmsd_row_to_json_avro_schema(), which maps every column to a fixed
+ * Avro type in column order. The encoder records the column types of
+ * the first row, and then writes the values of each row straight from
+ * the column mvals, without building an avro_value_t.
+ */
+typedef struct aks_encoder_s {
+	int col_count;
+	enum ldms_value_type col_type[OVIS_FLEX];
+} *aks_encoder_t;
+
+/*
+ * Compile an encoder for the rows shaped like \c row.
+ *
+ * Returns NULL and sets errno to ENOTSUP if a column type has no Avro
+ * mapping, or to ENOMEM.
+ */
+aks_encoder_t aks_encoder_new(ldmsd_row_t row);
+
+void aks_encoder_free(aks_encoder_t ae);
+
+/*
+ * Append the Avro binary encoding of \c row to \c enc.
+ *
+ * Returns EINVAL if \c row does not have the columns that \c ae was
+ * compiled for, or the error in \c enc.
+ */
+int aks_encoder_encode(aks_encoder_t ae, ldmsd_row_t row, ldms_avro_enc_t enc);
+
+#endif
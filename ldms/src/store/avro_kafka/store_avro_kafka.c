@@ -33,6 +33,8 @@
 #include "ldmsd.h"
 #include "ldmsd_plug_api.h"
 #include "ovis_log.h"
+#include "ldms_msg_avro_ser.h"
+#include "aks_encoder.h"
 
 #define STORE_AVRO_KAFKA "store_avro_kafka"
 
@@ -60,8 +62,16 @@ typedef struct aks_handle_s
 	store_kafka_t sf;
 
 	struct rbt schema_tree;
+	struct rbt topic_tree;	   /* Kafka topics by name */
+	struct ldms_avro_enc_s enc; /* Reusable serialization buffer */
 } *aks_handle_t;
 
+struct topic_entry {
+	rd_kafka_topic_t *rkt;
+	struct rbn rbn;
+	char name[OVIS_FLEX];
+};
+
 static const char *_help_str =
     "   config name=store_avro_kafka [path=JSON_FILE]\n"
     "       encoding=MODE"
@@ -104,17 +114,18 @@ struct schema_entry
 	char *schema_name;
 	serdes_schema_t *serdes_schema;	/* The serdes schema */
 	ldms_schema_t ldms_schema;	/* The LDMS schema */
+	aks_encoder_t encoder;		/* Row encoder for the schema */
 	struct rbn rbn;
 };
 
-static serdes_schema_t *
+static struct schema_entry *
 serdes_schema_find(aks_handle_t sh, char *schema_name,
 		  ldms_schema_t lschema, ldmsd_row_t row)
 {
 	struct rbn *rbn;
 	serdes_schema_t *previous_schema = NULL;
 	serdes_schema_t *current_schema = NULL;
-	struct schema_entry *entry;
+	struct schema_entry *entry = NULL;
 	char *json_buf = NULL;
 	size_t json_len;
 	char errstr[512];
@@ -125,12 +136,18 @@ serdes_schema_find(aks_handle_t sh, char *schema_name,
 	rbn = rbt_find(&schema_tree, schema_name);
 	if (rbn) {
 		entry = container_of(rbn, struct schema_entry, rbn);
-		current_schema = entry->serdes_schema;
 		goto out;
 	}
 	entry = calloc(1, sizeof(*entry));
 	if (!entry)
 		goto out;
+	entry->encoder = aks_encoder_new(row);
+	if (!entry->encoder) {
+		ovis_log(sh->sf->log, OVIS_LERROR,
+			 "Error %d compiling the Avro encoder for schema '%s'\n",
+			 errno, schema_name);
+		goto err;
+	}
 
 	/* Look up the schema by name in the registry.
            Name alone does not tell us if the schema matches this row, so we
@@ -144,7 +161,7 @@ serdes_schema_find(aks_handle_t sh, char *schema_name,
 	/* Generate a new schema from the row specification and LDMS schema */
 	rc = ldmsd_row_to_json_avro_schema(row, &json_buf, &json_len);
 	if (rc)
-		goto out;
+		goto err;
 
         /* Push the generated schema to the registry */
         current_schema = serdes_schema_add(sh->serdes,
@@ -154,7 +171,7 @@ serdes_schema_find(aks_handle_t sh, char *schema_name,
 	if (!current_schema) {
 		ovis_log(sh->sf->log, OVIS_LERROR, "%s\n", json_buf);
 		ovis_log(sh->sf->log, OVIS_LERROR, "Error '%s' creating schema '%s'\n", errstr, schema_name);
-		goto out;
+		goto err;
 	}
 
         /* Log information about which schema was used */
@@ -186,11 +203,52 @@ serdes_schema_find(aks_handle_t sh, char *schema_name,
 	entry->schema_name = strdup(schema_name);
 	rbn_init(&entry->rbn, entry->schema_name);
 	rbt_ins(&schema_tree, &entry->rbn);
+	goto out;
+err:
+	if (entry->encoder)
+		aks_encoder_free(entry->encoder);
+	free(entry);
+	entry = NULL;
 out:
 	pthread_mutex_unlock(&schema_rbt_lock);
 	if (json_buf)
 		free(json_buf);
-	return current_schema;
+	return entry;
+}
+
+static int topic_cmp(void *a, const void *b)
+{
+	return strcmp((char *)a, (char *)b);
+}
+
+/*
+ * Return the Kafka topic handle for \c name, creating it the first time
+ * the name is seen. The handles are kept until the store is closed.
+ */
+static rd_kafka_topic_t *topic_get(aks_handle_t sh, const char *name)
+{
+	struct topic_entry *ent;
+	struct rbn *rbn;
+	size_t len;
+
+	rbn = rbt_find(&sh->topic_tree, name);
+	if (rbn) {
+		ent = container_of(rbn, struct topic_entry, rbn);
+		return ent->rkt;
+	}
+	len = strlen(name) + 1;
+	ent = malloc(sizeof(*ent) + len);
+	if (!ent)
+		return NULL;
+	memcpy(ent->name, name, len);
+	ent->rkt = rd_kafka_topic_new(sh->rd, name, NULL);
+	if (!ent->rkt) {
+		free(ent);
+		return NULL;
+	}
+	rbn_init(&ent->rbn, ent->name);
+	rbt_ins(&sh->topic_tree, &ent->rbn);
+	return ent->rkt;
 }
 
 static char *strip_whitespace(char *s)
@@ -399,6 +457,16 @@ static void close_store(ldmsd_plug_handle_t handle, ldmsd_store_handle_t _sh)
 {
 	/* This is called when strgp is stopped to clean up resources */
 	aks_handle_t sh = _sh;
+	struct topic_entry *ent;
+	struct rbn *rbn;
+
+	while ((rbn = rbt_min(&sh->topic_tree))) {
+		rbt_del(&sh->topic_tree, rbn);
+		ent = container_of(rbn, struct topic_entry, rbn);
+		rd_kafka_topic_destroy(ent->rkt);
+		free(ent);
+	}
+	ldms_avro_enc_free(&sh->enc);
 	if (sh->rd) {
 		rd_kafka_destroy(sh->rd);
 	}
@@ -421,6 +489,7 @@ static aks_handle_t __handle_new(ldmsd_plug_handle_t handle, ldmsd_strgp_t strgp
 	}
         sh->sf = sk;
 	rbt_init(&sh->schema_tree, schema_cmp);
+	rbt_init(&sh->topic_tree, topic_cmp);
 	sh->encoding = sk->g_serdes_encoding;
 	sh->topic_fmt = strdup(sk->g_topic_fmt);
 	if (!sh->topic_fmt)
@@ -474,232 +543,6 @@ err_0:
 	return NULL;
 }
 
-static int set_avro_value_from_col(avro_value_t *col_value,
-				   ldmsd_col_t col)
-{
-	int rc, idx;
-	struct ldms_timestamp ts;
-	avro_value_t val, item_val;
-	long ms;
-	char char_str[2];
-	size_t item_idx;
-	enum avro_type_t t = avro_value_get_type(col_value);
-	switch (col->type) {
-	case LDMS_V_TIMESTAMP:
-		switch (t) {
-		case AVRO_INT32:
-			/* Assume that this is only the seconds portion of
-			 * the timestamp
-			 */
-			ts = ldms_mval_get_ts(col->mval);
-			rc = avro_value_set_int(col_value, ts.sec);
-			break;
-		case AVRO_INT64:
-			/* This is assumed to be the Avro logical
-			 * type 'timestamp-millis'
-			 */
-			ts = ldms_mval_get_ts(col->mval);
-			ms = ((long)ts.sec * 1000) + (ts.usec / 1000);
-			rc = avro_value_set_long(col_value, ms);
-			break;
-		case AVRO_RECORD:
-			/* Expect sec, usec Avro record definition */
-			ts = ldms_mval_get_ts(col->mval);
-			rc = avro_value_get_by_name(col_value, "sec", &val, NULL);
-			assert(!rc);
-			rc = avro_value_set_int(&val, (long)ts.sec);
-			assert(!rc);
-			rc = avro_value_get_by_name(col_value, "usec", &val, NULL);
-			assert(!rc);
-			rc = avro_value_set_int(&val, (long)ts.usec);
-			assert(!rc);
-			break;
-		default:
-			assert(0 == "Unrecognized Avro type to LDMS_V_TIMESTAMP conversion");
-			break;
-		}
-		break;
-	case LDMS_V_CHAR:
-		char_str[0] = ldms_mval_get_char(col->mval);
-		char_str[1] = '\0';
-		rc = avro_value_set_string(col_value, char_str);
-		break;
-	case LDMS_V_U8:
-		rc = avro_value_set_int(col_value,
-				(int)ldms_mval_get_u8(col->mval));
-		break;
-	case LDMS_V_S8:
-		rc = avro_value_set_int(col_value,
-				(int)ldms_mval_get_s8(col->mval));
-		break;
-	case LDMS_V_U16:
-		rc = avro_value_set_int(col_value,
-				(int)ldms_mval_get_u16(col->mval));
-		break;
-	case LDMS_V_S16:
-		rc = avro_value_set_int(col_value,
-				(int)ldms_mval_get_s16(col->mval));
-		break;
-	case LDMS_V_U32:
-		rc = avro_value_set_int(col_value,
-				(int)ldms_mval_get_u32(col->mval));
-		break;
-	case LDMS_V_S32:
-		rc = avro_value_set_int(col_value,
-				(int)ldms_mval_get_s32(col->mval));
-		break;
-	case LDMS_V_U64:
-		rc = avro_value_set_long(col_value,
-				(long)ldms_mval_get_u64(col->mval));
-		break;
-	case LDMS_V_S64:
-		rc = avro_value_set_long(col_value,
-				(long)ldms_mval_get_s64(col->mval));
-		break;
-	case LDMS_V_F32:
-		rc = avro_value_set_float(col_value,
-				ldms_mval_get_float(col->mval));
-		break;
-	case LDMS_V_D64:
-		rc = avro_value_set_double(col_value,
-				ldms_mval_get_double(col->mval));
-		break;
-	case LDMS_V_CHAR_ARRAY:
-		rc = avro_value_set_string(col_value,
-				ldms_mval_array_get_str(col->mval));
-		break;
-	case LDMS_V_S8_ARRAY:
-		for (idx = 0; idx < col->array_len; idx++) {
-			rc = avro_value_append(col_value, &item_val, &item_idx);
-			if (rc)
-				break;
-			rc = avro_value_set_int(&item_val,
-					(int)ldms_mval_array_get_s8(col->mval, idx));
-		}
-		break;
-	case LDMS_V_U8_ARRAY:
-		for (idx = 0; idx < col->array_len; idx++) {
-			rc = avro_value_append(col_value, &item_val, &item_idx);
-			if (rc)
-				break;
-			rc = avro_value_set_int(&item_val,
-					(unsigned int)ldms_mval_array_get_u8(col->mval, idx));
-		}
-		break;
-	case LDMS_V_U16_ARRAY:
-		for (idx = 0; idx < col->array_len; idx++) {
-			rc = avro_value_append(col_value, &item_val, &item_idx);
-			if (rc)
-				break;
-			rc = avro_value_set_int(&item_val,
-					(unsigned int)ldms_mval_array_get_u16(col->mval, idx));
-		}
-		break;
-	case LDMS_V_S16_ARRAY:
-		for (idx = 0; idx < col->array_len; idx++) {
-			rc = avro_value_append(col_value, &item_val, &item_idx);
-			if (rc)
-				break;
-			rc = avro_value_set_int(&item_val,
-					(int)ldms_mval_array_get_s16(col->mval, idx));
-		}
-		break;
-	case LDMS_V_U32_ARRAY:
-		for (idx = 0; idx < col->array_len; idx++) {
-			rc = avro_value_append(col_value, &item_val, &item_idx);
-			if (rc)
-				break;
-			rc = avro_value_set_long(&item_val,
-					(long)ldms_mval_array_get_u32(col->mval, idx));
-		}
-		break;
-	case LDMS_V_S32_ARRAY:
-		for (idx = 0; idx < col->array_len; idx++) {
-			rc = avro_value_append(col_value, &item_val, &item_idx);
-			if (rc)
-				break;
-			rc = avro_value_set_int(&item_val,
-					ldms_mval_array_get_s64(col->mval, idx));
-		}
-		break;
-	case LDMS_V_U64_ARRAY:
-		for (idx = 0; idx < col->array_len; idx++) {
-			rc = avro_value_append(col_value, &item_val, &item_idx);
-			if (rc)
-				break;
-			rc = avro_value_set_long(&item_val,
-					(long)ldms_mval_array_get_u64(col->mval, idx));
-		}
-		break;
-	case LDMS_V_S64_ARRAY:
-		for (idx = 0; idx < col->array_len; idx++) {
-			rc = avro_value_append(col_value, &item_val, &item_idx);
-			if (rc)
-				break;
-			rc = avro_value_set_long(&item_val,
-					(long)ldms_mval_array_get_u64(col->mval, idx));
-		}
-		break;
-	case LDMS_V_F32_ARRAY:
-		for (idx = 0; idx < col->array_len; idx++) {
-			rc = avro_value_append(col_value, &item_val, &item_idx);
-			if (rc)
-				break;
-			rc = avro_value_set_float(&item_val,
-					ldms_mval_array_get_float(col->mval, idx));
-		}
-		break;
-	case LDMS_V_D64_ARRAY:
-		for (idx = 0; idx < col->array_len; idx++) {
-			rc = avro_value_append(col_value, &item_val, &item_idx);
-			if (rc)
-				break;
-			rc = avro_value_set_double(&item_val,
-					ldms_mval_array_get_double(col->mval, idx));
-		}
-		break;
-	case LDMS_V_LIST:
-	case LDMS_V_LIST_ENTRY:
-	case LDMS_V_RECORD_TYPE:
-	case LDMS_V_RECORD_INST:
-	case LDMS_V_RECORD_ARRAY:
-	default:
-		rc = ENOTSUP;
-		break;
-	}
-	return rc;
-}
-
-static int serialize_columns_of_row(avro_schema_t schema,
-                                    ldmsd_row_t row, avro_value_t *avro_row, ovis_log_t log)
-{
-	int rc, i;
-	ldmsd_col_t col;
-	avro_value_t avro_col;
-
-	for (i = 0; i < row->col_count; i++) {
-		char *avro_name;
-		col = &row->cols[i];
-		avro_name = ldmsd_avro_name_get(col->name);
-		rc = avro_value_get_by_name(avro_row, avro_name,
-					    &avro_col, NULL);
-		free(avro_name);
-		if (rc) {
-			ovis_log(log, OVIS_LERROR, "Error %d retrieving '%s' from '%s' schema\n",
-                                  rc, col->name, avro_schema_name(schema));
-			continue;
-		}
-		rc = set_avro_value_from_col(&avro_col, col);
-	}
-#ifdef AVRO_KAFKA_DEBUG
-	char *json_buf;
-	avro_value_to_json(avro_row, 0, &json_buf);
-	fprintf(stderr, "%s\n", json_buf);
-	free(json_buf);
-#endif
-	return 0;
-}
-
 typedef struct str_s {
 	char *buf_ptr;
 	char *cur_ptr;
@@ -890,47 +733,35 @@ static char *get_topic_name(aks_handle_t sh, ldms_set_t set, ldmsd_row_t row)
 }
 
 
-static int row_to_avro_payload(aks_handle_t sh, ldmsd_row_t row,
-                               void **payload, size_t *sizep)
+/*
+ * Encode \c row into \c sh->enc as the serdes framing followed by the
+ * Avro binary encoding of the row. The Avro encoding is written straight
+ * from the row columns by the encoder compiled for the row schema.
+ */
+static int row_to_avro_payload(aks_handle_t sh, ldmsd_row_t row)
 {
-        serdes_schema_t *serdes_schema;
-        avro_schema_t schema;
-        avro_value_iface_t *class;
-        avro_value_t avro_row;
-
-        char errstr[512];
-        int rc = 0;
-
-        serdes_schema = serdes_schema_find(sh, (char *)row->schema_name, NULL, row);
-        if (!serdes_schema) {
-                ovis_log(sh->sf->log, OVIS_LERROR, "A serdes schema for '%s' could not be "
-                          "constructed.\n", row->schema_name);
-                rc = 1;
-                goto out1;
-        }
-        schema = serdes_schema_avro(serdes_schema);
-        class = avro_generic_class_from_schema(schema);
-        avro_generic_value_new(class, &avro_row);
-
-        /* Encode ldmsd_row_s as an Avro value */
-        rc = serialize_columns_of_row(schema, row, &avro_row, sh->sf->log);
-        if (rc) {
-                ovis_log(sh->sf->log, OVIS_LERROR, "Failed to format row as Avro value, error: %d\n", rc);
-                goto out2;
-        }
-        /* Serialize an Avro value into a buffer */
-        if (serdes_schema_serialize_avro(serdes_schema, &avro_row,
-                                         payload, sizep,
-                                         errstr, sizeof(errstr))) {
-                ovis_log(sh->sf->log, OVIS_LERROR, "Failed to serialize Avro row: '%s'\n", errstr);
-                rc = 1;
-                goto out2;
-        }
-out2:
-        avro_value_decref(&avro_row);
-        avro_value_iface_decref(class);
-out1:
-        return rc;
+	struct schema_entry *entry;
+	int rc;
+
+	entry = serdes_schema_find(sh, (char *)row->schema_name, NULL, row);
+	if (!entry) {
+		ovis_log(sh->sf->log, OVIS_LERROR, "A serdes schema for '%s' could not be "
+			  "constructed.\n", row->schema_name);
+		return EINVAL;
+	}
+	ldms_avro_enc_reset(&sh->enc);
+	rc = ldms_avro_enc_framing(&sh->enc, sh->serdes, entry->serdes_schema);
+	if (rc && rc != ENOPROTOOPT) {
+		ovis_log(sh->sf->log, OVIS_LERROR, "Failed to write the serdes framing, error: %d\n", rc);
+		return rc;
+	}
+	rc = aks_encoder_encode(entry->encoder, row, &sh->enc);
+	if (rc) {
+		ovis_log(sh->sf->log, OVIS_LERROR, "Failed to encode the '%s' row as Avro, error: %d\n",
+			 row->schema_name, rc);
+		return rc;
+	}
+	return 0;
 }
 
 /* protected by strgp->lock */
@@ -956,7 +787,7 @@ commit_rows(ldmsd_plug_handle_t handle, ldmsd_strgp_t strgp, ldms_set_t set, ldm
 	{
 		void *ser_buf = NULL;
 		size_t ser_buf_size;
-                int ser_size;
+		int ser_size, msgflags;
 
 		char *topic_name = get_topic_name(sh, set, row);
 		if (!topic_name) {
@@ -964,48 +795,51 @@ commit_rows(ldmsd_plug_handle_t handle, ldmsd_strgp_t strgp, ldms_set_t set, ldm
 			continue;
 		}
 		ovis_log(sh->sf->log, OVIS_LDEBUG, "topic name %s\n", topic_name);
-		rkt = rd_kafka_topic_new(sh->rd, topic_name, NULL);
+		rkt = topic_get(sh, topic_name);
 		if (!rkt)
 		{
 			ovis_log(sh->sf->log, OVIS_LERROR, "rd_kafka_topic_new(\"%s\") failed, "
 				  "errno: %d\n",
 				  topic_name, errno);
-			goto skip_row_0;
+			goto skip_row;
 		}
 		switch (sh->encoding) {
 		case AKS_ENCODING_AVRO:
-                        rc = row_to_avro_payload(sh, row, &ser_buf, &ser_buf_size);
+			rc = row_to_avro_payload(sh, row);
 			if (rc) {
 				ovis_log(sh->sf->log, OVIS_LERROR, "Failed to serialize row as AVRO object, error: %d", rc);
-				goto skip_row_1;
+				goto skip_row;
 			}
+			/* librdkafka copies the payload; sh->enc is reused */
+			ser_buf = sh->enc.buf;
+			ser_buf_size = sh->enc.len;
+			msgflags = RD_KAFKA_MSG_F_COPY;
 			break;
 		case AKS_ENCODING_JSON:
 			/* Encode row as a JSON text object */
 			rc = ldmsd_row_to_json_object(row, (char **)&ser_buf, &ser_size);
 			if (rc) {
 				ovis_log(sh->sf->log, OVIS_LERROR, "Failed to serialize row as JSON object, error: %d", rc);
-				goto skip_row_1;
+				goto skip_row;
 			}
 			ser_buf_size = (size_t)ser_size;
+			msgflags = RD_KAFKA_MSG_F_FREE;
 			break;
 		default:
 			assert(0 == "Invalid/unsupported serialization encoding");
 		}
 
-		/* Publish the Avro serialized buffer */
-		rc = rd_kafka_produce(rkt, RD_KAFKA_PARTITION_UA,
-				      RD_KAFKA_MSG_F_FREE,
+		/* Publish the serialized buffer */
+		rc = rd_kafka_produce(rkt, RD_KAFKA_PARTITION_UA, msgflags,
 				      ser_buf, ser_buf_size, NULL, 0, NULL);
 		if (rc) {
 			ovis_log(sh->sf->log, OVIS_LERROR,
                                  "rd_kafka_produce(\"%s\") failed, \"%s\"\n",
                                  topic_name, rd_kafka_err2str(rd_kafka_last_error()));
-			free(ser_buf);
+			if (msgflags == RD_KAFKA_MSG_F_FREE)
+				free(ser_buf);
 		}
-	skip_row_1:
-		rd_kafka_topic_destroy(rkt);
-	skip_row_0:
+	skip_row:
 		free(topic_name);
 	}
 
@@ -0,0 +1,174 @@
+/* -*- c-basic-offset: 8 -*-
+ * Copyright 2026 Lawrence Livermore National Security, LLC
+ * Copyright 2026 Open Grid Computing, Inc.
+ *
+ * See the top-level COPYING file for details.
+ *
+ * SPDX-License-Identifier: (GPL-2.0 OR BSD-3-Clause)
+ */
+/*
+ * Encode an ldmsd_row with aks_encoder and decode it with libavro.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <avro.h>
+#include "aks_encoder.h"
+
+#define ASSERT(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: assertion '%s' failed\n", \
+			__FILE__, __LINE__, #cond); \
+		exit(1); \
+	} \
+} while (0)
+
+static const char *schema_json =
+	"{\"name\":\"test\",\"type\":\"record\",\"fields\":["
+	"{\"name\":\"ts\",\"type\":{\"type\":\"long\",\"logicalType\":\"timestamp-millis\"}},"
+	"{\"name\":\"u8\",\"type\":\"int\"},"
+	"{\"name\":\"s32\",\"type\":\"int\"},"
+	"{\"name\":\"u32\",\"type\":\"long\"},"
+	"{\"name\":\"s64\",\"type\":\"long\"},"
+	"{\"name\":\"u64\",\"type\":\"long\"},"
+	"{\"name\":\"f32\",\"type\":\"float\"},"
+	"{\"name\":\"d64\",\"type\":\"double\"},"
+	"{\"name\":\"str\",\"type\":\"string\"},"
+	"{\"name\":\"arr\",\"type\":{\"type\":\"array\",\"items\":\"int\"}},"
+	"{\"name\":\"empty\",\"type\":{\"type\":\"array\",\"items\":\"double\"}}"
+	"]}";
+
+#define COLS 11
+#define ARR_LEN 4
+
+static void col_init(ldmsd_row_t row, int i, const char *name,
+		     enum ldms_value_type type, int array_len, uint8_t **mp)
+{
+	row->cols[i].name = name;
+	row->cols[i].type = type;
+	row->cols[i].array_len = array_len;
+	row->cols[i].mval = (ldms_mval_t)*mp;
+	*mp += 64;
+}
+
+int main(int argc, char **argv)
+{
+	ldmsd_row_t row;
+	uint8_t *m;
+	aks_encoder_t ae;
+	struct ldms_avro_enc_s enc = {0};
+	struct ldms_timestamp ts = { .sec = 1700000000, .usec = 123456 };
+	avro_schema_t schema;
+	avro_value_iface_t *iface;
+	avro_value_t val, f, item;
+	avro_reader_t rd;
+	int32_t i32;
+	int64_t i64;
+	float fl;
+	double d;
+	const char *s;
+	size_t sz;
+	int i, rc;
+
+	row = calloc(1, sizeof(*row) + COLS * sizeof(row->cols[0]));
+	ASSERT(row);
+	row->mvals = calloc(COLS, 64);
+	ASSERT(row->mvals);
+	row->schema_name = "test";
+	row->col_count = COLS;
+	m = row->mvals;
+	col_init(row, 0, "ts", LDMS_V_TIMESTAMP, 1, &m);
+	col_init(row, 1, "u8", LDMS_V_U8, 1, &m);
+	col_init(row, 2, "s32", LDMS_V_S32, 1, &m);
+	col_init(row, 3, "u32", LDMS_V_U32, 1, &m);
+	col_init(row, 4, "s64", LDMS_V_S64, 1, &m);
+	col_init(row, 5, "u64", LDMS_V_U64, 1, &m);
+	col_init(row, 6, "f32", LDMS_V_F32, 1, &m);
+	col_init(row, 7, "d64", LDMS_V_D64, 1, &m);
+	col_init(row, 8, "str", LDMS_V_CHAR_ARRAY, 16, &m);
+	col_init(row, 9, "arr", LDMS_V_S32_ARRAY, ARR_LEN, &m);
+	col_init(row, 10, "empty", LDMS_V_D64_ARRAY, 0, &m);
+
+	row->cols[0].mval->v_ts = ts; /* ldms_mval_set_ts() is not in libldms */
+	ldms_mval_set_u8(row->cols[1].mval, 255);
+	ldms_mval_set_s32(row->cols[2].mval, INT32_MIN);
+	ldms_mval_set_u32(row->cols[3].mval, UINT32_MAX);
+	ldms_mval_set_s64(row->cols[4].mval, INT64_MIN);
+	ldms_mval_set_u64(row->cols[5].mval, 1ULL << 40);
+	ldms_mval_set_float(row->cols[6].mval, 1.5);
+	ldms_mval_set_double(row->cols[7].mval, -2.25);
+	ldms_mval_array_set_str(row->cols[8].mval, "hello", 16);
+	for (i = 0; i < ARR_LEN; i++)
+		ldms_mval_array_set_s32(row->cols[9].mval, i, -i * 1000);
+
+	ae = aks_encoder_new(row);
+	ASSERT(ae);
+	rc = aks_encoder_encode(ae, row, &enc);
+	ASSERT(rc == 0);
+
+	rc = avro_schema_from_json_length(schema_json, strlen(schema_json), &schema);
+	ASSERT(rc == 0);
+	iface = avro_generic_class_from_schema(schema);
+	ASSERT(iface);
+	rc = avro_generic_value_new(iface, &val);
+	ASSERT(rc == 0);
+	rd = avro_reader_memory(enc.buf, enc.len);
+	ASSERT(rd);
+	rc = avro_value_read(rd, &val);
+	ASSERT(rc == 0);
+
+	avro_value_get_by_index(&val, 0, &f, NULL);
+	avro_value_get_long(&f, &i64);
+	ASSERT(i64 == 1700000000123LL);
+	avro_value_get_by_index(&val, 1, &f, NULL);
+	avro_value_get_int(&f, &i32);
+	ASSERT(i32 == 255);
+	avro_value_get_by_index(&val, 2, &f, NULL);
+	avro_value_get_int(&f, &i32);
+	ASSERT(i32 == INT32_MIN);
+	avro_value_get_by_index(&val, 3, &f, NULL);
+	avro_value_get_long(&f, &i64);
+	ASSERT(i64 == UINT32_MAX);
+	avro_value_get_by_index(&val, 4, &f, NULL);
+	avro_value_get_long(&f, &i64);
+	ASSERT(i64 == INT64_MIN);
+	avro_value_get_by_index(&val, 5, &f, NULL);
+	avro_value_get_long(&f, &i64);
+	ASSERT(i64 == (1LL << 40));
+	avro_value_get_by_index(&val, 6, &f, NULL);
+	avro_value_get_float(&f, &fl);
+	ASSERT(fl == 1.5);
+	avro_value_get_by_index(&val, 7, &f, NULL);
+	avro_value_get_double(&f, &d);
+	ASSERT(d == -2.25);
+	avro_value_get_by_index(&val, 8, &f, NULL);
+	avro_value_get_string(&f, &s, &sz);
+	ASSERT(sz == sizeof("hello") && 0 == strcmp(s, "hello"));
+	avro_value_get_by_index(&val, 9, &f, NULL);
+	avro_value_get_size(&f, &sz);
+	ASSERT(sz == ARR_LEN);
+	for (i = 0; i < ARR_LEN; i++) {
+		avro_value_get_by_index(&f, i, &item, NULL);
+		avro_value_get_int(&item, &i32);
+		ASSERT(i32 == -i * 1000);
+	}
+	avro_value_get_by_index(&val, 10, &f, NULL);
+	avro_value_get_size(&f, &sz);
+	ASSERT(sz == 0);
+
+	/* A row of a different shape is rejected */
+	row->cols[1].type = LDMS_V_U16;
+	ASSERT(aks_encoder_encode(ae, row, &enc) == EINVAL);
+
+	avro_reader_free(rd);
+	avro_value_decref(&val);
+	avro_value_iface_decref(iface);
+	avro_schema_decref(schema);
+	aks_encoder_free(ae);
+	ldms_avro_enc_free(&enc);
+	free(row->mvals);
+	free(row);
+	printf("test_aks_encoder: PASSED\n");
+	return 0;
+}
@@ -54,6 +54,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <assert.h>
 #include <fcntl.h>
 #include <stdbool.h>
@@ -68,12 +69,19 @@
 #include <coll/idx.h>
 #include <coll/rbt.h>
 #include <assert.h>
+#include "config.h"
 #include "ldms.h"
 #include "ldmsd.h"
 #include "ldmsd_plug_api.h"
 #include "ldmsd_plugattr.h"
 #include "store_common.h"
 #include "store_csv_common.h"
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+#ifdef HAVE_LIBZSTD
+#include <zstd.h>
+#endif
 
 #define TV_SEC_COL	0
 #define TV_USEC_COL	1
@@ -87,6 +95,83 @@
 
 #define PNAME "store_csv"
 
+/*
+ * Rows are formatted into per-handle buffers and handed to a per-plugin
+ * writer thread, which owns all output to the data files: large
+ * write/writev calls, optional compression, fsync, and closing and
+ * renaming of files retired by rollover.
+ */
+#define CSV_WBUF_INIT_SZ	8192	/* initial row buffer allocation */
+#define CSV_WBUF_HIWAT		(64 * 1024) /* submit a row buffer at this length */
+#define CSV_WBUF_MAX_AGE	5	/* seconds rows may wait in an autosized buffer */
+#define CSV_WBUF_FREE_MAX	64	/* row buffers cached for reuse */
+#define CSV_WQ_MAX_BYTES	(64 * 1024 * 1024) /* producers block above this backlog */
+#define CSV_WRITER_IOV		64	/* buffers gathered in one writev */
+#define CSV_ZBUF_SZ		(256 * 1024) /* compressed output staging */
+
+#define CSV_WREQ_F_FLUSH	0x1	/* push compressor state to the file */
+#define CSV_WREQ_F_SYNC		0x2	/* flush and fsync */
+#define CSV_WREQ_F_CLOSE	0x4	/* finish, close, and free the stream */
+#define CSV_WREQ_F_RENAME	0x8	/* rename_output() after close */
+#define CSV_WREQ_F_WAIT		0x10	/* submitter waits for and frees the buffer */
+
+typedef enum csv_compress {
+	CSV_COMPRESS_NONE,
+	CSV_COMPRESS_GZIP,
+	CSV_COMPRESS_ZSTD,
+} csv_compress_t;
+
+typedef enum csv_zmode {
+	CSV_Z_CONTINUE,
+	CSV_Z_FLUSH,
+	CSV_Z_END,
+} csv_zmode_t;
+
+struct csv_store_handle;
+
+/* An open data file. Only the writer thread touches it once it has
+ * been handed over with the first buffer. */
+struct csv_ostream {
+	FILE *fp; /* owns the descriptor; stdio buffering is not used */
+	int fd;
+	char *filename;
+	csv_compress_t compress;
+	int err; /* last write error, logged once */
+	struct csv_store_handle *s_handle; /* rename and permission settings */
+	char *zbuf; /* compressed output not yet written */
+	size_t zlen;
+#ifdef HAVE_LIBZ
+	z_stream zs;
+#endif
+#ifdef HAVE_LIBZSTD
+	ZSTD_CStream *zcs;
+#endif
+};
+
+/* Formatted rows, and the unit of work for the writer thread. */
+struct csv_wbuf {
+	TAILQ_ENTRY(csv_wbuf) entry;
+	struct csv_ostream *os;
+	int flags; /* CSV_WREQ_F_* */
+	int done;
+	size_t len;
+	size_t alloc;
+	char *data;
+};
+TAILQ_HEAD(csv_wbuf_list, csv_wbuf);
+
+struct csv_writer {
+	pthread_mutex_t lock;
+	pthread_cond_t cond; /* queue, completion, and backlog changes */
+	pthread_t thread;
+	int started;
+	int stop;
+	size_t qbytes; /* queued bytes not yet written */
+	struct csv_wbuf_list queue;
+	struct csv_wbuf_list free_list;
+	int free_count;
+};
+
 /* Plugin structure */
 typedef struct store_csv_s {
 	pthread_mutex_t cfg_lock;
@@ -107,10 +192,17 @@ typedef struct store_csv_s {
 	pthread_t rothread;
 	int rothread_used;
 
+	struct csv_writer writer;
+	LIST_ENTRY(store_csv_s) entry; /* in sc_list */
+
 	int init;
 
 } *store_csv_t;
 
+/* plugin instances, for flushing queued rows when the process exits */
+static LIST_HEAD(, store_csv_s) sc_list = LIST_HEAD_INITIALIZER(sc_list);
+static pthread_mutex_t sc_list_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /** ROLLTYPES documents rolltype and is used in help output. Also used for buffering */
 #define ROLLTYPES \
 "                     1: wake approximately every rollover seconds and roll.\n" \
@@ -168,8 +260,11 @@ typedef enum csv_store_handle_type {
 struct csv_store_handle {
 	csv_store_handle_type_t type;
 	char *path;
-	FILE *file;
-	FILE *headerfile;
+	struct csv_ostream *os; /* data file */
+	struct csv_wbuf *wb; /* rows not yet handed to the writer */
+	time_t last_submit;
+	csv_compress_t compress;
+	FILE *headerfile; /* only when altheader */
 	printheader_t printheader;
 	int udata;
 	pthread_mutex_t lock;
@@ -232,6 +327,625 @@ static char* allocStoreKey(const char* container, const char* schema){
 }
 
 
+static const char *csv_compress_suffix(csv_compress_t c)
+{
+	switch (c) {
+	case CSV_COMPRESS_GZIP:
+		return ".gz";
+	case CSV_COMPRESS_ZSTD:
+		return ".zst";
+	default:
+		return "";
+	}
+}
+
+static int __write_full(int fd, const char *data, size_t len)
+{
+	ssize_t rc;
+	while (len) {
+		rc = write(fd, data, len);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			return errno;
+		}
+		data += rc;
+		len -= rc;
+	}
+	return 0;
+}
+
+/* iov is consumed */
+static int __writev_full(int fd, struct iovec *iov, int n)
+{
+	ssize_t rc;
+	while (n) {
+		rc = writev(fd, iov, n);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			return errno;
+		}
+		while (n && (size_t)rc >= iov->iov_len) {
+			rc -= iov->iov_len;
+			iov++;
+			n--;
+		}
+		if (n) {
+			iov->iov_base = (char *)iov->iov_base + rc;
+			iov->iov_len -= rc;
+		}
+	}
+	return 0;
+}
+
+static void csv_ostream_error(struct csv_ostream *os, int rc)
+{
+	if (rc && rc != os->err)
+		ovis_log(mylog, OVIS_LERROR, "Error %d writing to '%s'\n",
+			 rc, os->filename);
+	os->err = rc;
+}
+
+/* Stage compressed output, writing zbuf to the file when full. */
+static int __zbuf_drain(struct csv_ostream *os, int all)
+{
+	int rc;
+	if (!os->zlen || (!all && os->zlen < CSV_ZBUF_SZ))
+		return 0;
+	rc = __write_full(os->fd, os->zbuf, os->zlen);
+	os->zlen = 0;
+	return rc;
+}
+
+#ifdef HAVE_LIBZ
+static int csv_ostream_gzip(struct csv_ostream *os, const char *data,
+			    size_t len, csv_zmode_t mode)
+{
+	int zflush, zrc, rc, full;
+	zflush = (mode == CSV_Z_END)?Z_FINISH:
+		 (mode == CSV_Z_FLUSH)?Z_SYNC_FLUSH:Z_NO_FLUSH;
+	os->zs.next_in = (Bytef *)data;
+	os->zs.avail_in = len;
+	do {
+		os->zs.next_out = (Bytef *)os->zbuf + os->zlen;
+		os->zs.avail_out = CSV_ZBUF_SZ - os->zlen;
+		zrc = deflate(&os->zs, zflush);
+		if (zrc == Z_STREAM_ERROR)
+			return EIO;
+		os->zlen = CSV_ZBUF_SZ - os->zs.avail_out;
+		full = (os->zs.avail_out == 0);
+		rc = __zbuf_drain(os, 0);
+		if (rc)
+			return rc;
+	} while (os->zs.avail_in || full);
+	return 0;
+}
+#endif
+
+#ifdef HAVE_LIBZSTD
+static int csv_ostream_zstd(struct csv_ostream *os, const char *data,
+			    size_t len, csv_zmode_t mode)
+{
+	ZSTD_EndDirective zmode;
+	ZSTD_inBuffer in = { data, len, 0 };
+	ZSTD_outBuffer out;
+	size_t remaining;
+	int rc;
+	zmode = (mode == CSV_Z_END)?ZSTD_e_end:
+		(mode == CSV_Z_FLUSH)?ZSTD_e_flush:ZSTD_e_continue;
+	do {
+		out.dst = os->zbuf;
+		out.size = CSV_ZBUF_SZ;
+		out.pos = os->zlen;
+		remaining = ZSTD_compressStream2(os->zcs, &out, &in, zmode);
+		if (ZSTD_isError(remaining)) {
+			ovis_log(mylog, OVIS_LERROR, "zstd error on '%s': %s\n",
+				 os->filename, ZSTD_getErrorName(remaining));
+			return EIO;
+		}
+		os->zlen = out.pos;
+		rc = __zbuf_drain(os, 0);
+		if (rc)
+			return rc;
+	} while ((zmode == ZSTD_e_continue)?(in.pos < in.size):(remaining != 0));
+	return 0;
+}
+#endif
+
+/* Compress data into the stream; CSV_Z_FLUSH and CSV_Z_END also write out
+ * everything staged so far. No-op for uncompressed streams. */
+static int csv_ostream_compress(struct csv_ostream *os, const char *data,
+				size_t len, csv_zmode_t mode)
+{
+	int rc;
+	switch (os->compress) {
+#ifdef HAVE_LIBZ
+	case CSV_COMPRESS_GZIP:
+		rc = csv_ostream_gzip(os, data, len, mode);
+		break;
+#endif
+#ifdef HAVE_LIBZSTD
+	case CSV_COMPRESS_ZSTD:
+		rc = csv_ostream_zstd(os, data, len, mode);
+		break;
+#endif
+	default:
+		return 0;
+	}
+	if (!rc && mode != CSV_Z_CONTINUE)
+		rc = __zbuf_drain(os, 1);
+	return rc;
+}
+
+static void csv_ostream_free(struct csv_ostream *os)
+{
+	switch (os->compress) {
+#ifdef HAVE_LIBZ
+	case CSV_COMPRESS_GZIP:
+		deflateEnd(&os->zs);
+		break;
+#endif
+#ifdef HAVE_LIBZSTD
+	case CSV_COMPRESS_ZSTD:
+		ZSTD_freeCStream(os->zcs);
+		break;
+#endif
+	default:
+		break;
+	}
+	if (os->fp)
+		fclose(os->fp);
+	free(os->zbuf);
+	free(os->filename);
+	free(os);
+}
+
+/* Open (append) a data file for s_handle. Returns NULL with errno set. */
+static struct csv_ostream *
+csv_ostream_open(struct csv_store_handle *s_handle, const char *filename)
+{
+	struct csv_ostream *os;
+	int rc = ENOMEM;
+
+	os = calloc(1, sizeof(*os));
+	if (!os)
+		goto err_0;
+	os->s_handle = s_handle;
+	os->compress = s_handle->compress;
+	os->filename = strdup(filename);
+	if (!os->filename)
+		goto err_1;
+	if (os->compress != CSV_COMPRESS_NONE) {
+		os->zbuf = malloc(CSV_ZBUF_SZ);
+		if (!os->zbuf)
+			goto err_1;
+	}
+	switch (os->compress) {
+#ifdef HAVE_LIBZ
+	case CSV_COMPRESS_GZIP:
+		/* 16 + MAX_WBITS selects the gzip wrapper */
+		if (Z_OK != deflateInit2(&os->zs, Z_DEFAULT_COMPRESSION,
+					 Z_DEFLATED, 16 + MAX_WBITS, 8,
+					 Z_DEFAULT_STRATEGY))
+			goto err_1;
+		break;
+#endif
+#ifdef HAVE_LIBZSTD
+	case CSV_COMPRESS_ZSTD:
+		os->zcs = ZSTD_createCStream();
+		if (!os->zcs)
+			goto err_1;
+		break;
+#endif
+	default:
+		break;
+	}
+	os->fp = fopen_perm(filename, "a+", LDMSD_DEFAULT_FILE_PERM);
+	if (!os->fp) {
+		rc = errno;
+		goto err_2;
+	}
+	os->fd = fileno(os->fp);
+	ch_output(os->fp, filename, CSHC(s_handle), &PG);
+	return os;
+
+ err_2:
+	csv_ostream_free(os);
+	errno = rc;
+	return NULL;
+ err_1:
+	/* compressor state may be partially set up */
+	os->compress = CSV_COMPRESS_NONE;
+	csv_ostream_free(os);
+ err_0:
+	errno = rc;
+	return NULL;
+}
+
+/* writer thread only */
+static void csv_ostream_writev(struct csv_ostream *os, struct iovec *iov, int n)
+{
+	int i, rc = 0;
+	if (os->compress == CSV_COMPRESS_NONE) {
+		rc = __writev_full(os->fd, iov, n);
+	} else {
+		for (i = 0; i < n && !rc; i++)
+			rc = csv_ostream_compress(os, iov[i].iov_base,
+						  iov[i].iov_len, CSV_Z_CONTINUE);
+	}
+	csv_ostream_error(os, rc);
+}
+
+/* writer thread only */
+static void csv_ostream_close(struct csv_ostream *os, int rename)
+{
+	struct csv_store_handle *s_handle = os->s_handle;
+	char *name;
+
+	csv_ostream_error(os, csv_ostream_compress(os, NULL, 0, CSV_Z_END));
+	fclose(os->fp);
+	os->fp = NULL;
+	name = os->filename;
+	os->filename = NULL;
+	csv_ostream_free(os);
+	if (rename)
+		rename_output(name, FTYPE_DATA, CSHC(s_handle), &PG);
+	free(name);
+}
+
+/* caller MUST hold w->lock */
+static void __csv_wbuf_put(struct csv_writer *w, struct csv_wbuf *wb)
+{
+	if (w->free_count < CSV_WBUF_FREE_MAX) {
+		TAILQ_INSERT_HEAD(&w->free_list, wb, entry);
+		w->free_count++;
+		return;
+	}
+	free(wb->data);
+	free(wb);
+}
+
+static struct csv_wbuf *csv_wbuf_get(struct csv_writer *w)
+{
+	struct csv_wbuf *wb;
+
+	pthread_mutex_lock(&w->lock);
+	wb = TAILQ_FIRST(&w->free_list);
+	if (wb) {
+		TAILQ_REMOVE(&w->free_list, wb, entry);
+		w->free_count--;
+	}
+	pthread_mutex_unlock(&w->lock);
+	if (!wb)
+		return calloc(1, sizeof(*wb));
+	wb->os = NULL;
+	wb->flags = 0;
+	wb->done = 0;
+	wb->len = 0;
+	return wb;
+}
+
+static int wbuf_reserve(struct csv_wbuf *wb, size_t n)
+{
+	size_t sz;
+	char *data;
+
+	if (wb->len + n <= wb->alloc)
+		return 0;
+	sz = wb->alloc ? wb->alloc : CSV_WBUF_INIT_SZ;
+	while (sz < wb->len + n)
+		sz *= 2;
+	data = realloc(wb->data, sz);
+	if (!data)
+		return ENOMEM;
+	wb->data = data;
+	wb->alloc = sz;
+	return 0;
+}
+
+/*
+ * Row formatting. Each returns the number of bytes appended or a
+ * negative errno.
+ */
+static inline int wb_putc(struct csv_wbuf *wb, char c)
+{
+	if (wbuf_reserve(wb, 1))
+		return -ENOMEM;
+	wb->data[wb->len++] = c;
+	return 1;
+}
+
+static inline int wb_putsn(struct csv_wbuf *wb, const char *s, size_t n)
+{
+	if (wbuf_reserve(wb, n))
+		return -ENOMEM;
+	memcpy(wb->data + wb->len, s, n);
+	wb->len += n;
+	return n;
+}
+
+static inline int wb_puts(struct csv_wbuf *wb, const char *s)
+{
+	return wb_putsn(wb, s, strlen(s));
+}
+
+/* decimal, zero-padded on the left to at least width digits */
+static int wb_u64_pad(struct csv_wbuf *wb, uint64_t v, int width)
+{
+	char tmp[20];
+	int n = 0;
+	do {
+		tmp[sizeof(tmp) - ++n] = '0' + (v % 10);
+		v /= 10;
+	} while (v);
+	while (n < width && n < sizeof(tmp))
+		tmp[sizeof(tmp) - ++n] = '0';
+	return wb_putsn(wb, &tmp[sizeof(tmp) - n], n);
+}
+
+static inline int wb_u64(struct csv_wbuf *wb, uint64_t v)
+{
+	return wb_u64_pad(wb, v, 0);
+}
+
+static int wb_s64(struct csv_wbuf *wb, int64_t v)
+{
+	int rc;
+	if (v >= 0)
+		return wb_u64(wb, v);
+	if (wb_putc(wb, '-') < 0)
+		return -ENOMEM;
+	rc = wb_u64(wb, -(uint64_t)v);
+	return (rc < 0)?rc:rc + 1;
+}
+
+/* used for floating point, where printf output is the format of record */
+static int wb_printf(struct csv_wbuf *wb, const char *fmt, ...)
+{
+	va_list ap;
+	int n;
+
+	if (wbuf_reserve(wb, 32))
+		return -ENOMEM;
+	va_start(ap, fmt);
+	n = vsnprintf(wb->data + wb->len, wb->alloc - wb->len, fmt, ap);
+	va_end(ap);
+	if (n < 0)
+		return -EINVAL;
+	if ((size_t)n >= wb->alloc - wb->len) {
+		if (wbuf_reserve(wb, n + 1))
+			return -ENOMEM;
+		va_start(ap, fmt);
+		n = vsnprintf(wb->data + wb->len, wb->alloc - wb->len, fmt, ap);
+		va_end(ap);
+	}
+	wb->len += n;
+	return n;
+}
+
+static inline int __wb_sum(int a, int b)
+{
+	if (a < 0)
+		return a;
+	if (b < 0)
+		return b;
+	return a + b;
+}
+
+/*
+ * Write a batch of buffers, gathering runs destined for the same stream
+ * into a single writev. Returns the number of bytes consumed.
+ */
+static size_t csv_writer_process(struct csv_wbuf_list *batch)
+{
+	struct iovec iov[CSV_WRITER_IOV];
+	struct csv_wbuf *wb, *next;
+	struct csv_ostream *os;
+	size_t bytes = 0;
+	int n, flags, rc;
+
+	for (wb = TAILQ_FIRST(batch); wb; wb = next) {
+		os = wb->os;
+		n = 0;
+		next = wb;
+		do {
+			if (next->len) {
+				iov[n].iov_base = next->data;
+				iov[n].iov_len = next->len;
+				bytes += next->len;
+				n++;
+			}
+			flags = next->flags;
+			next = TAILQ_NEXT(next, entry);
+		} while (!flags && next && next->os == os && n < CSV_WRITER_IOV);
+		if (!os)
+			continue;
+		if (n)
+			csv_ostream_writev(os, iov, n);
+		if (flags & CSV_WREQ_F_CLOSE) {
+			csv_ostream_close(os, flags & CSV_WREQ_F_RENAME);
+			continue;
+		}
+		if (flags & (CSV_WREQ_F_FLUSH | CSV_WREQ_F_SYNC)) {
+			rc = csv_ostream_compress(os, NULL, 0, CSV_Z_FLUSH);
+			csv_ostream_error(os, rc);
+		}
+		if (flags & CSV_WREQ_F_SYNC)
+			fsync(os->fd);
+	}
+	return bytes;
+}
+
+static void *csv_writer_proc(void *arg)
+{
+	struct csv_writer *w = arg;
+	struct csv_wbuf_list batch;
+	struct csv_wbuf *wb;
+	size_t bytes;
+
+	pthread_mutex_lock(&w->lock);
+	while (1) {
+		while (!w->stop && TAILQ_EMPTY(&w->queue))
+			pthread_cond_wait(&w->cond, &w->lock);
+		if (TAILQ_EMPTY(&w->queue))
+			break; /* stopped and drained */
+		TAILQ_INIT(&batch);
+		TAILQ_CONCAT(&batch, &w->queue, entry);
+		pthread_mutex_unlock(&w->lock);
+
+		bytes = csv_writer_process(&batch);
+
+		pthread_mutex_lock(&w->lock);
+		w->qbytes -= bytes;
+		while ((wb = TAILQ_FIRST(&batch))) {
+			TAILQ_REMOVE(&batch, wb, entry);
+			if (wb->flags & CSV_WREQ_F_WAIT)
+				wb->done = 1;
+			else
+				__csv_wbuf_put(w, wb);
+		}
+		pthread_cond_broadcast(&w->cond);
+	}
+	pthread_mutex_unlock(&w->lock);
+	return NULL;
+}
+
+static void csv_writer_init(struct csv_writer *w)
+{
+	pthread_mutex_init(&w->lock, NULL);
+	pthread_cond_init(&w->cond, NULL);
+	TAILQ_INIT(&w->queue);
+	TAILQ_INIT(&w->free_list);
+}
+
+static int csv_writer_start(struct csv_writer *w)
+{
+	int rc;
+	if (w->started)
+		return 0;
+	w->stop = 0;
+	rc = pthread_create(&w->thread, NULL, csv_writer_proc, w);
+	if (rc)
+		return rc;
+	pthread_setname_np(w->thread, "store_csv:wr");
+	w->started = 1;
+	return 0;
+}
+
+/* Drain the queue and stop the writer thread. */
+static void csv_writer_stop(struct csv_writer *w)
+{
+	struct csv_wbuf *wb;
+
+	if (w->started) {
+		pthread_mutex_lock(&w->lock);
+		w->stop = 1;
+		pthread_cond_broadcast(&w->cond);
+		pthread_mutex_unlock(&w->lock);
+		pthread_join(w->thread, NULL);
+		pthread_mutex_lock(&w->lock);
+		w->started = 0;
+		pthread_mutex_unlock(&w->lock);
+	}
+	while ((wb = TAILQ_FIRST(&w->free_list))) {
+		TAILQ_REMOVE(&w->free_list, wb, entry);
+		free(wb->data);
+		free(wb);
+	}
+	w->free_count = 0;
+}
+
+/* caller MUST hold s_handle->lock */
+static struct csv_wbuf *csv_store_handle_wbuf(struct csv_store_handle *s_handle)
+{
+	if (!s_handle->wb)
+		s_handle->wb = csv_wbuf_get(&s_handle->sc->writer);
+	return s_handle->wb;
+}
+
+/*
+ * Hand the pending rows of s_handle to the writer, along with the
+ * CSV_WREQ_F_* actions to perform on the data file afterwards.
+ * Blocks while the writer backlog is over CSV_WQ_MAX_BYTES, and with
+ * CSV_WREQ_F_WAIT until the writer has completed the request.
+ * caller MUST hold s_handle->lock.
+ */
+static int csv_wbuf_submit(struct csv_store_handle *s_handle, int flags)
+{
+	struct csv_writer *w = &s_handle->sc->writer;
+	struct csv_wbuf *wb = s_handle->wb;
+
+	if (!flags && (!wb || !wb->len))
+		return 0;
+	if (!s_handle->os)
+		return EINVAL;
+	if (!wb) {
+		wb = csv_wbuf_get(w);
+		if (!wb)
+			return ENOMEM;
+	}
+	s_handle->wb = NULL;
+	s_handle->last_submit = time(NULL);
+	wb->os = s_handle->os;
+	wb->flags = flags;
+	wb->done = 0;
+
+	pthread_mutex_lock(&w->lock);
+	if (!w->started) {
+		/* writer stopped at exit; write in the caller */
+		struct csv_wbuf_list one;
+		pthread_mutex_unlock(&w->lock);
+		TAILQ_INIT(&one);
+		TAILQ_INSERT_TAIL(&one, wb, entry);
+		csv_writer_process(&one);
+		pthread_mutex_lock(&w->lock);
+		__csv_wbuf_put(w, wb);
+		pthread_mutex_unlock(&w->lock);
+		return 0;
+	}
+	while (w->qbytes > CSV_WQ_MAX_BYTES && !w->stop)
+		pthread_cond_wait(&w->cond, &w->lock);
+	w->qbytes += wb->len;
+	TAILQ_INSERT_TAIL(&w->queue, wb, entry);
+	pthread_cond_broadcast(&w->cond);
+	if (flags & CSV_WREQ_F_WAIT) {
+		while (!wb->done)
+			pthread_cond_wait(&w->cond, &w->lock);
+		__csv_wbuf_put(w, wb);
+	}
+	pthread_mutex_unlock(&w->lock);
+	return 0;
+}
+
+/*
+ * Apply the buffer= / buffertype= policy after a row is formatted.
+ * caller MUST hold s_handle->lock.
+ */
+static void csv_store_handle_flush_check(struct csv_store_handle *s_handle)
+{
+	int doflush = 0;
+
+	if ((s_handle->buffer_type == 3) &&
+	    ((s_handle->store_count - s_handle->lastflush) >=
+	     s_handle->buffer_sz)){
+		s_handle->lastflush = s_handle->store_count;
+		doflush = 1;
+	} else if ((s_handle->buffer_type == 4) &&
+		 ((s_handle->byte_count - s_handle->lastflush) >=
+		  s_handle->buffer_sz)){
+		s_handle->lastflush = s_handle->byte_count;
+		doflush = 1;
+	}
+	if ((s_handle->buffer_sz == 0) || doflush) {
+		csv_wbuf_submit(s_handle, CSV_WREQ_F_SYNC);
+		return;
+	}
+	if (s_handle->wb && (s_handle->wb->len >= CSV_WBUF_HIWAT ||
+		time(NULL) - s_handle->last_submit >= CSV_WBUF_MAX_AGE))
+		csv_wbuf_submit(s_handle, 0);
+}
+
 struct roll_cb_arg {
 	struct csv_plugin_static *cps;
 	time_t appx;
@@ -249,7 +963,7 @@ static void roll_cb(void *obj, void *cb_arg)
 	store_csv_t sc = args->sc;
 
 	FILE* nhfp = NULL;
-	FILE* nfp = NULL;
+	struct csv_ostream *nos = NULL;
 
 	char *new_filename = NULL;
 	char *new_headerfilename = NULL;
@@ -289,15 +1003,14 @@ static void roll_cb(void *obj, void *cb_arg)
 	}
 
 
-	if (s_handle->file)
-		fflush(s_handle->file);
 	if (s_handle->headerfile)
 		fflush(s_handle->headerfile);
 
 	/* == preparing new filenames == */
 
 	/* new filename */
-	len = asprintf(&new_filename, "%s.%ld", s_handle->path, appx);
+	len = asprintf(&new_filename, "%s.%ld%s", s_handle->path, appx,
+		       csv_compress_suffix(s_handle->compress));
 	if (len < 0) {
 		ERR_LOG("out of memory: %s:%s():%d\n", __FILE__, __func__, __LINE__);
 		goto out;
@@ -327,37 +1040,33 @@ static void roll_cb(void *obj, void *cb_arg)
 	/* open files */
 
 	//re name: if got here, then rollover requested
-	nfp = fopen_perm(new_filename, "a+", LDMSD_DEFAULT_FILE_PERM);
-	if (!nfp){
+	nos = csv_ostream_open(s_handle, new_filename);
+	if (!nos){
 		//we cant open the new file, skip
 		ERR_LOG("cannot open file <%s>\n", new_filename);
 		goto err_3;
 	}
-	ch_output(nfp, new_filename, CSHC(s_handle), cps);
 
 	if (s_handle->altheader){
 		/* truncate a separate headerfile if it exists.
 		 * FIXME: do we still want to do this? */
 		nhfp = fopen_perm(new_headerfilename, "w", LDMSD_DEFAULT_FILE_PERM);
 		if (!nhfp){
-			fclose(nfp);
 			ERR_LOG("cannot open file <%s>\n", new_headerfilename);
 			goto err_4;
 		}
 		ch_output(nhfp, new_headerfilename, CSHC(s_handle), cps);
-	} else {
-		nhfp = nfp;
 	}
 
 	//close and swap
-	if (s_handle->headerfile && s_handle->altheader) {
-		/* if s_handle->altheader == 0, headerfile is file */
+	if (s_handle->headerfile) {
+		/* only open with altheader */
 		fclose(s_handle->headerfile);
 	}
-	if (s_handle->file) {
-		fclose(s_handle->file);
-		rename_output(s_handle->filename, FTYPE_DATA,
-			CSHC(s_handle), cps);
+	if (s_handle->os) {
+		/* The writer finishes, closes, and renames the retired file
+		 * after the rows already queued for it. */
+		csv_wbuf_submit(s_handle, CSV_WREQ_F_CLOSE | CSV_WREQ_F_RENAME);
 	}
 	if (s_handle->altheader != 0 && s_handle->headerfilename) {
 		rename_output(s_handle->headerfilename, FTYPE_HDR,
@@ -369,7 +1078,7 @@ static void roll_cb(void *obj, void *cb_arg)
 		free(s_handle->typefilename);
 		s_handle->typefilename = new_typefilename;
 	}
-	s_handle->file = nfp;
+	s_handle->os = nos;
 	free(s_handle->filename);
 	s_handle->filename = new_filename;
 	s_handle->headerfile = nhfp;
@@ -381,7 +1090,7 @@ static void roll_cb(void *obj, void *cb_arg)
 	goto out;
 
 err_4:
-	fclose(nfp);
+	csv_ostream_free(nos);
 err_3:
 	free(new_typefilename); /* may be NULL, but it is OK */
 err_2:
@@ -528,6 +1237,30 @@ static int config_handle(struct csv_store_handle *s_handle)
 		if (c)
 			s_handle->array_rquote = c[0];
 	}
+	s_handle->compress = CSV_COMPRESS_NONE;
+	c = (char *)ldmsd_plugattr_value(sc->pa, "compress", k);
+	if (!c || 0 == strcmp(c, "none")) {
+		/* default */
+	} else if (0 == strcmp(c, "gzip")) {
+#ifdef HAVE_LIBZ
+		s_handle->compress = CSV_COMPRESS_GZIP;
+#else
+		ovis_log(mylog, OVIS_LERROR, "compress=gzip is not supported; "
+			"store_csv was built without zlib.\n");
+		return ENOTSUP;
+#endif
+	} else if (0 == strcmp(c, "zstd")) {
+#ifdef HAVE_LIBZSTD
+		s_handle->compress = CSV_COMPRESS_ZSTD;
+#else
+		ovis_log(mylog, OVIS_LERROR, "compress=zstd is not supported; "
+			"store_csv was built without libzstd.\n");
+		return ENOTSUP;
+#endif
+	} else {
+		ovis_log(mylog, OVIS_LERROR, "improper compress= input '%s'.\n", c);
+		return EINVAL;
+	}
 	return 0;
 }
 
@@ -665,6 +1398,7 @@ static int config(ldmsd_plug_handle_t handle, struct attr_value_list *kwl, struc
 		"rollover",
 		"rolltype",
 		"rollempty",
+		"compress",
 		CSV_STORE_ATTR_COMMON,
 		NULL
 	};
@@ -823,6 +1557,12 @@ static int config(ldmsd_plug_handle_t handle, struct attr_value_list *kwl, struc
 		}
 	}
 
+	rc = csv_writer_start(&sc->writer);
+	if (rc) {
+		ovis_log(mylog, OVIS_LERROR, "writer thread create error: %d\n", rc);
+		goto out;
+	}
+
 	sc->rollover = roll;
 	sc->rollagain = ragain;
 	if (rollmethod >= MINROLLTYPE) {
@@ -842,6 +1582,7 @@ static const char *usage(ldmsd_plug_handle_t handle)
 	return  "    config name=store_csv path=<path> rollover=<num> rolltype=<num>\n"
 		"           [altheader=<0/!0> userdata=<0/!0>]\n"
 		"           [buffer=<0/1/N> buffertype=<3/4>]\n"
+		"           [compress=<none/gzip/zstd>]\n"
 		"           [rename_template=<metapath> [rename_uid=<int-uid> [rename_gid=<int-gid]\n"
 		"               rename_perm=<octal-mode>]]\n"
 		"           [create_uid=<int-uid> [create_gid=<int-gid] create_perm=<octal-mode>]\n"
@@ -866,16 +1607,71 @@ static const char *usage(ldmsd_plug_handle_t handle)
 		"                     N > 1 to flush after that many kb (> 4) or that many lines (>=1)\n"
 		"         - buffertype [3,4] Defines the policy used to schedule buffer flush.\n"
 		"                      Only applies for N > 1. Same as rolltypes.\n"
+		"         - compress  Compress data files with gzip or zstd (default none).\n"
+		"                     The suffix .gz or .zst is added to data file names.\n"
 		"\n"
 		;
 }
 
+/*
+ * The header goes to the separate header file with altheader, otherwise
+ * it is formatted in memory and queued ahead of the rows in the data file.
+ * caller MUST hold the s_handle->lock
+ */
+static FILE *header_stream_open(struct csv_store_handle *s_handle,
+				char **hbuf, size_t *hlen)
+{
+	FILE *fp;
+	if (s_handle->altheader) {
+		fp = s_handle->headerfile;
+		if (!fp)
+			ovis_log(mylog, OVIS_LERROR, "Cannot print header. No headerfile\n");
+		return fp;
+	}
+	fp = open_memstream(hbuf, hlen);
+	if (!fp)
+		ovis_log(mylog, OVIS_LERROR, "Cannot print header. "
+			 "open_memstream error %d\n", errno);
+	return fp;
+}
+
+/* caller MUST hold the s_handle->lock */
+static int header_stream_close(struct csv_store_handle *s_handle, FILE *fp,
+			       char **hbuf, size_t *hlen)
+{
+	struct csv_wbuf *wb;
+	int rc;
+
+	if (s_handle->altheader) {
+		fflush(fp);
+		fsync(fileno(fp));
+		fclose(fp);
+		s_handle->headerfile = NULL;
+		return 0;
+	}
+	fclose(fp); /* sets *hbuf and *hlen */
+	wb = csv_store_handle_wbuf(s_handle);
+	if (!wb) {
+		free(*hbuf);
+		return ENOMEM;
+	}
+	rc = wb_putsn(wb, *hbuf, *hlen);
+	free(*hbuf);
+	if (rc < 0)
+		return -rc;
+	/* Flush for the header, as if it was a separate file */
+	return csv_wbuf_submit(s_handle, CSV_WREQ_F_SYNC);
+}
+
 /* caller MUST hold the s_handle->lock */
 static int print_header_from_row(struct csv_store_handle *s_handle,
 				 ldms_set_t set, struct ldmsd_row_s *row)
 {
 	/* Only called from Store which already has the lock */
 	FILE* fp;
+	char *hbuf = NULL;
+	size_t hlen = 0;
+	int rc;
 
 	if (s_handle == NULL){
 		ovis_log(mylog, OVIS_LERROR, "Null store handle. Cannot print header\n");
@@ -883,22 +1679,15 @@ static int print_header_from_row(struct csv_store_handle *s_handle,
 	}
 	s_handle->printheader = DONT_PRINT_HEADER;
 
-	fp = s_handle->headerfile;
-	if (!fp){
-		ovis_log(mylog, OVIS_LERROR, "Cannot print header. No headerfile\n");
+	fp = header_stream_open(s_handle, &hbuf, &hlen);
+	if (!fp)
 		return EINVAL;
-	}
 	csv_row_format_header(fp, s_handle->headerfilename, CCSHC(s_handle), s_handle->udata,
                                  &PG, set, row,
                                  s_handle->time_format);
-
-	/* Flush for the header, whether or not it is the data file as well */
-	fflush(fp);
-	fsync(fileno(fp));
-
-	if (s_handle->headerfile && s_handle->altheader)
-		fclose(s_handle->headerfile);
-	s_handle->headerfile = 0;
+	rc = header_stream_close(s_handle, fp, &hbuf, &hlen);
+	if (rc)
+		return rc;
 	fp = NULL;
 
 	/* dump data types header, or whine and continue to other headers. */
@@ -935,6 +1724,9 @@ static int print_header_from_store(struct csv_store_handle *s_handle, ldms_set_t
 	FILE* fp;
 	store_csv_t sc = s_handle->sc;
 	char tmp_path[PATH_MAX];
+	char *hbuf = NULL;
+	size_t hlen = 0;
+	int rc;
 
 	if (s_handle == NULL){
 		ovis_log(mylog, OVIS_LERROR, "Null store handle. Cannot print header\n");
@@ -942,11 +1734,9 @@ static int print_header_from_store(struct csv_store_handle *s_handle, ldms_set_t
 	}
 	s_handle->printheader = DONT_PRINT_HEADER;
 
-	fp = s_handle->headerfile;
-	if (!fp){
-		ovis_log(mylog, OVIS_LERROR, "Cannot print header. No headerfile\n");
+	fp = header_stream_open(s_handle, &hbuf, &hlen);
+	if (!fp)
 		return EINVAL;
-	}
 	int ec;
 	if (s_handle->altheader) {
 		if (sc->rolltype >= MINROLLTYPE)
@@ -966,14 +1756,9 @@ static int print_header_from_store(struct csv_store_handle *s_handle, ldms_set_t
 	csv_format_header_common(fp, tmp_path, CCSHC(s_handle), s_handle->udata,
                                  &PG, set, metric_array, metric_count,
                                  s_handle->time_format);
-
-	/* Flush for the header, whether or not it is the data file as well */
-	fflush(fp);
-	fsync(fileno(fp));
-
-	if (s_handle->headerfile && s_handle->altheader)
-		fclose(s_handle->headerfile);
-	s_handle->headerfile = 0;
+	rc = header_stream_close(s_handle, fp, &hbuf, &hlen);
+	if (rc)
+		return rc;
 	fp = NULL;
 
 	/* dump data types header, or whine and continue to other headers. */
@@ -1026,422 +1811,107 @@ open_store(ldmsd_plug_handle_t handle, const char *container, const char* schema
 static inline void __print_check(struct csv_store_handle *sh, int rc)
 {
 	if (rc < 0) {
-		ovis_log(mylog, OVIS_LERROR, "Error %d writing to '%s'\n",
-		       rc, sh->path);
+		ovis_log(mylog, OVIS_LERROR, "Error %d formatting for '%s'\n",
+		       -rc, sh->path);
 	} else {
 		sh->byte_count += rc;
 	}
 }
 
+/* Format element i of a scalar (i == 0) or array value. */
+static int store_elem(struct csv_wbuf *wb, enum ldms_value_type mtype,
+		      ldms_mval_t mval, int i)
+{
+	switch (mtype) {
+	case LDMS_V_CHAR:
+		return wb_putc(wb, mval->v_char);
+	case LDMS_V_U8:
+	case LDMS_V_U8_ARRAY:
+		return wb_u64(wb, mval->a_u8[i]);
+	case LDMS_V_S8:
+	case LDMS_V_S8_ARRAY:
+		return wb_s64(wb, mval->a_s8[i]);
+	case LDMS_V_U16:
+	case LDMS_V_U16_ARRAY:
+		return wb_u64(wb, mval->a_u16[i]);
+	case LDMS_V_S16:
+	case LDMS_V_S16_ARRAY:
+		return wb_s64(wb, mval->a_s16[i]);
+	case LDMS_V_U32:
+	case LDMS_V_U32_ARRAY:
+		return wb_u64(wb, mval->a_u32[i]);
+	case LDMS_V_S32:
+	case LDMS_V_S32_ARRAY:
+		return wb_s64(wb, mval->a_s32[i]);
+	case LDMS_V_U64:
+	case LDMS_V_U64_ARRAY:
+		return wb_u64(wb, mval->a_u64[i]);
+	case LDMS_V_S64:
+	case LDMS_V_S64_ARRAY:
+		return wb_s64(wb, mval->a_s64[i]);
+	case LDMS_V_F32:
+	case LDMS_V_F32_ARRAY:
+		return wb_printf(wb, "%.9g", mval->a_f[i]);
+	case LDMS_V_D64:
+	case LDMS_V_D64_ARRAY:
+		return wb_printf(wb, "%.17g", mval->a_d[i]);
+	default:
+		return 0;
+	}
+}
+
+static inline void
+store_udata(struct csv_store_handle *sh, uint64_t udata)
+{
+	if (sh->udata) {
+		__print_check(sh, wb_putc(sh->wb, ','));
+		__print_check(sh, wb_u64(sh->wb, udata));
+	}
+}
+
+/* caller MUST hold sh->lock and have sh->wb */
 static void
 store_metric(struct csv_store_handle *sh, const char *wsqt, uint64_t udata,
 		enum ldms_value_type mtype, size_t count, ldms_mval_t mval)
 {
-	int rc, i;
+	struct csv_wbuf *wb = sh->wb;
+	char lquote, sep, rquote;
+	int i;
 	ldms_mval_t v;
 	switch (mtype) {
 	case LDMS_V_CHAR_ARRAY:
-		if (sh->udata) {
-			rc = fprintf(sh->file, ",%"PRIu64, udata);
-			__print_check(sh, rc);
-		}
+		store_udata(sh, udata);
 		/* our csv does not included embedded nuls */
-		rc = fprintf(sh->file, ",%s%s%s", wsqt, mval->a_char, wsqt);
-		__print_check(sh, rc);
-		break;
+		__print_check(sh, wb_putc(wb, ','));
+		__print_check(sh, wb_puts(wb, wsqt));
+		__print_check(sh, wb_puts(wb, mval->a_char));
+		__print_check(sh, wb_puts(wb, wsqt));
+		return;
 	case LDMS_V_CHAR:
-		if (sh->udata) {
-			rc = fprintf(sh->file, ",%"PRIu64, udata);
-			__print_check(sh, rc);
-		}
-		rc = fprintf(sh->file, ",%c", mval->v_char);
-		__print_check(sh, rc);
-		break;
-	case LDMS_V_U8_ARRAY:
-		if (sh->expand_array) {
-			for (i = 0; i < count; i++){
-				if (sh->udata) {
-					rc = fprintf(sh->file, ",%"PRIu64, udata);
-					__print_check(sh, rc);
-				}
-				rc = fprintf(sh->file, ",%hhu", mval->a_u8[i]);
-				__print_check(sh, rc);
-			}
-		} else {
-			if (sh->udata) {
-				rc = fprintf(sh->file, ",%"PRIu64, udata);
-				__print_check(sh, rc);
-			}
-			for (i = 0; i < count; i++) {
-				if (i == 0) {
-					rc = fprintf(sh->file, ",%c%hhu",
-							sh->array_lquote,
-							mval->a_u8[i]);
-				} else {
-					rc = fprintf(sh->file, "%c%hhu",
-							sh->array_sep,
-							mval->a_u8[i]);
-				}
-				__print_check(sh, rc);
-			}
-			rc = fprintf(sh->file, "%c", sh->array_rquote);
-			__print_check(sh, rc);
-		}
-		break;
 	case LDMS_V_U8:
-		if (sh->udata) {
-			rc = fprintf(sh->file, ",%"PRIu64, udata);
-			__print_check(sh, rc);
-		}
-		rc = fprintf(sh->file, ",%hhu", mval->v_u8);
-		__print_check(sh, rc);
-		break;
-	case LDMS_V_S8_ARRAY:
-		if (sh->expand_array) {
-			for (i = 0; i < count; i++) {
-				if (sh->udata) {
-					rc = fprintf(sh->file, ",%"PRIu64, udata);
-					__print_check(sh, rc);
-				}
-				rc = fprintf(sh->file, ",%hhd", mval->a_s8[i]);
-				__print_check(sh, rc);
-			}
-		} else {
-			if (sh->udata) {
-				rc = fprintf(sh->file, ",%"PRIu64, udata);
-				__print_check(sh, rc);
-			}
-			for (i = 0; i < count; i++) {
-				if (i == 0) {
-					rc = fprintf(sh->file, ",%c%hhd",
-							sh->array_lquote,
-							mval->a_s8[i]);
-				} else {
-					rc = fprintf(sh->file, "%c%hhd",
-							sh->array_sep,
-							mval->a_s8[i]);
-				}
-				__print_check(sh, rc);
-			}
-			rc = fprintf(sh->file, "%c", sh->array_rquote);
-			__print_check(sh, rc);
-		}
-		break;
 	case LDMS_V_S8:
-		if (sh->udata) {
-			rc = fprintf(sh->file, ",%"PRIu64, udata);
-			__print_check(sh, rc);
-		}
-		rc = fprintf(sh->file, ",%hhd", mval->v_s8);
-		__print_check(sh, rc);
-		break;
-	case LDMS_V_U16_ARRAY:
-		if (sh->expand_array) {
-			for (i = 0; i < count; i++) {
-				if (sh->udata) {
-					rc = fprintf(sh->file, ",%"PRIu64, udata);
-					__print_check(sh, rc);
-				}
-				rc = fprintf(sh->file, ",%hu", mval->a_u16[i]);
-				__print_check(sh, rc);
-			}
-		} else {
-			if (sh->udata) {
-				rc = fprintf(sh->file, ",%"PRIu64, udata);
-				__print_check(sh, rc);
-			}
-			for (i = 0; i < count; i++) {
-				if (i == 0) {
-					rc = fprintf(sh->file, ",%c%hu",
-							sh->array_lquote,
-							mval->a_u16[i]);
-				} else {
-					rc = fprintf(sh->file, "%c%hu",
-							sh->array_sep,
-							mval->a_u16[i]);
-				}
-				__print_check(sh, rc);
-			}
-			rc = fprintf(sh->file, "%c", sh->array_rquote);
-			__print_check(sh, rc);
-		}
-		break;
 	case LDMS_V_U16:
-		if (sh->udata) {
-			rc = fprintf(sh->file, ",%"PRIu64, udata);
-			__print_check(sh, rc);
-		}
-		rc = fprintf(sh->file, ",%hu", mval->v_u16);
-		__print_check(sh, rc);
-		break;
-	case LDMS_V_S16_ARRAY:
-		if (sh->expand_array) {
-			for (i = 0; i < count; i++) {
-				if (sh->udata) {
-					rc = fprintf(sh->file, ",%"PRIu64, udata);
-					__print_check(sh, rc);
-				}
-				rc = fprintf(sh->file, ",%hd", mval->a_s16[i]);
-				__print_check(sh, rc);
-			}
-		} else {
-			if (sh->udata) {
-				rc = fprintf(sh->file, ",%"PRIu64, udata);
-				__print_check(sh, rc);
-			}
-			for (i = 0; i < count; i++) {
-				if (i == 0) {
-					rc = fprintf(sh->file, ",%c%hd",
-							sh->array_lquote,
-							mval->a_s16[i]);
-				} else {
-					rc = fprintf(sh->file, "%c%hd",
-							sh->array_sep,
-							mval->a_s16[i]);
-				}
-				__print_check(sh, rc);
-			}
-			rc = fprintf(sh->file, "%c", sh->array_rquote);
-			__print_check(sh, rc);
-		}
-		break;
 	case LDMS_V_S16:
-		if (sh->udata) {
-			rc = fprintf(sh->file, ",%"PRIu64, udata);
-			__print_check(sh, rc);
-		}
-		rc = fprintf(sh->file, ",%hd", mval->v_s16);
-		__print_check(sh, rc);
-		break;
-	case LDMS_V_U32_ARRAY:
-		if (sh->expand_array) {
-			for (i = 0; i < count; i++) {
-				if (sh->udata) {
-					rc = fprintf(sh->file, ",%"PRIu64, udata);
-					__print_check(sh, rc);
-				}
-				rc = fprintf(sh->file, ",%" PRIu32, mval->a_u32[i]);
-				__print_check(sh, rc);
-			}
-		} else {
-			if (sh->udata) {
-				rc = fprintf(sh->file, ",%"PRIu64, udata);
-				__print_check(sh, rc);
-			}
-			for (i = 0; i < count; i++) {
-				if (i == 0) {
-					rc = fprintf(sh->file, ",%c%" PRIu32,
-							sh->array_lquote,
-							mval->a_u32[i]);
-				} else {
-					rc = fprintf(sh->file, "%c%" PRIu32,
-							sh->array_sep,
-							mval->a_u32[i]);
-				}
-				__print_check(sh, rc);
-			}
-			rc = fprintf(sh->file, "%c", sh->array_rquote);
-			__print_check(sh, rc);
-		}
-		break;
 	case LDMS_V_U32:
-		if (sh->udata) {
-			rc = fprintf(sh->file, ",%"PRIu64, udata);
-			__print_check(sh, rc);
-		}
-		rc = fprintf(sh->file, ",%" PRIu32, mval->v_u32);
-		__print_check(sh, rc);
-		break;
-	case LDMS_V_S32_ARRAY:
-		if (sh->expand_array) {
-			for (i = 0; i < count; i++) {
-				if (sh->udata) {
-					rc = fprintf(sh->file, ",%"PRIu64, udata);
-					__print_check(sh, rc);
-				}
-				rc = fprintf(sh->file, ",%" PRId32, mval->a_s32[i]);
-				__print_check(sh, rc);
-			}
-		} else {
-			if (sh->udata) {
-				rc = fprintf(sh->file, ",%"PRIu64, udata);
-				__print_check(sh, rc);
-			}
-			for (i = 0; i < count; i++) {
-				if (i == 0) {
-					rc = fprintf(sh->file, ",%c%" PRId32,
-							sh->array_lquote,
-							mval->a_s32[i]);
-				} else {
-					rc = fprintf(sh->file, "%c%" PRId32,
-							sh->array_sep,
-							mval->a_s32[i]);
-				}
-				__print_check(sh, rc);
-			}
-			rc = fprintf(sh->file, "%c", sh->array_rquote);
-			__print_check(sh, rc);
-		}
-		break;
 	case LDMS_V_S32:
-		if (sh->udata) {
-			rc = fprintf(sh->file, ",%"PRIu64, udata);
-			__print_check(sh, rc);
-		}
-		rc = fprintf(sh->file, ",%" PRId32, mval->v_s32);
-		__print_check(sh, rc);
-		break;
-	case LDMS_V_U64_ARRAY:
-		if (sh->expand_array) {
-			for (i = 0; i < count; i++) {
-				if (sh->udata) {
-					rc = fprintf(sh->file, ",%"PRIu64, udata);
-					__print_check(sh, rc);
-				}
-				rc = fprintf(sh->file, ",%" PRIu64, mval->a_u64[i]);
-				__print_check(sh, rc);
-			}
-		} else {
-			if (sh->udata) {
-				rc = fprintf(sh->file, ",%"PRIu64, udata);
-				__print_check(sh, rc);
-			}
-			for (i = 0; i < count; i++) {
-				if (i == 0) {
-					rc = fprintf(sh->file, ",%c%" PRIu64,
-							sh->array_lquote,
-							mval->a_u64[i]);
-				} else {
-					rc = fprintf(sh->file, "%c%" PRIu64,
-							sh->array_sep,
-							mval->a_u64[i]);
-				}
-				__print_check(sh, rc);
-			}
-			rc = fprintf(sh->file, "%c", sh->array_rquote);
-			__print_check(sh, rc);
-		}
-		break;
 	case LDMS_V_U64:
-		if (sh->udata) {
-			rc = fprintf(sh->file, ",%"PRIu64, udata);
-			__print_check(sh, rc);
-		}
-		rc = fprintf(sh->file, ",%"PRIu64, mval->v_u64);
-		__print_check(sh, rc);
-		break;
-	case LDMS_V_S64_ARRAY:
-		if (sh->expand_array) {
-			for (i = 0; i < count; i++) {
-				if (sh->udata) {
-					rc = fprintf(sh->file, ",%"PRIu64, udata);
-					__print_check(sh, rc);
-				}
-				rc = fprintf(sh->file, ",%" PRId64, mval->a_s64[i]);
-				__print_check(sh, rc);
-			}
-		} else {
-			if (sh->udata) {
-				rc = fprintf(sh->file, ",%"PRIu64, udata);
-				__print_check(sh, rc);
-			}
-			for (i = 0; i < count; i++) {
-				if (i == 0) {
-					rc = fprintf(sh->file, ",\"%" PRId64, mval->a_s64[i]);
-				} else {
-					rc = fprintf(sh->file, ",%" PRId64, mval->a_s64[i]);
-				}
-				__print_check(sh, rc);
-			}
-			rc = fprintf(sh->file, "\"");
-			__print_check(sh, rc);
-		}
-		break;
 	case LDMS_V_S64:
-		if (sh->udata) {
-			rc = fprintf(sh->file, ",%"PRIu64, udata);
-			__print_check(sh, rc);
-		}
-		rc = fprintf(sh->file, ",%" PRId64, mval->v_s64);
-		__print_check(sh, rc);
-		break;
-	case LDMS_V_F32_ARRAY:
-		if (sh->expand_array) {
-			for (i = 0; i < count; i++) {
-				if (sh->udata) {
-					rc = fprintf(sh->file, ",%"PRIu64, udata);
-					__print_check(sh, rc);
-				}
-				rc = fprintf(sh->file, ",%.9g", mval->a_f[i]);
-				__print_check(sh, rc);
-			}
-		} else {
-			if (sh->udata) {
-				rc = fprintf(sh->file, ",%"PRIu64, udata);
-				__print_check(sh, rc);
-			}
-			for (i = 0; i < count; i++) {
-				if (i == 0) {
-					rc = fprintf(sh->file, ",%c%.9g",
-							sh->array_lquote,
-							mval->a_f[i]);
-				} else {
-					rc = fprintf(sh->file, "%c%.9g",
-							sh->array_sep,
-							mval->a_f[i]);
-				}
-				__print_check(sh, rc);
-			}
-			rc = fprintf(sh->file, "%c", sh->array_rquote);
-			__print_check(sh, rc);
-		}
-		break;
 	case LDMS_V_F32:
-		if (sh->udata) {
-			rc = fprintf(sh->file, ",%"PRIu64, udata);
-			__print_check(sh, rc);
-		}
-		rc = fprintf(sh->file, ",%.9g", mval->v_f);
-		__print_check(sh, rc);
-		break;
-	case LDMS_V_D64_ARRAY:
-		if (sh->expand_array) {
-			for (i = 0; i < count; i++) {
-				if (sh->udata) {
-					rc = fprintf(sh->file, ",%"PRIu64, udata);
-					__print_check(sh, rc);
-				}
-				rc = fprintf(sh->file, ",%.17g", mval->a_d[i]);
-				__print_check(sh, rc);
-			}
-		} else {
-			if (sh->udata) {
-				rc = fprintf(sh->file, ",%"PRIu64, udata);
-				__print_check(sh, rc);
-			}
-			for (i = 0; i < count; i++) {
-				if (i == 0) {
-					rc = fprintf(sh->file, ",%c%.17g",
-							sh->array_lquote,
-							mval->a_d[i]);
-				} else {
-					rc = fprintf(sh->file, "%c%.17g",
-							sh->array_sep,
-							mval->a_d[i]);
-				}
-				__print_check(sh, rc);
-			}
-			rc = fprintf(sh->file, "%c", sh->array_rquote);
-			__print_check(sh, rc);
-		}
-		break;
 	case LDMS_V_D64:
-		if (sh->udata) {
-			rc = fprintf(sh->file, ",%"PRIu64, udata);
-			__print_check(sh, rc);
-		}
-		rc = fprintf(sh->file, ",%.17g", mval->v_d);
-		__print_check(sh, rc);
+		store_udata(sh, udata);
+		__print_check(sh, wb_putc(wb, ','));
+		__print_check(sh, store_elem(wb, mtype, mval, 0));
+		return;
+	case LDMS_V_U8_ARRAY:
+	case LDMS_V_S8_ARRAY:
+	case LDMS_V_U16_ARRAY:
+	case LDMS_V_S16_ARRAY:
+	case LDMS_V_U32_ARRAY:
+	case LDMS_V_S32_ARRAY:
+	case LDMS_V_U64_ARRAY:
+	case LDMS_V_S64_ARRAY:
+	case LDMS_V_F32_ARRAY:
+	case LDMS_V_D64_ARRAY:
 		break;
 	case LDMS_V_RECORD_INST:
 		for (i = 0; i < ldms_record_card(mval); i++) {
@@ -1449,44 +1919,73 @@ store_metric(struct csv_store_handle *sh, const char *wsqt, uint64_t udata,
 			v = ldms_record_metric_get(mval, i);
 			store_metric(sh, wsqt, udata, mtype, count, v);
 		}
-		break;
+		return;
 	default:
 		ovis_log(mylog, OVIS_LERROR, "Received unrecognized metric value type %d\n", mtype);
 		/* print no value */
-		if (sh->udata) {
-			rc = fprintf(sh->file, ",");
-			__print_check(sh, rc);
+		if (sh->udata)
+			__print_check(sh, wb_putc(wb, ','));
+		__print_check(sh, wb_putc(wb, ','));
+		return;
+	}
+
+	/* numeric arrays */
+	if (sh->expand_array) {
+		for (i = 0; i < count; i++) {
+			store_udata(sh, udata);
+			__print_check(sh, wb_putc(wb, ','));
+			__print_check(sh, store_elem(wb, mtype, mval, i));
 		}
-		rc = fprintf(sh->file, ",");
-		__print_check(sh, rc);
-		break;
+		return;
+	}
+	if (mtype == LDMS_V_S64_ARRAY) {
+		/* s64 arrays have always been written as "v,v,..." */
+		lquote = '"';
+		sep = ',';
+		rquote = '"';
+	} else {
+		lquote = sh->array_lquote;
+		sep = sh->array_sep;
+		rquote = sh->array_rquote;
+	}
+	store_udata(sh, udata);
+	for (i = 0; i < count; i++) {
+		if (i == 0) {
+			__print_check(sh, wb_putc(wb, ','));
+			__print_check(sh, wb_putc(wb, lquote));
+		} else {
+			__print_check(sh, wb_putc(wb, sep));
+		}
+		__print_check(sh, store_elem(wb, mtype, mval, i));
 	}
+	__print_check(sh, wb_putc(wb, rquote));
 }
 
 static void
 store_time_job_app(struct csv_store_handle *sh, const struct ldms_timestamp *ts, ldms_set_t set)
 {
+	struct csv_wbuf *wb = sh->wb;
 	const char *pname;
 	/* Print timestamp fields */
 	if (sh->time_format == TF_MILLISEC) {
 		/* Alternate time format. First field is milliseconds-since-epoch,
 		   and the second field is the left-over microseconds */
-		fprintf(sh->file, "%"PRIu64",%"PRIu32,
-			((uint64_t)ts->sec * 1000) + (ts->usec / 1000),
-			ts->usec % 1000);
+		__print_check(sh, wb_u64(wb, ((uint64_t)ts->sec * 1000) + (ts->usec / 1000)));
+		__print_check(sh, wb_putc(wb, ','));
+		__print_check(sh, wb_u64(wb, ts->usec % 1000));
 	} else {
 		/* Traditional time format, where the first field is
 		   <seconds>.<microseconds>, second is microseconds repeated */
-		fprintf(sh->file, "%"PRIu32".%06"PRIu32 ",%"PRIu32,
-			ts->sec, ts->usec, ts->usec);
+		__print_check(sh, wb_u64(wb, ts->sec));
+		__print_check(sh, wb_putc(wb, '.'));
+		__print_check(sh, wb_u64_pad(wb, ts->usec, 6));
+		__print_check(sh, wb_putc(wb, ','));
+		__print_check(sh, wb_u64(wb, ts->usec));
 	}
+	__print_check(sh, wb_putc(wb, ','));
 	pname = ldms_set_producer_name_get(set);
-	if (pname != NULL){
-		fprintf(sh->file, ",%s", pname);
-		sh->byte_count += strlen(pname);
-	} else {
-		fprintf(sh->file, ",");
-	}
+	if (pname != NULL)
+		__print_check(sh, wb_puts(wb, pname));
 }
 
 static int store(ldmsd_plug_handle_t handle, ldmsd_store_handle_t _s_handle, ldms_set_t set, int *metric_array, size_t metric_count)
@@ -1496,7 +1995,6 @@ static int store(ldmsd_plug_handle_t handle, ldmsd_store_handle_t _s_handle, ldm
 	uint64_t udata;
 	struct csv_store_handle *s_handle;
 	int i;
-	int doflush = 0;
 	int rc;
 	ldms_mval_t mval;
 	enum ldms_value_type metric_type;
@@ -1548,7 +2046,7 @@ static int store(ldmsd_plug_handle_t handle, ldmsd_store_handle_t _s_handle, ldm
 	}
 
 	pthread_mutex_lock(&s_handle->lock);
-	if (!s_handle->file){
+	if (!s_handle->os){
 		ovis_log(mylog, OVIS_LERROR, "Cannot insert values for <%s>: file is NULL\n",
 		       s_handle->path);
 		pthread_mutex_unlock(&s_handle->lock);
@@ -1581,6 +2079,11 @@ static int store(ldmsd_plug_handle_t handle, ldmsd_store_handle_t _s_handle, ldm
 		break;
 	}
 
+	if (!csv_store_handle_wbuf(s_handle)) {
+		pthread_mutex_unlock(&s_handle->lock);
+		return ENOMEM;
+	}
+
 	/* FIXME: will we want to throw an error if we cannot write? */
 	char *wsqt = ""; /* ietf quotation wrapping strings */
 	if (s_handle->ietfcsv) {
@@ -1653,26 +2156,12 @@ static int store(ldmsd_plug_handle_t handle, ldmsd_store_handle_t _s_handle, ldm
 					     metric_type, count, mval);
 			}
 		}
-		fprintf(s_handle->file,"\n");
+		__print_check(s_handle, wb_putc(s_handle->wb, '\n'));
 	} while (done < s_handle->num_lists);
 
 	s_handle->store_count++;
 
-	if ((s_handle->buffer_type == 3) &&
-	    ((s_handle->store_count - s_handle->lastflush) >=
-	     s_handle->buffer_sz)){
-		s_handle->lastflush = s_handle->store_count;
-		doflush = 1;
-	} else if ((s_handle->buffer_type == 4) &&
-		 ((s_handle->byte_count - s_handle->lastflush) >=
-		  s_handle->buffer_sz)){
-		s_handle->lastflush = s_handle->byte_count;
-		doflush = 1;
-	}
-	if ((s_handle->buffer_sz == 0) || doflush){
-		fflush(s_handle->file);
-		fsync(fileno(s_handle->file));
-	}
+	csv_store_handle_flush_check(s_handle);
 	pthread_mutex_unlock(&s_handle->lock);
 
 	return 0;
@@ -1685,8 +2174,19 @@ static int flush_store(ldmsd_plug_handle_t handle, ldmsd_store_handle_t _s_handl
 		ovis_log(mylog, OVIS_LERROR, "flush error.\n");
 		return -1;
 	}
+	if (s_handle->type == CSV_ROW_STORE_HANDLE) {
+		struct csv_row_store_handle *rs_handle = (void *)s_handle;
+		struct rbn *rbn;
+		RBT_FOREACH(rbn, &rs_handle->row_schema_rbt) {
+			s_handle = ((struct csv_row_schema_rbn_s *)rbn)->s_handle;
+			pthread_mutex_lock(&s_handle->lock);
+			csv_wbuf_submit(s_handle, CSV_WREQ_F_FLUSH);
+			pthread_mutex_unlock(&s_handle->lock);
+		}
+		return 0;
+	}
 	pthread_mutex_lock(&s_handle->lock);
-	fflush(s_handle->file);
+	csv_wbuf_submit(s_handle, CSV_WREQ_F_FLUSH);
 	pthread_mutex_unlock(&s_handle->lock);
 	return 0;
 }
@@ -1697,14 +2197,18 @@ static void __csv_handle_close(struct csv_store_handle *s_handle)
 	pthread_mutex_lock(&s_handle->lock);
 	ovis_log(mylog, OVIS_LDEBUG, "Closing with path <%s>\n",
 	       s_handle->path);
-	fflush(s_handle->file);
+	if (s_handle->os)
+		csv_wbuf_submit(s_handle, CSV_WREQ_F_CLOSE | CSV_WREQ_F_WAIT);
+	s_handle->os = NULL;
+	if (s_handle->wb) {
+		free(s_handle->wb->data);
+		free(s_handle->wb);
+		s_handle->wb = NULL;
+	}
 	if (s_handle->path)
 		free(s_handle->path);
 	s_handle->path = NULL;
-	if (s_handle->file)
-		fclose(s_handle->file);
-	s_handle->file = NULL;
-	if (s_handle->headerfile && s_handle->altheader)
+	if (s_handle->headerfile)
 		fclose(s_handle->headerfile);
 	s_handle->headerfile = NULL;
 	CLOSE_STORE_COMMON(s_handle);
@@ -1860,9 +2364,11 @@ csv_store_handle_get(store_csv_t sc, const char *container, const char *schema)
 	/* csv filename */
 	if (sc->rolltype >= MINROLLTYPE){
 		//append the files with epoch. assume wont collide to the sec.
-		len = asprintf(&s_handle->filename, "%s.%ld", s_handle->path, appx);
+		len = asprintf(&s_handle->filename, "%s.%ld%s", s_handle->path, appx,
+			       csv_compress_suffix(s_handle->compress));
 	} else {
-		len = asprintf(&s_handle->filename, "%s", s_handle->path);
+		len = asprintf(&s_handle->filename, "%s%s", s_handle->path,
+			       csv_compress_suffix(s_handle->compress));
 	}
 	if (len < 0) {
 		ERR_LOG("Not enough memory (%s:%s():%d)", __FILE__, __func__, __LINE__);
@@ -1870,13 +2376,12 @@ csv_store_handle_get(store_csv_t sc, const char *container, const char *schema)
 	}
 
 	/* the CSV FILE */
-	s_handle->file = fopen_perm(s_handle->filename, "a+", LDMSD_DEFAULT_FILE_PERM);
+	s_handle->os = csv_ostream_open(s_handle, s_handle->filename);
 	s_handle->otime = appx;
-	if (!s_handle->file) {
+	if (!s_handle->os) {
 		ERR_LOG("Error %d opening the file %s.\n", errno, s_handle->path);
 		goto err_6;
 	}
-	ch_output(s_handle->file, s_handle->filename, CSHC(s_handle), &PG);
 
 	/* header file name */
 	if (s_handle->altheader) {
@@ -1909,8 +2414,6 @@ csv_store_handle_get(store_csv_t sc, const char *container, const char *schema)
 			goto err_8;
 		}
 		ch_output(s_handle->headerfile, s_handle->headerfilename, CSHC(s_handle), &PG);
-	} else {
-		s_handle->headerfile = s_handle->file;
 	}
 
 	if (s_handle->typeheader > 0) {
@@ -1938,7 +2441,7 @@ csv_store_handle_get(store_csv_t sc, const char *container, const char *schema)
  err_8:
 	free(s_handle->headerfilename);
  err_7:
-	fclose(s_handle->file);
+	csv_ostream_free(s_handle->os);
  err_6:
 	free(s_handle->filename);
  err_5:
@@ -1993,6 +2496,7 @@ csv_row_schema_get(ldmsd_strgp_t strgp, struct csv_row_store_handle *rs_handle,
 
 typedef struct csv_store_col_info_s {
 	struct csv_store_handle *s_handle;
+	struct csv_wbuf *wb;
 	ldms_mval_t v;
 	const char *ustr;
 	const char *sep;
@@ -2002,133 +2506,167 @@ typedef struct csv_store_col_info_s {
 
 typedef int (*csv_store_col_fn)(csv_store_col_info_t ci);
 
+static inline int store_col_pfx(csv_store_col_info_t ci)
+{
+	int len = wb_puts(ci->wb, ci->ustr);
+	return __wb_sum(len, wb_puts(ci->wb, ci->sep));
+}
+
 static int store_col_char(csv_store_col_info_t ci)
 {
-	return fprintf(ci->s_handle->file, "%s%s%c", ci->ustr, ci->sep, ci->v->v_char);
+	int len = store_col_pfx(ci);
+	return __wb_sum(len, wb_putc(ci->wb, ci->v->v_char));
 }
 
 static int store_col_u8(csv_store_col_info_t ci)
 {
-	return fprintf(ci->s_handle->file, "%s%s%hhu", ci->ustr, ci->sep, ci->v->v_u8);
+	int len = store_col_pfx(ci);
+	return __wb_sum(len, wb_u64(ci->wb, ci->v->v_u8));
 }
 
 static int store_col_s8(csv_store_col_info_t ci)
 {
-	return fprintf(ci->s_handle->file, "%s%s%hhd", ci->ustr, ci->sep, ci->v->v_s8);
+	int len = store_col_pfx(ci);
+	return __wb_sum(len, wb_s64(ci->wb, ci->v->v_s8));
 }
 
 static int store_col_u16(csv_store_col_info_t ci)
 {
-	return fprintf(ci->s_handle->file, "%s%s%hu", ci->ustr, ci->sep, ci->v->v_u16);
+	int len = store_col_pfx(ci);
+	return __wb_sum(len, wb_u64(ci->wb, ci->v->v_u16));
 }
 
 static int store_col_s16(csv_store_col_info_t ci)
 {
-	return fprintf(ci->s_handle->file, "%s%s%hd", ci->ustr, ci->sep, ci->v->v_s16);
+	int len = store_col_pfx(ci);
+	return __wb_sum(len, wb_s64(ci->wb, ci->v->v_s16));
 }
 
 static int store_col_u32(csv_store_col_info_t ci)
 {
-	return fprintf(ci->s_handle->file, "%s%s%u", ci->ustr, ci->sep, ci->v->v_u32);
+	int len = store_col_pfx(ci);
+	return __wb_sum(len, wb_u64(ci->wb, ci->v->v_u32));
 }
 
 static int store_col_s32(csv_store_col_info_t ci)
 {
-	return fprintf(ci->s_handle->file, "%s%s%d", ci->ustr, ci->sep, ci->v->v_s32);
+	int len = store_col_pfx(ci);
+	return __wb_sum(len, wb_s64(ci->wb, ci->v->v_s32));
 }
 
 static int store_col_u64(csv_store_col_info_t ci)
 {
-	return fprintf(ci->s_handle->file, "%s%s%lu", ci->ustr, ci->sep, ci->v->v_u64);
+	int len = store_col_pfx(ci);
+	return __wb_sum(len, wb_u64(ci->wb, ci->v->v_u64));
 }
 
 static int store_col_s64(csv_store_col_info_t ci)
 {
-	return fprintf(ci->s_handle->file, "%s%s%ld", ci->ustr, ci->sep, ci->v->v_s64);
+	int len = store_col_pfx(ci);
+	return __wb_sum(len, wb_s64(ci->wb, ci->v->v_s64));
 }
 
 static int store_col_f(csv_store_col_info_t ci)
 {
-	return fprintf(ci->s_handle->file, "%s%s%f", ci->ustr, ci->sep, ci->v->v_f);
+	int len = store_col_pfx(ci);
+	return __wb_sum(len, wb_printf(ci->wb, "%f", ci->v->v_f));
 }
 
 static int store_col_d(csv_store_col_info_t ci)
 {
-	return fprintf(ci->s_handle->file, "%s%s%f", ci->ustr, ci->sep, ci->v->v_d);
+	int len = store_col_pfx(ci);
+	return __wb_sum(len, wb_printf(ci->wb, "%f", ci->v->v_d));
 }
 
 static int store_col_ts(csv_store_col_info_t ci)
 {
+	struct csv_wbuf *wb = ci->wb;
+	int len = store_col_pfx(ci);
 	if (ci->s_handle->time_format == TF_MILLISEC) {
 		/* Alternate time format. First field is milliseconds-since-epoch,
 		   and the second field is the left-over microseconds */
-		return fprintf(ci->s_handle->file, "%s%s%lu,%u",
-				ci->ustr, ci->sep,
-				((uint64_t)ci->v->v_ts.sec * 1000) + (ci->v->v_ts.usec / 1000),
-				ci->v->v_ts.usec % 1000);
+		len = __wb_sum(len, wb_u64(wb, ((uint64_t)ci->v->v_ts.sec * 1000) +
+					   (ci->v->v_ts.usec / 1000)));
+		len = __wb_sum(len, wb_putc(wb, ','));
+		len = __wb_sum(len, wb_u64(wb, ci->v->v_ts.usec % 1000));
 	} else {
 		/* Traditional time format, where the first field is
 		   <seconds>.<microseconds>, second is microseconds repeated */
-		return fprintf(ci->s_handle->file, "%s%s%u.%06u,%u",
-				ci->ustr, ci->sep, ci->v->v_ts.sec,
-				ci->v->v_ts.usec, ci->v->v_ts.usec);
+		len = __wb_sum(len, wb_u64(wb, ci->v->v_ts.sec));
+		len = __wb_sum(len, wb_putc(wb, '.'));
+		len = __wb_sum(len, wb_u64_pad(wb, ci->v->v_ts.usec, 6));
+		len = __wb_sum(len, wb_putc(wb, ','));
+		len = __wb_sum(len, wb_u64(wb, ci->v->v_ts.usec));
 	}
+	return len;
 }
 
 static int store_col_char_array(csv_store_col_info_t ci)
 {
-	return fprintf(ci->s_handle->file, "%s%s%s%s%s",
-			ci->ustr, ci->sep, ci->wsqt, ci->v->a_char, ci->wsqt);
+	int len = store_col_pfx(ci);
+	len = __wb_sum(len, wb_puts(ci->wb, ci->wsqt));
+	len = __wb_sum(len, wb_puts(ci->wb, ci->v->a_char));
+	return __wb_sum(len, wb_puts(ci->wb, ci->wsqt));
 }
 
 static int store_col_u8_array(csv_store_col_info_t ci)
 {
-	return fprintf(ci->s_handle->file, "%s%s%hhu", ci->ustr, ci->sep, ci->v->a_u8[ci->i]);
+	int len = store_col_pfx(ci);
+	return __wb_sum(len, wb_u64(ci->wb, ci->v->a_u8[ci->i]));
 }
 
 static int store_col_s8_array(csv_store_col_info_t ci)
 {
-	return fprintf(ci->s_handle->file, "%s%s%hhd", ci->ustr, ci->sep, ci->v->a_s8[ci->i]);
+	int len = store_col_pfx(ci);
+	return __wb_sum(len, wb_s64(ci->wb, ci->v->a_s8[ci->i]));
 }
 
 static int store_col_u16_array(csv_store_col_info_t ci)
 {
-	return fprintf(ci->s_handle->file, "%s%s%hu", ci->ustr, ci->sep, ci->v->a_u16[ci->i]);
+	int len = store_col_pfx(ci);
+	return __wb_sum(len, wb_u64(ci->wb, ci->v->a_u16[ci->i]));
 }
 
 static int store_col_s16_array(csv_store_col_info_t ci)
 {
-	return fprintf(ci->s_handle->file, "%s%s%hd", ci->ustr, ci->sep, ci->v->a_s16[ci->i]);
+	int len = store_col_pfx(ci);
+	return __wb_sum(len, wb_s64(ci->wb, ci->v->a_s16[ci->i]));
 }
 
 static int store_col_u32_array(csv_store_col_info_t ci)
 {
-	return fprintf(ci->s_handle->file, "%s%s%u", ci->ustr, ci->sep, ci->v->a_u32[ci->i]);
+	int len = store_col_pfx(ci);
+	return __wb_sum(len, wb_u64(ci->wb, ci->v->a_u32[ci->i]));
 }
 
 static int store_col_s32_array(csv_store_col_info_t ci)
 {
-	return fprintf(ci->s_handle->file, "%s%s%d", ci->ustr, ci->sep, ci->v->a_s32[ci->i]);
+	int len = store_col_pfx(ci);
+	return __wb_sum(len, wb_s64(ci->wb, ci->v->a_s32[ci->i]));
 }
 
 static int store_col_u64_array(csv_store_col_info_t ci)
 {
-	return fprintf(ci->s_handle->file, "%s%s%lu", ci->ustr, ci->sep, ci->v->a_u64[ci->i]);
+	int len = store_col_pfx(ci);
+	return __wb_sum(len, wb_u64(ci->wb, ci->v->a_u64[ci->i]));
 }
 
 static int store_col_s64_array(csv_store_col_info_t ci)
 {
-	return fprintf(ci->s_handle->file, "%s%s%ld", ci->ustr, ci->sep, ci->v->a_s64[ci->i]);
+	int len = store_col_pfx(ci);
+	return __wb_sum(len, wb_s64(ci->wb, ci->v->a_s64[ci->i]));
 }
 
 static int store_col_f_array(csv_store_col_info_t ci)
 {
-	return fprintf(ci->s_handle->file, "%s%s%.9g", ci->ustr, ci->sep, ci->v->a_f[ci->i]);
+	int len = store_col_pfx(ci);
+	return __wb_sum(len, wb_printf(ci->wb, "%.9g", ci->v->a_f[ci->i]));
 }
 
 static int store_col_d_array(csv_store_col_info_t ci)
 {
-	return fprintf(ci->s_handle->file, "%s%s%.17g", ci->ustr, ci->sep, ci->v->a_d[ci->i]);
+	int len = store_col_pfx(ci);
+	return __wb_sum(len, wb_printf(ci->wb, "%.17g", ci->v->a_d[ci->i]));
 }
 
 csv_store_col_fn __store_col_fn_tbl[] = {
@@ -2189,6 +2727,7 @@ static int store_col(ldms_set_t set, struct csv_store_handle *s_handle,
 	ci.ustr = ustr;
 	ci.sep = sep;
 	ci.s_handle = s_handle;
+	ci.wb = s_handle->wb;
 	ci.v = col->mval;
 	ci.wsqt = s_handle->ietfcsv?"\"":""; /* ietf quotation wrapping strings */
 
@@ -2198,8 +2737,8 @@ static int store_col(ldms_set_t set, struct csv_store_handle *s_handle,
 			ci.i = i;
 			len = col_fn(&ci);
 			if (len < 0) {
-				rc = errno;
-				ERR_LOG("Error %d writing to '%s'\n", errno, s_handle->filename);
+				rc = -len;
+				ERR_LOG("Error %d formatting for '%s'\n", rc, s_handle->filename);
 			} else {
 				s_handle->byte_count += len;
 			}
@@ -2213,8 +2752,8 @@ static int store_col(ldms_set_t set, struct csv_store_handle *s_handle,
 		/* single value */
 		len = col_fn(&ci);
 		if (len < 0) {
-			rc = errno;
-			ERR_LOG("Error %d writing to '%s'\n", errno, s_handle->filename);
+			rc = -len;
+			ERR_LOG("Error %d formatting for '%s'\n", rc, s_handle->filename);
 		} else {
 			s_handle->byte_count += len;
 		}
@@ -2232,6 +2771,12 @@ store_row(ldmsd_strgp_t strgp, ldms_set_t set, struct csv_store_handle *s_handle
 	rc = 0;
 
 	pthread_mutex_lock(&s_handle->lock);
+	if (!s_handle->os) {
+		ovis_log(mylog, OVIS_LERROR, "Cannot insert values for <%s>: file is NULL\n",
+		       s_handle->path);
+		rc = EPERM;
+		goto out;
+	}
 
 	/* headers */
 	switch (s_handle->printheader){
@@ -2255,29 +2800,18 @@ store_row(ldmsd_strgp_t strgp, ldms_set_t set, struct csv_store_handle *s_handle
 		break;
 	}
 
+	if (!csv_store_handle_wbuf(s_handle)) {
+		rc = ENOMEM;
+		goto out;
+	}
 	for (i = 0; i < row->col_count; i++) {
 		col = &row->cols[i];
 		col_rc = store_col(set, s_handle, col, 0 == i);
 		if (col_rc)
 			rc = col_rc;
 	}
-	fprintf(s_handle->file, "\n");
-	int doflush = 0;
-	if ((s_handle->buffer_type == 3) &&
-	    ((s_handle->store_count - s_handle->lastflush) >=
-	     s_handle->buffer_sz)){
-		s_handle->lastflush = s_handle->store_count;
-		doflush = 1;
-	} else if ((s_handle->buffer_type == 4) &&
-		 ((s_handle->byte_count - s_handle->lastflush) >=
-		  s_handle->buffer_sz)){
-		s_handle->lastflush = s_handle->byte_count;
-		doflush = 1;
-	}
-	if ((s_handle->buffer_sz == 0) || doflush){
-		fflush(s_handle->file);
-		fsync(fileno(s_handle->file));
-	}
+	__print_check(s_handle, wb_putc(s_handle->wb, '\n'));
+	csv_store_handle_flush_check(s_handle);
  out:
 	pthread_mutex_unlock(&s_handle->lock);
 	return rc;
@@ -2338,6 +2872,10 @@ static int constructor(ldmsd_plug_handle_t handle)
                 return ENOMEM;
         }
 	mylog = ldmsd_plug_log_get(handle);
+	csv_writer_init(&sc->writer);
+	pthread_mutex_lock(&sc_list_lock);
+	LIST_INSERT_HEAD(&sc_list, sc, entry);
+	pthread_mutex_unlock(&sc_list_lock);
         ldmsd_plug_ctxt_set(handle, sc);
 
         return 0;
@@ -2359,6 +2897,12 @@ static void destructor(ldmsd_plug_handle_t handle)
 		sc->store_idx = NULL;
 	}
 	pthread_mutex_unlock(&sc->cfg_lock);
+	pthread_mutex_lock(&sc_list_lock);
+	LIST_REMOVE(sc, entry);
+	pthread_mutex_unlock(&sc_list_lock);
+	csv_writer_stop(&sc->writer);
+	pthread_cond_destroy(&sc->writer.cond);
+	pthread_mutex_destroy(&sc->writer.lock);
 
         free(sc);
 }
@@ -2383,8 +2927,38 @@ static void store_csv_init()
 	LIB_CTOR_COMMON(PG);
 }
 
+static void exit_flush_cb(void *obj, void *cb_arg)
+{
+	struct csv_store_handle *s_handle = obj;
+	if (pthread_mutex_trylock(&s_handle->lock))
+		return;
+	if (s_handle->os) {
+		/* finish compressed streams too */
+		csv_wbuf_submit(s_handle, CSV_WREQ_F_CLOSE);
+		s_handle->os = NULL;
+	}
+	pthread_mutex_unlock(&s_handle->lock);
+}
+
 static void __attribute__ ((destructor)) store_csv_fini(void);
 static void store_csv_fini()
 {
+	store_csv_t sc;
+
+	/*
+	 * Rows still buffered at exit would otherwise be lost. Locks held
+	 * by threads still running are skipped rather than waited on.
+	 */
+	if (0 == pthread_mutex_trylock(&sc_list_lock)) {
+		LIST_FOREACH(sc, &sc_list, entry) {
+			if (pthread_mutex_trylock(&sc->cfg_lock))
+				continue;
+			if (sc->store_idx)
+				idx_traverse(sc->store_idx, exit_flush_cb, NULL);
+			pthread_mutex_unlock(&sc->cfg_lock);
+			csv_writer_stop(&sc->writer);
+		}
+		pthread_mutex_unlock(&sc_list_lock);
+	}
 	LIB_DTOR_COMMON(PG);
 }
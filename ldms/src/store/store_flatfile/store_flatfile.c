@@ -46,16 +46,21 @@
  * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
+#define _GNU_SOURCE
 #include <ctype.h>
 #include <sys/queue.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <fcntl.h>
+#include <unistd.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <time.h>
+#include <limits.h>
 #include <linux/limits.h>
 #include <pthread.h>
 #include <errno.h>
@@ -68,6 +73,12 @@
 /*
  * NOTE:
  *   (flatfile::path) = (root_path)/(container)/(schema)/(metric)
+ *
+ *   store() formats the values into per-metric chunk lists. A writer
+ *   thread appends the pending chunks of each metric file with writev(),
+ *   every flush_interval or when buffer_size bytes are pending. The
+ *   metric files are opened on demand and kept in an LRU cache of at most
+ *   max_open file descriptors.
  */
 
 static ovis_log_t mylog;
@@ -81,37 +92,398 @@ static char *root_path; /**< store root path */
 #define _stringify(_x) #_x
 #define stringify(_x) _stringify(_x)
 
+#define FF_CHUNK_SIZE 8192
+#define FF_CHUNK_FREE_MAX 1024
+#define FF_WRITER_IOV 64
+#define FF_MAX_OPEN_DEFAULT 512
+#define FF_FLUSH_INTERVAL_DEFAULT 1000000 /* usec */
+#define FF_BUFFER_SIZE_DEFAULT (4 * 1024 * 1024)
+/* pending bytes of one file after which store() writes it out itself */
+#define FF_MS_PENDING_MAX (1024 * 1024)
+
+static int max_open = FF_MAX_OPEN_DEFAULT;
+static long flush_interval = FF_FLUSH_INTERVAL_DEFAULT;
+static int64_t buffer_size = FF_BUFFER_SIZE_DEFAULT;
+
+struct ff_chunk {
+	TAILQ_ENTRY(ff_chunk) entry;
+	size_t len;
+	size_t alloc;
+	char data[OVIS_FLEX];
+};
+TAILQ_HEAD(ff_chunk_list, ff_chunk);
+
 /**
  * \brief Store for individual metric.
  */
 struct flatfile_metric_store {
-	FILE *file; /**< File handle */
+	int fd; /**< File descriptor, -1 if not in the open-file cache */
 	pthread_mutex_t lock; /**< lock at metric store level */
 	char *path; /**< path of the flatfile store */
+	struct ff_chunk_list chunks; /**< Pending data, protected by lock */
+	size_t pending; /**< Bytes in chunks */
+	int dirty; /**< Queued for the writer since the last write */
+	int queued; /**< On writer.dirty_list, protected by writer.lock */
+	TAILQ_ENTRY(flatfile_metric_store) dirty_entry;
+	TAILQ_ENTRY(flatfile_metric_store) lru_entry; /**< protected by writer.io_lock */
 	LIST_ENTRY(flatfile_metric_store) entry; /**< Entry for free list. */
 };
 
 struct flatfile_store_instance {
 	char *path; /**< (root_path)/(container)/schema */
 	char *schema;
+	char *key; /**< (container):(schema) in store_idx */
 	idx_t ms_idx;
 	LIST_HEAD(ms_list, flatfile_metric_store) ms_list;
 	int metric_count;
 	struct flatfile_metric_store *ms[OVIS_FLEX];
 };
 
+/*
+ * Lock order: writer.io_lock -> ms->lock -> writer.lock
+ */
+static struct ff_writer {
+	pthread_t thread;
+	pthread_mutex_t lock; /**< dirty_list, pending, free_list, stop */
+	pthread_cond_t cond;
+	TAILQ_HEAD(, flatfile_metric_store) dirty_list;
+	int64_t pending; /**< Bytes buffered in all metric stores */
+	struct ff_chunk_list free_list;
+	int free_count;
+	int stop;
+	int started;
+	pthread_mutex_t io_lock; /**< File writes and the open-file cache */
+	TAILQ_HEAD(, flatfile_metric_store) lru; /**< Open files, LRU first */
+	int open_count;
+} writer;
+
 static pthread_mutex_t cfg_lock;
 
+static struct ff_chunk *ff_chunk_get(size_t sz)
+{
+	struct ff_chunk *c = NULL;
+	if (sz <= FF_CHUNK_SIZE) {
+		pthread_mutex_lock(&writer.lock);
+		c = TAILQ_FIRST(&writer.free_list);
+		if (c) {
+			TAILQ_REMOVE(&writer.free_list, c, entry);
+			writer.free_count--;
+		}
+		pthread_mutex_unlock(&writer.lock);
+		sz = FF_CHUNK_SIZE;
+	}
+	if (!c) {
+		c = malloc(sizeof(*c) + sz);
+		if (!c)
+			return NULL;
+		c->alloc = sz;
+	}
+	c->len = 0;
+	return c;
+}
+
+/* Recycle the chunks of \c list that held \c bytes pending bytes. */
+static void ff_chunks_put(struct ff_chunk_list *list, size_t bytes)
+{
+	struct ff_chunk *c;
+	pthread_mutex_lock(&writer.lock);
+	writer.pending -= bytes;
+	while ((c = TAILQ_FIRST(list))) {
+		TAILQ_REMOVE(list, c, entry);
+		if (c->alloc == FF_CHUNK_SIZE && writer.free_count < FF_CHUNK_FREE_MAX) {
+			TAILQ_INSERT_HEAD(&writer.free_list, c, entry);
+			writer.free_count++;
+		} else {
+			free(c);
+		}
+	}
+	pthread_mutex_unlock(&writer.lock);
+}
+
+/* caller MUST hold ms->lock */
+static int ms_printf(struct flatfile_metric_store *ms, const char *fmt, ...)
+{
+	struct ff_chunk *c = TAILQ_LAST(&ms->chunks, ff_chunk_list);
+	size_t room = c ? c->alloc - c->len : 0;
+	va_list ap;
+	int n;
+
+	va_start(ap, fmt);
+	n = vsnprintf(c ? c->data + c->len : NULL, room, fmt, ap);
+	va_end(ap);
+	if (n < 0)
+		return n;
+	if ((size_t)n >= room) {
+		c = ff_chunk_get(n + 1);
+		if (!c) {
+			errno = ENOMEM;
+			return -1;
+		}
+		TAILQ_INSERT_TAIL(&ms->chunks, c, entry);
+		va_start(ap, fmt);
+		n = vsnprintf(c->data, c->alloc, fmt, ap);
+		va_end(ap);
+	}
+	c->len += n;
+	ms->pending += n;
+	return n;
+}
+
+/* Put \c ms on the writer dirty list if it is not there already. */
+static void ms_queue(struct flatfile_metric_store *ms)
+{
+	pthread_mutex_lock(&writer.lock);
+	if (!ms->queued) {
+		ms->queued = 1;
+		TAILQ_INSERT_TAIL(&writer.dirty_list, ms, dirty_entry);
+	}
+	pthread_mutex_unlock(&writer.lock);
+}
+
+/* caller MUST hold writer.io_lock */
+static void ms_fd_close(struct flatfile_metric_store *ms)
+{
+	if (ms->fd < 0)
+		return;
+	close(ms->fd);
+	ms->fd = -1;
+	TAILQ_REMOVE(&writer.lru, ms, lru_entry);
+	writer.open_count--;
+}
+
+/* caller MUST hold writer.io_lock */
+static int ms_fd_get(struct flatfile_metric_store *ms)
+{
+	struct flatfile_metric_store *old;
+
+	if (ms->fd >= 0) {
+		TAILQ_REMOVE(&writer.lru, ms, lru_entry);
+		TAILQ_INSERT_TAIL(&writer.lru, ms, lru_entry);
+		return ms->fd;
+	}
+	while (writer.open_count >= max_open &&
+	       (old = TAILQ_FIRST(&writer.lru)))
+		ms_fd_close(old);
+	ms->fd = open(ms->path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC,
+		      LDMSD_DEFAULT_FILE_PERM);
+	if (ms->fd < 0)
+		return -1;
+	TAILQ_INSERT_TAIL(&writer.lru, ms, lru_entry);
+	writer.open_count++;
+	return ms->fd;
+}
+
+static int ff_writev(int fd, struct iovec *iov, int n)
+{
+	ssize_t w;
+	while (n) {
+		w = writev(fd, iov, n);
+		if (w < 0) {
+			if (errno == EINTR)
+				continue;
+			return errno;
+		}
+		while (n && (size_t)w >= iov->iov_len) {
+			w -= iov->iov_len;
+			iov++;
+			n--;
+		}
+		if (n) {
+			iov->iov_base = (char *)iov->iov_base + w;
+			iov->iov_len -= w;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Append the pending data of \c ms to its file.
+ * caller MUST hold writer.io_lock
+ */
+static int ms_write(struct flatfile_metric_store *ms)
+{
+	struct ff_chunk_list list = TAILQ_HEAD_INITIALIZER(list);
+	struct iovec iov[FF_WRITER_IOV];
+	struct ff_chunk *c;
+	size_t bytes;
+	int n, rc = 0;
+
+	pthread_mutex_lock(&ms->lock);
+	TAILQ_CONCAT(&list, &ms->chunks, entry);
+	bytes = ms->pending;
+	ms->pending = 0;
+	ms->dirty = 0;
+	pthread_mutex_unlock(&ms->lock);
+	if (!bytes)
+		goto out;
+
+	if (ms_fd_get(ms) < 0) {
+		rc = errno;
+		ovis_log(mylog, OVIS_LERROR, STRFF ": Error opening %s: %d: %s, "
+			 "%zu bytes dropped\n", ms->path, rc, STRERROR(rc), bytes);
+		goto out;
+	}
+	c = TAILQ_FIRST(&list);
+	while (c) {
+		for (n = 0; c && n < FF_WRITER_IOV; c = TAILQ_NEXT(c, entry)) {
+			if (!c->len)
+				continue;
+			iov[n].iov_base = c->data;
+			iov[n].iov_len = c->len;
+			n++;
+		}
+		rc = ff_writev(ms->fd, iov, n);
+		if (rc) {
+			ovis_log(mylog, OVIS_LERROR, STRFF ": Error writing %s: %d: %s\n",
+				 ms->path, rc, STRERROR(rc));
+			/* reopen on the next write */
+			ms_fd_close(ms);
+			break;
+		}
+	}
+ out:
+	ff_chunks_put(&list, bytes);
+	return rc;
+}
+
+/* Write out all queued metric stores. */
+static void ff_writer_drain()
+{
+	struct flatfile_metric_store *ms;
+
+	pthread_mutex_lock(&writer.io_lock);
+	while (1) {
+		pthread_mutex_lock(&writer.lock);
+		ms = TAILQ_FIRST(&writer.dirty_list);
+		if (ms) {
+			TAILQ_REMOVE(&writer.dirty_list, ms, dirty_entry);
+			ms->queued = 0;
+		}
+		pthread_mutex_unlock(&writer.lock);
+		if (!ms)
+			break;
+		ms_write(ms);
+	}
+	pthread_mutex_unlock(&writer.io_lock);
+}
+
+static void *ff_writer_proc(void *arg)
+{
+	struct timespec ts;
+	int stop;
+
+	pthread_mutex_lock(&writer.lock);
+	while (1) {
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += flush_interval / 1000000;
+		ts.tv_nsec += (flush_interval % 1000000) * 1000;
+		if (ts.tv_nsec >= 1000000000) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000;
+		}
+		while (!writer.stop && writer.pending < buffer_size) {
+			if (pthread_cond_timedwait(&writer.cond, &writer.lock, &ts))
+				break; /* flush interval */
+		}
+		stop = writer.stop;
+		pthread_mutex_unlock(&writer.lock);
+		ff_writer_drain();
+		pthread_mutex_lock(&writer.lock);
+		if (stop)
+			break;
+	}
+	pthread_mutex_unlock(&writer.lock);
+	return NULL;
+}
+
+/* caller MUST hold cfg_lock */
+static int ff_writer_start()
+{
+	int rc;
+	if (writer.started)
+		return 0;
+	writer.stop = 0;
+	rc = pthread_create(&writer.thread, NULL, ff_writer_proc, NULL);
+	if (rc)
+		return rc;
+	pthread_setname_np(writer.thread, "store_flatfile:wr");
+	writer.started = 1;
+	return 0;
+}
+
+/* Drain the dirty list and stop the writer thread. */
+static void ff_writer_stop()
+{
+	struct ff_chunk *c;
+
+	if (writer.started) {
+		pthread_mutex_lock(&writer.lock);
+		writer.stop = 1;
+		pthread_cond_signal(&writer.cond);
+		pthread_mutex_unlock(&writer.lock);
+		pthread_join(writer.thread, NULL);
+		writer.started = 0;
+	}
+	while ((c = TAILQ_FIRST(&writer.free_list))) {
+		TAILQ_REMOVE(&writer.free_list, c, entry);
+		free(c);
+	}
+	writer.free_count = 0;
+}
+
+static void ms_free(struct flatfile_metric_store *ms)
+{
+	struct ff_chunk *c;
+	while ((c = TAILQ_FIRST(&ms->chunks))) {
+		TAILQ_REMOVE(&ms->chunks, c, entry);
+		free(c);
+	}
+	if (ms->path)
+		free(ms->path);
+	pthread_mutex_destroy(&ms->lock);
+	free(ms);
+}
+
 /**
  * \brief Configuration
  */
 static int config(ldmsd_plug_handle_t handle, struct attr_value_list *kwl, struct attr_value_list *avl)
 {
-	char *value;
+	char *value, *opt, *end;
+	long lval;
+	int64_t bval;
 	value = av_value(avl, "path");
 	if (!value)
 		goto err;
 
+	opt = av_value(avl, "max_open");
+	if (opt) {
+		lval = strtol(opt, &end, 0);
+		if (*end != '\0' || lval <= 0 || lval > INT_MAX) {
+			ovis_log(mylog, OVIS_LERROR, STRFF ": Invalid max_open '%s'\n", opt);
+			return EINVAL;
+		}
+		max_open = lval;
+	}
+	opt = av_value(avl, "flush_interval");
+	if (opt) {
+		lval = strtol(opt, &end, 0);
+		if (*end != '\0' || lval <= 0) {
+			ovis_log(mylog, OVIS_LERROR, STRFF ": Invalid flush_interval '%s'\n", opt);
+			return EINVAL;
+		}
+		flush_interval = lval;
+	}
+	opt = av_value(avl, "buffer_size");
+	if (opt) {
+		bval = ovis_get_mem_size(opt);
+		if (bval <= 0) {
+			ovis_log(mylog, OVIS_LERROR, STRFF ": Invalid buffer_size '%s'\n", opt);
+			return EINVAL;
+		}
+		buffer_size = bval;
+	}
+
 	pthread_mutex_lock(&cfg_lock);
 	if (root_path)
 		free(root_path);
@@ -127,9 +499,17 @@ static int config(ldmsd_plug_handle_t handle, struct attr_value_list *kwl, struc
 static const char *usage(ldmsd_plug_handle_t handle)
 {
 	return
-"    config name=store_flatfile path=<path>\n"
+"    config name=store_flatfile path=<path> [max_open=<n>] [flush_interval=<usec>]\n"
+"                               [buffer_size=<bytes>]\n"
 "              - Set the root path for the storage of flatfiles.\n"
-"              path      The path to the root of the flatfile directory\n";
+"              path           The path to the root of the flatfile directory\n"
+"              max_open       The maximum number of open metric files (default "
+				stringify(FF_MAX_OPEN_DEFAULT) ")\n"
+"              flush_interval The interval in microseconds at which buffered\n"
+"                             data is written to the files (default "
+				stringify(FF_FLUSH_INTERVAL_DEFAULT) ")\n"
+"              buffer_size    Write out earlier when this many bytes are\n"
+"                             buffered, e.g. 4M (default 4M)\n";
 }
 
 static ldmsd_store_handle_t
@@ -138,7 +518,7 @@ static ldmsd_store_handle_t
 {
 	struct flatfile_store_instance *si;
 	struct flatfile_metric_store *ms;
-	int i;
+	int i, rc;
 	char *key = NULL;
 	size_t len;
 
@@ -150,6 +530,13 @@ static ldmsd_store_handle_t
 	snprintf(key, len, "%s:%s", container, schema);
 
 	pthread_mutex_lock(&cfg_lock);
+	rc = ff_writer_start();
+	if (rc) {
+		ovis_log(mylog, OVIS_LERROR, STRFF ": Failed to start the writer "
+			 "thread: %d: %s\n", rc, STRERROR(rc));
+		si = NULL;
+		goto out;
+	}
 	/*
 	 * Add a component type directory if one does not
 	 * already exist
@@ -189,6 +576,7 @@ static ldmsd_store_handle_t
 		i = 0;
 		char mname[128];
 		char *name;
+		pthread_mutex_lock(&writer.io_lock);
 		TAILQ_FOREACH(x, metric_list, entry) {
 			name = strchr(x->name, '#');
 			if (name) {
@@ -210,6 +598,9 @@ static ldmsd_store_handle_t
 					__FILE__, __LINE__);
 				goto err4;
 			}
+			ms->fd = -1;
+			TAILQ_INIT(&ms->chunks);
+			pthread_mutex_init(&ms->lock, NULL);
 			sprintf(tmp_path, "%s/%s", si->path, name);
 			ms->path = strdup(tmp_path);
 			if (!ms->path) {
@@ -217,38 +608,33 @@ static ldmsd_store_handle_t
 					__FILE__, __LINE__);
 				goto err4;
 			}
-			ms->file = fopen_perm(ms->path, "a+", LDMSD_DEFAULT_FILE_PERM);
-			if (!ms->file) {
+			/* create the file now; it may be evicted from the cache later */
+			if (ms_fd_get(ms) < 0) {
 				int eno = errno;
 				ovis_log(mylog, OVIS_LERROR, STRFF ": Error opening %s: %d: %s at %s:%d\n",
 					ms->path, eno, STRERROR(eno),
 					__FILE__, __LINE__);
 				goto err4;
 			}
-			pthread_mutex_init(&ms->lock, NULL);
 			idx_add(si->ms_idx, name, strlen(name), ms);
 			LIST_INSERT_HEAD(&si->ms_list, ms, entry);
 			si->ms[i++] = ms;
 		}
-		idx_add(store_idx, (void *)key, strlen(key), si);
+		pthread_mutex_unlock(&writer.io_lock);
+		si->key = key;
+		key = NULL;
+		idx_add(store_idx, (void *)si->key, strlen(si->key), si);
 	}
 	goto out;
 err4:
-	if (ms) {
-		if (ms->path)
-			free(ms->path);
-		if (ms->file)
-			fclose(ms->file);
-		free(ms);
-	}
+	if (ms)
+		ms_free(ms);
 	while ((ms = LIST_FIRST(&si->ms_list))) {
 		LIST_REMOVE(ms, entry);
-		if (ms->path)
-			free(ms->path);
-		if (ms->file)
-			fclose(ms->file);
-		free(ms);
+		ms_fd_close(ms);
+		ms_free(ms);
 	}
+	pthread_mutex_unlock(&writer.io_lock);
 
 	free(si->schema);
 err3:
@@ -269,11 +655,14 @@ static int
 store(ldmsd_plug_handle_t handle, ldmsd_store_handle_t _sh, ldms_set_t set, int *metric_arry, size_t metric_count)
 {
 	struct flatfile_store_instance *si;
+	struct flatfile_metric_store *ms;
 	int i;
-	int rc = 0, rc2 = 0;
+	int rc = 0;
 	int last_rc = 0;
 	int last_errno = 0;
-	int compidx;
+	int compidx, queue;
+	int64_t bytes = 0;
+	size_t pending;
 
 	if (!_sh)
 		return EINVAL;
@@ -294,83 +683,93 @@ store(ldmsd_plug_handle_t handle, ldmsd_store_handle_t _sh, ldms_set_t set, int
 		comp_id = ldms_metric_get_u64(set, compidx);
 	}
 	for (i=0; i<metric_count; i++) {
-		pthread_mutex_lock(&si->ms[i]->lock);
+		ms = si->ms[i];
+		pthread_mutex_lock(&ms->lock);
+		pending = ms->pending;
 		/* time, host, compid, value */
-#define STAMP \
-	rc2 = fprintf(si->ms[i]->file, "%"PRIu32".%06"PRIu32" %s %"PRIu64, \
-		ts->sec, ts->usec, prod, comp_id)
+#define STAMP "%"PRIu32".%06"PRIu32" %s %"PRIu64
+#define STAMP_ARGS ts->sec, ts->usec, prod, comp_id
 		enum ldms_value_type metric_type =
 			ldms_metric_type_get(set, metric_arry[i]);
 		switch (metric_type) {
 		case LDMS_V_CHAR_ARRAY:
-			STAMP;
-			rc = fprintf(si->ms[i]->file, " %s\n",
+			rc = ms_printf(ms, STAMP " %s\n", STAMP_ARGS,
 			     ldms_metric_array_get_str(set, metric_arry[i]));
 			break;
 		case LDMS_V_U8:
-			STAMP;
-			rc = fprintf(si->ms[i]->file, " %u\n",
+			rc = ms_printf(ms, STAMP " %u\n", STAMP_ARGS,
 			     (unsigned)ldms_metric_get_u8(set, metric_arry[i]));
 			break;
 		case LDMS_V_S8:
-			STAMP;
-			rc = fprintf(si->ms[i]->file, " %d\n",
+			rc = ms_printf(ms, STAMP " %d\n", STAMP_ARGS,
 			     (int)ldms_metric_get_s8(set, metric_arry[i]));
 			break;
 		case LDMS_V_U16:
-			STAMP;
-			rc = fprintf(si->ms[i]->file, " %u\n",
+			rc = ms_printf(ms, STAMP " %u\n", STAMP_ARGS,
 			     (unsigned)ldms_metric_get_u16(set, metric_arry[i]));
 			break;
 		case LDMS_V_S16:
-			STAMP;
-			rc = fprintf(si->ms[i]->file, " %d\n",
+			rc = ms_printf(ms, STAMP " %d\n", STAMP_ARGS,
 			     (int)ldms_metric_get_s16(set, metric_arry[i]));
 			break;
 		case LDMS_V_U32:
-			STAMP;
-			rc = fprintf(si->ms[i]->file, " %u\n",
+			rc = ms_printf(ms, STAMP " %u\n", STAMP_ARGS,
 			     (unsigned)ldms_metric_get_u32(set, metric_arry[i]));
 			break;
 		case LDMS_V_S32:
-			STAMP;
-			rc = fprintf(si->ms[i]->file, " %d\n",
+			rc = ms_printf(ms, STAMP " %d\n", STAMP_ARGS,
 			     ldms_metric_get_s32(set, metric_arry[i]));
 			break;
 		case LDMS_V_U64:
-			STAMP;
-			rc = fprintf(si->ms[i]->file, " %"PRIu64"\n",
+			rc = ms_printf(ms, STAMP " %"PRIu64"\n", STAMP_ARGS,
 			     ldms_metric_get_u64(set, metric_arry[i]));
 			break;
 		case LDMS_V_S64:
-			STAMP;
-			rc = fprintf(si->ms[i]->file, " %"PRId64"\n",
+			rc = ms_printf(ms, STAMP " %"PRId64"\n", STAMP_ARGS,
 			     ldms_metric_get_s64(set, metric_arry[i]));
 			break;
 		case LDMS_V_F32:
-			STAMP;
-			rc = fprintf(si->ms[i]->file, " %.9g\n",
+			rc = ms_printf(ms, STAMP " %.9g\n", STAMP_ARGS,
 			     ldms_metric_get_float(set, metric_arry[i]));
 			break;
 		case LDMS_V_D64:
-			STAMP;
-			rc = fprintf(si->ms[i]->file, " %.17g\n",
+			rc = ms_printf(ms, STAMP " %.17g\n", STAMP_ARGS,
 			     ldms_metric_get_double(set, metric_arry[i]));
 			break;
 		default:
 			/* array types not supported yet. want row and split files options */
+			rc = 0;
 			break;
 		}
+#undef STAMP_ARGS
 #undef STAMP
-		if (rc < 0 || rc2 < 0) {
+		if (rc < 0) {
 			last_errno = errno;
-			last_rc = (rc != 0 ? rc : rc2);
+			last_rc = rc;
 			ovis_log(mylog, OVIS_LERROR, STRFF ": Error %d: %s at %s:%d\n", last_errno,
 					STRERROR(last_errno), __FILE__,
 					__LINE__);
 		}
-		pthread_mutex_unlock(&si->ms[i]->lock);
+		bytes += ms->pending - pending;
+		queue = (ms->pending && !ms->dirty);
+		if (queue)
+			ms->dirty = 1;
+		pending = ms->pending;
+		pthread_mutex_unlock(&ms->lock);
+		if (queue)
+			ms_queue(ms);
+		if (pending >= FF_MS_PENDING_MAX) {
+			/* the writer is behind; write this file out here */
+			pthread_mutex_lock(&writer.io_lock);
+			ms_write(ms);
+			pthread_mutex_unlock(&writer.io_lock);
+		}
 	}
+	pthread_mutex_lock(&writer.lock);
+	writer.pending += bytes;
+	if (writer.pending >= buffer_size)
+		pthread_cond_signal(&writer.cond);
+	pthread_mutex_unlock(&writer.lock);
 
  err:
 	if (last_errno)
@@ -384,44 +783,45 @@ static int flush_store(ldmsd_plug_handle_t handle, ldmsd_store_handle_t _sh)
 	if (!_sh)
 		return EINVAL;
 	int lrc, rc = 0;
-	int eno = 0;
 	struct flatfile_metric_store *ms;
+	pthread_mutex_lock(&writer.io_lock);
 	LIST_FOREACH(ms, &si->ms_list, entry) {
-		pthread_mutex_lock(&ms->lock);
-		lrc = fflush(ms->file);
-		if (lrc) {
+		lrc = ms_write(ms);
+		if (lrc)
 			rc = lrc;
-			eno = errno;
-			ovis_log(mylog, OVIS_LERROR, STRFF ": Error %d: %s at %s:%d\n",
-				eno, STRERROR(eno),
-					__FILE__, __LINE__);
-		}
-		pthread_mutex_unlock(&ms->lock);
 	}
-	if (eno)
-		errno = eno;
+	pthread_mutex_unlock(&writer.io_lock);
+	if (rc)
+		errno = rc;
 	return rc;
 }
 
 static void close_store(ldmsd_plug_handle_t handle, ldmsd_store_handle_t _sh)
 {
-	pthread_mutex_lock(&cfg_lock);
 	/*
 	 * NOTE: This close function looks like destroy to me.
 	 */
 	struct flatfile_store_instance *si = _sh;
 	if (!_sh)
 		return;
+	pthread_mutex_lock(&cfg_lock);
 	struct flatfile_metric_store *ms;
+	pthread_mutex_lock(&writer.io_lock);
 	while ((ms = LIST_FIRST(&si->ms_list))) {
 		LIST_REMOVE(ms, entry);
-		if (ms->file)
-			fclose(ms->file);
-		if (ms->path)
-			free(ms->path);
-		free(ms);
+		pthread_mutex_lock(&writer.lock);
+		if (ms->queued) {
+			TAILQ_REMOVE(&writer.dirty_list, ms, dirty_entry);
+			ms->queued = 0;
+		}
+		pthread_mutex_unlock(&writer.lock);
+		ms_write(ms);
+		ms_fd_close(ms);
+		ms_free(ms);
 	}
-	idx_delete(store_idx, (void *)(si->schema), strlen(si->schema));
+	pthread_mutex_unlock(&writer.io_lock);
+	idx_delete(store_idx, (void *)(si->key), strlen(si->key));
+	free(si->key);
 	free(si->path);
 	free(si->schema);
 	idx_destroy(si->ms_idx);
@@ -439,9 +839,13 @@ static int constructor(ldmsd_plug_handle_t handle)
 static void destructor(ldmsd_plug_handle_t handle)
 {
 	/*
+	 * The writer writes out the buffered data before it exits.
 	 * TODO: Iterate through all unclosed stores and cleanup resources
 	 * and close any open files.
 	 */
+	pthread_mutex_lock(&cfg_lock);
+	ff_writer_stop();
+	pthread_mutex_unlock(&cfg_lock);
 }
 
 struct ldmsd_store ldmsd_plugin_interface = {
@@ -463,11 +867,20 @@ static void store_flatfile_init()
 {
 	store_idx = idx_create();
 	pthread_mutex_init(&cfg_lock, NULL);
+	pthread_mutex_init(&writer.lock, NULL);
+	pthread_mutex_init(&writer.io_lock, NULL);
+	pthread_cond_init(&writer.cond, NULL);
+	TAILQ_INIT(&writer.dirty_list);
+	TAILQ_INIT(&writer.free_list);
+	TAILQ_INIT(&writer.lru);
 }
 
 static void __attribute__ ((destructor)) store_flatfile_fini(void);
 static void store_flatfile_fini()
 {
 	pthread_mutex_destroy(&cfg_lock);
+	pthread_mutex_destroy(&writer.lock);
+	pthread_mutex_destroy(&writer.io_lock);
+	pthread_cond_destroy(&writer.cond);
 	idx_destroy(store_idx);
 }
@@ -110,11 +110,79 @@ struct sos_list_ctxt {
 	struct sos_list *list;
 };
 
+/*
+ * Rows committed through a decomposition are copied into per-schema
+ * staging batches while the strgp lock is held, and handed to a
+ * per-plugin writer thread. The writer inserts all of the queued rows of
+ * a container in one SOS transaction, creating the objects of a schema
+ * together and indexing them in the key order of the first indexed
+ * attribute.
+ */
+#define SOS_BATCH_INIT_SZ	8192	/* initial staging allocation */
+#define SOS_BATCH_FREE_MAX	64	/* batches cached for reuse */
+#define SOS_WQ_MAX_BYTES	(64 * 1024 * 1024) /* producers block above this backlog */
+
+#define SOS_BATCH_F_WAIT	0x1	/* submitter waits for the writer to pass it */
+
+#define SOS_STAGE_ALIGN(_sz)	(((_sz) + 7) & ~((size_t)7))
+
+struct row_schema_rbn_s;
+
+/*
+ * Staged rows of one schema. Each row is a struct sos_stage_row followed
+ * by col_count columns, each a struct sos_stage_col followed by the
+ * value bytes padded to 8 bytes.
+ */
+struct sos_batch {
+	TAILQ_ENTRY(sos_batch) entry;
+	sos_handle_t sos_handle; /* container reference held for the writer */
+	struct row_schema_rbn_s *rrbn; /* NULL in a wait marker */
+	int flags; /* SOS_BATCH_F_* */
+	int done;
+	int grouped; /* writer thread only */
+	int row_count;
+	size_t len;
+	size_t alloc;
+	char *data;
+};
+TAILQ_HEAD(sos_batch_list, sos_batch);
+
+struct sos_stage_row {
+	uint32_t col_count;
+	uint32_t len; /* including this header */
+};
+
+struct sos_stage_col {
+	uint32_t type; /* enum ldms_value_type */
+	uint32_t count; /* array elements, 1 for scalars */
+};
+
+/* An object created by the writer, and its sort key. */
+struct sos_wobj {
+	sos_obj_t obj;
+	sos_key_t key;
+};
+
+struct sos_writer {
+	pthread_mutex_t lock;
+	pthread_cond_t cond; /* queue, completion, and backlog changes */
+	pthread_t thread;
+	int started;
+	int stop;
+	size_t qbytes; /* queued bytes not yet inserted */
+	struct sos_batch_list queue;
+	struct sos_batch_list free_list;
+	int free_count;
+	struct sos_wobj *wobj; /* writer thread only */
+	size_t wobj_alloc;
+};
+
 typedef struct store_sos_s {
 	pthread_mutex_t cfg_lock;
 	LIST_HEAD(sos_inst_list, sos_instance) inst_list;
 	char root_path[PATH_MAX]; /**< store root path */
 	time_t timeout;		  /* Default is forever */
+	struct sos_writer writer;
 } *store_sos_t;
 
 /*
@@ -122,6 +190,7 @@ typedef struct store_sos_s {
  *   <sos::path> = <root_path>/<container>
  */
 struct sos_instance {
+	store_sos_t ss;
 	char *container;
 	char *schema_name;
 	char *path; /**< <root_path>/<container> */
@@ -164,6 +233,8 @@ struct row_schema_rbn_s {
 	struct ldms_digest_s digest;
 	char name[128];
 	sos_schema_t sos_schema;
+	sos_attr_t sort_attr; /* first indexed attribute, may be NULL */
+	struct sos_batch *batch; /* rows staged by the current commit */
 };
 
 static int row_schema_rbn_cmp(void *tree_key, const void *key)
@@ -514,6 +585,14 @@ static sos_handle_t __find_container(const char *path)
 	return h;
 }
 
+static sos_handle_t ref_container(sos_handle_t h)
+{
+	pthread_mutex_lock(&cfg_lock);
+	h->ref_count++;
+	pthread_mutex_unlock(&cfg_lock);
+	return h;
+}
+
 static sos_handle_t get_container(const char *path)
 {
 	sos_handle_t h = NULL;
@@ -584,7 +663,7 @@ static int config(ldmsd_plug_handle_t handle, struct attr_value_list *kwl, struc
 	LIST_FOREACH(si, &ss->inst_list, entry) {
 		pthread_mutex_lock(&si->lock);
 		if (si->sos_handle) {
-			put_container_no_lock(si->sos_handle);
+			put_container(si->sos_handle);
 			si->sos_handle = NULL;
 		}
 		size_t pathlen =
@@ -636,6 +715,7 @@ open_store(ldmsd_plug_handle_t handle, const char *container, const char *schema
 	if (!si->path)
 		goto err3;
 	sprintf(si->path, "%s/%s", ss->root_path, container);
+	si->ss = ss;
 	pthread_mutex_init(&si->lock, NULL);
 	pthread_mutex_lock(&ss->cfg_lock);
 	LIST_INSERT_HEAD(&ss->inst_list, si, entry);
@@ -1430,11 +1510,400 @@ err:
 	return errno;
 }
 
+/* caller MUST hold w->lock */
+static void __sos_batch_put(struct sos_writer *w, struct sos_batch *b)
+{
+	if (w->free_count < SOS_BATCH_FREE_MAX) {
+		TAILQ_INSERT_HEAD(&w->free_list, b, entry);
+		w->free_count++;
+		return;
+	}
+	free(b->data);
+	free(b);
+}
+
+static struct sos_batch *sos_batch_get(struct sos_writer *w)
+{
+	struct sos_batch *b;
+
+	pthread_mutex_lock(&w->lock);
+	b = TAILQ_FIRST(&w->free_list);
+	if (b) {
+		TAILQ_REMOVE(&w->free_list, b, entry);
+		w->free_count--;
+	}
+	pthread_mutex_unlock(&w->lock);
+	if (!b)
+		return calloc(1, sizeof(*b));
+	b->sos_handle = NULL;
+	b->rrbn = NULL;
+	b->flags = 0;
+	b->done = 0;
+	b->row_count = 0;
+	b->len = 0;
+	return b;
+}
+
+static int sos_batch_reserve(struct sos_batch *b, size_t n)
+{
+	size_t sz;
+	char *data;
+
+	if (b->len + n <= b->alloc)
+		return 0;
+	sz = b->alloc ? b->alloc : SOS_BATCH_INIT_SZ;
+	while (sz < b->len + n)
+		sz *= 2;
+	data = realloc(b->data, sz);
+	if (!data)
+		return ENOMEM;
+	b->data = data;
+	b->alloc = sz;
+	return 0;
+}
+
+static int sos_writer_wobj_reserve(struct sos_writer *w, size_t n)
+{
+	struct sos_wobj *wobj;
+	size_t sz;
+
+	if (n <= w->wobj_alloc)
+		return 0;
+	sz = w->wobj_alloc ? w->wobj_alloc : 1024;
+	while (sz < n)
+		sz *= 2;
+	wobj = realloc(w->wobj, sz * sizeof(*wobj));
+	if (!wobj)
+		return ENOMEM;
+	w->wobj = wobj;
+	w->wobj_alloc = sz;
+	return 0;
+}
+
+/* writer thread only */
+static int sos_writer_begin_x(struct sos_writer *w, sos_handle_t h)
+{
+	store_sos_t ss = container_of(w, struct store_sos_s, writer);
+	struct timespec now;
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	if (ss->timeout > 0) {
+		now.tv_sec += ss->timeout;
+		if (sos_begin_x_wait(h->sos, &now)) {
+			LOG_(OVIS_LERROR,
+			     "Timeout attempting to open a transaction on the container '%s'.\n",
+			     h->path);
+			return ETIMEDOUT;
+		}
+		return 0;
+	}
+	while (sos_begin_x_wait(h->sos, &now)) {
+		now.tv_sec += 5; /* Report warning every 5 seconds */
+		LOG_(OVIS_LWARN,
+		     "Timeout attempting to open a transaction "
+		     "on the container '%s'...retrying.\n",
+		     h->path);
+		clock_gettime(CLOCK_REALTIME, &now);
+	}
+	return 0;
+}
+
+/*
+ * Create the objects of the rows staged in b, appending them and their
+ * sort keys to w->wobj starting at *n. The objects are not indexed yet.
+ * writer thread only.
+ */
+static void sos_writer_batch_objs(struct sos_writer *w, struct sos_batch *b,
+				  size_t *n)
+{
+	struct row_schema_rbn_s *rrbn = b->rrbn;
+	struct sos_stage_row *srow;
+	struct sos_stage_col *scol;
+	sos_attr_t sos_attr;
+	sos_obj_t sos_obj;
+	SOS_VALUE(value);
+	SOS_VALUE(array_value);
+	char *p, *end = b->data + b->len;
+	size_t sz;
+	int i;
+
+	if (sos_writer_wobj_reserve(w, *n + b->row_count)) {
+		LOG_(OVIS_LERROR, "Not enough memory, %d rows dropped, "
+		     "container: %s, schema: %s\n",
+		     b->row_count, b->sos_handle->path, rrbn->name);
+		return;
+	}
+	for (p = b->data; p < end; p += srow->len) {
+		srow = (void *)p;
+		sos_obj = sos_obj_new(rrbn->sos_schema);
+		if (!sos_obj) {
+			LOG_(OVIS_LERROR, "cannot create SOS object, "
+			     "errno: %d, container: %s, schema: %s\n",
+			     errno, b->sos_handle->path, rrbn->name);
+			continue;
+		}
+		/* the columns were matched with the attributes when staged */
+		sos_attr = sos_schema_attr_first(rrbn->sos_schema);
+		scol = (void *)(srow + 1);
+		for (i = 0; i < srow->col_count; i++) {
+			ldms_mval_t mval = (void *)(scol + 1);
+			if (0 == ldms_type_is_array(scol->type)) {
+				sos_value_init(value, sos_obj, sos_attr);
+				sos_mval_set(value, mval, scol->type);
+				sos_value_put(value);
+				sz = (scol->type == LDMS_V_TIMESTAMP) ?
+					sizeof(struct ldms_timestamp) :
+					__element_byte_len(scol->type);
+			} else {
+				sz = scol->count * __element_byte_len(scol->type);
+				array_value = sos_array_new(array_value,
+						sos_attr, sos_obj, scol->count);
+				if (!array_value) {
+					LOG_(OVIS_LERROR, "Error %d allocating '%s' array of size %d\n",
+					     errno, sos_attr_name(sos_attr),
+					     scol->count);
+					break;
+				}
+				sos_value_memcpy(array_value, mval, sz);
+				sos_value_put(array_value);
+			}
+			scol = (void *)((char *)(scol + 1) + SOS_STAGE_ALIGN(sz));
+			sos_attr = sos_schema_attr_next(sos_attr);
+		}
+		if (i < srow->col_count) {
+			sos_obj_delete(sos_obj);
+			sos_obj_put(sos_obj);
+			continue;
+		}
+		w->wobj[*n].obj = sos_obj;
+		w->wobj[*n].key = rrbn->sort_attr ?
+				  sos_attr_key(rrbn->sort_attr, sos_obj) : NULL;
+		(*n)++;
+	}
+}
+
+static int sos_wobj_cmp(const void *a, const void *b, void *arg)
+{
+	const struct sos_wobj *wa = a, *wb = b;
+	if (!wa->key || !wb->key)
+		return (wa->key != NULL) - (wb->key != NULL);
+	return sos_index_key_cmp(arg, wa->key, wb->key);
+}
+
+/* Index the n objects in w->wobj in key order. writer thread only. */
+static void sos_writer_index(struct sos_writer *w, sos_attr_t sort_attr, size_t n)
+{
+	size_t i;
+
+	if (sort_attr && n > 1)
+		qsort_r(w->wobj, n, sizeof(w->wobj[0]), sos_wobj_cmp,
+			sos_attr_index(sort_attr));
+	for (i = 0; i < n; i++) {
+		sos_obj_index(w->wobj[i].obj);
+		sos_obj_put(w->wobj[i].obj);
+		if (w->wobj[i].key)
+			sos_key_put(w->wobj[i].key);
+	}
+}
+
+/*
+ * Insert the rows of a batch list, one transaction per container and one
+ * pass per schema. Returns the number of staged bytes consumed.
+ */
+static size_t sos_writer_process(struct sos_writer *w, struct sos_batch_list *list)
+{
+	struct sos_batch *b, *s, *t;
+	sos_schema_t sos_schema;
+	sos_handle_t h;
+	size_t bytes = 0, n;
+	int rc;
+
+	TAILQ_FOREACH(b, list, entry) {
+		b->grouped = (b->rrbn == NULL);
+		bytes += b->len;
+	}
+	TAILQ_FOREACH(b, list, entry) {
+		if (b->grouped)
+			continue;
+		h = b->sos_handle;
+		rc = sos_writer_begin_x(w, h);
+		for (s = b; s; s = TAILQ_NEXT(s, entry)) {
+			if (s->grouped || s->sos_handle != h)
+				continue;
+			sos_schema = s->rrbn->sos_schema;
+			n = 0;
+			for (t = s; t; t = TAILQ_NEXT(t, entry)) {
+				if (t->grouped || t->sos_handle != h ||
+				    t->rrbn->sos_schema != sos_schema)
+					continue;
+				t->grouped = 1;
+				if (rc) {
+					LOG_(OVIS_LERROR, "%d rows dropped, "
+					     "container: %s, schema: %s\n",
+					     t->row_count, h->path, t->rrbn->name);
+					continue;
+				}
+				sos_writer_batch_objs(w, t, &n);
+			}
+			sos_writer_index(w, s->rrbn->sort_attr, n);
+		}
+		if (!rc)
+			sos_end_x(h->sos);
+	}
+	TAILQ_FOREACH(b, list, entry) {
+		if (b->sos_handle) {
+			put_container(b->sos_handle);
+			b->sos_handle = NULL;
+		}
+	}
+	return bytes;
+}
+
+static void *sos_writer_proc(void *arg)
+{
+	struct sos_writer *w = arg;
+	struct sos_batch_list list;
+	struct sos_batch *b;
+	size_t bytes;
+
+	pthread_mutex_lock(&w->lock);
+	while (1) {
+		while (!w->stop && TAILQ_EMPTY(&w->queue))
+			pthread_cond_wait(&w->cond, &w->lock);
+		if (TAILQ_EMPTY(&w->queue))
+			break; /* stopped and drained */
+		TAILQ_INIT(&list);
+		TAILQ_CONCAT(&list, &w->queue, entry);
+		pthread_mutex_unlock(&w->lock);
+
+		bytes = sos_writer_process(w, &list);
+
+		pthread_mutex_lock(&w->lock);
+		w->qbytes -= bytes;
+		while ((b = TAILQ_FIRST(&list))) {
+			TAILQ_REMOVE(&list, b, entry);
+			if (b->flags & SOS_BATCH_F_WAIT)
+				b->done = 1;
+			else
+				__sos_batch_put(w, b);
+		}
+		pthread_cond_broadcast(&w->cond);
+	}
+	pthread_mutex_unlock(&w->lock);
+	return NULL;
+}
+
+static void sos_writer_init(struct sos_writer *w)
+{
+	pthread_mutex_init(&w->lock, NULL);
+	pthread_cond_init(&w->cond, NULL);
+	TAILQ_INIT(&w->queue);
+	TAILQ_INIT(&w->free_list);
+}
+
+static int sos_writer_start(struct sos_writer *w)
+{
+	int rc;
+
+	pthread_mutex_lock(&w->lock);
+	if (w->started) {
+		pthread_mutex_unlock(&w->lock);
+		return 0;
+	}
+	w->stop = 0;
+	rc = pthread_create(&w->thread, NULL, sos_writer_proc, w);
+	if (!rc) {
+		pthread_setname_np(w->thread, "store_sos:wr");
+		w->started = 1;
+	}
+	pthread_mutex_unlock(&w->lock);
+	return rc;
+}
+
+/* Drain the queue, stop the writer thread and release its memory. */
+static void sos_writer_stop(struct sos_writer *w)
+{
+	struct sos_batch *b;
+
+	if (w->started) {
+		pthread_mutex_lock(&w->lock);
+		w->stop = 1;
+		pthread_cond_broadcast(&w->cond);
+		pthread_mutex_unlock(&w->lock);
+		pthread_join(w->thread, NULL);
+		w->started = 0;
+	}
+	while ((b = TAILQ_FIRST(&w->free_list))) {
+		TAILQ_REMOVE(&w->free_list, b, entry);
+		free(b->data);
+		free(b);
+	}
+	w->free_count = 0;
+	free(w->wobj);
+	w->wobj = NULL;
+	w->wobj_alloc = 0;
+}
+
+/*
+ * Queue the batches in list, blocking while the writer backlog is over
+ * SOS_WQ_MAX_BYTES.
+ */
+static void sos_writer_submit(struct sos_writer *w, struct sos_batch_list *list)
+{
+	struct sos_batch *b;
+	size_t bytes = 0;
+
+	TAILQ_FOREACH(b, list, entry)
+		bytes += b->len;
+	pthread_mutex_lock(&w->lock);
+	if (!w->started) {
+		/*
+		 * writer not running; insert in the caller. w->wobj is shared,
+		 * so the callers insert one at a time under w->lock.
+		 */
+		sos_writer_process(w, list);
+		while ((b = TAILQ_FIRST(list))) {
+			TAILQ_REMOVE(list, b, entry);
+			__sos_batch_put(w, b);
+		}
+		pthread_mutex_unlock(&w->lock);
+		return;
+	}
+	while (w->qbytes > SOS_WQ_MAX_BYTES && !w->stop)
+		pthread_cond_wait(&w->cond, &w->lock);
+	w->qbytes += bytes;
+	TAILQ_CONCAT(&w->queue, list, entry);
+	pthread_cond_broadcast(&w->cond);
+	pthread_mutex_unlock(&w->lock);
+}
+
+/* Wait until the writer has inserted everything queued so far. */
+static void sos_writer_wait(struct sos_writer *w)
+{
+	struct sos_batch *b;
+
+	b = sos_batch_get(w);
+	if (!b)
+		return;
+	b->flags = SOS_BATCH_F_WAIT;
+	pthread_mutex_lock(&w->lock);
+	if (w->started) {
+		TAILQ_INSERT_TAIL(&w->queue, b, entry);
+		pthread_cond_broadcast(&w->cond);
+		while (!b->done)
+			pthread_cond_wait(&w->cond, &w->lock);
+	}
+	__sos_batch_put(w, b);
+	pthread_mutex_unlock(&w->lock);
+}
+
 static int flush_store(ldmsd_plug_handle_t handle, ldmsd_store_handle_t _sh)
 {
 	struct sos_instance *si = _sh;
 	if (!_sh)
 		return EINVAL;
+	/* rows committed so far must be in the container first */
+	sos_writer_wait(&si->ss->writer);
 	pthread_mutex_lock(&si->lock);
 	/* It is possible that a sos was unsuccessfully created. */
 	if (si->sos_handle)
@@ -1452,6 +1921,9 @@ static void close_store(ldmsd_plug_handle_t handle, ldmsd_store_handle_t _sh)
 	if (!si)
 		return;
 
+	/* the writer may still have rows referring to si->schema_rbt */
+	sos_writer_wait(&si->ss->writer);
+
 	pthread_mutex_lock(&cfg_lock);
 	LIST_REMOVE(si, entry);
 	pthread_mutex_unlock(&cfg_lock);
@@ -1482,11 +1954,17 @@ static int init_store_instance(ldmsd_plug_handle_t handle, ldmsd_strgp_t strgp)
 		goto err_0;
 	}
 	rbt_init(&si->schema_rbt, row_schema_rbn_cmp);
+	si->ss = ss;
 	len = asprintf(&si->path, "%s/%s", ss->root_path, strgp->container);
 	if (len < 0) {
 		rc = errno;
 		goto err_1;
 	}
+	rc = sos_writer_start(&ss->writer);
+	if (rc) {
+		LOG_(OVIS_LERROR, "writer thread create error: %d\n", rc);
+		goto err_2;
+	}
 	si->sos_handle = get_container(si->path);
 	if (!si->sos_handle) {
 		rc = errno;
@@ -1615,6 +2093,13 @@ get_row_schema(ldmsd_strgp_t strgp, ldmsd_row_t row)
 		if (!rrbn->sos_schema)
 			goto err_1;
 	}
+	/* the writer indexes each batch in the order of this attribute */
+	for (rrbn->sort_attr = sos_schema_attr_first(rrbn->sos_schema);
+	     rrbn->sort_attr;
+	     rrbn->sort_attr = sos_schema_attr_next(rrbn->sort_attr)) {
+		if (sos_attr_is_indexed(rrbn->sort_attr))
+			break;
+	}
 
 	rbt_ins(&si->schema_rbt, &rrbn->rbn);
 	return rrbn;
@@ -1625,21 +2110,95 @@ get_row_schema(ldmsd_strgp_t strgp, ldmsd_row_t row)
 	return NULL;
 }
 
+/*
+ * Copy the column values of row to the end of b. The columns are checked
+ * against the attributes of the schema so that the writer can apply them
+ * without checking.
+ */
+static int sos_batch_stage_row(struct sos_batch *b, sos_schema_t sos_schema,
+			       ldmsd_row_t row)
+{
+	struct sos_stage_row *srow;
+	struct sos_stage_col *scol;
+	sos_type_t sos_type;
+	sos_attr_t sos_attr;
+	ldmsd_col_t col;
+	size_t start = b->len, sz;
+	int i, count;
+
+	if (sos_batch_reserve(b, sizeof(*srow)))
+		goto enomem;
+	b->len += sizeof(*srow);
+	sos_attr = sos_schema_attr_first(sos_schema);
+	for (i = 0; i < row->col_count; i++) {
+		col = &row->cols[i];
+		if (!sos_attr) {
+			LOG_(OVIS_LERROR,
+			     "sos attribute - ldms metric mismatch: "
+			     "expecting more sos attributes\n");
+			goto einval;
+		}
+		sos_type = sos_type_from_ldms_type(col->type);
+		if (sos_attr_type(sos_attr) != sos_type) {
+			LOG_(OVIS_LERROR,
+			     "sos attribute - ldms metric type mismatch: "
+			     "expecting %s, but got %s\n",
+			     sos_type_sym(sos_type),
+			     sos_type_sym(sos_attr_type(sos_attr)));
+			goto einval;
+		}
+		if (0 == ldms_type_is_array(col->type)) {
+			count = 1;
+			sz = (col->type == LDMS_V_TIMESTAMP) ?
+				sizeof(struct ldms_timestamp) :
+				__element_byte_len(col->type);
+		} else {
+			if (col->type == LDMS_V_CHAR_ARRAY)
+				count = strnlen(col->mval->a_char, col->array_len);
+			else
+				count = col->array_len;
+			sz = count * __element_byte_len(col->type);
+		}
+		if (sos_batch_reserve(b, sizeof(*scol) + SOS_STAGE_ALIGN(sz)))
+			goto enomem;
+		scol = (void *)(b->data + b->len);
+		scol->type = col->type;
+		scol->count = count;
+		memcpy(scol + 1, col->mval, sz);
+		b->len += sizeof(*scol) + SOS_STAGE_ALIGN(sz);
+		sos_attr = sos_schema_attr_next(sos_attr);
+	}
+	srow = (void *)(b->data + start);
+	srow->col_count = row->col_count;
+	srow->len = b->len - start;
+	b->row_count++;
+	return 0;
+
+ enomem:
+	LOG_(OVIS_LERROR, "Not enough memory to stage a '%s' row\n",
+	     row->schema_name);
+	b->len = start;
+	return ENOMEM;
+ einval:
+	b->len = start;
+	return EINVAL;
+}
+
+/*
+ * Stage the rows in per-schema batches and hand them to the writer
+ * thread; the SOS objects are created and indexed there.
+ */
 static int
 commit_rows(ldmsd_plug_handle_t handle, ldmsd_strgp_t strgp,
 	    ldms_set_t set, ldmsd_row_list_t row_list, int row_count)
 {
 	int rc = 0;
+	store_sos_t ss = ldmsd_plug_ctxt_get(handle);
+	struct sos_batch_list staged;
 	struct sos_instance *si;
+	struct sos_batch *b;
 	ldmsd_row_t row;
-	ldmsd_col_t col;
 	struct row_schema_rbn_s *rrbn;
-	sos_obj_t sos_obj;
-	sos_type_t sos_type;
-	SOS_VALUE(value);
-	SOS_VALUE(array_value);
-	sos_attr_t sos_attr;
-	int i, esz, array_len, count;
 
 	if (!strgp->store_handle) {
 		rc = init_store_instance(handle, strgp);
@@ -1655,95 +2214,32 @@ commit_rows(ldmsd_plug_handle_t handle, ldmsd_strgp_t strgp,
 			goto out;
 		}
 	}
-	store_sos_t ss = ldmsd_plug_ctxt_get(handle);
-	if (ss->timeout > 0) {
-		struct timespec now;
-		clock_gettime(CLOCK_REALTIME, &now);
-		now.tv_sec += ss->timeout;
-		if (sos_begin_x_wait(si->sos_handle->sos, &now)) {
-			LOG_(OVIS_LERROR,
-			     "Timeout attempting to open a transaction on the container '%s'.\n",
-			     si->path);
-			errno = ETIMEDOUT;
-			pthread_mutex_unlock(&si->lock);
-			return -1;
-		}
-	} else {
-		sos_begin_x(si->sos_handle->sos);
-	}
+	TAILQ_INIT(&staged);
 	TAILQ_FOREACH(row, row_list, entry) {
 		rrbn = get_row_schema(strgp, row);
 		if (!rrbn) {
 			/* get_row_schema() already logged the error */
-			goto row_next;
-		}
-		sos_obj = sos_obj_new(rrbn->sos_schema);
-		if (!sos_obj) {
-			LOG_(OVIS_LERROR, "cannot create SOS object, "
-			     "errno: %d, container: %s, schema: %s\n",
-			     errno, si->path, rrbn->key.name);
-			goto row_next;
+			continue;
 		}
-		sos_attr = sos_schema_attr_first(rrbn->sos_schema);
-		for (i = 0; i < row->col_count; i++) {
-			col = &row->cols[i];
-			if (!sos_attr) {
-				LOG_(OVIS_LERROR,
-				     "sos attribute - ldms metric mismatch: "
-				     "expecting more sos attributes\n");
-				goto row_err;
+		b = rrbn->batch;
+		if (!b) {
+			b = sos_batch_get(&ss->writer);
+			if (!b) {
+				LOG_(OVIS_LERROR, "Not enough memory, "
+				     "container: %s, schema: %s\n",
+				     si->path, rrbn->key.name);
+				continue;
 			}
-			sos_type = sos_type_from_ldms_type(col->type);
-			if (sos_attr_type(sos_attr) != sos_type) {
-				LOG_(OVIS_LERROR,
-				     "sos attribute - ldms metric type mismatch: "
-				     "expecting %s, but got %s\n",
-				     sos_type_sym(sos_type),
-				     sos_type_sym(sos_attr_type(sos_attr)));
-				goto row_err;
-			}
-			if (0 == ldms_type_is_array(col->type)) {
-				sos_value_init(value, sos_obj, sos_attr);
-				sos_mval_set(value, col->mval, col->type);
-				sos_value_put(value);
-			} else {
-				esz = __element_byte_len(col->type);
-				if (col->type == LDMS_V_CHAR_ARRAY) {
-					array_len = strlen(col->mval->a_char);
-					if (array_len > col->array_len) {
-						array_len = col->array_len;
-					}
-				} else {
-					array_len = col->array_len;
-				}
-				array_value = sos_array_new(array_value,
-						sos_attr, sos_obj, array_len);
-				if (!array_value) {
-					LOG_(OVIS_LERROR, "Error %d allocating '%s' array of size %d\n",
-					     errno,
-					     sos_attr_name(sos_attr),
-					     array_len);
-					errno = ENOMEM;
-					goto row_err;
-				}
-				count = sos_value_memcpy(array_value,
-						col->mval, array_len * esz);
-				assert(count == array_len * esz);
-				sos_value_put(array_value);
-			}
-			sos_attr = sos_schema_attr_next(sos_attr);
+			b->rrbn = rrbn;
+			b->sos_handle = ref_container(si->sos_handle);
+			rrbn->batch = b;
+			TAILQ_INSERT_TAIL(&staged, b, entry);
 		}
-		sos_obj_index(sos_obj);
-		sos_obj_put(sos_obj);
-		sos_obj = NULL;
-		goto row_next;
-
-	row_err:
-		sos_obj_delete(sos_obj);
-	row_next:
-		continue;
+		(void)sos_batch_stage_row(b, rrbn->sos_schema, row);
 	}
-	sos_end_x(si->sos_handle->sos);
+	TAILQ_FOREACH(b, &staged, entry)
+		b->rrbn->batch = NULL;
+	sos_writer_submit(&ss->writer, &staged);
  out:
 	return rc;
 }
@@ -1759,6 +2255,7 @@ static int constructor(ldmsd_plug_handle_t handle)
 	store_sos_t ss = calloc(1, sizeof(*ss));
 	if (!ss)
 		return ENOMEM;
+	sos_writer_init(&ss->writer);
 	ldmsd_plug_ctxt_set(handle, ss);
 	return 0;
 }
@@ -1766,6 +2263,9 @@ static int constructor(ldmsd_plug_handle_t handle)
 static void destructor(ldmsd_plug_handle_t handle)
 {
 	store_sos_t ss = ldmsd_plug_ctxt_get(handle);
+	sos_writer_stop(&ss->writer);
+	pthread_cond_destroy(&ss->writer.cond);
+	pthread_mutex_destroy(&ss->writer.lock);
         free(ss);
 }
 
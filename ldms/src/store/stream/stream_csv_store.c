@@ -47,6 +47,7 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#define _GNU_SOURCE
 #include <ctype.h>
 #include <sys/queue.h>
 #include <sys/types.h>
@@ -62,6 +63,7 @@
 #include <pthread.h>
 #include <errno.h>
 #include <unistd.h>
+#include <sys/uio.h>
 #include <ovis_json/ovis_json.h>
 #include <coll/idx.h>
 #include <coll/rbt.h>
@@ -160,6 +162,50 @@ static pthread_mutex_t cfg_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static idx_t stream_idx;
 
+/*
+ * Lines are formatted into a buffer per stream and handed to a writer
+ * thread, which owns all write() and fsync() calls on the data files.
+ * The stream files are opened with stdio, but stdio buffering is not
+ * used.
+ */
+#define WBUF_INIT_SZ	(64 * 1024)	/* initial line buffer allocation */
+#define WBUF_HIWAT	(64 * 1024)	/* hand a line buffer to the writer at this length */
+#define WBUF_MAX_AGE	1		/* seconds lines may wait in a line buffer */
+#define WBUF_FREE_MAX	32		/* line buffers cached for reuse */
+#define WQ_MAX_BYTES	(32 * 1024 * 1024) /* stream callbacks block above this backlog */
+#define WRITER_IOV	64		/* buffers gathered in one writev */
+
+#define WREQ_F_SYNC	0x1		/* fsync after writing */
+#define WREQ_F_WAIT	0x2		/* submitter waits for and frees the buffer */
+
+struct wbuf {
+	TAILQ_ENTRY(wbuf) entry;
+	int fd;
+	int flags; /* WREQ_F_* */
+	int done;
+	size_t len;
+	size_t alloc;
+	char *data;
+};
+TAILQ_HEAD(wbuf_list, wbuf);
+
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond; /* queue, completion, and backlog changes */
+	pthread_t thread;
+	int started;
+	int stop;
+	size_t qbytes; /* queued bytes not yet written */
+	struct wbuf_list queue;
+	struct wbuf_list free_list;
+	int free_count;
+} writer = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+	.queue = TAILQ_HEAD_INITIALIZER(writer.queue),
+	.free_list = TAILQ_HEAD_INITIALIZER(writer.free_list),
+};
+
 typedef enum {
 	CFG_PRE, CFG_BASIC, CFG_DONE, CFG_FAILED
 } cfg_state;
@@ -180,6 +226,13 @@ struct linedata {
 	int nkey;
 	int nheaderkey; /* number of keys in the header */
 	char *header;
+	/*
+	 * Values of the current message, in header order. Messages are
+	 * matched against the header keys in attribute order first, and
+	 * only looked up by name if the order differs.
+	 */
+	json_entity_t *singletonval;
+	json_entity_t *dictval;
 };
 
 struct csv_stream_handle {
@@ -201,6 +254,8 @@ struct csv_stream_handle {
 	struct timeval tlastrcv; /* for the flush. */
 	struct linedata dataline; /* used to keep track of keys for the header */
 	ldmsd_stream_client_t client; /* subscribe/unsubscribe */
+	struct wbuf *wb; /* lines not yet handed to the writer */
+	time_t wb_time; /* when wb was last handed to the writer */
 	pthread_mutex_t lock;
 };
 
@@ -236,6 +291,321 @@ static void _clear_key_info(struct linedata *dataline)
 	dataline->nheaderkey = 0;
 	free(dataline->header);
 	dataline->header = NULL;
+	free(dataline->singletonval);
+	dataline->singletonval = NULL;
+	free(dataline->dictval);
+	dataline->dictval = NULL;
+}
+
+/* caller MUST hold writer.lock */
+static void __wbuf_put(struct wbuf *wb)
+{
+	if (writer.free_count < WBUF_FREE_MAX) {
+		TAILQ_INSERT_HEAD(&writer.free_list, wb, entry);
+		writer.free_count++;
+		return;
+	}
+	free(wb->data);
+	free(wb);
+}
+
+static struct wbuf *_wbuf_get(void)
+{
+	struct wbuf *wb;
+
+	pthread_mutex_lock(&writer.lock);
+	wb = TAILQ_FIRST(&writer.free_list);
+	if (wb) {
+		TAILQ_REMOVE(&writer.free_list, wb, entry);
+		writer.free_count--;
+	}
+	pthread_mutex_unlock(&writer.lock);
+	if (!wb)
+		return calloc(1, sizeof(*wb));
+	wb->fd = -1;
+	wb->flags = 0;
+	wb->done = 0;
+	wb->len = 0;
+	return wb;
+}
+
+static int _wbuf_reserve(struct wbuf *wb, size_t n)
+{
+	size_t sz;
+	char *data;
+
+	if (wb->len + n <= wb->alloc)
+		return 0;
+	sz = wb->alloc ? wb->alloc : WBUF_INIT_SZ;
+	while (sz < wb->len + n)
+		sz *= 2;
+	data = realloc(wb->data, sz);
+	if (!data)
+		return ENOMEM;
+	wb->data = data;
+	wb->alloc = sz;
+	return 0;
+}
+
+/* Formatting into a line buffer. Each returns 0 or ENOMEM. */
+static inline int _wb_putsn(struct wbuf *wb, const char *str, size_t n)
+{
+	if (_wbuf_reserve(wb, n))
+		return ENOMEM;
+	memcpy(wb->data + wb->len, str, n);
+	wb->len += n;
+	return 0;
+}
+
+static inline int _wb_putc(struct wbuf *wb, char c)
+{
+	if (_wbuf_reserve(wb, 1))
+		return ENOMEM;
+	wb->data[wb->len++] = c;
+	return 0;
+}
+
+static int _wb_s64(struct wbuf *wb, int64_t v)
+{
+	char tmp[21];
+	uint64_t u = (v < 0) ? -(uint64_t)v : (uint64_t)v;
+	int n = 0;
+
+	do {
+		tmp[sizeof(tmp) - ++n] = '0' + (u % 10);
+		u /= 10;
+	} while (u);
+	if (v < 0)
+		tmp[sizeof(tmp) - ++n] = '-';
+	return _wb_putsn(wb, &tmp[sizeof(tmp) - n], n);
+}
+
+/* "%f" of a double is at most 317 digits plus sign, point and 6 decimals */
+static int _wb_double(struct wbuf *wb, double d)
+{
+	int n;
+
+	if (_wbuf_reserve(wb, 330))
+		return ENOMEM;
+	n = snprintf(wb->data + wb->len, wb->alloc - wb->len, "%f", d);
+	if (n < 0)
+		return EINVAL;
+	wb->len += n;
+	return 0;
+}
+
+/* Write all of iov to fd. */
+static int __writev_full(int fd, struct iovec *iov, int n)
+{
+	ssize_t rc;
+
+	while (n) {
+		rc = writev(fd, iov, n);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			return errno;
+		}
+		while (n && rc >= (ssize_t)iov->iov_len) {
+			rc -= iov->iov_len;
+			iov++;
+			n--;
+		}
+		if (n) {
+			iov->iov_base = (char *)iov->iov_base + rc;
+			iov->iov_len -= rc;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Write a batch of buffers, gathering runs destined for the same file
+ * into a single writev. Returns the number of bytes consumed.
+ */
+static size_t _writer_process(struct wbuf_list *batch)
+{
+	struct iovec iov[WRITER_IOV];
+	struct wbuf *wb, *next;
+	size_t bytes = 0;
+	int n, fd, flags, rc;
+
+	for (wb = TAILQ_FIRST(batch); wb; wb = next) {
+		fd = wb->fd;
+		n = 0;
+		next = wb;
+		do {
+			if (next->len) {
+				iov[n].iov_base = next->data;
+				iov[n].iov_len = next->len;
+				bytes += next->len;
+				n++;
+			}
+			flags = next->flags;
+			next = TAILQ_NEXT(next, entry);
+		} while (!(flags & WREQ_F_SYNC) && next && next->fd == fd &&
+			 n < WRITER_IOV);
+		if (n) {
+			rc = __writev_full(fd, iov, n);
+			if (rc)
+				ovis_log(mylog, OVIS_LERROR, PNAME
+					 ": Error %d writing to fd %d\n", rc, fd);
+		}
+		if (flags & WREQ_F_SYNC)
+			fsync(fd);
+	}
+	return bytes;
+}
+
+static void *_writer_proc(void *arg)
+{
+	struct wbuf_list batch;
+	struct wbuf *wb;
+	size_t bytes;
+
+	pthread_mutex_lock(&writer.lock);
+	while (1) {
+		while (!writer.stop && TAILQ_EMPTY(&writer.queue))
+			pthread_cond_wait(&writer.cond, &writer.lock);
+		if (TAILQ_EMPTY(&writer.queue))
+			break; /* stopped and drained */
+		TAILQ_INIT(&batch);
+		TAILQ_CONCAT(&batch, &writer.queue, entry);
+		pthread_mutex_unlock(&writer.lock);
+
+		bytes = _writer_process(&batch);
+
+		pthread_mutex_lock(&writer.lock);
+		writer.qbytes -= bytes;
+		while ((wb = TAILQ_FIRST(&batch))) {
+			TAILQ_REMOVE(&batch, wb, entry);
+			if (wb->flags & WREQ_F_WAIT)
+				wb->done = 1;
+			else
+				__wbuf_put(wb);
+		}
+		pthread_cond_broadcast(&writer.cond);
+	}
+	pthread_mutex_unlock(&writer.lock);
+	return NULL;
+}
+
+static int _writer_start(void)
+{
+	int rc = 0;
+
+	pthread_mutex_lock(&writer.lock);
+	if (!writer.started) {
+		writer.stop = 0;
+		rc = pthread_create(&writer.thread, NULL, _writer_proc, NULL);
+		if (!rc) {
+			pthread_setname_np(writer.thread, "stream_csv:wr");
+			writer.started = 1;
+		}
+	}
+	pthread_mutex_unlock(&writer.lock);
+	return rc;
+}
+
+/* Drain the queue and stop the writer thread. */
+static void _writer_stop(void)
+{
+	struct wbuf *wb;
+
+	pthread_mutex_lock(&writer.lock);
+	if (writer.started) {
+		writer.stop = 1;
+		pthread_cond_broadcast(&writer.cond);
+		pthread_mutex_unlock(&writer.lock);
+		pthread_join(writer.thread, NULL);
+		pthread_mutex_lock(&writer.lock);
+		writer.started = 0;
+	}
+	while ((wb = TAILQ_FIRST(&writer.free_list))) {
+		TAILQ_REMOVE(&writer.free_list, wb, entry);
+		free(wb->data);
+		free(wb);
+	}
+	writer.free_count = 0;
+	pthread_mutex_unlock(&writer.lock);
+}
+
+/* caller MUST hold stream_handle->lock */
+static struct wbuf *_stream_wbuf(struct csv_stream_handle *stream_handle)
+{
+	if (!stream_handle->wb)
+		stream_handle->wb = _wbuf_get();
+	return stream_handle->wb;
+}
+
+/*
+ * Hand the pending lines of stream_handle to the writer, with WREQ_F_SYNC
+ * to fsync the file afterwards. Blocks while the writer backlog is over
+ * WQ_MAX_BYTES, and with WREQ_F_WAIT until the lines are written.
+ * caller MUST hold stream_handle->lock.
+ */
+static void _stream_submit(struct csv_stream_handle *stream_handle, int flags)
+{
+	struct wbuf *wb = stream_handle->wb;
+
+	if (!(flags & (WREQ_F_SYNC | WREQ_F_WAIT)) && (!wb || !wb->len))
+		return;
+	if (!stream_handle->file)
+		return;
+	if (!wb) {
+		wb = _wbuf_get();
+		if (!wb)
+			return;
+	}
+	stream_handle->wb = NULL;
+	stream_handle->wb_time = time(NULL);
+	wb->fd = fileno(stream_handle->file);
+	wb->flags = flags;
+	wb->done = 0;
+
+	pthread_mutex_lock(&writer.lock);
+	if (!writer.started) {
+		/* no writer thread; write in the caller */
+		struct wbuf_list one;
+		pthread_mutex_unlock(&writer.lock);
+		TAILQ_INIT(&one);
+		TAILQ_INSERT_TAIL(&one, wb, entry);
+		_writer_process(&one);
+		pthread_mutex_lock(&writer.lock);
+		__wbuf_put(wb);
+		pthread_mutex_unlock(&writer.lock);
+		return;
+	}
+	while (writer.qbytes > WQ_MAX_BYTES && !writer.stop)
+		pthread_cond_wait(&writer.cond, &writer.lock);
+	writer.qbytes += wb->len;
+	TAILQ_INSERT_TAIL(&writer.queue, wb, entry);
+	pthread_cond_broadcast(&writer.cond);
+	if (flags & WREQ_F_WAIT) {
+		while (!wb->done)
+			pthread_cond_wait(&writer.cond, &writer.lock);
+		__wbuf_put(wb);
+	}
+	pthread_mutex_unlock(&writer.lock);
+}
+
+/*
+ * Apply the buffer policy after lines are added.
+ * caller MUST hold stream_handle->lock.
+ */
+static void _stream_flush_check(struct csv_stream_handle *stream_handle)
+{
+	struct wbuf *wb = stream_handle->wb;
+
+	if (!buffer) {
+		_stream_submit(stream_handle, WREQ_F_SYNC);
+		return;
+	}
+	if (!wb || !wb->len)
+		return;
+	if (wb->len >= WBUF_HIWAT ||
+	    time(NULL) - stream_handle->wb_time >= WBUF_MAX_AGE)
+		_stream_submit(stream_handle, 0);
 }
 
 static void close_streamstore(void *obj, void *cb_arg)
@@ -261,11 +631,16 @@ static void close_streamstore(void *obj, void *cb_arg)
 	stream_handle->client = NULL;
 
 	if (stream_handle->file) {
-		fflush(stream_handle->file);
-		fsync(fileno(stream_handle->file));
+		_stream_submit(stream_handle, WREQ_F_SYNC | WREQ_F_WAIT);
 		fclose(stream_handle->file);
 	}
 	stream_handle->file = NULL;
+	if (stream_handle->wb) {
+		pthread_mutex_lock(&writer.lock);
+		__wbuf_put(stream_handle->wb);
+		pthread_mutex_unlock(&writer.lock);
+		stream_handle->wb = NULL;
+	}
 
 	_clear_key_info(&stream_handle->dataline);
 	stream_handle->store_count = 0;
@@ -464,6 +839,13 @@ static int _get_header_from_data(struct linedata *dataline, json_entity_t e)
 	}
 
 	dataline->nheaderkey = dataline->nsingleton + dataline->ndict;
+	dataline->singletonval = calloc(dataline->nsingleton + 1,
+					sizeof(json_entity_t));
+	dataline->dictval = calloc(dataline->ndict + 1, sizeof(json_entity_t));
+	if (!dataline->singletonval || !dataline->dictval) {
+		rc = ENOMEM;
+		goto err;
+	}
 
 	/*
 	 * order will be order of singletons and order of dict.
@@ -506,28 +888,26 @@ err:
 	return rc;
 }
 
-static int _append_singleton(json_entity_t en, jbuf_t jb)
+static int _append_singleton(json_entity_t en, struct wbuf *wb)
 {
 
 	switch (en->type) {
 	case JSON_INT_VALUE:
-		jb = jbuf_append_str(jb, "%ld", en->value.int_);
-		break;
+		return _wb_s64(wb, en->value.int_);
 	case JSON_BOOL_VALUE:
 		if (en->value.bool_)
-			jb = jbuf_append_str(jb, "true");
-		else
-			jb = jbuf_append_str(jb, "false");
-		break;
+			return _wb_putsn(wb, "true", 4);
+		return _wb_putsn(wb, "false", 5);
 	case JSON_FLOAT_VALUE:
-		jb = jbuf_append_str(jb, "%f", en->value.double_);
-		break;
+		return _wb_double(wb, en->value.double_);
 	case JSON_STRING_VALUE:
-		jb = jbuf_append_str(jb, "\"%s\"", en->value.str_->str);
-		break;
+		if (_wbuf_reserve(wb, en->value.str_->str_len + 2))
+			return ENOMEM;
+		_wb_putc(wb, '"');
+		_wb_putsn(wb, en->value.str_->str, en->value.str_->str_len);
+		return _wb_putc(wb, '"');
 	case JSON_NULL_VALUE:
-		jb = jbuf_append_str(jb, "null");
-		break;
+		return _wb_putsn(wb, "null", 4);
 	default:
 		/* this should not happen */
 		ovis_log(mylog, OVIS_LDEBUG,
@@ -542,68 +922,126 @@ static int _append_singleton(json_entity_t en, jbuf_t jb)
 
 static int _print_header(struct csv_stream_handle *stream_handle)
 {
+	struct wbuf *wb;
 
 	/* don't count the header in the store_count or byte_count */
 	if (stream_handle && stream_handle->file
 			&& stream_handle->dataline.header) {
-		fprintf(stream_handle->file, "#%s\n",
-				stream_handle->dataline.header);
-		fflush(stream_handle->file);
-		fsync(fileno(stream_handle->file));
+		wb = _stream_wbuf(stream_handle);
+		if (!wb)
+			return ENOMEM;
+		_wb_putc(wb, '#');
+		_wb_putsn(wb, stream_handle->dataline.header,
+			  strlen(stream_handle->dataline.header));
+		_wb_putc(wb, '\n');
+		_stream_submit(stream_handle, WREQ_F_SYNC);
 		return 0;
 	}
 
 	return -1;
 }
 
+/* End the line that started at wb offset start, and account for it. */
+static int _end_line(struct csv_stream_handle *stream_handle,
+		     struct wbuf *wb, size_t start, struct timeval *tv_prev)
+{
+	int rc;
+#ifdef TIMESTAMP_STORE
+	_wb_putc(wb, ',');
+	_wb_double(wb, tv_prev->tv_sec + tv_prev->tv_usec/1000000.0);
+#endif
+	rc = _wb_putc(wb, '\n');
+	if (rc)
+		return rc;
+	stream_handle->byte_count += wb->len - start;
+	/*
+	 * stream_cb has the lock, so roll cannot be called while
+	 * this is going on.
+	 */
+	stream_handle->store_count++;
+	return 0;
+}
+
+/*
+ * Fill vals with the values of the keys in dict e, in key order.
+ * Attributes are compared with the keys in order first; the values are
+ * looked up by name only if the message keys are not in header order.
+ * If the dict has a list named listkey it is returned in *list.
+ */
+static void _match_keys(json_entity_t e, int nkey, char **key,
+			json_entity_t *vals, const char *listkey,
+			json_entity_t *list)
+{
+	json_entity_t a;
+	json_attr_t attr;
+	const char *name;
+	int i = 0;
+
+	if (list)
+		*list = NULL;
+	for (a = json_attr_first(e); a; a = json_attr_next(a)) {
+		attr = a->value.attr_;
+		name = attr->name->value.str_->str;
+		if (list && listkey && attr->value->type == JSON_LIST_VALUE &&
+		    0 == strcmp(name, listkey)) {
+			*list = attr->value;
+			continue;
+		}
+		if (i >= nkey || strcmp(name, key[i]))
+			goto slow;
+		vals[i++] = attr->value;
+	}
+	if (i == nkey)
+		return;
+ slow:
+	for (i = 0; i < nkey; i++)
+		vals[i] = json_value_find(e, key[i]);
+	if (list)
+		*list = listkey ? json_value_find(e, listkey) : NULL;
+}
+
 static int _print_data_lines(struct csv_stream_handle *stream_handle,
 				struct timeval *tv_prev, json_entity_t e)
 {
 	/* well known order */
 
 	json_entity_t en, li;
-	jbuf_t jbs, jb;
+	struct wbuf *wb;
+	size_t start, cur, prefix_len;
 	int iheaderkey;
 	int i;
 	int rc;
 
-	/*
-	 * NOTE: if needed for performance reasons, can we eliminate some
-	 * of the checking and jsut rely on getting NULL returns when we
-	 * ask for the actual item that we would want?
-	 */
 	if (!stream_handle || !stream_handle->file) {
 		return -1;
 	}
 
 	struct linedata *dataline = &stream_handle->dataline;
+	wb = _stream_wbuf(stream_handle);
+	if (!wb)
+		return ENOMEM;
+	start = cur = wb->len;
 
-	iheaderkey = 0;
+	_match_keys(e, dataline->nsingleton, dataline->singletonkey,
+		    dataline->singletonval, dataline->nlist ? dataline->listkey : NULL,
+		    &en);
 
-	jbs = NULL;
-	jbs = jbuf_new();
-	if (dataline->nsingleton > 0) {
-		for (i = 0; i < dataline->nsingleton; i++) {
-			en = json_value_find(e, dataline->singletonkey[i]);
-			if (en == NULL) {
-				/* this may or may not be ok.... */
-			} else {
-				rc = _append_singleton(en, jbs);
-				if (rc) {
-					ovis_log(mylog, OVIS_LDEBUG,
-						PNAME ": Cannot print data because "
-						"of a variable print problem\n");
-					jbuf_free(jbs);
-					return rc;
-				}
-			}
-			if (iheaderkey < (dataline->nheaderkey - 1)) {
-				jbs = jbuf_append_str(jbs, ",");
+	iheaderkey = 0;
+	for (i = 0; i < dataline->nsingleton; i++) {
+		if (dataline->singletonval[i]) {
+			rc = _append_singleton(dataline->singletonval[i], wb);
+			if (rc) {
+				ovis_log(mylog, OVIS_LDEBUG,
+					PNAME ": Cannot print data because "
+					"of a variable print problem\n");
+				goto err;
 			}
-			iheaderkey++;
 		}
-	} else {
-		jbs = jbuf_append_str(jbs, ""); /* Need this for adding list items */
+		/* else this may or may not be ok.... */
+		if (iheaderkey < (dataline->nheaderkey - 1)) {
+			_wb_putc(wb, ',');
+		}
+		iheaderkey++;
 	}
 
 	/*
@@ -611,42 +1049,23 @@ static int _print_data_lines(struct csv_stream_handle *stream_handle,
 	 * if header has no list or an empty list, just write the singletons
 	 */
 	if (dataline->nlist == 0) {
-#ifdef TIMESTAMP_STORE
-		rc = fprintf(stream_handle->file, "%s,%f\n", jbs->buf,
-			(tv_prev->tv_sec + tv_prev->tv_usec/1000000.0));
-#else
-		rc = fprintf(stream_handle->file, "%s\n", jbs->buf);
-
-#endif
-		jbuf_free(jbs);
-		stream_handle->byte_count += rc;
-		/*
-		 * stream_cb has the lock, so roll cannot be called while
-		 * this is going on.
-		 */
-		stream_handle->store_count++;
+		rc = _end_line(stream_handle, wb, start, tv_prev);
+		if (rc)
+			goto err;
 		goto out;
 	}
 
-	/* if header has a list..... */
-	en = json_value_find(e, dataline->listkey);
-	/* if data has no list */
-	if (en == NULL) {
-		ovis_log(mylog, OVIS_LDEBUG, PNAME ": no match for %s\n", dataline->listkey);
+	/* if data has no list, or a list with no dicts */
+	if (en == NULL || (en->type == JSON_LIST_VALUE && !json_item_first(en))) {
+		if (en == NULL)
+			ovis_log(mylog, OVIS_LDEBUG, PNAME ": no match for %s\n", dataline->listkey);
 		/* write out just the singleton line and empty vals for the dict items */
 		for (i = 0; i < dataline->ndict - 1; i++) {
-			jbs = jbuf_append_str(jbs, ",");
+			_wb_putc(wb, ',');
 		}
-#ifdef TIMESTAMP_STORE
-		rc = fprintf(stream_handle->file, "%s,%f\n", jbs->buf,
-			(tv_prev->tv_sec + tv_prev->tv_usec/1000000.0));
-#else
-		rc = fprintf(stream_handle->file, "%s\n", jbs->buf);
-#endif
-		jbuf_free(jbs);
-		stream_handle->byte_count += rc;
-		/* stream_cb has the lock, so roll cannot be called while this is going on. */
-		stream_handle->store_count++;
+		rc = _end_line(stream_handle, wb, start, tv_prev);
+		if (rc)
+			goto err;
 		goto out;
 	}
 
@@ -660,78 +1079,59 @@ static int _print_data_lines(struct csv_stream_handle *stream_handle,
 		 * NOTE: this is bad. currently writing out nothing,
 		 * but could change this later.
 		 */
-		jbuf_free(jbs);
+		wb->len = start;
 		return -1;
 	}
 
-	/* if there are no dicts */
-	if (json_item_first(en) == NULL) {
-		for (i = 0; i < dataline->ndict - 1; i++) {
-			jbs = jbuf_append_str(jbs, ",");
-		}
-#ifdef TIMESTAMP_STORE
-		rc = fprintf(stream_handle->file, "%s,%f\n", jbs->buf,
-			(tv_prev->tv_sec + tv_prev->tv_usec/1000000.0));
-#else
-		rc = fprintf(stream_handle->file, "%s\n", jbs->buf);
-#endif
-		jbuf_free(jbs);
-		stream_handle->byte_count += rc;
-		/* stream_cb has the lock, so roll cannot be called while this is going on. */
-		stream_handle->store_count++;
-		goto out;
-	}
-
-	/* if there are dicts */
+	/* if there are dicts, each is its own line after the singletons */
+	prefix_len = wb->len - start;
 	for (li = json_item_first(en); li; li = json_item_next(li)) {
+		cur = wb->len;
 		if (li->type != JSON_DICT_VALUE) {
 			ovis_log(mylog, OVIS_LERROR,
 					PNAME ": LIST %s has innards that are not "
 					"a DICT type %s. skipping this data.\n",
 					dataline->listkey,
 					json_type_name(li->type));
-			/* no output */
-			jbuf_free(jbs);
+			/* no further output */
+			wb->len = cur;
 			return -1;
 		}
-
-		/* each dict will be its own line */
-		jb = jbuf_new();
-		jb = jbuf_append_str(jb, "%s", jbs->buf);
+		if (cur != start) {
+			/* repeat the singletons of the first line */
+			if (_wbuf_reserve(wb, prefix_len)) {
+				rc = ENOMEM;
+				goto err;
+			}
+			memcpy(wb->data + wb->len, wb->data + start, prefix_len);
+			wb->len += prefix_len;
+		}
+		_match_keys(li, dataline->ndict, dataline->dictkey,
+			    dataline->dictval, NULL, NULL);
 		for (i = 0; i < dataline->ndict; i++) {
-			json_entity_t edict = json_value_find(li, dataline->dictkey[i]);
+			json_entity_t edict = dataline->dictval[i];
 			if (edict == NULL) {
 				ovis_log(mylog, OVIS_LDEBUG,
 						PNAME ": NULL return from find for "
 						"key <%s>\n", dataline->dictkey[i]);
 				/* print nothing */
 			} else {
-				rc = _append_singleton(edict, jb);
+				rc = _append_singleton(edict, wb);
 				if (rc) {
 					ovis_log(mylog, OVIS_LDEBUG,
 						PNAME ": Cannot print data because "
 						"of a variable print problem\n");
-					jbuf_free(jbs);
-					jbuf_free(jb);
-					return rc;
+					goto err;
 				}
 			}
 			if (i < (dataline->ndict - 1)) {
-				jb = jbuf_append_str(jb, ",");
+				_wb_putc(wb, ',');
 			}
 		}
-#ifdef TIMESTAMP_STORE
-		rc = fprintf(stream_handle->file, "%s,%f\n", jb->buf,
-			(tv_prev->tv_sec + tv_prev->tv_usec/1000000.0));
-#else
-		rc = fprintf(stream_handle->file, "%s\n", jb->buf);
-#endif
-		jbuf_free(jb);
-		stream_handle->byte_count += rc;
-		 /* stream_cb has the lock, so roll cannot be called while this is going on. */
-		stream_handle->store_count++;
+		rc = _end_line(stream_handle, wb, cur, tv_prev);
+		if (rc)
+			goto err;
 	}
-	jbuf_free(jbs);
 
 out:
 #ifdef STREAM_CSV_DIAGNOSTICS
@@ -739,6 +1139,10 @@ out:
 						stream_handle->store_count);
 #endif
 	return 0;
+err:
+	/* lines already ended stay; drop the partial one */
+	wb->len = cur;
+	return rc;
 }
 
 static void _roll_innards(struct csv_stream_handle *stream_handle);
@@ -824,24 +1228,21 @@ static int stream_cb(ldmsd_stream_client_t c, void *ctxt,
 
 	if (stream_type == LDMSD_STREAM_STRING) {
 		/* note that the string might have a newline as part of it */
-#ifdef TIMESTAMP_STORE
-		rc = fprintf(stream_handle->file, "%s,%f\n",
-				msg,
-				tv_prev.tv_sec + tv_prev.tv_usec/1000000.0);
-#else
-		rc = fprintf(stream_handle->file, "%s\n", msg);
-#endif
-		stream_handle->byte_count += rc;
-		stream_handle->store_count++;
-
-		if (!buffer) {
-			/*
-			 * stream_cb has the lock, so roll cannot be called while
-			 * this is going on.
-			 */
-			fflush(stream_handle->file);
-			fsync(fileno(stream_handle->file));
+		struct wbuf *wb = _stream_wbuf(stream_handle);
+		size_t start;
+		if (!wb) {
+			rc = ENOMEM;
+			goto out;
+		}
+		start = wb->len;
+		rc = _wb_putsn(wb, msg, strlen(msg));
+		if (!rc)
+			rc = _end_line(stream_handle, wb, start, &tv_prev);
+		if (rc) {
+			wb->len = start;
+			goto out;
 		}
+		_stream_flush_check(stream_handle);
 	} else if (stream_type == LDMSD_STREAM_JSON) {
 		if (!e) {
 			ovis_log(mylog, OVIS_LERROR, "Why is entity NULL?\n");
@@ -871,11 +1272,7 @@ static int stream_cb(ldmsd_stream_client_t c, void *ctxt,
 		}
 
 		_print_data_lines(stream_handle, &tv_prev, e);
-
-		if (!buffer) {
-			fflush(stream_handle->file);
-			fsync(fileno(stream_handle->file));
-		}
+		_stream_flush_check(stream_handle);
 	} else {
 		ovis_log(mylog, OVIS_LERROR, PNAME ": unknown stream type\n");
 		rc = EINVAL;
@@ -1007,8 +1404,7 @@ static void _roll_innards(struct csv_stream_handle *stream_handle)
 		return;
 
 	if (stream_handle->file) { /* this should always be true */
-		fflush(stream_handle->file);
-		fsync(fileno(stream_handle->file));
+		_stream_submit(stream_handle, WREQ_F_SYNC | WREQ_F_WAIT);
 	}
 
 	pathlen = strlen(stream_handle->basename) + 12;
@@ -1112,8 +1508,7 @@ static void flush_cb(void *obj, void *cb_arg)
 					"(curr %ld last %ld)\n",
 					stream_handle->stream, timex,
 					stream_handle->tlastrcv.tv_sec);
-			fflush(stream_handle->file);
-			fsync(fileno(stream_handle->file));
+			_stream_submit(stream_handle, WREQ_F_SYNC);
 		}
 	}
 
@@ -1320,6 +1715,12 @@ static int config(ldmsd_plug_handle_t handle, struct attr_value_list *kwl,
 
 	cfgstate = CFG_BASIC;
 
+	rc = _writer_start();
+	if (rc) {
+		ovis_log(mylog, OVIS_LERROR, PNAME ": writer thread create error: %d\n", rc);
+		goto out;
+	}
+
 	templist = strdup(streamlist);
 	if (!templist) {
 		rc = ENOMEM;
@@ -1477,6 +1878,7 @@ static void destructor(ldmsd_plug_handle_t handle)
 		idx_destroy(stream_idx);
 		stream_idx = NULL;
 	}
+	_writer_stop();
 
 	free(root_path);
 	root_path = NULL;
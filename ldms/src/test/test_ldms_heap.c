@@ -0,0 +1,154 @@
+/* -*- c-basic-offset: 8 -*-
+ * Copyright (c) 2026 National Technology & Engineering Solutions
+ * of Sandia, LLC (NTESS). Under the terms of Contract DE-NA0003525 with
+ * NTESS, the U.S. Government retains certain rights in this software.
+ * Copyright (c) 2026 Open Grid Computing, Inc. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the BSD-type
+ * license below:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *      Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *      Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ *      Neither the name of Sandia nor the names of any contributors may
+ *      be used to endorse or promote products derived from this software
+ *      without specific prior written permission.
+ *
+ *      Neither the name of Open Grid Computing nor the names of any
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ *      Modified source versions must be plainly marked as such, and
+ *      must not be misrepresented as being the original software.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* A program to test the size-class free lists of the LDMS heap. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "ldms.h"
+#include "ldms_heap.h"
+
+#define HEAP_SZ (64 * 1024)
+#define N_ITEMS 256
+
+static int err;
+
+#define CHECK(cond, ...) do { \
+	if (!(cond)) { \
+		err++; \
+		printf("error: " __VA_ARGS__); \
+	} \
+} while (0)
+
+static void info_print(const char *label, ldms_heap_t h)
+{
+	struct ldms_heap_info i;
+	ldms_heap_get_info(h, &i);
+	printf("%s: size %zu free_chunks %zu free_grains %zu largest %zu "
+	       "slab_chunks %zu slab_grains %zu fragmentation %zu%%\n",
+	       label, i.size, i.free_chunks, i.free_bytes, i.largest,
+	       i.slab_free_chunks, i.slab_free_grains, i.fragmentation);
+}
+
+int main(int argc, char **argv)
+{
+	struct ldms_heap heap;
+	struct ldms_heap_instance inst;
+	struct ldms_heap_info info;
+	ldms_heap_t h;
+	void *base, *p, *big;
+	void *items[N_ITEMS];
+	int i;
+
+	base = calloc(1, 4 * HEAP_SZ);
+	if (!base)
+		return ENOMEM;
+
+	/* A heap below LDMS_HEAP_SLAB_MIN_SIZE has no size classes */
+	ldms_heap_init(&heap, base, 8 * 1024, 32);
+	h = ldms_heap_get(&inst, &heap, base);
+	ldms_heap_get_info(h, &info);
+	CHECK(heap.slab == 0, "small heap has size classes\n");
+	CHECK(info.free_chunks == 1, "small heap is not one free chunk\n");
+
+	/* Growing it past LDMS_HEAP_SLAB_MIN_SIZE adds them */
+	CHECK(0 == ldms_heap_grow(h, HEAP_SZ), "ldms_heap_grow failed\n");
+	CHECK(heap.slab != 0, "grown heap has no size classes\n");
+	info_print("grown", h);
+
+	ldms_heap_init(&heap, base, HEAP_SZ, 32);
+	h = ldms_heap_get(&inst, &heap, base);
+	CHECK(heap.slab != 0, "heap has no size classes\n");
+
+	/* Freed small chunks are reused without touching the trees */
+	for (i = 0; i < N_ITEMS; i++) {
+		items[i] = ldms_heap_alloc(h, 40);
+		CHECK(items[i] != NULL, "alloc %d failed\n", i);
+	}
+	info_print("allocated", h);
+	for (i = 0; i < N_ITEMS; i++)
+		ldms_heap_free(h, items[i]);
+	ldms_heap_get_info(h, &info);
+	info_print("freed", h);
+	CHECK(info.slab_free_chunks >= N_ITEMS,
+	      "%zu chunks in the size classes, expecting %d\n",
+	      info.slab_free_chunks, N_ITEMS);
+	for (i = 0; i < N_ITEMS; i++) {
+		p = ldms_heap_alloc(h, 40);
+		CHECK(p != NULL, "re-alloc %d failed\n", i);
+		items[i] = p;
+	}
+	for (i = 0; i < N_ITEMS; i++)
+		ldms_heap_free(h, items[i]);
+
+	/*
+	 * A large allocation that does not fit in the trees returns the
+	 * size classes to the trees and coalesces them.
+	 */
+	big = ldms_heap_alloc(h, HEAP_SZ - 4096);
+	CHECK(big != NULL, "large alloc failed\n");
+	info_print("large", h);
+	ldms_heap_free(h, big);
+	ldms_heap_get_info(h, &info);
+	info_print("drained", h);
+	CHECK(info.slab_free_chunks == 0, "size classes not drained\n");
+	CHECK(info.free_chunks == 1, "%zu free chunks after drain\n",
+	      info.free_chunks);
+	CHECK(info.fragmentation == 0, "fragmentation %zu%% after drain\n",
+	      info.fragmentation);
+
+	free(base);
+	if (err)
+		printf("%d errors\n", err);
+	else
+		printf("no errors\n");
+	return err;
+}
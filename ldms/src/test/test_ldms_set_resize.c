@@ -0,0 +1,309 @@
+/* -*- c-basic-offset: 8 -*-
+ * Copyright (c) 2026 National Technology & Engineering Solutions
+ * of Sandia, LLC (NTESS). Under the terms of Contract DE-NA0003525 with
+ * NTESS, the U.S. Government retains certain rights in this software.
+ * Copyright (c) 2026 Open Grid Computing, Inc. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the BSD-type
+ * license below:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *      Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *      Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ *      Neither the name of Sandia nor the names of any contributors may
+ *      be used to endorse or promote products derived from this software
+ *      without specific prior written permission.
+ *
+ *      Neither the name of Open Grid Computing nor the names of any
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ *      Modified source versions must be plainly marked as such, and
+ *      must not be misrepresented as being the original software.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * A program to test ldms_set_heap_grow() on a set that a peer has looked
+ * up: the mirror must follow the resize and the producer must release the
+ * old set memory once the mirror has switched over.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <semaphore.h>
+#include <time.h>
+#include <sys/wait.h>
+#include "ldms.h"
+#include "ldms_xprt.h"
+#include "ldms_private.h"
+
+#define SET_NAME "test_ldms_set_resize/0"
+#define HEAP_SZ 512
+#define N_ITEMS 1024
+#define TIMEOUT 10
+
+static int err;
+static sem_t conn_sem, lookup_sem, update_sem;
+static ldms_set_t mirror;
+
+#define CHECK(cond, ...) do { \
+	if (!(cond)) { \
+		err++; \
+		printf("error: " __VA_ARGS__); \
+	} \
+} while (0)
+
+static int sem_wait_timeout(sem_t *sem)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += TIMEOUT;
+	return sem_timedwait(sem, &ts);
+}
+
+static void conn_cb(ldms_t x, ldms_xprt_event_t e, void *arg)
+{
+	if (e->type == LDMS_XPRT_EVENT_CONNECTED ||
+	    e->type == LDMS_XPRT_EVENT_ERROR ||
+	    e->type == LDMS_XPRT_EVENT_REJECTED)
+		sem_post(&conn_sem);
+}
+
+static void lookup_cb(ldms_t x, enum ldms_lookup_status status, int more,
+		      ldms_set_t s, void *arg)
+{
+	if (!status)
+		mirror = s;
+	sem_post(&lookup_sem);
+}
+
+static void update_cb(ldms_t x, ldms_set_t s, int flags, void *arg)
+{
+	if (!(flags & LDMS_UPD_F_MORE))
+		sem_post(&update_sem);
+}
+
+static int update(void)
+{
+	if (ldms_xprt_update(mirror, update_cb, NULL))
+		return -1;
+	return sem_wait_timeout(&update_sem);
+}
+
+/* Append the items \c from to \c to - 1; return the first one not added */
+static int append(ldms_set_t set, int from, int to)
+{
+	ldms_mval_t lh, v;
+	int i;
+
+	lh = ldms_metric_get(set, 0);
+	ldms_transaction_begin(set);
+	for (i = from; i < to; i++) {
+		v = ldms_list_append_item(set, lh, LDMS_V_U64, 1);
+		if (!v)
+			break;
+		v->v_u64 = i;
+	}
+	ldms_transaction_end(set);
+	return i;
+}
+
+/* Return the number of items in order at the head of the mirror list */
+static int mirror_items(void)
+{
+	ldms_mval_t lh, v;
+	enum ldms_value_type typ;
+	size_t count;
+	int i = 0;
+
+	lh = ldms_metric_get(mirror, 0);
+	for (v = ldms_list_first(mirror, lh, &typ, &count); v;
+	     v = ldms_list_next(mirror, v, &typ, &count)) {
+		if (typ != LDMS_V_U64 || v->v_u64 != i)
+			break;
+		i++;
+	}
+	return i;
+}
+
+static int retired_count(struct ldms_set *set)
+{
+	struct ldms_set_retired *ret;
+	int n = 0;
+	pthread_mutex_lock(&set->lock);
+	LIST_FOREACH(ret, &set->retired, entry)
+		n++;
+	pthread_mutex_unlock(&set->lock);
+	return n;
+}
+
+/*
+ * The producer runs in a child process because a process cannot hold a
+ * set and its mirror under the same name. The parent drives it through
+ * a pair of pipes, one command byte at a time.
+ */
+static int producer(int rfd, int wfd)
+{
+	ldms_schema_t schema;
+	ldms_set_t set;
+	ldms_t lx;
+	char port[16], cmd;
+	int i, n, rc;
+
+	ldms_init(16 * 1024 * 1024);
+	schema = ldms_schema_new("test_ldms_set_resize");
+	if (!schema)
+		return ENOMEM;
+	ldms_schema_metric_list_add(schema, "list", NULL, HEAP_SZ);
+	set = ldms_set_new(SET_NAME, schema);
+	if (!set)
+		return ENOMEM;
+	n = append(set, 0, N_ITEMS);
+	CHECK(n < N_ITEMS, "%d items fit in a %d byte heap\n", n, HEAP_SZ);
+	ldms_set_publish(set);
+
+	lx = ldms_xprt_new_with_auth("sock", "none", NULL);
+	if (!lx) {
+		write(wfd, "", 1);
+		return 0;
+	}
+	for (i = 0; i < 100; i++) {
+		snprintf(port, sizeof(port), "%d", 20000 + (getpid() + i) % 20000);
+		rc = ldms_xprt_listen_by_name(lx, "localhost", port, NULL, NULL);
+		if (!rc)
+			break;
+	}
+	if (rc) {
+		printf("error: cannot listen, %d\n", rc);
+		return rc;
+	}
+	write(wfd, port, sizeof(port));
+	write(wfd, &n, sizeof(n));
+
+	/* 'g': grow the heap until all the items fit */
+	if (read(rfd, &cmd, 1) != 1 || cmd != 'g')
+		return EINVAL;
+	while (n < N_ITEMS) {
+		rc = ldms_set_heap_grow(set, 2 * ldms_set_heap_size_get(set));
+		if (rc) {
+			printf("error: ldms_set_heap_grow failed, %d\n", rc);
+			return rc;
+		}
+		n = append(set, n, N_ITEMS);
+	}
+	printf("producer heap %" PRIu64 " bytes, %d retired\n",
+	       ldms_set_heap_size_get(set), retired_count(set));
+	write(wfd, &n, sizeof(n));
+
+	/* 'r': the old memory is released once the mirror acknowledges */
+	if (read(rfd, &cmd, 1) != 1 || cmd != 'r')
+		return EINVAL;
+	for (i = 0; i < TIMEOUT * 10 && retired_count(set); i++)
+		usleep(100000);
+	CHECK(0 == retired_count(set), "%d retired regions not released\n",
+	      retired_count(set));
+	return err;
+}
+
+int main(int argc, char **argv)
+{
+	int to_prdcr[2], from_prdcr[2];
+	char port[16];
+	ldms_t cx;
+	pid_t pid;
+	int i, n, status, rc;
+
+	if (pipe(to_prdcr) || pipe(from_prdcr))
+		return errno;
+	setlinebuf(stdout);
+	pid = fork();
+	if (pid < 0)
+		return errno;
+	if (!pid)
+		exit(producer(to_prdcr[0], from_prdcr[1]));
+
+	if (read(from_prdcr[0], port, sizeof(port)) != sizeof(port)) {
+		printf("1..0 # SKIP the sock transport is not available\n");
+		waitpid(pid, &status, 0);
+		return 0;
+	}
+	if (read(from_prdcr[0], &n, sizeof(n)) != sizeof(n))
+		return EIO;
+
+	ldms_init(16 * 1024 * 1024);
+	sem_init(&conn_sem, 0, 0);
+	sem_init(&lookup_sem, 0, 0);
+	sem_init(&update_sem, 0, 0);
+	cx = ldms_xprt_new_with_auth("sock", "none", NULL);
+	rc = ldms_xprt_connect_by_name(cx, "localhost", port, conn_cb, NULL);
+	if (rc || sem_wait_timeout(&conn_sem) || !ldms_xprt_connected(cx)) {
+		printf("error: cannot connect to port %s\n", port);
+		err++;
+		goto out;
+	}
+	rc = ldms_xprt_lookup(cx, SET_NAME, LDMS_LOOKUP_BY_INSTANCE,
+			      lookup_cb, NULL);
+	if (rc || sem_wait_timeout(&lookup_sem) || !mirror) {
+		printf("error: lookup of %s failed\n", SET_NAME);
+		err++;
+		goto out;
+	}
+	CHECK(0 == update(), "update before the resize failed\n");
+	CHECK(mirror_items() == n, "mirror has %d items, expecting %d\n",
+	      mirror_items(), n);
+
+	write(to_prdcr[1], "g", 1);
+	if (read(from_prdcr[0], &n, sizeof(n)) != sizeof(n)) {
+		err++;
+		goto out;
+	}
+
+	/* The mirror switches to the new memory on an update after RESIZE */
+	for (i = 0; i < TIMEOUT * 10 && mirror_items() != n; i++) {
+		CHECK(0 == update(), "update after the resize failed\n");
+		usleep(100000);
+	}
+	CHECK(mirror_items() == n, "mirror has %d items, expecting %d\n",
+	      mirror_items(), n);
+	printf("mirror heap %" PRIu64 " bytes, %d items\n",
+	       ldms_set_heap_size_get(mirror), mirror_items());
+ out:
+	write(to_prdcr[1], "r", 1);
+	waitpid(pid, &status, 0);
+	if (!WIFEXITED(status) || WEXITSTATUS(status))
+		err++;
+	if (err)
+		printf("%d errors\n", err);
+	else
+		printf("no errors\n");
+	return err;
+}
@@ -0,0 +1,144 @@
+#!/bin/bash
+#
+# Measure the failover takeover time on localhost.
+#
+# NSAMP sampler daemons are split between agg1 and agg2, which form a
+# failover pair. Once agg2 has received agg1's config, one more sampler is
+# added to agg1 in-band (replicated to agg2 as a delta), agg1 is killed and
+# the time until agg2 serves the sets of all samplers is reported.
+#
+# usage: [NSAMP=N] [STANDBY=0|1] [INTERVAL=USEC] [VERBOSE=LEVEL] ./takeover.sh
+#
+# Run it with STANDBY=0 and STANDBY=1 to compare the cold takeover (agg2
+# connects to agg1's samplers at failover) with the warm standby (agg2
+# only starts the updaters at failover).
+
+NSAMP=${NSAMP:-16}
+STANDBY=${STANDBY:-0}
+INTERVAL=${INTERVAL:-1000000}
+SAMP_PORT=${SAMP_PORT:-10100}
+AGG1_PORT=${AGG1_PORT:-11001}
+AGG2_PORT=${AGG2_PORT:-11002}
+DIR=${DIR:-$(mktemp -d /tmp/failover-takeover.XXXXXX)}
+VERBOSE=${VERBOSE:-ERROR}
+
+export ZAP_EVENT_WORKERS=${ZAP_EVENT_WORKERS:-1}
+
+PIDS=()
+
+cleanup() {
+	for P in ${PIDS[@]}; do
+		kill $P 2>/dev/null
+	done
+	wait 2>/dev/null
+}
+trap cleanup EXIT
+
+now() { # msec
+	echo $(( $(date +%s%N) / 1000000 ))
+}
+
+nsets() {
+	ldms_ls -x sock -h localhost -p $1 2>/dev/null | grep -c /meminfo
+}
+
+mkdir -p $DIR/cfg $DIR/log
+
+# samp$NSAMP is added to agg1 in-band after the pair is configured
+for ((I=0; I<=NSAMP; I++)); do
+	cat > $DIR/cfg/samp$I <<EOF
+load name=meminfo
+config name=meminfo instance=samp$I/meminfo producer=samp$I
+start name=meminfo interval=$INTERVAL offset=0
+EOF
+	ldmsd -x sock:$((SAMP_PORT+I)) -c $DIR/cfg/samp$I -n samp$I \
+		-v ERROR > $DIR/log/samp$I 2>&1 &
+	PIDS+=($!)
+done
+
+# agg1 gets the even samplers, agg2 the odd ones
+for A in 1 2; do
+	PORT=$((A == 1 ? AGG1_PORT : AGG2_PORT))
+	PEER=$((A == 1 ? 2 : 1))
+	PEER_PORT=$((A == 1 ? AGG2_PORT : AGG1_PORT))
+	CFG=$DIR/cfg/agg$A
+	: > $CFG
+	for ((I=A-1; I<NSAMP; I+=2)); do
+		cat >> $CFG <<EOF
+prdcr_add name=samp$I host=localhost xprt=sock port=$((SAMP_PORT+I)) \
+	  type=active interval=$INTERVAL
+EOF
+	done
+	cat >> $CFG <<EOF
+prdcr_start_regex regex=.*
+updtr_add name=updtr interval=$INTERVAL offset=$((INTERVAL/2))
+updtr_prdcr_add name=updtr regex=.*
+updtr_start name=updtr
+failover_config host=localhost port=$PEER_PORT xprt=sock \
+		interval=$INTERVAL peer_name=agg$PEER standby=$STANDBY
+failover_start
+EOF
+	ldmsd -x sock:$PORT -c $CFG -n agg$A -v $VERBOSE \
+		> $DIR/log/agg$A 2>&1 &
+	PIDS+=($!)
+	eval AGG${A}_PID=$!
+done
+
+echo "waiting for the failover pair to be configured ..."
+for ((T=0; T<120; T++)); do
+	ST=$(echo failover_status | ldmsctl -x sock -h localhost \
+		-p $AGG2_PORT 2>/dev/null)
+	if echo "$ST" | grep -q 'conn_state: CONFIGURED' &&
+	   [[ $(nsets $AGG1_PORT) -eq $(( (NSAMP+1)/2 )) ]] &&
+	   [[ $(nsets $AGG2_PORT) -eq $(( NSAMP/2 )) ]]; then
+		break
+	fi
+	sleep 1
+done
+if ((T == 120)); then
+	echo "failover pair not configured, see $DIR/log"
+	exit 1
+fi
+
+ctl() { # port cmd
+	echo "$2" | ldmsctl -x sock -h localhost -p $1 2>&1
+}
+
+# the objects replicated from agg1 are not agg2's to alter
+if ! ctl $AGG2_PORT "prdcr_stop name=#samp0" | grep -q "reserved"; then
+	echo "agg2 did not refuse to stop the replicated #samp0"
+	exit 1
+fi
+
+ctl $AGG1_PORT "prdcr_add name=samp$NSAMP host=localhost xprt=sock \
+	port=$((SAMP_PORT+NSAMP)) type=active interval=$INTERVAL" > /dev/null
+ctl $AGG1_PORT "prdcr_start name=samp$NSAMP" > /dev/null
+# the updater resolves its producers at updtr_prdcr_add
+ctl $AGG1_PORT "updtr_stop name=updtr" > /dev/null
+ctl $AGG1_PORT "updtr_prdcr_add name=updtr regex=samp$NSAMP" > /dev/null
+ctl $AGG1_PORT "updtr_start name=updtr" > /dev/null
+for ((T=0; T<60; T++)); do
+	[[ $(nsets $AGG1_PORT) -eq $(( (NSAMP+1)/2 + 1 )) ]] &&
+	ctl $AGG2_PORT "prdcr_status" | grep -q "#samp$NSAMP" && break
+	sleep 1
+done
+if ((T == 60)); then
+	echo "samp$NSAMP was not replicated to agg2, see $DIR/log"
+	exit 1
+fi
+# let the standby connections settle
+sleep 2
+
+T0=$(now)
+kill $AGG1_PID
+while [[ $(nsets $AGG2_PORT) -le $NSAMP ]]; do
+	sleep 0.05
+	if (( $(now) - T0 > 120000 )); then
+		echo "agg2 did not take over, see $DIR/log"
+		exit 1
+	fi
+done
+T1=$(now)
+
+printf "samplers: %d, standby: %d, takeover: %d.%03d sec\n" \
+	$((NSAMP+1)) $STANDBY $(( (T1-T0) / 1000 )) $(( (T1-T0) % 1000 ))
@@ -65,6 +65,8 @@
 
 #define FNV_32_PRIME 0x01000193
 #define FNV_64_PRIME 0x100000001b3ULL
+#define FNV_32_OFFSET_BASIS 0x811c9dc5
+#define FNV_64_OFFSET_BASIS 0xcbf29ce484222325ULL
 
 /**
  * \brief An implementation of FNV-A1 hash algorithm, 32-bit hash value.
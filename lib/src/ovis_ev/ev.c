@@ -29,6 +29,7 @@ ev_type_t ev_type_new(const char *name, size_t size)
 	if (!evt->t_name)
 		goto err_1;
 	evt->t_size = size;
+	pthread_mutex_init(&evt->t_free_lock, NULL);
 	evt->t_id = __sync_fetch_and_add(&next_type_id, 1);
 
 	pthread_mutex_lock(&type_lock);
@@ -81,11 +82,140 @@ const char *ev_type_name(ev_type_t t)
 	return t->t_name;
 }
 
-ev_t ev_new(ev_type_t evt)
+/*
+ * Each thread keeps a few recycled events of each type so that ev_new() and
+ * ev_put() do not contend with the other workers. Events allocated by one
+ * thread and put by another travel through the type freelist in batches.
+ */
+struct ev_cache_s {
+	struct ev__s *head;
+	int len;
+};
+
+static __thread struct ev_cache_s ev_cache[EV_CACHE_TYPES];
+static __thread int ev_cache_registered;
+static pthread_key_t ev_cache_key;
+static pthread_once_t ev_cache_once = PTHREAD_ONCE_INIT;
+
+/* Return up to n events of the cache to the type freelist */
+static void ev_cache_drain(struct ev_cache_s *c, int n)
 {
-	ev__t e = malloc(sizeof(*e) + evt->t_size);
-	if (!e)
+	ev__t head, tail, e;
+	ev_type_t evt;
+	int i, room;
+
+	head = tail = c->head;
+	if (!head)
+		return;
+	evt = head->e_type;
+	for (i = 1; i < n && tail->e_next; i++)
+		tail = tail->e_next;
+	c->head = tail->e_next;
+	c->len -= i;
+	tail->e_next = NULL;
+
+	pthread_mutex_lock(&evt->t_free_lock);
+	room = EV_FREELIST_MAX - evt->t_free_len;
+	if (room >= i) {
+		tail->e_next = evt->t_free;
+		evt->t_free = head;
+		evt->t_free_len += i;
+		head = NULL;
+	} else {
+		while (room-- > 0) {
+			e = head;
+			head = e->e_next;
+			e->e_next = evt->t_free;
+			evt->t_free = e;
+			evt->t_free_len++;
+		}
+	}
+	pthread_mutex_unlock(&evt->t_free_lock);
+	while (head) {
+		e = head;
+		head = e->e_next;
+		free(e);
+	}
+}
+
+/* Take up to EV_CACHE_BATCH events from the type freelist */
+static void ev_cache_refill(ev_type_t evt, struct ev_cache_s *c)
+{
+	ev__t head, tail;
+	int i;
+
+	pthread_mutex_lock(&evt->t_free_lock);
+	head = tail = evt->t_free;
+	if (!head)
+		goto out;
+	for (i = 1; i < EV_CACHE_BATCH && tail->e_next; i++)
+		tail = tail->e_next;
+	evt->t_free = tail->e_next;
+	evt->t_free_len -= i;
+	tail->e_next = c->head;
+	c->head = head;
+	c->len += i;
+ out:
+	pthread_mutex_unlock(&evt->t_free_lock);
+}
+
+/* thread exit: give the cached events back to the freelists */
+static void ev_cache_release(void *arg)
+{
+	struct ev_cache_s *cache = arg;
+	int i;
+
+	for (i = 0; i < EV_CACHE_TYPES; i++) {
+		while (cache[i].head)
+			ev_cache_drain(&cache[i], EV_CACHE_BATCH);
+	}
+}
+
+static void ev_cache_key_init(void)
+{
+	pthread_key_create(&ev_cache_key, ev_cache_release);
+}
+
+static struct ev_cache_s *ev_cache_get(ev_type_t evt)
+{
+	if (evt->t_id >= EV_CACHE_TYPES)
 		return NULL;
+	if (!ev_cache_registered) {
+		pthread_once(&ev_cache_once, ev_cache_key_init);
+		pthread_setspecific(ev_cache_key, ev_cache);
+		ev_cache_registered = 1;
+	}
+	return &ev_cache[evt->t_id];
+}
+
+ev_t ev_new(ev_type_t evt)
+{
+	struct ev_cache_s *c;
+	ev__t e;
+
+	c = ev_cache_get(evt);
+	if (c) {
+		if (!c->head)
+			ev_cache_refill(evt, c);
+		e = c->head;
+		if (e) {
+			c->head = e->e_next;
+			c->len--;
+		}
+	} else {
+		pthread_mutex_lock(&evt->t_free_lock);
+		e = evt->t_free;
+		if (e) {
+			evt->t_free = e->e_next;
+			evt->t_free_len--;
+		}
+		pthread_mutex_unlock(&evt->t_free_lock);
+	}
+	if (!e) {
+		e = malloc(sizeof(*e) + evt->t_size);
+		if (!e)
+			return NULL;
+	}
 
 	e->e_refcount = 1;
 	e->e_type = evt;
@@ -97,8 +227,27 @@ ev_t ev_new(ev_type_t evt)
 void ev_put(ev_t ev)
 {
 	ev__t e = EV(ev);
+	ev_type_t evt;
+	struct ev_cache_s *c;
 	assert(e->e_refcount);
 	if (0 == __sync_sub_and_fetch(&e->e_refcount, 1)) {
+		evt = e->e_type;
+		c = ev_cache_get(evt);
+		if (c) {
+			e->e_next = c->head;
+			c->head = e;
+			if (++c->len >= 2 * EV_CACHE_BATCH)
+				ev_cache_drain(c, EV_CACHE_BATCH);
+			return;
+		}
+		pthread_mutex_lock(&evt->t_free_lock);
+		if (evt->t_free_len < EV_FREELIST_MAX) {
+			e->e_next = evt->t_free;
+			evt->t_free = e;
+			evt->t_free_len++;
+			e = NULL;
+		}
+		pthread_mutex_unlock(&evt->t_free_lock);
 		free(e);
 	}
 }
@@ -146,21 +295,28 @@ int ev_post(ev_worker_t src, ev_worker_t dst, ev_t ev, struct timespec *to)
 	e->e_dst = dst;
 	rbn_init(&e->e_to_rbn, &e->e_to);
 
+	if (!to) {
+		/* Immediate events never take the worker lock */
+		if (__atomic_load_n(&dst->w_state, __ATOMIC_ACQUIRE) == EV_WORKER_FLUSHING) {
+			e->e_posted = 0;
+			return EBUSY;
+		}
+		ev_get(&e->e_ev);
+		__sync_fetch_and_add(&dst->w_ev_list_len, 1);
+		__ev_q_push(dst, e);
+		__ev_worker_wake(dst);
+		return 0;
+	}
+
 	pthread_mutex_lock(&dst->w_lock);
 	if (dst->w_state == EV_WORKER_FLUSHING)
 		goto err;
 	ev_get(&e->e_ev);
-	if (to) {
-		rbt_ins(&dst->w_event_tree, &e->e_to_rbn);
-	} else {
-		__sync_fetch_and_add(&dst->w_ev_list_len, 1);
-		TAILQ_INSERT_TAIL(&dst->w_event_list, e, e_entry);
-
-	}
+	rbt_ins(&dst->w_event_tree, &e->e_to_rbn);
 	rc = (ev_time_cmp(&e->e_to, &dst->w_sem_wait) <= 0);
 	pthread_mutex_unlock(&dst->w_lock);
 	if (rc)
-		sem_post(&dst->w_sem);
+		__ev_worker_wake(dst);
 
 	return 0;
  err:
@@ -197,11 +353,11 @@ int ev_cancel(ev_t ev)
 
 	rbt_del(&e->e_dst->w_event_tree, &e->e_to_rbn);
 	__sync_fetch_and_add(&e->e_dst->w_ev_list_len, 1);
-	TAILQ_INSERT_TAIL(&e->e_dst->w_event_list, e, e_entry);
+	__ev_q_push(e->e_dst, e);
  out:
 	pthread_mutex_unlock(&e->e_dst->w_lock);
 	if (!rc)
-		sem_post(&e->e_dst->w_sem);
+		__ev_worker_wake(e->e_dst);
 	return rc;
 }
 
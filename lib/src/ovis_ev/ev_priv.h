@@ -2,16 +2,29 @@
 #define __EV_PRIV_H_
 
 #include <sys/queue.h>
-#include <semaphore.h>
+#include <pthread.h>
+#include <unistd.h>
 #include <inttypes.h>
 #include <coll/rbt.h>
 #include "ev.h"
 
+/* Upper bound on the number of recycled events kept per type */
+#define EV_FREELIST_MAX 1024
+/* Types (by id) that have a per-thread cache of recycled events */
+#define EV_CACHE_TYPES 32
+/* Events moved between a thread cache and the type freelist at once */
+#define EV_CACHE_BATCH 32
+
 struct ev_type_s {
 	char *t_name;
 	uint64_t t_id;
 	struct rbn t_rbn;
 	size_t t_size;
+	/* Recycled events of this type shared by all threads; the threads
+	 * take and return them in batches, see ev_new() and ev_put() */
+	pthread_mutex_t t_free_lock;
+	struct ev__s *t_free;
+	int t_free_len;
 };
 
 typedef struct ev__s {
@@ -23,7 +36,7 @@ typedef struct ev__s {
 	ev_status_t e_status;
 	struct timespec e_to;
 	struct rbn e_to_rbn;
-	TAILQ_ENTRY(ev__s) e_entry;
+	struct ev__s *e_next;	/* immediate queue or type freelist link */
 	struct ev_s e_ev;
 } *ev__t;
 
@@ -39,18 +52,50 @@ struct ev_worker_s {
 	pthread_t w_thread;
 	enum evw_state_e w_state;
 	struct timespec w_sem_wait;
-	sem_t w_sem;
 	struct rbn w_rbn;
+	/* Protects w_event_tree, w_sem_wait and w_state transitions */
 	pthread_mutex_t w_lock;
 	ev_actor_t *w_dispatch;
 	size_t w_dispatch_len;
 	/* An ordered tree of events with timeouts */
 	struct rbt w_event_tree;
-	/* A list of events without timeouts */
-	TAILQ_HEAD(w_event_list, ev__s) w_event_list;
+	/*
+	 * Events without timeouts are kept in an intrusive multi-producer
+	 * single-consumer queue. Producers only swap w_q_tail, the worker
+	 * thread is the only one touching w_q_head.
+	 */
+	struct ev__s *w_q_tail;
+	struct ev__s *w_q_head;
+	struct ev__s w_q_stub;
 	int w_ev_list_len;
+	/*
+	 * The worker sets w_sleeping before it blocks on w_efd. Producers
+	 * write the eventfd only if they are the one that clears it, so a
+	 * burst of posts costs a single wakeup.
+	 */
+	int w_efd;
+	int w_sleeping;
 };
 
 #define EV(_e_) container_of(_e_, struct ev__s, e_ev);
+
+/* Append \c e to the immediate queue of \c w, may be called by any thread */
+static inline void __ev_q_push(ev_worker_t w, ev__t e)
+{
+	ev__t prev;
+	__atomic_store_n(&e->e_next, NULL, __ATOMIC_RELAXED);
+	prev = __atomic_exchange_n(&w->w_q_tail, e, __ATOMIC_SEQ_CST);
+	__atomic_store_n(&prev->e_next, e, __ATOMIC_RELEASE);
+}
+
+/* Wake the worker if it is blocked or about to block */
+static inline void __ev_worker_wake(ev_worker_t w)
+{
+	uint64_t one = 1;
+	if (__atomic_exchange_n(&w->w_sleeping, 0, __ATOMIC_SEQ_CST)) {
+		if (write(w->w_efd, &one, sizeof(one)) < 0)
+			return;
+	}
+}
 #endif
 
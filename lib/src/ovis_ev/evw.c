@@ -6,6 +6,8 @@
 #include <pthread.h>
 #include <time.h>
 #include <inttypes.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 #include <coll/rbt.h>
 #include "ev.h"
 #include "ev_priv.h"
@@ -44,36 +46,69 @@ int ev_time_cmp(struct timespec *tsa, const struct timespec *tsb)
 }
 
 /*
- * Process all of the events in the worker's event list.
+ * Remove the oldest event from the immediate queue. Only the worker
+ * thread calls this. Returns NULL if the queue is empty or if a
+ * producer is between its exchange and its link; in the latter case
+ * that producer wakes the worker once the link is visible.
+ */
+static ev__t __ev_q_pop(ev_worker_t w)
+{
+	ev__t head = w->w_q_head;
+	ev__t next = __atomic_load_n(&head->e_next, __ATOMIC_ACQUIRE);
+
+	if (head == &w->w_q_stub) {
+		if (!next)
+			return NULL;
+		w->w_q_head = next;
+		head = next;
+		next = __atomic_load_n(&next->e_next, __ATOMIC_ACQUIRE);
+	}
+	if (next) {
+		w->w_q_head = next;
+		return head;
+	}
+	if (head != __atomic_load_n(&w->w_q_tail, __ATOMIC_ACQUIRE))
+		return NULL;
+	__ev_q_push(w, &w->w_q_stub);
+	next = __atomic_load_n(&head->e_next, __ATOMIC_ACQUIRE);
+	if (next) {
+		w->w_q_head = next;
+		return head;
+	}
+	return NULL;
+}
+
+static int __ev_q_empty(ev_worker_t w)
+{
+	return w->w_q_head == &w->w_q_stub &&
+		NULL == __atomic_load_n(&w->w_q_stub.e_next, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * Process all of the events in the worker's immediate queue.
  *
- * Called with the worker lock held.
+ * Called without the worker lock held.
  */
 static void process_immediate_events(ev_worker_t w)
 {
 	ev__t e;
 	ev_actor_t actor;
- next:
-	if (TAILQ_EMPTY(&w->w_event_list))
-		return;
 
-	e = TAILQ_FIRST(&w->w_event_list);
-	TAILQ_REMOVE(&w->w_event_list, e, e_entry);
-	__sync_fetch_and_sub(&w->w_ev_list_len, 1);
-	e->e_posted = 0;
+	while ((e = __ev_q_pop(w))) {
+		__sync_fetch_and_sub(&w->w_ev_list_len, 1);
+		e->e_posted = 0;
 
-	if (w->w_state == EV_WORKER_FLUSHING)
-		e->e_status = EV_FLUSH;
+		if (__atomic_load_n(&w->w_state, __ATOMIC_ACQUIRE) == EV_WORKER_FLUSHING)
+			e->e_status = EV_FLUSH;
 
-	pthread_mutex_unlock(&w->w_lock);
-	actor = NULL;
-	if (e->e_type->t_id < w->w_dispatch_len)
-		actor = w->w_dispatch[e->e_type->t_id];
-	if (!actor)
-		actor = w->w_actor;
-	actor(e->e_src, e->e_dst, e->e_status, &e->e_ev);
-	ev_put(&e->e_ev);
-	pthread_mutex_lock(&w->w_lock);
-	goto next;
+		actor = NULL;
+		if (e->e_type->t_id < w->w_dispatch_len)
+			actor = w->w_dispatch[e->e_type->t_id];
+		if (!actor)
+			actor = w->w_actor;
+		actor(e->e_src, e->e_dst, e->e_status, &e->e_ev);
+		ev_put(&e->e_ev);
+	}
 }
 
 /*
@@ -127,16 +162,45 @@ void ev_sched_to(struct timespec *to, time_t secs, int nsecs)
 	to->tv_nsec += nsecs;
 }
 
+/*
+ * Block on the worker eventfd until a producer wakes us or the
+ * w_sem_wait deadline passes.
+ */
+static void worker_wait(ev_worker_t w)
+{
+	struct pollfd pfd = { .fd = w->w_efd, .events = POLLIN };
+	struct timespec now, rel;
+	uint64_t cnt;
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	rel.tv_sec = w->w_sem_wait.tv_sec - now.tv_sec;
+	rel.tv_nsec = w->w_sem_wait.tv_nsec - now.tv_nsec;
+	while (rel.tv_nsec < 0) {
+		rel.tv_sec -= 1;
+		rel.tv_nsec += 1000000000;
+	}
+	while (rel.tv_nsec >= 1000000000) {
+		rel.tv_sec += 1;
+		rel.tv_nsec -= 1000000000;
+	}
+	if (rel.tv_sec < 0) {
+		rel.tv_sec = 0;
+		rel.tv_nsec = 0;
+	}
+	if (ppoll(&pfd, 1, &rel, NULL) > 0) {
+		if (read(w->w_efd, &cnt, sizeof(cnt)) < 0)
+			cnt = 0;
+	}
+}
+
 static void *worker_proc(void *arg)
 {
 	ev__t e;
 	ev_worker_t w = arg;
 	w->w_state = EV_WORKER_RUNNING;
-	ev_sched_to(&w->w_sem_wait, 0, 0);
-	sem_timedwait(&w->w_sem, &w->w_sem_wait);
 	while (1) {
-		pthread_mutex_lock(&w->w_lock);
 		process_immediate_events(w);
+		pthread_mutex_lock(&w->w_lock);
 		e = process_to_events(w);
 		if (e) {
 			w->w_sem_wait = e->e_to;
@@ -145,8 +209,19 @@ static void *worker_proc(void *arg)
 		}
 		if (w->w_state == EV_WORKER_FLUSHING)
 			w->w_state = EV_WORKER_RUNNING;
+		/*
+		 * Announce that we are going to sleep before the final
+		 * check of the immediate queue. A producer that posts
+		 * after this point sees w_sleeping and writes the eventfd;
+		 * one that posted before it is seen by __ev_q_empty().
+		 */
+		__atomic_store_n(&w->w_sleeping, 1, __ATOMIC_SEQ_CST);
 		pthread_mutex_unlock(&w->w_lock);
-		sem_timedwait(&w->w_sem, &w->w_sem_wait);
+		if (!__ev_q_empty(w) &&
+		    __atomic_exchange_n(&w->w_sleeping, 0, __ATOMIC_SEQ_CST))
+			continue;
+		worker_wait(w);
+		__atomic_store_n(&w->w_sleeping, 0, __ATOMIC_SEQ_CST);
 	}
 	return NULL;
 }
@@ -156,7 +231,7 @@ void ev_flush(ev_worker_t w)
 	pthread_mutex_lock(&w->w_lock);
 	w->w_state = EV_WORKER_FLUSHING;
 	pthread_mutex_unlock(&w->w_lock);
-	sem_post(&w->w_sem);
+	__ev_worker_wake(w);
 }
 
 ev_worker_t ev_worker_new(const char *name, ev_actor_t actor_fn)
@@ -172,14 +247,18 @@ ev_worker_t ev_worker_new(const char *name, ev_actor_t actor_fn)
 	if (!w->w_name)
 		goto err_1;
 	w->w_actor = actor_fn;
-	err = sem_init(&w->w_sem, 0, 0);
-	if (err)
-		goto err_2;
+	w->w_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (w->w_efd < 0) {
+		err = errno;
+		goto err_1;
+	}
 
 	w->w_state = EV_WORKER_STOPPED;
 	pthread_mutex_init(&w->w_lock, NULL);
 	rbt_init(&w->w_event_tree, (int (*)(void *, const void*))ev_time_cmp);
-	TAILQ_INIT(&w->w_event_list);
+	w->w_q_stub.e_next = NULL;
+	w->w_q_head = &w->w_q_stub;
+	w->w_q_tail = &w->w_q_stub;
 
 	pthread_mutex_lock(&worker_lock);
 	err = EEXIST;
@@ -203,6 +282,7 @@ ev_worker_t ev_worker_new(const char *name, ev_actor_t actor_fn)
 	return w;
  err_2:
 	pthread_mutex_unlock(&worker_lock);
+	close(w->w_efd);
  err_1:
 	free(w->w_name);
  err_0:
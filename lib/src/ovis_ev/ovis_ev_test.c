@@ -2,6 +2,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <time.h>
+#include <getopt.h>
+#include <semaphore.h>
 #include <pthread.h>
 #include "ev.h"
 #include "ev_priv.h"
@@ -38,12 +40,130 @@ static int timer_actor(ev_worker_t src, ev_worker_t dst, ev_status_t status, ev_
 	return 0;
 }
 
+/*
+ * Throughput benchmark: bench_producers threads each post bench_count
+ * immediate events, producer i to worker i % bench_workers.
+ */
+static int bench_count;
+static int bench_producers = 1;
+static int bench_workers = 1;
+static ev_worker_t *bench_w;
+static ev_type_t bench_type;
+static uint64_t bench_done;
+static sem_t bench_sem;
+
+static int bench_actor(ev_worker_t src, ev_worker_t dst, ev_status_t status, ev_t e)
+{
+	if (__sync_add_and_fetch(&bench_done, 1) ==
+	    (uint64_t)bench_count * bench_producers)
+		sem_post(&bench_sem);
+	return 0;
+}
+
+static void *bench_proc(void *arg)
+{
+	ev_worker_t w = arg;
+	int i;
+	ev_t ev;
+
+	for (i = 0; i < bench_count; i++) {
+		ev = ev_new(bench_type);
+		if (!ev) {
+			perror("ev_new");
+			exit(1);
+		}
+		EV_DATA(ev, struct data_s)->v = i;
+		while (ev_post(w, w, ev, NULL))
+			;
+		ev_put(ev);
+	}
+	return NULL;
+}
+
+static int bench(void)
+{
+	int i;
+	pthread_t *thr;
+	struct timespec t0, t1;
+	double secs;
+	uint64_t total = (uint64_t)bench_count * bench_producers;
+
+	char name[32];
+
+	sem_init(&bench_sem, 0, 0);
+	bench_w = calloc(bench_workers, sizeof(*bench_w));
+	thr = calloc(bench_producers, sizeof(*thr));
+	if (!bench_w || !thr) {
+		perror("bench setup");
+		return 1;
+	}
+	for (i = 0; i < bench_workers; i++) {
+		snprintf(name, sizeof(name), "BENCH%d", i);
+		bench_w[i] = ev_worker_new(name, bench_actor);
+		if (!bench_w[i]) {
+			perror("bench setup");
+			return 1;
+		}
+	}
+	bench_type = ev_type_new("bench", sizeof(struct data_s));
+	if (!bench_type) {
+		perror("bench setup");
+		return 1;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < bench_producers; i++)
+		pthread_create(&thr[i], NULL, bench_proc,
+			       bench_w[i % bench_workers]);
+	for (i = 0; i < bench_producers; i++)
+		pthread_join(thr[i], NULL);
+	sem_wait(&bench_sem);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+	printf("producers %d workers %d events %lu elapsed %.6f s "
+	       "rate %.0f events/s\n",
+	       bench_producers, bench_workers, total, secs, total / secs);
+	free(thr);
+	free(bench_w);
+	return 0;
+}
+
+static void usage(char *argv[])
+{
+	printf("usage: %s [-n COUNT [-p PRODUCERS] [-w WORKERS]]\n"
+	       "    Without options, run the timer/request/response demo.\n"
+	       "    -n COUNT      Benchmark mode, events posted per producer.\n"
+	       "    -p PRODUCERS  Number of posting threads (default: 1).\n"
+	       "    -w WORKERS    Number of workers the producers post to\n"
+	       "                  (default: 1).\n",
+	       argv[0]);
+	exit(1);
+}
+
 int main(int argc, char *argv[])
 {
 	struct timespec to;
 	ev_worker_t timer, a, b;
 	ev_type_t timeout, request, response;
 	ev_t to_ev, req_ev, resp_ev;
+	int op;
+
+	while ((op = getopt(argc, argv, "n:p:w:")) != -1) {
+		switch (op) {
+		case 'n':
+			bench_count = atoi(optarg);
+			break;
+		case 'p':
+			bench_producers = atoi(optarg);
+			break;
+		case 'w':
+			bench_workers = atoi(optarg);
+			break;
+		default:
+			usage(argv);
+		}
+	}
+	if (bench_count > 0 && bench_producers > 0 && bench_workers > 0)
+		return bench();
 
 	timer = ev_worker_new("TIMER", timer_actor);
 	a = ev_worker_new("A", timer_actor);
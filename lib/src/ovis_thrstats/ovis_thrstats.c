@@ -1,6 +1,7 @@
 #include <assert.h>
 #include <errno.h>
 #include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/syscall.h>
@@ -212,6 +213,13 @@ static void __buckets_get_usage(int is_idling, uint64_t interval_us,
 	int i, idx;
 	uint64_t remaining, space;
 
+	res->idle_us = res->active_us = res->interval_us = 0;
+
+	/* The stats are initialized by the thread they describe; a reader
+	 * racing with the thread start sees no buckets yet. */
+	if (!bucket_sz)
+		return;
+
 	/* Determine how many buckets we can examine.
 	 * The current bucket isn't complete or filled yet, so
 	 * the highest possible number of buckets is stat->num_buckets - 1.
@@ -224,8 +232,6 @@ static void __buckets_get_usage(int is_idling, uint64_t interval_us,
 			needed_buckets = bucket_cnt - 1;
 	}
 
-	res->idle_us = res->active_us = res->interval_us = 0;
-
 	/*
 	 * Fill the buckets with the elapsed time from the last wait_start and
 	 * wait_end time
@@ -369,4 +375,137 @@ void ovis_thrstats_result_cleanup(struct ovis_thrstats_result *res)
 	if (!res)
 		return;
 	free(res->name);
-}
\ No newline at end of file
+}
+
+/* Stripe index of the calling thread, assigned on first use */
+static __thread int __hist_stripe = -1;
+static int __hist_stripe_next = 0;
+
+static inline struct ovis_thrstats_hist_stripe *
+__hist_stripe_get(ovis_thrstats_hist_t hist)
+{
+	if (__hist_stripe < 0) {
+		__hist_stripe = __atomic_fetch_add(&__hist_stripe_next, 1,
+						   __ATOMIC_RELAXED)
+				% OVIS_THRSTATS_HIST_STRIPES;
+	}
+	return &hist->stripe[__hist_stripe];
+}
+
+static inline int __hist_bucket_idx(uint64_t us)
+{
+	int idx;
+	if (!us)
+		return 0;
+	idx = 64 - __builtin_clzll(us);
+	if (idx >= OVIS_THRSTATS_HIST_BUCKETS)
+		idx = OVIS_THRSTATS_HIST_BUCKETS - 1;
+	return idx;
+}
+
+ovis_thrstats_hist_t ovis_thrstats_hist_new()
+{
+	ovis_thrstats_hist_t hist;
+	int rc;
+
+	rc = posix_memalign((void **)&hist, 64, sizeof(*hist));
+	if (rc) {
+		errno = rc;
+		return NULL;
+	}
+	memset(hist, 0, sizeof(*hist));
+	return hist;
+}
+
+void ovis_thrstats_hist_free(ovis_thrstats_hist_t hist)
+{
+	free(hist);
+}
+
+void ovis_thrstats_hist_record(ovis_thrstats_hist_t hist, uint64_t us)
+{
+	struct ovis_thrstats_hist_stripe *st = __hist_stripe_get(hist);
+	uint64_t max;
+
+	__atomic_fetch_add(&st->bucket[__hist_bucket_idx(us)], 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&st->sum_us, us, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&st->count, 1, __ATOMIC_RELAXED);
+	max = __atomic_load_n(&st->max_us, __ATOMIC_RELAXED);
+	while (us > max) {
+		if (__atomic_compare_exchange_n(&st->max_us, &max, us, 0,
+						__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			break;
+	}
+}
+
+void ovis_thrstats_hist_record_ts(ovis_thrstats_hist_t hist,
+				  struct timespec *start, struct timespec *end)
+{
+	int64_t us = __timespec_diff_us(start, end);
+	ovis_thrstats_hist_record(hist, (us < 0)?0:us);
+}
+
+void ovis_thrstats_hist_get(ovis_thrstats_hist_t hist,
+			    struct ovis_thrstats_hist_result *res)
+{
+	struct ovis_thrstats_hist_stripe *st;
+	uint64_t max;
+	int i, j;
+
+	memset(res, 0, sizeof(*res));
+	for (i = 0; i < OVIS_THRSTATS_HIST_STRIPES; i++) {
+		st = &hist->stripe[i];
+		res->count += __atomic_load_n(&st->count, __ATOMIC_RELAXED);
+		res->sum_us += __atomic_load_n(&st->sum_us, __ATOMIC_RELAXED);
+		max = __atomic_load_n(&st->max_us, __ATOMIC_RELAXED);
+		if (max > res->max_us)
+			res->max_us = max;
+		for (j = 0; j < OVIS_THRSTATS_HIST_BUCKETS; j++) {
+			res->bucket[j] += __atomic_load_n(&st->bucket[j],
+							  __ATOMIC_RELAXED);
+		}
+	}
+}
+
+void ovis_thrstats_hist_reset(ovis_thrstats_hist_t hist)
+{
+	struct ovis_thrstats_hist_stripe *st;
+	int i, j;
+
+	for (i = 0; i < OVIS_THRSTATS_HIST_STRIPES; i++) {
+		st = &hist->stripe[i];
+		__atomic_store_n(&st->count, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&st->sum_us, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&st->max_us, 0, __ATOMIC_RELAXED);
+		for (j = 0; j < OVIS_THRSTATS_HIST_BUCKETS; j++)
+			__atomic_store_n(&st->bucket[j], 0, __ATOMIC_RELAXED);
+	}
+}
+
+uint64_t ovis_thrstats_hist_bucket_bound(int idx)
+{
+	if (idx >= OVIS_THRSTATS_HIST_BUCKETS - 1)
+		return UINT64_MAX;
+	return 1UL << idx;
+}
+
+uint64_t ovis_thrstats_hist_percentile(struct ovis_thrstats_hist_result *res,
+				       double pct)
+{
+	uint64_t target, acc, bound;
+	int i;
+
+	if (!res->count)
+		return 0;
+	target = (uint64_t)((pct / 100.0) * res->count);
+	if (target < 1)
+		target = 1;
+	acc = 0;
+	for (i = 0; i < OVIS_THRSTATS_HIST_BUCKETS; i++) {
+		acc += res->bucket[i];
+		if (acc >= target)
+			break;
+	}
+	bound = ovis_thrstats_hist_bucket_bound(i);
+	return (bound < res->max_us)?bound:res->max_us;
+}
@@ -359,5 +359,132 @@ void ovis_thrstats_result_cleanup(struct ovis_thrstats_result *res);
  */
 int ovis_thrstats_name_set(ovis_thrstats_t stats, const char *name);
 
+/**
+ * Latency Histograms:
+ * ------------------
+ * An \c ovis_thrstats_hist records operation latencies into log2 buckets
+ * of microseconds. Bucket 0 counts latencies below 1 us and bucket \c i
+ * (i > 0) counts latencies in [2^(i-1), 2^i) us. The last bucket also
+ * absorbs everything above its lower bound.
+ *
+ * Recording is lock-free. Each recording thread is bound to one of
+ * \c OVIS_THRSTATS_HIST_STRIPES cache-line aligned stripes and only
+ * increments that stripe with relaxed atomics, so concurrent recorders
+ * rarely share a cache line. Readers merge the stripes in
+ * ovis_thrstats_hist_get(). The merged result is not an atomic snapshot,
+ * but every recorded sample eventually becomes visible.
+ *
+ * // One histogram per monitored object
+ * ovis_thrstats_hist_t h = ovis_thrstats_hist_new();
+ * clock_gettime(CLOCK_REALTIME, &start);
+ * do_something();
+ * clock_gettime(CLOCK_REALTIME, &end);
+ * ovis_thrstats_hist_record_ts(h, &start, &end);
+ *
+ * struct ovis_thrstats_hist_result res;
+ * ovis_thrstats_hist_get(h, &res);
+ * printf("p99 <= %lu us\n", ovis_thrstats_hist_percentile(&res, 99));
+ */
+#define OVIS_THRSTATS_HIST_BUCKETS 32
+#define OVIS_THRSTATS_HIST_STRIPES 4
+
+struct ovis_thrstats_hist_stripe {
+	uint64_t count;
+	uint64_t sum_us;
+	uint64_t max_us;
+	uint64_t bucket[OVIS_THRSTATS_HIST_BUCKETS];
+} __attribute__((aligned(64)));
+
+typedef struct ovis_thrstats_hist {
+	struct ovis_thrstats_hist_stripe stripe[OVIS_THRSTATS_HIST_STRIPES];
+} *ovis_thrstats_hist_t;
+
+/**
+ * \struct ovis_thrstats_hist_result
+ * \brief Histogram data merged from all stripes
+ */
+struct ovis_thrstats_hist_result {
+	/** Number of recorded samples */
+	uint64_t count;
+	/** Sum of all recorded latencies in microseconds */
+	uint64_t sum_us;
+	/** Largest recorded latency in microseconds */
+	uint64_t max_us;
+	/** Sample counts of the log2 buckets */
+	uint64_t bucket[OVIS_THRSTATS_HIST_BUCKETS];
+};
+
+/**
+ * Allocate a zeroed, cache-line aligned latency histogram
+ *
+ * \return The histogram, or NULL with \c errno set on failure
+ */
+ovis_thrstats_hist_t ovis_thrstats_hist_new();
+
+/**
+ * Free a histogram allocated by ovis_thrstats_hist_new()
+ *
+ * \param hist The histogram; NULL is ignored
+ */
+void ovis_thrstats_hist_free(ovis_thrstats_hist_t hist);
+
+/**
+ * Record one latency sample
+ *
+ * \param hist The histogram
+ * \param us   The latency in microseconds
+ */
+void ovis_thrstats_hist_record(ovis_thrstats_hist_t hist, uint64_t us);
+
+/**
+ * Record the latency between two timestamps
+ *
+ * A negative duration (\c end before \c start) is recorded as zero.
+ *
+ * \param hist  The histogram
+ * \param start The start of the operation
+ * \param end   The end of the operation
+ */
+void ovis_thrstats_hist_record_ts(ovis_thrstats_hist_t hist,
+				  struct timespec *start, struct timespec *end);
+
+/**
+ * Merge the stripes of \c hist into \c res
+ *
+ * \param hist The histogram
+ * \param res  The output result
+ */
+void ovis_thrstats_hist_get(ovis_thrstats_hist_t hist,
+			    struct ovis_thrstats_hist_result *res);
+
+/**
+ * Zero all counters of \c hist
+ *
+ * Samples recorded concurrently with the reset may be partially kept.
+ *
+ * \param hist The histogram
+ */
+void ovis_thrstats_hist_reset(ovis_thrstats_hist_t hist);
+
+/**
+ * Upper bound of the bucket \c idx in microseconds
+ *
+ * \param idx The bucket index
+ * \return The exclusive upper bound; UINT64_MAX for the last bucket
+ */
+uint64_t ovis_thrstats_hist_bucket_bound(int idx);
+
+/**
+ * Estimate a latency percentile from a merged result
+ *
+ * The estimate is the upper bound of the bucket containing the
+ * percentile, capped by \c res->max_us.
+ *
+ * \param res The merged result
+ * \param pct The percentile (0-100)
+ * \return The estimated latency in microseconds; 0 if \c res is empty
+ */
+uint64_t ovis_thrstats_hist_percentile(struct ovis_thrstats_hist_result *res,
+				       double pct);
 
 #endif
\ No newline at end of file
@@ -409,8 +409,8 @@ static void __teardown_conn(struct z_fi_ep *rep)
 		if (ret) {
 			/* LOG_(rep, "error %d closing CQ\n", ret); */
 			/* Try to clear the cq and try close again */
-			struct fi_cq_err_entry	entry;
-			while (fi_cq_read(rep->cq, &entry, 1) > 0) {
+			struct fi_cq_data_entry	entry[Z_FI_CQ_BATCH];
+			while (fi_cq_read(rep->cq, entry, Z_FI_CQ_BATCH) > 0) {
 			}
 			ret = fi_close(&rep->cq->fid);
 			if (ret) {
@@ -745,7 +745,8 @@ _buffer_init_pool(struct z_fi_ep *rep)
 {
 	struct z_fi_buffer_pool *p;
 	pthread_mutex_lock(&rep->buf_free_list_lock);
-	p = _buffer_pool_new(rep, RQ_DEPTH + SQ_DEPTH + 4);
+	/* receives, and SENDs in flight (bounded by the peer's RQ credits) */
+	p = _buffer_pool_new(rep, 2 * RQ_DEPTH + 4);
 	pthread_mutex_unlock(&rep->buf_free_list_lock);
 	if (!p)
 		return errno;
@@ -908,16 +909,37 @@ static void z_fi_flush(struct z_fi_ep *rep)
 	pthread_cond_signal(&rep->io_q_cond);
 }
 
+static inline void
+z_fi_msg_rma_init(struct fi_msg_rma *msg, struct iovec *iov, void **desc,
+		  struct fi_rma_iov *rma_iov, void *context)
+{
+	memset(msg, 0, sizeof(*msg));
+	msg->msg_iov = iov;
+	msg->desc = desc;
+	msg->iov_count = 1;
+	msg->rma_iov = rma_iov;
+	msg->rma_iov_count = 1;
+	msg->context = context;
+}
+
 /*
  * Must be called with the credit_lock held.
+ *
+ * \c flags is applied to RDMA operations only, it is used to post
+ * FI_MORE on all but the last operation of a chain from submit_pending().
+ * SENDs are always posted with the default flags.
  */
 static zap_err_t
-post_wr(struct z_fi_ep *rep, struct z_fi_context *ctxt)
+post_wr(struct z_fi_ep *rep, struct z_fi_context *ctxt, uint64_t flags)
 {
 	int rc;
 	size_t len;
 	struct z_fi_buffer *rb;
 	struct fid_mr *mr;
+	struct iovec iov;
+	void *desc;
+	struct fi_rma_iov rma_iov;
+	struct fi_msg_rma msg;
 
 	switch (ctxt->op) {
 	    case Z_FI_WC_SEND:
@@ -955,10 +977,21 @@ post_wr(struct z_fi_ep *rep, struct z_fi_context *ctxt)
 			rc = errno;
 			break;
 		}
-		rc = fi_write(rep->fi_ep, ctxt->u.rdma.src_addr, ctxt->u.rdma.len,
-			      fi_mr_desc(mr), 0,
-			      (uint64_t)ctxt->u.rdma.dst_addr,
-			      z_fi_rkey_get(ctxt->u.rdma.dst_map), ctxt);
+		if (flags) {
+			iov.iov_base = ctxt->u.rdma.src_addr;
+			iov.iov_len = ctxt->u.rdma.len;
+			desc = fi_mr_desc(mr);
+			rma_iov.addr = (uint64_t)ctxt->u.rdma.dst_addr;
+			rma_iov.len = ctxt->u.rdma.len;
+			rma_iov.key = z_fi_rkey_get(ctxt->u.rdma.dst_map);
+			z_fi_msg_rma_init(&msg, &iov, &desc, &rma_iov, ctxt);
+			rc = fi_writemsg(rep->fi_ep, &msg, flags);
+		} else {
+			rc = fi_write(rep->fi_ep, ctxt->u.rdma.src_addr,
+				      ctxt->u.rdma.len, fi_mr_desc(mr), 0,
+				      (uint64_t)ctxt->u.rdma.dst_addr,
+				      z_fi_rkey_get(ctxt->u.rdma.dst_map), ctxt);
+		}
 
 		DLOG("ZAP_WC_RDMA_WRITE rep %p ctxt %p src %p dst %p len %d\n",
 		     rep, ctxt, ctxt->u.rdma.src_addr, ctxt->u.rdma.dst_addr, ctxt->u.rdma.len);
@@ -969,10 +1002,21 @@ post_wr(struct z_fi_ep *rep, struct z_fi_context *ctxt)
 			rc = errno;
 			break;
 		}
-		rc = fi_read(rep->fi_ep, ctxt->u.rdma.dst_addr, ctxt->u.rdma.len,
-			     fi_mr_desc(mr), 0,
-			     (uint64_t)ctxt->u.rdma.src_addr,
-			     z_fi_rkey_get(ctxt->u.rdma.src_map), ctxt);
+		if (flags) {
+			iov.iov_base = ctxt->u.rdma.dst_addr;
+			iov.iov_len = ctxt->u.rdma.len;
+			desc = fi_mr_desc(mr);
+			rma_iov.addr = (uint64_t)ctxt->u.rdma.src_addr;
+			rma_iov.len = ctxt->u.rdma.len;
+			rma_iov.key = z_fi_rkey_get(ctxt->u.rdma.src_map);
+			z_fi_msg_rma_init(&msg, &iov, &desc, &rma_iov, ctxt);
+			rc = fi_readmsg(rep->fi_ep, &msg, flags);
+		} else {
+			rc = fi_read(rep->fi_ep, ctxt->u.rdma.dst_addr,
+				     ctxt->u.rdma.len, fi_mr_desc(mr), 0,
+				     (uint64_t)ctxt->u.rdma.src_addr,
+				     z_fi_rkey_get(ctxt->u.rdma.src_map), ctxt);
+		}
 
 		DLOG("ZAP_WC_RDMA_READ rep %p ctxt %p src %p dst %p len %d\n",
 		     rep, ctxt, ctxt->u.rdma.src_addr, ctxt->u.rdma.dst_addr, ctxt->u.rdma.len);
@@ -1040,11 +1084,15 @@ static int get_credits(struct z_fi_ep *rep, int is_rdma)
 	return rc;
 }
 
-static void put_sq(struct z_fi_ep *rep)
+/* Return \c n SQ credits at once for a batch of send/RDMA completions */
+static void put_sq(struct z_fi_ep *rep, int n)
 {
+	if (!n)
+		return;
 	pthread_mutex_lock(&rep->credit_lock);
-	if (rep->sq_credits < SQ_DEPTH)
-		rep->sq_credits++;
+	rep->sq_credits += n;
+	if (rep->sq_credits > SQ_DEPTH)
+		rep->sq_credits = SQ_DEPTH;
 	pthread_mutex_unlock(&rep->credit_lock);
 }
 
@@ -1056,29 +1104,61 @@ static void put_sq(struct z_fi_ep *rep)
  */
 static void submit_pending(struct z_fi_ep *rep)
 {
-	int is_rdma;
+	int is_rdma, i, n, failed = 0, unflushed;
+	uint64_t more;
 	struct z_fi_context *ctxt;
+	struct z_fi_context *batch[SQ_DEPTH];
 
 	if (rep->ep.state != ZAP_EP_CONNECTED) {
 		return;
 	}
 
 	pthread_mutex_lock(&rep->credit_lock);
-	while (!TAILQ_EMPTY(&rep->io_q)) {
+	/*
+	 * Take everything the credits allow off the queue first, then post
+	 * the chain with FI_MORE on all but the last operation so that the
+	 * provider can ring the doorbell once for a multi-set update.
+	 */
+	n = 0;
+	while (!TAILQ_EMPTY(&rep->io_q) && n < SQ_DEPTH) {
 		ctxt = TAILQ_FIRST(&rep->io_q);
 		is_rdma = (ctxt->op != Z_FI_WC_SEND);
 		if (_get_credits(rep, is_rdma))
-			goto out;
+			break;
 
 		TAILQ_REMOVE(&rep->io_q, ctxt, pending_link);
 		DLOG("rep %p ctxt %p\n", rep, ctxt);
 		ctxt->pending = 0;
-
-		if (post_wr(rep, ctxt))
-			__context_free(ctxt);
+		batch[n++] = ctxt;
 	}
-	pthread_cond_signal(&rep->io_q_cond);
- out:
+	unflushed = 0;
+	for (i = 0; i < n; i++) {
+		/* After a failure, post the rest one by one; each post
+		 * without FI_MORE also submits the deferred ones. */
+		more = (i < n - 1 && !failed && batch[i]->op != Z_FI_WC_SEND &&
+			batch[i]->op != Z_FI_WC_SEND_MAPPED &&
+			batch[i]->op != Z_FI_WC_SHARE) ? FI_MORE : 0;
+		if (post_wr(rep, batch[i], more)) {
+			failed = 1;
+			__context_free(batch[i]);
+			continue;
+		}
+		unflushed = !!more;
+	}
+	if (unflushed) {
+		/*
+		 * The last post of the chain failed, so the provider may hold
+		 * the FI_MORE operations before it indefinitely. There is no
+		 * flush operation in libfabric: shut the endpoint down so that
+		 * the provider completes them with FI_ECANCELED.
+		 */
+		LOG_(rep, "the end of an FI_MORE chain could not be posted, "
+		     "shutting down the endpoint\n");
+		rep->ep.state = ZAP_EP_ERROR;
+		fi_shutdown(rep->fi_ep, 0);
+	}
+	if (TAILQ_EMPTY(&rep->io_q))
+		pthread_cond_signal(&rep->io_q_cond);
 	pthread_mutex_unlock(&rep->credit_lock);
 }
 
@@ -1092,7 +1172,7 @@ static zap_err_t submit_wr(struct z_fi_ep *rep, struct z_fi_context *ctxt, int i
 
 	pthread_mutex_lock(&rep->credit_lock);
 	if (!get_credits(rep, is_rdma)) {
-		rc = post_wr(rep, ctxt);
+		rc = post_wr(rep, ctxt, 0);
 	} else {
 		ctxt->pending = 1;
 		TAILQ_INSERT_TAIL(&rep->io_q, ctxt, pending_link);
@@ -1600,17 +1680,77 @@ err_0:
 	return ret;
 }
 
+/*
+ * Dispatch one completion. Returns 1 if the completion returns an SQ
+ * credit. The context is freed by the caller.
+ */
+static int process_cq_entry(struct z_fi_ep *rep, struct fi_cq_err_entry *entry)
+{
+	struct z_fi_context *ctxt = entry->op_context;
+
+	switch (ctxt->op) {
+	case Z_FI_WC_SHARE:
+		DLOG("got ZAP_WC_SEND rep %p ctxt %p rb %p err %d proverr %d\n",
+		     rep, ctxt, ctxt->u.send.rb, entry->err, entry->prov_errno);
+		process_share_wc(rep, entry);
+		if (entry->err && ctxt->u.send.rb)
+			__buffer_free(ctxt->u.send.rb);
+		return 1;
+	case Z_FI_WC_SEND:
+		DLOG("got ZAP_WC_SEND rep %p ctxt %p rb %p err %d proverr %d\n",
+		     rep, ctxt, ctxt->u.send.rb, entry->err, entry->prov_errno);
+		process_send_wc(rep, entry);
+		if (entry->err && ctxt->u.send.rb)
+			__buffer_free(ctxt->u.send.rb);
+		return 1;
+	case Z_FI_WC_SEND_MAPPED:
+		DLOG("got ZAP_WC_SEND rep %p ctxt %p rb %p err %d proverr %d\n",
+		     rep, ctxt, ctxt->u.send_mapped.rb, entry->err, entry->prov_errno);
+		process_send_mapped_wc(rep, entry);
+		if (entry->err && ctxt->u.send.rb)
+			__buffer_free(ctxt->u.send.rb);
+		return 1;
+	case Z_FI_WC_RDMA_WRITE:
+		DLOG("got ZAP_WC_RDMA_WRITE rep %p ctxt %p src %p dst %p err %d proverr %d\n",
+		     rep, ctxt, ctxt->u.rdma.src_addr, ctxt->u.rdma.dst_addr,
+		     entry->err, entry->prov_errno);
+		process_write_wc(rep, entry);
+		return 1;
+	case Z_FI_WC_RDMA_READ:
+		DLOG("got ZAP_WC_RDMA_READ rep %p ctxt %p src %p dst %p err %d proverr %d\n",
+		     rep, ctxt, ctxt->u.rdma.src_addr, ctxt->u.rdma.dst_addr,
+		     entry->err, entry->prov_errno);
+		process_read_wc(rep, entry);
+		return 1;
+	case Z_FI_WC_RECV:
+		DLOG("got ZAP_WC_RECV rep %p ctxt %p rb %p len %d err %d proverr %d\n",
+		     rep, ctxt, ctxt->u.recv.rb, entry->len, entry->err, entry->prov_errno);
+		if (!entry->err)
+			process_recv_wc(rep, entry);
+		return 0;
+	default:
+		LOG_(rep,"invalid completion op %d\n", ctxt->op);
+		return 0;
+	}
+}
+
+/*
+ * Drain the CQ up to Z_FI_CQ_BATCH entries per fi_cq_read(). The SQ
+ * credits and the contexts of a batch are returned under a single
+ * acquisition of credit_lock and ep.lock respectively.
+ */
 static void scrub_cq(struct z_fi_ep *rep)
 {
-	int			ret;
+	int			ret, i, n_sq;
 	struct z_fi_context	*ctxt;
+	struct fi_cq_data_entry	entries[Z_FI_CQ_BATCH];
+	struct z_fi_context	*done[Z_FI_CQ_BATCH];
 	struct fi_cq_err_entry	entry;
 	struct fid		*fid[1];
 
 	DLOG("rep %p\n", rep);
 	while (1) {
-		memset(&entry, 0, sizeof(entry));
-		ret = fi_cq_read(rep->cq, &entry, 1);
+		ret = fi_cq_read(rep->cq, entries, Z_FI_CQ_BATCH);
 		if ((ret == 0) || (ret == -FI_EAGAIN)) {
 			fid[0] = &rep->cq->fid;
 			ret = fi_trywait(rep->fabric, fid, 1);
@@ -1619,6 +1759,7 @@ static void scrub_cq(struct z_fi_ep *rep)
 			break;
 		}
 		if (ret == -FI_EAVAIL) {
+			memset(&entry, 0, sizeof(entry));
 			fi_cq_readerr(rep->cq, &entry, 0);
 			if (entry.err != FI_ECANCELED) {
 				/* We got an error status, not flush. */
@@ -1629,64 +1770,34 @@ static void scrub_cq(struct z_fi_ep *rep)
 				continue;
 			}
 			assert(entry.err);
+			ctxt = entry.op_context;
+			DLOG("fi_cq_readerr entry.err %d ctxt %p\n", entry.err, ctxt);
+			put_sq(rep, process_cq_entry(rep, &entry));
+			pthread_mutex_lock(&rep->ep.lock);
+			__context_free(ctxt);
+			pthread_mutex_unlock(&rep->ep.lock);
+			continue;
 		} else if (ret < 0) {
 			DLOG("fi_cq_read error %d\n", ret);
 			break;
 		}
-		ctxt = entry.op_context;
-		DLOG("fi_cq_read %d, entry.err %d ctxt %p\n", ret, entry.err, ctxt);
-		switch (ctxt->op) {
-		case Z_FI_WC_SHARE:
-			DLOG("got ZAP_WC_SEND rep %p ctxt %p rb %p err %d proverr %d\n",
-			     rep, ctxt, ctxt->u.send.rb, entry.err, entry.prov_errno);
-			process_share_wc(rep, &entry);
-			put_sq(rep);
-			if (entry.err && ctxt->u.send.rb)
-				__buffer_free(ctxt->u.send.rb);
-			break;
-		case Z_FI_WC_SEND:
-			DLOG("got ZAP_WC_SEND rep %p ctxt %p rb %p err %d proverr %d\n",
-			     rep, ctxt, ctxt->u.send.rb, entry.err, entry.prov_errno);
-			process_send_wc(rep, &entry);
-			put_sq(rep);
-			if (entry.err && ctxt->u.send.rb)
-				__buffer_free(ctxt->u.send.rb);
-			break;
-		case Z_FI_WC_SEND_MAPPED:
-			DLOG("got ZAP_WC_SEND rep %p ctxt %p rb %p err %d proverr %d\n",
-			     rep, ctxt, ctxt->u.send_mapped.rb, entry.err, entry.prov_errno);
-			process_send_mapped_wc(rep, &entry);
-			put_sq(rep);
-			if (entry.err && ctxt->u.send.rb)
-				__buffer_free(ctxt->u.send.rb);
-			break;
-		case Z_FI_WC_RDMA_WRITE:
-			DLOG("got ZAP_WC_RDMA_WRITE rep %p ctxt %p src %p dst %p err %d proverr %d\n",
-			     rep, ctxt, ctxt->u.rdma.src_addr, ctxt->u.rdma.dst_addr,
-			     entry.err, entry.prov_errno);
-			process_write_wc(rep, &entry);
-			put_sq(rep);
-			break;
-		case Z_FI_WC_RDMA_READ:
-			DLOG("got ZAP_WC_RDMA_READ rep %p ctxt %p src %p dst %p err %d proverr %d\n",
-			     rep, ctxt, ctxt->u.rdma.src_addr, ctxt->u.rdma.dst_addr,
-			     entry.err, entry.prov_errno);
-			process_read_wc(rep, &entry);
-			put_sq(rep);
-			break;
-		case Z_FI_WC_RECV:
-			DLOG("got ZAP_WC_RECV rep %p ctxt %p rb %p len %d err %d proverr %d\n",
-			     rep, ctxt, ctxt->u.recv.rb, entry.len, entry.err, entry.prov_errno);
-			if (!entry.err)
-				process_recv_wc(rep, &entry);
-			break;
-		default:
-			LOG_(rep,"invalid completion op %d\n", ctxt->op);
-			break;
+		DLOG("fi_cq_read %d entries\n", ret);
+		n_sq = 0;
+		for (i = 0; i < ret; i++) {
+			memset(&entry, 0, sizeof(entry));
+			entry.op_context = entries[i].op_context;
+			entry.flags = entries[i].flags;
+			entry.len = entries[i].len;
+			entry.buf = entries[i].buf;
+			entry.data = entries[i].data;
+			done[i] = entry.op_context;
+			n_sq += process_cq_entry(rep, &entry);
 		}
+		put_sq(rep, n_sq);
 
 		pthread_mutex_lock(&rep->ep.lock);
-		__context_free(ctxt);
+		for (i = 0; i < ret; i++)
+			__context_free(done[i]);
 		pthread_mutex_unlock(&rep->ep.lock);
 	}
 	DLOG("done with rep %p\n", rep);
@@ -2244,7 +2355,7 @@ static int send_credit_update(struct z_fi_ep *rep)
 		goto out;
 	}
 	ctxt->u.send.rb = rbuf;
-	rc = post_wr(rep, ctxt);
+	rc = post_wr(rep, ctxt, 0);
 	if (rc) {
 		__buffer_free(rbuf);
 		rc = ENOSPC;
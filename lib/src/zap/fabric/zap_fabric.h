@@ -56,8 +56,16 @@
 #include "../zap.h"
 #include "../zap_priv.h"
 
-#define SQ_DEPTH 4
+/*
+ * SQ_DEPTH is local: it bounds the operations in flight on our send queue.
+ * SENDs are further bounded by the RQ credits of the peer, so only RDMA
+ * reads and writes (e.g. the updates of many sets) use the full depth.
+ * RQ_DEPTH is the number of receives both peers assume the other posted;
+ * it is part of the credit protocol and must not change.
+ */
+#define SQ_DEPTH 64
 #define RQ_DEPTH 4
+#define Z_FI_CQ_BATCH 32 /* completions per fi_cq_read() */
 #define RQ_BUF_SZ 2048
 
 /* Libfabric version required by zap. */
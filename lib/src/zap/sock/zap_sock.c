@@ -64,11 +64,18 @@
 #include <signal.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
+#include <time.h>
 #include "coll/rbt.h"
 #include "ovis_util/os_util.h"
 #include "ovis_log/ovis_log.h"
 
 #include "zap_sock.h"
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+#ifdef HAVE_LIBZSTD
+#include <zstd.h>
+#endif
 
 #define GETTID() syscall(SYS_gettid)
 
@@ -100,6 +107,23 @@ static ovis_log_t zslog;
 
 static int init_complete = 0;
 
+/*
+ * Payload compression (ZAP_SOCK_COMPRESS / ZAP_SOCK_COMPRESS_MIN).
+ *
+ * ZAP_SOCK_COMPRESS is a comma separated list of codecs in the order of
+ * preference, e.g. "zstd,zlib". The active side offers all of them in
+ * SOCK_MSG_CONNECT and the passive side picks the first of its own list that
+ * was offered. Only SOCK_MSG_READ_RESP and SOCK_MSG_SENDRECV payloads of at
+ * least ZAP_SOCK_COMPRESS_MIN bytes are compressed; data always lands
+ * uncompressed in the destination map, so the layout seen by the
+ * application does not change.
+ */
+#define ZAP_SOCK_COMPRESS_MIN 1024
+static int z_sock_zip_pref[2];
+static int z_sock_zip_npref;
+static int z_sock_zip_codecs; /* SOCK_ZIP_* bits of z_sock_zip_pref[] */
+static size_t z_sock_zip_min;
+
 static void *io_thread_proc(void *arg);
 
 static void sock_event(struct epoll_event *ev);
@@ -127,6 +151,9 @@ static void z_sock_buff_cleanup(z_sock_buff_t buff);
 static void z_sock_buff_reset(z_sock_buff_t buff);
 static int z_sock_buff_extend(z_sock_buff_t buff, size_t new_sz);
 
+static int z_sock_unzip(struct z_sock_ep *sep, char *dst, size_t dst_len,
+			const char *src, size_t len);
+
 static void z_sock_hdr_init(struct sock_msg_hdr *hdr, uint32_t xid,
 			    uint16_t type, uint32_t len, uint64_t ctxt);
 
@@ -459,6 +486,7 @@ static void process_sep_read_error(struct z_sock_ep *sep)
 static void process_sep_msg_connect(struct z_sock_ep *sep)
 {
 	struct sock_msg_connect *msg;
+	int i, offer;
 
 	msg = sep->buff.data;
 
@@ -478,6 +506,15 @@ static void process_sep_msg_connect(struct z_sock_ep *sep)
 		return;
 	}
 
+	/* Pick the first of our compression codecs that the peer offers */
+	offer = ntohs(msg->hdr.flags);
+	for (i = 0; i < z_sock_zip_npref; i++) {
+		if (offer & z_sock_zip_pref[i]) {
+			sep->zip = z_sock_zip_pref[i];
+			break;
+		}
+	}
+
 	/*
 	 * NOTE
 	 * ----
@@ -519,6 +556,18 @@ static void process_sep_msg_accepted(struct z_sock_ep *sep)
 	struct sock_msg_sendrecv *msg;
 	struct zap_event ev;
 	zap_err_t zerr;
+	int zip;
+
+	msg = sep->buff.data;
+
+	/* The peer must choose exactly one of the codecs we offered */
+	zip = ntohs(msg->hdr.flags);
+	if (zip && ((zip & (zip - 1)) || !(zip & z_sock_zip_codecs))) {
+		LOG_(sep, "'Accept' message with unexpected compression "
+			  "codec %#x.\n", zip);
+		goto err;
+	}
+	sep->zip = zip;
 
 	pthread_mutex_lock(&sep->ep.lock);
 	zerr = __sock_send(sep, SOCK_MSG_ACK_ACCEPTED, NULL, 0);
@@ -526,8 +575,6 @@ static void process_sep_msg_accepted(struct z_sock_ep *sep)
 	if (zerr)
 		goto err;
 
-	msg = sep->buff.data;
-
 	ev.type = ZAP_EVENT_CONNECTED;
 	ev.status = ZAP_ERR_OK;
 	ev.data = (void*)msg->data;
@@ -611,7 +658,23 @@ static void process_sep_msg_sendrecv(struct z_sock_ep *sep)
 	ev.data = (unsigned char *)msg->data;
 	ev.data_len = ntohl(msg->data_len);
 
+	if (msg->hdr.flags & htons(SOCK_MSG_F_ZIP)) {
+		if (ev.data_len > SOCKBUF_SZ)
+			goto err;
+		if (sep->unzip_buff.alen < ev.data_len &&
+		    z_sock_buff_extend(&sep->unzip_buff, ev.data_len))
+			goto err;
+		if (z_sock_unzip(sep, sep->unzip_buff.data, ev.data_len,
+				 msg->data, ntohl(msg->hdr.msg_len) - sizeof(*msg)))
+			goto err;
+		ev.data = sep->unzip_buff.data;
+	}
+
 	sep->ep.cb(&sep->ep, &ev);
+	return;
+err:
+	LOG_(sep, "Failed to decompress a %zu bytes message.\n", ev.data_len);
+	shutdown(sep->sock, SHUT_RDWR);
 }
 
 /**
@@ -697,6 +760,199 @@ void __sock_io_free(struct z_sock_ep *sep, struct z_sock_io *io)
 	free(io);
 }
 
+static void z_sock_zip_init()
+{
+	char *s, *buf, *tok, *ptr;
+	int codec;
+
+	z_sock_zip_pref[0] = z_sock_zip_pref[1] = 0;
+	z_sock_zip_npref = 0;
+	z_sock_zip_codecs = 0;
+	z_sock_zip_min = ZAP_ENV_INT(ZAP_SOCK_COMPRESS_MIN);
+	s = getenv("ZAP_SOCK_COMPRESS");
+	if (!s)
+		return;
+	buf = strdup(s);
+	if (!buf)
+		return;
+	for (tok = strtok_r(buf, ",", &ptr); tok; tok = strtok_r(NULL, ",", &ptr)) {
+		codec = 0;
+#ifdef HAVE_LIBZSTD
+		if (0 == strcmp(tok, "zstd"))
+			codec = SOCK_ZIP_ZSTD;
+#endif
+#ifdef HAVE_LIBZ
+		if (0 == strcmp(tok, "zlib"))
+			codec = SOCK_ZIP_ZLIB;
+#endif
+		if (!codec) {
+			if (strcmp(tok, "none"))
+				ovis_log(zslog, OVIS_LWARN, "ZAP_SOCK_COMPRESS: "
+					 "'%s' is not supported, ignored.\n", tok);
+			continue;
+		}
+		if (z_sock_zip_codecs & codec)
+			continue;
+		z_sock_zip_codecs |= codec;
+		z_sock_zip_pref[z_sock_zip_npref++] = codec;
+	}
+	free(buf);
+}
+
+static uint64_t z_sock_zip_ns(struct timespec *t0)
+{
+	struct timespec t1;
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	return (t1.tv_sec - t0->tv_sec) * 1000000000 + t1.tv_nsec - t0->tv_nsec;
+}
+
+static void z_sock_zip_stat(struct z_sock_ep *sep, int unzip,
+			    size_t in, size_t out, uint64_t ns)
+{
+	struct zap_zip_stats *st;
+	if (!sep->ep.thread)
+		return;
+	st = &sep->ep.thread->stat->zip;
+	if (unzip) {
+		__atomic_fetch_add(&st->unzip_in_bytes, in, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&st->unzip_out_bytes, out, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&st->unzip_ns, ns, __ATOMIC_RELAXED);
+	} else {
+		__atomic_fetch_add(&st->in_bytes, in, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&st->out_bytes, out, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&st->ns, ns, __ATOMIC_RELAXED);
+	}
+}
+
+static size_t z_sock_zip_bound(struct z_sock_ep *sep, size_t len)
+{
+	switch (sep->zip) {
+#ifdef HAVE_LIBZSTD
+	case SOCK_ZIP_ZSTD:
+		return ZSTD_compressBound(len);
+#endif
+#ifdef HAVE_LIBZ
+	case SOCK_ZIP_ZLIB:
+		return compressBound(len);
+#endif
+	}
+	return 0;
+}
+
+/*
+ * Compress `len` bytes of `src` into `dst`. Returns the compressed length, or
+ * 0 if the codec failed. Caller must hold `sep->ep.lock`.
+ */
+static size_t z_sock_zip(struct z_sock_ep *sep, char *dst, size_t dst_len,
+			 const char *src, size_t len)
+{
+	switch (sep->zip) {
+#ifdef HAVE_LIBZSTD
+	case SOCK_ZIP_ZSTD: {
+		size_t n;
+		if (!sep->zip_cctx) {
+			sep->zip_cctx = ZSTD_createCCtx();
+			if (!sep->zip_cctx)
+				return 0;
+		}
+		n = ZSTD_compressCCtx(sep->zip_cctx, dst, dst_len, src, len, 1);
+		return ZSTD_isError(n)?0:n;
+	}
+#endif
+#ifdef HAVE_LIBZ
+	case SOCK_ZIP_ZLIB: {
+		uLongf n = dst_len;
+		if (Z_OK != compress2((Bytef *)dst, &n, (const Bytef *)src,
+				      len, Z_BEST_SPEED))
+			return 0;
+		return n;
+	}
+#endif
+	}
+	return 0;
+}
+
+/*
+ * Decompress `len` bytes of `src` into `dst`. The result must be exactly
+ * `dst_len` bytes. Called only from the endpoint's io thread.
+ */
+static int z_sock_unzip(struct z_sock_ep *sep, char *dst, size_t dst_len,
+			const char *src, size_t len)
+{
+	struct timespec t0;
+	int rc = EINVAL;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	switch (sep->zip) {
+#ifdef HAVE_LIBZSTD
+	case SOCK_ZIP_ZSTD: {
+		size_t n;
+		if (!sep->zip_dctx) {
+			sep->zip_dctx = ZSTD_createDCtx();
+			if (!sep->zip_dctx)
+				return ENOMEM;
+		}
+		n = ZSTD_decompressDCtx(sep->zip_dctx, dst, dst_len, src, len);
+		if (!ZSTD_isError(n) && n == dst_len)
+			rc = 0;
+		break;
+	}
+#endif
+#ifdef HAVE_LIBZ
+	case SOCK_ZIP_ZLIB: {
+		uLongf n = dst_len;
+		if (Z_OK == uncompress((Bytef *)dst, &n, (const Bytef *)src, len)
+		    && n == dst_len)
+			rc = 0;
+		break;
+	}
+#endif
+	}
+	if (!rc)
+		z_sock_zip_stat(sep, 1, len, dst_len, z_sock_zip_ns(&t0));
+	return rc;
+}
+
+/*
+ * Build a send wr carrying the `msg_size` bytes of header `m` followed by
+ * `data` compressed with the negotiated codec. Returns NULL if the data is
+ * not worth compressing (or compression failed); the caller then sends it
+ * as is. Caller must hold `sep->ep.lock`.
+ */
+static z_sock_send_wr_t __sock_zip_wr(struct z_sock_ep *sep,
+				      struct sock_msg_hdr *m, size_t msg_size,
+				      const char *data, size_t data_len,
+				      struct z_sock_io *io)
+{
+	z_sock_send_wr_t wr;
+	struct timespec t0;
+	size_t bound, zlen;
+
+	if (!sep->zip || data_len < z_sock_zip_min)
+		return NULL;
+	bound = z_sock_zip_bound(sep, data_len);
+	wr = __sock_wr_alloc(bound, io);
+	if (!wr)
+		return NULL;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	zlen = z_sock_zip(sep, wr->msg.bytes + msg_size, bound, data, data_len);
+	if (!zlen || zlen >= data_len) {
+		/* incompressible; account it as sent as is */
+		z_sock_zip_stat(sep, 0, data_len, data_len, z_sock_zip_ns(&t0));
+		__sock_wr_free(wr);
+		return NULL;
+	}
+	z_sock_zip_stat(sep, 0, data_len, zlen, z_sock_zip_ns(&t0));
+	memcpy(wr->msg.bytes, m, msg_size);
+	wr->msg.sendrecv.hdr.flags = htons(SOCK_MSG_F_ZIP);
+	wr->msg.sendrecv.hdr.msg_len = htonl(msg_size + zlen);
+	wr->msg_len = msg_size + zlen;
+	wr->data_len = 0;
+	wr->data = NULL;
+	wr->off = 0;
+	return wr;
+}
+
 /**
  * Receiving a read response message.
  */
@@ -730,7 +986,13 @@ static void process_sep_msg_read_resp(struct z_sock_ep *sep)
 					   data_len, 0);
 		switch (rc) {
 		case 0:
-			memcpy(io->dst_ptr, msg->data, data_len);
+			if (!(msg->hdr.flags & htons(SOCK_MSG_F_ZIP))) {
+				memcpy(io->dst_ptr, msg->data, data_len);
+				break;
+			}
+			if (z_sock_unzip(sep, io->dst_ptr, data_len, msg->data,
+					 ntohl(msg->hdr.msg_len) - sizeof(*msg)))
+				rc = ZAP_ERR_LOCAL_OPERATION;
 			break;
 		case EACCES:
 			rc = ZAP_ERR_LOCAL_PERMISSION;
@@ -763,7 +1025,7 @@ z_sock_hdr_init(struct sock_msg_hdr *hdr, uint32_t xid,
 		hdr->xid = __sync_add_and_fetch(&g_xid, 1);
 	else
 		hdr->xid = xid;
-	hdr->reserved = 0;
+	hdr->flags = 0;
 	hdr->msg_type = htons(type);
 	hdr->msg_len = htonl(len);
 	hdr->ctxt = ctxt;
@@ -1495,6 +1757,7 @@ static zap_err_t __sock_send_connect(struct z_sock_ep *sep, char *buf, size_t le
 	msg.data_len = htonl(len);
 	ZAP_VERSION_SET(msg.ver);
 	memcpy(&msg.sig, ZAP_SOCK_SIG, sizeof(msg.sig));
+	msg.hdr.flags = htons(z_sock_zip_codecs); /* compression offer */
 
 	zerr = __sock_send_msg(sep, &msg.hdr, sizeof(msg), buf, len);
 	if (zerr)
@@ -1510,6 +1773,8 @@ static zap_err_t __sock_send(struct z_sock_ep *sep, uint16_t msg_type,
 
 	z_sock_hdr_init(&msg.hdr, 0, msg_type, (uint32_t)(sizeof(msg) + len), 0);
 	msg.data_len = htonl(len);
+	if (msg_type == SOCK_MSG_ACCEPTED)
+		msg.hdr.flags = htons(sep->zip); /* chosen codec */
 
 	return __sock_send_msg_nolock(sep, &msg.hdr, sizeof(msg), buf, len);
 }
@@ -1569,15 +1834,18 @@ static zap_err_t __sock_send_msg_nolock(struct z_sock_ep *sep,
 	assert(mtype != SOCK_MSG_WRITE_REQ); /* WRITE_REQ uses __wr_post() */
 	/* allocate send wr */
 	if (mtype == SOCK_MSG_READ_RESP) {
-		/* allow big message, and do not copy `data`  */
-		wr = __sock_wr_alloc(0, NULL);
-		if (!wr)
-			return ZAP_ERR_RESOURCE;
-		wr->msg_len = msg_size;
-		wr->data_len = data_len;
-		wr->data = data;
-		wr->off = 0;
-		memcpy(wr->msg.bytes, m, msg_size);
+		/* allow big message, and do not copy `data` unless compressed */
+		wr = __sock_zip_wr(sep, m, msg_size, data, data_len, NULL);
+		if (!wr) {
+			wr = __sock_wr_alloc(0, NULL);
+			if (!wr)
+				return ZAP_ERR_RESOURCE;
+			wr->msg_len = msg_size;
+			wr->data_len = data_len;
+			wr->data = data;
+			wr->off = 0;
+			memcpy(wr->msg.bytes, m, msg_size);
+		}
 	} else {
 		if (data_len > sep->ep.z->max_msg) {
 			DEBUG_LOG(sep, "%ld ep: %p, SEND invalid message length: %ld\n",
@@ -1807,6 +2075,7 @@ static zap_err_t z_sock_listen(zap_ep_t ep, struct sockaddr *sa,
 static zap_err_t z_sock_send2(zap_ep_t ep, char *buf, size_t len, void *cb_arg)
 {
 	struct z_sock_ep *sep = (struct z_sock_ep *)ep;
+	struct sock_msg_sendrecv msg;
 	struct z_sock_io *io;
 	zap_err_t zerr;
 
@@ -1829,20 +2098,22 @@ static zap_err_t z_sock_send2(zap_ep_t ep, char *buf, size_t len, void *cb_arg)
 	io->comp_type = ZAP_EVENT_SEND_COMPLETE;
 	io->ctxt = cb_arg;
 
-	io->wr = __sock_wr_alloc(len, io);
+	z_sock_hdr_init(&msg.hdr, 0, SOCK_MSG_SENDRECV, sizeof(msg) + len, 0);
+	msg.data_len = htonl((uint32_t)len);
+	io->wr = __sock_zip_wr(sep, &msg.hdr, sizeof(msg), buf, len, io);
 	if (!io->wr) {
-		zerr = ZAP_ERR_RESOURCE;
-		goto err1;
+		io->wr = __sock_wr_alloc(len, io);
+		if (!io->wr) {
+			zerr = ZAP_ERR_RESOURCE;
+			goto err1;
+		}
+		io->wr->data = 0;
+		io->wr->data_len = 0;
+		io->wr->msg_len = sizeof(msg) + len;
+		memcpy(io->wr->msg.bytes, &msg, sizeof(msg));
+		memcpy(io->wr->msg.bytes + sizeof(msg), buf, len);
 	}
-
 	io->wr->flags = Z_SOCK_WR_COMPLETION | Z_SOCK_WR_SEND;
-	io->wr->data = 0;
-	io->wr->data_len = 0;
-	io->wr->msg_len = sizeof(io->wr->msg.sendrecv) + len;
-	z_sock_hdr_init(&io->wr->msg.sendrecv.hdr, 0, SOCK_MSG_SENDRECV,
-			sizeof(io->wr->msg.sendrecv) + len, 0);
-	io->wr->msg.sendrecv.data_len = htonl((uint32_t)len);
-	memcpy(io->wr->msg.bytes + sizeof(io->wr->msg.sendrecv), buf, len);
 
 	TAILQ_INSERT_TAIL(&sep->io_q, io, q_link);
 	/* Post the work request */
@@ -1947,6 +2218,7 @@ static int init_once()
 		ovis_log(NULL, OVIS_LWARN, "Failed to create zap_sock's "
 				"log subsystem. Error %d.\n", errno);
 	}
+	z_sock_zip_init();
 
 	__atomic_store_n(&init_complete, 1, __ATOMIC_SEQ_CST);
 	pthread_mutex_unlock(&mutex);
@@ -2014,6 +2286,11 @@ static void z_sock_destroy(zap_ep_t ep)
 	ZAP_ASSERT(TAILQ_EMPTY(&sep->io_q), ep, "%s: The io_q is not empty "
 			"when the reference count reaches 0.\n", __func__);
 	z_sock_buff_cleanup(&sep->buff);
+	z_sock_buff_cleanup(&sep->unzip_buff);
+#ifdef HAVE_LIBZSTD
+	ZSTD_freeCCtx(sep->zip_cctx);
+	ZSTD_freeDCtx(sep->zip_dctx);
+#endif
 	pthread_mutex_lock(&z_sock_list_mutex);
 	LIST_REMOVE(sep, link);
 	pthread_mutex_unlock(&z_sock_list_mutex);
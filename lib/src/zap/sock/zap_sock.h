@@ -141,12 +141,28 @@ const char *sock_msg_type_str(sock_msg_type_t t)
  */
 struct sock_msg_hdr {
 	uint16_t msg_type; /**< The request type */
-	uint16_t reserved;
+	uint16_t flags;    /**< Message type specific flags (see below) */
 	uint32_t msg_len;  /**< Length of the entire message, header included. */
 	uint32_t xid;	   /**< Transaction Id to check against reply */
 	uint64_t ctxt;	   /**< User context to be returned in reply */
 };
 
+/*
+ * Payload compression codecs. SOCK_MSG_CONNECT carries the codecs the
+ * active side offers in hdr.flags and SOCK_MSG_ACCEPTED carries the one the
+ * passive side chose (0 for none). The field used to be reserved and is 0
+ * from (and ignored by) older peers, so compression is used only when both
+ * sides enable it.
+ */
+#define SOCK_ZIP_ZLIB 0x1
+#define SOCK_ZIP_ZSTD 0x2
+
+/*
+ * hdr.flags of SOCK_MSG_SENDRECV and SOCK_MSG_READ_RESP: data[] is compressed
+ * with the negotiated codec and data_len is the uncompressed length.
+ */
+#define SOCK_MSG_F_ZIP 0x1
+
 static char ZAP_SOCK_SIG[8] = "SOCKET";
 
 /**
@@ -298,6 +314,11 @@ struct z_sock_ep {
 	TAILQ_HEAD(, z_sock_send_wr_s) sq; /* send queue */
 	LIST_ENTRY(z_sock_ep) link;
 	pthread_cond_t sq_cond;
+
+	int zip; /* negotiated SOCK_ZIP_* codec, 0 if none */
+	void *zip_cctx; /* zstd compression context, protected by ep.lock */
+	void *zip_dctx; /* zstd decompression context, used by the io thread */
+	struct z_sock_buff_s unzip_buff; /* decompressed SOCK_MSG_SENDRECV data */
 };
 
 #define ZAP_SOCK_EV_SIZE 4096
@@ -0,0 +1,539 @@
+/* -*- c-basic-offset: 8 -*-
+ * Copyright (c) 2026 National Technology & Engineering Solutions
+ * of Sandia, LLC (NTESS). Under the terms of Contract DE-NA0003525 with
+ * NTESS, the U.S. Government retains certain rights in this software.
+ * Copyright (c) 2026 Open Grid Computing, Inc. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the BSD-type
+ * license below:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *      Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *      Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ *      Neither the name of Sandia nor the names of any contributors may
+ *      be used to endorse or promote products derived from this software
+ *      without specific prior written permission.
+ *
+ *      Neither the name of Open Grid Computing nor the names of any
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ *      Modified source versions must be plainly marked as such, and
+ *      must not be misrepresented as being the original software.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * \file zap_test_compress.c
+ *
+ * Test the payload compression of the transports (sock, ZAP_SOCK_COMPRESS).
+ *
+ * To test, run two processes of the test program as follows:
+ * ```
+ * # run the server; it serves one client and exits when the client
+ * # disconnects
+ * $ ZAP_SOCK_COMPRESS=zstd zap_test_compress -x sock -p PORT -s [-e 0|1]
+ *
+ * # run the client
+ * $ ZAP_SOCK_COMPRESS=zstd zap_test_compress -x sock -p PORT -h HOST [-e 0|1]
+ * ```
+ *
+ * Each side may use any ZAP_SOCK_COMPRESS setting (or none), or be an older
+ * libzap_sock without compression (ZAP_LIBPATH). `-e 1` expects the
+ * payloads to be compressed in both directions, `-e 0` expects them not to
+ * be; without `-e` only the data is verified.
+ *
+ * Here's the scenario:
+ * - The server maps a region that is half compressible text and half
+ *   random bytes, and listens on the specified port.
+ * - The client asks the server to zap_share the region.
+ * - The client sends text and random messages of various sizes, up to the
+ *   maximum message size (SENDRECV). The server verifies each one and sends
+ *   it back; the client verifies the echo.
+ * - The client zap_reads the whole region and then parts of it (READ_RESP),
+ *   verifying the data.
+ * - Both sides print the compression counters of the zap threads (bytes
+ *   before and after, and the savings) and check them against `-e`.
+ * - The exit status is 0 if everything checked out.
+ */
+#include <unistd.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <getopt.h>
+#include <stdlib.h>
+#include <sys/errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <assert.h>
+#include "zap.h"
+
+#ifdef NDEBUG
+#define ASSERT(COND) do { \
+	if (COND) \
+		break; \
+	printf("assert(" #COND ") failed.\n"); \
+	exit(-1); \
+} while (0)
+#else
+#define ASSERT(COND) assert(COND)
+#endif
+
+#define FAIL(FMT, ...) do { \
+	printf("FAIL: %s:%d " FMT, __func__, __LINE__, ## __VA_ARGS__); \
+	exit(1); \
+} while (0)
+
+/* The shared region; not a multiple of any block size on purpose */
+#define REGION_SZ (1024 * 1024 + 123)
+
+enum msg_type {
+	MSG_SHARE_REQ,
+	MSG_SHARE_REP,
+	MSG_ECHO,
+};
+
+enum data_kind {
+	DATA_TEXT,	/* compressible */
+	DATA_RANDOM,	/* incompressible */
+};
+
+#pragma pack(push, 4)
+struct msg {
+	uint32_t type;
+	uint32_t kind;
+	uint32_t seed;
+	uint32_t len;	/* of data[] */
+	uint64_t addr;	/* MSG_SHARE_REP: the address of the region */
+	char data[];
+};
+#pragma pack(pop)
+
+zap_t zap;
+char *region;
+zap_map_t region_map;
+char *buf;
+zap_map_t buf_map;
+struct zap_mem_info meminfo;
+int expect = -1;
+
+/* client */
+sem_t sem;
+zap_map_t remote_map;
+char *remote_addr;
+struct msg *echo;
+
+static void fill(char *p, size_t len, uint32_t seed, int kind)
+{
+	static const char *words[] = { "cpu", "user=", "sys=", "idle=", "\n" };
+	uint32_t x = seed | 1;
+	size_t i, n;
+
+	if (kind == DATA_RANDOM) {
+		for (i = 0; i < len; i++) {
+			/* xorshift32 */
+			x ^= x << 13;
+			x ^= x >> 17;
+			x ^= x << 5;
+			p[i] = x;
+		}
+		return;
+	}
+	for (i = 0; i < len; i += n) {
+		n = snprintf(p + i, len - i, "%s%u ",
+			     words[(seed + i) % 5], (unsigned)((seed + i / 64) % 1000));
+		if (n >= len - i)
+			break;
+	}
+}
+
+static void verify(const char *what, const char *p, size_t len,
+		   uint32_t seed, int kind)
+{
+	char *exp = malloc(len + 1);
+	size_t i;
+
+	ASSERT(exp);
+	fill(exp, len, seed, kind);
+	if (memcmp(p, exp, len)) {
+		for (i = 0; i < len && p[i] == exp[i]; i++)
+			;
+		FAIL("%s: %zu bytes (seed %u kind %d) differ at offset %zu\n",
+		     what, len, seed, kind, i);
+	}
+	free(exp);
+}
+
+/* The region: the first half is text, the second half is random */
+static void fill_region(char *p)
+{
+	fill(p, REGION_SZ / 2, 7, DATA_TEXT);
+	fill(p + REGION_SZ / 2, REGION_SZ - REGION_SZ / 2, 11, DATA_RANDOM);
+}
+
+static void verify_region(const char *p, size_t off, size_t len)
+{
+	char *exp = malloc(REGION_SZ);
+	size_t i;
+
+	ASSERT(exp);
+	fill_region(exp);
+	if (memcmp(p, exp + off, len)) {
+		for (i = 0; i < len && p[i] == exp[off + i]; i++)
+			;
+		FAIL("read [%zu, %zu) differs at offset %zu\n",
+		     off, off + len, off + i);
+	}
+	free(exp);
+}
+
+/* Print the compression counters of all zap threads and check `expect` */
+static int report(const char *side)
+{
+	struct zap_thrstat_result *res;
+	struct zap_zip_stats z = {};
+	int i, rc = 0;
+
+	res = zap_thrstat_get_result(0);
+	ASSERT(res);
+	for (i = 0; i < res->count; i++) {
+		z.in_bytes += res->entries[i].zip.in_bytes;
+		z.out_bytes += res->entries[i].zip.out_bytes;
+		z.ns += res->entries[i].zip.ns;
+		z.unzip_in_bytes += res->entries[i].zip.unzip_in_bytes;
+		z.unzip_out_bytes += res->entries[i].zip.unzip_out_bytes;
+		z.unzip_ns += res->entries[i].zip.unzip_ns;
+	}
+	zap_thrstat_free_result(res);
+	printf("%s: compressed %" PRIu64 " -> %" PRIu64 " bytes "
+	       "(saved %" PRId64 ", %.1f%%) in %.3f ms\n", side,
+	       z.in_bytes, z.out_bytes, (int64_t)(z.in_bytes - z.out_bytes),
+	       z.in_bytes ? 100.0 * (z.in_bytes - z.out_bytes) / z.in_bytes : 0.0,
+	       z.ns / 1e6);
+	printf("%s: decompressed %" PRIu64 " -> %" PRIu64 " bytes in %.3f ms\n",
+	       side, z.unzip_in_bytes, z.unzip_out_bytes, z.unzip_ns / 1e6);
+	if (expect == 1 &&
+	    !(z.out_bytes < z.in_bytes && z.unzip_in_bytes < z.unzip_out_bytes)) {
+		printf("FAIL: %s: expected compression in both directions\n", side);
+		rc = 1;
+	}
+	if (expect == 0 && (z.in_bytes || z.unzip_in_bytes)) {
+		printf("FAIL: %s: expected no compression\n", side);
+		rc = 1;
+	}
+	return rc;
+}
+
+static void on_server_recv(zap_ep_t ep, zap_event_t ev)
+{
+	struct msg *msg = (void *)ev->data;
+	struct msg rep = { .type = MSG_SHARE_REP };
+	zap_err_t err;
+
+	ASSERT(ev->data_len >= sizeof(*msg));
+	switch (msg->type) {
+	case MSG_SHARE_REQ:
+		rep.addr = (uint64_t)(uintptr_t)region;
+		rep.len = REGION_SZ;
+		err = zap_share(ep, region_map, (void *)&rep, sizeof(rep));
+		ASSERT(err == ZAP_ERR_OK);
+		break;
+	case MSG_ECHO:
+		if (ev->data_len != sizeof(*msg) + msg->len)
+			FAIL("message length %zu, expected %zu\n",
+			     ev->data_len, sizeof(*msg) + msg->len);
+		verify("server recv", msg->data, msg->len, msg->seed, msg->kind);
+		err = zap_send(ep, ev->data, ev->data_len);
+		ASSERT(err == ZAP_ERR_OK);
+		break;
+	default:
+		FAIL("unexpected message type %d\n", msg->type);
+	}
+}
+
+static void server_cb(zap_ep_t ep, zap_event_t ev)
+{
+	zap_err_t err;
+
+	switch (ev->type) {
+	case ZAP_EVENT_CONNECT_REQUEST:
+		err = zap_accept(ep, server_cb, NULL, 0);
+		ASSERT(err == ZAP_ERR_OK);
+		break;
+	case ZAP_EVENT_CONNECTED:
+		printf("server: client connected\n");
+		break;
+	case ZAP_EVENT_RECV_COMPLETE:
+		on_server_recv(ep, ev);
+		break;
+	case ZAP_EVENT_SEND_COMPLETE:
+		if (ev->status)
+			FAIL("send completed with %s\n", zap_err_str(ev->status));
+		break;
+	case ZAP_EVENT_DISCONNECTED:
+		printf("server: client disconnected\n");
+		exit(report("server"));
+		break;
+	default:
+		FAIL("unexpected zap event %s\n", zap_event_str(ev->type));
+	}
+}
+
+static void client_cb(zap_ep_t ep, zap_event_t ev)
+{
+	struct msg *msg = (void *)ev->data;
+
+	switch (ev->type) {
+	case ZAP_EVENT_CONNECTED:
+		sem_post(&sem);
+		break;
+	case ZAP_EVENT_RENDEZVOUS:
+		ASSERT(ev->data_len == sizeof(*msg));
+		ASSERT(msg->type == MSG_SHARE_REP && msg->len == REGION_SZ);
+		remote_map = ev->map;
+		remote_addr = (char *)(uintptr_t)msg->addr;
+		sem_post(&sem);
+		break;
+	case ZAP_EVENT_RECV_COMPLETE:
+		ASSERT(msg->type == MSG_ECHO);
+		if (ev->data_len != sizeof(*msg) + msg->len)
+			FAIL("echo length %zu, expected %zu\n",
+			     ev->data_len, sizeof(*msg) + msg->len);
+		verify("client recv", msg->data, msg->len, msg->seed, msg->kind);
+		sem_post(&sem);
+		break;
+	case ZAP_EVENT_READ_COMPLETE:
+		if (ev->status)
+			FAIL("read completed with %s\n", zap_err_str(ev->status));
+		sem_post(&sem);
+		break;
+	case ZAP_EVENT_SEND_COMPLETE:
+		if (ev->status)
+			FAIL("send completed with %s\n", zap_err_str(ev->status));
+		break;
+	case ZAP_EVENT_DISCONNECTED:
+		printf("client: disconnected\n");
+		break;
+	default:
+		FAIL("unexpected zap event %s\n", zap_event_str(ev->type));
+	}
+}
+
+static void do_server(struct sockaddr_in *sin)
+{
+	zap_err_t err;
+	zap_ep_t ep;
+
+	fill_region(region);
+	ep = zap_new(zap, server_cb);
+	ASSERT(ep);
+	err = zap_listen(ep, (struct sockaddr *)sin, sizeof(*sin));
+	if (err)
+		FAIL("zap_listen: %s\n", zap_err_str(err));
+	while (1)
+		pause();
+}
+
+static void client_read(zap_ep_t ep, size_t off, size_t len)
+{
+	zap_err_t err;
+
+	memset(buf, 0, len);
+	err = zap_read(ep, remote_map, remote_addr + off, buf_map, buf, len,
+		       NULL);
+	ASSERT(err == ZAP_ERR_OK);
+	sem_wait(&sem);
+	verify_region(buf, off, len);
+}
+
+static int do_client(struct sockaddr_in *sin)
+{
+	static const size_t sizes[] = { 100, 1023, 1024, 4096, 65536, 0 };
+	struct msg *msg;
+	zap_err_t err;
+	zap_ep_t ep;
+	size_t len, max = zap_max_msg(zap) - sizeof(*msg);
+	int i, kind, n = 0;
+
+	msg = malloc(sizeof(*msg) + max);
+	ASSERT(msg);
+	ep = zap_new(zap, client_cb);
+	ASSERT(ep);
+	err = zap_connect(ep, (struct sockaddr *)sin, sizeof(*sin), NULL, 0);
+	if (err)
+		FAIL("zap_connect: %s\n", zap_err_str(err));
+	sem_wait(&sem);
+
+	memset(msg, 0, sizeof(*msg));
+	msg->type = MSG_SHARE_REQ;
+	err = zap_send(ep, msg, sizeof(*msg));
+	ASSERT(err == ZAP_ERR_OK);
+	sem_wait(&sem);
+
+	for (kind = DATA_TEXT; kind <= DATA_RANDOM; kind++) {
+		for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+			len = sizes[i] ? sizes[i] : max;
+			msg->type = MSG_ECHO;
+			msg->kind = kind;
+			msg->seed = ++n;
+			msg->len = len;
+			fill(msg->data, len, msg->seed, kind);
+			err = zap_send(ep, msg, sizeof(*msg) + len);
+			if (err)
+				FAIL("zap_send %zu bytes: %s\n", len,
+				     zap_err_str(err));
+			sem_wait(&sem);
+		}
+	}
+	printf("client: %d messages echoed intact\n", n);
+
+	client_read(ep, 0, REGION_SZ);
+	client_read(ep, 0, 1000);
+	client_read(ep, 1000, 69000);
+	client_read(ep, REGION_SZ / 2 - 500, 1000);
+	client_read(ep, 70000, REGION_SZ - 70000);
+	printf("client: 5 reads intact\n");
+
+	free(msg);
+	zap_close(ep);
+	return report("client");
+}
+
+static int resolve(const char *hostname, struct sockaddr_in *sin)
+{
+	struct hostent *h;
+
+	h = gethostbyname(hostname);
+	if (!h) {
+		printf("Error resolving hostname '%s'\n", hostname);
+		return -1;
+	}
+
+	if (h->h_addrtype != AF_INET) {
+		printf("Hostname '%s' resolved to an unsupported"
+				" address family\n", hostname);
+		return -1;
+	}
+
+	memset(sin, 0, sizeof *sin);
+	sin->sin_addr.s_addr = *(unsigned int *)(h->h_addr_list[0]);
+	sin->sin_family = h->h_addrtype;
+	return 0;
+}
+
+static zap_mem_info_t test_meminfo(void)
+{
+	return &meminfo;
+}
+
+#define FMT_ARGS "x:p:h:se:"
+static void usage(int argc, char *argv[])
+{
+	printf("usage: %s -x name -p port_no -h host [-s] [-e 0|1]\n"
+	       "    -x name	The transport to use.\n"
+	       "    -p port_no	The port number.\n"
+	       "    -h host	The host name or IP address. Must be specified\n"
+	       "		if this is the client.\n"
+	       "    -s		This is a server.\n"
+	       "    -e 0|1	Expect the payloads not to be (0) or to be (1)\n"
+	       "		compressed.\n"
+	       ,
+	       argv[0]);
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	int rc;
+	int is_server = 0;
+	unsigned short port_no = 0;
+	int ptmp = -1;
+	const char *xprt = NULL;
+	const char *host = NULL;
+	struct sockaddr_in sin = {};
+	zap_err_t err;
+
+	setbuf(stdout, NULL);
+
+	while (-1 != (rc = getopt(argc, argv, FMT_ARGS))) {
+		switch (rc) {
+		case 's':
+			is_server = 1;
+			break;
+		case 'h':
+			host = optarg;
+			break;
+		case 'x':
+			xprt = optarg;
+			break;
+		case 'p':
+			ptmp = atoi(optarg);
+			if (ptmp > 0 && ptmp < USHRT_MAX)
+				port_no = ptmp;
+			break;
+		case 'e':
+			expect = atoi(optarg);
+			break;
+		default:
+			usage(argc, argv);
+			break;
+		}
+	}
+	if (!xprt || !port_no || (!is_server && !host))
+		usage(argc, argv);
+
+	if (host) {
+		if (resolve(host, &sin))
+			usage(argc, argv);
+	} else
+		sin.sin_family = AF_INET;
+	sin.sin_port = htons(port_no);
+
+	sem_init(&sem, 0, 0);
+	region = calloc(1, REGION_SZ);
+	buf = calloc(1, REGION_SZ);
+	ASSERT(region && buf);
+	err = zap_map(&region_map, region, REGION_SZ, ZAP_ACCESS_READ);
+	ASSERT(err == ZAP_ERR_OK);
+	err = zap_map(&buf_map, buf, REGION_SZ,
+		      ZAP_ACCESS_READ|ZAP_ACCESS_WRITE);
+	ASSERT(err == ZAP_ERR_OK);
+	meminfo.start = region;
+	meminfo.len = REGION_SZ;
+
+	zap = zap_get(xprt, test_meminfo);
+	if (!zap) {
+		printf("%s: could not load the '%s' xprt.\n",
+		       __func__, xprt);
+		exit(1);
+	}
+	if (is_server)
+		do_server(&sin);
+	return do_client(&sin);
+}
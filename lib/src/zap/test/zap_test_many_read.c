@@ -398,7 +398,8 @@ void do_client(zap_t zap, struct sockaddr_in *sin)
 {
 	zap_err_t err;
 	zap_ep_t ep;
-	struct timespec ts;
+	struct timespec ts, t0, t1;
+	double usec;
 	int i, round;
 
 	ep = zap_new(zap, client_cb);
@@ -436,6 +437,7 @@ void do_client(zap_t zap, struct sockaddr_in *sin)
 	nanosleep(&ts, NULL);
 	pthread_mutex_lock(&mutex);
 	completions = 0;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
 	for (i = 0; i < num_sets; i++) {
 		err = zap_read(ep, rsets[i].map, rsets[i].addr,
 				   lmaps[i], (void*)&sets[i], sizeof(sets[i]),
@@ -445,7 +447,10 @@ void do_client(zap_t zap, struct sockaddr_in *sin)
 	while (completions < num_sets) {
 		pthread_cond_wait(&cond, &mutex);
 	}
-	LOG("(round: %d) %d read completions\n", round, completions);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	usec = (t1.tv_sec - t0.tv_sec)*1e6 + (t1.tv_nsec - t0.tv_nsec)/1e3;
+	LOG("(round: %d) %d read completions in %.0f usec (%.0f reads/sec)\n",
+	    round, completions, usec, completions * 1e6 / usec);
 	pthread_mutex_unlock(&mutex);
 	round++;
 	goto loop;
@@ -65,6 +65,7 @@
 #include <netdb.h>
 #include <unistd.h>
 #include <sys/sysinfo.h>
+#include <sched.h>
 #include "ovis_log/ovis_log.h"
 #include "ovis_thrstats/ovis_thrstats.h"
 #include "ovis-ldms-config.h"
@@ -83,6 +84,8 @@ int __zap_assert = 0;
 #define ZAP_IO_BUSY 0.8 /* default value */
 static double zap_io_busy = ZAP_IO_BUSY;
 static int zap_io_max;
+/* pin the threads of pool i to CPU (i % nprocs) when set (ZAP_IO_AFFINITY) */
+static int zap_io_affinity;
 
 LIST_HEAD(zap_list, zap) zap_list;
 
@@ -795,6 +798,16 @@ static zap_io_thread_t __io_thread_create(zap_t z, struct zap_io_thread_pool_s *
 	t->stat->pool_idx = tp->idx;
 	t->tp = tp;
 	tp->n++;
+	if (zap_io_affinity) {
+		cpu_set_t cpus;
+		int ncpu = get_nprocs();
+		CPU_ZERO(&cpus);
+		CPU_SET(tp->idx % (ncpu?ncpu:1), &cpus);
+		if (pthread_setaffinity_np(t->thread, sizeof(cpus), &cpus))
+			ovis_log(zlog, OVIS_LWARN, "Cannot pin I/O thread of "
+				 "pool %d to CPU %d\n", tp->idx,
+				 tp->idx % (ncpu?ncpu:1));
+	}
 	LIST_INSERT_HEAD(&tp->_io_threads, t, _entry);
 	return t;
 }
@@ -966,6 +979,7 @@ void zap_thrstat_reset(zap_thrstat_t stats, struct timespec *now)
 {
 	struct ovis_thrstats *t = &stats->stats;
 	ovis_thrstats_reset(t, now);
+	memset(&stats->zip, 0, sizeof(stats->zip));
 	if (t->app_reset_fn)
 		t->app_reset_fn(t->app_ctxt, now);
 }
@@ -1050,6 +1064,7 @@ struct zap_thrstat_result *zap_thrstat_get_result(uint64_t interval_s)
 		res->entries[i].n_eps = t->n_eps;
 		res->entries[i].sq_sz = t->sq_sz;
 		res->entries[i].pool_idx = t->pool_idx;
+		res->entries[i].zip = t->zip;
 		i += 1;
 	}
 out:
@@ -1142,6 +1157,7 @@ static void zap_init(void)
 {
 	int nprocs = get_nprocs() / 2;
 	zap_io_max = zap_env_int("ZAP_IO_MAX", nprocs ? nprocs : 1);
+	zap_io_affinity = zap_env_int("ZAP_IO_AFFINITY", 0);
 	static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 	if (__atomic_load_n(&zap_initialized, __ATOMIC_SEQ_CST))
 		return;
@@ -852,6 +852,23 @@ void zap_thrstat_wait_start(zap_thrstat_t stats);
  */
 void zap_thrstat_wait_end(zap_thrstat_t stats);
 
+/**
+ * \struct zap_zip_stats
+ * \brief Payload compression counters
+ *
+ * Transports that compress message payloads (sock with ZAP_SOCK_COMPRESS)
+ * account the bytes before and after (de)compression and the time spent.
+ * The savings on the wire are \c in_bytes - \c out_bytes.
+ */
+struct zap_zip_stats {
+	uint64_t in_bytes;        /**< Payload bytes given to the compressor */
+	uint64_t out_bytes;       /**< Payload bytes sent */
+	uint64_t ns;              /**< Time spent compressing */
+	uint64_t unzip_in_bytes;  /**< Compressed payload bytes received */
+	uint64_t unzip_out_bytes; /**< Payload bytes after decompression */
+	uint64_t unzip_ns;        /**< Time spent decompressing */
+};
+
 /**
  * \struct zap_thrstat_result_entry
  * \brief Thread statistics for a Zap I/O thread
@@ -870,6 +887,8 @@ struct zap_thrstat_result_entry {
 	uint64_t sq_sz;
 	/** Thread pool index (-1 for dedicated threads) */
 	int pool_idx;
+	/** Payload compression counters */
+	struct zap_zip_stats zip;
     };
 
 /**
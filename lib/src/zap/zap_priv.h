@@ -542,6 +542,9 @@ struct zap_thrstat {
 
 	/** Number of endpoints */
 	uint64_t n_eps;
+
+	/** Payload compression of the thread's endpoints (see zap.h) */
+	struct zap_zip_stats zip;
 };
 
 /**